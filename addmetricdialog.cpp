@@ -1,6 +1,7 @@
 #include "addmetricdialog.h"
 #include "ui_addmetricdialog.h"
 #include <QMessageBox>
+#include "metricanomalydetector.h"
 // Ya no necesitas QDoubleValidator
 
 AddMetricDialog::AddMetricDialog(QWidget *parent) :
@@ -112,9 +113,31 @@ void AddMetricDialog::on_okButton_clicked()
         return;
     }
 
+    // Comparar con el historial reciente del paciente (mediana/MAD y ritmo de cambio)
+    HealthMetric candidate(m_editingMetricId, -1, getDate(), getWeight(), getHeight(), 0.0,
+                           getBodyFatPercentage(), getMuscleMassPercentage(), getNotes(), QDateTime());
+    const QList<MetricAnomalyDetector::Finding> findings = MetricAnomalyDetector::check(candidate, m_history, m_birthDate);
+    if (!findings.isEmpty()) {
+        const QMessageBox::StandardButton answer = QMessageBox::warning(
+            this, "Revise los datos",
+            "Algunos valores parecen improbables:\n\n" + MetricAnomalyDetector::describe(findings)
+                + "\n\n¿Guardar de todos modos?",
+            QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+        if (answer != QMessageBox::Yes) {
+            return;
+        }
+    }
+
     accept();
 }
 
+void AddMetricDialog::setAnomalyContext(const QList<HealthMetric>& history, const QDate& birthDate, int editingMetricId)
+{
+    m_history = history;
+    m_birthDate = birthDate;
+    m_editingMetricId = editingMetricId;
+}
+
 void AddMetricDialog::on_cancelButton_clicked()
 {
     reject();
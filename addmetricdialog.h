@@ -3,6 +3,8 @@
 
 #include <QDialog>
 #include <QDate>
+#include <QList>
+#include "healtmetric.h"
 
 // No necesitas QDoubleValidator si usas QDoubleSpinBox
 // #include <QDoubleSpinBox> // Normalmente no es necesario incluir aquí si ya está en ui_addmetricdialog.h
@@ -30,12 +32,20 @@ public:
     double getMuscleMassPercentage() const;
     QString getNotes() const;
 
+    // Historial del paciente para avisar de valores improbables antes de guardar.
+    // editingMetricId es el id de la métrica que se edita (-1 para una nueva).
+    void setAnomalyContext(const QList<HealthMetric>& history, const QDate& birthDate, int editingMetricId = -1);
+
 private slots:
     void on_okButton_clicked();
     void on_cancelButton_clicked();
 
 private:
     Ui::AddMetricDialog *ui;
+
+    QList<HealthMetric> m_history;
+    QDate m_birthDate;
+    int m_editingMetricId = -1;
 };
 
 #endif // ADDMETRICDIALOG_H
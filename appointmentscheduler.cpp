@@ -0,0 +1,585 @@
+#include "appointmentscheduler.h"
+#include "datachangehub.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <algorithm>
+
+namespace {
+
+const char* const kColumns = "appointment_id, user_id, practitioner, room, start_time, end_time, status, notes";
+
+qint64 secondsOf(const QDateTime& dateTime)
+{
+    return dateTime.toSecsSinceEpoch();
+}
+
+AppointmentScheduler::Appointment appointmentFromQuery(const QSqlQuery& query)
+{
+    AppointmentScheduler::Appointment appointment;
+    appointment.appointmentId = query.value(0).toInt();
+    appointment.userId = query.value(1).toInt();
+    appointment.practitioner = query.value(2).toString();
+    appointment.room = query.value(3).toString();
+    appointment.start = QDateTime::fromString(query.value(4).toString(), Qt::ISODate);
+    appointment.end = QDateTime::fromString(query.value(5).toString(), Qt::ISODate);
+    appointment.status = AppointmentScheduler::Status(query.value(6).toInt());
+    appointment.notes = query.value(7).toString();
+    return appointment;
+}
+
+void bindAppointment(QSqlQuery& query, const AppointmentScheduler::Appointment& appointment)
+{
+    query.bindValue(":user_id", appointment.userId);
+    query.bindValue(":practitioner", appointment.practitioner);
+    query.bindValue(":room", appointment.room.isEmpty() ? QVariant() : QVariant(appointment.room));
+    query.bindValue(":start_time", appointment.start.toString(Qt::ISODate));
+    query.bindValue(":end_time", appointment.end.toString(Qt::ISODate));
+    query.bindValue(":status", int(appointment.status));
+    query.bindValue(":notes", appointment.notes);
+}
+
+bool byStart(const AppointmentScheduler::Appointment& a, const AppointmentScheduler::Appointment& b)
+{
+    return a.start < b.start || (a.start == b.start && a.appointmentId < b.appointmentId);
+}
+
+} // namespace
+
+AppointmentScheduler* AppointmentScheduler::instance()
+{
+    static AppointmentScheduler scheduler;
+    return &scheduler;
+}
+
+AppointmentScheduler::AppointmentScheduler(QObject *parent)
+    : QObject(parent)
+    , m_loaded(false)
+{
+    connect(DataChangeHub::instance(), &DataChangeHub::healthMetricAdded, this, &AppointmentScheduler::onHealthMetricAdded);
+    connect(DataChangeHub::instance(), &DataChangeHub::userDeleted, this, &AppointmentScheduler::onUserDeleted);
+    connect(DataChangeHub::instance(), &DataChangeHub::bulkImportCompleted, this, &AppointmentScheduler::onBulkImportCompleted);
+}
+
+QString AppointmentScheduler::statusName(Status status)
+{
+    switch (status) {
+    case Scheduled: return "Programada";
+    case Completed: return "Realizada";
+    case Cancelled: return "Cancelada";
+    case NoShow: return "No presentado";
+    }
+    return QString();
+}
+
+bool AppointmentScheduler::ensureLoaded()
+{
+    if (m_loaded) {
+        return true;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT %1 FROM appointments WHERE status <> :cancelled").arg(kColumns));
+    query.bindValue(":cancelled", int(Cancelled));
+    if (!query.exec()) {
+        qCritical() << "Error al cargar la agenda:" << query.lastError().text();
+        return false;
+    }
+    m_appointments.clear();
+    m_byPractitioner.clear();
+    m_byRoom.clear();
+    while (query.next()) {
+        const Appointment appointment = appointmentFromQuery(query);
+        m_appointments.insert(appointment.appointmentId, appointment);
+        index(appointment);
+    }
+    m_loaded = true;
+    qInfo() << "Agenda cargada:" << m_appointments.size() << "citas," << m_byPractitioner.size()
+            << "profesionales en" << timer.elapsed() << "ms.";
+    return true;
+}
+
+void AppointmentScheduler::index(const Appointment& appointment)
+{
+    const qint64 start = secondsOf(appointment.start);
+    const qint64 end = secondsOf(appointment.end);
+    m_byPractitioner[appointment.practitioner].insert(start, end, appointment.appointmentId);
+    if (!appointment.room.isEmpty()) {
+        m_byRoom[appointment.room].insert(start, end, appointment.appointmentId);
+    }
+}
+
+void AppointmentScheduler::unindex(const Appointment& appointment)
+{
+    const qint64 start = secondsOf(appointment.start);
+    auto practitioner = m_byPractitioner.find(appointment.practitioner);
+    if (practitioner != m_byPractitioner.end()) {
+        practitioner->remove(start, appointment.appointmentId);
+    }
+    auto room = m_byRoom.find(appointment.room);
+    if (room != m_byRoom.end()) {
+        room->remove(start, appointment.appointmentId);
+    }
+}
+
+bool AppointmentScheduler::validate(const Appointment& appointment, QString* error)
+{
+    auto fail = [error](const QString& message) {
+        if (error) {
+            *error = message;
+        }
+        return false;
+    };
+    if (appointment.userId <= 0 || appointment.practitioner.trimmed().isEmpty()) {
+        return fail("La cita necesita un paciente y un profesional.");
+    }
+    if (!appointment.start.isValid() || !appointment.end.isValid() || appointment.end <= appointment.start) {
+        return fail("La hora de fin debe ser posterior a la de inicio.");
+    }
+    if (!ensureLoaded()) {
+        return fail("No se pudo cargar la agenda.");
+    }
+    const QList<Appointment> clashes = conflicts(appointment);
+    if (!clashes.isEmpty()) {
+        const Appointment& clash = clashes.first();
+        const bool samePractitioner = clash.practitioner == appointment.practitioner;
+        return fail(QString("%1 ya tiene una cita de %2 a %3.")
+                        .arg(samePractitioner ? appointment.practitioner : "La sala " + appointment.room,
+                             clash.start.toString("dd/MM/yyyy HH:mm"), clash.end.toString("HH:mm")));
+    }
+    return true;
+}
+
+int AppointmentScheduler::book(const Appointment& appointment, QString* error)
+{
+    Appointment booked = appointment;
+    booked.appointmentId = -1;
+    booked.status = Scheduled;
+    if (!validate(booked, error)) {
+        return -1;
+    }
+
+    QSqlQuery query;
+    query.prepare("INSERT INTO appointments (user_id, practitioner, room, start_time, end_time, status, notes) "
+                  "VALUES (:user_id, :practitioner, :room, :start_time, :end_time, :status, :notes)");
+    bindAppointment(query, booked);
+    if (!query.exec() || !query.lastInsertId().isValid()) {
+        qCritical() << "Error al reservar la cita:" << query.lastError().text();
+        if (error) {
+            *error = "No se pudo guardar la cita.";
+        }
+        return -1;
+    }
+    booked.appointmentId = query.lastInsertId().toInt();
+    m_appointments.insert(booked.appointmentId, booked);
+    index(booked);
+    emit appointmentChanged(booked.appointmentId);
+    return booked.appointmentId;
+}
+
+bool AppointmentScheduler::reschedule(const Appointment& appointment, QString* error)
+{
+    if (!ensureLoaded()) {
+        return false;
+    }
+    const auto it = m_appointments.constFind(appointment.appointmentId);
+    if (it == m_appointments.cend()) {
+        if (error) {
+            *error = "La cita no existe o está cancelada.";
+        }
+        return false;
+    }
+    Appointment updated = appointment;
+    updated.userId = it->userId;
+    updated.status = it->status;
+    if (!validate(updated, error)) {
+        return false;
+    }
+
+    QSqlQuery query;
+    query.prepare("UPDATE appointments SET practitioner = :practitioner, room = :room, start_time = :start_time, "
+                  "end_time = :end_time, notes = :notes, user_id = :user_id, status = :status "
+                  "WHERE appointment_id = :appointment_id");
+    bindAppointment(query, updated);
+    query.bindValue(":appointment_id", updated.appointmentId);
+    if (!query.exec()) {
+        qCritical() << "Error al mover la cita" << updated.appointmentId << ":" << query.lastError().text();
+        if (error) {
+            *error = "No se pudo guardar la cita.";
+        }
+        return false;
+    }
+    unindex(it.value());
+    m_appointments.insert(updated.appointmentId, updated);
+    index(updated);
+    emit appointmentChanged(updated.appointmentId);
+    return true;
+}
+
+bool AppointmentScheduler::updateStatusRow(int appointmentId, Status status)
+{
+    QSqlQuery query;
+    query.prepare("UPDATE appointments SET status = :status WHERE appointment_id = :appointment_id");
+    query.bindValue(":status", int(status));
+    query.bindValue(":appointment_id", appointmentId);
+    if (!query.exec()) {
+        qCritical() << "Error al cambiar el estado de la cita" << appointmentId << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool AppointmentScheduler::setStatus(int appointmentId, Status status)
+{
+    if (!ensureLoaded()) {
+        return false;
+    }
+    const auto it = m_appointments.find(appointmentId);
+    if (it == m_appointments.end()) {
+        qWarning() << "No se puede cambiar el estado de una cita cancelada o inexistente:" << appointmentId;
+        return false;
+    }
+    if (!updateStatusRow(appointmentId, status)) {
+        return false;
+    }
+    if (status == Cancelled) {
+        unindex(it.value());
+        m_appointments.erase(it);
+    } else {
+        it->status = status;
+    }
+    emit appointmentChanged(appointmentId);
+    return true;
+}
+
+AppointmentScheduler::Appointment AppointmentScheduler::appointment(int appointmentId)
+{
+    if (ensureLoaded() && m_appointments.contains(appointmentId)) {
+        return m_appointments.value(appointmentId);
+    }
+    // Canceladas: solo en la base de datos
+    QSqlQuery query;
+    query.prepare(QString("SELECT %1 FROM appointments WHERE appointment_id = :appointment_id").arg(kColumns));
+    query.bindValue(":appointment_id", appointmentId);
+    if (query.exec() && query.next()) {
+        return appointmentFromQuery(query);
+    }
+    return Appointment();
+}
+
+QList<AppointmentScheduler::Appointment> AppointmentScheduler::conflicts(const Appointment& appointment)
+{
+    QList<Appointment> result;
+    if (!ensureLoaded()) {
+        return result;
+    }
+    const qint64 start = secondsOf(appointment.start);
+    const qint64 end = secondsOf(appointment.end);
+    QVector<IntervalTree::Interval> hits;
+    const auto practitioner = m_byPractitioner.constFind(appointment.practitioner);
+    if (practitioner != m_byPractitioner.cend() && practitioner->overlaps(start, end, appointment.appointmentId)) {
+        hits += practitioner->overlapping(start, end);
+    }
+    const auto room = appointment.room.isEmpty() ? m_byRoom.cend() : m_byRoom.constFind(appointment.room);
+    if (room != m_byRoom.cend() && room->overlaps(start, end, appointment.appointmentId)) {
+        hits += room->overlapping(start, end);
+    }
+    for (const IntervalTree::Interval& hit : std::as_const(hits)) {
+        if (hit.id != appointment.appointmentId
+            && std::none_of(result.cbegin(), result.cend(), [&hit](const Appointment& a) { return a.appointmentId == hit.id; })) {
+            result.append(m_appointments.value(hit.id));
+        }
+    }
+    std::sort(result.begin(), result.end(), byStart);
+    return result;
+}
+
+QDateTime AppointmentScheduler::nextFreeSlot(const QString& practitioner, const QString& room, const QDateTime& from,
+                                             const QDateTime& to, int minutes)
+{
+    if (!ensureLoaded() || minutes <= 0) {
+        return QDateTime();
+    }
+    const qint64 length = qint64(minutes) * 60;
+    const qint64 end = secondsOf(to);
+    const IntervalTree none;
+    const IntervalTree& byPractitioner = m_byPractitioner.contains(practitioner) ? m_byPractitioner[practitioner] : none;
+    const IntervalTree& byRoom = (!room.isEmpty() && m_byRoom.contains(room)) ? m_byRoom[room] : none;
+
+    // Se alterna entre los dos árboles hasta que el hueco de uno también está libre en el otro;
+    // cada vuelta avanza el candidato, así que termina en pocas iteraciones
+    qint64 candidate = secondsOf(from);
+    while (candidate >= 0) {
+        const qint64 forPractitioner = byPractitioner.firstGap(candidate, end, length);
+        if (forPractitioner < 0) {
+            return QDateTime();
+        }
+        const qint64 forRoom = byRoom.firstGap(forPractitioner, end, length);
+        if (forRoom == forPractitioner) {
+            return QDateTime::fromSecsSinceEpoch(forRoom);
+        }
+        candidate = forRoom;
+    }
+    return QDateTime();
+}
+
+QList<AppointmentScheduler::Appointment> AppointmentScheduler::appointmentsBetween(const QDateTime& from, const QDateTime& to,
+                                                                                 const QString& practitioner)
+{
+    QList<Appointment> result;
+    if (!ensureLoaded()) {
+        return result;
+    }
+    const qint64 start = secondsOf(from);
+    const qint64 end = secondsOf(to);
+    for (auto it = m_byPractitioner.cbegin(); it != m_byPractitioner.cend(); ++it) {
+        if (!practitioner.isEmpty() && it.key() != practitioner) {
+            continue;
+        }
+        for (const IntervalTree::Interval& interval : it->overlapping(start, end)) {
+            result.append(m_appointments.value(interval.id));
+        }
+    }
+    std::sort(result.begin(), result.end(), byStart);
+    return result;
+}
+
+QList<AppointmentScheduler::Appointment> AppointmentScheduler::view(View view, const QDate& date, const QString& practitioner)
+{
+    QDate first = date;
+    QDate last = date;
+    switch (view) {
+    case DayView:
+        break;
+    case WeekView:
+        first = date.addDays(1 - date.dayOfWeek());
+        last = first.addDays(6);
+        break;
+    case MonthView:
+        first = QDate(date.year(), date.month(), 1);
+        last = first.addMonths(1).addDays(-1);
+        break;
+    }
+    return appointmentsBetween(first.startOfDay(), last.addDays(1).startOfDay(), practitioner);
+}
+
+QList<AppointmentScheduler::Appointment> AppointmentScheduler::appointmentsForUser(int userId)
+{
+    QList<Appointment> result;
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT %1 FROM appointments WHERE user_id = :user_id ORDER BY start_time").arg(kColumns));
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al leer las citas del usuario" << userId << ":" << query.lastError().text();
+        return result;
+    }
+    while (query.next()) {
+        result.append(appointmentFromQuery(query));
+    }
+    return result;
+}
+
+QStringList AppointmentScheduler::practitioners()
+{
+    ensureLoaded();
+    QStringList names = m_byPractitioner.keys();
+    names.sort(Qt::CaseInsensitive);
+    return names;
+}
+
+QStringList AppointmentScheduler::rooms()
+{
+    ensureLoaded();
+    QStringList names = m_byRoom.keys();
+    names.sort(Qt::CaseInsensitive);
+    return names;
+}
+
+bool AppointmentScheduler::linkMetric(int appointmentId, int metricId)
+{
+    QSqlQuery query;
+    query.prepare("REPLACE INTO appointment_metrics (metric_id, appointment_id) VALUES (:metric_id, :appointment_id)");
+    query.bindValue(":metric_id", metricId);
+    query.bindValue(":appointment_id", appointmentId);
+    if (!query.exec()) {
+        qCritical() << "Error al enlazar la medición" << metricId << "con la cita" << appointmentId << ":"
+                    << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+QList<int> AppointmentScheduler::metricsFor(int appointmentId)
+{
+    QList<int> metricIds;
+    QSqlQuery query;
+    query.prepare("SELECT metric_id FROM appointment_metrics WHERE appointment_id = :appointment_id ORDER BY metric_id");
+    query.bindValue(":appointment_id", appointmentId);
+    if (!query.exec()) {
+        qCritical() << "Error al leer las mediciones de la cita" << appointmentId << ":" << query.lastError().text();
+        return metricIds;
+    }
+    while (query.next()) {
+        metricIds.append(query.value(0).toInt());
+    }
+    return metricIds;
+}
+
+int AppointmentScheduler::appointmentForMetric(int metricId)
+{
+    QSqlQuery query;
+    query.prepare("SELECT appointment_id FROM appointment_metrics WHERE metric_id = :metric_id");
+    query.bindValue(":metric_id", metricId);
+    if (query.exec() && query.next()) {
+        return query.value(0).toInt();
+    }
+    return -1;
+}
+
+void AppointmentScheduler::onHealthMetricAdded(int userId, int metricId)
+{
+    // La medición se enlaza con la primera cita no cancelada del paciente ese día
+    // (índice idx_appointments_user_start); no hace falta tener la agenda cargada
+    QSqlQuery query;
+    query.prepare("SELECT date FROM health_metrics WHERE metric_id = :metric_id");
+    query.bindValue(":metric_id", metricId);
+    if (!query.exec() || !query.next()) {
+        return;
+    }
+    const QDate day = QDate::fromString(query.value(0).toString().left(10), Qt::ISODate);
+    if (!day.isValid()) {
+        return;
+    }
+    query.prepare("SELECT appointment_id, status FROM appointments WHERE user_id = :user_id "
+                  "AND start_time >= :day_start AND start_time < :next_day AND status <> :cancelled "
+                  "ORDER BY start_time LIMIT 1");
+    query.bindValue(":user_id", userId);
+    query.bindValue(":day_start", day.toString(Qt::ISODate));
+    query.bindValue(":next_day", day.addDays(1).toString(Qt::ISODate));
+    query.bindValue(":cancelled", int(Cancelled));
+    if (!query.exec() || !query.next()) {
+        return;
+    }
+    const int appointmentId = query.value(0).toInt();
+    const Status status = Status(query.value(1).toInt());
+    if (!linkMetric(appointmentId, metricId)) {
+        return;
+    }
+    // Con la medición tomada la visita se da por realizada
+    if (status == Scheduled && updateStatusRow(appointmentId, Completed) && m_appointments.contains(appointmentId)) {
+        m_appointments[appointmentId].status = Completed;
+    }
+    emit appointmentChanged(appointmentId);
+}
+
+// Importación masiva: no emite healthMetricAdded, así que aquí se enlazan de una vez las mediciones
+// importadas con las citas del mismo día. Los pacientes nuevos no tienen citas y se descartan con
+// la primera consulta (índice idx_appointments_user_start).
+void AppointmentScheduler::onBulkImportCompleted(const QList<int>& userIds)
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QSqlQuery query;
+    QList<int> changed;
+    for (int userId : userIds) {
+        // Primera cita no cancelada de cada día
+        query.prepare("SELECT appointment_id, start_time, status FROM appointments "
+                      "WHERE user_id = :user_id AND status <> :cancelled ORDER BY start_time");
+        query.bindValue(":user_id", userId);
+        query.bindValue(":cancelled", int(Cancelled));
+        if (!query.exec()) {
+            qCritical() << "Error al leer las citas del usuario" << userId << ":" << query.lastError().text();
+            db.rollback();
+            return;
+        }
+        QHash<QString, QPair<int, Status>> byDay;
+        while (query.next()) {
+            const QString day = query.value(1).toString().left(10);
+            if (!byDay.contains(day)) {
+                byDay.insert(day, qMakePair(query.value(0).toInt(), Status(query.value(2).toInt())));
+            }
+        }
+        if (byDay.isEmpty()) {
+            continue;
+        }
+
+        query.prepare("SELECT m.metric_id, m.date FROM health_metrics m WHERE m.user_id = :user_id "
+                      "AND NOT EXISTS (SELECT 1 FROM appointment_metrics am WHERE am.metric_id = m.metric_id)");
+        query.bindValue(":user_id", userId);
+        if (!query.exec()) {
+            qCritical() << "Error al leer las mediciones del usuario" << userId << ":" << query.lastError().text();
+            db.rollback();
+            return;
+        }
+        QList<QPair<int, int>> links; // (medición, cita)
+        while (query.next()) {
+            const auto it = byDay.constFind(query.value(1).toString().left(10));
+            if (it != byDay.cend()) {
+                links.append(qMakePair(query.value(0).toInt(), it->first));
+            }
+        }
+        for (const auto& link : std::as_const(links)) {
+            if (!linkMetric(link.second, link.first)) {
+                db.rollback();
+                return;
+            }
+            if (!changed.contains(link.second)) {
+                changed.append(link.second);
+            }
+        }
+        // Con la medición tomada la visita se da por realizada
+        for (auto it = byDay.cbegin(); it != byDay.cend(); ++it) {
+            const int appointmentId = it->first;
+            if (it->second == Scheduled && changed.contains(appointmentId) && !updateStatusRow(appointmentId, Completed)) {
+                db.rollback();
+                return;
+            }
+        }
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar los enlaces de la importación:" << db.lastError().text();
+        return;
+    }
+    for (int appointmentId : std::as_const(changed)) {
+        if (m_appointments.contains(appointmentId) && m_appointments[appointmentId].status == Scheduled) {
+            m_appointments[appointmentId].status = Completed;
+        }
+        emit appointmentChanged(appointmentId);
+    }
+    if (!changed.isEmpty()) {
+        qInfo() << "Importación:" << changed.size() << "citas enlazadas con mediciones importadas.";
+    }
+}
+
+void AppointmentScheduler::onUserDeleted(int userId)
+{
+    QSqlQuery query;
+    query.prepare("DELETE FROM appointment_metrics WHERE appointment_id IN "
+                  "(SELECT appointment_id FROM appointments WHERE user_id = :user_id)");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al borrar las mediciones de las citas del usuario" << userId << ":" << query.lastError().text();
+    }
+    query.prepare("DELETE FROM appointments WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al borrar las citas del usuario" << userId << ":" << query.lastError().text();
+    }
+    if (!m_loaded) {
+        return;
+    }
+    for (auto it = m_appointments.begin(); it != m_appointments.end();) {
+        if (it->userId == userId) {
+            unindex(it.value());
+            it = m_appointments.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef APPOINTMENTSCHEDULER_H
+#define APPOINTMENTSCHEDULER_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include "intervaltree.h"
+
+// Agenda de citas de la consulta ('appointments', migración v7).
+// Las citas no canceladas se cargan una vez en memoria, en un árbol de intervalos por profesional
+// y otro por sala (IntervalTree), así que comprobar un conflicto al reservar o mover una cita y
+// buscar el siguiente hueco libre cuestan O(log n) aunque haya años de historial.
+// Las vistas de día, semana y mes se sirven de los mismos árboles, sin consultar la base de datos.
+// Cada visita enlaza con las mediciones que se tomaron en ella ('appointment_metrics'); al añadir
+// una medición se enlaza sola con la cita del paciente de ese día (también tras una importación masiva).
+class AppointmentScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Status {
+        Scheduled = 0,
+        Completed = 1,
+        Cancelled = 2,
+        NoShow = 3
+    };
+
+    enum View {
+        DayView,
+        WeekView,  // Lunes a domingo
+        MonthView
+    };
+
+    struct Appointment {
+        int appointmentId = -1;
+        int userId = -1;
+        QString practitioner;
+        QString room; // Opcional
+        QDateTime start;
+        QDateTime end;
+        Status status = Scheduled;
+        QString notes;
+    };
+
+    static AppointmentScheduler* instance();
+    static QString statusName(Status status);
+
+    bool ensureLoaded();
+
+    // Reserva una cita. Falla (con el motivo en 'error') si el profesional o la sala están ocupados.
+    // Retorna el id de la cita o -1.
+    int book(const Appointment& appointment, QString* error = nullptr);
+    // Cambia hora, profesional, sala o notas de una cita existente, con las mismas comprobaciones
+    bool reschedule(const Appointment& appointment, QString* error = nullptr);
+    // Cancelar libera el hueco; la cita queda en el historial del paciente
+    bool setStatus(int appointmentId, Status status);
+    Appointment appointment(int appointmentId);
+
+    // Citas con las que chocaría (sin contar la propia si ya existe)
+    QList<Appointment> conflicts(const Appointment& appointment);
+    // Primer hueco de 'minutes' minutos en [from, to) libre para el profesional y, si se indica, la sala.
+    // QDateTime inválido si no hay ninguno.
+    QDateTime nextFreeSlot(const QString& practitioner, const QString& room, const QDateTime& from,
+                           const QDateTime& to, int minutes);
+
+    // Citas no canceladas que se solapan con [from, to), por hora de inicio.
+    // Sin profesional: las de todos.
+    QList<Appointment> appointmentsBetween(const QDateTime& from, const QDateTime& to,
+                                           const QString& practitioner = QString());
+    QList<Appointment> view(View view, const QDate& date, const QString& practitioner = QString());
+    // Historial completo del paciente, canceladas incluidas
+    QList<Appointment> appointmentsForUser(int userId);
+    QStringList practitioners();
+    QStringList rooms();
+
+    // --- Mediciones de cada visita ---
+    bool linkMetric(int appointmentId, int metricId);
+    QList<int> metricsFor(int appointmentId);
+    int appointmentForMetric(int metricId); // -1 si la medición no está enlazada
+
+signals:
+    void appointmentChanged(int appointmentId);
+
+private slots:
+    void onHealthMetricAdded(int userId, int metricId);
+    void onUserDeleted(int userId);
+    void onBulkImportCompleted(const QList<int>& userIds);
+
+private:
+    explicit AppointmentScheduler(QObject *parent = nullptr);
+
+    bool validate(const Appointment& appointment, QString* error);
+    void index(const Appointment& appointment);
+    void unindex(const Appointment& appointment);
+    bool updateStatusRow(int appointmentId, Status status);
+
+    bool m_loaded;
+    QHash<int, Appointment> m_appointments; // Solo las no canceladas
+    QHash<QString, IntervalTree> m_byPractitioner;
+    QHash<QString, IntervalTree> m_byRoom;
+};
+
+#endif // APPOINTMENTSCHEDULER_H
@@ -0,0 +1,417 @@
+#include "arrowipcwriter.h"
+#include <QDate>
+#include <QDateTime>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+// Valores de Schema.fbs / Message.fbs / File.fbs de Arrow
+const qint16 kMetadataVersionV5 = 4;
+const quint8 kHeaderSchema = 1;
+const quint8 kHeaderRecordBatch = 3;
+const quint8 kTypeInt = 2;
+const quint8 kTypeFloatingPoint = 3;
+const quint8 kTypeUtf8 = 5;
+const quint8 kTypeDate = 8;
+const quint8 kTypeTimestamp = 10;
+const qint16 kPrecisionDouble = 2;
+const qint16 kDateUnitDay = 0;
+const qint16 kTimeUnitMillisecond = 1;
+
+const char kMagic[] = "ARROW1";
+const qint64 kMsecsPerDay = 86400000;
+
+qint64 padding8(qint64 size)
+{
+    return (8 - (size & 7)) & 7;
+}
+
+template <typename T>
+void appendLittleEndian(QByteArray& out, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian<T>(value, bytes);
+    out.append(bytes, sizeof(T));
+}
+
+// Constructor mínimo de FlatBuffers. Como el de la biblioteca oficial, escribe de atrás hacia
+// delante: cada objeto se crea antes que quien lo referencia, y un "offset" es la distancia desde
+// el final del búfer, de modo que las referencias siempre apuntan hacia delante en el resultado.
+class FlatBufferBuilder
+{
+public:
+    FlatBufferBuilder() : m_minAlign(1), m_tableStart(0) {}
+
+    quint32 createString(const QByteArray& utf8)
+    {
+        prep(4, utf8.size() + 1);
+        push<quint8>(0);
+        m_buf.prepend(utf8);
+        push<quint32>(quint32(utf8.size()));
+        return offset();
+    }
+
+    // Vector de structs ya serializados (little-endian, con su relleno interno)
+    quint32 createStructVector(const QByteArray& elements, int count, int alignment)
+    {
+        prep(4, elements.size());
+        prep(alignment, elements.size());
+        m_buf.prepend(elements);
+        push<quint32>(quint32(count));
+        return offset();
+    }
+
+    quint32 createOffsetVector(const QVector<quint32>& offsets)
+    {
+        prep(4, 4 * offsets.size());
+        for (int i = int(offsets.size()) - 1; i >= 0; --i) {
+            push<quint32>(offset() + 4 - offsets[i]);
+        }
+        push<quint32>(quint32(offsets.size()));
+        return offset();
+    }
+
+    void startTable(int fieldCount)
+    {
+        m_fields = QVector<quint32>(fieldCount, 0);
+        m_tableStart = offset();
+    }
+
+    template <typename T>
+    void addScalar(int field, T value)
+    {
+        prep(sizeof(T), 0);
+        push<T>(value);
+        m_fields[field] = offset();
+    }
+
+    void addOffset(int field, quint32 target)
+    {
+        prep(4, 0);
+        push<quint32>(offset() + 4 - target);
+        m_fields[field] = offset();
+    }
+
+    quint32 endTable()
+    {
+        prep(4, 0);
+        push<qint32>(0); // Desplazamiento a la vtable; se corrige al final
+        const quint32 object = offset();
+        for (int i = int(m_fields.size()) - 1; i >= 0; --i) {
+            push<quint16>(m_fields[i] ? quint16(object - m_fields[i]) : quint16(0));
+        }
+        push<quint16>(quint16(object - m_tableStart));
+        push<quint16>(quint16(4 + 2 * m_fields.size()));
+        const quint32 vtable = offset();
+        qToLittleEndian<qint32>(qint32(vtable - object), m_buf.data() + (m_buf.size() - object));
+        return object;
+    }
+
+    QByteArray finish(quint32 root)
+    {
+        prep(m_minAlign, 4);
+        push<quint32>(offset() + 4 - root);
+        return m_buf;
+    }
+
+private:
+    quint32 offset() const { return quint32(m_buf.size()); }
+
+    // Rellena para que, tras escribir 'additional' bytes, la posición quede alineada a 'size'
+    void prep(int size, qsizetype additional)
+    {
+        m_minAlign = qMax(m_minAlign, size);
+        const qsizetype padding = (~(m_buf.size() + additional) + 1) & (size - 1);
+        if (padding > 0) {
+            m_buf.prepend(QByteArray(padding, '\0'));
+        }
+    }
+
+    template <typename T>
+    void push(T value)
+    {
+        char bytes[sizeof(T)];
+        qToLittleEndian<T>(value, bytes);
+        m_buf.prepend(bytes, sizeof(T));
+    }
+
+    QByteArray m_buf;
+    int m_minAlign;
+    QVector<quint32> m_fields;
+    quint32 m_tableStart;
+};
+
+quint32 buildSchema(FlatBufferBuilder& builder, const QVector<ExportWriter::Column>& columns)
+{
+    QVector<quint32> fields;
+    for (const ExportWriter::Column& column : columns) {
+        const quint32 name = builder.createString(column.name.toUtf8());
+        const quint32 children = builder.createOffsetVector({});
+        quint8 typeType = kTypeUtf8;
+        switch (column.type) {
+        case ExportWriter::IntegerColumn:
+            typeType = kTypeInt;
+            builder.startTable(2);
+            builder.addScalar<qint32>(0, 64);
+            builder.addScalar<quint8>(1, 1); // Con signo
+            break;
+        case ExportWriter::RealColumn:
+            typeType = kTypeFloatingPoint;
+            builder.startTable(1);
+            builder.addScalar<qint16>(0, kPrecisionDouble);
+            break;
+        case ExportWriter::DateColumn:
+            typeType = kTypeDate;
+            builder.startTable(1);
+            builder.addScalar<qint16>(0, kDateUnitDay); // El valor por defecto es MILLISECOND: hay que escribirlo
+            break;
+        case ExportWriter::DateTimeColumn:
+            typeType = kTypeTimestamp;
+            builder.startTable(2);
+            builder.addScalar<qint16>(0, kTimeUnitMillisecond);
+            break;
+        case ExportWriter::TextColumn:
+            builder.startTable(0);
+            break;
+        }
+        const quint32 type = builder.endTable();
+
+        builder.startTable(7);
+        builder.addOffset(0, name);
+        builder.addOffset(3, type);
+        builder.addOffset(5, children);
+        builder.addScalar<quint8>(1, 1); // nullable
+        builder.addScalar<quint8>(2, typeType);
+        fields.append(builder.endTable());
+    }
+    const quint32 fieldVector = builder.createOffsetVector(fields);
+
+    builder.startTable(4);
+    builder.addOffset(1, fieldVector);
+    builder.addScalar<qint16>(0, 0); // Little-endian
+    return builder.endTable();
+}
+
+QByteArray buildMessage(FlatBufferBuilder& builder, quint8 headerType, quint32 header, qint64 bodyLength)
+{
+    builder.startTable(5);
+    builder.addScalar<qint64>(3, bodyLength);
+    builder.addOffset(2, header);
+    builder.addScalar<qint16>(0, kMetadataVersionV5);
+    builder.addScalar<quint8>(1, headerType);
+    return builder.finish(builder.endTable());
+}
+
+} // namespace
+
+ArrowIpcExportWriter::ArrowIpcExportWriter(ExportSink& sink, int batchRows)
+    : ExportWriter(sink)
+    , m_batchRows(qMax(1, batchRows))
+    , m_rows(0)
+{
+}
+
+void ArrowIpcExportWriter::resetBuilders()
+{
+    m_rows = 0;
+    for (int c = 0; c < m_builders.size(); ++c) {
+        ColumnBuilder& builder = m_builders[c];
+        builder.validity.clear();
+        builder.values.clear();
+        builder.offsets.clear();
+        builder.nullCount = 0;
+        if (m_columns[c].type == TextColumn) {
+            appendLittleEndian<qint32>(builder.offsets, 0);
+        }
+    }
+}
+
+bool ArrowIpcExportWriter::begin(const QVector<Column>& columns)
+{
+    m_columns = columns;
+    m_builders = QVector<ColumnBuilder>(columns.size());
+    m_batches.clear();
+    resetBuilders();
+
+    // Cabecera del archivo: "ARROW1" y relleno hasta 8 bytes
+    if (!m_sink.write(QByteArray(kMagic, 6) + QByteArray(2, '\0'))) {
+        return false;
+    }
+    FlatBufferBuilder builder;
+    const quint32 schema = buildSchema(builder, m_columns);
+    return writeMessage(buildMessage(builder, kHeaderSchema, schema, 0), {}, 0, nullptr);
+}
+
+bool ArrowIpcExportWriter::writeRow(const QVector<QVariant>& values)
+{
+    const int bit = m_rows & 7;
+    for (int c = 0; c < m_columns.size(); ++c) {
+        ColumnBuilder& builder = m_builders[c];
+        const QVariant& value = values[c];
+        bool valid = !value.isNull();
+
+        switch (m_columns[c].type) {
+        case IntegerColumn: {
+            const qint64 number = valid ? value.toLongLong(&valid) : 0;
+            appendLittleEndian<qint64>(builder.values, valid ? number : 0);
+            break;
+        }
+        case RealColumn: {
+            const double number = valid ? value.toDouble(&valid) : 0.0;
+            quint64 bits = 0;
+            if (valid) {
+                std::memcpy(&bits, &number, sizeof(bits));
+            }
+            appendLittleEndian<quint64>(builder.values, bits);
+            break;
+        }
+        case DateColumn: {
+            const QDate date = valid ? value.toDate() : QDate();
+            valid = date.isValid();
+            appendLittleEndian<qint32>(builder.values, valid ? qint32(QDate(1970, 1, 1).daysTo(date)) : 0);
+            break;
+        }
+        case DateTimeColumn: {
+            const QDateTime dateTime = valid ? value.toDateTime() : QDateTime();
+            valid = dateTime.isValid();
+            // Hora de pared tal cual (timestamp sin zona): días desde 1970 más la hora del día
+            const qint64 msecs = valid ? QDate(1970, 1, 1).daysTo(dateTime.date()) * kMsecsPerDay
+                                             + dateTime.time().msecsSinceStartOfDay()
+                                       : 0;
+            appendLittleEndian<qint64>(builder.values, msecs);
+            break;
+        }
+        case TextColumn:
+            if (valid) {
+                builder.values.append(value.toString().toUtf8());
+            }
+            appendLittleEndian<qint32>(builder.offsets, qint32(builder.values.size()));
+            break;
+        }
+
+        if (bit == 0) {
+            builder.validity.append('\0');
+        }
+        if (valid) {
+            builder.validity.data()[builder.validity.size() - 1] |= char(1 << bit);
+        } else {
+            ++builder.nullCount;
+        }
+    }
+
+    ++m_rows;
+    return m_rows < m_batchRows || flushBatch();
+}
+
+bool ArrowIpcExportWriter::flushBatch()
+{
+    if (m_rows == 0) {
+        return true;
+    }
+
+    // Búferes de cada columna en orden: validez, [offsets], valores. Cada uno empieza alineado a 8.
+    static const QByteArray empty;
+    QVector<const QByteArray*> buffers;
+    QByteArray nodes;
+    QByteArray bufferSpecs;
+    qint64 bodyLength = 0;
+    auto addBuffer = [&](const QByteArray* buffer) {
+        buffers.append(buffer);
+        appendLittleEndian<qint64>(bufferSpecs, bodyLength);
+        appendLittleEndian<qint64>(bufferSpecs, buffer->size());
+        bodyLength += buffer->size() + padding8(buffer->size());
+    };
+    for (int c = 0; c < m_columns.size(); ++c) {
+        const ColumnBuilder& builder = m_builders[c];
+        appendLittleEndian<qint64>(nodes, m_rows);
+        appendLittleEndian<qint64>(nodes, builder.nullCount);
+        addBuffer(builder.nullCount > 0 ? &builder.validity : &empty); // Sin nulos no hace falta el mapa
+        if (m_columns[c].type == TextColumn) {
+            addBuffer(&builder.offsets);
+        }
+        addBuffer(&builder.values);
+    }
+
+    FlatBufferBuilder builder;
+    const quint32 nodeVector = builder.createStructVector(nodes, int(m_columns.size()), 8);
+    const quint32 bufferVector = builder.createStructVector(bufferSpecs, int(buffers.size()), 8);
+    builder.startTable(4);
+    builder.addScalar<qint64>(0, m_rows);
+    builder.addOffset(1, nodeVector);
+    builder.addOffset(2, bufferVector);
+    const quint32 recordBatch = builder.endTable();
+
+    Block block;
+    if (!writeMessage(buildMessage(builder, kHeaderRecordBatch, recordBatch, bodyLength), buffers, bodyLength, &block)) {
+        return false;
+    }
+    m_batches.append(block);
+    resetBuilders();
+    return true;
+}
+
+bool ArrowIpcExportWriter::writeMessage(const QByteArray& metadata, const QVector<const QByteArray*>& bodyBuffers,
+                                        qint64 bodyLength, Block* block)
+{
+    static const char zeros[8] = {};
+    const qint64 start = m_sink.position();
+    const qint32 metadataSize = qint32(metadata.size() + padding8(metadata.size()));
+
+    QByteArray prefix;
+    appendLittleEndian<quint32>(prefix, 0xFFFFFFFFu); // Marcador de continuación
+    appendLittleEndian<qint32>(prefix, metadataSize);
+    if (!m_sink.write(prefix) || !m_sink.write(metadata)
+        || !m_sink.write(zeros, padding8(metadata.size()))) {
+        return false;
+    }
+    for (const QByteArray* buffer : bodyBuffers) {
+        if (!m_sink.write(*buffer) || !m_sink.write(zeros, padding8(buffer->size()))) {
+            return false;
+        }
+    }
+    if (block) {
+        block->offset = start;
+        block->metadataLength = 8 + metadataSize;
+        block->bodyLength = bodyLength;
+    }
+    return true;
+}
+
+bool ArrowIpcExportWriter::finish()
+{
+    if (!flushBatch()) {
+        return false;
+    }
+    // Fin del flujo
+    QByteArray endOfStream;
+    appendLittleEndian<quint32>(endOfStream, 0xFFFFFFFFu);
+    appendLittleEndian<qint32>(endOfStream, 0);
+    if (!m_sink.write(endOfStream)) {
+        return false;
+    }
+
+    // Pie: esquema repetido y posición de cada lote, para leer el archivo con acceso aleatorio
+    FlatBufferBuilder builder;
+    QByteArray blocks;
+    for (const Block& block : m_batches) {
+        appendLittleEndian<qint64>(blocks, block.offset);
+        appendLittleEndian<qint32>(blocks, block.metadataLength);
+        appendLittleEndian<qint32>(blocks, 0); // Relleno del struct
+        appendLittleEndian<qint64>(blocks, block.bodyLength);
+    }
+    const quint32 schema = buildSchema(builder, m_columns);
+    const quint32 dictionaries = builder.createStructVector(QByteArray(), 0, 8);
+    const quint32 recordBatches = builder.createStructVector(blocks, int(m_batches.size()), 8);
+    builder.startTable(5);
+    builder.addOffset(1, schema);
+    builder.addOffset(2, dictionaries);
+    builder.addOffset(3, recordBatches);
+    builder.addScalar<qint16>(0, kMetadataVersionV5);
+    const QByteArray footer = builder.finish(builder.endTable());
+
+    QByteArray trailer;
+    appendLittleEndian<qint32>(trailer, qint32(footer.size()));
+    trailer.append(kMagic, 6);
+    return m_sink.write(footer) && m_sink.write(trailer);
+}
@@ -0,0 +1,51 @@
+#ifndef ARROWIPCWRITER_H
+#define ARROWIPCWRITER_H
+
+#include "exportwriter.h"
+
+// Formato de archivo Arrow IPC (el de Feather v2, extensión .arrow), escrito sin depender de la
+// biblioteca de Arrow: los metadatos son FlatBuffers pequeños que se construyen a mano.
+// Las filas se acumulan por columnas en lotes de 'batchRows' (memoria constante) y cada lote se
+// escribe como un RecordBatch. Los datos quedan en disco en el mismo formato que usan pyarrow,
+// pandas, polars, R o DuckDB en memoria: se cargan (o se mapean) sin analizar texto.
+// Tipos: IntegerColumn -> int64, RealColumn -> float64, TextColumn -> utf8, DateColumn -> date32,
+// DateTimeColumn -> timestamp[ms] sin zona horaria (hora de pared, como está guardada).
+class ArrowIpcExportWriter : public ExportWriter
+{
+public:
+    static const int kDefaultBatchRows = 65536;
+
+    explicit ArrowIpcExportWriter(ExportSink& sink, int batchRows = kDefaultBatchRows);
+
+    bool begin(const QVector<Column>& columns) override;
+    bool writeRow(const QVector<QVariant>& values) override;
+    bool finish() override;
+
+private:
+    struct ColumnBuilder {
+        QByteArray validity; // Un bit por fila (1 = hay valor)
+        QByteArray offsets;  // Solo texto: int32 por fila + 1
+        QByteArray values;
+        qint64 nullCount = 0;
+    };
+
+    // Posición de cada mensaje en el archivo (para el pie)
+    struct Block {
+        qint64 offset;
+        qint32 metadataLength;
+        qint64 bodyLength;
+    };
+
+    void resetBuilders();
+    bool flushBatch();
+    // Mensaje encapsulado: marcador, longitud, metadatos alineados a 8 bytes y cuerpo
+    bool writeMessage(const QByteArray& metadata, const QVector<const QByteArray*>& bodyBuffers,
+                      qint64 bodyLength, Block* block);
+
+    int m_batchRows;
+    int m_rows;
+    QVector<ColumnBuilder> m_builders;
+    QVector<Block> m_batches;
+};
+
+#endif // ARROWIPCWRITER_H
@@ -0,0 +1,1220 @@
+#include "bulkimporter.h"
+#include "collationkey.h"
+#include "datachangehub.h"
+#include "metrickernels.h"
+#include "metricrollups.h"
+#include "textnormalizer.h"
+#include "usermanager.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariantList>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const qint64 kChunkBytes = 1 << 20; // Lo que analiza un hilo de una vez
+const int kMaxBindValues = 999;     // Parámetros por sentencia (límite de SQLite anterior a 3.32)
+const int kMaxExternalIdLength = 100;
+const double kMinWeightKg = 2.0;
+const double kMaxWeightKg = 400.0;
+const double kMinHeightCm = 40.0;
+const double kMaxHeightCm = 250.0;
+
+// Fin del registro que empieza en 'pos': primer salto de línea fuera de comillas (o 'end')
+qint64 recordEnd(const char* data, qint64 pos, qint64 end)
+{
+    bool quoted = false;
+    for (; pos < end; ++pos) {
+        const char c = data[pos];
+        if (c == '"') {
+            quoted = !quoted; // "" dentro de comillas cambia dos veces: no altera el estado
+        } else if (c == '\n' && !quoted) {
+            return pos;
+        }
+    }
+    return end;
+}
+
+// Campos de [begin, end) con comillas RFC 4180 ("a;""b"";c")
+void splitFields(const char* data, qint64 begin, qint64 end, char separator, QVector<QByteArray>& fields)
+{
+    fields.clear();
+    qint64 i = begin;
+    while (true) {
+        QByteArray field;
+        if (i < end && data[i] == '"') {
+            for (++i; i < end; ++i) {
+                if (data[i] == '"') {
+                    if (i + 1 < end && data[i + 1] == '"') {
+                        field.append('"');
+                        ++i;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                field.append(data[i]);
+            }
+        }
+        const qint64 start = i;
+        while (i < end && data[i] != separator) {
+            ++i;
+        }
+        field.append(data + start, i - start);
+        fields.append(field);
+        if (i >= end) {
+            break;
+        }
+        ++i; // Separador
+    }
+}
+
+// Fila vacía: solo espacios y separadores (Excel exporta las filas en blanco como ";;;;")
+bool isBlank(const char* data, qint64 begin, qint64 end, char separator)
+{
+    for (qint64 i = begin; i < end; ++i) {
+        const char c = data[i];
+        if (c != separator && c != ' ' && c != '\t') {
+            return false;
+        }
+    }
+    return true;
+}
+
+char detectSeparator(const QByteArray& headerLine)
+{
+    char best = ',';
+    qsizetype bestCount = 0;
+    for (const char candidate : { ';', '\t', ',' }) {
+        const qsizetype count = headerLine.count(candidate);
+        if (count > bestCount) {
+            best = candidate;
+            bestCount = count;
+        }
+    }
+    return best;
+}
+
+QString fieldText(const QByteArray& field)
+{
+    return QString::fromUtf8(field).trimmed();
+}
+
+// Número con punto o coma decimal. Campo vacío: NaN. false si hay texto que no es un número.
+bool parseNumber(QByteArray field, double& value)
+{
+    field = field.trimmed();
+    if (field.isEmpty()) {
+        value = std::numeric_limits<double>::quiet_NaN();
+        return true;
+    }
+    field.replace(',', '.');
+    bool ok = false;
+    value = field.toDouble(&ok);
+    return ok && std::isfinite(value);
+}
+
+// "2024-03-15", "2024-03-15 08:30" (la hora de la báscula se descarta), "15/03/2024", "15-03-24", "15.03.2024"
+QDate parseDate(const QByteArray& field, const QDate& today)
+{
+    QByteArray text = field.trimmed();
+    const qsizetype timeStart = text.indexOf(text.size() > 10 && text.at(10) == 'T' ? 'T' : ' ');
+    if (timeStart > 0) {
+        text.truncate(timeStart);
+    }
+    QList<QByteArray> parts;
+    for (const char separator : { '-', '/', '.' }) {
+        if (text.count(separator) == 2) {
+            parts = text.split(separator);
+            break;
+        }
+    }
+    if (parts.size() != 3) {
+        return QDate();
+    }
+    bool okFirst = false;
+    bool okSecond = false;
+    bool okThird = false;
+    const int first = parts[0].toInt(&okFirst);
+    const int second = parts[1].toInt(&okSecond);
+    int third = parts[2].toInt(&okThird);
+    if (!okFirst || !okSecond || !okThird) {
+        return QDate();
+    }
+    if (parts[0].size() == 4) {
+        return QDate(first, second, third); // Año, mes, día
+    }
+    if (parts[2].size() == 2) {
+        third += third <= today.year() % 100 ? 2000 : 1900;
+    } else if (parts[2].size() != 4) {
+        return QDate();
+    }
+    return QDate(third, second, first); // Día, mes, año
+}
+
+// Sin dato: "Sedentario", el factor más bajo al estimar el gasto energético
+QString normalizeActivityLevel(const QString& value)
+{
+    const QString folded = TextNormalizer::fold(value);
+    if (folded.isEmpty() || folded.startsWith("sedent")) {
+        return "Sedentario";
+    }
+    if (folded.startsWith("lig") || folded.startsWith("lev")) {
+        return "Ligero";
+    }
+    if (folded.startsWith("mod")) {
+        return "Moderado";
+    }
+    if (folded.startsWith("muy")) {
+        return "Muy Activo";
+    }
+    if (folded.startsWith("act")) {
+        return "Activo";
+    }
+    return QString();
+}
+
+QString normalizeGoal(const QString& value)
+{
+    const QString folded = TextNormalizer::fold(value);
+    if (folded.isEmpty() || folded.contains("salud")) {
+        return "Mejorar salud";
+    }
+    if (folded.startsWith("perd") || folded.startsWith("adelg")) {
+        return "Perder peso";
+    }
+    if (folded.startsWith("mant")) {
+        return "Mantener peso";
+    }
+    if (folded.startsWith("gan") || folded.contains("musc")) {
+        return "Ganar musculo";
+    }
+    return "Otro";
+}
+
+QByteArray quoted(const QByteArray& text)
+{
+    QByteArray out;
+    out.reserve(text.size() + 2);
+    out.append('"');
+    for (const char c : text) {
+        if (c == '"') {
+            out.append('"');
+        }
+        out.append(c);
+    }
+    out.append('"');
+    return out;
+}
+
+// INSERT de varias filas por sentencia ('values' lleva columns.size() valores por fila): cada
+// sentencia sustituye a cientos de ejecuciones sueltas. Las dos formas preparadas (tanda completa
+// y resto) se reutilizan mientras no cambie el número de filas.
+bool insertRows(const QSqlDatabase& db, const QString& table, const QStringList& columns, const QVariantList& values,
+                QString* error)
+{
+    const int columnCount = columns.size();
+    const int rowsPerStatement = kMaxBindValues / columnCount;
+    const qsizetype rowCount = values.size() / columnCount;
+    const QString rowPlaceholders = "(" + QStringList(columnCount, QString("?")).join(", ") + ")";
+
+    QSqlQuery query(db);
+    int preparedRows = 0;
+    for (qsizetype first = 0; first < rowCount; first += rowsPerStatement) {
+        const int rows = int(qMin<qsizetype>(rowsPerStatement, rowCount - first));
+        if (rows != preparedRows) {
+            const QString sql = QString("INSERT INTO %1 (%2) VALUES %3")
+                                    .arg(table, columns.join(", "), QStringList(rows, rowPlaceholders).join(", "));
+            if (!query.prepare(sql)) {
+                *error = QString("Error al preparar la inserción en '%1': %2").arg(table, query.lastError().text());
+                return false;
+            }
+            preparedRows = rows;
+        }
+        const qsizetype offset = first * columnCount;
+        for (int i = 0; i < rows * columnCount; ++i) {
+            query.bindValue(i, values.at(offset + i));
+        }
+        if (!query.exec()) {
+            *error = QString("Error al insertar en '%1': %2").arg(table, query.lastError().text());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Siguiente user_id libre, o -1 si hay un error. Los pacientes se insertan con ID explícito para
+// enlazar sus IDs externos en la misma tanda sin releerlos. Se llama con la transacción ya
+// escribiendo (SQLite la bloquea para los demás escritores), así que nadie puede ocupar el ID.
+int nextUserId(const QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+    if (!query.exec("SELECT MAX(user_id) FROM users") || !query.next()) {
+        return -1;
+    }
+    qint64 last = query.value(0).toLongLong();
+    // SQLite con AUTOINCREMENT no reutiliza los IDs de pacientes borrados
+    if (db.driverName() == "QSQLITE"
+        && query.exec("SELECT seq FROM sqlite_sequence WHERE name = 'users'") && query.next()) {
+        last = qMax(last, query.value(0).toLongLong());
+    }
+    return int(last + 1);
+}
+
+const int kMaxQueuedWaves = 2; // Tandas analizadas que esperan al escritor; limita la memoria si la base va lenta
+
+} // namespace
+
+struct BulkImporter::WriterState {
+    QString connectionName;
+    QHash<QString, int> externalIds; // Copia propia: la del importador se actualiza con cada tanda guardada
+    QHash<int, double> lastHeight;   // Altura más reciente por paciente
+    QFile rejects;
+    int fileIndex = -1;
+    qint64 imported = 0;             // Totales del archivo en curso
+    qint64 rejected = 0;
+    bool failed = false;             // Tras un error se descartan las tandas que quedan en la cola
+};
+
+BulkImporter* BulkImporter::instance()
+{
+    static BulkImporter importer;
+    return &importer;
+}
+
+BulkImporter::BulkImporter(QObject *parent)
+    : QObject(parent)
+    , m_writerContext(nullptr)
+    , m_writer(nullptr)
+    , m_fileIndex(0)
+    , m_running(false)
+    , m_cancelled(false)
+    , m_parseInFlight(false)
+    , m_writesPending(0)
+    , m_lastWaveQueued(false)
+    , m_data(nullptr)
+    , m_size(0)
+    , m_scanOffset(0)
+    , m_scanRow(0)
+{
+    connect(DataChangeHub::instance(), &DataChangeHub::userDeleted, this, &BulkImporter::onUserDeleted);
+}
+
+BulkImporter::~BulkImporter()
+{
+    // Al salir con una importación en marcha: el escritor descarta lo que tenga en cola
+    m_cancelFlag.storeRelaxed(1);
+    m_pool.waitForDone();
+    stopWriter();
+    closeCurrentFile();
+}
+
+QString BulkImporter::rejectsPathFor(const QString& filePath)
+{
+    const QFileInfo info(filePath);
+    return info.dir().filePath(info.completeBaseName() + ".rechazos.csv");
+}
+
+bool BulkImporter::start(const Options& options, QString* error)
+{
+    auto fail = [error](const QString& message) {
+        qWarning() << "Importación masiva:" << message;
+        if (error) {
+            *error = message;
+        }
+        return false;
+    };
+    if (m_running) {
+        return fail("Ya hay una importación en curso.");
+    }
+    if (options.source.trimmed().isEmpty()) {
+        return fail("Falta el origen (clínica) de los IDs de paciente.");
+    }
+    if (options.patientsFile.isEmpty() && options.metricsFile.isEmpty()) {
+        return fail("No hay archivos que importar.");
+    }
+
+    m_options = options;
+    m_options.source = options.source.trimmed();
+    m_results.clear();
+    const QList<QPair<Kind, QString>> files = { { Patients, options.patientsFile }, { HealthMetrics, options.metricsFile } };
+    for (const auto& file : files) {
+        if (file.second.isEmpty()) {
+            continue;
+        }
+        FileResult result;
+        result.kind = file.first;
+        result.filePath = QFileInfo(file.second).absoluteFilePath();
+        result.rejectsPath = rejectsPathFor(result.filePath);
+        m_results.append(result);
+    }
+    m_fileIndex = 0;
+    m_error.clear();
+    m_cancelled = false;
+    m_cancelFlag.storeRelaxed(0);
+    m_parseInFlight = false;
+    m_writesPending = 0;
+    m_touchedUsers.clear();
+
+    QString loadError;
+    if (!loadExternalIds(&loadError) || !startWriter(&loadError)) {
+        return fail(loadError);
+    }
+
+    m_running = true;
+    m_timer.start();
+    qInfo() << "Importación masiva de" << m_options.source << "con" << m_pool.maxThreadCount() << "hilos;"
+            << m_externalIds.size() << "pacientes ya enlazados.";
+    startNextFile();
+    return true;
+}
+
+void BulkImporter::cancel()
+{
+    if (!m_running) {
+        return;
+    }
+    m_cancelled = true;
+    m_cancelFlag.storeRelaxed(1);
+    pump(); // Termina en cuanto no quede nada en vuelo
+}
+
+bool BulkImporter::loadExternalIds(QString* error)
+{
+    m_externalIds.clear();
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.prepare("SELECT external_id, user_id FROM patient_external_ids WHERE source = :source");
+    query.bindValue(":source", m_options.source);
+    if (!query.exec()) {
+        *error = "Error al leer los IDs externos: " + query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        m_externalIds.insert(query.value(0).toString(), query.value(1).toInt());
+    }
+    return true;
+}
+
+bool BulkImporter::startWriter(QString* error)
+{
+    static QAtomicInteger<quint32> counter;
+    m_writer = new WriterState;
+    m_writer->connectionName = QString("bulk_import_%1").arg(counter.fetchAndAddRelaxed(1));
+    m_writer->externalIds = m_externalIds;
+    m_writerContext = new QObject;
+    m_writerContext->moveToThread(&m_writerThread);
+    m_writerThread.start();
+
+    // La conexión se abre en el hilo que la va a usar
+    WriterState* writer = m_writer;
+    QString openError;
+    QMetaObject::invokeMethod(m_writerContext, [writer, &openError]() {
+        QSqlDatabase db = QSqlDatabase::cloneDatabase(QString(QSqlDatabase::defaultConnection), writer->connectionName);
+        if (!db.open()) {
+            openError = "No se pudo abrir la conexión de escritura: " + db.lastError().text();
+        }
+    }, Qt::BlockingQueuedConnection);
+    if (!openError.isEmpty()) {
+        stopWriter();
+        *error = openError;
+        return false;
+    }
+    return true;
+}
+
+void BulkImporter::stopWriter()
+{
+    if (!m_writer) {
+        return;
+    }
+    WriterState* writer = m_writer;
+    QMetaObject::invokeMethod(m_writerContext, [writer]() {
+        writer->rejects.close();
+        QSqlDatabase::database(writer->connectionName, false).close();
+    }, Qt::BlockingQueuedConnection);
+    m_writerThread.quit();
+    m_writerThread.wait();
+    QSqlDatabase::removeDatabase(writer->connectionName);
+    delete m_writerContext;
+    m_writerContext = nullptr;
+    delete m_writer;
+    m_writer = nullptr;
+}
+
+bool BulkImporter::resolveColumns(Kind kind, const QStringList& header, QVector<int>& columns, QString* error)
+{
+    // Cabeceras normalizadas (TextNormalizer::fold + words), en orden de preferencia
+    static const char* const aliases[FieldCount] = {
+        "id paciente|id_paciente|paciente id|patient_id|patient id|external_id|id externo|nhc|historia clinica"
+        "|n historia|historia|codigo paciente|codigo|paciente|id",
+        "nombre|first_name|first name|name",
+        "apellido 1|apellido1|primer apellido|last_name1|apellidos|apellido|last_name|last name|surname",
+        "apellido 2|apellido2|segundo apellido|last_name2",
+        "genero|sexo|gender|sex",
+        "fecha de nacimiento|fecha nacimiento|fecha_nacimiento|nacimiento|birth_date|birth date|birthdate|dob",
+        "nivel de actividad|nivel actividad|actividad|activity_level|activity level|activity",
+        "objetivo|goal",
+        "fecha|fecha medicion|fecha de medicion|fecha hora|date|datetime|timestamp",
+        "peso|peso kg|weight|weight kg",
+        "altura|altura cm|talla|talla cm|estatura|height|height cm",
+        "grasa|grasa corporal|porcentaje grasa|porcentaje de grasa|body_fat|body fat|body_fat_percentage|fat",
+        "musculo|masa muscular|porcentaje musculo|porcentaje de musculo|muscle|muscle_mass|muscle mass"
+        "|muscle_mass_percentage",
+        "notas|observaciones|comentarios|notes"
+    };
+    static const char* const labels[FieldCount] = {
+        "ID de paciente", "nombre", "primer apellido", "segundo apellido", "género", "fecha de nacimiento",
+        "nivel de actividad", "objetivo", "fecha", "peso", "altura", "% de grasa", "% de músculo", "notas"
+    };
+    const QVector<Field> required = kind == Patients
+        ? QVector<Field>{ ExternalIdField, FirstNameField, LastName1Field, GenderField, BirthDateField }
+        : QVector<Field>{ ExternalIdField, DateField, WeightField };
+
+    columns.fill(-1, FieldCount);
+    for (int field = 0; field < FieldCount; ++field) {
+        for (const QString& name : QString::fromLatin1(aliases[field]).split('|')) {
+            const int column = int(header.indexOf(name));
+            if (column >= 0) {
+                columns[field] = column;
+                break;
+            }
+        }
+    }
+    QStringList missing;
+    for (const Field field : required) {
+        if (columns[field] < 0) {
+            missing << QString::fromUtf8(labels[field]);
+        }
+    }
+    if (!missing.isEmpty()) {
+        *error = "Faltan columnas: " + missing.join(", ");
+        return false;
+    }
+    return true;
+}
+
+// Una pasada por el trozo sirve para los dos estados posibles al empezar: dentro de comillas, un
+// salto de línea está fuera de ellas si la paridad de las comillas anteriores es impar
+BulkImporter::QuoteScan BulkImporter::scanQuotes(const char* data, const Chunk& chunk)
+{
+    QuoteScan scan;
+    // Salto de línea justo antes del trozo: el primer registro empieza en su primer byte
+    if (chunk.begin > 0 && data[chunk.begin - 1] == '\n') {
+        scan.firstNewline[0] = chunk.begin - 1;
+    }
+    int parity = 0;
+    for (qint64 pos = chunk.begin; pos < chunk.end; ++pos) {
+        const char c = data[pos];
+        if (c == '"') {
+            parity ^= 1;
+        } else if (c == '\n' && scan.firstNewline[parity] < 0) {
+            scan.firstNewline[parity] = pos;
+        }
+    }
+    scan.oddQuotes = parity != 0;
+    return scan;
+}
+
+BulkImporter::ChunkResult BulkImporter::parseChunk(const ParseContext& context, const Chunk& chunk)
+{
+    ChunkResult result;
+    const char* data = context.data;
+    QVector<QByteArray> fields;
+    auto field = [&](Field f) {
+        const int column = context.columns.at(f);
+        return column >= 0 && column < fields.size() ? fields.at(column) : QByteArray();
+    };
+
+    qint64 row = 0; // Relativa al trozo
+    qint64 pos = chunk.begin;
+    for (; pos < chunk.end; ++row) {
+        const qint64 begin = pos;
+        const qint64 newline = recordEnd(data, pos, context.size);
+        const qint64 end = (newline > begin && data[newline - 1] == '\r') ? newline - 1 : newline;
+        pos = newline + 1;
+        if (isBlank(data, begin, end, context.separator)) {
+            continue;
+        }
+        splitFields(data, begin, end, context.separator, fields);
+
+        QString reason;
+        if (context.kind == Patients) {
+            PatientRow patient;
+            patient.row = row;
+            patient.externalId = fieldText(field(ExternalIdField));
+            patient.firstName = fieldText(field(FirstNameField));
+            patient.lastName1 = fieldText(field(LastName1Field));
+            patient.lastName2 = fieldText(field(LastName2Field));
+            patient.gender = User::normalizeGender(fieldText(field(GenderField)));
+            patient.birthDate = parseDate(field(BirthDateField), context.today);
+            patient.activityLevel = normalizeActivityLevel(fieldText(field(ActivityLevelField)));
+            patient.goal = normalizeGoal(fieldText(field(GoalField)));
+
+            if (patient.externalId.isEmpty()) {
+                reason = "Falta el ID del paciente";
+            } else if (patient.externalId.size() > kMaxExternalIdLength) {
+                reason = "ID del paciente demasiado largo";
+            } else if (patient.firstName.isEmpty()) {
+                reason = "Falta el nombre";
+            } else if (patient.lastName1.isEmpty()) {
+                reason = "Falta el primer apellido";
+            } else if (patient.gender.isEmpty()) {
+                reason = QString("Género no reconocido: '%1'").arg(fieldText(field(GenderField)));
+            } else if (!patient.birthDate.isValid()) {
+                reason = "Fecha de nacimiento no válida";
+            } else if (patient.birthDate > context.today || patient.birthDate.year() < context.today.year() - 120) {
+                reason = "Fecha de nacimiento fuera de rango";
+            } else if (patient.activityLevel.isEmpty()) {
+                reason = QString("Nivel de actividad no reconocido: '%1'").arg(fieldText(field(ActivityLevelField)));
+            } else {
+                patient.record = QByteArray(data + begin, end - begin);
+                result.patients.append(patient);
+            }
+        } else {
+            MetricRow metric;
+            metric.row = row;
+            const QString externalId = fieldText(field(ExternalIdField));
+            metric.userId = context.externalIds.value(externalId, -1);
+            metric.date = parseDate(field(DateField), context.today);
+            metric.notes = fieldText(field(NotesField));
+            double weight = 0.0;
+            double height = 0.0;
+            double bodyFat = 0.0;
+            double muscleMass = 0.0;
+            const bool numeric = parseNumber(field(WeightField), weight) && parseNumber(field(HeightField), height)
+                                 && parseNumber(field(BodyFatField), bodyFat)
+                                 && parseNumber(field(MuscleMassField), muscleMass);
+            if (height == 0.0) {
+                height = std::numeric_limits<double>::quiet_NaN(); // "0": sin medir
+            } else if (height < 3.0) {
+                height *= 100.0; // En metros
+            }
+
+            if (externalId.isEmpty()) {
+                reason = "Falta el ID del paciente";
+            } else if (metric.userId < 0) {
+                reason = QString("Paciente desconocido: '%1'").arg(externalId);
+            } else if (!metric.date.isValid()) {
+                reason = "Fecha no válida";
+            } else if (metric.date > context.today || metric.date.year() < 1900) {
+                reason = "Fecha fuera de rango";
+            } else if (!numeric) {
+                reason = "Valor numérico no válido";
+            } else if (std::isnan(weight)) {
+                reason = "Falta el peso";
+            } else if (weight < kMinWeightKg || weight > kMaxWeightKg) {
+                reason = QString("Peso fuera de rango: %1 kg").arg(weight);
+            } else if (!std::isnan(height) && (height < kMinHeightCm || height > kMaxHeightCm)) {
+                reason = QString("Altura fuera de rango: %1 cm").arg(height);
+            } else if (!std::isnan(bodyFat) && (bodyFat < 0.0 || bodyFat > 80.0)) {
+                reason = QString("Porcentaje de grasa fuera de rango: %1").arg(bodyFat);
+            } else if (!std::isnan(muscleMass) && (muscleMass < 0.0 || muscleMass > 100.0)) {
+                reason = QString("Porcentaje de músculo fuera de rango: %1").arg(muscleMass);
+            } else {
+                metric.weight = weight;
+                metric.height = std::isnan(height) ? 0.0 : height;
+                metric.bodyFatPercentage = std::isnan(bodyFat) ? 0.0 : bodyFat;
+                metric.muscleMassPercentage = std::isnan(muscleMass) ? 0.0 : muscleMass;
+                result.metrics.append(metric);
+            }
+        }
+        if (!reason.isEmpty()) {
+            Reject reject;
+            reject.row = row;
+            reject.reason = reason;
+            reject.record = QByteArray(data + begin, end - begin);
+            result.rejects.append(reject);
+        }
+    }
+    result.records = row;
+    result.next = qMin(pos, context.size);
+    return result;
+}
+
+void BulkImporter::startNextFile()
+{
+    while (!m_cancelled && m_fileIndex < m_results.size()) {
+        QString error;
+        if (!openCurrentFile(&error)) {
+            m_error = error;
+            break;
+        }
+        if (!m_results.at(m_fileIndex).alreadyImported) {
+            m_lastWaveQueued = false;
+            pump();
+            return; // Continúa en onWaveWritten al guardarse la última tanda del archivo
+        }
+        closeCurrentFile();
+        ++m_fileIndex;
+    }
+    finish();
+}
+
+bool BulkImporter::openCurrentFile(QString* error)
+{
+    FileResult& result = m_results[m_fileIndex];
+    m_file.setFileName(result.filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        *error = QString("No se pudo abrir %1: %2").arg(result.filePath, m_file.errorString());
+        return false;
+    }
+    m_size = m_file.size();
+    m_modified = QFileInfo(m_file).lastModified().toString(Qt::ISODate);
+    if (m_size == 0) {
+        *error = QString("%1 está vacío.").arg(result.filePath);
+        return false;
+    }
+    // Todo el archivo mapeado: los hilos leen de la caché de páginas del sistema, sin copias
+    uchar* map = m_file.map(0, m_size);
+    if (!map) {
+        *error = QString("No se pudo mapear %1 en memoria: %2").arg(result.filePath, m_file.errorString());
+        return false;
+    }
+    m_data = reinterpret_cast<const char*>(map);
+
+    // Cabecera (con o sin la marca BOM que añade Excel)
+    const qint64 headerStart = (m_size >= 3 && std::memcmp(m_data, "\xEF\xBB\xBF", 3) == 0) ? 3 : 0;
+    const qint64 headerEnd = recordEnd(m_data, headerStart, m_size);
+    QByteArray headerLine(m_data + headerStart, headerEnd - headerStart);
+    if (headerLine.endsWith('\r')) {
+        headerLine.chop(1);
+    }
+    m_context = ParseContext();
+    m_context.kind = result.kind;
+    m_context.data = m_data;
+    m_context.size = m_size;
+    m_context.separator = detectSeparator(headerLine);
+    m_context.today = QDate::currentDate();
+    if (result.kind == HealthMetrics) {
+        m_context.externalIds = m_externalIds; // Ya incluye los pacientes importados antes
+    }
+    QVector<QByteArray> fields;
+    splitFields(headerLine.constData(), 0, headerLine.size(), m_context.separator, fields);
+    QStringList header;
+    for (const QByteArray& field : fields) {
+        header << TextNormalizer::words(TextNormalizer::fold(QString::fromUtf8(field))).join(' ');
+    }
+    if (!resolveColumns(result.kind, header, m_context.columns, error)) {
+        *error = QString("%1: %2").arg(result.filePath, *error);
+        return false;
+    }
+    m_scanOffset = qMin(headerEnd + 1, m_size);
+    m_scanRow = 2;
+
+    // Punto de control de una ejecución anterior: vale si el archivo no ha cambiado
+    QSqlQuery query;
+    query.prepare("SELECT source, file_size, file_modified, next_offset, next_row, rows_imported, rows_rejected, completed "
+                  "FROM import_checkpoints WHERE file_path = :file_path AND kind = :kind");
+    query.bindValue(":file_path", result.filePath);
+    query.bindValue(":kind", int(result.kind));
+    if (!query.exec()) {
+        *error = "Error al leer el punto de control de la importación: " + query.lastError().text();
+        return false;
+    }
+    if (query.next() && query.value(0).toString() == m_options.source && query.value(1).toLongLong() == m_size
+        && query.value(2).toString() == m_modified) {
+        result.imported = query.value(5).toLongLong();
+        result.rejected = query.value(6).toLongLong();
+        if (query.value(7).toInt() != 0) {
+            result.alreadyImported = true;
+            qInfo() << result.filePath << "ya se importó completo; no se vuelve a leer.";
+            return true;
+        }
+        m_scanOffset = qBound(m_scanOffset, query.value(3).toLongLong(), m_size);
+        m_scanRow = query.value(4).toLongLong();
+        result.resumed = true;
+        qInfo() << "Reanudando la importación de" << result.filePath << "en la fila" << m_scanRow;
+    } else {
+        QFile::remove(result.rejectsPath); // Rechazos de una importación anterior de otro contenido
+    }
+    return true;
+}
+
+void BulkImporter::pump()
+{
+    if (m_cancelled || !m_error.isEmpty()) {
+        if (!m_parseInFlight && m_writesPending == 0) {
+            finish();
+        }
+        return;
+    }
+    // Los hilos analizan la tanda siguiente mientras el escritor guarda las anteriores
+    if (m_parseInFlight || m_lastWaveQueued || m_writesPending >= kMaxQueuedWaves) {
+        return;
+    }
+    launchWave();
+}
+
+void BulkImporter::launchWave()
+{
+    if (m_scanOffset >= m_size) {
+        // Sin filas tras la cabecera (o tras el punto de control): la tanda vacía completa el archivo
+        submitWave(QList<ChunkResult>());
+        return;
+    }
+    // Unos pocos trozos por hilo: la memoria de una tanda no depende del tamaño del archivo. Se
+    // cortan por bytes; los límites de registro los buscan los propios hilos.
+    const int chunksPerWave = qMax(4, 2 * m_pool.maxThreadCount());
+    QVector<Chunk> chunks;
+    for (qint64 begin = m_scanOffset; chunks.size() < chunksPerWave && begin < m_size; begin += kChunkBytes) {
+        Chunk chunk;
+        chunk.begin = begin;
+        chunk.end = qMin(begin + kChunkBytes, m_size);
+        chunks.append(chunk);
+    }
+
+    m_parseInFlight = true;
+    auto* watcher = new QFutureWatcher<QuoteScan>(this);
+    connect(watcher, &QFutureWatcher<QuoteScan>::finished, this, [this, watcher, chunks]() {
+        const QList<QuoteScan> scans = watcher->future().results(); // En el orden del archivo
+        watcher->deleteLater();
+        onWaveScanned(chunks, scans);
+    });
+    const char* data = m_data;
+    watcher->setFuture(QtConcurrent::mapped(&m_pool, chunks, [data](const Chunk& chunk) {
+        return scanQuotes(data, chunk);
+    }));
+}
+
+void BulkImporter::onWaveScanned(const QVector<Chunk>& chunks, const QList<QuoteScan>& scans)
+{
+    if (m_cancelled || !m_error.isEmpty()) {
+        m_parseInFlight = false;
+        pump();
+        return;
+    }
+    // El primer trozo empieza en un límite de registro y fuera de comillas; la paridad de cada trozo
+    // dice en qué estado empieza el siguiente y, con él, dónde está su primer registro
+    QVector<Chunk> parts;
+    bool quotedState = false;
+    for (int i = 0; i < chunks.size(); ++i) {
+        qint64 begin = chunks.at(i).begin;
+        if (i > 0) {
+            const qint64 newline = scans.at(i).firstNewline[quotedState ? 1 : 0];
+            begin = newline < 0 ? chunks.at(i).end : newline + 1;
+        }
+        quotedState = quotedState != scans.at(i).oddQuotes;
+        if (begin >= chunks.at(i).end) {
+            continue; // Ningún registro empieza en este trozo: lo lee el anterior
+        }
+        if (!parts.isEmpty()) {
+            parts.last().end = begin;
+        }
+        Chunk part;
+        part.begin = begin;
+        part.end = chunks.last().end; // El último lee hasta acabar el registro que empieza antes de aquí
+        parts.append(part);
+    }
+
+    auto* watcher = new QFutureWatcher<ChunkResult>(this);
+    connect(watcher, &QFutureWatcher<ChunkResult>::finished, this, [this, watcher]() {
+        const QList<ChunkResult> results = watcher->future().results();
+        watcher->deleteLater();
+        onWaveParsed(results);
+    });
+    const ParseContext context = m_context;
+    watcher->setFuture(QtConcurrent::mapped(&m_pool, parts, [context](const Chunk& chunk) {
+        return parseChunk(context, chunk);
+    }));
+}
+
+void BulkImporter::onWaveParsed(const QList<ChunkResult>& results)
+{
+    m_parseInFlight = false;
+    if (!m_cancelled && m_error.isEmpty()) {
+        submitWave(results);
+    }
+    pump(); // Si se canceló, la tanda se descarta: el punto de control no ha avanzado
+}
+
+void BulkImporter::submitWave(const QList<ChunkResult>& results)
+{
+    const FileResult& result = m_results.at(m_fileIndex);
+    Wave wave;
+    wave.fileIndex = m_fileIndex;
+    wave.kind = result.kind;
+    wave.filePath = result.filePath;
+    wave.rejectsPath = result.rejectsPath;
+    wave.source = m_options.source;
+    wave.fileSize = m_size;
+    wave.modified = m_modified;
+    wave.separator = m_context.separator;
+    wave.importedBefore = result.imported;
+    wave.rejectedBefore = result.rejected;
+    wave.firstRow = m_scanRow;
+    wave.endOffset = results.isEmpty() ? m_scanOffset : results.last().next;
+    wave.endRow = m_scanRow;
+    for (const ChunkResult& chunk : results) {
+        wave.endRow += chunk.records;
+    }
+    wave.last = wave.endOffset >= m_size;
+    wave.results = results;
+
+    m_scanOffset = wave.endOffset;
+    m_scanRow = wave.endRow;
+    m_lastWaveQueued = wave.last;
+    ++m_writesPending;
+    // Cola del hilo de escritura: las tandas se guardan en el orden en que se envían
+    WriterState* writer = m_writer;
+    QMetaObject::invokeMethod(m_writerContext, [this, writer, wave]() mutable {
+        const WaveWritten written = writeWave(*writer, wave, m_cancelFlag);
+        QMetaObject::invokeMethod(this, [this, written]() { onWaveWritten(written); }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+void BulkImporter::onWaveWritten(const WaveWritten& written)
+{
+    --m_writesPending;
+    if (!written.ok) {
+        if (!written.error.isEmpty() && m_error.isEmpty()) {
+            qCritical() << "Importación masiva detenida:" << written.error;
+            m_error = written.error;
+        }
+        pump();
+        return;
+    }
+
+    FileResult& result = m_results[written.fileIndex];
+    result.imported = written.imported;
+    result.rejected = written.rejected;
+    m_touchedUsers.unite(written.users);
+    m_externalIds.insert(written.newExternalIds); // El archivo de mediciones se abre con ellos
+    emit progress(result.kind, written.endOffset, written.fileSize, result.imported, result.rejected);
+
+    if (written.last) {
+        qInfo() << "Importado" << result.filePath << ":" << result.imported << "filas," << result.rejected << "rechazadas.";
+        closeCurrentFile();
+        ++m_fileIndex;
+        startNextFile();
+        return;
+    }
+    pump();
+}
+
+// Hilo de escritura. El punto de control va en la misma transacción que las filas: una tanda se
+// guarda entera o no se guarda.
+BulkImporter::WaveWritten BulkImporter::writeWave(WriterState& writer, Wave& wave, const QAtomicInt& cancelled)
+{
+    WaveWritten written;
+    written.fileIndex = wave.fileIndex;
+    written.endOffset = wave.endOffset;
+    written.fileSize = wave.fileSize;
+    written.last = wave.last;
+    if (writer.failed || cancelled.loadRelaxed() != 0) {
+        return written;
+    }
+    if (writer.fileIndex != wave.fileIndex) {
+        writer.rejects.close();
+        writer.fileIndex = wave.fileIndex;
+        writer.imported = wave.importedBefore;
+        writer.rejected = wave.rejectedBefore;
+    }
+    // Filas absolutas: cada hilo numeró las suyas desde 0
+    qint64 base = wave.firstRow;
+    for (ChunkResult& result : wave.results) {
+        for (PatientRow& patient : result.patients) {
+            patient.row += base;
+        }
+        for (MetricRow& metric : result.metrics) {
+            metric.row += base;
+        }
+        for (Reject& reject : result.rejects) {
+            reject.row += base;
+        }
+        base += result.records;
+    }
+
+    QSqlDatabase db = QSqlDatabase::database(writer.connectionName);
+    QVector<Reject> rejects;
+    qint64 imported = 0;
+    QString error;
+    bool ok = db.transaction();
+    if (!ok) {
+        error = "No se pudo iniciar la transacción: " + db.lastError().text();
+    }
+    ok = ok && (wave.kind == Patients ? writePatients(writer, wave, rejects, imported, written, &error)
+                                      : writeMetrics(writer, wave, rejects, imported, written, &error));
+    ok = ok && saveCheckpoint(writer, wave, writer.imported + imported, writer.rejected + rejects.size(), &error);
+    // Rechazos antes del commit: si este falla, al reanudar se repiten en el archivo, pero no se pierden
+    if (ok && !writeRejects(writer, wave, rejects)) {
+        error = QString("No se pudo escribir %1: %2").arg(wave.rejectsPath, writer.rejects.errorString());
+        ok = false;
+    }
+    if (ok && !db.commit()) {
+        error = "Error al confirmar la tanda: " + db.lastError().text();
+        ok = false;
+    }
+    if (!ok) {
+        db.rollback();
+        writer.failed = true;
+        written.error = error;
+        written.users.clear();
+        written.newExternalIds.clear();
+        return written;
+    }
+
+    writer.imported += imported;
+    writer.rejected += rejects.size();
+    written.ok = true;
+    written.imported = writer.imported;
+    written.rejected = writer.rejected;
+    return written;
+}
+
+bool BulkImporter::writePatients(WriterState& writer, const Wave& wave, QVector<Reject>& rejects, qint64& imported,
+                                 WaveWritten& written, QString* error)
+{
+    QVector<const PatientRow*> patients;
+    QSet<QString> inWave;
+    for (const ChunkResult& result : wave.results) {
+        rejects += result.rejects;
+        for (const PatientRow& patient : result.patients) {
+            const int existing = writer.externalIds.value(patient.externalId, -1);
+            if (existing > 0 || inWave.contains(patient.externalId)) {
+                Reject reject;
+                reject.row = patient.row;
+                reject.reason = existing > 0 ? QString("El ID externo ya está importado (paciente %1)").arg(existing)
+                                             : QString("El ID externo está repetido en el archivo");
+                reject.record = patient.record;
+                rejects.append(reject);
+                continue;
+            }
+            inWave.insert(patient.externalId);
+            patients.append(&patient);
+        }
+    }
+    if (patients.isEmpty()) {
+        return true;
+    }
+
+    // Primero el contador: la transacción pasa a escribir antes de calcular los IDs. Dentro de ella,
+    // además, la instantánea de arranque no puede quedar vigente con pacientes a medias.
+    const QSqlDatabase db = QSqlDatabase::database(writer.connectionName);
+    if (!UserManager().bumpUsersChangeCounter(db)) {
+        *error = "No se pudo actualizar el contador de cambios de usuarios.";
+        return false;
+    }
+    int userId = nextUserId(db);
+    if (userId < 0) {
+        *error = "No se pudo obtener el siguiente ID de paciente.";
+        return false;
+    }
+    QVariantList userValues;
+    QVariantList idValues;
+    for (const PatientRow* patient : std::as_const(patients)) {
+        userValues << userId << patient->firstName << patient->lastName1 << patient->lastName2 << patient->gender
+                   << patient->birthDate.toString(Qt::ISODate) << patient->activityLevel << patient->goal
+                   << CollationKey::forUserName(patient->firstName, patient->lastName1, patient->lastName2);
+        idValues << wave.source << patient->externalId << userId;
+        written.newExternalIds.insert(patient->externalId, userId);
+        written.users.insert(userId);
+        ++userId;
+    }
+    if (!insertRows(db, "users", { "user_id", "first_name", "last_name1", "last_name2", "gender", "birth_date",
+                                   "activity_level", "goal", "sort_key" }, userValues, error)
+        || !insertRows(db, "patient_external_ids", { "source", "external_id", "user_id" }, idValues, error)) {
+        return false;
+    }
+    writer.externalIds.insert(written.newExternalIds);
+    imported = patients.size();
+    return true;
+}
+
+bool BulkImporter::writeMetrics(WriterState& writer, const Wave& wave, QVector<Reject>& rejects, qint64& imported,
+                                WaveWritten& written, QString* error)
+{
+    QVector<MetricRow> metrics;
+    for (const ChunkResult& result : wave.results) {
+        rejects += result.rejects;
+        metrics += result.metrics;
+    }
+    // Orden (user_id, date): las filas de cada paciente caen juntas al final de su tramo del índice
+    // idx_health_metrics_user_date y la altura que falta se arrastra de la medición anterior
+    std::sort(metrics.begin(), metrics.end(), [](const MetricRow& a, const MetricRow& b) {
+        if (a.userId != b.userId) {
+            return a.userId < b.userId;
+        }
+        return a.date != b.date ? a.date < b.date : a.row < b.row;
+    });
+
+    // Alturas resueltas primero para calcular el IMC de toda la tanda de una vez con MetricKernels
+    QVector<double> weights(metrics.size());
+    QVector<double> heights(metrics.size());
+    QVector<double> bmis(metrics.size());
+    for (qsizetype i = 0; i < metrics.size(); ++i) {
+        const MetricRow& metric = metrics.at(i);
+        double height = metric.height;
+        if (height > 0.0) {
+            writer.lastHeight.insert(metric.userId, height);
+        } else {
+            height = latestHeight(writer, metric.userId); // Las básculas no suelen registrar la altura
+        }
+        weights[i] = metric.weight;
+        heights[i] = height;
+    }
+    MetricKernels::bmiBatch(weights.constData(), heights.constData(), bmis.data(), std::size_t(metrics.size()));
+
+    const QDateTime now = QDateTime::currentDateTime();
+    QVariantList values;
+    values.reserve(metrics.size() * 9);
+    for (qsizetype i = 0; i < metrics.size(); ++i) {
+        const MetricRow& metric = metrics.at(i);
+        values << metric.userId << metric.date.toString(Qt::ISODate) << metric.weight << heights.at(i) << bmis.at(i)
+               << metric.bodyFatPercentage << metric.muscleMassPercentage << now << metric.notes;
+        written.users.insert(metric.userId);
+    }
+    imported = metrics.size();
+    if (imported == 0) {
+        return true;
+    }
+    const QSqlDatabase db = QSqlDatabase::database(writer.connectionName);
+    if (!insertRows(db, "health_metrics",
+                    { "user_id", "date", "weight", "height", "bmi", "body_fat_percentage", "muscle_mass_percentage",
+                      "created_at", "notes" }, values, error)) {
+        return false;
+    }
+    // Resúmenes de los pacientes de la tanda en la misma transacción: solo los periodos entre su
+    // primera y su última fecha nuevas (las filas vienen ordenadas por paciente y fecha)
+    for (qsizetype first = 0; first < metrics.size();) {
+        qsizetype last = first;
+        while (last + 1 < metrics.size() && metrics[last + 1].userId == metrics[first].userId) {
+            ++last;
+        }
+        if (!MetricRollups::refreshRange(metrics[first].userId, metrics[first].date, metrics[last].date, db)) {
+            *error = QString("No se pudieron actualizar los resúmenes de métricas del paciente %1").arg(metrics[first].userId);
+            return false;
+        }
+        first = last + 1;
+    }
+    return true;
+}
+
+bool BulkImporter::saveCheckpoint(WriterState& writer, const Wave& wave, qint64 imported, qint64 rejected, QString* error)
+{
+    QSqlQuery query(QSqlDatabase::database(writer.connectionName));
+    query.prepare("REPLACE INTO import_checkpoints (file_path, kind, source, file_size, file_modified, next_offset, "
+                  "next_row, rows_imported, rows_rejected, completed, updated_at) "
+                  "VALUES (:file_path, :kind, :source, :file_size, :file_modified, :next_offset, "
+                  ":next_row, :rows_imported, :rows_rejected, :completed, :updated_at)");
+    query.bindValue(":file_path", wave.filePath);
+    query.bindValue(":kind", int(wave.kind));
+    query.bindValue(":source", wave.source);
+    query.bindValue(":file_size", wave.fileSize);
+    query.bindValue(":file_modified", wave.modified);
+    query.bindValue(":next_offset", wave.endOffset);
+    query.bindValue(":next_row", wave.endRow);
+    query.bindValue(":rows_imported", imported);
+    query.bindValue(":rows_rejected", rejected);
+    query.bindValue(":completed", wave.last ? 1 : 0);
+    query.bindValue(":updated_at", QDateTime::currentDateTime().toString(Qt::ISODate));
+    if (!query.exec()) {
+        *error = "Error al guardar el punto de control de la importación: " + query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool BulkImporter::writeRejects(WriterState& writer, const Wave& wave, QVector<Reject>& rejects)
+{
+    if (rejects.isEmpty()) {
+        return true;
+    }
+    std::sort(rejects.begin(), rejects.end(), [](const Reject& a, const Reject& b) { return a.row < b.row; });
+    const char separator = wave.separator;
+    QByteArray out;
+    if (!writer.rejects.isOpen()) {
+        writer.rejects.setFileName(wave.rejectsPath);
+        const bool resuming = writer.rejects.exists(); // Solo queda de una ejecución interrumpida
+        if (!writer.rejects.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            return false;
+        }
+        if (!resuming) {
+            out += QByteArray("fila") + separator + "motivo" + separator + "registro\r\n";
+        }
+    }
+    for (const Reject& reject : std::as_const(rejects)) {
+        out += QByteArray::number(reject.row);
+        out += separator;
+        out += quoted(reject.reason.toUtf8());
+        out += separator;
+        out += quoted(reject.record);
+        out += "\r\n";
+    }
+    return writer.rejects.write(out) == out.size() && writer.rejects.flush();
+}
+
+// Altura más reciente guardada del paciente (0 si no hay ninguna)
+double BulkImporter::latestHeight(WriterState& writer, int userId)
+{
+    const auto it = writer.lastHeight.constFind(userId);
+    if (it != writer.lastHeight.constEnd()) {
+        return it.value();
+    }
+    QSqlQuery query(QSqlDatabase::database(writer.connectionName));
+    query.prepare("SELECT height FROM health_metrics WHERE user_id = :user_id AND height > 0 ORDER BY date DESC LIMIT 1");
+    query.bindValue(":user_id", userId);
+    const double height = (query.exec() && query.next()) ? query.value(0).toDouble() : 0.0;
+    writer.lastHeight.insert(userId, height);
+    return height;
+}
+
+void BulkImporter::closeCurrentFile()
+{
+    if (m_data) {
+        m_file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(m_data)));
+        m_data = nullptr;
+    }
+    m_file.close();
+    m_context = ParseContext();
+}
+
+void BulkImporter::finish()
+{
+    if (!m_running) {
+        return;
+    }
+    stopWriter();
+    closeCurrentFile();
+    if (!m_touchedUsers.isEmpty()) {
+        // Lo guardado se queda aunque se cancele o falle una tanda: las cachés se ponen al día igual.
+        // Los resúmenes de métricas ya se actualizaron en la transacción de cada tanda.
+        QList<int> users = m_touchedUsers.values();
+        std::sort(users.begin(), users.end());
+        emit DataChangeHub::instance()->bulkImportCompleted(users);
+    }
+    m_running = false;
+    const bool completed = !m_cancelled && m_error.isEmpty();
+    qInfo() << "Importación masiva" << (completed ? "terminada" : m_cancelled ? "cancelada" : "detenida")
+            << "en" << m_timer.elapsed() << "ms;" << m_touchedUsers.size() << "pacientes con datos nuevos.";
+    emit finished(completed, m_timer.elapsed());
+}
+
+void BulkImporter::onUserDeleted(int userId)
+{
+    QSqlQuery query;
+    query.prepare("DELETE FROM patient_external_ids WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al borrar los IDs externos del usuario" << userId << ":" << query.lastError().text();
+    }
+    m_externalIds.removeIf([userId](QHash<QString, int>::iterator it) { return it.value() == userId; });
+    if (m_writer) {
+        // La copia del hilo de escritura se actualiza en su cola, entre dos tandas
+        WriterState* writer = m_writer;
+        QMetaObject::invokeMethod(m_writerContext, [writer, userId]() {
+            writer->externalIds.removeIf([userId](QHash<QString, int>::iterator it) { return it.value() == userId; });
+            writer->lastHeight.remove(userId);
+        }, Qt::QueuedConnection);
+    }
+}
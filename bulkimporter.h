@@ -0,0 +1,261 @@
+#ifndef BULKIMPORTER_H
+#define BULKIMPORTER_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QDate>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+
+// Importación masiva de pacientes y mediciones (alta de una clínica nueva) desde CSV, también los
+// CSV que exporta Excel (';' y coma decimal). UserManager::addUser y addHealthMetric hacen una
+// transacción y varios avisos por fila; aquí el archivo se mapea en memoria y cada tanda se corta
+// en trozos de tamaño fijo sin recorrerla: los hilos del pool calculan en paralelo dónde empieza
+// el primer registro de cada trozo (primer salto de línea fuera de comillas) y después analizan y
+// validan cada trozo. Un hilo de escritura propio, con su conexión, es el único escritor: guarda
+// las tandas en orden con INSERT de varias filas en una transacción por tanda, mientras los hilos
+// ya analizan la siguiente. El hilo principal solo reparte el trabajo y recibe los resultados.
+//
+// Los pacientes se identifican por el ID de la clínica de origen (patient_external_ids), así que
+// las mediciones pueden venir en otro archivo. Cada transacción guarda también el punto de
+// control (import_checkpoints): si la importación se interrumpe, la siguiente con el mismo
+// archivo continúa tras la última tanda guardada. Las filas no válidas van a un archivo de
+// rechazos junto al original, con el número de fila y el motivo.
+class BulkImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Kind {
+        Patients,
+        HealthMetrics
+    };
+
+    struct Options {
+        QString source;       // Clínica o sistema de origen de los IDs externos
+        QString patientsFile; // Opcional; se importa antes que las mediciones
+        QString metricsFile;  // Opcional
+    };
+
+    struct FileResult {
+        Kind kind = Patients;
+        QString filePath;
+        QString rejectsPath;
+        qint64 imported = 0; // Incluye lo guardado en ejecuciones interrumpidas
+        qint64 rejected = 0;
+        bool resumed = false;
+        bool alreadyImported = false; // Completado en una ejecución anterior: no se vuelve a leer
+    };
+
+    static BulkImporter* instance();
+
+    bool start(const Options& options, QString* error = nullptr);
+    bool isRunning() const { return m_running; }
+    // Se descarta la tanda en curso; la importación se puede reanudar más tarde
+    void cancel();
+
+    QList<FileResult> results() const { return m_results; }
+    QString errorString() const { return m_error; }
+
+    // "<carpeta>/<nombre>.rechazos.csv"
+    static QString rejectsPathFor(const QString& filePath);
+
+signals:
+    void progress(BulkImporter::Kind kind, qint64 bytesDone, qint64 bytesTotal, qint64 imported, qint64 rejected);
+    // completed = false si se canceló o hubo un error (errorString())
+    void finished(bool completed, qint64 elapsedMs);
+
+private slots:
+    void onUserDeleted(int userId);
+
+private:
+    explicit BulkImporter(QObject *parent = nullptr);
+    ~BulkImporter() override;
+
+    enum Field {
+        ExternalIdField,
+        FirstNameField,
+        LastName1Field,
+        LastName2Field,
+        GenderField,
+        BirthDateField,
+        ActivityLevelField,
+        GoalField,
+        DateField,
+        WeightField,
+        HeightField,
+        BodyFatField,
+        MuscleMassField,
+        NotesField,
+        FieldCount
+    };
+
+    // Trozo del archivo mapeado. Para analizarlo, 'begin' es un límite de registro y se leen los
+    // registros que empiezan antes de 'end' (el último puede acabar después).
+    struct Chunk {
+        qint64 begin = 0;
+        qint64 end = 0;
+    };
+
+    // Comillas de un trozo cortado por bytes, sin saber si empieza dentro de unas comillas:
+    // primer salto de línea que cerraría un registro en cada caso ([0] fuera, [1] dentro; -1 si no hay)
+    struct QuoteScan {
+        bool oddQuotes = false;
+        qint64 firstNewline[2] = { -1, -1 };
+    };
+
+    struct PatientRow {
+        qint64 row = 0;
+        QString externalId;
+        QString firstName;
+        QString lastName1;
+        QString lastName2;
+        QString gender;
+        QDate birthDate;
+        QString activityLevel;
+        QString goal;
+        QByteArray record; // Por si el ID externo resulta estar ya importado
+    };
+
+    struct MetricRow {
+        qint64 row = 0;
+        int userId = -1;
+        QDate date;
+        double weight = 0.0;
+        double height = 0.0; // 0 = sin dato: se usa la última conocida del paciente
+        double bodyFatPercentage = 0.0;
+        double muscleMassPercentage = 0.0;
+        QString notes;
+    };
+
+    struct Reject {
+        qint64 row = 0;
+        QString reason;
+        QByteArray record; // Registro original, sin el salto de línea
+    };
+
+    // Los números de fila son relativos al trozo; el escritor les suma la fila de su primer registro
+    struct ChunkResult {
+        QVector<PatientRow> patients;
+        QVector<MetricRow> metrics;
+        QVector<Reject> rejects;
+        qint64 records = 0; // Registros leídos (también los vacíos y los rechazados)
+        qint64 next = 0;    // Posición tras el último registro
+    };
+
+    // Lo que necesita un hilo para analizar un trozo; no toca la base de datos
+    struct ParseContext {
+        Kind kind = Patients;
+        const char* data = nullptr;
+        qint64 size = 0;
+        char separator = ',';
+        QVector<int> columns;            // Field -> columna del archivo (-1 si no está)
+        QHash<QString, int> externalIds; // Solo mediciones: ID externo -> user_id
+        QDate today;
+    };
+
+    // Una tanda analizada, con lo que necesita el hilo de escritura para guardarla sin tocar el importador
+    struct Wave {
+        int fileIndex = 0;
+        Kind kind = Patients;
+        QString filePath;
+        QString rejectsPath;
+        QString source;
+        qint64 fileSize = 0;
+        QString modified;
+        char separator = ',';
+        qint64 importedBefore = 0; // Totales del punto de control al abrir el archivo
+        qint64 rejectedBefore = 0;
+        qint64 firstRow = 0;       // Fila del primer registro de la tanda (la cabecera es la 1)
+        qint64 endOffset = 0;      // Punto de control tras guardarla
+        qint64 endRow = 0;
+        bool last = false;         // Última tanda del archivo: el punto de control queda completado
+        QList<ChunkResult> results;
+    };
+
+    // Resultado de guardar una tanda; ok = false sin error si se descartó (cancelación o fallo anterior)
+    struct WaveWritten {
+        int fileIndex = 0;
+        bool ok = false;
+        QString error;
+        qint64 imported = 0; // Totales del archivo, incluidas las ejecuciones anteriores
+        qint64 rejected = 0;
+        qint64 endOffset = 0;
+        qint64 fileSize = 0;
+        bool last = false;
+        QSet<int> users;                      // Pacientes con datos nuevos
+        QHash<QString, int> newExternalIds;   // Pacientes dados de alta en la tanda
+    };
+
+    // Estado del hilo de escritura (definido en bulkimporter.cpp); solo lo toca ese hilo
+    struct WriterState;
+
+    static bool resolveColumns(Kind kind, const QStringList& header, QVector<int>& columns, QString* error);
+    static QuoteScan scanQuotes(const char* data, const Chunk& chunk);
+    static ChunkResult parseChunk(const ParseContext& context, const Chunk& chunk);
+
+    bool loadExternalIds(QString* error);
+    bool startWriter(QString* error);
+    void stopWriter();
+    void startNextFile();
+    bool openCurrentFile(QString* error);
+    // Lanza la siguiente tanda si hay hilos libres y el escritor no va retrasado; termina si toca
+    void pump();
+    void launchWave();
+    void onWaveScanned(const QVector<Chunk>& chunks, const QList<QuoteScan>& scans);
+    void onWaveParsed(const QList<ChunkResult>& results);
+    void submitWave(const QList<ChunkResult>& results);
+    void onWaveWritten(const WaveWritten& written);
+
+    // Hilo de escritura: una tanda por transacción en su propia conexión
+    static WaveWritten writeWave(WriterState& writer, Wave& wave, const QAtomicInt& cancelled);
+    static bool writePatients(WriterState& writer, const Wave& wave, QVector<Reject>& rejects, qint64& imported,
+                              WaveWritten& written, QString* error);
+    static bool writeMetrics(WriterState& writer, const Wave& wave, QVector<Reject>& rejects, qint64& imported,
+                             WaveWritten& written, QString* error);
+    static bool saveCheckpoint(WriterState& writer, const Wave& wave, qint64 imported, qint64 rejected, QString* error);
+    static bool writeRejects(WriterState& writer, const Wave& wave, QVector<Reject>& rejects);
+    static double latestHeight(WriterState& writer, int userId);
+
+    void closeCurrentFile();
+    void finish();
+
+    QThreadPool m_pool;
+    QThread m_writerThread;
+    QObject* m_writerContext;  // Vive en m_writerThread: las tandas se le envían en orden
+    WriterState* m_writer;
+    QAtomicInt m_cancelFlag;   // Lo consulta el escritor antes de cada tanda
+    QElapsedTimer m_timer;
+    Options m_options;
+    QList<FileResult> m_results;
+    int m_fileIndex;
+    QString m_error;
+    bool m_running;
+    bool m_cancelled;
+    bool m_parseInFlight;
+    int m_writesPending;       // Tandas enviadas al escritor y aún sin guardar
+    bool m_lastWaveQueued;     // La última tanda del archivo en curso ya está en el escritor
+
+    // Archivo en curso
+    QFile m_file;
+    const char* m_data;
+    qint64 m_size;
+    QString m_modified;
+    ParseContext m_context;
+    qint64 m_scanOffset;
+    qint64 m_scanRow;
+
+    QHash<QString, int> m_externalIds; // De m_options.source
+    QSet<int> m_touchedUsers;          // Pacientes con datos nuevos (para el aviso final)
+};
+
+#endif // BULKIMPORTER_H
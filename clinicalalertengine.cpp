@@ -0,0 +1,528 @@
+#include "clinicalalertengine.h"
+#include "datachangehub.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTextStream>
+#include <QtEndian>
+
+namespace {
+
+// Columnas de health_metrics que necesita el evaluador (en el orden de sampleFromQuery)
+const char* const kSampleColumns = "metric_id, date, weight, bmi, body_fat_percentage, muscle_mass_percentage, lean_mass_kg";
+const int kWindowCacheSize = 2000; // Pacientes con ventana en memoria
+const int kDailyCheckIntervalMs = 60 * 60 * 1000;
+
+ClinicalRules::Sample sampleFromQuery(const QSqlQuery& query, int offset = 0)
+{
+    ClinicalRules::Sample sample;
+    sample.metricId = query.value(offset).toInt();
+    sample.date = QDate::fromString(query.value(offset + 1).toString(), Qt::ISODate);
+    sample.values[ClinicalRules::Weight] = query.value(offset + 2).toDouble();
+    sample.values[ClinicalRules::Bmi] = query.value(offset + 3).toDouble();
+    sample.values[ClinicalRules::BodyFat] = query.value(offset + 4).toDouble();
+    sample.values[ClinicalRules::MuscleMass] = query.value(offset + 5).toDouble();
+    sample.values[ClinicalRules::LeanMass] = query.value(offset + 6).toDouble();
+    return sample;
+}
+
+// Huella del texto de las reglas, estable entre ejecuciones (qHash lleva una semilla aleatoria por
+// proceso). Se guardan 31 bits: app_meta.value es INT en MariaDB.
+qint64 rulesHash(const QString& source)
+{
+    const QByteArray digest = QCryptographicHash::hash(source.toUtf8(), QCryptographicHash::Sha256);
+    return qint64(qFromBigEndian<quint32>(digest.constData()) & 0x7fffffff);
+}
+
+qint64 readMeta(const QString& name, qint64 fallback)
+{
+    QSqlQuery query;
+    query.prepare("SELECT value FROM app_meta WHERE name = :name");
+    query.bindValue(":name", name);
+    if (!query.exec() || !query.next()) {
+        return fallback;
+    }
+    return query.value(0).toLongLong();
+}
+
+bool writeMeta(const QString& name, qint64 value)
+{
+    QSqlQuery query;
+    query.prepare("REPLACE INTO app_meta (name, value) VALUES (:name, :value)");
+    query.bindValue(":name", name);
+    query.bindValue(":value", value);
+    if (!query.exec()) {
+        qCritical() << "Error al guardar" << name << "en app_meta:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+ClinicalAlertEngine* ClinicalAlertEngine::instance()
+{
+    static ClinicalAlertEngine engine;
+    return &engine;
+}
+
+ClinicalAlertEngine::ClinicalAlertEngine(QObject *parent)
+    : QObject(parent)
+    , m_windows(kWindowCacheSize)
+{
+    connect(DataChangeHub::instance(), &DataChangeHub::healthMetricAdded, this, &ClinicalAlertEngine::onHealthMetricAdded);
+    connect(DataChangeHub::instance(), &DataChangeHub::healthMetricUpdated, this, &ClinicalAlertEngine::onHealthMetricChanged);
+    connect(DataChangeHub::instance(), &DataChangeHub::healthMetricDeleted, this, &ClinicalAlertEngine::onHealthMetricChanged);
+    connect(DataChangeHub::instance(), &DataChangeHub::userDeleted, this, &ClinicalAlertEngine::onUserDeleted);
+    connect(DataChangeHub::instance(), &DataChangeHub::bulkImportCompleted, this, &ClinicalAlertEngine::onBulkImportCompleted);
+
+    m_dailyTimer.setInterval(kDailyCheckIntervalMs);
+    connect(&m_dailyTimer, &QTimer::timeout, this, &ClinicalAlertEngine::onDailyCheck);
+}
+
+bool ClinicalAlertEngine::initialize(const QString& rulesPath)
+{
+    m_rulesPath = rulesPath;
+    QString source = ClinicalRules::defaultRules();
+    QFile file(rulesPath);
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        source = QTextStream(&file).readAll();
+    }
+
+    QString error;
+    if (!compileAndStore(source, &error)) {
+        qWarning() << "Reglas de alerta no válidas en" << rulesPath << ":" << error << "- se usan las de defecto.";
+        compileAndStore(ClinicalRules::defaultRules(), nullptr);
+    }
+    m_initialized = true;
+
+    // Primera ejecución o reglas distintas a las de la última evaluación: una pasada completa
+    bool ok = true;
+    if (readMeta("clinical_rules_hash", -1) != rulesHash(m_source)) {
+        ok = rebuildAll();
+    }
+    onDailyCheck();
+    m_dailyTimer.start();
+    return ok;
+}
+
+bool ClinicalAlertEngine::setRules(const QString& source, QString* error)
+{
+    if (!compileAndStore(source, error)) {
+        return false;
+    }
+    if (!m_rulesPath.isEmpty()) {
+        QFile file(m_rulesPath);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+            QTextStream(&file) << source;
+        } else {
+            qWarning() << "No se pudieron guardar las reglas de alerta en" << m_rulesPath;
+        }
+    }
+    return !m_initialized || rebuildAll();
+}
+
+bool ClinicalAlertEngine::compileAndStore(const QString& source, QString* error)
+{
+    ClinicalRules::Plan plan;
+    if (!ClinicalRules::compile(source, plan, error)) {
+        return false;
+    }
+    m_plan = plan;
+    m_source = source;
+    m_windows.clear(); // La ventana necesaria depende de las reglas
+    return true;
+}
+
+bool ClinicalAlertEngine::loadWindow(int userId, PatientWindow& window)
+{
+    window.samples.clear();
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT %1 FROM health_metrics WHERE user_id = :user_id "
+                          "ORDER BY date DESC, created_at DESC").arg(kSampleColumns));
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al leer la ventana de alertas del usuario" << userId << ":" << query.lastError().text();
+        return false;
+    }
+    // De la más reciente hacia atrás, solo hasta cubrir la ventana del plan
+    QDate from;
+    while (query.next()) {
+        const ClinicalRules::Sample sample = sampleFromQuery(query);
+        if (window.samples.isEmpty()) {
+            from = sample.date.addDays(-m_plan.maxWindowDays);
+        } else if (window.samples.size() >= 2 && sample.date < from) {
+            break;
+        }
+        window.samples.prepend(sample);
+    }
+    return true;
+}
+
+void ClinicalAlertEngine::trimWindow(PatientWindow& window) const
+{
+    if (window.samples.isEmpty()) {
+        return;
+    }
+    const QDate from = window.samples.last().date.addDays(-m_plan.maxWindowDays);
+    int drop = 0;
+    while (window.samples.size() - drop > 2 && window.samples[drop].date < from) {
+        ++drop;
+    }
+    window.samples.remove(0, drop);
+}
+
+int ClinicalAlertEngine::evaluatePatient(int userId, const PatientWindow& window, const QDate& asOf)
+{
+    const int latestMetricId = window.samples.isEmpty() ? -1 : window.samples.last().metricId;
+
+    // Alertas abiertas del paciente y las de cruce ya emitidas para la última medición (revisadas o no)
+    QHash<QString, int> existing;
+    QSqlQuery query;
+    query.prepare("SELECT alert_id, rule_id FROM clinical_alerts "
+                  "WHERE user_id = :user_id AND (active = 1 OR (edge = 1 AND metric_id = :metric_id))");
+    query.bindValue(":user_id", userId);
+    query.bindValue(":metric_id", latestMetricId);
+    if (!query.exec()) {
+        qCritical() << "Error al leer las alertas del usuario" << userId << ":" << query.lastError().text();
+        return -1;
+    }
+    while (query.next()) {
+        existing.insert(query.value(1).toString(), query.value(0).toInt());
+    }
+
+    const QVector<ClinicalRules::Result> results = ClinicalRules::evaluate(m_plan, window.samples, asOf);
+    int fired = 0;
+    for (int r = 0; r < m_plan.rules.size(); ++r) {
+        const ClinicalRules::Rule& rule = m_plan.rules[r];
+        const bool exists = existing.contains(rule.id);
+
+        if (results[r].fired && !exists) {
+            query.prepare("INSERT INTO clinical_alerts (user_id, rule_id, metric_id, edge, value, message) "
+                          "VALUES (:user_id, :rule_id, :metric_id, :edge, :value, :message)");
+            query.bindValue(":user_id", userId);
+            query.bindValue(":rule_id", rule.id);
+            query.bindValue(":metric_id", latestMetricId);
+            query.bindValue(":edge", rule.edge ? 1 : 0);
+            query.bindValue(":value", results[r].value);
+            query.bindValue(":message", QString("%1 (%2)").arg(rule.title, QString::number(results[r].value, 'f', 1)));
+            if (!query.exec()) {
+                qCritical() << "Error al guardar la alerta" << rule.id << "del usuario" << userId << ":" << query.lastError().text();
+                return -1;
+            }
+            ++fired;
+        } else if (!results[r].fired && exists && !rule.edge) {
+            // Las alertas de estado se cierran solas; las de cruce esperan a que alguien las revise
+            query.prepare("UPDATE clinical_alerts SET active = 0, resolved_at = CURRENT_TIMESTAMP "
+                          "WHERE alert_id = :alert_id AND active = 1");
+            query.bindValue(":alert_id", existing.value(rule.id));
+            if (!query.exec()) {
+                qCritical() << "Error al resolver la alerta" << rule.id << "del usuario" << userId << ":" << query.lastError().text();
+                return -1;
+            }
+        }
+    }
+    return fired;
+}
+
+bool ClinicalAlertEngine::saveLastVisit(int userId, const PatientWindow& window)
+{
+    QSqlQuery query;
+    if (window.samples.isEmpty()) {
+        query.prepare("DELETE FROM clinical_alert_state WHERE user_id = :user_id");
+        query.bindValue(":user_id", userId);
+    } else {
+        // REPLACE INTO lo admiten tanto SQLite como MariaDB
+        query.prepare("REPLACE INTO clinical_alert_state (user_id, last_date) VALUES (:user_id, :last_date)");
+        query.bindValue(":user_id", userId);
+        query.bindValue(":last_date", window.samples.last().date.toString(Qt::ISODate));
+    }
+    if (!query.exec()) {
+        qCritical() << "Error al guardar la última visita del usuario" << userId << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+QList<ClinicalAlertEngine::Alert> ClinicalAlertEngine::activeAlerts(int userId)
+{
+    QList<Alert> alerts;
+    QSqlQuery query;
+    QString sql = "SELECT alert_id, user_id, rule_id, metric_id, value, message, fired_at FROM clinical_alerts "
+                  "WHERE active = 1 AND acknowledged = 0";
+    if (userId > 0) {
+        sql += " AND user_id = :user_id";
+    }
+    query.prepare(sql + " ORDER BY fired_at DESC");
+    if (userId > 0) {
+        query.bindValue(":user_id", userId);
+    }
+    if (!query.exec()) {
+        qCritical() << "Error al leer las alertas activas:" << query.lastError().text();
+        return alerts;
+    }
+    while (query.next()) {
+        Alert alert;
+        alert.alertId = query.value(0).toInt();
+        alert.userId = query.value(1).toInt();
+        alert.ruleId = query.value(2).toString();
+        alert.metricId = query.value(3).isNull() ? -1 : query.value(3).toInt();
+        alert.value = query.value(4).toDouble();
+        alert.message = query.value(5).toString();
+        alert.firedAt = query.value(6).toDateTime();
+        alerts.append(alert);
+    }
+    return alerts;
+}
+
+bool ClinicalAlertEngine::acknowledge(int alertId)
+{
+    QSqlQuery query;
+    query.prepare("UPDATE clinical_alerts SET acknowledged = 1, "
+                  "active = CASE WHEN edge = 1 THEN 0 ELSE active END "
+                  "WHERE alert_id = :alert_id");
+    query.bindValue(":alert_id", alertId);
+    if (!query.exec()) {
+        qCritical() << "Error al marcar como revisada la alerta" << alertId << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+int ClinicalAlertEngine::evaluateTimeRules(const QDate& asOf)
+{
+    // Candidatos: pacientes cuya última visita ya supera el umbral y aún no tienen la alerta
+    QSet<int> candidates;
+    QSqlQuery query;
+    for (const ClinicalRules::Rule& rule : std::as_const(m_plan.rules)) {
+        if (!rule.timeBased) {
+            continue;
+        }
+        query.prepare("SELECT s.user_id FROM clinical_alert_state s "
+                      "WHERE s.last_date <= :cutoff AND NOT EXISTS ("
+                      "SELECT 1 FROM clinical_alerts a WHERE a.user_id = s.user_id "
+                      "AND a.rule_id = :rule_id AND a.active = 1)");
+        query.bindValue(":cutoff", asOf.addDays(-rule.minDaysSinceLast).toString(Qt::ISODate));
+        query.bindValue(":rule_id", rule.id);
+        if (!query.exec()) {
+            qCritical() << "Error al buscar pacientes para la regla" << rule.id << ":" << query.lastError().text();
+            return -1;
+        }
+        while (query.next()) {
+            candidates.insert(query.value(0).toInt());
+        }
+    }
+
+    int fired = 0;
+    for (int userId : std::as_const(candidates)) {
+        PatientWindow *window = m_windows.object(userId);
+        PatientWindow loaded;
+        if (!window) {
+            if (!loadWindow(userId, loaded)) {
+                return -1;
+            }
+            window = &loaded;
+        }
+        const int count = evaluatePatient(userId, *window, asOf);
+        if (count < 0) {
+            return -1;
+        }
+        fired += count;
+    }
+    m_lastTimeCheck = asOf;
+    if (!candidates.isEmpty()) {
+        qInfo() << "Reglas temporales:" << candidates.size() << "pacientes revisados," << fired << "alertas nuevas.";
+    }
+    return fired;
+}
+
+bool ClinicalAlertEngine::rebuildAll()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // 1. Una pasada ordenada por paciente conservando solo la ventana que pide el plan
+    QVector<QPair<int, PatientWindow>> patients;
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!query.exec(QString("SELECT user_id, %1 FROM health_metrics ORDER BY user_id, date, created_at").arg(kSampleColumns))) {
+        qCritical() << "Error al leer las métricas para las alertas:" << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        const int userId = query.value(0).toInt();
+        if (patients.isEmpty() || patients.last().first != userId) {
+            patients.append(qMakePair(userId, PatientWindow()));
+        }
+        PatientWindow& window = patients.last().second;
+        window.samples.append(sampleFromQuery(query, 1));
+        trimWindow(window);
+    }
+    query.finish();
+
+    // 2. Evaluación y estado en una transacción
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QStringList ruleIds;
+    for (const ClinicalRules::Rule& rule : std::as_const(m_plan.rules)) {
+        ruleIds << "'" + rule.id + "'"; // El lenguaje solo admite letras, números y '_' en los identificadores
+    }
+    const QString closeRemoved = ruleIds.isEmpty()
+                                     ? QString("UPDATE clinical_alerts SET active = 0, resolved_at = CURRENT_TIMESTAMP WHERE active = 1")
+                                     : QString("UPDATE clinical_alerts SET active = 0, resolved_at = CURRENT_TIMESTAMP "
+                                               "WHERE active = 1 AND rule_id NOT IN (%1)").arg(ruleIds.join(", "));
+    if (!query.exec(closeRemoved) || !query.exec("DELETE FROM clinical_alert_state")) {
+        qCritical() << "Error al preparar la reevaluación de alertas:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    const QDate today = QDate::currentDate();
+    int fired = 0;
+    for (const auto& patient : std::as_const(patients)) {
+        const int count = evaluatePatient(patient.first, patient.second, today);
+        if (count < 0 || !saveLastVisit(patient.first, patient.second)) {
+            db.rollback();
+            return false;
+        }
+        fired += count;
+    }
+    if (!writeMeta("clinical_rules_hash", rulesHash(m_source))) {
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar la reevaluación de alertas:" << db.lastError().text();
+        return false;
+    }
+
+    m_windows.clear();
+    m_lastTimeCheck = today;
+    qInfo() << "Alertas clínicas reevaluadas:" << patients.size() << "pacientes," << m_plan.rules.size() << "reglas,"
+            << fired << "alertas nuevas en" << timer.elapsed() << "ms";
+    return true;
+}
+
+void ClinicalAlertEngine::onHealthMetricAdded(int userId, int metricId)
+{
+    if (!m_initialized) {
+        return;
+    }
+    PatientWindow *window = m_windows.object(userId);
+    bool appended = false;
+    if (window && !window->samples.isEmpty()) {
+        QSqlQuery query;
+        query.prepare(QString("SELECT %1 FROM health_metrics WHERE metric_id = :metric_id").arg(kSampleColumns));
+        query.bindValue(":metric_id", metricId);
+        if (query.exec() && query.next()) {
+            const ClinicalRules::Sample sample = sampleFromQuery(query);
+            if (sample.date >= window->samples.last().date) {
+                window->samples.append(sample);
+                trimWindow(*window);
+                appended = true;
+            }
+        }
+    }
+    if (!appended) {
+        // Sin ventana en memoria o medición intercalada en el historial: se recarga este paciente
+        window = new PatientWindow;
+        if (!loadWindow(userId, *window)) {
+            delete window;
+            return;
+        }
+        m_windows.insert(userId, window);
+    }
+    saveLastVisit(userId, *window);
+    evaluatePatient(userId, *window, QDate::currentDate());
+}
+
+void ClinicalAlertEngine::onHealthMetricChanged(int userId, int metricId)
+{
+    if (!m_initialized || userId <= 0) {
+        return;
+    }
+    // Un cruce detectado en la medición modificada ya no es fiable: se retira y se vuelve a evaluar
+    QSqlQuery query;
+    query.prepare("DELETE FROM clinical_alerts WHERE metric_id = :metric_id AND edge = 1 AND acknowledged = 0");
+    query.bindValue(":metric_id", metricId);
+    if (!query.exec()) {
+        qCritical() << "Error al retirar las alertas de la métrica" << metricId << ":" << query.lastError().text();
+    }
+
+    PatientWindow *window = new PatientWindow;
+    if (!loadWindow(userId, *window)) {
+        delete window;
+        m_windows.remove(userId);
+        return;
+    }
+    m_windows.insert(userId, window);
+    saveLastVisit(userId, *window);
+    evaluatePatient(userId, *window, QDate::currentDate());
+}
+
+void ClinicalAlertEngine::onUserDeleted(int userId)
+{
+    m_windows.remove(userId);
+    QSqlQuery query;
+    query.prepare("DELETE FROM clinical_alerts WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al borrar las alertas del usuario" << userId << ":" << query.lastError().text();
+    }
+    query.prepare("DELETE FROM clinical_alert_state WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al borrar el estado de alertas del usuario" << userId << ":" << query.lastError().text();
+    }
+}
+
+// Importación masiva: se reevalúan solo los pacientes con datos nuevos, en una transacción,
+// en lugar de una vez por medición (la importación no emite healthMetricAdded)
+void ClinicalAlertEngine::onBulkImportCompleted(const QList<int>& userIds)
+{
+    if (!m_initialized || userIds.isEmpty()) {
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    const QDate today = QDate::currentDate();
+    int fired = 0;
+    for (int userId : userIds) {
+        m_windows.remove(userId);
+        PatientWindow window;
+        if (!loadWindow(userId, window)) {
+            db.rollback();
+            return;
+        }
+        const int count = evaluatePatient(userId, window, today);
+        if (count < 0 || !saveLastVisit(userId, window)) {
+            db.rollback();
+            return;
+        }
+        fired += count;
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar las alertas de la importación:" << db.lastError().text();
+        return;
+    }
+    qInfo() << "Alertas tras la importación:" << userIds.size() << "pacientes," << fired << "alertas nuevas en"
+            << timer.elapsed() << "ms";
+}
+
+void ClinicalAlertEngine::onDailyCheck()
+{
+    const QDate today = QDate::currentDate();
+    if (m_lastTimeCheck != today) {
+        evaluateTimeRules(today);
+    }
+}
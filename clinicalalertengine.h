@@ -0,0 +1,87 @@
+#ifndef CLINICALALERTENGINE_H
+#define CLINICALALERTENGINE_H
+
+#include <QCache>
+#include <QDate>
+#include <QDateTime>
+#include <QList>
+#include <QObject>
+#include <QTimer>
+#include "clinicalrules.h"
+
+// Alertas clínicas evaluadas de forma incremental (ver ClinicalRules para el lenguaje de reglas).
+// Escucha a DataChangeHub, es decir, el camino de escritura de HealthMetricManager:
+//  - medición nueva posterior a la última: se añade a la ventana en memoria del paciente y se evalúa;
+//  - medición intercalada, editada o borrada: se recarga solo la ventana de ese paciente
+//    (consulta acotada por idx_health_metrics_user_date).
+// Las reglas con days_since_last se comprueban una vez al día consultando 'clinical_alert_state'
+// por su índice de fecha, así que solo se tocan los pacientes que acaban de superar el umbral.
+// Las alertas se guardan en 'clinical_alerts'. Las de estado (p. ej. "pérdida > 5 %") se resuelven
+// solas cuando la condición deja de cumplirse; las de cruce ('crosses') quedan hasta que se revisan.
+class ClinicalAlertEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Alert {
+        int alertId = -1;
+        int userId = -1;
+        QString ruleId;
+        int metricId = -1;
+        double value = 0.0;
+        QString message;
+        QDateTime firedAt;
+    };
+
+    static ClinicalAlertEngine* instance();
+
+    // Carga las reglas de rulesPath (o las de defecto si no existe) y pone el motor en marcha.
+    // Si las reglas cambiaron desde la última ejecución se reevalúan todos los pacientes una vez.
+    bool initialize(const QString& rulesPath);
+
+    // Sustituye las reglas (y las guarda en el fichero). false si no compilan.
+    bool setRules(const QString& source, QString* error = nullptr);
+    QString rules() const { return m_source; }
+
+    // Alertas activas sin revisar (de un paciente, o de todos con userId = -1)
+    QList<Alert> activeAlerts(int userId = -1);
+    // Marca la alerta como revisada; las de cruce se cierran
+    bool acknowledge(int alertId);
+
+    // Reglas temporales a fecha asOf. Retorna el número de alertas nuevas o -1 si hay un error.
+    int evaluateTimeRules(const QDate& asOf = QDate::currentDate());
+    // Reevaluación completa (solo al cambiar las reglas o en la primera ejecución)
+    bool rebuildAll();
+
+private slots:
+    void onHealthMetricAdded(int userId, int metricId);
+    void onHealthMetricChanged(int userId, int metricId);
+    void onUserDeleted(int userId);
+    void onBulkImportCompleted(const QList<int>& userIds);
+    void onDailyCheck();
+
+private:
+    explicit ClinicalAlertEngine(QObject *parent = nullptr);
+
+    // Mediciones recientes de un paciente: las de los últimos maxWindowDays y al menos dos
+    struct PatientWindow {
+        QVector<ClinicalRules::Sample> samples;
+    };
+
+    bool loadWindow(int userId, PatientWindow& window);
+    void trimWindow(PatientWindow& window) const;
+    // Contrasta el resultado de las reglas con las alertas guardadas. Retorna las alertas nuevas o -1.
+    int evaluatePatient(int userId, const PatientWindow& window, const QDate& asOf);
+    bool saveLastVisit(int userId, const PatientWindow& window);
+    bool compileAndStore(const QString& source, QString* error);
+
+    ClinicalRules::Plan m_plan;
+    QString m_source;
+    QString m_rulesPath;
+    QCache<int, PatientWindow> m_windows;
+    QTimer m_dailyTimer;
+    QDate m_lastTimeCheck;
+    bool m_initialized = false;
+};
+
+#endif // CLINICALALERTENGINE_H
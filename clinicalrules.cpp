@@ -0,0 +1,392 @@
+#include "clinicalrules.h"
+#include <QStringList>
+#include <cmath>
+
+namespace {
+
+struct Token {
+    enum Kind { Identifier, Number, String, Symbol, End } kind = End;
+    QString text;
+    double number = 0.0;
+};
+
+// Separa una línea en tokens: identificadores, números (con signo), cadenas entre comillas y símbolos
+bool tokenize(const QString& line, QVector<Token>& tokens, QString& error)
+{
+    int i = 0;
+    const int n = int(line.size());
+    while (i < n) {
+        const QChar c = line[i];
+        if (c.isSpace()) {
+            ++i;
+        } else if (c == '#') {
+            break;
+        } else if (c.isLetter() || c == '_') {
+            Token token;
+            token.kind = Token::Identifier;
+            while (i < n && (line[i].isLetterOrNumber() || line[i] == '_')) {
+                token.text += line[i++].toLower();
+            }
+            tokens.append(token);
+        } else if (c.isDigit() || (c == '-' && i + 1 < n && line[i + 1].isDigit())) {
+            int start = i++;
+            while (i < n && (line[i].isDigit() || line[i] == '.')) {
+                ++i;
+            }
+            Token token;
+            token.kind = Token::Number;
+            token.text = line.mid(start, i - start);
+            bool ok = false;
+            token.number = token.text.toDouble(&ok);
+            if (!ok) {
+                error = QString("número no válido '%1'").arg(token.text);
+                return false;
+            }
+            tokens.append(token);
+        } else if (c == '"') {
+            const int end = int(line.indexOf('"', i + 1));
+            if (end < 0) {
+                error = "falta la comilla de cierre del título";
+                return false;
+            }
+            Token token;
+            token.kind = Token::String;
+            token.text = line.mid(i + 1, end - i - 1);
+            tokens.append(token);
+            i = end + 1;
+        } else if ((c == '<' || c == '>') && i + 1 < n && line[i + 1] == '=') {
+            Token token;
+            token.kind = Token::Symbol;
+            token.text = line.mid(i, 2);
+            tokens.append(token);
+            i += 2;
+        } else if (QString(":(),<>").contains(c)) {
+            Token token;
+            token.kind = Token::Symbol;
+            token.text = c;
+            tokens.append(token);
+            ++i;
+        } else {
+            error = QString("carácter inesperado '%1'").arg(c);
+            return false;
+        }
+    }
+    tokens.append(Token());
+    return true;
+}
+
+// Analizador descendente de una línea ya separada en tokens
+class LineParser
+{
+public:
+    explicit LineParser(const QVector<Token>& tokens) : m_tokens(tokens) {}
+
+    bool parseRule(ClinicalRules::Rule& rule, QString& error)
+    {
+        if (!expect(Token::Identifier, QString(), "se esperaba el identificador de la regla", error)) {
+            return false;
+        }
+        rule.id = previous().text;
+        if (!expect(Token::String, QString(), "se esperaba el título entre comillas", error)) {
+            return false;
+        }
+        rule.title = previous().text;
+        if (!expect(Token::Symbol, ":", "se esperaba ':'", error)) {
+            return false;
+        }
+        do {
+            ClinicalRules::Term term;
+            if (!parseTerm(term, error)) {
+                return false;
+            }
+            rule.terms.append(term);
+        } while (accept(Token::Identifier, "and"));
+
+        if (peek().kind != Token::End) {
+            error = QString("texto inesperado '%1'").arg(peek().text);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool parseTerm(ClinicalRules::Term& term, QString& error)
+    {
+        if (accept(Token::Identifier, "days_since_last")) {
+            term.kind = ClinicalRules::DaysSinceLast;
+            if (!parseComparison(term, error)) {
+                return false;
+            }
+            if (term.comparison != ClinicalRules::Greater && term.comparison != ClinicalRules::GreaterOrEqual) {
+                error = "days_since_last solo admite > o >=";
+                return false;
+            }
+            return true;
+        }
+        if (peek().kind == Token::Identifier && (peek().text == "change" || peek().text == "change_pct")) {
+            term.kind = (next().text == "change") ? ClinicalRules::Change : ClinicalRules::ChangePct;
+            if (!expect(Token::Symbol, "(", "se esperaba '('", error) || !parseField(term, error)
+                || !expect(Token::Symbol, ",", "se esperaba ','", error)
+                || !expect(Token::Number, QString(), "se esperaba el número de días", error)) {
+                return false;
+            }
+            term.windowDays = int(previous().number);
+            if (term.windowDays <= 0) {
+                error = "la ventana debe ser de al menos un día";
+                return false;
+            }
+            return expect(Token::Symbol, ")", "se esperaba ')'", error) && parseComparison(term, error);
+        }
+
+        if (!parseField(term, error)) {
+            return false;
+        }
+        if (accept(Token::Identifier, "crosses")) {
+            if (accept(Token::Identifier, "above")) {
+                term.kind = ClinicalRules::CrossesAbove;
+            } else if (accept(Token::Identifier, "below")) {
+                term.kind = ClinicalRules::CrossesBelow;
+            } else {
+                error = "se esperaba 'above' o 'below'";
+                return false;
+            }
+            if (!expect(Token::Number, QString(), "se esperaba el umbral", error)) {
+                return false;
+            }
+            term.threshold = previous().number;
+            return true;
+        }
+        term.kind = ClinicalRules::Value;
+        return parseComparison(term, error);
+    }
+
+    bool parseField(ClinicalRules::Term& term, QString& error)
+    {
+        if (peek().kind == Token::Identifier) {
+            for (int f = 0; f < ClinicalRules::FieldCount; ++f) {
+                if (peek().text == ClinicalRules::fieldName(ClinicalRules::Field(f))) {
+                    term.field = ClinicalRules::Field(f);
+                    next();
+                    return true;
+                }
+            }
+        }
+        error = QString("campo desconocido '%1'").arg(peek().text);
+        return false;
+    }
+
+    bool parseComparison(ClinicalRules::Term& term, QString& error)
+    {
+        static const QStringList operators = { "<", "<=", ">", ">=" };
+        const int index = int(operators.indexOf(peek().text));
+        if (peek().kind != Token::Symbol || index < 0) {
+            error = "se esperaba un operador de comparación";
+            return false;
+        }
+        next();
+        term.comparison = ClinicalRules::Comparison(index);
+        if (!expect(Token::Number, QString(), "se esperaba un número", error)) {
+            return false;
+        }
+        term.threshold = previous().number;
+        return true;
+    }
+
+    const Token& peek() const { return m_tokens[m_pos]; }
+    const Token& previous() const { return m_tokens[m_pos - 1]; }
+    const Token& next() { return m_tokens[m_pos++]; }
+
+    bool accept(Token::Kind kind, const QString& text)
+    {
+        if (peek().kind == kind && peek().text == text) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool expect(Token::Kind kind, const QString& text, const char* message, QString& error)
+    {
+        if (peek().kind == kind && (text.isEmpty() || peek().text == text)) {
+            ++m_pos;
+            return true;
+        }
+        error = message;
+        return false;
+    }
+
+    const QVector<Token>& m_tokens;
+    int m_pos = 0;
+};
+
+bool compare(double value, ClinicalRules::Comparison comparison, double threshold)
+{
+    switch (comparison) {
+    case ClinicalRules::Less: return value < threshold;
+    case ClinicalRules::LessOrEqual: return value <= threshold;
+    case ClinicalRules::Greater: return value > threshold;
+    case ClinicalRules::GreaterOrEqual: return value >= threshold;
+    }
+    return false;
+}
+
+} // namespace
+
+QString ClinicalRules::defaultRules()
+{
+    return QStringLiteral(
+        "# Reglas de alerta por defecto\n"
+        "imc_30          \"IMC cruza 30 (obesidad)\"           : bmi crosses above 30\n"
+        "imc_bajo        \"IMC por debajo de 18,5\"            : bmi crosses below 18.5\n"
+        "perdida_5_30d   \"Pérdida de más del 5 % en 30 días\" : change_pct(weight, 30) < -5\n"
+        "ganancia_5_30d  \"Ganancia de más del 5 % en 30 días\": change_pct(weight, 30) > 5\n"
+        "musculo_2kg_90d \"Pérdida de masa magra > 2 kg en 90 días\" : change(lean_mass, 90) < -2\n"
+        "sin_visita_60d  \"Sin visita en 60 días\"             : days_since_last > 60\n");
+}
+
+QString ClinicalRules::fieldName(Field field)
+{
+    switch (field) {
+    case Weight: return "weight";
+    case Bmi: return "bmi";
+    case BodyFat: return "body_fat";
+    case MuscleMass: return "muscle_mass";
+    case LeanMass: return "lean_mass";
+    case FieldCount: break;
+    }
+    return QString();
+}
+
+bool ClinicalRules::compile(const QString& source, Plan& plan, QString* error)
+{
+    Plan compiled;
+    QStringList seenIds;
+    const QStringList lines = source.split('\n');
+    for (int lineNumber = 0; lineNumber < lines.size(); ++lineNumber) {
+        QVector<Token> tokens;
+        QString message;
+        Rule rule;
+        bool ok = tokenize(lines[lineNumber], tokens, message);
+        if (ok && tokens.size() == 1) {
+            continue; // Línea vacía o comentario
+        }
+        ok = ok && LineParser(tokens).parseRule(rule, message);
+        if (ok && seenIds.contains(rule.id)) {
+            message = QString("identificador repetido '%1'").arg(rule.id);
+            ok = false;
+        }
+        if (!ok) {
+            if (error) {
+                *error = QString("Línea %1: %2").arg(lineNumber + 1).arg(message);
+            }
+            return false;
+        }
+        seenIds.append(rule.id);
+
+        // Plan: referencias de ventana compartidas y necesidades de historial de cada regla
+        for (Term& term : rule.terms) {
+            if (term.kind == Change || term.kind == ChangePct) {
+                for (int r = 0; r < compiled.references.size(); ++r) {
+                    const WindowReference& reference = compiled.references[r];
+                    if (reference.field == term.field && reference.windowDays == term.windowDays) {
+                        term.referenceIndex = r;
+                        break;
+                    }
+                }
+                if (term.referenceIndex < 0) {
+                    term.referenceIndex = int(compiled.references.size());
+                    compiled.references.append({ term.field, term.windowDays });
+                }
+                compiled.maxWindowDays = qMax(compiled.maxWindowDays, term.windowDays);
+            } else if (term.kind == CrossesAbove || term.kind == CrossesBelow) {
+                rule.edge = true;
+            } else if (term.kind == DaysSinceLast) {
+                rule.timeBased = true;
+                const int days = int(std::floor(term.threshold)) + (term.comparison == Greater ? 1 : 0);
+                rule.minDaysSinceLast = qMax(rule.minDaysSinceLast, days);
+            }
+        }
+        compiled.rules.append(rule);
+    }
+
+    plan = compiled;
+    return true;
+}
+
+QVector<ClinicalRules::Result> ClinicalRules::evaluate(const Plan& plan, const QVector<Sample>& window, const QDate& asOf)
+{
+    QVector<Result> results(plan.rules.size());
+    if (window.isEmpty()) {
+        return results;
+    }
+    const Sample& latest = window.last();
+
+    // 1. Referencias de ventana: una pasada por referencia, compartida por todas las reglas que la usan
+    QVector<double> references(plan.references.size(), 0.0);
+    for (int r = 0; r < plan.references.size(); ++r) {
+        const WindowReference& reference = plan.references[r];
+        const QDate from = latest.date.addDays(-reference.windowDays);
+        for (int i = 0; i + 1 < window.size(); ++i) {
+            if (window[i].date >= from && window[i].values[reference.field] > 0) {
+                references[r] = window[i].values[reference.field];
+                break;
+            }
+        }
+    }
+
+    // Medición anterior con dato, por campo (para 'crosses')
+    double previousValues[FieldCount] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    for (int f = 0; f < FieldCount; ++f) {
+        for (int i = int(window.size()) - 2; i >= 0; --i) {
+            if (window[i].values[f] > 0) {
+                previousValues[f] = window[i].values[f];
+                break;
+            }
+        }
+    }
+
+    // 2. Reglas: todos los términos deben cumplirse
+    for (int r = 0; r < plan.rules.size(); ++r) {
+        const Rule& rule = plan.rules[r];
+        bool fired = !rule.terms.isEmpty();
+        for (int t = 0; t < rule.terms.size() && fired; ++t) {
+            const Term& term = rule.terms[t];
+            const double current = latest.values[term.field];
+            double value = 0.0;
+            bool available = true;
+            switch (term.kind) {
+            case Value:
+                value = current;
+                available = current > 0;
+                fired = available && compare(value, term.comparison, term.threshold);
+                break;
+            case CrossesAbove:
+            case CrossesBelow: {
+                const double before = previousValues[term.field];
+                value = current;
+                available = current > 0 && before > 0;
+                fired = available && (term.kind == CrossesAbove ? (before < term.threshold && current >= term.threshold)
+                                                                 : (before > term.threshold && current <= term.threshold));
+                break;
+            }
+            case Change:
+            case ChangePct: {
+                const double reference = references[term.referenceIndex];
+                available = current > 0 && reference > 0;
+                value = !available ? 0.0 : (term.kind == Change ? current - reference : (current - reference) / reference * 100.0);
+                fired = available && compare(value, term.comparison, term.threshold);
+                break;
+            }
+            case DaysSinceLast:
+                value = latest.date.daysTo(asOf);
+                fired = compare(value, term.comparison, term.threshold);
+                break;
+            }
+            if (t == 0) {
+                results[r].value = value;
+            }
+        }
+        results[r].fired = fired;
+    }
+    return results;
+}
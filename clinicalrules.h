@@ -0,0 +1,112 @@
+#ifndef CLINICALRULES_H
+#define CLINICALRULES_H
+
+#include <QDate>
+#include <QString>
+#include <QVector>
+
+// Lenguaje de reglas de alertas clínicas. Una regla por línea ('#' inicia un comentario):
+//
+//     <id> "<título>" : <condición> [and <condición> ...]
+//
+// Condiciones admitidas (<campo> = weight | bmi | body_fat | muscle_mass | lean_mass):
+//     <campo> <op> <número>                        valor de la última medición
+//     <campo> crosses above|below <número>         la última medición cruza el umbral respecto a la anterior
+//     change(<campo>, <días>) <op> <número>        diferencia con la medición más antigua de la ventana
+//     change_pct(<campo>, <días>) <op> <número>    lo mismo en % de la medición más antigua
+//     days_since_last > | >= <número>              días desde la última medición (solo crece con el tiempo)
+// con <op> = < | <= | > | >=.
+//
+// Ejemplos:
+//     imc_30     "IMC cruza 30"              : bmi crosses above 30
+//     perdida_5  "Pérdida > 5 % en 30 días"  : change_pct(weight, 30) < -5
+//     sin_visita "Sin visita en 60 días"     : days_since_last > 60
+//
+// compile() convierte el texto en un plan de evaluación: las referencias de ventana (campo, días)
+// se deduplican entre reglas y se calculan una sola vez por evaluación, y el plan sabe qué
+// ventana de historial necesita cada paciente (maxWindowDays) para que el estado sea acotado.
+class ClinicalRules
+{
+public:
+    enum Field {
+        Weight,
+        Bmi,
+        BodyFat,
+        MuscleMass,
+        LeanMass,
+        FieldCount
+    };
+
+    enum Comparison {
+        Less,
+        LessOrEqual,
+        Greater,
+        GreaterOrEqual
+    };
+
+    enum TermKind {
+        Value,        // <campo> <op> <número>
+        CrossesAbove,
+        CrossesBelow,
+        Change,       // change(<campo>, <días>)
+        ChangePct,    // change_pct(<campo>, <días>)
+        DaysSinceLast
+    };
+
+    // Una medición tal como la ve el evaluador (0 = dato ausente)
+    struct Sample {
+        int metricId = -1;
+        QDate date;
+        double values[FieldCount] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    };
+
+    struct Term {
+        TermKind kind = Value;
+        Field field = Weight;
+        Comparison comparison = Greater;
+        double threshold = 0.0;
+        int windowDays = 0;
+        int referenceIndex = -1; // Índice en Plan::references (Change/ChangePct)
+    };
+
+    struct Rule {
+        QString id;
+        QString title;
+        QVector<Term> terms;     // Unidas por 'and'
+        bool edge = false;       // Contiene 'crosses': es un suceso ligado a una medición, no un estado
+        bool timeBased = false;  // Contiene days_since_last: puede cumplirse sin mediciones nuevas
+        int minDaysSinceLast = 0;
+    };
+
+    // Referencia de ventana compartida: la medición más antigua de 'field' en los últimos windowDays
+    struct WindowReference {
+        Field field = Weight;
+        int windowDays = 0;
+    };
+
+    struct Plan {
+        QVector<Rule> rules;
+        QVector<WindowReference> references;
+        int maxWindowDays = 0;   // Historial que hay que conservar por paciente
+        bool isEmpty() const { return rules.isEmpty(); }
+    };
+
+    struct Result {
+        bool fired = false;
+        double value = 0.0;      // Valor del primer término (para el mensaje)
+    };
+
+    // Reglas por defecto de la clínica
+    static QString defaultRules();
+
+    // Compila el texto. Si hay errores devuelve false y deja la línea y el motivo en 'error'.
+    static bool compile(const QString& source, Plan& plan, QString* error = nullptr);
+
+    // Evalúa todas las reglas del plan sobre la ventana del paciente (ordenada por fecha, la última
+    // medición al final) a fecha 'asOf'. results tiene una entrada por regla.
+    static QVector<Result> evaluate(const Plan& plan, const QVector<Sample>& window, const QDate& asOf);
+
+    static QString fieldName(Field field);
+};
+
+#endif // CLINICALRULES_H
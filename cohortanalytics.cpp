@@ -0,0 +1,221 @@
+#include "cohortanalytics.h"
+#include "metrickernels.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QtConcurrent>
+#include <cmath>
+
+namespace {
+
+const int kImprovementWindowDays = 90;
+const double kHealthyBmiCenter = 21.75; // Centro del rango normal (18.5 - 25)
+
+using GroupMap = QHash<QString, CohortAnalytics::GroupAccumulator>;
+
+// ¿Ha mejorado el paciente entre 'before' y 'after' (índices de la serie) según su objetivo?
+// -1 si no se puede saber (falta el IMC en alguna de las dos mediciones)
+int improvement(const CohortAnalytics::PatientSeries& patient, int before, int after)
+{
+    const QString goal = patient.goal.toLower();
+    if (goal.contains("perder")) {
+        return patient.weights[after] < patient.weights[before] ? 1 : 0;
+    }
+    if (goal.contains("ganar")) {
+        // Masa muscular si se registra; si no, el peso
+        if (patient.muscle[after] > 0 && patient.muscle[before] > 0) {
+            return patient.muscle[after] > patient.muscle[before] ? 1 : 0;
+        }
+        return patient.weights[after] > patient.weights[before] ? 1 : 0;
+    }
+    // Mantener peso / mejorar salud / otro: IMC más cerca del rango saludable
+    if (patient.bmis[after] <= 0.0f || patient.bmis[before] <= 0.0f) {
+        return -1;
+    }
+    return std::fabs(patient.bmis[after] - kHealthyBmiCenter) < std::fabs(patient.bmis[before] - kHealthyBmiCenter) ? 1 : 0;
+}
+
+// Fase "map": agregados de un bloque de pacientes
+GroupMap aggregateChunk(const QVector<CohortAnalytics::PatientSeries>* series, int begin, int end, qint64 asOfDay)
+{
+    GroupMap groups;
+    for (int p = begin; p < end; ++p) {
+        const CohortAnalytics::PatientSeries& patient = series->at(p);
+        const int n = int(patient.days.size());
+        if (n == 0) {
+            continue;
+        }
+        CohortAnalytics::GroupAccumulator& acc = groups[patient.group];
+        ++acc.patients;
+        // Último IMC registrado: las mediciones sin altura lo guardan vacío o a 0 y hundirían la media
+        for (int i = n - 1; i >= 0; --i) {
+            if (patient.bmis[i] > 0.0f) {
+                ++acc.patientsWithBmi;
+                acc.sumLatestBmi += patient.bmis[i];
+                acc.bmiSketch.add(patient.bmis[i]);
+                break;
+            }
+        }
+
+        if (n >= 2) {
+            ++acc.patientsWithHistory;
+            acc.sumWeightChange += patient.weights[n - 1] - patient.weights[0];
+            acc.sumWeeklyTrend += 7.0 * MetricKernels::slope(patient.days.constData(), patient.weights.constData(),
+                                                             std::size_t(n));
+        }
+
+        // Ventana de 90 días: última medición hasta asOf contra la última anterior al inicio de la ventana
+        // (o la primera dentro de la ventana si no hay ninguna anterior)
+        const double windowStart = double(asOfDay - kImprovementWindowDays);
+        int after = -1;
+        int before = -1;
+        for (int i = n - 1; i >= 0; --i) {
+            if (after < 0 && patient.days[i] <= double(asOfDay)) {
+                after = i;
+            }
+            if (patient.days[i] <= windowStart) {
+                before = i;
+                break;
+            }
+        }
+        if (after >= 0 && patient.days[after] > windowStart) {
+            if (before < 0) {
+                for (int i = 0; i < after; ++i) {
+                    if (patient.days[i] > windowStart) {
+                        before = i;
+                        break;
+                    }
+                }
+            }
+            const int improving = (before >= 0 && before < after) ? improvement(patient, before, after) : -1;
+            if (improving >= 0) {
+                ++acc.evaluated;
+                acc.improving += improving;
+            }
+        }
+    }
+    return groups;
+}
+
+} // namespace
+
+void CohortAnalytics::GroupAccumulator::merge(const GroupAccumulator& other)
+{
+    patients += other.patients;
+    patientsWithHistory += other.patientsWithHistory;
+    sumWeightChange += other.sumWeightChange;
+    sumWeeklyTrend += other.sumWeeklyTrend;
+    patientsWithBmi += other.patientsWithBmi;
+    sumLatestBmi += other.sumLatestBmi;
+    bmiSketch.merge(other.bmiSketch);
+    evaluated += other.evaluated;
+    improving += other.improving;
+}
+
+// Una sola lectura secuencial de todas las métricas, ordenadas por paciente y fecha
+bool CohortAnalytics::loadSeries(GroupBy groupBy, const QSqlDatabase& db, QVector<PatientSeries>& series)
+{
+    QString groupColumn;
+    switch (groupBy) {
+    case ByGoal: groupColumn = "u.goal"; break;
+    case ByActivityLevel: groupColumn = "u.activity_level"; break;
+    case ByGender: groupColumn = "u.gender"; break;
+    }
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true); // No guarda en memoria las filas ya leídas
+    if (!query.exec(QString("SELECT m.user_id, m.date, m.weight, m.bmi, m.muscle_mass_percentage, u.goal, %1 "
+                            "FROM health_metrics m JOIN users u ON u.user_id = m.user_id "
+                            "ORDER BY m.user_id, m.date, m.created_at").arg(groupColumn))) {
+        qCritical() << "Error al leer las métricas para el análisis de cohortes:" << query.lastError().text();
+        return false;
+    }
+
+    int currentUser = -1;
+    while (query.next()) {
+        const int userId = query.value(0).toInt();
+        if (userId != currentUser) {
+            currentUser = userId;
+            PatientSeries patient;
+            patient.goal = query.value(5).toString();
+            patient.group = query.value(6).toString();
+            series.append(patient);
+        }
+        PatientSeries& patient = series.last();
+        const QDate date = QDate::fromString(query.value(1).toString(), Qt::ISODate);
+        if (!date.isValid()) {
+            continue;
+        }
+        patient.days.append(double(date.toJulianDay()));
+        patient.weights.append(query.value(2).toDouble());
+        patient.bmis.append(query.value(3).toFloat());
+        patient.muscle.append(query.value(4).toFloat());
+    }
+    return true;
+}
+
+QList<CohortGroupStats> CohortAnalytics::compute(GroupBy groupBy, const QDate& asOf, const QSqlDatabase& db)
+{
+    QList<CohortGroupStats> result;
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<PatientSeries> series;
+    if (!loadSeries(groupBy, db, series)) {
+        return result;
+    }
+    const qint64 loadMs = timer.elapsed();
+
+    // Bloques de pacientes: varios por hilo para equilibrar la carga
+    const int chunkCount = qMax(1, QThread::idealThreadCount() * 4);
+    const int chunkSize = qMax(1, int((series.size() + chunkCount - 1) / chunkCount));
+    QVector<QPair<int, int>> chunks;
+    for (int begin = 0; begin < series.size(); begin += chunkSize) {
+        chunks.append(qMakePair(begin, qMin(int(series.size()), begin + chunkSize)));
+    }
+
+    const QVector<PatientSeries>* data = &series;
+    const qint64 asOfDay = asOf.toJulianDay();
+    const GroupMap groups = QtConcurrent::blockingMappedReduced<GroupMap>(
+        chunks,
+        [data, asOfDay](const QPair<int, int>& chunk) {
+            return aggregateChunk(data, chunk.first, chunk.second, asOfDay);
+        },
+        [](GroupMap& total, const GroupMap& partial) {
+            for (auto it = partial.cbegin(); it != partial.cend(); ++it) {
+                total[it.key()].merge(it.value());
+            }
+        },
+        QtConcurrent::UnorderedReduce);
+
+    for (auto it = groups.cbegin(); it != groups.cend(); ++it) {
+        const GroupAccumulator& acc = it.value();
+        CohortGroupStats stats;
+        stats.group = it.key().isEmpty() ? QString("(sin valor)") : it.key();
+        stats.patients = acc.patients;
+        stats.patientsWithHistory = acc.patientsWithHistory;
+        stats.meanWeightChange = acc.patientsWithHistory > 0 ? acc.sumWeightChange / acc.patientsWithHistory : 0.0;
+        stats.meanWeeklyTrend = acc.patientsWithHistory > 0 ? acc.sumWeeklyTrend / acc.patientsWithHistory : 0.0;
+        stats.patientsWithBmi = acc.patientsWithBmi;
+        stats.meanLatestBmi = acc.patientsWithBmi > 0 ? acc.sumLatestBmi / acc.patientsWithBmi : 0.0;
+        stats.bmiP10 = acc.bmiSketch.quantile(0.10);
+        stats.bmiP25 = acc.bmiSketch.quantile(0.25);
+        stats.bmiMedian = acc.bmiSketch.quantile(0.50);
+        stats.bmiP75 = acc.bmiSketch.quantile(0.75);
+        stats.bmiP90 = acc.bmiSketch.quantile(0.90);
+        stats.evaluatedLast90Days = acc.evaluated;
+        stats.improvingLast90Days = acc.improving;
+        stats.improvingShare = acc.evaluated > 0 ? double(acc.improving) / acc.evaluated : 0.0;
+        result.append(stats);
+    }
+    std::sort(result.begin(), result.end(), [](const CohortGroupStats& a, const CohortGroupStats& b) {
+        return a.group < b.group;
+    });
+
+    qInfo() << "Análisis de cohortes:" << series.size() << "pacientes, lectura" << loadMs << "ms, total"
+            << timer.elapsed() << "ms en" << QThread::idealThreadCount() << "hilos.";
+    return result;
+}
@@ -0,0 +1,78 @@
+#ifndef COHORTANALYTICS_H
+#define COHORTANALYTICS_H
+
+#include <QDate>
+#include <QList>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+#include "quantilesketch.h"
+
+// Estadísticas agregadas de un grupo de pacientes (un objetivo, un nivel de actividad...)
+struct CohortGroupStats {
+    QString group;
+    int patients = 0;               // Pacientes con al menos una medición
+    int patientsWithHistory = 0;    // Pacientes con dos o más mediciones
+    double meanWeightChange = 0.0;  // kg entre la primera y la última medición
+    double meanWeeklyTrend = 0.0;   // Pendiente media del peso (kg/semana, mínimos cuadrados)
+    int patientsWithBmi = 0;        // Pacientes con algún IMC registrado (sin altura no hay IMC)
+    double meanLatestBmi = 0.0;     // Último IMC registrado de cada paciente
+    double bmiP10 = 0.0;            // Distribución del último IMC
+    double bmiP25 = 0.0;
+    double bmiMedian = 0.0;
+    double bmiP75 = 0.0;
+    double bmiP90 = 0.0;
+    int evaluatedLast90Days = 0;    // Pacientes con mediciones para comparar en la ventana
+    int improvingLast90Days = 0;    // ... de los cuales mejoran según su objetivo
+    double improvingShare = 0.0;    // improvingLast90Days / evaluatedLast90Days
+};
+
+// Motor de análisis de la clínica completa.
+// Lee health_metrics una sola vez (consulta de solo avance, unida a users), agrupa las filas por
+// paciente y calcula los agregados por grupo en paralelo con QtConcurrent::blockingMappedReduced.
+// Los cuantiles se calculan con QuantileSketch, que se puede fusionar entre hilos.
+class CohortAnalytics
+{
+public:
+    enum GroupBy {
+        ByGoal,
+        ByActivityLevel,
+        ByGender
+    };
+
+    // La lectura usa 'db', que debe pertenecer al hilo que llama (desde un hilo de trabajo, una
+    // conexión propia); el cálculo posterior se reparte entre todos los núcleos.
+    QList<CohortGroupStats> compute(GroupBy groupBy, const QDate& asOf = QDate::currentDate(),
+                                    const QSqlDatabase& db = QSqlDatabase::database());
+
+    // Serie compacta de un paciente (fechas en día juliano). Días y pesos van en arrays contiguos
+    // de double para poder pasarlos directamente a MetricKernels.
+    struct PatientSeries {
+        QString group;
+        QString goal;
+        QVector<double> days;
+        QVector<double> weights;
+        QVector<float> bmis;
+        QVector<float> muscle;
+    };
+
+    // Acumulador parcial de un grupo; se fusiona en la fase de reducción
+    struct GroupAccumulator {
+        int patients = 0;
+        int patientsWithHistory = 0;
+        double sumWeightChange = 0.0;
+        double sumWeeklyTrend = 0.0;
+        int patientsWithBmi = 0;
+        double sumLatestBmi = 0.0;
+        QuantileSketch bmiSketch;
+        int evaluated = 0;
+        int improving = 0;
+
+        void merge(const GroupAccumulator& other);
+    };
+
+private:
+    bool loadSeries(GroupBy groupBy, const QSqlDatabase& db, QVector<PatientSeries>& series);
+};
+
+#endif // COHORTANALYTICS_H
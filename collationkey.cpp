@@ -0,0 +1,124 @@
+#include "collationkey.h"
+
+namespace {
+
+// Pesos primarios (nunca 0x00, que separa los niveles)
+const char kFieldSeparator = 0x01; // Entre nombre y apellidos: "Ana Zurita" < "Anabel Abad"
+const char kSpace = 0x02;
+const char kDigitBase = 0x10;      // '0'..'9' -> 0x10..0x19
+const char kLetterBase = 0x20;     // 'a'..'z' con la ñ intercalada -> 0x20..0x3A
+const uchar kOtherMarker = 0xF0;   // Otros caracteres: marcador + código Unicode
+
+// Pesos secundarios (acentos) y terciarios (caja)
+const char kNoAccent = 0x01;
+const char kLowerCase = 0x01;
+const char kUpperCase = 0x02;
+
+char accentWeight(QChar mark)
+{
+    switch (mark.unicode()) {
+    case 0x0301: return 0x02; // agudo
+    case 0x0300: return 0x03; // grave
+    case 0x0308: return 0x04; // diéresis
+    case 0x0302: return 0x05; // circunflejo
+    default: return 0x06;
+    }
+}
+
+void appendText(const QString& text, QByteArray& primary, QByteArray& secondary, QByteArray& tertiary)
+{
+    // NFD separa cada letra de sus marcas (á -> a + U+0301, ñ -> n + U+0303)
+    const QString decomposed = text.normalized(QString::NormalizationForm_D);
+    bool lastWasSpace = true;
+
+    for (int i = 0; i < decomposed.size(); ++i) {
+        const QChar ch = decomposed.at(i);
+        if (ch.category() == QChar::Mark_NonSpacing) {
+            continue; // Ya tratada junto a su letra base
+        }
+
+        if (ch.isSpace()) {
+            if (!lastWasSpace) {
+                primary.append(kSpace);
+                secondary.append(kNoAccent);
+                tertiary.append(kLowerCase);
+            }
+            lastWasSpace = true;
+            continue;
+        }
+        lastWasSpace = false;
+
+        // Marcas que siguen a la letra base
+        bool hasTilde = false;
+        char accent = kNoAccent;
+        int next = i + 1;
+        while (next < decomposed.size() && decomposed.at(next).category() == QChar::Mark_NonSpacing) {
+            if (decomposed.at(next).unicode() == 0x0303) {
+                hasTilde = true;
+            } else if (accent == kNoAccent) {
+                accent = accentWeight(decomposed.at(next));
+            }
+            ++next;
+        }
+
+        const QChar lower = ch.toLower();
+        const ushort code = lower.unicode();
+        if (code >= 'a' && code <= 'z') {
+            // Alfabeto español: ... n, ñ, o ... (la ñ es letra propia, no una n acentuada)
+            int index = code - 'a';
+            if (code > 'n' || (code == 'n' && hasTilde)) {
+                ++index;
+            }
+            if (hasTilde && code != 'n') {
+                accent = accent == kNoAccent ? char(0x07) : accent; // ã, õ: solo diferencia secundaria
+            }
+            primary.append(char(kLetterBase + index));
+        } else if (code >= '0' && code <= '9') {
+            primary.append(char(kDigitBase + (code - '0')));
+        } else {
+            // 16 bits repartidos en tres bytes de 6 bits (+1) para no generar nunca un 0x00
+            primary.append(char(kOtherMarker));
+            primary.append(char(1 + (code >> 12)));
+            primary.append(char(1 + ((code >> 6) & 0x3F)));
+            primary.append(char(1 + (code & 0x3F)));
+        }
+        secondary.append(accent);
+        tertiary.append(ch.isUpper() ? kUpperCase : kLowerCase);
+    }
+}
+
+QByteArray joinLevels(const QByteArray& primary, const QByteArray& secondary, const QByteArray& tertiary)
+{
+    QByteArray key;
+    key.reserve(primary.size() + secondary.size() + tertiary.size() + 2);
+    key.append(primary);
+    key.append('\0');
+    key.append(secondary);
+    key.append('\0');
+    key.append(tertiary);
+    return key;
+}
+
+} // namespace
+
+QByteArray CollationKey::forText(const QString& text)
+{
+    QByteArray primary, secondary, tertiary;
+    appendText(text, primary, secondary, tertiary);
+    return joinLevels(primary, secondary, tertiary);
+}
+
+QByteArray CollationKey::forUserName(const QString& firstName, const QString& lastName1, const QString& lastName2)
+{
+    QByteArray primary, secondary, tertiary;
+    const QString fields[] = { firstName.trimmed(), lastName1.trimmed(), lastName2.trimmed() };
+    for (int i = 0; i < 3; ++i) {
+        if (i > 0) {
+            primary.append(kFieldSeparator);
+            secondary.append(kNoAccent);
+            tertiary.append(kLowerCase);
+        }
+        appendText(fields[i], primary, secondary, tertiary);
+    }
+    return joinLevels(primary, secondary, tertiary);
+}
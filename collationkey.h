@@ -0,0 +1,24 @@
+#ifndef COLLATIONKEY_H
+#define COLLATIONKEY_H
+
+#include <QByteArray>
+#include <QString>
+
+// Claves binarias de ordenación para nombres en español.
+// Comparar dos claves byte a byte (memcmp, como hace SQLite con BLOB) da el mismo orden
+// que una comparación alfabética española: la "ñ" va después de la "n", los acentos solo
+// desempatan (a < á) y las mayúsculas desempatan al final.
+//
+// QCollatorSortKey no expone sus bytes, así que no se puede guardar en la base de datos;
+// por eso la clave se genera aquí con una ponderación en tres niveles (letra, acento, caja)
+// al estilo del algoritmo de colación de Unicode.
+class CollationKey
+{
+public:
+    static QByteArray forText(const QString& text);
+
+    // Clave para la lista de pacientes: nombre, primer y segundo apellido
+    static QByteArray forUserName(const QString& firstName, const QString& lastName1, const QString& lastName2);
+};
+
+#endif // COLLATIONKEY_H
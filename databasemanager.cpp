@@ -1,10 +1,18 @@
 #include "databasemanager.h"
+#include "collationkey.h"
+#include "metricrollups.h"
+#include "foodcatalog.h"
+#include "fooddiary.h"
+#include "photostore.h"
+#include <QCoreApplication>
 #include <QDebug>        // Para mensajes de depuración
 #include <QSqlQuery>     // Para ejecutar consultas SQL
 #include <QSqlError>     // Para obtener información de errores SQL
 #include <QStandardPaths> // Para obtener rutas estándar del sistema (usado en ejemplos, no en la implementación final si usas ruta fija)
 #include <QDir>          // Para manejar directorios
 #include <QFileInfo>     // Para obtener información de archivos
+#include <QStringList>
+#include <QSqlRecord>
 
 // Constructor: Inicializa el objeto DatabaseManager
 DatabaseManager::DatabaseManager(QObject *parent) : QObject(parent)
@@ -59,6 +67,37 @@ DatabaseManager::~DatabaseManager()
         qCritical() << "Error: No se pudo crear la tabla 'health_metrics' (SQLite).";
         return false;
     }
+    if (!createAppMetaTable()) {
+        qCritical() << "Error: No se pudo crear la tabla 'app_meta' (SQLite).";
+        return false;
+    }
+    if (!createWeightForecastTable()) {
+        qCritical() << "Error: No se pudo crear la tabla 'weight_forecast_state' (SQLite).";
+        return false;
+    }
+    if (!createMetricReviewQueueTable()) {
+        qCritical() << "Error: No se pudo crear la tabla 'metric_review_queue' (SQLite).";
+        return false;
+    }
+    if (!createClinicalAlertTables()) {
+        qCritical() << "Error: No se pudieron crear las tablas de alertas clínicas (SQLite).";
+        return false;
+    }
+    if (!createMetricRollupsTable()) {
+        qCritical() << "Error: No se pudo crear la tabla 'health_metric_rollups' (SQLite).";
+        return false;
+    }
+    if (!migrateSchema()) {
+        qCritical() << "Error: No se pudo actualizar el esquema de la base de datos (SQLite).";
+        return false;
+    }
+    if (!createHealthMetricsNotesIndex()) {
+        qWarning() << "Aviso: índice de texto completo de notas no disponible (SQLite); se usará búsqueda simple.";
+    }
+
+    // El catálogo de alimentos es opcional: sin él la aplicación funciona igual
+    FoodCatalog::instance()->open(foodCatalogPath());
+    PhotoStore::instance()->open(photoStorePath());
 
     qInfo() << "Base de datos SQLite inicializada correctamente en:" << dbFilePath;
     return true;
@@ -97,11 +136,70 @@ bool DatabaseManager::initializeMariaDbDatabase(const QString& host, int port, c
         qCritical() << "Error: No se pudo crear la tabla 'health_metrics' (MariaDB).";
         return false;
     }
+    if (!createAppMetaTable()) {
+        qCritical() << "Error: No se pudo crear la tabla 'app_meta' (MariaDB).";
+        return false;
+    }
+    if (!createWeightForecastTable()) {
+        qCritical() << "Error: No se pudo crear la tabla 'weight_forecast_state' (MariaDB).";
+        return false;
+    }
+    if (!createMetricReviewQueueTable()) {
+        qCritical() << "Error: No se pudo crear la tabla 'metric_review_queue' (MariaDB).";
+        return false;
+    }
+    if (!createClinicalAlertTables()) {
+        qCritical() << "Error: No se pudieron crear las tablas de alertas clínicas (MariaDB).";
+        return false;
+    }
+    if (!createMetricRollupsTable()) {
+        qCritical() << "Error: No se pudo crear la tabla 'health_metric_rollups' (MariaDB).";
+        return false;
+    }
+    if (!migrateSchema()) {
+        qCritical() << "Error: No se pudo actualizar el esquema de la base de datos (MariaDB).";
+        return false;
+    }
+    if (!createHealthMetricsNotesIndex()) {
+        qWarning() << "Aviso: índice de texto completo de notas no disponible (MariaDB); se usará búsqueda simple.";
+    }
+
+    FoodCatalog::instance()->open(foodCatalogPath());
+    PhotoStore::instance()->open(photoStorePath());
 
     qInfo() << "Base de datos MariaDB inicializada correctamente en" << host << ":" << port << "/" << dbName;
     return true;
 }
 
+QString DatabaseManager::foodCatalogPathFor(const QString& dbFilePath)
+{
+    QFileInfo fi(dbFilePath);
+    return fi.absoluteDir().filePath(fi.completeBaseName() + ".foods.bin");
+}
+
+QString DatabaseManager::foodCatalogPath() const
+{
+    if (m_currentDbType == SQLite) {
+        return foodCatalogPathFor(m_dbName);
+    }
+    // Con MariaDB no hay archivo local de la base de datos: el catálogo va junto al ejecutable
+    return QDir(QCoreApplication::applicationDirPath()).filePath("nutricion.foods.bin");
+}
+
+QString DatabaseManager::photoStorePathFor(const QString& dbFilePath)
+{
+    QFileInfo fi(dbFilePath);
+    return fi.absoluteDir().filePath(fi.completeBaseName() + ".photos");
+}
+
+QString DatabaseManager::photoStorePath() const
+{
+    if (m_currentDbType == SQLite) {
+        return photoStorePathFor(m_dbName);
+    }
+    return QDir(QCoreApplication::applicationDirPath()).filePath("nutricion.photos");
+}
+
    // Función auxiliar interna para abrir la conexión a la base de datos
    // Usa las variables miembro (m_currentDbType, m_dbName, etc.)
    bool DatabaseManager::openDatabaseInternal()
@@ -212,3 +310,753 @@ bool DatabaseManager::createHealthMetricsTable()
     qInfo() << "Tabla 'health_metrics' asegurada/creada.";
     return true;
 }
+
+// Crea la tabla 'app_meta' si no existe.
+// Guarda pares nombre/valor, como el contador de cambios de 'users' que usa la instantánea de arranque.
+bool DatabaseManager::createAppMetaTable()
+{
+    QSqlQuery query(m_db);
+    QString createTableSql = "CREATE TABLE IF NOT EXISTS app_meta ("
+                             "name VARCHAR(64) PRIMARY KEY, "
+                             "value INTEGER NOT NULL DEFAULT 0"
+                             ");";
+
+    if (!query.exec(createTableSql)) {
+        qCritical() << "Error al crear la tabla 'app_meta':" << query.lastError().text();
+        return false;
+    }
+    qInfo() << "Tabla 'app_meta' asegurada/creada.";
+    return true;
+}
+
+// Crea el índice de texto completo de las notas de las métricas.
+// SQLite: tabla virtual FTS5 de contenido externo (apunta a health_metrics) mantenida por triggers,
+// con el tokenizador unicode61 eliminando diacríticos ("retencion" encuentra "retención").
+// MariaDB: índice FULLTEXT; su colación por defecto ya ignora acentos.
+bool DatabaseManager::createHealthMetricsNotesIndex()
+{
+    QSqlQuery query(m_db);
+
+    if (m_currentDbType == MariaDB) {
+        if (!query.exec("CREATE FULLTEXT INDEX IF NOT EXISTS idx_health_metrics_notes ON health_metrics (notes)")) {
+            qWarning() << "Error al crear el índice FULLTEXT de notas:" << query.lastError().text();
+            return false;
+        }
+        qInfo() << "Índice FULLTEXT de notas asegurado/creado.";
+        return true;
+    }
+
+    // ¿Existía ya? Si la creamos ahora hay que indexar las notas que ya hay en la tabla
+    bool existed = false;
+    if (query.exec("SELECT name FROM sqlite_master WHERE type = 'table' AND name = 'health_metrics_fts'")) {
+        existed = query.next();
+    }
+
+    const QStringList statements = {
+        "CREATE VIRTUAL TABLE IF NOT EXISTS health_metrics_fts USING fts5("
+        "notes, "
+        "content='health_metrics', "
+        "content_rowid='metric_id', "
+        "tokenize='unicode61 remove_diacritics 2'"
+        ")",
+        // Los triggers mantienen el índice sincronizado con cualquier escritura sobre health_metrics
+        "CREATE TRIGGER IF NOT EXISTS health_metrics_fts_ai AFTER INSERT ON health_metrics BEGIN "
+        "INSERT INTO health_metrics_fts (rowid, notes) VALUES (new.metric_id, new.notes); "
+        "END",
+        "CREATE TRIGGER IF NOT EXISTS health_metrics_fts_ad AFTER DELETE ON health_metrics BEGIN "
+        "INSERT INTO health_metrics_fts (health_metrics_fts, rowid, notes) VALUES ('delete', old.metric_id, old.notes); "
+        "END",
+        "CREATE TRIGGER IF NOT EXISTS health_metrics_fts_au AFTER UPDATE ON health_metrics BEGIN "
+        "INSERT INTO health_metrics_fts (health_metrics_fts, rowid, notes) VALUES ('delete', old.metric_id, old.notes); "
+        "INSERT INTO health_metrics_fts (rowid, notes) VALUES (new.metric_id, new.notes); "
+        "END"
+    };
+
+    for (const QString& sql : statements) {
+        if (!query.exec(sql)) {
+            qWarning() << "Error al crear el índice FTS5 de notas:" << query.lastError().text();
+            return false;
+        }
+    }
+
+    if (!existed) {
+        if (!query.exec("INSERT INTO health_metrics_fts (health_metrics_fts) VALUES ('rebuild')")) {
+            qWarning() << "Error al indexar las notas existentes:" << query.lastError().text();
+            return false;
+        }
+        qInfo() << "Índice FTS5 de notas creado e inicializado con las métricas existentes.";
+    } else {
+        qInfo() << "Índice FTS5 de notas asegurado.";
+    }
+    return true;
+}
+
+// Aplica, en orden, las migraciones pendientes del esquema
+// Crea la tabla 'weight_forecast_state' si no existe.
+// Una fila por paciente con el estado del suavizado de Holt que usa WeightForecaster.
+bool DatabaseManager::createWeightForecastTable()
+{
+    QSqlQuery query(m_db);
+    QString createTableSql = "CREATE TABLE IF NOT EXISTS weight_forecast_state ("
+                             "user_id INTEGER PRIMARY KEY, "
+                             "level REAL NOT NULL, "
+                             "trend REAL NOT NULL, "
+                             "last_date VARCHAR(10) NOT NULL, "
+                             "observations INTEGER NOT NULL, "
+                             "error_variance REAL NOT NULL DEFAULT 0, "
+                             "mean_gap_days REAL NOT NULL DEFAULT 7, "
+                             "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+                             ");";
+
+    if (!query.exec(createTableSql)) {
+        qCritical() << "Error al crear la tabla 'weight_forecast_state':" << query.lastError().text();
+        return false;
+    }
+    qInfo() << "Tabla 'weight_forecast_state' asegurada/creada.";
+    return true;
+}
+
+// Crea la tabla 'metric_review_queue' si no existe.
+// Mediciones marcadas como sospechosas por la revisión masiva (MetricAnomalyDetector::sweepAll).
+// El índice único (metric_id, rule) lo crea la migración v10, que también añade la columna a las bases antiguas.
+bool DatabaseManager::createMetricReviewQueueTable()
+{
+    QSqlQuery query(m_db);
+    QString createTableSql = "CREATE TABLE IF NOT EXISTS metric_review_queue ("
+                             "review_id " + autoIncrementPrimaryKey() + ", "
+                             "metric_id INTEGER NOT NULL, "
+                             "user_id INTEGER NOT NULL, "
+                             "rule VARCHAR(32) NOT NULL, "
+                             "field VARCHAR(32) NOT NULL, "
+                             "severity INTEGER NOT NULL, "
+                             "message TEXT, "
+                             "resolved INTEGER NOT NULL DEFAULT 0, "
+                             "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP, "
+                             "FOREIGN KEY (metric_id) REFERENCES health_metrics(metric_id) ON DELETE CASCADE"
+                             ");";
+
+    if (!query.exec(createTableSql)) {
+        qCritical() << "Error al crear la tabla 'metric_review_queue':" << query.lastError().text();
+        return false;
+    }
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_metric_review_pending ON metric_review_queue (resolved, user_id)")) {
+        qCritical() << "Error al crear el índice de 'metric_review_queue':" << query.lastError().text();
+        return false;
+    }
+    qInfo() << "Tabla 'metric_review_queue' asegurada/creada.";
+    return true;
+}
+
+// Crea las tablas de alertas clínicas si no existen (ClinicalAlertEngine).
+// 'clinical_alerts': alertas emitidas; los índices cubren la lista por paciente y la búsqueda por regla.
+// 'clinical_alert_state': fecha de la última medición de cada paciente, indexada para las reglas temporales.
+bool DatabaseManager::createClinicalAlertTables()
+{
+    QSqlQuery query(m_db);
+    const QStringList statements = {
+        "CREATE TABLE IF NOT EXISTS clinical_alerts ("
+        "alert_id " + autoIncrementPrimaryKey() + ", "
+        "user_id INTEGER NOT NULL, "
+        "rule_id VARCHAR(64) NOT NULL, "
+        "metric_id INTEGER, "
+        "edge INTEGER NOT NULL DEFAULT 0, "
+        "value REAL, "
+        "message TEXT, "
+        "active INTEGER NOT NULL DEFAULT 1, "
+        "acknowledged INTEGER NOT NULL DEFAULT 0, "
+        "fired_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP, "
+        "resolved_at TIMESTAMP NULL DEFAULT NULL, "
+        "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+        ");",
+        "CREATE INDEX IF NOT EXISTS idx_clinical_alerts_user ON clinical_alerts (user_id, active)",
+        "CREATE INDEX IF NOT EXISTS idx_clinical_alerts_rule ON clinical_alerts (rule_id, active)",
+        "CREATE INDEX IF NOT EXISTS idx_clinical_alerts_metric ON clinical_alerts (metric_id)",
+        "CREATE TABLE IF NOT EXISTS clinical_alert_state ("
+        "user_id INTEGER PRIMARY KEY, "
+        "last_date VARCHAR(10) NOT NULL, "
+        "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+        ");",
+        "CREATE INDEX IF NOT EXISTS idx_clinical_alert_state_date ON clinical_alert_state (last_date)"
+    };
+    for (const QString& statement : statements) {
+        if (!query.exec(statement)) {
+            qCritical() << "Error al crear las tablas de alertas clínicas:" << query.lastError().text();
+            return false;
+        }
+    }
+    qInfo() << "Tablas 'clinical_alerts' y 'clinical_alert_state' aseguradas/creadas.";
+    return true;
+}
+
+// Crea la tabla 'health_metric_rollups' si no existe (MetricRollups).
+// Una fila por paciente, nivel (1 semana, 2 mes, 3 año) y periodo; la clave primaria
+// sirve también para leer la serie de un paciente en orden de fecha.
+bool DatabaseManager::createMetricRollupsTable()
+{
+    QSqlQuery query(m_db);
+    QString createTableSql = "CREATE TABLE IF NOT EXISTS health_metric_rollups ("
+                             "user_id INTEGER NOT NULL, "
+                             "level INTEGER NOT NULL, "
+                             "bucket_start VARCHAR(10) NOT NULL, "
+                             "sample_count INTEGER NOT NULL, "
+                             "weight_min REAL, "
+                             "weight_max REAL, "
+                             "weight_sum REAL, "
+                             "weight_last REAL, "
+                             "bmi_count INTEGER NOT NULL DEFAULT 0, "
+                             "bmi_min REAL, "
+                             "bmi_max REAL, "
+                             "bmi_sum REAL, "
+                             "bmi_last REAL, "
+                             "last_date VARCHAR(10), "
+                             "PRIMARY KEY (user_id, level, bucket_start), "
+                             "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+                             ");";
+
+    if (!query.exec(createTableSql)) {
+        qCritical() << "Error al crear la tabla 'health_metric_rollups':" << query.lastError().text();
+        return false;
+    }
+    // Tablas anteriores a 'bmi_count': la columna tiene que existir antes de cualquier migración
+    // que reconstruya los resúmenes (v3 y v11)
+    if (!query.exec("SELECT bmi_count FROM health_metric_rollups LIMIT 1")
+        && !query.exec("ALTER TABLE health_metric_rollups ADD COLUMN bmi_count INTEGER NOT NULL DEFAULT 0")) {
+        qCritical() << "Error al añadir 'bmi_count' a 'health_metric_rollups':" << query.lastError().text();
+        return false;
+    }
+    qInfo() << "Tabla 'health_metric_rollups' asegurada/creada.";
+    return true;
+}
+
+// Clave primaria autoincremental según el motor (la sintaxis difiere entre SQLite y MariaDB)
+QString DatabaseManager::autoIncrementPrimaryKey() const
+{
+    return (m_currentDbType == MariaDB) ? "INTEGER PRIMARY KEY AUTO_INCREMENT" : "INTEGER PRIMARY KEY AUTOINCREMENT";
+}
+
+bool DatabaseManager::migrateSchema()
+{
+    const int version = schemaVersion();
+    if (version < 0) {
+        return false;
+    }
+
+    if (version < 1) {
+        if (!migrateUsersSortKey() || !setSchemaVersion(1)) {
+            return false;
+        }
+    }
+    if (version < 2) {
+        if (!migrateBodyCompositionColumns() || !setSchemaVersion(2)) {
+            return false;
+        }
+    }
+    if (version < 3) {
+        // v3: resúmenes semanales/mensuales/anuales calculados a partir de las métricas ya guardadas
+        if (!MetricRollups::rebuildAll() || !setSchemaVersion(3)) {
+            return false;
+        }
+    }
+    if (version < 4) {
+        if (!migrateRecipeTables() || !setSchemaVersion(4)) {
+            return false;
+        }
+    }
+    if (version < 5) {
+        if (!migrateFoodDiaryTables() || !setSchemaVersion(5)) {
+            return false;
+        }
+    }
+    if (version < 6) {
+        if (!migrateMealPlanTables() || !setSchemaVersion(6)) {
+            return false;
+        }
+    }
+    if (version < 7) {
+        if (!migrateAppointmentTables() || !setSchemaVersion(7)) {
+            return false;
+        }
+    }
+    if (version < 8) {
+        if (!migratePhotoTables() || !setSchemaVersion(8)) {
+            return false;
+        }
+    }
+    if (version < 9) {
+        if (!migrateImportTables() || !setSchemaVersion(9)) {
+            return false;
+        }
+    }
+    if (version < 10) {
+        if (!migrateMetricReviewQueue() || !setSchemaVersion(10)) {
+            return false;
+        }
+    }
+    if (version < 11) {
+        if (!migrateRollupBmiCount() || !setSchemaVersion(11)) {
+            return false;
+        }
+    }
+    if (version < 12) {
+        if (!migrateLeanMassIndex() || !setSchemaVersion(12)) {
+            return false;
+        }
+    }
+
+    qInfo() << "Esquema de la base de datos en la versión" << schemaVersion();
+    return true;
+}
+
+int DatabaseManager::schemaVersion()
+{
+    QSqlQuery query(m_db);
+    if (!query.exec("SELECT value FROM app_meta WHERE name = 'schema_version'")) {
+        qCritical() << "Error al leer la versión del esquema:" << query.lastError().text();
+        return -1;
+    }
+    return query.next() ? query.value(0).toInt() : 0;
+}
+
+bool DatabaseManager::setSchemaVersion(int version)
+{
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE app_meta SET value = :value WHERE name = 'schema_version'");
+    query.bindValue(":value", version);
+    if (!query.exec()) {
+        qCritical() << "Error al guardar la versión del esquema:" << query.lastError().text();
+        return false;
+    }
+    if (query.numRowsAffected() == 0) {
+        query.prepare("INSERT INTO app_meta (name, value) VALUES ('schema_version', :value)");
+        query.bindValue(":value", version);
+        if (!query.exec()) {
+            qCritical() << "Error al guardar la versión del esquema:" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+// v1: columna 'sort_key' con la clave de colación española de "nombre apellido1 apellido2".
+// Se calcula al escribir el usuario (UserManager) y el índice sirve tanto para ordenar como
+// para paginar por clave sin comparar cadenas con reglas de idioma en cada carga.
+bool DatabaseManager::migrateUsersSortKey()
+{
+    QSqlQuery query(m_db);
+
+    if (!m_db.record("users").contains("sort_key")) {
+        const QString type = (m_currentDbType == MariaDB) ? "VARBINARY(768)" : "BLOB";
+        if (!query.exec(QString("ALTER TABLE users ADD COLUMN sort_key %1").arg(type))) {
+            qCritical() << "Error al añadir la columna 'sort_key':" << query.lastError().text();
+            return false;
+        }
+    }
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_users_sort_key ON users (sort_key, user_id)")) {
+        qCritical() << "Error al crear el índice 'idx_users_sort_key':" << query.lastError().text();
+        return false;
+    }
+
+    // Rellenar la clave de los usuarios existentes en una sola transacción
+    if (!query.exec("SELECT user_id, first_name, last_name1, last_name2 FROM users WHERE sort_key IS NULL")) {
+        qCritical() << "Error al leer los usuarios sin clave de ordenación:" << query.lastError().text();
+        return false;
+    }
+    QList<QPair<int, QByteArray>> keys;
+    while (query.next()) {
+        keys.append(qMakePair(query.value(0).toInt(),
+                              CollationKey::forUserName(query.value(1).toString(),
+                                                        query.value(2).toString(),
+                                                        query.value(3).toString())));
+    }
+    query.finish();
+
+    if (!m_db.transaction()) {
+        qCritical() << "Error al iniciar la migración de 'sort_key':" << m_db.lastError().text();
+        return false;
+    }
+    QSqlQuery update(m_db);
+    update.prepare("UPDATE users SET sort_key = :sort_key WHERE user_id = :user_id");
+    for (const auto& key : keys) {
+        update.bindValue(":sort_key", key.second);
+        update.bindValue(":user_id", key.first);
+        if (!update.exec()) {
+            qCritical() << "Error al rellenar 'sort_key':" << update.lastError().text();
+            m_db.rollback();
+            return false;
+        }
+    }
+    if (!m_db.commit()) {
+        qCritical() << "Error al confirmar la migración de 'sort_key':" << m_db.lastError().text();
+        return false;
+    }
+
+    qInfo() << "Migración v1 aplicada: clave de ordenación calculada para" << keys.count() << "usuarios.";
+    return true;
+}
+
+// v2: composición corporal derivada como columnas generadas de 'health_metrics'.
+// El motor las calcula a partir de peso, altura y % de grasa, así que no pueden quedar desfasadas
+// y se pueden indexar. SQLite solo admite añadir columnas generadas VIRTUAL con ALTER TABLE
+// (se calculan al leer; los índices sí guardan el valor); MariaDB las guarda (STORED).
+// bmi_category: 0 bajo peso, 1 normal, 2 sobrepeso, 3-5 obesidad I-III (umbrales de la OMS).
+bool DatabaseManager::migrateBodyCompositionColumns()
+{
+    const QString heightMeters2 = "((height / 100.0) * (height / 100.0))";
+    const QString bmiExpr = QString("(weight / %1)").arg(heightMeters2);
+    const QList<QPair<QString, QString>> columns = {
+        { "fat_mass_kg", "CASE WHEN body_fat_percentage > 0 THEN weight * body_fat_percentage / 100.0 END" },
+        { "lean_mass_kg", "CASE WHEN body_fat_percentage > 0 THEN weight * (1 - body_fat_percentage / 100.0) END" },
+        { "ffmi", QString("CASE WHEN body_fat_percentage > 0 AND height > 0 "
+                          "THEN weight * (1 - body_fat_percentage / 100.0) / %1 END").arg(heightMeters2) },
+        { "bmi_category", QString("CASE WHEN weight > 0 AND height > 0 THEN "
+                                  "CASE WHEN %1 < 18.5 THEN 0 WHEN %1 < 25 THEN 1 WHEN %1 < 30 THEN 2 "
+                                  "WHEN %1 < 35 THEN 3 WHEN %1 < 40 THEN 4 ELSE 5 END END").arg(bmiExpr) },
+    };
+
+    QSqlQuery query(m_db);
+    const QSqlRecord record = m_db.record("health_metrics");
+    for (const auto& column : columns) {
+        if (record.contains(column.first)) {
+            continue;
+        }
+        const QString type = (column.first == "bmi_category") ? "INTEGER" : (m_currentDbType == MariaDB ? "DOUBLE" : "REAL");
+        const QString storage = (m_currentDbType == MariaDB) ? "STORED" : "VIRTUAL";
+        const QString sql = QString("ALTER TABLE health_metrics ADD COLUMN %1 %2 GENERATED ALWAYS AS (%3) %4")
+                                .arg(column.first, type, column.second, storage);
+        if (!query.exec(sql)) {
+            qCritical() << "Error al añadir la columna generada" << column.first << ":" << query.lastError().text();
+            return false;
+        }
+    }
+
+    // Índices para consultas por rango y para las funciones de ventana por paciente
+    const QStringList indexes = {
+        "CREATE INDEX IF NOT EXISTS idx_health_metrics_user_date ON health_metrics (user_id, date)",
+        "CREATE INDEX IF NOT EXISTS idx_health_metrics_bmi_category ON health_metrics (bmi_category, user_id)",
+    };
+    for (const QString& sql : indexes) {
+        if (!query.exec(sql)) {
+            qCritical() << "Error al crear índice de composición corporal:" << query.lastError().text();
+            return false;
+        }
+    }
+
+    qInfo() << "Migración v2 aplicada: columnas generadas de composición corporal.";
+    return true;
+}
+
+// v4: recetas y planes de dieta. Un ingrediente es un alimento del catálogo (food_code, el código
+// estable de FoodCatalog) o una subreceta (sub_recipe_id). Los índices por sub_recipe_id y
+// recipe_id permiten saber quién usa una receta sin recorrer todas.
+bool DatabaseManager::migrateRecipeTables()
+{
+    QSqlQuery query(m_db);
+    const QString primaryKey = autoIncrementPrimaryKey();
+    const QStringList statements = {
+        QString("CREATE TABLE IF NOT EXISTS recipes ("
+                "recipe_id %1, "
+                "name VARCHAR(255) NOT NULL, "
+                "yield_grams REAL, "
+                "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP, "
+                "updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP"
+                ");").arg(primaryKey),
+        "CREATE TABLE IF NOT EXISTS recipe_items ("
+        "recipe_id INTEGER NOT NULL, "
+        "position INTEGER NOT NULL, "
+        "food_code VARCHAR(64), "
+        "sub_recipe_id INTEGER, "
+        "grams REAL NOT NULL, "
+        "PRIMARY KEY (recipe_id, position), "
+        "FOREIGN KEY (recipe_id) REFERENCES recipes(recipe_id) ON DELETE CASCADE, "
+        "FOREIGN KEY (sub_recipe_id) REFERENCES recipes(recipe_id)"
+        ");",
+        "CREATE INDEX IF NOT EXISTS idx_recipe_items_sub_recipe ON recipe_items (sub_recipe_id)",
+        QString("CREATE TABLE IF NOT EXISTS diet_plans ("
+                "plan_id %1, "
+                "user_id INTEGER NOT NULL, "
+                "name VARCHAR(255) NOT NULL, "
+                "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP, "
+                "updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP, "
+                "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+                ");").arg(primaryKey),
+        "CREATE INDEX IF NOT EXISTS idx_diet_plans_user ON diet_plans (user_id)",
+        "CREATE TABLE IF NOT EXISTS diet_plan_items ("
+        "plan_id INTEGER NOT NULL, "
+        "position INTEGER NOT NULL, "
+        "recipe_id INTEGER NOT NULL, "
+        "grams REAL NOT NULL, "
+        "PRIMARY KEY (plan_id, position), "
+        "FOREIGN KEY (plan_id) REFERENCES diet_plans(plan_id) ON DELETE CASCADE, "
+        "FOREIGN KEY (recipe_id) REFERENCES recipes(recipe_id)"
+        ");",
+        "CREATE INDEX IF NOT EXISTS idx_diet_plan_items_recipe ON diet_plan_items (recipe_id)"
+    };
+    for (const QString& statement : statements) {
+        if (!query.exec(statement)) {
+            qCritical() << "Error al crear las tablas de recetas:" << query.lastError().text();
+            return false;
+        }
+    }
+    qInfo() << "Migración v4 aplicada: recetas y planes de dieta.";
+    return true;
+}
+
+// v5: diario de alimentación. Cada entrada guarda lo que aportó de cada nutriente de FoodDiary;
+// 'daily_intake' acumula esas mismas columnas por paciente y día. El índice (user_id, day, meal)
+// sirve para leer un día agrupado por comidas.
+bool DatabaseManager::migrateFoodDiaryTables()
+{
+    const QString real = (m_currentDbType == MariaDB) ? "DOUBLE" : "REAL";
+    QStringList nutrientColumns;
+    for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+        nutrientColumns << QString("%1 %2 NOT NULL DEFAULT 0").arg(FoodDiary::columnName(FoodDiary::Nutrient(n)), real);
+    }
+
+    QSqlQuery query(m_db);
+    const QStringList statements = {
+        QString("CREATE TABLE IF NOT EXISTS food_diary ("
+                "entry_id %1, "
+                "user_id INTEGER NOT NULL, "
+                "day VARCHAR(10) NOT NULL, "
+                "meal INTEGER NOT NULL, "
+                "food_code VARCHAR(64), "
+                "recipe_id INTEGER, "
+                "grams %2 NOT NULL, "
+                "%3, "
+                "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP, "
+                "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+                ");").arg(autoIncrementPrimaryKey(), real, nutrientColumns.join(", ")),
+        "CREATE INDEX IF NOT EXISTS idx_food_diary_user_day ON food_diary (user_id, day, meal)",
+        QString("CREATE TABLE IF NOT EXISTS daily_intake ("
+                "user_id INTEGER NOT NULL, "
+                "day VARCHAR(10) NOT NULL, "
+                "entry_count INTEGER NOT NULL, "
+                "%1, "
+                "PRIMARY KEY (user_id, day), "
+                "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+                ");").arg(nutrientColumns.join(", "))
+    };
+    for (const QString& statement : statements) {
+        if (!query.exec(statement)) {
+            qCritical() << "Error al crear las tablas del diario de alimentación:" << query.lastError().text();
+            return false;
+        }
+    }
+    qInfo() << "Migración v5 aplicada: diario de alimentación e ingesta diaria.";
+    return true;
+}
+
+bool DatabaseManager::migrateMealPlanTables()
+{
+    const QString real = (m_currentDbType == MariaDB) ? "DOUBLE" : "REAL";
+    QSqlQuery query(m_db);
+    const QStringList statements = {
+        "CREATE TABLE IF NOT EXISTS meal_plan_exclusions ("
+        "user_id INTEGER NOT NULL, "
+        "term VARCHAR(100) NOT NULL, "
+        "PRIMARY KEY (user_id, term), "
+        "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+        ");",
+        // item_key: "f:<código de alimento>" o "r:<id de receta>"
+        QString("CREATE TABLE IF NOT EXISTS food_prices ("
+                "item_key VARCHAR(80) PRIMARY KEY, "
+                "price_per_kg %1 NOT NULL"
+                ");").arg(real),
+        QString("CREATE TABLE IF NOT EXISTS meal_plan_runs ("
+                "user_id INTEGER NOT NULL, "
+                "week_start VARCHAR(10) NOT NULL, "
+                "deviation %1 NOT NULL, "
+                "cost %1 NOT NULL, "
+                "generated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP, "
+                "PRIMARY KEY (user_id, week_start), "
+                "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+                ");").arg(real),
+        QString("CREATE TABLE IF NOT EXISTS generated_meal_plans ("
+                "user_id INTEGER NOT NULL, "
+                "week_start VARCHAR(10) NOT NULL, "
+                "day_index INTEGER NOT NULL, "
+                "position INTEGER NOT NULL, "
+                "food_code VARCHAR(64), "
+                "recipe_id INTEGER, "
+                "grams %1 NOT NULL, "
+                "PRIMARY KEY (user_id, week_start, day_index, position), "
+                "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+                ");").arg(real)
+    };
+    for (const QString& statement : statements) {
+        if (!query.exec(statement)) {
+            qCritical() << "Error al crear las tablas de planes semanales:" << query.lastError().text();
+            return false;
+        }
+    }
+    qInfo() << "Migración v6 aplicada: exclusiones, precios y planes semanales generados.";
+    return true;
+}
+
+bool DatabaseManager::migrateAppointmentTables()
+{
+    QSqlQuery query(m_db);
+    const QStringList statements = {
+        // start_time/end_time en ISO local (yyyy-MM-ddTHH:mm:ss): se ordenan como texto
+        QString("CREATE TABLE IF NOT EXISTS appointments ("
+                "appointment_id %1, "
+                "user_id INTEGER NOT NULL, "
+                "practitioner VARCHAR(100) NOT NULL, "
+                "room VARCHAR(50), "
+                "start_time VARCHAR(19) NOT NULL, "
+                "end_time VARCHAR(19) NOT NULL, "
+                "status INTEGER NOT NULL DEFAULT 0, "
+                "notes TEXT, "
+                "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP, "
+                "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+                ");").arg(autoIncrementPrimaryKey()),
+        "CREATE INDEX IF NOT EXISTS idx_appointments_user_start ON appointments (user_id, start_time)",
+        "CREATE INDEX IF NOT EXISTS idx_appointments_practitioner_start ON appointments (practitioner, start_time)",
+        "CREATE TABLE IF NOT EXISTS appointment_metrics ("
+        "metric_id INTEGER PRIMARY KEY, "
+        "appointment_id INTEGER NOT NULL, "
+        "FOREIGN KEY (metric_id) REFERENCES health_metrics(metric_id) ON DELETE CASCADE, "
+        "FOREIGN KEY (appointment_id) REFERENCES appointments(appointment_id) ON DELETE CASCADE"
+        ");",
+        "CREATE INDEX IF NOT EXISTS idx_appointment_metrics_appointment ON appointment_metrics (appointment_id)"
+    };
+    for (const QString& statement : statements) {
+        if (!query.exec(statement)) {
+            qCritical() << "Error al crear las tablas de la agenda:" << query.lastError().text();
+            return false;
+        }
+    }
+    qInfo() << "Migración v7 aplicada: citas y mediciones de cada visita.";
+    return true;
+}
+
+bool DatabaseManager::migratePhotoTables()
+{
+    QSqlQuery query(m_db);
+    const QStringList statements = {
+        // Las imágenes están en el almacén de PhotoStore; aquí solo el hash y los metadatos
+        QString("CREATE TABLE IF NOT EXISTS progress_photos ("
+                "photo_id %1, "
+                "user_id INTEGER NOT NULL, "
+                "metric_id INTEGER, "
+                "sha256 CHAR(64) NOT NULL, "
+                "format VARCHAR(10), "
+                "width INTEGER, "
+                "height INTEGER, "
+                "byte_size INTEGER, "
+                "taken_at VARCHAR(19), "
+                "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP, "
+                "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE, "
+                "FOREIGN KEY (metric_id) REFERENCES health_metrics(metric_id) ON DELETE SET NULL"
+                ");").arg(autoIncrementPrimaryKey()),
+        "CREATE INDEX IF NOT EXISTS idx_progress_photos_user_taken ON progress_photos (user_id, taken_at)",
+        "CREATE INDEX IF NOT EXISTS idx_progress_photos_metric ON progress_photos (metric_id)",
+        "CREATE INDEX IF NOT EXISTS idx_progress_photos_sha256 ON progress_photos (sha256)"
+    };
+    for (const QString& statement : statements) {
+        if (!query.exec(statement)) {
+            qCritical() << "Error al crear la tabla de fotos de progreso:" << query.lastError().text();
+            return false;
+        }
+    }
+    qInfo() << "Migración v8 aplicada: fotos de progreso.";
+    return true;
+}
+
+bool DatabaseManager::migrateImportTables()
+{
+    QSqlQuery query(m_db);
+    const QStringList statements = {
+        // ID del paciente en la clínica o sistema de origen ('source') -> user_id
+        "CREATE TABLE IF NOT EXISTS patient_external_ids ("
+        "source VARCHAR(100) NOT NULL, "
+        "external_id VARCHAR(100) NOT NULL, "
+        "user_id INTEGER NOT NULL, "
+        "PRIMARY KEY (source, external_id), "
+        "FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE"
+        ");",
+        "CREATE INDEX IF NOT EXISTS idx_patient_external_ids_user ON patient_external_ids (user_id)",
+        // Una fila por archivo importado: posición y fila siguientes a la última tanda guardada
+        "CREATE TABLE IF NOT EXISTS import_checkpoints ("
+        "file_path VARCHAR(500) NOT NULL, "
+        "kind INTEGER NOT NULL, "
+        "source VARCHAR(100), "
+        "file_size BIGINT, "
+        "file_modified VARCHAR(19), "
+        "next_offset BIGINT NOT NULL, "
+        "next_row BIGINT NOT NULL, "
+        "rows_imported BIGINT DEFAULT 0, "
+        "rows_rejected BIGINT DEFAULT 0, "
+        "completed INTEGER DEFAULT 0, "
+        "updated_at VARCHAR(19), "
+        "PRIMARY KEY (file_path, kind)"
+        ");"
+    };
+    for (const QString& statement : statements) {
+        if (!query.exec(statement)) {
+            qCritical() << "Error al crear las tablas de importación:" << query.lastError().text();
+            return false;
+        }
+    }
+    qInfo() << "Migración v9 aplicada: importación masiva.";
+    return true;
+}
+
+// v10: la cola de revisión pasa a tener una entrada por medición y regla (columna 'rule' e índice
+// único). Hasta ahora ninguna entrada podía marcarse como revisada y la revisión las regeneraba
+// todas, así que se recrea vacía; la próxima revisión la vuelve a llenar.
+bool DatabaseManager::migrateMetricReviewQueue()
+{
+    QSqlQuery query(m_db);
+    if (!query.exec("DROP TABLE IF EXISTS metric_review_queue")) {
+        qCritical() << "Error al recrear la tabla 'metric_review_queue':" << query.lastError().text();
+        return false;
+    }
+    if (!createMetricReviewQueueTable()) {
+        return false;
+    }
+    // Una entrada por medición y regla: la revisión solo añade las nuevas y conserva las ya revisadas
+    if (!query.exec("CREATE UNIQUE INDEX idx_metric_review_rule ON metric_review_queue (metric_id, rule)")) {
+        qCritical() << "Error al crear el índice único de 'metric_review_queue':" << query.lastError().text();
+        return false;
+    }
+    qInfo() << "Migración v10 aplicada: cola de revisión por medición y regla.";
+    return true;
+}
+
+bool DatabaseManager::migrateRollupBmiCount()
+{
+    // La columna la añade createMetricRollupsTable. Se recalcula todo: los periodos guardados
+    // mezclaban el IMC 0 de las mediciones sin altura en el mínimo y en la media.
+    if (!MetricRollups::rebuildAll()) {
+        return false;
+    }
+    qInfo() << "Migración v11 aplicada: recuento de IMC en los resúmenes de métricas.";
+    return true;
+}
+
+// v12: los índices de un solo valor sobre lean_mass_kg y ffmi no los usaba ninguna consulta (no se
+// filtra ni se ordena por el valor sin el paciente). HealthMetricManager::findLeanMassDrops recorre las
+// mediciones de cada paciente por fecha leyendo su masa magra: con el valor al final del índice
+// la consulta se resuelve sin tocar la tabla (metric_id ya va en todo índice: rowid en SQLite,
+// clave primaria en InnoDB).
+bool DatabaseManager::migrateLeanMassIndex()
+{
+    QSqlQuery query(m_db);
+    // MariaDB exige la tabla en DROP INDEX
+    const QString onTable = (m_currentDbType == MariaDB) ? " ON health_metrics" : "";
+    const QStringList statements = {
+        "DROP INDEX IF EXISTS idx_health_metrics_lean_mass" + onTable,
+        "DROP INDEX IF EXISTS idx_health_metrics_ffmi" + onTable,
+        "CREATE INDEX IF NOT EXISTS idx_health_metrics_lean_mass_history "
+        "ON health_metrics (user_id, date, created_at, lean_mass_kg)",
+    };
+    for (const QString& sql : statements) {
+        if (!query.exec(sql)) {
+            qCritical() << "Error al actualizar los índices de masa magra:" << query.lastError().text();
+            return false;
+        }
+    }
+    qInfo() << "Migración v12 aplicada: índice de historial de masa magra.";
+    return true;
+}
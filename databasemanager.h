@@ -30,6 +30,14 @@ public:
     void closeDatabase();
     bool isDatabaseOpen() const;
 
+    // Catálogo de alimentos (FoodCatalog): archivo binario junto a la base de datos,
+    // p. ej. nutricion.db -> nutricion.foods.bin. Se abre al final de initialize*.
+    static QString foodCatalogPathFor(const QString& dbFilePath);
+    QString foodCatalogPath() const;
+    // Almacén de fotos de progreso (PhotoStore): nutricion.db -> nutricion.photos/
+    static QString photoStorePathFor(const QString& dbFilePath);
+    QString photoStorePath() const;
+
 private:
     QSqlDatabase m_db; // El objeto principal de la base de datos de Qt
     DatabaseType m_currentDbType; // Guarda el tipo de base de datos que se está usando
@@ -49,6 +57,37 @@ private:
     // El SQL usado aquí es compatible con SQLite y MariaDB/MySQL
     bool createUsersTable();
     bool createHealthMetricsTable();
+    // Tabla clave/valor para metadatos de la aplicación (p. ej. contadores de cambios)
+    bool createAppMetaTable();
+    // Estado por paciente de la previsión de peso (WeightForecaster)
+    bool createWeightForecastTable();
+    // Cola de mediciones sospechosas pendientes de revisar (MetricAnomalyDetector)
+    bool createMetricReviewQueueTable();
+    // Alertas clínicas emitidas y última visita por paciente (ClinicalAlertEngine)
+    bool createClinicalAlertTables();
+    // Resúmenes de peso/IMC por semana, mes y año (MetricRollups)
+    bool createMetricRollupsTable();
+    QString autoIncrementPrimaryKey() const;
+    // Migraciones del esquema. La versión aplicada se guarda en app_meta ('schema_version')
+    // y cada paso se ejecuta una sola vez, en orden.
+    bool migrateSchema();
+    int schemaVersion();
+    bool setSchemaVersion(int version);
+    bool migrateUsersSortKey(); // v1: clave de ordenación española indexada en 'users'
+    bool migrateBodyCompositionColumns(); // v2: masa grasa/magra, FFMI y categoría de IMC generadas
+    bool migrateRecipeTables(); // v4: recetas, ingredientes y planes de dieta (RecipeGraph)
+    bool migrateFoodDiaryTables(); // v5: diario de alimentación y resumen diario (FoodDiary)
+    bool migrateMealPlanTables(); // v6: exclusiones, precios y planes semanales (MealPlanOptimizer)
+    bool migrateAppointmentTables(); // v7: citas y mediciones de cada visita (AppointmentScheduler)
+    bool migratePhotoTables(); // v8: metadatos de las fotos de progreso (PhotoStore)
+    bool migrateImportTables(); // v9: IDs externos de pacientes y puntos de control (BulkImporter)
+    bool migrateMetricReviewQueue(); // v10: cola de revisión con una entrada por medición y regla
+    bool migrateRollupBmiCount(); // v11: resúmenes recalculados sin las mediciones de IMC 0
+    bool migrateLeanMassIndex(); // v12: índice de historial de masa magra en lugar de los de un solo valor
+
+    // Índice de texto completo sobre health_metrics.notes (FTS5 en SQLite, FULLTEXT en MariaDB).
+    // No es crítico: si el motor no lo soporta la búsqueda de notas recurre a LIKE.
+    bool createHealthMetricsNotesIndex();
 };
 
 #endif // DATABASEMANAGER_H
@@ -0,0 +1,12 @@
+#include "datachangehub.h"
+
+DataChangeHub::DataChangeHub(QObject *parent) : QObject(parent)
+{
+}
+
+DataChangeHub* DataChangeHub::instance()
+{
+    // Se crea en el primer uso y vive hasta el final del proceso
+    static DataChangeHub hub;
+    return &hub;
+}
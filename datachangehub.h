@@ -0,0 +1,34 @@
+#ifndef DATACHANGEHUB_H
+#define DATACHANGEHUB_H
+
+#include <QList>
+#include <QObject>
+
+// Punto único de aviso de cambios en los datos.
+// Cada ventana crea sus propios gestores (UserManager, HealthMetricManager), así que
+// las cachés e índices en memoria se suscriben aquí en lugar de a una instancia concreta.
+class DataChangeHub : public QObject
+{
+    Q_OBJECT
+
+public:
+    static DataChangeHub* instance();
+
+signals:
+    void userAdded(int userId);
+    void userUpdated(int userId);
+    void userDeleted(int userId);
+
+    void healthMetricAdded(int userId, int metricId);
+    void healthMetricUpdated(int userId, int metricId);
+    void healthMetricDeleted(int userId, int metricId);
+
+    // Importación masiva (BulkImporter): no hay avisos por fila; las cachés se recargan una vez
+    // con los pacientes que recibieron datos nuevos
+    void bulkImportCompleted(const QList<int>& userIds);
+
+private:
+    explicit DataChangeHub(QObject *parent = nullptr);
+};
+
+#endif // DATACHANGEHUB_H
@@ -0,0 +1,212 @@
+#include "dataexporter.h"
+#include "arrowipcwriter.h"
+#include <QAtomicInteger>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <iterator>
+
+namespace {
+
+const qint64 kProgressEvery = 4096; // Filas entre avisos de progreso
+
+struct SourceColumn {
+    const char* sql;
+    ExportWriter::ColumnType type;
+};
+
+const SourceColumn kPatientColumns[] = {
+    { "user_id", ExportWriter::IntegerColumn },
+    { "first_name", ExportWriter::TextColumn },
+    { "last_name1", ExportWriter::TextColumn },
+    { "last_name2", ExportWriter::TextColumn },
+    { "gender", ExportWriter::TextColumn },
+    { "birth_date", ExportWriter::DateColumn },
+    { "activity_level", ExportWriter::TextColumn },
+    { "goal", ExportWriter::TextColumn },
+    { "created_at", ExportWriter::DateTimeColumn },
+};
+
+const SourceColumn kMetricColumns[] = {
+    { "metric_id", ExportWriter::IntegerColumn },
+    { "user_id", ExportWriter::IntegerColumn },
+    { "date", ExportWriter::DateColumn },
+    { "weight", ExportWriter::RealColumn },
+    { "height", ExportWriter::RealColumn },
+    { "bmi", ExportWriter::RealColumn },
+    { "body_fat_percentage", ExportWriter::RealColumn },
+    { "muscle_mass_percentage", ExportWriter::RealColumn },
+    { "notes", ExportWriter::TextColumn },
+    { "created_at", ExportWriter::DateTimeColumn },
+    { "fat_mass_kg", ExportWriter::RealColumn },
+    { "lean_mass_kg", ExportWriter::RealColumn },
+    { "ffmi", ExportWriter::RealColumn },
+    { "bmi_category", ExportWriter::IntegerColumn },
+};
+
+ExportWriter* createWriter(DataExporter::Format format, ExportSink& sink)
+{
+    switch (format) {
+    case DataExporter::Csv:
+        return new CsvExportWriter(sink);
+    case DataExporter::JsonLines:
+        return new JsonLinesExportWriter(sink);
+    case DataExporter::ArrowIpc:
+        return new ArrowIpcExportWriter(sink);
+    }
+    return nullptr;
+}
+
+} // namespace
+
+QString DataExporter::fileSuffix(Format format, ExportSink::Compression compression)
+{
+    QString suffix = format == Csv ? ".csv" : format == JsonLines ? ".jsonl" : ".arrow";
+    if (compression == ExportSink::GzipCompression) {
+        suffix += ".gz";
+    }
+    return suffix;
+}
+
+bool DataExporter::exportTo(const QString& filePath, Dataset dataset, Format format,
+                            ExportSink::Compression compression, const Filter& filter,
+                            Result* result, QString* error, const Progress& progress)
+{
+    static QAtomicInteger<quint64> counter;
+    const QString connectionName = QString("export_%1").arg(counter.fetchAndAddRelaxed(1));
+    bool exported = false;
+    {
+        QSqlDatabase db = QSqlDatabase::cloneDatabase(QString(QSqlDatabase::defaultConnection), connectionName);
+        if (db.open()) {
+            exported = exportWith(db, filePath, dataset, format, compression, filter, result, error, progress);
+        } else {
+            qWarning() << "Exportación fallida: no se pudo abrir la conexión" << connectionName << ":" << db.lastError().text();
+            if (error) {
+                *error = "No se pudo abrir la base de datos: " + db.lastError().text();
+            }
+        }
+        db.close();
+    }
+    // Fuera del bloque: no queda ninguna QSqlDatabase ni QSqlQuery que use la conexión
+    QSqlDatabase::removeDatabase(connectionName);
+    return exported;
+}
+
+bool DataExporter::exportWith(const QSqlDatabase& db, const QString& filePath, Dataset dataset, Format format,
+                              ExportSink::Compression compression, const Filter& filter, Result* result,
+                              QString* error, const Progress& progress)
+{
+    auto fail = [error](const QString& message) {
+        qWarning() << "Exportación fallida:" << message;
+        if (error) {
+            *error = message;
+        }
+        return false;
+    };
+    QElapsedTimer timer;
+    timer.start();
+
+    // 1. Columnas y consulta
+    const bool metrics = dataset == HealthMetrics;
+    const SourceColumn* source = metrics ? kMetricColumns : kPatientColumns;
+    const int columnCount = metrics ? int(std::size(kMetricColumns)) : int(std::size(kPatientColumns));
+    QVector<ExportWriter::Column> columns;
+    QStringList select;
+    for (int c = 0; c < columnCount; ++c) {
+        columns.append({ QString::fromLatin1(source[c].sql), source[c].type });
+        select << source[c].sql;
+    }
+
+    QStringList conditions;
+    const QString dateColumn = metrics ? "date" : "created_at";
+    if (filter.from.isValid()) {
+        conditions << dateColumn + " >= :from";
+    }
+    if (filter.to.isValid()) {
+        conditions << dateColumn + " < :to"; // Fin de día incluido también para created_at
+    }
+    if (!filter.userIds.isEmpty()) {
+        QStringList ids;
+        for (int userId : filter.userIds) {
+            ids << QString::number(userId);
+        }
+        conditions << QString("user_id IN (%1)").arg(ids.join(','));
+    }
+    const QString table = metrics ? "health_metrics" : "users";
+    const QString where = conditions.isEmpty() ? QString() : " WHERE " + conditions.join(" AND ");
+    // Orden por clave primaria: SQLite recorre la tabla sin ordenar nada en memoria
+    const QString sql = QString("SELECT %1 FROM %2%3 ORDER BY %4")
+                            .arg(select.join(", "), table, where, metrics ? "metric_id" : "user_id");
+
+    auto bindFilter = [&filter](QSqlQuery& q) {
+        if (filter.from.isValid()) {
+            q.bindValue(":from", filter.from.toString(Qt::ISODate));
+        }
+        if (filter.to.isValid()) {
+            q.bindValue(":to", filter.to.addDays(1).toString(Qt::ISODate));
+        }
+    };
+    // Total para el progreso: solo se cuenta si alguien lo va a mostrar
+    qint64 total = 0;
+    if (progress) {
+        QSqlQuery count(db);
+        count.prepare(QString("SELECT COUNT(*) FROM %1%2").arg(table, where));
+        bindFilter(count);
+        if (!count.exec() || !count.next()) {
+            return fail("Error al contar los datos: " + count.lastError().text());
+        }
+        total = count.value(0).toLongLong();
+        if (!progress(0, total)) {
+            return fail("Exportación cancelada.");
+        }
+    }
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true); // Sin caché de filas en el controlador
+    query.prepare(sql);
+    bindFilter(query);
+    if (!query.exec()) {
+        return fail("Error al leer los datos: " + query.lastError().text());
+    }
+
+    // 2. Volcado fila a fila
+    ExportSink sink;
+    if (!sink.open(filePath, compression)) {
+        return fail(sink.errorString());
+    }
+    QScopedPointer<ExportWriter> writer(createWriter(format, sink));
+    if (!writer->begin(columns)) {
+        return fail(sink.errorString());
+    }
+    QVector<QVariant> values(columnCount);
+    qint64 rows = 0;
+    while (query.next()) {
+        for (int c = 0; c < columnCount; ++c) {
+            values[c] = query.value(c);
+        }
+        if (!writer->writeRow(values)) {
+            return fail(sink.errorString());
+        }
+        ++rows;
+        if (progress && rows % kProgressEvery == 0 && !progress(rows, total)) {
+            return fail("Exportación cancelada."); // Sin commit: QSaveFile descarta el archivo a medias
+        }
+    }
+    if (query.lastError().isValid()) {
+        return fail("Error al leer los datos: " + query.lastError().text());
+    }
+    if (!writer->finish() || !sink.commit()) {
+        return fail(sink.errorString());
+    }
+
+    if (result) {
+        result->rows = rows;
+        result->bytes = sink.bytesWritten();
+        result->elapsedMs = timer.elapsed();
+    }
+    qInfo() << "Exportadas" << rows << "filas a" << filePath << "en" << timer.elapsed() << "ms";
+    return true;
+}
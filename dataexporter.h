@@ -0,0 +1,58 @@
+#ifndef DATAEXPORTER_H
+#define DATAEXPORTER_H
+
+#include <QDate>
+#include <QList>
+#include <QSqlDatabase>
+#include <QString>
+#include <functional>
+#include "exportwriter.h"
+
+// Extractos de 'users' y 'health_metrics' para análisis externo (CSV, JSON Lines o Arrow IPC).
+// Las filas se leen con una consulta de solo avance y pasan una a una al ExportWriter del formato,
+// que escribe en un ExportSink con búfer: la memoria no depende del tamaño de la base de datos.
+// exportTo abre su propia conexión, así que se puede llamar desde un hilo de trabajo.
+class DataExporter
+{
+public:
+    enum Dataset {
+        Patients,
+        HealthMetrics
+    };
+
+    enum Format {
+        Csv,
+        JsonLines,
+        ArrowIpc
+    };
+
+    // Filtros opcionales. Mediciones: por fecha de la medición; pacientes: por fecha de alta.
+    struct Filter {
+        QDate from;
+        QDate to;
+        QList<int> userIds; // Vacío = todos los pacientes
+    };
+
+    struct Result {
+        qint64 rows = 0;
+        qint64 bytes = 0; // Tamaño del archivo (comprimido si procede)
+        qint64 elapsedMs = 0;
+    };
+
+    // Filas escritas y total; devuelve false para cancelar (el archivo anterior no se toca)
+    using Progress = std::function<bool(qint64 rows, qint64 total)>;
+
+    static bool exportTo(const QString& filePath, Dataset dataset, Format format,
+                         ExportSink::Compression compression, const Filter& filter = Filter(),
+                         Result* result = nullptr, QString* error = nullptr, const Progress& progress = Progress());
+
+    // ".csv", ".jsonl", ".arrow" y ".gz" si va comprimido
+    static QString fileSuffix(Format format, ExportSink::Compression compression);
+
+private:
+    static bool exportWith(const QSqlDatabase& db, const QString& filePath, Dataset dataset, Format format,
+                           ExportSink::Compression compression, const Filter& filter, Result* result,
+                           QString* error, const Progress& progress);
+};
+
+#endif // DATAEXPORTER_H
@@ -0,0 +1,228 @@
+#include "energycalculator.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cstddef>
+
+namespace {
+
+struct Factor {
+    const char* name;
+    double value;
+};
+
+// Mismos textos que los QComboBox de MainWindow::setupComboBoxes
+constexpr Factor kActivityFactors[] = {
+    { "Sedentario", 1.2 },
+    { "Ligero", 1.375 },
+    { "Moderado", 1.55 },
+    { "Activo", 1.725 },
+    { "Muy Activo", 1.9 },
+};
+constexpr double kDefaultActivityFactor = 1.2;
+
+// Ajuste multiplicativo sobre el TDEE
+constexpr Factor kGoalFactors[] = {
+    { "Perder peso", 0.80 },   // Déficit del 20 %
+    { "Mantener peso", 1.0 },
+    { "Ganar musculo", 1.10 }, // Superávit del 10 %
+    { "Mejorar salud", 1.0 },
+    { "Otro", 1.0 },
+};
+constexpr double kDefaultGoalFactor = 1.0;
+
+// Coeficientes: valor para mujer (sexOffset = -1) y para hombre (+1); con 0 queda la media
+struct SexCoefficient {
+    double female;
+    double male;
+    constexpr double mid() const { return (female + male) / 2.0; }
+    constexpr double half() const { return (male - female) / 2.0; }
+};
+
+// Mifflin-St Jeor: 10 peso + 6,25 altura - 5 edad + s (s = +5 hombre, -161 mujer)
+constexpr SexCoefficient kMifflinConstant = { -161.0, 5.0 };
+// Harris-Benedict revisada
+constexpr SexCoefficient kHarrisConstant = { 447.593, 88.362 };
+constexpr SexCoefficient kHarrisWeight = { 9.247, 13.397 };
+constexpr SexCoefficient kHarrisHeight = { 3.098, 4.799 };
+constexpr SexCoefficient kHarrisAge = { 4.330, 5.677 };
+// Katch-McArdle: 370 + 21,6 masa magra
+constexpr double kKatchConstant = 370.0;
+constexpr double kKatchLeanMass = 21.6;
+
+template <std::size_t N>
+double lookup(const Factor (&table)[N], const QString& name, double fallback)
+{
+    for (const Factor& factor : table) {
+        if (name.compare(QLatin1String(factor.name), Qt::CaseInsensitive) == 0) {
+            return factor.value;
+        }
+    }
+    return fallback;
+}
+
+double ageInYears(const QDate& birthDate, const QDate& asOf)
+{
+    if (!birthDate.isValid() || !asOf.isValid()) {
+        return -1.0;
+    }
+    return birthDate.daysTo(asOf) / 365.2425;
+}
+
+} // namespace
+
+double EnergyCalculator::activityFactorFor(const QString& activityLevel)
+{
+    return lookup(kActivityFactors, activityLevel.trimmed(), kDefaultActivityFactor);
+}
+
+double EnergyCalculator::goalFactorFor(const QString& goal)
+{
+    return lookup(kGoalFactors, goal.trimmed(), kDefaultGoalFactor);
+}
+
+double EnergyCalculator::sexOffsetFor(const QString& gender)
+{
+    const QString value = User::normalizeGender(gender); // "Mujer" no debe contar como Masculino
+    if (value == "Masculino") {
+        return 1.0;
+    }
+    if (value == "Femenino") {
+        return -1.0;
+    }
+    return 0.0;
+}
+
+void EnergyCalculator::Batch::reserve(int count)
+{
+    for (QVector<double>* column : { &weightKg, &heightCm, &ageYears, &bodyFatPercentage, &sexOffset,
+                                     &activityFactor, &goalFactor }) {
+        column->reserve(count);
+    }
+}
+
+void EnergyCalculator::computeBatch(Batch& batch)
+{
+    const int n = batch.size();
+    for (QVector<double>* column : { &batch.mifflinStJeor, &batch.harrisBenedict, &batch.katchMcArdle,
+                                     &batch.bmr, &batch.tdee, &batch.targetKcal }) {
+        column->resize(n);
+    }
+
+    const double* weight = batch.weightKg.constData();
+    const double* height = batch.heightCm.constData();
+    const double* age = batch.ageYears.constData();
+    const double* fat = batch.bodyFatPercentage.constData();
+    const double* sex = batch.sexOffset.constData();
+    const double* activity = batch.activityFactor.constData();
+    const double* goal = batch.goalFactor.constData();
+    double* mifflin = batch.mifflinStJeor.data();
+    double* harris = batch.harrisBenedict.data();
+    double* katch = batch.katchMcArdle.data();
+    double* bmr = batch.bmr.data();
+    double* tdee = batch.tdee.data();
+    double* target = batch.targetKcal.data();
+
+    // Cada coeficiente dependiente del sexo se escribe como media + s * semidiferencia,
+    // así el bucle no tiene ramas y se vectoriza
+    for (int i = 0; i < n; ++i) {
+        mifflin[i] = 10.0 * weight[i] + 6.25 * height[i] - 5.0 * age[i]
+                     + kMifflinConstant.mid() + sex[i] * kMifflinConstant.half();
+        harris[i] = (kHarrisConstant.mid() + sex[i] * kHarrisConstant.half())
+                    + (kHarrisWeight.mid() + sex[i] * kHarrisWeight.half()) * weight[i]
+                    + (kHarrisHeight.mid() + sex[i] * kHarrisHeight.half()) * height[i]
+                    - (kHarrisAge.mid() + sex[i] * kHarrisAge.half()) * age[i];
+        const double hasFat = fat[i] > 0.0 ? 1.0 : 0.0;
+        katch[i] = hasFat * (kKatchConstant + kKatchLeanMass * weight[i] * (1.0 - fat[i] / 100.0));
+        bmr[i] = hasFat * katch[i] + (1.0 - hasFat) * mifflin[i];
+        tdee[i] = bmr[i] * activity[i];
+        target[i] = tdee[i] * goal[i];
+    }
+}
+
+EnergyCalculator::Estimate EnergyCalculator::estimate(const User& user, const HealthMetric& metric, const QDate& asOf)
+{
+    Estimate result;
+    const double age = ageInYears(user.birthDate(), asOf);
+    if (metric.weight() <= 0 || metric.height() <= 0 || age < 0) {
+        return result;
+    }
+
+    Batch batch;
+    batch.weightKg.append(metric.weight());
+    batch.heightCm.append(metric.height());
+    batch.ageYears.append(age);
+    batch.bodyFatPercentage.append(metric.bodyFatPercentage());
+    batch.sexOffset.append(sexOffsetFor(user.gender()));
+    batch.activityFactor.append(activityFactorFor(user.activityLevel()));
+    batch.goalFactor.append(goalFactorFor(user.goal()));
+    computeBatch(batch);
+
+    result.valid = true;
+    result.ageYears = age;
+    result.mifflinStJeor = batch.mifflinStJeor.at(0);
+    result.harrisBenedict = batch.harrisBenedict.at(0);
+    result.katchMcArdle = batch.katchMcArdle.at(0);
+    result.bmr = batch.bmr.at(0);
+    result.activityFactor = batch.activityFactor.at(0);
+    result.tdee = batch.tdee.at(0);
+    result.goalFactor = batch.goalFactor.at(0);
+    result.targetKcal = batch.targetKcal.at(0);
+    return result;
+}
+
+QHash<int, EnergyCalculator::Estimate> EnergyCalculator::estimateAll(const QList<QSharedPointer<User>>& users,
+                                                                     const QHash<int, HealthMetric>& latestMetrics,
+                                                                     const QDate& asOf)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Batch batch;
+    batch.reserve(users.size());
+    QVector<int> ids;
+    ids.reserve(users.size());
+
+    for (const QSharedPointer<User>& user : users) {
+        if (!user) {
+            continue;
+        }
+        auto it = latestMetrics.constFind(user->id());
+        if (it == latestMetrics.cend()) {
+            continue;
+        }
+        const double age = ageInYears(user->birthDate(), asOf);
+        if (it->weight() <= 0 || it->height() <= 0 || age < 0) {
+            continue;
+        }
+        ids.append(user->id());
+        batch.weightKg.append(it->weight());
+        batch.heightCm.append(it->height());
+        batch.ageYears.append(age);
+        batch.bodyFatPercentage.append(it->bodyFatPercentage());
+        batch.sexOffset.append(sexOffsetFor(user->gender()));
+        batch.activityFactor.append(activityFactorFor(user->activityLevel()));
+        batch.goalFactor.append(goalFactorFor(user->goal()));
+    }
+
+    computeBatch(batch);
+
+    QHash<int, Estimate> results;
+    results.reserve(ids.size());
+    for (int i = 0; i < ids.size(); ++i) {
+        Estimate estimate;
+        estimate.valid = true;
+        estimate.ageYears = batch.ageYears.at(i);
+        estimate.mifflinStJeor = batch.mifflinStJeor.at(i);
+        estimate.harrisBenedict = batch.harrisBenedict.at(i);
+        estimate.katchMcArdle = batch.katchMcArdle.at(i);
+        estimate.bmr = batch.bmr.at(i);
+        estimate.activityFactor = batch.activityFactor.at(i);
+        estimate.tdee = batch.tdee.at(i);
+        estimate.goalFactor = batch.goalFactor.at(i);
+        estimate.targetKcal = batch.targetKcal.at(i);
+        results.insert(ids.at(i), estimate);
+    }
+
+    qInfo() << "Objetivos calóricos recalculados para" << results.size() << "pacientes en" << timer.elapsed() << "ms";
+    return results;
+}
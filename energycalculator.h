@@ -0,0 +1,75 @@
+#ifndef ENERGYCALCULATOR_H
+#define ENERGYCALCULATOR_H
+
+#include <QDate>
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include "user.h"
+#include "healtmetric.h"
+
+// Cálculo de necesidades energéticas: metabolismo basal (BMR), gasto total (TDEE = BMR x factor
+// de actividad) y objetivo calórico (TDEE x ajuste según el objetivo del paciente).
+//  - Mifflin-St Jeor: fórmula de referencia cuando no hay % de grasa.
+//  - Harris-Benedict (revisión de Roza y Shizgal, 1984): se informa como comparación.
+//  - Katch-McArdle: se usa como BMR principal cuando la medición incluye % de grasa corporal.
+// Los factores de actividad y de objetivo son tablas constexpr indexadas por los textos de la UI.
+class EnergyCalculator
+{
+public:
+    struct Estimate {
+        bool valid = false;        // false si faltan peso, altura o fecha de nacimiento
+        double ageYears = 0.0;
+        double mifflinStJeor = 0.0;
+        double harrisBenedict = 0.0;
+        double katchMcArdle = 0.0; // 0 si la medición no tiene % de grasa
+        double bmr = 0.0;          // Katch-McArdle si hay % de grasa; si no, Mifflin-St Jeor
+        double activityFactor = 1.0;
+        double tdee = 0.0;
+        double goalFactor = 1.0;
+        double targetKcal = 0.0;
+    };
+
+    // Estimación para un paciente con su última medición
+    static Estimate estimate(const User& user, const HealthMetric& metric, const QDate& asOf = QDate::currentDate());
+
+    // Datos de toda la clínica en columnas (un elemento por paciente) para el cálculo en bloque.
+    // sexOffset: +1 hombre, -1 mujer, 0 sin especificar (se usa la media de ambas fórmulas).
+    struct Batch {
+        QVector<double> weightKg;
+        QVector<double> heightCm;
+        QVector<double> ageYears;
+        QVector<double> bodyFatPercentage; // 0 si no se midió
+        QVector<double> sexOffset;
+        QVector<double> activityFactor;
+        QVector<double> goalFactor;
+
+        // Salidas
+        QVector<double> mifflinStJeor;
+        QVector<double> harrisBenedict;
+        QVector<double> katchMcArdle;
+        QVector<double> bmr;
+        QVector<double> tdee;
+        QVector<double> targetKcal;
+
+        void reserve(int count);
+        int size() const { return int(weightKg.size()); }
+    };
+
+    // Bucles sin ramas sobre columnas contiguas (el compilador los vectoriza)
+    static void computeBatch(Batch& batch);
+
+    // Recalcula el objetivo de todos los pacientes a partir de su última medición
+    // (HealthMetricManager::getLatestHealthMetricForAllUsers). Solo incluye los que tienen datos válidos.
+    static QHash<int, Estimate> estimateAll(const QList<QSharedPointer<User>>& users,
+                                            const QHash<int, HealthMetric>& latestMetrics,
+                                            const QDate& asOf = QDate::currentDate());
+
+    static double activityFactorFor(const QString& activityLevel);
+    static double goalFactorFor(const QString& goal);
+    static double sexOffsetFor(const QString& gender);
+};
+
+#endif // ENERGYCALCULATOR_H
@@ -0,0 +1,248 @@
+#include "exportwriter.h"
+#include <QDate>
+#include <QDateTime>
+#include <QDebug>
+#include <QLocale>
+#include <QtEndian>
+#include <cmath>
+
+namespace {
+
+const qsizetype kBufferSize = 1 << 20;
+
+// CRC-32 de gzip (polinomio 0xEDB88320)
+quint32 crc32(const QByteArray& data)
+{
+    static const QVector<quint32> table = [] {
+        QVector<quint32> t(256);
+        for (quint32 n = 0; n < 256; ++n) {
+            quint32 c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[int(n)] = c;
+        }
+        return t;
+    }();
+    quint32 crc = 0xFFFFFFFFu;
+    for (const char byte : data) {
+        crc = table[int((crc ^ quint8(byte)) & 0xFF)] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Un miembro gzip (RFC 1952) con el contenido del búfer. qCompress ya produce deflate dentro de
+// un envoltorio zlib; basta con quitar el envoltorio y poner la cabecera y la cola de gzip.
+QByteArray gzipMember(const QByteArray& data)
+{
+    const QByteArray zlib = qCompress(data, 6); // [tamaño 4 B][cabecera zlib 2 B][deflate][adler32 4 B]
+    QByteArray member;
+    member.reserve(zlib.size() + 8);
+    static const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+    member.append(header, sizeof(header));
+    member.append(zlib.constData() + 6, zlib.size() - 10);
+    char trailer[8];
+    qToLittleEndian<quint32>(crc32(data), trailer);
+    qToLittleEndian<quint32>(quint32(data.size()), trailer + 4);
+    member.append(trailer, sizeof(trailer));
+    return member;
+}
+
+QByteArray formatValue(const QVariant& value, ExportWriter::ColumnType type)
+{
+    switch (type) {
+    case ExportWriter::IntegerColumn:
+        return QByteArray::number(value.toLongLong());
+    case ExportWriter::RealColumn: {
+        const double number = value.toDouble();
+        return std::isfinite(number) ? QByteArray::number(number, 'g', QLocale::FloatingPointShortest) : QByteArray();
+    }
+    case ExportWriter::DateColumn:
+        return value.toDate().toString(Qt::ISODate).toLatin1();
+    case ExportWriter::DateTimeColumn:
+        return value.toDateTime().toString(Qt::ISODate).toLatin1();
+    case ExportWriter::TextColumn:
+        break;
+    }
+    return value.toString().toUtf8();
+}
+
+void appendJsonString(QByteArray& out, const QByteArray& utf8)
+{
+    static const char hex[] = "0123456789abcdef";
+    out.append('"');
+    for (const char c : utf8) {
+        switch (c) {
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\t': out.append("\\t"); break;
+        default:
+            if (quint8(c) < 0x20) {
+                out.append("\\u00");
+                out.append(hex[quint8(c) >> 4]);
+                out.append(hex[quint8(c) & 0xF]);
+            } else {
+                out.append(c); // UTF-8 tal cual: JSON lo admite sin escapar
+            }
+        }
+    }
+    out.append('"');
+}
+
+} // namespace
+
+// --- ExportSink ---
+
+ExportSink::ExportSink()
+    : m_compression(NoCompression)
+    , m_position(0)
+    , m_bytesWritten(0)
+{
+}
+
+bool ExportSink::open(const QString& filePath, Compression compression)
+{
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        m_error = QString("No se pudo crear %1: %2").arg(filePath, m_file.errorString());
+        return false;
+    }
+    m_compression = compression;
+    m_buffer.clear();
+    m_buffer.reserve(kBufferSize);
+    m_position = 0;
+    m_bytesWritten = 0;
+    return true;
+}
+
+bool ExportSink::write(const char* data, qsizetype size)
+{
+    m_position += size;
+    while (size > 0) {
+        const qsizetype chunk = qMin(size, kBufferSize - m_buffer.size());
+        m_buffer.append(data, chunk);
+        data += chunk;
+        size -= chunk;
+        if (m_buffer.size() >= kBufferSize && !flushBuffer()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ExportSink::flushBuffer()
+{
+    if (m_buffer.isEmpty()) {
+        return true;
+    }
+    const QByteArray out = m_compression == GzipCompression ? gzipMember(m_buffer) : m_buffer;
+    if (m_file.write(out) != out.size()) {
+        m_error = QString("Error al escribir %1: %2").arg(m_file.fileName(), m_file.errorString());
+        return false;
+    }
+    m_bytesWritten += out.size();
+    m_buffer.clear(); // Conserva la reserva
+    return true;
+}
+
+bool ExportSink::commit()
+{
+    if (!flushBuffer()) {
+        m_file.cancelWriting();
+        return false;
+    }
+    if (!m_file.commit()) {
+        m_error = QString("No se pudo guardar %1: %2").arg(m_file.fileName(), m_file.errorString());
+        return false;
+    }
+    return true;
+}
+
+// --- CSV ---
+
+bool CsvExportWriter::begin(const QVector<Column>& columns)
+{
+    m_columns = columns;
+    m_line.clear();
+    for (int c = 0; c < columns.size(); ++c) {
+        if (c > 0) {
+            m_line.append(',');
+        }
+        m_line.append(columns[c].name.toUtf8());
+    }
+    m_line.append("\r\n");
+    return m_sink.write(m_line);
+}
+
+bool CsvExportWriter::writeRow(const QVector<QVariant>& values)
+{
+    m_line.clear();
+    for (int c = 0; c < m_columns.size(); ++c) {
+        if (c > 0) {
+            m_line.append(',');
+        }
+        const QVariant& value = values[c];
+        if (value.isNull()) {
+            continue; // Campo vacío
+        }
+        const QByteArray field = formatValue(value, m_columns[c].type);
+        if (m_columns[c].type == TextColumn
+            && (field.contains(',') || field.contains('"') || field.contains('\n') || field.contains('\r'))) {
+            m_line.append('"');
+            for (const char ch : field) {
+                if (ch == '"') {
+                    m_line.append('"');
+                }
+                m_line.append(ch);
+            }
+            m_line.append('"');
+        } else {
+            m_line.append(field);
+        }
+    }
+    m_line.append("\r\n");
+    return m_sink.write(m_line);
+}
+
+// --- JSON Lines ---
+
+bool JsonLinesExportWriter::begin(const QVector<Column>& columns)
+{
+    m_columns = columns;
+    m_keys.clear();
+    for (const Column& column : columns) {
+        QByteArray key;
+        appendJsonString(key, column.name.toUtf8());
+        key.append(':');
+        m_keys.append(key);
+    }
+    return true;
+}
+
+bool JsonLinesExportWriter::writeRow(const QVector<QVariant>& values)
+{
+    m_line.clear();
+    m_line.append('{');
+    for (int c = 0; c < m_columns.size(); ++c) {
+        if (c > 0) {
+            m_line.append(',');
+        }
+        m_line.append(m_keys[c]);
+        const QVariant& value = values[c];
+        const ColumnType type = m_columns[c].type;
+        const QByteArray field = value.isNull() ? QByteArray() : formatValue(value, type);
+        if (field.isEmpty() && type != TextColumn) {
+            m_line.append("null"); // Nulo, fecha inválida o número no finito
+        } else if (value.isNull()) {
+            m_line.append("null");
+        } else if (type == IntegerColumn || type == RealColumn) {
+            m_line.append(field);
+        } else {
+            appendJsonString(m_line, field);
+        }
+    }
+    m_line.append("}\n");
+    return m_sink.write(m_line);
+}
@@ -0,0 +1,105 @@
+#ifndef EXPORTWRITER_H
+#define EXPORTWRITER_H
+
+#include <QByteArray>
+#include <QSaveFile>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+// Salida de una exportación: acumula lo escrito en un búfer de 1 MB y lo vuelca al archivo de una
+// vez, opcionalmente comprimido con gzip (un miembro gzip por búfer: 'gzip -d', Python, R o DuckDB
+// leen los miembros concatenados como un solo archivo). Se escribe con QSaveFile: una exportación
+// que falla a medias no reemplaza el archivo anterior.
+class ExportSink
+{
+public:
+    enum Compression {
+        NoCompression,
+        GzipCompression
+    };
+
+    ExportSink();
+
+    bool open(const QString& filePath, Compression compression);
+    bool write(const char* data, qsizetype size);
+    bool write(const QByteArray& data) { return write(data.constData(), data.size()); }
+    // Bytes escritos antes de comprimir (las posiciones de Arrow se cuentan sobre ellos)
+    qint64 position() const { return m_position; }
+    // Bytes en el archivo final
+    qint64 bytesWritten() const { return m_bytesWritten; }
+    bool commit();
+    QString errorString() const { return m_error; }
+
+private:
+    bool flushBuffer();
+
+    QSaveFile m_file;
+    Compression m_compression;
+    QByteArray m_buffer;
+    qint64 m_position;
+    qint64 m_bytesWritten;
+    QString m_error;
+};
+
+// Formato de una exportación. DataExporter lee las filas con una consulta de solo avance y se las
+// pasa una a una; cada formato decide cuánto acumula antes de escribir en el ExportSink.
+class ExportWriter
+{
+public:
+    enum ColumnType {
+        IntegerColumn,  // Entero de 64 bits
+        RealColumn,     // Doble precisión
+        TextColumn,     // UTF-8
+        DateColumn,     // Fecha sin hora
+        DateTimeColumn  // Fecha y hora local, precisión de milisegundos
+    };
+
+    struct Column {
+        QString name;
+        ColumnType type;
+    };
+
+    explicit ExportWriter(ExportSink& sink) : m_sink(sink) {}
+    virtual ~ExportWriter() = default;
+
+    virtual bool begin(const QVector<Column>& columns) = 0;
+    // Un valor por columna; un QVariant nulo es un valor ausente
+    virtual bool writeRow(const QVector<QVariant>& values) = 0;
+    virtual bool finish() = 0;
+
+protected:
+    ExportSink& m_sink;
+    QVector<Column> m_columns;
+};
+
+// CSV (RFC 4180): cabecera con los nombres de columna, separador ',' y comillas solo donde hacen falta
+class CsvExportWriter : public ExportWriter
+{
+public:
+    explicit CsvExportWriter(ExportSink& sink) : ExportWriter(sink) {}
+
+    bool begin(const QVector<Column>& columns) override;
+    bool writeRow(const QVector<QVariant>& values) override;
+    bool finish() override { return true; }
+
+private:
+    QByteArray m_line;
+};
+
+// JSON Lines: un objeto por fila; los valores ausentes se escriben como null
+class JsonLinesExportWriter : public ExportWriter
+{
+public:
+    explicit JsonLinesExportWriter(ExportSink& sink) : ExportWriter(sink) {}
+
+    bool begin(const QVector<Column>& columns) override;
+    bool writeRow(const QVector<QVariant>& values) override;
+    bool finish() override { return true; }
+
+private:
+    QVector<QByteArray> m_keys; // "nombre": ya escapado
+    QByteArray m_line;
+};
+
+#endif // EXPORTWRITER_H
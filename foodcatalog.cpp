@@ -0,0 +1,724 @@
+#include "foodcatalog.h"
+#include "textnormalizer.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// Formato del archivo (little-endian; el catálogo solo se abre en máquinas little-endian,
+// porque las columnas se leen directamente del mapeo sin convertir):
+//   FileHeader | secciones alineadas a 8 bytes en el orden de Section
+//   tabla de cadenas: quint32 desplazamientos[n + 1] | bytes UTF-8
+//   Values: float[nutrientes][alimentos], una columna contigua por nutriente
+//   Words: WordEntry ordenadas por el texto de la palabra (apuntan a FoldedNames)
+//   TrigramKeys: quint32 ordenados | TrigramOffsets: quint32[n + 1] | TrigramPostings: quint32 alimentos
+const char kMagic[4] = { 'N', 'F', 'C', 'T' };
+const quint32 kFormatVersion = 1;
+
+enum Section {
+    FoodCodes,
+    FoodNames,
+    FoldedNames,
+    NutrientCodes,
+    NutrientNames,
+    NutrientUnits,
+    Values,
+    Words,
+    TrigramKeys,
+    TrigramOffsets,
+    TrigramPostings,
+    SectionCount
+};
+
+struct FileHeader {
+    char magic[4];
+    quint32 version;
+    quint32 foodCount;
+    quint32 nutrientCount;
+    quint32 wordCount;
+    quint32 trigramCount;
+    quint64 fileSize;
+    quint64 sections[SectionCount];
+};
+
+struct WordEntry {
+    quint32 food;
+    quint32 offset; // Byte dentro de la cadena normalizada del alimento
+    quint32 length;
+};
+
+static_assert(sizeof(WordEntry) == 12, "WordEntry debe ocupar 12 bytes");
+
+// Vista sobre una tabla de cadenas del archivo mapeado
+struct StringTable {
+    const quint32* offsets = nullptr;
+    const char* bytes = nullptr;
+
+    QByteArray raw(int i) const
+    {
+        return QByteArray::fromRawData(bytes + offsets[i], int(offsets[i + 1] - offsets[i]));
+    }
+    QString text(int i) const { return QString::fromUtf8(bytes + offsets[i], int(offsets[i + 1] - offsets[i])); }
+};
+
+quint32 trigramKey(const char* bytes)
+{
+    return (quint32(uchar(bytes[0])) << 16) | (quint32(uchar(bytes[1])) << 8) | quint32(uchar(bytes[2]));
+}
+
+// Trigramas de una palabra rodeada de espacios (" pan " -> " pa", "pan", "an ")
+void appendTrigrams(const QByteArray& word, QVector<quint32>& keys)
+{
+    const QByteArray padded = ' ' + word + ' ';
+    for (int i = 0; i + 3 <= padded.size(); ++i) {
+        keys.append(trigramKey(padded.constData() + i));
+    }
+}
+
+// Palabras normalizadas de un nombre en UTF-8, con su posición dentro de la cadena
+QVector<QPair<int, QByteArray>> wordsWithOffsets(const QByteArray& folded)
+{
+    QVector<QPair<int, QByteArray>> result;
+    int from = 0;
+    for (const QString& word : TextNormalizer::words(QString::fromUtf8(folded))) {
+        const QByteArray bytes = word.toUtf8();
+        const int position = int(folded.indexOf(bytes, from));
+        if (position < 0) {
+            continue;
+        }
+        result.append(qMakePair(position, bytes));
+        from = position + int(bytes.size());
+    }
+    return result;
+}
+
+template <typename T>
+void appendValue(QByteArray& out, T value)
+{
+    char buffer[sizeof(T)];
+    qToLittleEndian<T>(value, buffer);
+    out.append(buffer, sizeof(T));
+}
+
+// Escritura del archivo por bloques: las secciones se vuelcan según se generan, sin montar
+// el catálogo entero en memoria (con USDA son cientos de MiB)
+class BlockWriter
+{
+public:
+    explicit BlockWriter(QIODevice* device)
+        : m_device(device)
+    {
+    }
+
+    template <typename T>
+    void append(T value)
+    {
+        appendValue<T>(m_buffer, value);
+        flushIfFull();
+    }
+    void append(const QByteArray& bytes)
+    {
+        m_buffer.append(bytes);
+        flushIfFull();
+    }
+    void alignTo8()
+    {
+        while (pos() % 8 != 0) {
+            m_buffer.append('\0');
+        }
+    }
+    qint64 pos() const { return m_written + m_buffer.size(); }
+    bool flush()
+    {
+        if (m_ok && !m_buffer.isEmpty()) {
+            m_ok = m_device->write(m_buffer) == m_buffer.size();
+            m_written += m_buffer.size();
+        }
+        m_buffer.clear();
+        return m_ok;
+    }
+
+private:
+    void flushIfFull()
+    {
+        if (m_buffer.size() >= kBlockSize) {
+            flush();
+        }
+    }
+
+    static const int kBlockSize = 1 << 20;
+    QIODevice* m_device;
+    QByteArray m_buffer;
+    qint64 m_written = 0;
+    bool m_ok = true;
+};
+
+void appendStringTable(BlockWriter& out, const QList<QByteArray>& strings)
+{
+    quint32 offset = 0;
+    out.append<quint32>(0);
+    for (const QByteArray& string : strings) {
+        offset += quint32(string.size());
+        out.append<quint32>(offset);
+    }
+    for (const QByteArray& string : strings) {
+        out.append(string);
+    }
+}
+
+QList<QByteArray> toUtf8List(const QStringList& strings)
+{
+    QList<QByteArray> result;
+    result.reserve(strings.size());
+    for (const QString& string : strings) {
+        result.append(string.toUtf8());
+    }
+    return result;
+}
+
+} // namespace
+
+struct FoodCatalog::Layout {
+    FileHeader header;
+    StringTable foodCodes;
+    StringTable foodNames;
+    StringTable foldedNames;
+    StringTable nutrientCodes;
+    StringTable nutrientNames;
+    StringTable nutrientUnits;
+    const float* values = nullptr;
+    const WordEntry* words = nullptr;
+    const quint32* trigramKeys = nullptr;
+    const quint32* trigramOffsets = nullptr;
+    const quint32* trigramPostings = nullptr;
+
+    // Texto de una entrada del índice de palabras
+    const char* wordText(const WordEntry& entry) const { return foldedNames.bytes + foldedNames.offsets[entry.food] + entry.offset; }
+};
+
+// ---------------------------------------------------------------------------------------------
+// Builder
+
+int FoodCatalog::Builder::addNutrient(const QString& code, const QString& name, const QString& unit)
+{
+    m_nutrientCodes.append(code);
+    m_nutrientNames.append(name);
+    m_nutrientUnits.append(unit);
+    m_cells.append(QVector<Cell>());
+    return int(m_nutrientCodes.size()) - 1;
+}
+
+int FoodCatalog::Builder::addFood(const QString& code, const QString& name)
+{
+    m_foodCodes.append(code);
+    m_foodNames.append(name.simplified());
+    return int(m_foodNames.size()) - 1;
+}
+
+void FoodCatalog::Builder::setValue(int food, int nutrient, float value)
+{
+    if (nutrient >= 0 && nutrient < m_cells.size() && food >= 0 && food < m_foodNames.size()) {
+        m_cells[nutrient].append({ quint32(food), value });
+    }
+}
+
+bool FoodCatalog::Builder::write(const QString& filePath, QString* error) const
+{
+    QElapsedTimer timer;
+    timer.start();
+    const int foods = foodCount();
+
+    // Nutrientes con al menos un valor
+    QVector<int> kept;
+    for (int n = 0; n < m_cells.size(); ++n) {
+        if (std::any_of(m_cells[n].cbegin(), m_cells[n].cend(), [](const Cell& cell) { return !std::isnan(cell.value); })) {
+            kept.append(n);
+        }
+    }
+
+    // Nombres normalizados, índice de palabras y trigramas
+    QList<QByteArray> folded;
+    folded.reserve(foods);
+    QVector<WordEntry> words;
+    QVector<quint64> trigramPairs; // (trigrama << 32) | alimento
+    QVector<quint32> keys;
+    for (int food = 0; food < foods; ++food) {
+        folded.append(TextNormalizer::fold(m_foodNames[food]).toUtf8());
+        keys.clear();
+        for (const auto& word : wordsWithOffsets(folded.last())) {
+            words.append({ quint32(food), quint32(word.first), quint32(word.second.size()) });
+            appendTrigrams(word.second, keys);
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        for (quint32 key : keys) {
+            trigramPairs.append((quint64(key) << 32) | quint64(food));
+        }
+    }
+    std::sort(words.begin(), words.end(), [&folded](const WordEntry& a, const WordEntry& b) {
+        const int cmp = std::memcmp(folded[a.food].constData() + a.offset, folded[b.food].constData() + b.offset,
+                                    std::min(a.length, b.length));
+        if (cmp != 0) {
+            return cmp < 0;
+        }
+        return a.length != b.length ? a.length < b.length : a.food < b.food;
+    });
+    std::sort(trigramPairs.begin(), trigramPairs.end());
+
+    QVector<quint32> trigramKeys;
+    QVector<quint32> trigramOffsets;
+    for (int i = 0; i < trigramPairs.size(); ++i) {
+        const quint32 key = quint32(trigramPairs[i] >> 32);
+        if (trigramKeys.isEmpty() || trigramKeys.last() != key) {
+            trigramKeys.append(key);
+            trigramOffsets.append(quint32(i));
+        }
+    }
+    trigramOffsets.append(quint32(trigramPairs.size()));
+
+    // QSaveFile escribe en un temporal y renombra: nunca dejamos un catálogo a medias
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+
+    // Ensamblado de las secciones; la cabecera se reescribe al final con las posiciones
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.foodCount = quint32(foods);
+    header.nutrientCount = quint32(kept.size());
+    header.wordCount = quint32(words.size());
+    header.trigramCount = quint32(trigramKeys.size());
+
+    BlockWriter out(&file);
+    out.append(QByteArray(sizeof(FileHeader), '\0'));
+
+    QStringList codes;
+    QStringList names;
+    QStringList units;
+    for (int n : std::as_const(kept)) {
+        codes << m_nutrientCodes[n];
+        names << m_nutrientNames[n];
+        units << m_nutrientUnits[n];
+    }
+    const QList<QList<QByteArray>> tables = {
+        toUtf8List(m_foodCodes), toUtf8List(m_foodNames), folded,
+        toUtf8List(codes), toUtf8List(names), toUtf8List(units)
+    };
+    for (int section = FoodCodes; section <= NutrientUnits; ++section) {
+        out.alignTo8();
+        header.sections[section] = quint64(out.pos());
+        appendStringTable(out, tables[section]);
+    }
+
+    // Las columnas se expanden de una en una: solo hay en memoria los valores presentes
+    out.alignTo8();
+    header.sections[Values] = quint64(out.pos());
+    for (int n : std::as_const(kept)) {
+        QVector<Cell> cells = m_cells[n];
+        std::stable_sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) { return a.food < b.food; });
+        int next = 0;
+        for (int food = 0; food < foods; ++food) {
+            float value = std::numeric_limits<float>::quiet_NaN();
+            while (next < cells.size() && cells[next].food == quint32(food)) {
+                value = cells[next++].value; // Si se repite, vale el último (como al sobrescribir)
+            }
+            out.append<float>(value);
+        }
+    }
+
+    out.alignTo8();
+    header.sections[Words] = quint64(out.pos());
+    for (const WordEntry& entry : std::as_const(words)) {
+        out.append<quint32>(entry.food);
+        out.append<quint32>(entry.offset);
+        out.append<quint32>(entry.length);
+    }
+
+    out.alignTo8();
+    header.sections[TrigramKeys] = quint64(out.pos());
+    for (quint32 key : std::as_const(trigramKeys)) {
+        out.append<quint32>(key);
+    }
+    out.alignTo8();
+    header.sections[TrigramOffsets] = quint64(out.pos());
+    for (quint32 offset : std::as_const(trigramOffsets)) {
+        out.append<quint32>(offset);
+    }
+    out.alignTo8();
+    header.sections[TrigramPostings] = quint64(out.pos());
+    for (quint64 pair : std::as_const(trigramPairs)) {
+        out.append<quint32>(quint32(pair & 0xFFFFFFFFu));
+    }
+
+    header.fileSize = quint64(out.pos());
+    bool written = out.flush() && file.seek(0)
+                   && file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header));
+    if (!written) {
+        if (error) {
+            *error = file.errorString();
+        }
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+
+    qInfo() << "Catálogo de alimentos escrito:" << foods << "alimentos," << kept.size() << "nutrientes,"
+            << header.fileSize / 1024 << "KiB en" << timer.elapsed() << "ms";
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Lectura
+
+FoodCatalog* FoodCatalog::instance()
+{
+    static FoodCatalog catalog;
+    return &catalog;
+}
+
+FoodCatalog::FoodCatalog()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_layout(nullptr)
+{
+}
+
+FoodCatalog::~FoodCatalog()
+{
+    close();
+}
+
+bool FoodCatalog::open(const QString& filePath)
+{
+    close();
+    if (QSysInfo::ByteOrder != QSysInfo::LittleEndian) {
+        qWarning() << "El catálogo de alimentos solo se puede mapear en máquinas little-endian.";
+        return false;
+    }
+
+    m_file.setFileName(filePath);
+    if (!m_file.exists()) {
+        qInfo() << "No hay catálogo de alimentos en" << filePath;
+        return false;
+    }
+    if (!m_file.open(QIODevice::ReadOnly) || m_file.size() < qint64(sizeof(FileHeader))) {
+        qWarning() << "No se pudo abrir el catálogo de alimentos:" << filePath << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+    const uchar* data = m_file.map(0, m_file.size());
+    if (!data) {
+        qWarning() << "No se pudo mapear el catálogo de alimentos:" << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    Layout* layout = new Layout;
+    std::memcpy(&layout->header, data, sizeof(FileHeader));
+    const FileHeader& header = layout->header;
+    const quint64 size = quint64(m_file.size());
+    bool valid = std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0
+                 && header.version == kFormatVersion && header.fileSize == size;
+    for (int section = 0; valid && section < SectionCount; ++section) {
+        valid = header.sections[section] % 8 == 0 && header.sections[section] <= size
+                && (section == 0 || header.sections[section] >= header.sections[section - 1]);
+    }
+
+    // Tablas de cadenas: la tabla de desplazamientos y los bytes deben caber en su sección
+    auto stringTable = [&](Section section, quint32 count, StringTable& table) {
+        const quint64 start = header.sections[section];
+        const quint64 end = header.sections[section + 1];
+        if (!valid || start + (quint64(count) + 1) * 4 > end) {
+            valid = false;
+            return;
+        }
+        table.offsets = reinterpret_cast<const quint32*>(data + start);
+        table.bytes = reinterpret_cast<const char*>(data + start + (quint64(count) + 1) * 4);
+        valid = start + (quint64(count) + 1) * 4 + table.offsets[count] <= end;
+    };
+    stringTable(FoodCodes, header.foodCount, layout->foodCodes);
+    stringTable(FoodNames, header.foodCount, layout->foodNames);
+    stringTable(FoldedNames, header.foodCount, layout->foldedNames);
+    stringTable(NutrientCodes, header.nutrientCount, layout->nutrientCodes);
+    stringTable(NutrientNames, header.nutrientCount, layout->nutrientNames);
+    stringTable(NutrientUnits, header.nutrientCount, layout->nutrientUnits);
+
+    valid = valid
+            && header.sections[Values] + quint64(header.foodCount) * header.nutrientCount * sizeof(float) <= header.sections[Words]
+            && header.sections[Words] + quint64(header.wordCount) * sizeof(WordEntry) <= header.sections[TrigramKeys]
+            && header.sections[TrigramKeys] + quint64(header.trigramCount) * 4 <= header.sections[TrigramOffsets]
+            && header.sections[TrigramOffsets] + (quint64(header.trigramCount) + 1) * 4 <= header.sections[TrigramPostings];
+    if (valid) {
+        layout->values = reinterpret_cast<const float*>(data + header.sections[Values]);
+        layout->words = reinterpret_cast<const WordEntry*>(data + header.sections[Words]);
+        layout->trigramKeys = reinterpret_cast<const quint32*>(data + header.sections[TrigramKeys]);
+        layout->trigramOffsets = reinterpret_cast<const quint32*>(data + header.sections[TrigramOffsets]);
+        layout->trigramPostings = reinterpret_cast<const quint32*>(data + header.sections[TrigramPostings]);
+        valid = header.sections[TrigramPostings] + quint64(layout->trigramOffsets[header.trigramCount]) * 4 <= size;
+    }
+
+    // Los índices se leen sin comprobar en cada búsqueda: aquí se valida que no salgan del archivo
+    auto monotonic = [](const quint32* offsets, quint32 count) {
+        for (quint32 i = 0; i < count; ++i) {
+            if (offsets[i + 1] < offsets[i]) {
+                return false;
+            }
+        }
+        return true;
+    };
+    for (const StringTable* table : { &layout->foodCodes, &layout->foodNames, &layout->foldedNames }) {
+        valid = valid && monotonic(table->offsets, header.foodCount);
+    }
+    for (const StringTable* table : { &layout->nutrientCodes, &layout->nutrientNames, &layout->nutrientUnits }) {
+        valid = valid && monotonic(table->offsets, header.nutrientCount);
+    }
+    for (quint32 i = 0; valid && i < header.wordCount; ++i) {
+        const WordEntry& entry = layout->words[i];
+        valid = entry.food < header.foodCount
+                && quint64(entry.offset) + entry.length
+                       <= layout->foldedNames.offsets[entry.food + 1] - layout->foldedNames.offsets[entry.food];
+    }
+    valid = valid && layout->trigramOffsets[0] == 0 && monotonic(layout->trigramOffsets, header.trigramCount);
+    const quint32 postings = valid ? layout->trigramOffsets[header.trigramCount] : 0;
+    for (quint32 p = 0; valid && p < postings; ++p) {
+        valid = layout->trigramPostings[p] < header.foodCount;
+    }
+
+    if (!valid) {
+        qWarning() << "Catálogo de alimentos no válido o de otra versión, se ignorará:" << filePath;
+        delete layout;
+        m_file.unmap(const_cast<uchar*>(data));
+        m_file.close();
+        return false;
+    }
+
+    m_data = data;
+    m_size = qint64(size);
+    m_layout = layout;
+    qInfo() << "Catálogo de alimentos mapeado:" << header.foodCount << "alimentos," << header.nutrientCount << "nutrientes";
+    return true;
+}
+
+void FoodCatalog::close()
+{
+    m_codeIndex.clear(); // Sus claves apuntan al archivo mapeado
+    if (m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    delete m_layout;
+    m_layout = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+}
+
+int FoodCatalog::foodCount() const
+{
+    return m_layout ? int(m_layout->header.foodCount) : 0;
+}
+
+int FoodCatalog::nutrientCount() const
+{
+    return m_layout ? int(m_layout->header.nutrientCount) : 0;
+}
+
+QString FoodCatalog::foodCode(int food) const
+{
+    return (food >= 0 && food < foodCount()) ? m_layout->foodCodes.text(food) : QString();
+}
+
+QString FoodCatalog::foodName(int food) const
+{
+    return (food >= 0 && food < foodCount()) ? m_layout->foodNames.text(food) : QString();
+}
+
+int FoodCatalog::foodIndex(const QString& code) const
+{
+    if (!isOpen()) {
+        return -1;
+    }
+    if (m_codeIndex.isEmpty()) {
+        m_codeIndex.reserve(foodCount());
+        for (int food = 0; food < foodCount(); ++food) {
+            m_codeIndex.insert(m_layout->foodCodes.raw(food), food);
+        }
+    }
+    return m_codeIndex.value(code.toUtf8(), -1);
+}
+
+FoodCatalog::Nutrient FoodCatalog::nutrient(int index) const
+{
+    Nutrient result;
+    if (index >= 0 && index < nutrientCount()) {
+        result.code = m_layout->nutrientCodes.text(index);
+        result.name = m_layout->nutrientNames.text(index);
+        result.unit = m_layout->nutrientUnits.text(index);
+    }
+    return result;
+}
+
+int FoodCatalog::nutrientIndex(const QString& code) const
+{
+    const QByteArray wanted = code.toUtf8();
+    for (int i = 0; i < nutrientCount(); ++i) {
+        if (m_layout->nutrientCodes.raw(i) == wanted) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const float* FoodCatalog::column(int nutrient) const
+{
+    if (nutrient < 0 || nutrient >= nutrientCount()) {
+        return nullptr;
+    }
+    return m_layout->values + qint64(nutrient) * m_layout->header.foodCount;
+}
+
+float FoodCatalog::value(int food, int nutrient) const
+{
+    const float* values = column(nutrient);
+    return (values && food >= 0 && food < foodCount()) ? values[food] : std::numeric_limits<float>::quiet_NaN();
+}
+
+QVector<int> FoodCatalog::prefixMatches(const QByteArray& word) const
+{
+    QVector<int> foods;
+    const WordEntry* begin = m_layout->words;
+    const WordEntry* end = begin + m_layout->header.wordCount;
+    const Layout* layout = m_layout;
+    const std::size_t length = std::size_t(word.size());
+
+    // Primera palabra >= prefijo; a partir de ahí, todas las que empiezan por él son contiguas
+    const WordEntry* it = std::lower_bound(begin, end, word, [layout, length](const WordEntry& entry, const QByteArray& wanted) {
+        const int cmp = std::memcmp(layout->wordText(entry), wanted.constData(), std::min<std::size_t>(entry.length, length));
+        return cmp < 0 || (cmp == 0 && entry.length < length);
+    });
+    for (; it != end; ++it) {
+        if (it->length < length || std::memcmp(layout->wordText(*it), word.constData(), length) != 0) {
+            break;
+        }
+        foods.append(int(it->food));
+    }
+    std::sort(foods.begin(), foods.end());
+    foods.erase(std::unique(foods.begin(), foods.end()), foods.end());
+    return foods;
+}
+
+QVector<FoodCatalog::Match> FoodCatalog::trigramMatches(const QList<QByteArray>& words, int limit, const QVector<int>& exclude) const
+{
+    QVector<Match> matches;
+    QVector<quint32> keys;
+    for (const QByteArray& word : words) {
+        appendTrigrams(word, keys);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    if (keys.isEmpty()) {
+        return matches;
+    }
+
+    // Recuento de trigramas compartidos por alimento recorriendo solo las listas de la consulta
+    QVector<quint16> shared(foodCount(), 0);
+    QVector<int> touched;
+    const quint32* keysBegin = m_layout->trigramKeys;
+    const quint32* keysEnd = keysBegin + m_layout->header.trigramCount;
+    for (quint32 key : std::as_const(keys)) {
+        const quint32* found = std::lower_bound(keysBegin, keysEnd, key);
+        if (found == keysEnd || *found != key) {
+            continue;
+        }
+        const qint64 index = found - keysBegin;
+        for (quint32 p = m_layout->trigramOffsets[index]; p < m_layout->trigramOffsets[index + 1]; ++p) {
+            const quint32 food = m_layout->trigramPostings[p];
+            if (shared[food]++ == 0) {
+                touched.append(int(food));
+            }
+        }
+    }
+
+    const double minScore = 0.4;
+    for (int food : std::as_const(touched)) {
+        const double score = double(shared[food]) / keys.size();
+        if (score >= minScore && !std::binary_search(exclude.cbegin(), exclude.cend(), food)) {
+            matches.append({ food, score * 0.99 }); // Siempre por debajo de una coincidencia por prefijo
+        }
+    }
+    std::sort(matches.begin(), matches.end(), [this](const Match& a, const Match& b) {
+        if (a.score != b.score) {
+            return a.score > b.score;
+        }
+        return m_layout->foldedNames.offsets[a.food + 1] - m_layout->foldedNames.offsets[a.food]
+               < m_layout->foldedNames.offsets[b.food + 1] - m_layout->foldedNames.offsets[b.food];
+    });
+    if (matches.size() > limit) {
+        matches.resize(limit);
+    }
+    return matches;
+}
+
+QVector<FoodCatalog::Match> FoodCatalog::search(const QString& text, int limit) const
+{
+    QVector<Match> results;
+    if (!isOpen() || limit <= 0) {
+        return results;
+    }
+    QList<QByteArray> words;
+    for (const QString& word : TextNormalizer::words(TextNormalizer::fold(text))) {
+        words.append(word.toUtf8());
+    }
+    if (words.isEmpty()) {
+        return results;
+    }
+
+    // 1. Todas las palabras buscadas como prefijo de alguna palabra del nombre (intersección)
+    QVector<int> candidates = prefixMatches(words.first());
+    for (int i = 1; i < words.size() && !candidates.isEmpty(); ++i) {
+        const QVector<int> next = prefixMatches(words[i]);
+        QVector<int> intersection;
+        std::set_intersection(candidates.cbegin(), candidates.cend(), next.cbegin(), next.cend(),
+                              std::back_inserter(intersection));
+        candidates = intersection;
+    }
+    // Los nombres más cortos suelen ser el alimento genérico ("Leche" antes que "Leche de soja con cacao")
+    const StringTable& names = m_layout->foldedNames;
+    std::vector<int> ranked(candidates.cbegin(), candidates.cend());
+    const std::size_t top = std::min<std::size_t>(ranked.size(), std::size_t(limit));
+    std::partial_sort(ranked.begin(), ranked.begin() + top, ranked.end(), [&names](int a, int b) {
+        const quint32 la = names.offsets[a + 1] - names.offsets[a];
+        const quint32 lb = names.offsets[b + 1] - names.offsets[b];
+        return la != lb ? la < lb : a < b;
+    });
+    for (std::size_t i = 0; i < top; ++i) {
+        results.append({ ranked[i], 1.0 });
+    }
+
+    // 2. Errores de tecleo o palabras incompletas en medio: coincidencia aproximada por trigramas
+    if (results.size() < limit) {
+        results += trigramMatches(words, limit - int(results.size()), candidates);
+    }
+    return results;
+}
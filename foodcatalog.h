@@ -0,0 +1,109 @@
+#ifndef FOODCATALOG_H
+#define FOODCATALOG_H
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Catálogo de composición de alimentos (valores por 100 g de porción comestible).
+// Vive en un archivo binario por columnas junto a nutricion.db (ver DatabaseManager::foodCatalogPath)
+// que se mapea en memoria sin copiarlo ni decodificarlo: abrirlo valida la cabecera y que los
+// índices no apunten fuera del archivo (una pasada lineal, sin copiar nada).
+//
+// Formato (little-endian, secciones alineadas a 8 bytes; ver foodcatalog.cpp):
+//   cabecera | tablas de cadenas (códigos, nombres, nombres normalizados, nutrientes)
+//   | valores float por nutriente (una columna contigua por nutriente, NaN = sin dato)
+//   | índice de palabras ordenado (búsqueda por prefijo) | índice de trigramas (búsqueda aproximada)
+//
+// Las búsquedas no distinguen acentos ni mayúsculas (TextNormalizer::fold).
+// El archivo se genera con FoodCatalog::Builder (lo usa FoodCatalogImporter).
+class FoodCatalog
+{
+public:
+    struct Nutrient {
+        QString code;   // Identificador estable (p. ej. "energy_kcal" o el número de nutriente USDA)
+        QString name;
+        QString unit;
+    };
+
+    struct Match {
+        int food = -1;
+        double score = 0.0; // 1 = todas las palabras coinciden por prefijo; < 1 = coincidencia aproximada
+    };
+
+    // Genera el archivo a partir de alimentos y nutrientes en memoria. Los valores se guardan
+    // dispersos (solo los que existen, por nutriente) y el archivo se escribe por bloques.
+    class Builder
+    {
+    public:
+        int addNutrient(const QString& code, const QString& name, const QString& unit);
+        int addFood(const QString& code, const QString& name);
+        void setValue(int food, int nutrient, float value);
+
+        int foodCount() const { return int(m_foodNames.size()); }
+        int nutrientCount() const { return int(m_nutrientCodes.size()); }
+
+        // Escribe el archivo de forma atómica. Los nutrientes sin ningún valor se descartan.
+        bool write(const QString& filePath, QString* error = nullptr) const;
+
+    private:
+        QStringList m_foodCodes;
+        QStringList m_foodNames;
+        QStringList m_nutrientCodes;
+        QStringList m_nutrientNames;
+        QStringList m_nutrientUnits;
+        struct Cell {
+            quint32 food;
+            float value;
+        };
+        QVector<QVector<Cell>> m_cells; // [nutriente] -> valores recibidos, en orden de llegada
+    };
+
+    static FoodCatalog* instance();
+
+    // Mapea el archivo. false si no existe o no es válido (el catálogo queda vacío).
+    bool open(const QString& filePath);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+    QString filePath() const { return m_file.fileName(); }
+
+    int foodCount() const;
+    int nutrientCount() const;
+
+    QString foodCode(int food) const;
+    QString foodName(int food) const;
+    // Índice del alimento por código; -1 si no existe. El índice por código se crea en la primera llamada.
+    int foodIndex(const QString& code) const;
+    Nutrient nutrient(int index) const;
+    // Índice del nutriente por código; -1 si no existe
+    int nutrientIndex(const QString& code) const;
+
+    // Valor por 100 g; NaN si el alimento no tiene dato de ese nutriente
+    float value(int food, int nutrient) const;
+    // Columna completa de un nutriente (foodCount() valores) directamente sobre el archivo mapeado
+    const float* column(int nutrient) const;
+
+    // Búsqueda por nombre: primero alimentos cuyas palabras empiezan por todas las palabras buscadas
+    // (las más cortas primero); si no llegan a 'limit', se completa con coincidencias por trigramas.
+    QVector<Match> search(const QString& text, int limit = 50) const;
+
+private:
+    FoodCatalog();
+    ~FoodCatalog();
+
+    QVector<int> prefixMatches(const QByteArray& word) const;
+    QVector<Match> trigramMatches(const QList<QByteArray>& words, int limit, const QVector<int>& exclude) const;
+
+    // Punteros a las secciones del archivo mapeado (definido en foodcatalog.cpp)
+    struct Layout;
+
+    QFile m_file;
+    const uchar* m_data;
+    qint64 m_size;
+    Layout* m_layout;
+    mutable QHash<QByteArray, int> m_codeIndex;
+};
+
+#endif // FOODCATALOG_H
@@ -0,0 +1,327 @@
+#include "foodcatalogimporter.h"
+#include "foodcatalog.h"
+#include "textnormalizer.h"
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTextStream>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Lector CSV con comillas (RFC 4180): "a;""b"";c" y saltos de línea dentro de comillas
+class CsvReader
+{
+public:
+    explicit CsvReader(QFile* file)
+        : m_stream(file)
+    {
+        m_stream.setEncoding(QStringConverter::Utf8);
+    }
+
+    void setSeparator(QChar separator) { m_separator = separator; }
+
+    bool readRecord(QStringList& fields)
+    {
+        fields.clear();
+        if (m_stream.atEnd()) {
+            return false;
+        }
+        QString field;
+        bool quoted = false;
+        QString line = m_stream.readLine();
+        while (true) {
+            for (int i = 0; i < line.size(); ++i) {
+                const QChar c = line.at(i);
+                if (quoted) {
+                    if (c == '"') {
+                        if (i + 1 < line.size() && line.at(i + 1) == '"') {
+                            field += '"';
+                            ++i;
+                        } else {
+                            quoted = false;
+                        }
+                    } else {
+                        field += c;
+                    }
+                } else if (c == '"') {
+                    quoted = true;
+                } else if (c == m_separator) {
+                    fields.append(field);
+                    field.clear();
+                } else {
+                    field += c;
+                }
+            }
+            if (!quoted || m_stream.atEnd()) {
+                break;
+            }
+            field += '\n';
+            line = m_stream.readLine();
+        }
+        fields.append(field);
+        return true;
+    }
+
+private:
+    QTextStream m_stream;
+    QChar m_separator = ',';
+};
+
+QChar detectSeparator(const QString& headerLine)
+{
+    const QList<QChar> candidates = { ';', '\t', ',' };
+    QChar best = ',';
+    qsizetype bestCount = 0;
+    for (QChar candidate : candidates) {
+        const qsizetype count = headerLine.count(candidate);
+        if (count > bestCount) {
+            best = candidate;
+            bestCount = count;
+        }
+    }
+    return best;
+}
+
+// Valor de una celda de nutriente: NaN si no hay dato
+float parseAmount(QString text)
+{
+    text = text.trimmed();
+    if (text.isEmpty() || text == "-" || text.compare("n.d.", Qt::CaseInsensitive) == 0) {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+    if (text.compare("tr", Qt::CaseInsensitive) == 0 || text.compare("trazas", Qt::CaseInsensitive) == 0) {
+        return 0.0f;
+    }
+    if (text.startsWith('<')) { // "<0.1": por debajo del límite de detección
+        return 0.0f;
+    }
+    text.replace(',', '.');
+    bool ok = false;
+    const float value = text.toFloat(&ok);
+    return (ok && std::isfinite(value)) ? value : std::numeric_limits<float>::quiet_NaN();
+}
+
+// "Proteína total (g)" -> nombre "Proteína total", unidad "g", código "proteina_total"
+void splitNutrientHeader(const QString& header, QString& code, QString& name, QString& unit)
+{
+    static const QRegularExpression unitPattern(R"(^(.*?)\s*[\(\[]([^\)\]]*)[\)\]]\s*$)");
+    const QRegularExpressionMatch match = unitPattern.match(header.trimmed());
+    if (match.hasMatch()) {
+        name = match.captured(1).trimmed();
+        unit = match.captured(2).trimmed();
+    } else {
+        name = header.trimmed();
+        unit.clear();
+    }
+    code = TextNormalizer::words(TextNormalizer::fold(name)).join('_');
+}
+
+int findColumn(const QStringList& header, const QStringList& names)
+{
+    for (int i = 0; i < header.size(); ++i) {
+        const QString folded = TextNormalizer::fold(header.at(i)).trimmed();
+        if (names.contains(folded)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Cada cuántos registros se informa del avance
+const int kProgressEvery = 4096;
+
+bool fail(QString* error, const QString& message)
+{
+    qWarning() << "Importación de alimentos:" << message;
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+} // namespace
+
+bool FoodCatalogImporter::importCsv(const QString& csvPath, const QString& catalogPath, QString* error,
+                                    const Progress& progress)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(csvPath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return fail(error, QString("No se pudo abrir %1: %2").arg(csvPath, file.errorString()));
+    }
+    // El separador se decide con la primera línea; después se relee con el lector para respetar las comillas
+    const QString headerLine = QString::fromUtf8(file.readLine());
+    file.seek(0);
+    CsvReader records(&file);
+    records.setSeparator(detectSeparator(headerLine));
+    QStringList header;
+    records.readRecord(header);
+
+    const int codeColumn = findColumn(header, { "codigo", "code", "id", "food code", "cod" });
+    const int nameColumn = findColumn(header, { "nombre", "alimento", "name", "description", "descripcion", "food name" });
+    if (nameColumn < 0) {
+        return fail(error, "No se encontró la columna con el nombre del alimento.");
+    }
+
+    FoodCatalog::Builder builder;
+    QVector<int> nutrientOfColumn(header.size(), -1);
+    for (int column = 0; column < header.size(); ++column) {
+        if (column == codeColumn || column == nameColumn || header.at(column).trimmed().isEmpty()) {
+            continue;
+        }
+        QString code;
+        QString name;
+        QString unit;
+        splitNutrientHeader(header.at(column), code, name, unit);
+        nutrientOfColumn[column] = builder.addNutrient(code, name, unit);
+    }
+
+    QStringList fields;
+    int skipped = 0;
+    qint64 recordsRead = 0;
+    while (records.readRecord(fields)) {
+        if (progress && ++recordsRead % kProgressEvery == 0 && !progress(file.pos(), file.size())) {
+            return fail(error, "Importación cancelada.");
+        }
+        if (fields.size() <= nameColumn || fields.at(nameColumn).trimmed().isEmpty()) {
+            ++skipped;
+            continue;
+        }
+        const QString code = (codeColumn >= 0 && codeColumn < fields.size())
+                                 ? fields.at(codeColumn).trimmed()
+                                 : QString::number(builder.foodCount() + 1);
+        const int food = builder.addFood(code, fields.at(nameColumn));
+        const int columns = int(qMin(fields.size(), nutrientOfColumn.size()));
+        for (int column = 0; column < columns; ++column) {
+            if (nutrientOfColumn.at(column) >= 0) {
+                builder.setValue(food, nutrientOfColumn.at(column), parseAmount(fields.at(column)));
+            }
+        }
+    }
+    if (builder.foodCount() == 0) {
+        return fail(error, "El archivo no contiene alimentos.");
+    }
+    if (skipped > 0) {
+        qWarning() << "Importación de alimentos:" << skipped << "filas sin nombre ignoradas";
+    }
+
+    qInfo() << "Tabla de alimentos leída:" << builder.foodCount() << "alimentos en" << timer.elapsed() << "ms";
+    return builder.write(catalogPath, error);
+}
+
+bool FoodCatalogImporter::importUsdaFdc(const QString& directory, const QString& catalogPath, QString* error,
+                                        const Progress& progress)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const QDir dir(directory);
+    QFile foodFile(dir.filePath("food.csv"));
+    QFile nutrientFile(dir.filePath("nutrient.csv"));
+    QFile amountFile(dir.filePath("food_nutrient.csv"));
+    for (QFile* file : { &foodFile, &nutrientFile, &amountFile }) {
+        if (!file->open(QIODevice::ReadOnly | QIODevice::Text)) {
+            return fail(error, QString("No se pudo abrir %1: %2").arg(file->fileName(), file->errorString()));
+        }
+    }
+
+    // Avance sobre el total de los tres archivos, en el orden en que se leen
+    const qint64 total = nutrientFile.size() + foodFile.size() + amountFile.size();
+    qint64 recordsRead = 0;
+    auto keepGoing = [&](qint64 before, const QFile& current) {
+        return !progress || ++recordsRead % kProgressEvery != 0 || progress(before + current.pos(), total);
+    };
+
+    FoodCatalog::Builder builder;
+    QStringList fields;
+
+    // nutrient.csv: id, name, unit_name, nutrient_nbr, rank
+    QHash<qint64, int> nutrientById;
+    {
+        CsvReader reader(&nutrientFile);
+        reader.readRecord(fields);
+        const int idColumn = fields.indexOf("id");
+        const int nameColumn = fields.indexOf("name");
+        const int unitColumn = fields.indexOf("unit_name");
+        const int numberColumn = fields.indexOf("nutrient_nbr");
+        if (idColumn < 0 || nameColumn < 0 || unitColumn < 0) {
+            return fail(error, "nutrient.csv no tiene las columnas id, name y unit_name.");
+        }
+        while (reader.readRecord(fields)) {
+            if (!keepGoing(0, nutrientFile)) {
+                return fail(error, "Importación cancelada.");
+            }
+            if (fields.size() <= qMax(idColumn, qMax(nameColumn, unitColumn))) {
+                continue;
+            }
+            const QString number = numberColumn >= 0 && numberColumn < fields.size() ? fields.at(numberColumn).trimmed() : QString();
+            const QString code = number.isEmpty() ? fields.at(idColumn) : number;
+            nutrientById.insert(fields.at(idColumn).toLongLong(),
+                                builder.addNutrient(code, fields.at(nameColumn), fields.at(unitColumn).toLower()));
+        }
+    }
+
+    // food.csv: fdc_id, data_type, description, ...
+    QHash<qint64, int> foodById;
+    {
+        CsvReader reader(&foodFile);
+        reader.readRecord(fields);
+        const int idColumn = fields.indexOf("fdc_id");
+        const int nameColumn = fields.indexOf("description");
+        if (idColumn < 0 || nameColumn < 0) {
+            return fail(error, "food.csv no tiene las columnas fdc_id y description.");
+        }
+        while (reader.readRecord(fields)) {
+            if (!keepGoing(nutrientFile.size(), foodFile)) {
+                return fail(error, "Importación cancelada.");
+            }
+            if (fields.size() <= qMax(idColumn, nameColumn) || fields.at(nameColumn).trimmed().isEmpty()) {
+                continue;
+            }
+            foodById.insert(fields.at(idColumn).toLongLong(), builder.addFood(fields.at(idColumn), fields.at(nameColumn)));
+        }
+    }
+
+    // food_nutrient.csv: id, fdc_id, nutrient_id, amount, ...
+    {
+        CsvReader reader(&amountFile);
+        reader.readRecord(fields);
+        const int foodColumn = fields.indexOf("fdc_id");
+        const int nutrientColumn = fields.indexOf("nutrient_id");
+        const int amountColumn = fields.indexOf("amount");
+        if (foodColumn < 0 || nutrientColumn < 0 || amountColumn < 0) {
+            return fail(error, "food_nutrient.csv no tiene las columnas fdc_id, nutrient_id y amount.");
+        }
+        const int needed = qMax(foodColumn, qMax(nutrientColumn, amountColumn));
+        qint64 rows = 0;
+        while (reader.readRecord(fields)) {
+            if (!keepGoing(nutrientFile.size() + foodFile.size(), amountFile)) {
+                return fail(error, "Importación cancelada.");
+            }
+            if (fields.size() <= needed) {
+                continue;
+            }
+            const auto food = foodById.constFind(fields.at(foodColumn).toLongLong());
+            const auto nutrient = nutrientById.constFind(fields.at(nutrientColumn).toLongLong());
+            if (food == foodById.cend() || nutrient == nutrientById.cend()) {
+                continue;
+            }
+            builder.setValue(food.value(), nutrient.value(), parseAmount(fields.at(amountColumn)));
+            ++rows;
+        }
+        qInfo() << "food_nutrient.csv:" << rows << "valores leídos";
+    }
+
+    if (builder.foodCount() == 0) {
+        return fail(error, "food.csv no contiene alimentos.");
+    }
+    qInfo() << "Tablas USDA leídas:" << builder.foodCount() << "alimentos en" << timer.elapsed() << "ms";
+    return builder.write(catalogPath, error);
+}
@@ -0,0 +1,30 @@
+#ifndef FOODCATALOGIMPORTER_H
+#define FOODCATALOGIMPORTER_H
+
+#include <QString>
+#include <functional>
+
+// Convierte tablas de composición de alimentos al archivo binario de FoodCatalog.
+// Los valores deben venir por 100 g de porción comestible.
+class FoodCatalogImporter
+{
+public:
+    // Avance de la lectura en bytes; si retorna false se cancela (las funciones son aptas para
+    // un hilo de trabajo: no tocan la base de datos ni el catálogo abierto)
+    using Progress = std::function<bool(qint64 done, qint64 total)>;
+
+    // Tabla nacional "ancha" (BEDCA, CIQUAL, ...): una fila por alimento y una columna por nutriente.
+    // Separador ';', ',' o tabulador (se detecta en la cabecera); admite coma decimal.
+    // La columna de código se reconoce por su cabecera (código, code, id); la de nombre
+    // (nombre, alimento, name, description) es obligatoria. Cabeceras de nutriente "Proteína (g)".
+    // Celdas vacías o "-" = sin dato; "tr" (trazas) = 0.
+    static bool importCsv(const QString& csvPath, const QString& catalogPath, QString* error = nullptr,
+                          const Progress& progress = Progress());
+
+    // Exportación CSV de USDA FoodData Central: food.csv, nutrient.csv y food_nutrient.csv
+    // en el mismo directorio. food_nutrient.csv se lee en streaming (puede tener millones de filas).
+    static bool importUsdaFdc(const QString& directory, const QString& catalogPath, QString* error = nullptr,
+                              const Progress& progress = Progress());
+};
+
+#endif // FOODCATALOGIMPORTER_H
@@ -0,0 +1,563 @@
+#include "fooddiary.h"
+#include "foodcatalog.h"
+#include "recipegraph.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QPair>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <cmath>
+
+namespace {
+
+struct NutrientInfo {
+    const char* column;
+    const char* label;
+    const char* unit;
+    bool upperLimit;
+    // Códigos con los que puede aparecer en el catálogo: nombres normalizados de las tablas
+    // nacionales (FoodCatalogImporter::importCsv) y números de nutriente USDA (nutrient_nbr e id)
+    QStringList aliases;
+};
+
+const NutrientInfo& info(FoodDiary::Nutrient nutrient)
+{
+    static const NutrientInfo kInfo[FoodDiary::NutrientCount] = {
+        { "energy_kcal", "Energía", "kcal", false,
+          { "energia", "energia_total", "valor_energetico", "energy", "energy_kcal", "208", "1008" } },
+        { "protein_g", "Proteínas", "g", false,
+          { "proteina", "proteinas", "proteina_total", "protein", "203", "1003" } },
+        { "carbohydrate_g", "Hidratos de carbono", "g", false,
+          { "hidratos_de_carbono", "hidratos_de_carbono_totales", "carbohidratos", "carbohidratos_totales",
+            "carbohydrate", "carbohydrate_by_difference", "205", "1005" } },
+        { "sugars_g", "Azúcares", "g", true,
+          { "azucares", "azucares_totales", "sugars", "sugars_total", "sugars_total_including_nlea", "269", "2000" } },
+        { "fat_g", "Grasas", "g", false,
+          { "grasa", "grasa_total", "grasas", "lipidos", "lipidos_totales", "fat", "total_lipid_fat", "204", "1004" } },
+        { "saturated_fat_g", "Grasas saturadas", "g", true,
+          { "acidos_grasos_saturados", "acidos_grasos_saturados_totales", "grasa_saturada", "saturated_fat",
+            "fatty_acids_total_saturated", "606", "1258" } },
+        { "fiber_g", "Fibra", "g", false,
+          { "fibra", "fibra_alimentaria", "fibra_dietetica", "fibra_total", "fiber", "fiber_total_dietary", "291", "1079" } },
+        { "sodium_mg", "Sodio", "mg", true,
+          { "sodio", "sodium", "sodium_na", "na", "307", "1093" } },
+        { "potassium_mg", "Potasio", "mg", false,
+          { "potasio", "potassium", "potassium_k", "k", "306", "1092" } },
+        { "calcium_mg", "Calcio", "mg", false,
+          { "calcio", "calcium", "calcium_ca", "ca", "301", "1087" } },
+        { "iron_mg", "Hierro", "mg", false,
+          { "hierro", "hierro_total", "iron", "iron_fe", "fe", "303", "1089" } },
+        { "vitamin_c_mg", "Vitamina C", "mg", false,
+          { "vitamina_c", "acido_ascorbico", "vitamin_c", "vitamin_c_total_ascorbic_acid", "401", "1162" } },
+    };
+    return kInfo[nutrient];
+}
+
+// Factor para pasar de la unidad del catálogo a la del diario; 0 si no son compatibles
+double unitFactor(QString from, const QString& to)
+{
+    from = from.trimmed().toLower();
+    if (from.isEmpty() || from == to) {
+        return 1.0;
+    }
+    auto grams = [](const QString& unit) {
+        if (unit == "g") return 1.0;
+        if (unit == "mg") return 1e-3;
+        if (unit == "µg" || unit == "ug" || unit == "mcg") return 1e-6;
+        return 0.0;
+    };
+    if (grams(from) > 0.0 && grams(to) > 0.0) {
+        return grams(from) / grams(to);
+    }
+    if (from == "kj" && to == "kcal") {
+        return 1.0 / 4.184;
+    }
+    return 0.0;
+}
+
+// Columna del catálogo que corresponde a cada nutriente del diario (-1 si no la hay).
+// Se prefiere la unidad exacta: las tablas nacionales suelen traer "Energía (kJ)" y "Energía (kcal)".
+struct CatalogColumns {
+    int index[FoodDiary::NutrientCount];
+    double factor[FoodDiary::NutrientCount];
+
+    CatalogColumns()
+    {
+        const FoodCatalog *catalog = FoodCatalog::instance();
+        for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+            const NutrientInfo& wanted = info(FoodDiary::Nutrient(n));
+            index[n] = -1;
+            factor[n] = 0.0;
+            for (int i = 0; i < catalog->nutrientCount(); ++i) {
+                const FoodCatalog::Nutrient nutrient = catalog->nutrient(i);
+                if (!wanted.aliases.contains(nutrient.code.toLower())) {
+                    continue;
+                }
+                const double f = unitFactor(nutrient.unit, wanted.unit);
+                if (f > 0.0 && (index[n] < 0 || f == 1.0)) {
+                    index[n] = i;
+                    factor[n] = f;
+                }
+                if (f == 1.0) {
+                    break;
+                }
+            }
+        }
+    }
+};
+
+// Aporte por 100 g de un alimento del catálogo o de una receta; false si no existe
+bool compositionOf(const CatalogColumns& columns, const QString& foodCode, int recipeId,
+                   double out[FoodDiary::NutrientCount])
+{
+    if (recipeId >= 0) {
+        const QVector<double> per100g = RecipeGraph::instance()->recipePer100g(recipeId);
+        if (per100g.isEmpty()) {
+            return false;
+        }
+        for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+            out[n] = (columns.index[n] >= 0 && columns.index[n] < per100g.size())
+                         ? per100g[columns.index[n]] * columns.factor[n]
+                         : 0.0;
+        }
+        return true;
+    }
+    const FoodCatalog *catalog = FoodCatalog::instance();
+    const int food = catalog->foodIndex(foodCode);
+    if (food < 0) {
+        return false;
+    }
+    for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+        const float value = columns.index[n] >= 0 ? catalog->value(food, columns.index[n]) : NAN;
+        out[n] = std::isnan(value) ? 0.0 : double(value) * columns.factor[n];
+    }
+    return true;
+}
+
+QString nutrientColumnList()
+{
+    QStringList columns;
+    for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+        columns << FoodDiary::columnName(FoodDiary::Nutrient(n));
+    }
+    return columns.join(", ");
+}
+
+// Suma (o resta) el incremento de un día en 'daily_intake'. La fila se crea si no existe
+// y se borra cuando se queda sin entradas.
+bool applyDelta(int userId, const QDate& day, const FoodDiary::DayIntake& delta)
+{
+    static const QString updateSql = [] {
+        QStringList sets = { "entry_count = entry_count + :entry_count" };
+        for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+            const QString column = FoodDiary::columnName(FoodDiary::Nutrient(n));
+            sets << QString("%1 = %1 + :%1").arg(column);
+        }
+        return QString("UPDATE daily_intake SET %1 WHERE user_id = :user_id AND day = :day").arg(sets.join(", "));
+    }();
+    static const QString insertSql = [] {
+        QStringList placeholders;
+        for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+            placeholders << ":" + FoodDiary::columnName(FoodDiary::Nutrient(n));
+        }
+        return QString("INSERT INTO daily_intake (user_id, day, entry_count, %1) VALUES (:user_id, :day, :entry_count, %2)")
+            .arg(nutrientColumnList(), placeholders.join(", "));
+    }();
+
+    QSqlQuery query;
+    auto bindAll = [&]() {
+        query.bindValue(":user_id", userId);
+        query.bindValue(":day", day.toString(Qt::ISODate));
+        query.bindValue(":entry_count", delta.entryCount);
+        for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+            query.bindValue(":" + FoodDiary::columnName(FoodDiary::Nutrient(n)), delta.values[n]);
+        }
+    };
+
+    query.prepare(updateSql);
+    bindAll();
+    if (!query.exec()) {
+        qCritical() << "Error al actualizar la ingesta diaria del usuario" << userId << ":" << query.lastError().text();
+        return false;
+    }
+    // entry_count siempre cambia, así que 0 filas afectadas significa que el día no existía
+    if (query.numRowsAffected() == 0 && delta.entryCount > 0) {
+        query.prepare(insertSql);
+        bindAll();
+        if (!query.exec()) {
+            qCritical() << "Error al crear la ingesta diaria del usuario" << userId << ":" << query.lastError().text();
+            return false;
+        }
+    }
+    if (delta.entryCount < 0) {
+        query.prepare("DELETE FROM daily_intake WHERE user_id = :user_id AND day = :day AND entry_count <= 0");
+        query.bindValue(":user_id", userId);
+        query.bindValue(":day", day.toString(Qt::ISODate));
+        if (!query.exec()) {
+            qCritical() << "Error al limpiar la ingesta diaria del usuario" << userId << ":" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool applyDeltas(const QMap<QPair<int, QDate>, FoodDiary::DayIntake>& deltas)
+{
+    for (auto it = deltas.cbegin(); it != deltas.cend(); ++it) {
+        if (!applyDelta(it.key().first, it.key().second, it.value())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString placeholdersFor(int count)
+{
+    QStringList marks;
+    for (int i = 0; i < count; ++i) {
+        marks << "?";
+    }
+    return marks.join(", ");
+}
+
+} // namespace
+
+QString FoodDiary::columnName(Nutrient nutrient)
+{
+    return QString::fromLatin1(info(nutrient).column);
+}
+
+QString FoodDiary::label(Nutrient nutrient)
+{
+    return QString::fromUtf8(info(nutrient).label);
+}
+
+QString FoodDiary::unit(Nutrient nutrient)
+{
+    return QString::fromLatin1(info(nutrient).unit);
+}
+
+bool FoodDiary::isUpperLimit(Nutrient nutrient)
+{
+    return info(nutrient).upperLimit;
+}
+
+QString FoodDiary::mealName(Meal meal)
+{
+    switch (meal) {
+    case Breakfast: return "Desayuno";
+    case MidMorning: return "Media mañana";
+    case Lunch: return "Comida";
+    case Snack: return "Merienda";
+    case Dinner: return "Cena";
+    case OtherMeal: break;
+    }
+    return "Otro";
+}
+
+int FoodDiary::addEntries(QVector<Entry>& entries)
+{
+    if (entries.isEmpty()) {
+        return 0;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    // 1. Lo que aporta cada entrada, antes de tocar la base de datos
+    const CatalogColumns columns;
+    QMap<QPair<int, QDate>, DayIntake> deltas;
+    for (Entry& entry : entries) {
+        if (entry.userId <= 0 || !entry.day.isValid() || !(entry.grams > 0.0)) {
+            qWarning() << "Entrada de diario no válida (usuario, día o cantidad).";
+            return -1;
+        }
+        double per100g[NutrientCount];
+        if (!compositionOf(columns, entry.foodCode, entry.recipeId, per100g)) {
+            if (entry.recipeId >= 0) {
+                qWarning() << "Entrada de diario con una receta que no existe:" << entry.recipeId;
+            } else {
+                qWarning() << "Entrada de diario con un alimento que no está en el catálogo:" << entry.foodCode;
+            }
+            return -1;
+        }
+        const double portion = entry.grams / 100.0;
+        for (int n = 0; n < NutrientCount; ++n) {
+            entry.values[n] = per100g[n] * portion;
+        }
+        DayIntake& delta = deltas[qMakePair(entry.userId, entry.day)];
+        ++delta.entryCount;
+        for (int n = 0; n < NutrientCount; ++n) {
+            delta.values[n] += entry.values[n];
+        }
+    }
+
+    // 2. Un único INSERT por lotes y un UPDATE por paciente y día, en una transacción
+    QVariantList userIds, days, meals, foodCodes, recipeIds, grams;
+    QVector<QVariantList> values(NutrientCount);
+    for (const Entry& entry : std::as_const(entries)) {
+        userIds << entry.userId;
+        days << entry.day.toString(Qt::ISODate);
+        meals << int(entry.meal);
+        foodCodes << (entry.recipeId >= 0 ? QVariant() : QVariant(entry.foodCode));
+        recipeIds << (entry.recipeId >= 0 ? QVariant(entry.recipeId) : QVariant());
+        grams << entry.grams;
+        for (int n = 0; n < NutrientCount; ++n) {
+            values[n] << entry.values[n];
+        }
+    }
+
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QSqlQuery query;
+    query.prepare(QString("INSERT INTO food_diary (user_id, day, meal, food_code, recipe_id, grams, %1) VALUES (%2)")
+                      .arg(nutrientColumnList(), placeholdersFor(6 + NutrientCount)));
+    query.addBindValue(userIds);
+    query.addBindValue(days);
+    query.addBindValue(meals);
+    query.addBindValue(foodCodes);
+    query.addBindValue(recipeIds);
+    query.addBindValue(grams);
+    for (const QVariantList& column : std::as_const(values)) {
+        query.addBindValue(column);
+    }
+    if (!query.execBatch()) {
+        qCritical() << "Error al guardar las entradas del diario:" << query.lastError().text();
+        db.rollback();
+        return -1;
+    }
+    if (!applyDeltas(deltas)) {
+        db.rollback();
+        return -1;
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar las entradas del diario:" << db.lastError().text();
+        return -1;
+    }
+
+    qInfo() << "Diario:" << entries.size() << "entradas," << deltas.size() << "días actualizados en" << timer.elapsed() << "ms";
+    return int(entries.size());
+}
+
+bool FoodDiary::removeEntries(const QList<qint64>& entryIds)
+{
+    if (entryIds.isEmpty()) {
+        return true;
+    }
+    const QString inList = placeholdersFor(int(entryIds.size()));
+
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QSqlQuery query;
+    query.prepare(QString("SELECT user_id, day, %1 FROM food_diary WHERE entry_id IN (%2)").arg(nutrientColumnList(), inList));
+    for (qint64 id : entryIds) {
+        query.addBindValue(id);
+    }
+    if (!query.exec()) {
+        qCritical() << "Error al leer las entradas del diario a borrar:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    QMap<QPair<int, QDate>, DayIntake> deltas;
+    while (query.next()) {
+        DayIntake& delta = deltas[qMakePair(query.value(0).toInt(), QDate::fromString(query.value(1).toString(), Qt::ISODate))];
+        --delta.entryCount;
+        for (int n = 0; n < NutrientCount; ++n) {
+            delta.values[n] -= query.value(2 + n).toDouble();
+        }
+    }
+
+    query.prepare(QString("DELETE FROM food_diary WHERE entry_id IN (%1)").arg(inList));
+    for (qint64 id : entryIds) {
+        query.addBindValue(id);
+    }
+    if (!query.exec()) {
+        qCritical() << "Error al borrar las entradas del diario:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    if (!applyDeltas(deltas)) {
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar el borrado del diario:" << db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool FoodDiary::removeUserData(int userId)
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QSqlQuery query;
+    for (const char* table : { "food_diary", "daily_intake" }) {
+        query.prepare(QString("DELETE FROM %1 WHERE user_id = :user_id").arg(table));
+        query.bindValue(":user_id", userId);
+        if (!query.exec()) {
+            qCritical() << "Error al borrar" << table << "del usuario" << userId << ":" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar el borrado del diario del usuario" << userId << ":" << db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+QVector<FoodDiary::Entry> FoodDiary::entries(int userId, const QDate& day)
+{
+    QVector<Entry> result;
+    QSqlQuery query;
+    query.prepare(QString("SELECT entry_id, meal, food_code, recipe_id, grams, %1 FROM food_diary "
+                          "WHERE user_id = :user_id AND day = :day ORDER BY meal, entry_id").arg(nutrientColumnList()));
+    query.bindValue(":user_id", userId);
+    query.bindValue(":day", day.toString(Qt::ISODate));
+    if (!query.exec()) {
+        qCritical() << "Error al leer el diario del usuario" << userId << ":" << query.lastError().text();
+        return result;
+    }
+    while (query.next()) {
+        Entry entry;
+        entry.entryId = query.value(0).toLongLong();
+        entry.userId = userId;
+        entry.day = day;
+        entry.meal = Meal(query.value(1).toInt());
+        entry.foodCode = query.value(2).toString();
+        entry.recipeId = query.value(3).isNull() ? -1 : query.value(3).toInt();
+        entry.grams = query.value(4).toDouble();
+        for (int n = 0; n < NutrientCount; ++n) {
+            entry.values[n] = query.value(5 + n).toDouble();
+        }
+        result.append(entry);
+    }
+    return result;
+}
+
+QVector<FoodDiary::Composition> FoodDiary::compositionPer100g(const QVector<QPair<QString, int>>& items)
+{
+    const CatalogColumns columns;
+    QVector<Composition> result(items.size());
+    for (qsizetype i = 0; i < items.size(); ++i) {
+        result[i].valid = compositionOf(columns, items[i].first, items[i].second, result[i].values);
+    }
+    return result;
+}
+
+QVector<FoodDiary::DayIntake> FoodDiary::dailyIntake(int userId, const QDate& from, const QDate& to)
+{
+    QVector<DayIntake> result;
+    if (!from.isValid() || !to.isValid() || to < from) {
+        return result;
+    }
+    for (QDate day = from; day <= to; day = day.addDays(1)) {
+        DayIntake intake;
+        intake.day = day;
+        result.append(intake);
+    }
+
+    QSqlQuery query;
+    query.prepare(QString("SELECT day, entry_count, %1 FROM daily_intake "
+                          "WHERE user_id = :user_id AND day >= :from AND day <= :to").arg(nutrientColumnList()));
+    query.bindValue(":user_id", userId);
+    query.bindValue(":from", from.toString(Qt::ISODate));
+    query.bindValue(":to", to.toString(Qt::ISODate));
+    if (!query.exec()) {
+        qCritical() << "Error al leer la ingesta diaria del usuario" << userId << ":" << query.lastError().text();
+        return result;
+    }
+    while (query.next()) {
+        const qint64 offset = from.daysTo(QDate::fromString(query.value(0).toString(), Qt::ISODate));
+        if (offset < 0 || offset >= result.size()) {
+            continue;
+        }
+        DayIntake& intake = result[offset];
+        intake.entryCount = query.value(1).toInt();
+        for (int n = 0; n < NutrientCount; ++n) {
+            intake.values[n] = query.value(2 + n).toDouble();
+        }
+    }
+    return result;
+}
+
+QVector<FoodDiary::DayIntake> FoodDiary::weeklyIntake(int userId, const QDate& day)
+{
+    const QDate monday = day.addDays(1 - day.dayOfWeek());
+    return dailyIntake(userId, monday, monday.addDays(6));
+}
+
+FoodDiary::Targets FoodDiary::targetsFor(double targetKcal)
+{
+    Targets targets;
+    if (!(targetKcal > 0.0)) {
+        return targets;
+    }
+    targets.values[EnergyKcal] = targetKcal;
+    targets.values[ProteinG] = targetKcal * 0.15 / 4.0;
+    targets.values[CarbohydrateG] = targetKcal * 0.50 / 4.0;
+    targets.values[FatG] = targetKcal * 0.35 / 9.0;
+    targets.values[SugarsG] = targetKcal * 0.10 / 4.0;      // Máximo: 10 % de la energía (OMS)
+    targets.values[SaturatedFatG] = targetKcal * 0.10 / 9.0; // Máximo: 10 % de la energía
+    targets.values[FiberG] = targetKcal * 14.0 / 1000.0;     // 14 g por cada 1000 kcal
+    targets.values[SodiumMg] = 2000.0;                       // Máximo (OMS)
+    targets.values[PotassiumMg] = 3500.0;
+    targets.values[CalciumMg] = 950.0;
+    targets.values[IronMg] = 13.0;
+    targets.values[VitaminCMg] = 100.0;
+    return targets;
+}
+
+FoodDiary::Adherence FoodDiary::adherence(int userId, const QDate& from, const QDate& to, const Targets& targets)
+{
+    Adherence result;
+    const QVector<DayIntake> days = dailyIntake(userId, from, to);
+    for (const DayIntake& day : days) {
+        if (day.entryCount == 0) {
+            continue; // Un día sin registrar no es un día de ayuno
+        }
+        ++result.daysLogged;
+        for (int n = 0; n < NutrientCount; ++n) {
+            result.average[n] += day.values[n];
+        }
+    }
+    for (int n = 0; n < NutrientCount; ++n) {
+        if (result.daysLogged > 0) {
+            result.average[n] /= result.daysLogged;
+        }
+        result.ratio[n] = targets.values[n] > 0.0 ? result.average[n] / targets.values[n] : 0.0;
+    }
+    return result;
+}
+
+bool FoodDiary::rebuildRollups()
+{
+    QElapsedTimer timer;
+    timer.start();
+    QStringList sums;
+    for (int n = 0; n < NutrientCount; ++n) {
+        sums << QString("SUM(%1)").arg(columnName(Nutrient(n)));
+    }
+
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QSqlQuery query;
+    if (!query.exec("DELETE FROM daily_intake")
+        || !query.exec(QString("INSERT INTO daily_intake (user_id, day, entry_count, %1) "
+                               "SELECT user_id, day, COUNT(*), %2 FROM food_diary GROUP BY user_id, day")
+                           .arg(nutrientColumnList(), sums.join(", ")))) {
+        qCritical() << "Error al reconstruir la ingesta diaria:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar la ingesta diaria:" << db.lastError().text();
+        return false;
+    }
+    qInfo() << "Ingesta diaria reconstruida en" << timer.elapsed() << "ms";
+    return true;
+}
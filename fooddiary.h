@@ -0,0 +1,113 @@
+#ifndef FOODDIARY_H
+#define FOODDIARY_H
+
+#include <QDate>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+// Diario de alimentación: lo que come cada paciente por día y comida ('food_diary'),
+// con un resumen por paciente y día ('daily_intake') de energía, macronutrientes y algunos
+// micronutrientes clave.
+//  - Las altas van por lotes: una transacción, una sentencia preparada (execBatch) y una sola
+//    actualización de 'daily_intake' por paciente y día del lote, sumando el incremento.
+//  - Cada fila del diario guarda lo que aportó al registrarse (catálogo o receta en ese momento),
+//    así que al borrarla se resta exactamente lo mismo y el histórico no cambia al reimportar tablas.
+//  - Las vistas semanales y la adherencia a objetivos leen solo 'daily_intake' (una fila por día).
+class FoodDiary
+{
+public:
+    enum Meal {
+        Breakfast = 0,
+        MidMorning = 1,
+        Lunch = 2,
+        Snack = 3,
+        Dinner = 4,
+        OtherMeal = 5
+    };
+
+    // Columnas del resumen diario (mismo orden en food_diary y daily_intake)
+    enum Nutrient {
+        EnergyKcal,
+        ProteinG,
+        CarbohydrateG,
+        SugarsG,
+        FatG,
+        SaturatedFatG,
+        FiberG,
+        SodiumMg,
+        PotassiumMg,
+        CalciumMg,
+        IronMg,
+        VitaminCMg,
+        NutrientCount
+    };
+
+    struct Entry {
+        qint64 entryId = -1;
+        int userId = -1;
+        QDate day;
+        Meal meal = OtherMeal;
+        QString foodCode;  // Alimento del catálogo...
+        int recipeId = -1; // ...o receta (RecipeGraph)
+        double grams = 0.0;
+        double values[NutrientCount] = {}; // Lo que aporta la entrada (se calcula al guardarla)
+    };
+
+    struct DayIntake {
+        QDate day;
+        int entryCount = 0;
+        double values[NutrientCount] = {};
+    };
+
+    // Objetivos diarios; 0 = sin objetivo. Los "máximos" (azúcares, grasa saturada, sodio) son límites.
+    struct Targets {
+        double values[NutrientCount] = {};
+    };
+
+    // Aporte por 100 g de un alimento o una receta
+    struct Composition {
+        bool valid = false; // false si el alimento o la receta no existen
+        double values[NutrientCount] = {};
+    };
+
+    struct Adherence {
+        int daysLogged = 0;                  // Días con alguna entrada en el periodo
+        double average[NutrientCount] = {};  // Media por día registrado
+        double ratio[NutrientCount] = {};    // average / objetivo (0 si no hay objetivo)
+    };
+
+    static QString columnName(Nutrient nutrient);
+    static QString label(Nutrient nutrient);
+    static QString unit(Nutrient nutrient);
+    static bool isUpperLimit(Nutrient nutrient);
+    static QString mealName(Meal meal);
+
+    // Guarda las entradas en bloque y actualiza el resumen diario en la misma transacción.
+    // Calcula 'values' de cada entrada. Retorna el número de entradas guardadas o -1 si hay un error.
+    static int addEntries(QVector<Entry>& entries);
+    static bool removeEntries(const QList<qint64>& entryIds);
+    // Borra el diario y el resumen diario de un paciente (DataChangeHub::userDeleted, ver main.cpp):
+    // las claves foráneas no se aplican, así que el borrado del paciente no los arrastra
+    static bool removeUserData(int userId);
+    static QVector<Entry> entries(int userId, const QDate& day);
+
+    // Composición por 100 g de cada elemento: (código de alimento, -1) o ("", id de receta)
+    static QVector<Composition> compositionPer100g(const QVector<QPair<QString, int>>& items);
+
+    // Resumen día a día entre from y to (ambos incluidos); los días sin registro van vacíos
+    static QVector<DayIntake> dailyIntake(int userId, const QDate& from, const QDate& to);
+    // Semana de lunes a domingo que contiene 'day'
+    static QVector<DayIntake> weeklyIntake(int userId, const QDate& day);
+
+    // Objetivos a partir de la energía objetivo (EnergyCalculator): reparto de macronutrientes
+    // 15 % proteína, 50 % hidratos, 35 % grasa y referencias de micronutrientes de adulto (OMS/EFSA)
+    static Targets targetsFor(double targetKcal);
+    static Adherence adherence(int userId, const QDate& from, const QDate& to, const Targets& targets);
+
+    // Reconstruye 'daily_intake' a partir del diario (reparación; las escrituras lo mantienen solo)
+    static bool rebuildRollups();
+};
+
+#endif // FOODDIARY_H
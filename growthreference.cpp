@@ -0,0 +1,228 @@
+#include "growthreference.h"
+#include "whotables.h" // Generado al configurar (whotables.cmake) a partir de who/*.txt
+#include <cmath>
+
+namespace {
+
+using LmsRow = WhoTables::Row;
+
+// Tablas incorporadas: una fila por mes (0 = nacimiento) de las tablas LMS de la OMS (2006),
+// de 0 a 12 meses. Solo se usan para los indicadores que no se compilaron desde who/.
+constexpr int kMonths = 13;
+
+constexpr LmsRow kWeightBoys[kMonths] = {
+    { 0.3487, 3.3464, 0.14602 }, { 0.2297, 4.4709, 0.13395 }, { 0.1970, 5.5675, 0.12385 },
+    { 0.1738, 6.3762, 0.11727 }, { 0.1553, 7.0023, 0.11316 }, { 0.1395, 7.5105, 0.11080 },
+    { 0.1257, 7.9340, 0.10958 }, { 0.1134, 8.2970, 0.10902 }, { 0.1021, 8.6151, 0.10882 },
+    { 0.0917, 8.9014, 0.10881 }, { 0.0820, 9.1649, 0.10891 }, { 0.0730, 9.4122, 0.10906 },
+    { 0.0644, 9.6479, 0.10925 },
+};
+
+constexpr LmsRow kWeightGirls[kMonths] = {
+    { 0.3809, 3.2322, 0.14171 }, { 0.1714, 4.1873, 0.13724 }, { 0.0962, 5.1282, 0.13000 },
+    { 0.0402, 5.8458, 0.12619 }, { -0.0050, 6.4237, 0.12402 }, { -0.0430, 6.8985, 0.12274 },
+    { -0.0756, 7.2970, 0.12204 }, { -0.1039, 7.6422, 0.12178 }, { -0.1288, 7.9487, 0.12181 },
+    { -0.1507, 8.2254, 0.12199 }, { -0.1700, 8.4800, 0.12223 }, { -0.1872, 8.7192, 0.12247 },
+    { -0.2024, 8.9481, 0.12268 },
+};
+
+constexpr LmsRow kLengthBoys[kMonths] = {
+    { 1.0, 49.8842, 0.03795 }, { 1.0, 54.7244, 0.03557 }, { 1.0, 58.4249, 0.03424 },
+    { 1.0, 61.4292, 0.03328 }, { 1.0, 63.8860, 0.03257 }, { 1.0, 65.9026, 0.03204 },
+    { 1.0, 67.6236, 0.03165 }, { 1.0, 69.1645, 0.03139 }, { 1.0, 70.5994, 0.03124 },
+    { 1.0, 71.9687, 0.03117 }, { 1.0, 73.2812, 0.03118 }, { 1.0, 74.5388, 0.03125 },
+    { 1.0, 75.7488, 0.03137 },
+};
+
+constexpr LmsRow kLengthGirls[kMonths] = {
+    { 1.0, 49.1477, 0.03790 }, { 1.0, 53.6872, 0.03640 }, { 1.0, 57.0673, 0.03568 },
+    { 1.0, 59.8029, 0.03520 }, { 1.0, 62.0899, 0.03486 }, { 1.0, 64.0301, 0.03463 },
+    { 1.0, 65.7311, 0.03448 }, { 1.0, 67.2873, 0.03441 }, { 1.0, 68.7498, 0.03440 },
+    { 1.0, 70.1435, 0.03444 }, { 1.0, 71.4818, 0.03452 }, { 1.0, 72.7710, 0.03464 },
+    { 1.0, 74.0150, 0.03479 },
+};
+
+constexpr LmsRow kBmiBoys[kMonths] = {
+    { -0.3053, 13.4069, 0.09560 }, { 0.2708, 14.9441, 0.09027 }, { 0.1118, 16.3195, 0.08677 },
+    { 0.0068, 16.8987, 0.08495 }, { -0.0727, 17.1579, 0.08378 }, { -0.1370, 17.2919, 0.08296 },
+    { -0.1913, 17.3422, 0.08233 }, { -0.2385, 17.3288, 0.08183 }, { -0.2802, 17.2647, 0.08142 },
+    { -0.3176, 17.1662, 0.08109 }, { -0.3516, 17.0488, 0.08083 }, { -0.3828, 16.9239, 0.08064 },
+    { -0.4115, 16.7981, 0.08050 },
+};
+
+constexpr LmsRow kBmiGirls[kMonths] = {
+    { -0.0631, 13.3363, 0.09272 }, { 0.3448, 14.5679, 0.09556 }, { 0.1749, 15.7679, 0.09371 },
+    { 0.0643, 16.3574, 0.09254 }, { -0.0191, 16.6703, 0.09166 }, { -0.0864, 16.8386, 0.09096 },
+    { -0.1429, 16.9083, 0.09036 }, { -0.1916, 16.9020, 0.08984 }, { -0.2344, 16.8404, 0.08939 },
+    { -0.2725, 16.7406, 0.08898 }, { -0.3068, 16.6184, 0.08861 }, { -0.3381, 16.4875, 0.08828 },
+    { -0.3667, 16.3568, 0.08797 },
+};
+
+constexpr const LmsRow* kTables[3][2] = {
+    { kWeightBoys, kWeightGirls },
+    { kLengthBoys, kLengthGirls },
+    { kBmiBoys, kBmiGirls },
+};
+
+constexpr double kDaysPerMonth = 30.4375; // Igual que la OMS (365,25 / 12)
+
+const LmsRow* tableFor(GrowthReference::Indicator indicator, GrowthReference::Sex sex, int& rows)
+{
+    if (WhoTables::kRows[indicator][sex] > 0) {
+        rows = WhoTables::kRows[indicator][sex];
+        return WhoTables::kTables[indicator][sex];
+    }
+    rows = kMonths;
+    return kTables[indicator][sex];
+}
+
+double rawZ(const GrowthReference::Lms& lms, double value)
+{
+    if (std::fabs(lms.l) < 1e-12) {
+        return std::log(value / lms.m) / lms.s;
+    }
+    return (std::pow(value / lms.m, lms.l) - 1.0) / (lms.l * lms.s);
+}
+
+} // namespace
+
+double GrowthReference::maxAgeMonths(Indicator indicator, Sex sex)
+{
+    int rows = 0;
+    tableFor(indicator, sex, rows);
+    return rows - 1;
+}
+
+GrowthReference::Lms GrowthReference::lms(Indicator indicator, Sex sex, double ageMonths)
+{
+    Lms result;
+    int rows = 0;
+    const LmsRow* table = tableFor(indicator, sex, rows);
+    if (!(ageMonths >= 0.0) || ageMonths > rows - 1) {
+        return result;
+    }
+    const int lower = qMin(int(ageMonths), rows - 2);
+    const double t = ageMonths - lower;
+    const LmsRow& a = table[lower];
+    const LmsRow& b = table[lower + 1];
+    result.valid = true;
+    result.l = a.l + (b.l - a.l) * t;
+    result.m = a.m + (b.m - a.m) * t;
+    result.s = a.s + (b.s - a.s) * t;
+    return result;
+}
+
+double GrowthReference::valueAtZ(const Lms& lms, double z)
+{
+    if (std::fabs(lms.l) < 1e-12) {
+        return lms.m * std::exp(lms.s * z);
+    }
+    return lms.m * std::pow(1.0 + lms.l * lms.s * z, 1.0 / lms.l);
+}
+
+double GrowthReference::zScore(Indicator indicator, const Lms& lms, double value)
+{
+    if (!lms.valid || value <= 0.0) {
+        return 0.0;
+    }
+    const double z = rawZ(lms, value);
+    if (indicator == HeightForAge || std::fabs(z) <= 3.0) {
+        return z;
+    }
+    // Corrección de la OMS para peso e IMC: por encima de |3| se usa la distancia entre SD2 y SD3
+    if (z > 3.0) {
+        const double sd3 = valueAtZ(lms, 3.0);
+        const double sd23 = sd3 - valueAtZ(lms, 2.0);
+        return 3.0 + (value - sd3) / sd23;
+    }
+    const double sd3neg = valueAtZ(lms, -3.0);
+    const double sd23neg = valueAtZ(lms, -2.0) - sd3neg;
+    return -3.0 + (value - sd3neg) / sd23neg;
+}
+
+double GrowthReference::percentileFromZ(double z)
+{
+    return 50.0 * std::erfc(-z / std::sqrt(2.0));
+}
+
+double GrowthReference::ageInMonths(const QDate& birthDate, const QDate& date)
+{
+    if (!birthDate.isValid() || !date.isValid()) {
+        return -1.0;
+    }
+    return birthDate.daysTo(date) / kDaysPerMonth;
+}
+
+bool GrowthReference::sexFor(const QString& gender, Sex& sex)
+{
+    const QString value = User::normalizeGender(gender); // "Mujer" no debe contar como Masculino
+    if (value == "Masculino") {
+        sex = Male;
+        return true;
+    }
+    if (value == "Femenino") {
+        sex = Female;
+        return true;
+    }
+    return false;
+}
+
+GrowthReference::Assessment GrowthReference::assess(const User& user, const HealthMetric& metric)
+{
+    Assessment result;
+    Sex sex;
+    if (!sexFor(user.gender(), sex)) {
+        return result;
+    }
+    const double age = ageInMonths(user.birthDate(), metric.date());
+    // Cada indicador tiene su cobertura (el peso/edad de la OMS acaba a los 10 años)
+    const Lms weight = lms(WeightForAge, sex, age);
+    const Lms height = lms(HeightForAge, sex, age);
+    const Lms bmi = lms(BmiForAge, sex, age);
+
+    result.ageMonths = age;
+    if (weight.valid) {
+        result.weightValid = true;
+        result.weightZ = zScore(WeightForAge, weight, metric.weight());
+        result.weightPercentile = percentileFromZ(result.weightZ);
+    }
+    if (height.valid) {
+        result.heightValid = true;
+        result.heightZ = zScore(HeightForAge, height, metric.height());
+        result.heightPercentile = percentileFromZ(result.heightZ);
+    }
+    if (bmi.valid) {
+        result.bmiValid = true;
+        result.bmiZ = zScore(BmiForAge, bmi, metric.bmi());
+        result.bmiPercentile = percentileFromZ(result.bmiZ);
+    }
+    result.valid = result.weightValid || result.heightValid || result.bmiValid;
+    return result;
+}
+
+QVector<QVector<double>> GrowthReference::bands(Indicator indicator, Sex sex, const QVector<double>& ageMonths,
+                                                const QVector<double>& zLevels)
+{
+    QVector<QVector<double>> curves(zLevels.size(), QVector<double>(ageMonths.size(), 0.0));
+    for (int i = 0; i < ageMonths.size(); ++i) {
+        const Lms params = lms(indicator, sex, ageMonths.at(i));
+        if (!params.valid) {
+            continue; // Fuera de la cobertura: la curva queda a 0 en ese punto
+        }
+        for (int k = 0; k < zLevels.size(); ++k) {
+            curves[k][i] = valueAtZ(params, zLevels.at(k));
+        }
+    }
+    return curves;
+}
+
+QVector<double> GrowthReference::standardZLevels()
+{
+    // P3, P15, P50, P85, P97
+    return { -1.880794, -1.036433, 0.0, 1.036433, 1.880794 };
+}
+
+QStringList GrowthReference::standardPercentileNames()
+{
+    return { "P3", "P15", "P50", "P85", "P97" };
+}
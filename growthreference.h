@@ -0,0 +1,86 @@
+#ifndef GROWTHREFERENCE_H
+#define GROWTHREFERENCE_H
+
+#include <QDate>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "user.h"
+#include "healtmetric.h"
+
+// Percentiles y puntuaciones z pediátricas con el método LMS de la OMS (Patrones de Crecimiento Infantil).
+// Las tablas L, M, S tienen una fila por mes de edad; entre meses se interpola linealmente.
+// La fila se obtiene por índice directo (sin búsquedas).
+//
+// Las tablas completas se compilan en el programa como arrays constexpr (whotables.h, que genera
+// whotables.cmake al configurar a partir de los archivos de la OMS en who/): patrones de 2006
+// (0-5 años) y referencia de 2007 (5-19 años; peso/edad solo hasta 10 años). No se lee nada al
+// arrancar. Los indicadores sin archivo usan las tablas incorporadas, de 0 a 12 meses. Fuera de
+// la cobertura de cada indicador (maxAgeMonths) las funciones devuelven resultados no válidos.
+class GrowthReference
+{
+public:
+    enum Indicator {
+        WeightForAge,
+        HeightForAge, // Longitud (tumbado) en los primeros meses
+        BmiForAge
+    };
+
+    enum Sex {
+        Male,
+        Female
+    };
+
+    struct Lms {
+        bool valid = false;
+        double l = 0.0;
+        double m = 0.0;
+        double s = 0.0;
+    };
+
+    // Resultado para una fila de métricas
+    struct Assessment {
+        bool valid = false;        // false si la edad o el sexo quedan fuera de todas las tablas
+        bool weightValid = false;  // Cobertura de cada indicador por separado
+        bool heightValid = false;
+        bool bmiValid = false;
+        double ageMonths = 0.0;
+        double weightZ = 0.0;
+        double weightPercentile = 0.0;
+        double heightZ = 0.0;
+        double heightPercentile = 0.0;
+        double bmiZ = 0.0;
+        double bmiPercentile = 0.0;
+    };
+
+    // Última edad (en meses) cubierta por la tabla
+    static double maxAgeMonths(Indicator indicator, Sex sex);
+
+    // Parámetros LMS interpolados a una edad (en meses)
+    static Lms lms(Indicator indicator, Sex sex, double ageMonths);
+
+    // Puntuación z del valor medido (con la corrección de la OMS para |z| > 3 en peso e IMC)
+    static double zScore(Indicator indicator, const Lms& lms, double value);
+    // Percentil (0-100) de una puntuación z
+    static double percentileFromZ(double z);
+    // Valor de la referencia correspondiente a una puntuación z
+    static double valueAtZ(const Lms& lms, double z);
+
+    // Evalúa una medición del paciente. La edad se calcula con User::birthDate y la fecha de la métrica.
+    static Assessment assess(const User& user, const HealthMetric& metric);
+
+    // Curvas de percentiles en bloque: para cada edad se interpolan los LMS una sola vez
+    // y se calculan todas las curvas. bands[k][i] = valor de la curva k (zLevels[k]) a ageMonths[i].
+    static QVector<QVector<double>> bands(Indicator indicator, Sex sex, const QVector<double>& ageMonths,
+                                          const QVector<double>& zLevels);
+
+    // Puntuaciones z de las curvas habituales (P3, P15, P50, P85, P97)
+    static QVector<double> standardZLevels();
+    static QStringList standardPercentileNames();
+
+    static double ageInMonths(const QDate& birthDate, const QDate& date);
+    // false si el género no es masculino ni femenino (las tablas dependen del sexo)
+    static bool sexFor(const QString& gender, Sex& sex);
+};
+
+#endif // GROWTHREFERENCE_H
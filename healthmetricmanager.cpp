@@ -1,8 +1,12 @@
 #include "healthmetricmanager.h"
+#include "datachangehub.h"
 #include <QDebug>
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
+#include <QSqlDatabase>
+#include "textnormalizer.h"
+#include "metricrollups.h"
 
 HealthMetricManager::HealthMetricManager(QObject *parent) : QObject(parent)
 {
@@ -34,23 +38,51 @@ bool HealthMetricManager::addHealthMetric(const HealthMetric& metric)
     }
 
     qInfo() << "Métrica de salud añadida correctamente para el usuario ID:" << metric.userId();
+    MetricRollups::addMeasurement(metric.userId(), metric.date(), metric.weight(), metric.bmi());
+    emit DataChangeHub::instance()->healthMetricAdded(metric.userId(), query.lastInsertId().toInt());
     return true;
 }
 
 // Implementación para obtener métricas de salud por ID de usuario (CORREGIDA)
 QList<QSharedPointer<HealthMetric>> HealthMetricManager::getHealthMetricsByUserId(int userId)
 {
-    QList<QSharedPointer<HealthMetric>> metrics;
     QSqlQuery query;
-    query.prepare("SELECT metric_id, user_id, date, weight, height, bmi, body_fat_percentage, muscle_mass_percentage, notes, created_at " // Añadido created_at
+    query.prepare("SELECT " + metricColumns() + " "
                   "FROM health_metrics WHERE user_id = :user_id ORDER BY date ASC, created_at ASC"); // Ordenar por fecha y luego por hora de creación
     query.bindValue(":user_id", userId);
 
     if (!query.exec()) {
         qCritical() << "Error al obtener métricas de salud por usuario ID:" << query.lastError().text();
-        return metrics; // Retorna lista vacía en caso de error
+        return QList<QSharedPointer<HealthMetric>>(); // Retorna lista vacía en caso de error
     }
 
+    const QList<QSharedPointer<HealthMetric>> metrics = readMetrics(query);
+    qInfo() << "Obtenidas" << metrics.count() << "métricas de salud para el usuario ID:" << userId;
+    return metrics;
+}
+
+QList<QSharedPointer<HealthMetric>> HealthMetricManager::getHealthMetricsByUserId(int userId, const QDate& from, const QDate& to)
+{
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.prepare("SELECT " + metricColumns() + " "
+                  "FROM health_metrics WHERE user_id = :user_id AND date BETWEEN :from AND :to "
+                  "ORDER BY date ASC, created_at ASC");
+    query.bindValue(":user_id", userId);
+    query.bindValue(":from", from.toString(Qt::ISODate));
+    query.bindValue(":to", to.toString(Qt::ISODate));
+
+    if (!query.exec()) {
+        qCritical() << "Error al obtener métricas de salud del periodo para el usuario ID:" << userId
+                    << query.lastError().text();
+        return QList<QSharedPointer<HealthMetric>>();
+    }
+    return readMetrics(query);
+}
+
+QList<QSharedPointer<HealthMetric>> HealthMetricManager::readMetrics(QSqlQuery& query)
+{
+    QList<QSharedPointer<HealthMetric>> metrics;
     while (query.next()) {
         // Extraer todos los valores de la fila de la base de datos
         int id = query.value("metric_id").toInt();
@@ -66,12 +98,12 @@ QList<QSharedPointer<HealthMetric>> HealthMetricManager::getHealthMetricsByUserI
 
         // Ahora, creamos el QSharedPointer y pasamos TODOS los argumentos
         // al constructor de HealthMetric que recibe todos los campos (el primero en HealthMetric.h)
-        metrics.append(QSharedPointer<HealthMetric>::create(
+        QSharedPointer<HealthMetric> metric = QSharedPointer<HealthMetric>::create(
             id, retrievedUserId, date, weight, height, bmi, bodyFatPercentage, muscleMassPercentage, notes, createdAt
-            ));
+            );
+        readDerivedColumns(query, *metric);
+        metrics.append(metric);
     }
-
-    qInfo() << "Obtenidas" << metrics.count() << "métricas de salud para el usuario ID:" << userId;
     return metrics;
 }
 
@@ -84,6 +116,16 @@ bool HealthMetricManager::updateHealthMetric(const HealthMetric& metric)
     }
 
     QSqlQuery query;
+    // Fecha y paciente anteriores: sus periodos resumidos también cambian
+    int previousUserId = -1;
+    QDate previousDate;
+    query.prepare("SELECT user_id, date FROM health_metrics WHERE metric_id = :metric_id");
+    query.bindValue(":metric_id", metric.id());
+    if (query.exec() && query.next()) {
+        previousUserId = query.value(0).toInt();
+        previousDate = QDate::fromString(query.value(1).toString(), Qt::ISODate);
+    }
+
     query.prepare("UPDATE health_metrics SET "
                   "user_id = :user_id, "
                   "date = :date, "
@@ -116,6 +158,11 @@ bool HealthMetricManager::updateHealthMetric(const HealthMetric& metric)
     }
 
     qInfo() << "Métrica de salud con ID" << metric.id() << "actualizada correctamente.";
+    MetricRollups::refreshPeriods(metric.userId(), metric.date());
+    if (previousUserId > 0 && (previousUserId != metric.userId() || previousDate != metric.date())) {
+        MetricRollups::refreshPeriods(previousUserId, previousDate);
+    }
+    emit DataChangeHub::instance()->healthMetricUpdated(metric.userId(), metric.id());
     return true;
 }
 
@@ -128,6 +175,16 @@ bool HealthMetricManager::deleteHealthMetric(int metricId)
     }
 
     QSqlQuery query;
+    // Recuperamos el paciente y la fecha antes de borrar para notificar el cambio y actualizar los resúmenes
+    int userId = -1;
+    QDate date;
+    query.prepare("SELECT user_id, date FROM health_metrics WHERE metric_id = :metric_id");
+    query.bindValue(":metric_id", metricId);
+    if (query.exec() && query.next()) {
+        userId = query.value(0).toInt();
+        date = QDate::fromString(query.value(1).toString(), Qt::ISODate);
+    }
+
     query.prepare("DELETE FROM health_metrics WHERE metric_id = :metric_id");
     query.bindValue(":metric_id", metricId);
 
@@ -142,6 +199,10 @@ bool HealthMetricManager::deleteHealthMetric(int metricId)
     }
 
     qInfo() << "Métrica de salud con ID" << metricId << "eliminada correctamente.";
+    if (userId > 0) {
+        MetricRollups::refreshPeriods(userId, date);
+    }
+    emit DataChangeHub::instance()->healthMetricDeleted(userId, metricId);
     return true;
 }
 
@@ -149,7 +210,7 @@ HealthMetric HealthMetricManager::getHealthMetric(int metricId)
 {
     HealthMetric metrics;
     QSqlQuery query;
-    query.prepare("SELECT metric_id, user_id, date, weight, height, bmi, body_fat_percentage, muscle_mass_percentage, notes, created_at " // Añadido created_at
+    query.prepare("SELECT " + metricColumns() + " "
                   "FROM health_metrics WHERE metric_id = :metric_id ");
     query.bindValue(":metric_id", metricId);
     if (!query.exec()) {
@@ -167,5 +228,321 @@ HealthMetric HealthMetricManager::getHealthMetric(int metricId)
     metrics.setMuscleMassPercentage(query.value("muscle_mass_percentage").toDouble());
     metrics.setNotes(query.value("notes").toString());
     metrics.setCreatedAt(query.value("created_at").toDateTime());
+    readDerivedColumns(query, metrics);
     return metrics;
 }
+
+HealthMetric HealthMetricManager::getLatestHealthMetric(int userId)
+{
+    HealthMetric metric; // id() == -1 si no hay métricas
+    QSqlQuery query;
+    query.prepare("SELECT " + metricColumns() + " "
+                  "FROM health_metrics WHERE user_id = :user_id ORDER BY date DESC, created_at DESC LIMIT 1");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al obtener la última métrica del usuario" << userId << ":" << query.lastError().text();
+        return metric;
+    }
+    if (!query.next()) {
+        return metric;
+    }
+    metric.setId(query.value("metric_id").toInt());
+    metric.setUserId(query.value("user_id").toInt());
+    metric.setDate(QDate::fromString(query.value("date").toString(), Qt::ISODate));
+    metric.setWeight(query.value("weight").toDouble());
+    metric.setHeight(query.value("height").toDouble());
+    metric.setBmi(query.value("bmi").toDouble());
+    metric.setBodyFatPercentage(query.value("body_fat_percentage").toDouble());
+    metric.setMuscleMassPercentage(query.value("muscle_mass_percentage").toDouble());
+    metric.setNotes(query.value("notes").toString());
+    metric.setCreatedAt(query.value("created_at").toDateTime());
+    readDerivedColumns(query, metric);
+    return metric;
+}
+
+QHash<int, double> HealthMetricManager::getLatestBmiForAllUsers()
+{
+    QHash<int, double> latest;
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    // Ordenado por paciente y fecha: la última fila de cada paciente es su medición más reciente
+    if (!query.exec("SELECT user_id, bmi FROM health_metrics ORDER BY user_id, date, created_at")) {
+        qCritical() << "Error al obtener el último IMC de los pacientes:" << query.lastError().text();
+        return latest;
+    }
+    while (query.next()) {
+        latest.insert(query.value(0).toInt(), query.value(1).toDouble());
+    }
+    return latest;
+}
+
+QHash<int, HealthMetric> HealthMetricManager::getLatestHealthMetricForAllUsers(const QSqlDatabase& db)
+{
+    QHash<int, HealthMetric> latest;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    // Mismo recorrido que getLatestBmiForAllUsers: la última fila de cada paciente sobrescribe las anteriores
+    if (!query.exec("SELECT " + metricColumns() + " FROM health_metrics ORDER BY user_id, date, created_at")) {
+        qCritical() << "Error al obtener la última métrica de los pacientes:" << query.lastError().text();
+        return latest;
+    }
+    while (query.next()) {
+        HealthMetric metric;
+        metric.setId(query.value("metric_id").toInt());
+        metric.setUserId(query.value("user_id").toInt());
+        metric.setDate(QDate::fromString(query.value("date").toString(), Qt::ISODate));
+        metric.setWeight(query.value("weight").toDouble());
+        metric.setHeight(query.value("height").toDouble());
+        metric.setBmi(query.value("bmi").toDouble());
+        metric.setBodyFatPercentage(query.value("body_fat_percentage").toDouble());
+        metric.setMuscleMassPercentage(query.value("muscle_mass_percentage").toDouble());
+        metric.setCreatedAt(query.value("created_at").toDateTime());
+        readDerivedColumns(query, metric);
+        latest.insert(metric.userId(), metric);
+    }
+    return latest;
+}
+
+QList<LeanMassDrop> HealthMetricManager::findLeanMassDrops(double minDropKg, const QDate& since, const QSqlDatabase& db)
+{
+    QList<LeanMassDrop> drops;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    // La ventana solo recibe las mediciones desde 'since' y, de cada paciente con alguna, la anterior
+    // a esa fecha, que es la única que hace falta para comparar la primera del periodo. Todo sale del
+    // índice (user_id, date, created_at, lean_mass_kg) sin leer las filas de la tabla; las filas sin
+    // % de grasa no tienen masa magra y se descartan antes.
+    query.prepare("SELECT user_id, metric_id, date, previous_lean_mass_kg, lean_mass_kg FROM ("
+                  "SELECT user_id, metric_id, date, lean_mass_kg, "
+                  "LAG(lean_mass_kg) OVER (PARTITION BY user_id ORDER BY date, created_at) AS previous_lean_mass_kg "
+                  "FROM ("
+                  "SELECT user_id, metric_id, date, created_at, lean_mass_kg FROM health_metrics "
+                  "WHERE lean_mass_kg IS NOT NULL AND date >= :since1 "
+                  "UNION ALL "
+                  "SELECT m.user_id, m.metric_id, m.date, m.created_at, m.lean_mass_kg FROM ("
+                  "SELECT r.user_id, (SELECT p.metric_id FROM health_metrics p "
+                  "WHERE p.user_id = r.user_id AND p.lean_mass_kg IS NOT NULL AND p.date < :since2 "
+                  "ORDER BY p.date DESC, p.created_at DESC LIMIT 1) AS prior_id "
+                  "FROM (SELECT DISTINCT user_id FROM health_metrics "
+                  "WHERE lean_mass_kg IS NOT NULL AND date >= :since3) AS r"
+                  ") AS priors JOIN health_metrics m ON m.metric_id = priors.prior_id"
+                  ") AS recent) AS changes "
+                  "WHERE previous_lean_mass_kg - lean_mass_kg > :min_drop AND date >= :since4 "
+                  "ORDER BY previous_lean_mass_kg - lean_mass_kg DESC");
+    // Cada marcador una sola vez: el controlador de MariaDB no admite repetir nombres
+    const QString sinceText = since.isValid() ? since.toString(Qt::ISODate) : QString("");
+    query.bindValue(":min_drop", minDropKg);
+    query.bindValue(":since1", sinceText);
+    query.bindValue(":since2", sinceText);
+    query.bindValue(":since3", sinceText);
+    query.bindValue(":since4", sinceText);
+    if (!query.exec()) {
+        qCritical() << "Error al buscar bajadas de masa magra:" << query.lastError().text();
+        return drops;
+    }
+    while (query.next()) {
+        LeanMassDrop drop;
+        drop.userId = query.value(0).toInt();
+        drop.metricId = query.value(1).toInt();
+        drop.date = QDate::fromString(query.value(2).toString(), Qt::ISODate);
+        drop.previousLeanMassKg = query.value(3).toDouble();
+        drop.leanMassKg = query.value(4).toDouble();
+        drops.append(drop);
+    }
+    return drops;
+}
+
+QString HealthMetricManager::metricColumns()
+{
+    return "metric_id, user_id, date, weight, height, bmi, body_fat_percentage, muscle_mass_percentage, notes, created_at, "
+           "fat_mass_kg, lean_mass_kg, ffmi, bmi_category";
+}
+
+void HealthMetricManager::readDerivedColumns(const QSqlQuery& query, HealthMetric& metric)
+{
+    const QVariant category = query.value("bmi_category");
+    metric.setDerivedComposition(query.value("fat_mass_kg").toDouble(),
+                                 query.value("lean_mass_kg").toDouble(),
+                                 query.value("ffmi").toDouble(),
+                                 category.isNull() ? -1 : category.toInt());
+}
+
+// Búsqueda de texto completo en las notas.
+// SQLite usa la tabla FTS5 'health_metrics_fts' (ordenada por bm25) y MariaDB el índice FULLTEXT.
+QList<NoteSearchResult> HealthMetricManager::searchNotes(const QString& text, int limit, const QSqlDatabase& db)
+{
+    QList<NoteSearchResult> results;
+    const QStringList words = TextNormalizer::words(TextNormalizer::fold(text));
+    if (words.isEmpty() || limit <= 0) {
+        return results;
+    }
+
+    QSqlQuery query(db);
+    const QString driver = db.driverName();
+
+    if (driver == "QMYSQL") {
+        // Modo booleano: todas las palabras obligatorias y como prefijo (+palabra*)
+        QStringList terms;
+        for (const QString& word : words) {
+            terms << QString("+%1*").arg(word);
+        }
+        query.prepare(QString("SELECT user_id, metric_id, date, notes, "
+                              "MATCH (notes) AGAINST (:terms IN BOOLEAN MODE) AS score "
+                              "FROM health_metrics WHERE MATCH (notes) AGAINST (:terms2 IN BOOLEAN MODE) "
+                              "ORDER BY score DESC LIMIT %1").arg(limit));
+        query.bindValue(":terms", terms.join(' '));
+        query.bindValue(":terms2", terms.join(' '));
+
+        if (!query.exec()) {
+            qWarning() << "Búsqueda FULLTEXT no disponible, se usa LIKE:" << query.lastError().text();
+            return searchNotesWithLike(words, limit, db);
+        }
+        while (query.next()) {
+            NoteSearchResult result;
+            result.userId = query.value("user_id").toInt();
+            result.metricId = query.value("metric_id").toInt();
+            result.date = QDate::fromString(query.value("date").toString(), Qt::ISODate);
+            result.snippet = makeSnippet(query.value("notes").toString(), words);
+            result.score = query.value("score").toDouble();
+            results.append(result);
+        }
+        qInfo() << "Búsqueda de notas" << words << ":" << results.count() << "resultados.";
+        return results;
+    }
+
+    // FTS5: cada palabra como frase entre comillas con '*' para buscar por prefijo.
+    // Las comillas internas se duplican para que la entrada del usuario no altere la sintaxis MATCH.
+    QStringList phrases;
+    for (QString word : words) {
+        word.replace('"', "\"\"");
+        phrases << QString("\"%1\"*").arg(word);
+    }
+
+    query.prepare("SELECT m.user_id, m.metric_id, m.date, "
+                  "snippet(health_metrics_fts, 0, '[', ']', '…', 12) AS snippet, "
+                  "bm25(health_metrics_fts) AS rank "
+                  "FROM health_metrics_fts "
+                  "JOIN health_metrics m ON m.metric_id = health_metrics_fts.rowid "
+                  "WHERE health_metrics_fts MATCH :match "
+                  "ORDER BY rank LIMIT :limit");
+    query.bindValue(":match", phrases.join(' '));
+    query.bindValue(":limit", limit);
+
+    if (!query.exec()) {
+        qWarning() << "Búsqueda FTS5 no disponible, se usa LIKE:" << query.lastError().text();
+        return searchNotesWithLike(words, limit, db);
+    }
+
+    while (query.next()) {
+        NoteSearchResult result;
+        result.userId = query.value("user_id").toInt();
+        result.metricId = query.value("metric_id").toInt();
+        result.date = QDate::fromString(query.value("date").toString(), Qt::ISODate);
+        result.snippet = query.value("snippet").toString();
+        result.score = -query.value("rank").toDouble(); // bm25 es negativo: más negativo = más relevante
+        results.append(result);
+    }
+
+    qInfo() << "Búsqueda de notas" << words << ":" << results.count() << "resultados.";
+    return results;
+}
+
+// Recorrido con LIKE; solo se usa si el motor no tiene índice de texto completo.
+// LIKE no ignora acentos, así que el filtro de la consulta es aproximado (ver likePattern)
+// y el definitivo se hace en C++ con el texto normalizado.
+QList<NoteSearchResult> HealthMetricManager::searchNotesWithLike(const QStringList& words, int limit, const QSqlDatabase& db)
+{
+    QList<NoteSearchResult> results;
+    QStringList conditions;
+    for (qsizetype i = 0; i < words.size(); ++i) {
+        conditions << QString("notes LIKE :word%1 ESCAPE '!'").arg(i);
+    }
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT user_id, metric_id, date, notes FROM health_metrics "
+                          "WHERE notes IS NOT NULL AND notes <> '' AND %1 ORDER BY date DESC")
+                      .arg(conditions.join(" AND ")));
+    for (qsizetype i = 0; i < words.size(); ++i) {
+        query.bindValue(QString(":word%1").arg(i), likePattern(words[i]));
+    }
+    if (!query.exec()) {
+        qCritical() << "Error al buscar en las notas:" << query.lastError().text();
+        return results;
+    }
+
+    while (query.next() && results.count() < limit) {
+        const QString notes = query.value("notes").toString();
+        const QString folded = TextNormalizer::fold(notes);
+        bool matchesAll = true;
+        for (const QString& word : words) {
+            if (!folded.contains(word)) {
+                matchesAll = false;
+                break;
+            }
+        }
+        if (!matchesAll) {
+            continue;
+        }
+        NoteSearchResult result;
+        result.userId = query.value("user_id").toInt();
+        result.metricId = query.value("metric_id").toInt();
+        result.date = QDate::fromString(query.value("date").toString(), Qt::ISODate);
+        result.snippet = makeSnippet(notes, words);
+        result.score = 1.0;
+        results.append(result);
+    }
+    return results;
+}
+
+// '%palabra%' para una palabra ya normalizada. Las letras que en el texto original pueden llevar
+// tilde o diéresis (vocales, ñ, ç) y cualquier carácter no ASCII pasan a '_' (un carácter cualquiera),
+// de modo que el filtro nunca descarta una nota que coincide; '!' escapa los comodines literales.
+QString HealthMetricManager::likePattern(const QString& word)
+{
+    static const QString kAccentable = QStringLiteral("aeiouync");
+    QString pattern = QStringLiteral("%");
+    for (const QChar ch : word) {
+        if (ch.unicode() > 0x7f || kAccentable.contains(ch)) {
+            pattern += QLatin1Char('_');
+        } else if (ch == QLatin1Char('%') || ch == QLatin1Char('_') || ch == QLatin1Char('!')) {
+            pattern += QLatin1Char('!') + ch;
+        } else {
+            pattern += ch;
+        }
+    }
+    return pattern + QLatin1Char('%');
+}
+
+QString HealthMetricManager::makeSnippet(const QString& notes, const QStringList& words)
+{
+    const int kContext = 40; // Caracteres a cada lado del término
+    const QString folded = TextNormalizer::fold(notes);
+
+    // fold() puede colapsar espacios, por lo que la posición es aproximada en textos con espacios dobles
+    int position = -1;
+    int length = 0;
+    for (const QString& word : words) {
+        const int found = folded.indexOf(word);
+        if (found >= 0 && (position < 0 || found < position)) {
+            position = found;
+            length = word.size();
+        }
+    }
+    if (position < 0 || position >= notes.size()) {
+        return notes.left(2 * kContext);
+    }
+
+    length = qMin(length, int(notes.size()) - position);
+    const int start = qMax(0, position - kContext);
+    const int end = qMin(int(notes.size()), position + length + kContext);
+    QString snippet = notes.mid(start, position - start)
+                      + "[" + notes.mid(position, length) + "]"
+                      + notes.mid(position + length, end - position - length);
+    if (start > 0) {
+        snippet.prepend(QString::fromUtf8("…"));
+    }
+    if (end < notes.size()) {
+        snippet.append(QString::fromUtf8("…"));
+    }
+    return snippet;
+}
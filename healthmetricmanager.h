@@ -4,10 +4,32 @@
 #include <QObject>
 #include <QList> // Para almacenar listas de objetos HealthMetric
 #include <QSharedPointer> // Para manejar objetos HealthMetric de forma segura
+#include <QHash>
+#include <QSqlDatabase>
 
 // Asegúrate de incluir la definición de HealthMetric
 #include "healtmetric.h"
 
+class QSqlQuery;
+
+// Resultado de la búsqueda de texto en las notas de las métricas
+struct NoteSearchResult {
+    int userId = -1;
+    int metricId = -1;
+    QDate date;
+    QString snippet; // Fragmento de la nota con los términos marcados entre [ ]
+    double score = 0.0; // Relevancia (mayor es mejor)
+};
+
+// Pérdida de masa magra entre dos mediciones consecutivas de un paciente
+struct LeanMassDrop {
+    int userId = -1;
+    int metricId = -1;         // Medición en la que se detecta la bajada
+    QDate date;
+    double previousLeanMassKg = 0.0;
+    double leanMassKg = 0.0;
+};
+
 class HealthMetricManager : public QObject
 {
     Q_OBJECT
@@ -23,6 +45,8 @@ public:
     // Retorna una lista de punteros compartidos a HealthMetric.
     // Usamos QSharedPointer para gestionar la memoria de forma segura.
     QList<QSharedPointer<HealthMetric>> getHealthMetricsByUserId(int userId);
+    // Solo las de [from, to]: recorre el tramo del índice (user_id, date) del periodo, no todo el historial
+    QList<QSharedPointer<HealthMetric>> getHealthMetricsByUserId(int userId, const QDate& from, const QDate& to);
 
     // Actualiza una métrica de salud existente en la base de datos.
     // La métrica debe tener un metric_id válido.
@@ -36,7 +60,42 @@ public:
     // Obtiene una metrica por id
     HealthMetric getHealthMetric (int metricId);
 
+    // Última métrica (por fecha) de un paciente; id() == -1 si no tiene ninguna
+    HealthMetric getLatestHealthMetric(int userId);
+
+    // IMC de la última medición de cada paciente, en una sola pasada por la tabla
+    QHash<int, double> getLatestBmiForAllUsers();
+
+    // Última medición completa de cada paciente, en una sola pasada por la tabla
+    // ('db' para leer desde otro hilo con su conexión)
+    QHash<int, HealthMetric> getLatestHealthMetricForAllUsers(const QSqlDatabase& db = QSqlDatabase::database());
+
+    // Mediciones en las que la masa magra bajó más de minDropKg respecto a la anterior del mismo paciente.
+    // Se resuelve en la base de datos con LAG() sobre la columna generada lean_mass_kg, limitado al periodo.
+    // ('db' para leer desde otro hilo con su conexión)
+    QList<LeanMassDrop> findLeanMassDrops(double minDropKg, const QDate& since = QDate(),
+                                          const QSqlDatabase& db = QSqlDatabase::database());
+
+    // Busca en las notas de todas las métricas de la clínica (sin distinguir acentos ni mayúsculas).
+    // Cada palabra se busca como prefijo y deben aparecer todas. Resultados ordenados por relevancia.
+    // ('db' para buscar desde otro hilo con su conexión)
+    QList<NoteSearchResult> searchNotes(const QString& text, int limit = 100,
+                                        const QSqlDatabase& db = QSqlDatabase::database());
+
 private:
+    // Lista de columnas común a todas las lecturas de métricas completas
+    static QString metricColumns();
+    // Rellena los valores derivados (columnas generadas) de una fila leída con metricColumns()
+    static void readDerivedColumns(const QSqlQuery& query, HealthMetric& metric);
+    // Lee todas las filas de una consulta ya ejecutada con metricColumns()
+    static QList<QSharedPointer<HealthMetric>> readMetrics(QSqlQuery& query);
+    // Alternativa sin índice de texto completo (recorre la tabla con LIKE)
+    QList<NoteSearchResult> searchNotesWithLike(const QStringList& words, int limit, const QSqlDatabase& db);
+    // Patrón LIKE que no descarta coincidencias con tildes (el filtro exacto se hace en C++)
+    static QString likePattern(const QString& word);
+    // Construye un fragmento alrededor de la primera aparición de alguno de los términos
+    static QString makeSnippet(const QString& notes, const QStringList& words);
+
          // No necesitamos una conexión QSqlDatabase aquí directamente,
          // ya que trabajaremos con la conexión predeterminada que DatabaseManager ya abrió.
          // Sin embargo, sí usaremos QSqlQuery.
@@ -23,7 +23,11 @@ public:
         m_bodyFatPercentage(0.0),
         m_muscleMassPercentage(0.0),
         m_notes(""),
-        m_createdAt(QDateTime()) // Fecha/hora invalida por defecto
+        m_createdAt(QDateTime()), // Fecha/hora invalida por defecto
+        m_fatMassKg(0.0),
+        m_leanMassKg(0.0),
+        m_ffmi(0.0),
+        m_bmiCategory(-1)
     {}
     // Constructor para una métrica existente (con ID y created_at)
     HealthMetric(int id, int userId, const QDate& date, double weight, double height,
@@ -31,7 +35,8 @@ public:
                  const QString& notes, const QDateTime& createdAt)
         : m_id(id), m_userId(userId), m_date(date), m_weight(weight), m_height(height),
         m_bmi(bmi), m_bodyFatPercentage(bodyFatPercentage),
-        m_muscleMassPercentage(muscleMassPercentage), m_notes(notes), m_createdAt(createdAt) {}
+        m_muscleMassPercentage(muscleMassPercentage), m_notes(notes), m_createdAt(createdAt),
+        m_fatMassKg(0.0), m_leanMassKg(0.0), m_ffmi(0.0), m_bmiCategory(-1) {}
 
     // Constructor para una nueva métrica (sin ID la DB los generará)
     HealthMetric(int userId, const QDate& date, double weight, double height,
@@ -39,7 +44,8 @@ public:
         : m_id(-1), m_userId(userId), m_date(date), m_weight(weight), m_height(height),
         m_bmi(0.0), // El BMI se calculará en el setter o antes de la DB
         m_bodyFatPercentage(bodyFatPercentage),
-        m_muscleMassPercentage(muscleMassPercentage), m_notes(notes), m_createdAt(time_at) {}
+        m_muscleMassPercentage(muscleMassPercentage), m_notes(notes), m_createdAt(time_at),
+        m_fatMassKg(0.0), m_leanMassKg(0.0), m_ffmi(0.0), m_bmiCategory(-1) {}
 
 
     // Getters
@@ -54,6 +60,30 @@ public:
     QString notes() const { return m_notes; }
     QDateTime createdAt() const { return m_createdAt; }
 
+    // Valores derivados calculados por la base de datos (columnas generadas, esquema v2).
+    // Son de solo lectura: se rellenan al cargar la métrica y valen 0 (-1 la categoría) si no hay datos.
+    double fatMassKg() const { return m_fatMassKg; }
+    double leanMassKg() const { return m_leanMassKg; }
+    double ffmi() const { return m_ffmi; }
+    int bmiCategory() const { return m_bmiCategory; } // 0 bajo peso ... 5 obesidad III
+    void setDerivedComposition(double fatMassKg, double leanMassKg, double ffmi, int bmiCategory) {
+        m_fatMassKg = fatMassKg;
+        m_leanMassKg = leanMassKg;
+        m_ffmi = ffmi;
+        m_bmiCategory = bmiCategory;
+    }
+    static QString bmiCategoryName(int category) {
+        switch (category) {
+        case 0: return "Bajo peso";
+        case 1: return "Normal";
+        case 2: return "Sobrepeso";
+        case 3: return "Obesidad I";
+        case 4: return "Obesidad II";
+        case 5: return "Obesidad III";
+        default: return "Sin datos";
+        }
+    }
+
     // Setters (para permitir modificación si es necesario)
     void setId(int id) { m_id = id; }
     void setUserId(int userId) { m_userId = userId; }
@@ -89,6 +119,10 @@ private:
     double m_muscleMassPercentage;
     QString m_notes;
     QDateTime m_createdAt;
+    double m_fatMassKg;
+    double m_leanMassKg;
+    double m_ffmi;
+    int m_bmiCategory;
 };
 
 #endif // HEALTHMETRIC_H
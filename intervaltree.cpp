@@ -0,0 +1,191 @@
+#include "intervaltree.h"
+#include <algorithm>
+
+IntervalTree::IntervalTree()
+    : m_root(-1)
+    , m_size(0)
+    , m_seed(2463534242u)
+{
+}
+
+int IntervalTree::allocate(const Interval& interval)
+{
+    // xorshift32: prioridades aleatorias reproducibles, sin depender de QRandomGenerator
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+
+    Node node;
+    node.interval = interval;
+    node.maxEnd = interval.end;
+    node.priority = m_seed;
+    if (!m_free.isEmpty()) {
+        const int index = m_free.takeLast();
+        m_nodes[index] = node;
+        return index;
+    }
+    m_nodes.append(node);
+    return int(m_nodes.size()) - 1;
+}
+
+void IntervalTree::update(int node)
+{
+    Node& n = m_nodes[node];
+    n.maxEnd = n.interval.end;
+    if (n.left >= 0) {
+        n.maxEnd = std::max(n.maxEnd, m_nodes[n.left].maxEnd);
+    }
+    if (n.right >= 0) {
+        n.maxEnd = std::max(n.maxEnd, m_nodes[n.right].maxEnd);
+    }
+}
+
+void IntervalTree::split(int node, qint64 start, int id, int& left, int& right)
+{
+    if (node < 0) {
+        left = right = -1;
+        return;
+    }
+    const Interval& interval = m_nodes[node].interval;
+    if (interval.start < start || (interval.start == start && interval.id < id)) {
+        int rightOfChild = -1;
+        split(m_nodes[node].right, start, id, rightOfChild, right);
+        m_nodes[node].right = rightOfChild;
+        left = node;
+    } else {
+        int leftOfChild = -1;
+        split(m_nodes[node].left, start, id, left, leftOfChild);
+        m_nodes[node].left = leftOfChild;
+        right = node;
+    }
+    update(node);
+}
+
+int IntervalTree::merge(int left, int right)
+{
+    if (left < 0) {
+        return right;
+    }
+    if (right < 0) {
+        return left;
+    }
+    if (m_nodes[left].priority > m_nodes[right].priority) {
+        m_nodes[left].right = merge(m_nodes[left].right, right);
+        update(left);
+        return left;
+    }
+    m_nodes[right].left = merge(left, m_nodes[right].left);
+    update(right);
+    return right;
+}
+
+void IntervalTree::insert(qint64 start, qint64 end, int id)
+{
+    Interval interval;
+    interval.start = start;
+    interval.end = end;
+    interval.id = id;
+    const int node = allocate(interval);
+    int left = -1;
+    int right = -1;
+    split(m_root, start, id, left, right);
+    m_root = merge(merge(left, node), right);
+    ++m_size;
+}
+
+bool IntervalTree::remove(qint64 start, int id)
+{
+    int left = -1;
+    int rest = -1;
+    split(m_root, start, id, left, rest);
+    int middle = -1;
+    int right = -1;
+    split(rest, start, id + 1, middle, right);
+    if (middle < 0) {
+        m_root = merge(left, right);
+        return false;
+    }
+    // (start, id) es único, así que 'middle' es un solo nodo
+    m_free.append(middle);
+    m_root = merge(left, right);
+    --m_size;
+    return true;
+}
+
+void IntervalTree::clear()
+{
+    m_nodes.clear();
+    m_free.clear();
+    m_root = -1;
+    m_size = 0;
+}
+
+template <typename Visitor>
+bool IntervalTree::visit(int node, qint64 start, qint64 end, Visitor& visitor) const
+{
+    if (node < 0) {
+        return true;
+    }
+    const Node& n = m_nodes[node];
+    if (n.maxEnd <= start) {
+        return true; // Todo el subárbol termina antes de la consulta
+    }
+    if (!visit(n.left, start, end, visitor)) {
+        return false;
+    }
+    if (n.interval.start >= end) {
+        return true; // Este nodo y su subárbol derecho empiezan después de la consulta
+    }
+    if (n.interval.end > start && !visitor(n.interval)) {
+        return false;
+    }
+    return visit(n.right, start, end, visitor);
+}
+
+bool IntervalTree::overlaps(qint64 start, qint64 end, int ignoreId) const
+{
+    bool found = false;
+    auto visitor = [&found, ignoreId](const Interval& interval) {
+        found = interval.id != ignoreId;
+        return !found;
+    };
+    visit(m_root, start, end, visitor);
+    return found;
+}
+
+QVector<IntervalTree::Interval> IntervalTree::overlapping(qint64 start, qint64 end) const
+{
+    QVector<Interval> result;
+    auto visitor = [&result](const Interval& interval) {
+        result.append(interval);
+        return true;
+    };
+    visit(m_root, start, end, visitor);
+    return result;
+}
+
+qint64 IntervalTree::firstGap(qint64 from, qint64 to, qint64 length, int ignoreId) const
+{
+    if (length <= 0 || from + length > to) {
+        return -1;
+    }
+    // Los solapados llegan ordenados por inicio: el cursor avanza hasta el final de cada uno
+    qint64 cursor = from;
+    bool found = false;
+    auto visitor = [&](const Interval& interval) {
+        if (interval.id == ignoreId) {
+            return true;
+        }
+        if (interval.start - cursor >= length) {
+            found = true;
+            return false;
+        }
+        cursor = std::max(cursor, interval.end);
+        return cursor + length <= to;
+    };
+    visit(m_root, from, to, visitor);
+    if (found || cursor + length <= to) {
+        return cursor;
+    }
+    return -1;
+}
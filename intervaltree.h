@@ -0,0 +1,66 @@
+#ifndef INTERVALTREE_H
+#define INTERVALTREE_H
+
+#include <QVector>
+#include <QtGlobal>
+
+// Árbol de intervalos semiabiertos [start, end) con un identificador cada uno.
+// Es un treap (árbol binario de búsqueda ordenado por (start, id) y equilibrado con prioridades
+// aleatorias) en el que cada nodo guarda además el mayor 'end' de su subárbol. Con eso:
+//  - insertar y borrar cuestan O(log n) de media;
+//  - saber si algo se solapa con un intervalo cuesta O(log n);
+//  - listar los k solapados o buscar el primer hueco libre cuesta O(log n + k).
+// Los nodos viven en un vector con lista de huecos libres (sin una reserva de memoria por nodo).
+class IntervalTree
+{
+public:
+    struct Interval {
+        qint64 start = 0;
+        qint64 end = 0;
+        int id = -1;
+    };
+
+    IntervalTree();
+
+    void insert(qint64 start, qint64 end, int id);
+    // El intervalo se identifica por su inicio y su id
+    bool remove(qint64 start, int id);
+    void clear();
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+    // ¿Algún intervalo (distinto de ignoreId) se solapa con [start, end)?
+    bool overlaps(qint64 start, qint64 end, int ignoreId = -1) const;
+    // Intervalos que se solapan con [start, end), ordenados por inicio
+    QVector<Interval> overlapping(qint64 start, qint64 end) const;
+    // Primer instante t en [from, to - length] tal que [t, t + length) no se solapa con nada
+    // (salvo ignoreId); -1 si no hay hueco
+    qint64 firstGap(qint64 from, qint64 to, qint64 length, int ignoreId = -1) const;
+
+private:
+    struct Node {
+        Interval interval;
+        qint64 maxEnd = 0;
+        quint32 priority = 0;
+        int left = -1;
+        int right = -1;
+    };
+
+    int allocate(const Interval& interval);
+    void update(int node);
+    // Divide el subárbol en (< (start, id)) y (>= (start, id))
+    void split(int node, qint64 start, int id, int& left, int& right);
+    int merge(int left, int right);
+
+    // Recorre en orden los intervalos que se solapan con [start, end) mientras visit devuelva true
+    template <typename Visitor>
+    bool visit(int node, qint64 start, qint64 end, Visitor& visitor) const;
+
+    QVector<Node> m_nodes;
+    QVector<int> m_free;
+    int m_root;
+    int m_size;
+    quint32 m_seed;
+};
+
+#endif // INTERVALTREE_H
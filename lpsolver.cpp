@@ -0,0 +1,355 @@
+#include "lpsolver.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace {
+
+const double kEpsilon = 1e-9;
+const double kFeasibilityTolerance = 1e-7;
+const double kIntegerTolerance = 1e-6;
+// Se poda lo que no puede mejorar la mejor entera en más de un 1 %: para los modelos de dieta
+// esa diferencia no se nota y evita recorrer árboles enteros de empates
+const double kRelativeGap = 1e-2;
+const int kRoundingInterval = 16; // Nodos entre intentos de la heurística de redondeo
+const int kMaxPivots = 50000;
+
+// Tabla del simplex: m filas de restricciones + fila de costes reducidos; la última columna es el lado derecho
+struct Tableau {
+    int rows = 0;
+    int columns = 0;
+    std::vector<double> cells;
+
+    Tableau(int m, int n)
+        : rows(m)
+        , columns(n)
+        , cells(std::size_t(m + 1) * std::size_t(n + 1), 0.0)
+    {
+    }
+
+    double& at(int i, int j) { return cells[std::size_t(i) * std::size_t(columns + 1) + std::size_t(j)]; }
+    double& rhs(int i) { return at(i, columns); }
+};
+
+void pivot(Tableau& t, int row, int column)
+{
+    const double p = t.at(row, column);
+    for (int j = 0; j <= t.columns; ++j) {
+        t.at(row, j) /= p;
+    }
+    for (int i = 0; i <= t.rows; ++i) {
+        if (i == row) {
+            continue;
+        }
+        const double factor = t.at(i, column);
+        if (std::fabs(factor) <= kEpsilon) {
+            continue;
+        }
+        for (int j = 0; j <= t.columns; ++j) {
+            t.at(i, j) -= factor * t.at(row, j);
+        }
+    }
+}
+
+// Itera hasta que ningún coste reducido permitido sea negativo (minimización).
+// Regla de Bland: entra la primera columna que mejora y sale la fila de menor índice básico en empate.
+LpSolver::Status iterate(Tableau& t, std::vector<int>& basis, const std::vector<bool>& allowed)
+{
+    for (int iteration = 0; iteration < kMaxPivots; ++iteration) {
+        int entering = -1;
+        for (int j = 0; j < t.columns; ++j) {
+            if (allowed[std::size_t(j)] && t.at(t.rows, j) < -kEpsilon) {
+                entering = j;
+                break;
+            }
+        }
+        if (entering < 0) {
+            return LpSolver::Optimal;
+        }
+
+        int leaving = -1;
+        double bestRatio = 0.0;
+        for (int i = 0; i < t.rows; ++i) {
+            const double coefficient = t.at(i, entering);
+            if (coefficient <= kEpsilon) {
+                continue;
+            }
+            const double ratio = t.rhs(i) / coefficient;
+            if (leaving < 0 || ratio < bestRatio - kEpsilon
+                || (std::fabs(ratio - bestRatio) <= kEpsilon && basis[std::size_t(i)] < basis[std::size_t(leaving)])) {
+                leaving = i;
+                bestRatio = ratio;
+            }
+        }
+        if (leaving < 0) {
+            return LpSolver::Unbounded;
+        }
+        pivot(t, leaving, entering);
+        basis[std::size_t(leaving)] = entering;
+    }
+    return LpSolver::IterationLimit;
+}
+
+} // namespace
+
+int LpSolver::Problem::addVariable(double costCoefficient, double upperBound, bool isInteger)
+{
+    cost.append(costCoefficient);
+    upper.append(upperBound);
+    integer.append(isInteger);
+    return int(cost.size()) - 1;
+}
+
+void LpSolver::Problem::addRow(const QVector<QPair<int, double>>& terms, Sense sense, double rhs)
+{
+    Row row;
+    row.terms = terms;
+    row.sense = sense;
+    row.rhs = rhs;
+    rows.append(row);
+}
+
+LpSolver::Result LpSolver::solveLp(const Problem& problem)
+{
+    Result result;
+    const int n = problem.variableCount();
+
+    // Filas en forma densa con lado derecho no negativo; las cotas superiores son filas más
+    struct DenseRow {
+        std::vector<double> a;
+        Sense sense;
+        double rhs;
+    };
+    std::vector<DenseRow> rows;
+    rows.reserve(std::size_t(problem.rows.size() + n));
+    for (const Row& row : problem.rows) {
+        DenseRow dense{ std::vector<double>(std::size_t(n), 0.0), row.sense, row.rhs };
+        for (const auto& term : row.terms) {
+            dense.a[std::size_t(term.first)] += term.second;
+        }
+        rows.push_back(std::move(dense));
+    }
+    for (int j = 0; j < n; ++j) {
+        if (problem.upper[j] > 0.0) {
+            DenseRow bound{ std::vector<double>(std::size_t(n), 0.0), LessEqual, problem.upper[j] };
+            bound.a[std::size_t(j)] = 1.0;
+            rows.push_back(std::move(bound));
+        }
+    }
+    int slackCount = 0;
+    int artificialCount = 0;
+    for (DenseRow& row : rows) {
+        if (row.rhs < 0.0) {
+            for (double& value : row.a) {
+                value = -value;
+            }
+            row.rhs = -row.rhs;
+            row.sense = row.sense == LessEqual ? GreaterEqual : (row.sense == GreaterEqual ? LessEqual : Equal);
+        }
+        slackCount += row.sense != Equal ? 1 : 0;
+        artificialCount += row.sense != LessEqual ? 1 : 0;
+    }
+
+    // Columnas: originales | holguras | artificiales
+    const int m = int(rows.size());
+    const int columns = n + slackCount + artificialCount;
+    Tableau t(m, columns);
+    std::vector<int> basis(std::size_t(m), -1);
+    std::vector<bool> artificialRow(std::size_t(m), false);
+    int slack = n;
+    int artificial = n + slackCount;
+    for (int i = 0; i < m; ++i) {
+        const DenseRow& row = rows[std::size_t(i)];
+        for (int j = 0; j < n; ++j) {
+            t.at(i, j) = row.a[std::size_t(j)];
+        }
+        t.rhs(i) = row.rhs;
+        if (row.sense == LessEqual) {
+            t.at(i, slack) = 1.0;
+            basis[std::size_t(i)] = slack++;
+        } else {
+            if (row.sense == GreaterEqual) {
+                t.at(i, slack++) = -1.0;
+            }
+            t.at(i, artificial) = 1.0;
+            basis[std::size_t(i)] = artificial++;
+            artificialRow[std::size_t(i)] = true;
+        }
+    }
+
+    // Fase 1: minimizar la suma de artificiales
+    std::vector<bool> allowed(std::size_t(columns), true);
+    if (artificialCount > 0) {
+        double rhsSum = 0.0;
+        for (int i = 0; i < m; ++i) {
+            if (!artificialRow[std::size_t(i)]) {
+                continue;
+            }
+            for (int j = 0; j < n + slackCount; ++j) {
+                t.at(m, j) -= t.at(i, j);
+            }
+            t.rhs(m) -= t.rhs(i);
+            rhsSum += t.rhs(i);
+        }
+        const Status phase1 = iterate(t, basis, allowed);
+        if (phase1 == IterationLimit) {
+            result.status = IterationLimit;
+            return result;
+        }
+        if (-t.rhs(m) > kFeasibilityTolerance * std::max(1.0, rhsSum)) {
+            result.status = Infeasible;
+            return result;
+        }
+        // Las artificiales que siguen en la base (a 0) se cambian por cualquier columna real;
+        // si la fila no tiene ninguna es redundante y la artificial se queda fija en 0
+        for (int i = 0; i < m; ++i) {
+            if (basis[std::size_t(i)] < n + slackCount) {
+                continue;
+            }
+            for (int j = 0; j < n + slackCount; ++j) {
+                if (std::fabs(t.at(i, j)) > kEpsilon) {
+                    pivot(t, i, j);
+                    basis[std::size_t(i)] = j;
+                    break;
+                }
+            }
+        }
+        for (int j = n + slackCount; j < columns; ++j) {
+            allowed[std::size_t(j)] = false;
+        }
+    }
+
+    // Fase 2: costes reales expresados en la base actual
+    for (int j = 0; j <= columns; ++j) {
+        t.at(m, j) = j < n ? problem.cost[j] : 0.0;
+    }
+    for (int i = 0; i < m; ++i) {
+        const int b = basis[std::size_t(i)];
+        const double cb = b < n ? problem.cost[b] : 0.0;
+        if (cb == 0.0) {
+            continue;
+        }
+        for (int j = 0; j <= columns; ++j) {
+            t.at(m, j) -= cb * t.at(i, j);
+        }
+    }
+    const Status phase2 = iterate(t, basis, allowed);
+    if (phase2 != Optimal) {
+        result.status = phase2;
+        return result;
+    }
+
+    result.status = Optimal;
+    result.x = QVector<double>(n, 0.0);
+    for (int i = 0; i < m; ++i) {
+        const int b = basis[std::size_t(i)];
+        if (b < n) {
+            result.x[b] = std::max(0.0, t.rhs(i));
+        }
+    }
+    for (int j = 0; j < n; ++j) {
+        result.objective += problem.cost[j] * result.x[j];
+    }
+    return result;
+}
+
+LpSolver::Result LpSolver::solve(const Problem& problem, int maxNodes)
+{
+    Result best;
+    best.status = Infeasible;
+    double bestObjective = std::numeric_limits<double>::infinity();
+
+    // Cada nodo es la lista de cotas añadidas por las ramificaciones desde la raíz
+    std::vector<QVector<Row>> stack;
+    stack.emplace_back();
+    int nodes = 0;
+    while (!stack.empty() && nodes < maxNodes) {
+        const QVector<Row> bounds = std::move(stack.back());
+        stack.pop_back();
+        ++nodes;
+
+        Problem node = problem;
+        node.rows += bounds;
+        const Result relaxed = solveLp(node);
+        if (relaxed.status == Unbounded && nodes == 1) {
+            best.status = Unbounded;
+            best.nodes = nodes;
+            return best;
+        }
+        if (relaxed.status != Optimal || relaxed.objective >= bestObjective - kEpsilon - kRelativeGap * std::fabs(bestObjective)) {
+            continue; // Inviable o no puede mejorar la mejor entera
+        }
+
+        // Heurística de redondeo: enteras fijadas al valor más cercano y el resto libre. En los modelos
+        // con variables de holgura elásticas casi siempre es factible y da pronto una buena cota.
+        if (nodes % kRoundingInterval == 1) {
+            Problem rounded = node;
+            for (int j = 0; j < problem.variableCount(); ++j) {
+                if (problem.integer[j]) {
+                    rounded.addRow({ qMakePair(j, 1.0) }, Equal, std::round(relaxed.x[j]));
+                }
+            }
+            Result candidate = solveLp(rounded);
+            if (candidate.status == Optimal && candidate.objective < bestObjective - kEpsilon) {
+                for (int j = 0; j < problem.variableCount(); ++j) {
+                    if (problem.integer[j]) {
+                        candidate.x[j] = std::round(candidate.x[j]);
+                    }
+                }
+                best = candidate;
+                bestObjective = candidate.objective;
+            }
+        }
+
+        // Variable entera más fraccionaria
+        int branch = -1;
+        double branchDistance = kIntegerTolerance;
+        for (int j = 0; j < problem.variableCount(); ++j) {
+            if (!problem.integer[j]) {
+                continue;
+            }
+            const double fraction = relaxed.x[j] - std::floor(relaxed.x[j]);
+            const double distance = std::min(fraction, 1.0 - fraction);
+            if (distance > branchDistance) {
+                branch = j;
+                branchDistance = distance;
+            }
+        }
+        if (branch < 0) {
+            best = relaxed;
+            bestObjective = relaxed.objective;
+            for (int j = 0; j < problem.variableCount(); ++j) {
+                if (problem.integer[j]) {
+                    best.x[j] = std::round(best.x[j]);
+                }
+            }
+            continue;
+        }
+
+        const double value = relaxed.x[branch];
+        Row down;
+        down.terms = { qMakePair(branch, 1.0) };
+        down.sense = LessEqual;
+        down.rhs = std::floor(value);
+        Row up;
+        up.terms = { qMakePair(branch, 1.0) };
+        up.sense = GreaterEqual;
+        up.rhs = std::ceil(value);
+        // Se explora primero el redondeo más cercano (se apila el último)
+        const bool upFirst = value - std::floor(value) > 0.5;
+        QVector<Row> first = bounds;
+        QVector<Row> second = bounds;
+        first.append(upFirst ? down : up);
+        second.append(upFirst ? up : down);
+        stack.push_back(std::move(first));
+        stack.push_back(std::move(second));
+    }
+
+    best.nodes = nodes;
+    if (std::isfinite(bestObjective)) {
+        best.status = stack.empty() ? Optimal : Feasible;
+    } else if (!stack.empty()) {
+        best.status = IterationLimit;
+    }
+    return best;
+}
@@ -0,0 +1,63 @@
+#ifndef LPSOLVER_H
+#define LPSOLVER_H
+
+#include <QPair>
+#include <QVector>
+
+// Programación lineal entera mixta para modelos pequeños (decenas de filas, cientos de columnas),
+// sin dependencias externas:
+//  - simplex primal en dos fases sobre tabla densa, con la regla de Bland para no ciclar;
+//  - ramificación y acotación en profundidad para las variables enteras, podando con la mejor
+//    solución encontrada (con un margen del 1 %) y con un límite de nodos; cada cierto número de
+//    nodos se prueba a redondear la relajación para tener pronto una solución entera.
+// Las filas se describen de forma dispersa (solo los coeficientes distintos de 0).
+// No usa Qt más allá de los contenedores, así que se puede llamar desde cualquier hilo.
+class LpSolver
+{
+public:
+    enum Sense {
+        LessEqual,
+        GreaterEqual,
+        Equal
+    };
+
+    struct Row {
+        QVector<QPair<int, double>> terms; // (variable, coeficiente)
+        Sense sense = LessEqual;
+        double rhs = 0.0;
+    };
+
+    // Minimizar cost · x con x >= 0, x <= upper (si upper > 0) y las filas
+    struct Problem {
+        QVector<double> cost;
+        QVector<double> upper;   // <= 0: sin cota superior
+        QVector<bool> integer;
+        QVector<Row> rows;
+
+        int addVariable(double costCoefficient, double upperBound = 0.0, bool isInteger = false);
+        void addRow(const QVector<QPair<int, double>>& terms, Sense sense, double rhs);
+        int variableCount() const { return int(cost.size()); }
+    };
+
+    enum Status {
+        Optimal,
+        Feasible,    // Entera encontrada, pero se agotaron los nodos antes de probar que es la mejor
+        Infeasible,
+        Unbounded,
+        IterationLimit
+    };
+
+    struct Result {
+        Status status = Infeasible;
+        double objective = 0.0;
+        QVector<double> x;
+        int nodes = 0; // Nodos de ramificación explorados
+    };
+
+    // Relajación lineal (ignora 'integer')
+    static Result solveLp(const Problem& problem);
+    // Con variables enteras; maxNodes acota el tiempo en los casos difíciles
+    static Result solve(const Problem& problem, int maxNodes = 2000);
+};
+
+#endif // LPSOLVER_H
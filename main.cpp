@@ -6,6 +6,19 @@
 #include <QDir> // Para manejar directorios
 #include <QMessageBox> // Para mostrar mensajes de error al usuario
 #include <QCoreApplication>
+#include <QTimer>
+#include "usersnapshot.h" // Instantánea de la lista de pacientes para el arranque en caliente
+#include "weightforecaster.h"
+#include "clinicalalertengine.h"
+#include "recipegraph.h"
+#include "mealplanoptimizer.h"
+#include "patientdeduplicator.h"
+#include "appointmentscheduler.h"
+#include "bulkimporter.h"
+#include "datachangehub.h"
+#include "fooddiary.h"
+#include "metricanomalydetector.h"
+#include "metricrollups.h"
 
 int main(int argc, char *argv[])
 {
@@ -29,6 +42,23 @@ int main(int argc, char *argv[])
     }
     // --- Fin de carga de QSS ---
 
+    // --- Arranque en caliente: pintar la lista de pacientes desde la instantánea ---
+    // La instantánea vive junto a nutricion.db y se mapea en memoria, así que la ventana
+    // aparece con la lista antes de abrir la base de datos y crear las tablas.
+    QString appDirPath = QCoreApplication::applicationDirPath();
+    QString dbFilePath = appDirPath+"/nutricion.db";
+    QString snapshotPath = UserSnapshot::pathForDatabase(dbFilePath);
+
+    UserSnapshot snapshot;
+    snapshot.load(snapshotPath);
+
+    // Crea y muestra la ventana principal de tu aplicación
+    MainWindow w;
+    w.showUserSnapshot(snapshot);
+    w.show();
+    QCoreApplication::processEvents(); // Primer pintado antes de tocar la base de datos
+    // --- Fin del arranque en caliente ---
+
     DatabaseManager dbManager;
 
     // --- ELIGE UNA DE LAS SIGUIENTES CONFIGURACIONES DE BASE DE DATOS ---
@@ -37,8 +67,6 @@ int main(int argc, char *argv[])
     // OPCIÓN 1: Configuración para SQLite (base de datos local en un archivo)
     // Es la opción más sencilla y no requiere un servidor de base de datos externo.
 
-    QString appDirPath = QCoreApplication::applicationDirPath();
-    QString dbFilePath = appDirPath+"/nutricion.db";
     qDebug() << "Ruta a la base de datos: " + dbFilePath;
     if (!dbManager.initializeSqliteDatabase(dbFilePath)) {
         // Si hay un error al inicializar, muestra un mensaje crítico y termina la aplicación
@@ -67,10 +95,64 @@ int main(int argc, char *argv[])
     */
     // --------------------------------------------------------------------
 
-    // Crea y muestra la ventana principal de tu aplicación
-    MainWindow w;
-    w.show();
+    // Reconciliar la lista con la base de datos una vez arrancado el bucle de eventos:
+    // si el contador de cambios coincide con el de la instantánea no se consulta nada más.
+    // La comprobación y la posible recarga se leen en segundo plano (MainWindow::reconcileUsers).
+    const qint64 snapshotCounter = snapshot.isValid() ? snapshot.changeCounter() : -1;
+    QTimer::singleShot(0, &w, [&w, snapshotCounter]() {
+        w.reconcileUsers(snapshotCounter);
+    });
+
+    // Previsiones de peso: se crea el gestor (escucha los cambios de métricas) y se incorporan
+    // las mediciones que aún no procesó, sin recorrer historiales completos
+    QTimer::singleShot(0, WeightForecaster::instance(), []() {
+        WeightForecaster::instance()->refreshAll();
+    });
+
+    // Alertas clínicas: las reglas viven junto a nutricion.db; a partir de aquí se evalúan
+    // con cada cambio de métricas y una vez al día para las reglas temporales
+    const QString rulesPath = appDirPath + "/clinical_rules.txt";
+    QTimer::singleShot(0, ClinicalAlertEngine::instance(), [rulesPath]() {
+        ClinicalAlertEngine::instance()->initialize(rulesPath);
+    });
+
+    // Índice de duplicados en memoria: así la comprobación de cada alta no espera a la carga
+    QTimer::singleShot(0, PatientDeduplicator::instance(), []() {
+        PatientDeduplicator::instance()->ensureLoaded();
+    });
+
+    // Recetas y planes: se cargan la primera vez que se consultan; aquí solo se crea el grafo
+    // para que borre los planes de los pacientes que se eliminen
+    RecipeGraph::instance();
+
+    // Diario de alimentación: no tiene estado propio, pero lo del paciente borrado se borra con él
+    QObject::connect(DataChangeHub::instance(), &DataChangeHub::userDeleted, DataChangeHub::instance(), [](int userId) {
+        FoodDiary::removeUserData(userId);
+    });
+    // Resúmenes de peso e IMC: tabla propia sin borrado en cascada
+    QObject::connect(DataChangeHub::instance(), &DataChangeHub::userDeleted, DataChangeHub::instance(), [](int userId) {
+        MetricRollups::removeUserData(userId);
+    });
+
+    // Agenda: se carga al primer uso; se crea ya para enlazar cada medición nueva con su visita
+    AppointmentScheduler::instance();
+
+    // Importación masiva: se crea ya para que al borrar un paciente se borren sus IDs externos.
+    // Las mediciones importadas no pasan por la comprobación de AddMetricDialog: al terminar se
+    // revisan las de esos pacientes y los avisos quedan en la cola de revisión.
+    BulkImporter::instance();
+    QObject::connect(DataChangeHub::instance(), &DataChangeHub::bulkImportCompleted, DataChangeHub::instance(),
+                     [](const QList<int>& userIds) {
+                         MetricAnomalyDetector::sweepUsers(userIds);
+                     });
+
+    // Planes semanales: una vez al día se generan los de la semana siguiente en segundo plano
+    MealPlanOptimizer::instance()->startNightly();
 
     // Inicia el bucle de eventos de la aplicación Qt
-    return a.exec();
+    int result = a.exec();
+
+    // Guarda la lista actual para el próximo arranque
+    UserSnapshot::save(snapshotPath, w.userEntries(), w.usersChangeCounter());
+    return result;
 }
@@ -5,27 +5,122 @@
 #include <QTableWidgetItem> // Para manejar los elementos dentro de QTableWidget
 #include <QHeaderView>      // Para ajustar el tamaño de las columnas de la tabla
 #include <qlistwidget.h>
+#include <algorithm>
+#include <functional>
+#include "datachangehub.h"
+#include "metricanomalydetector.h"
+#include "patientcomparisonwindow.h"
+#include "foodcatalog.h"
+#include "foodcatalogimporter.h"
+#include "recipegraph.h"
+#include "appointmentscheduler.h"
+#include "mealplanoptimizer.h"
+#include "progressreportengine.h"
+#include "dataexporter.h"
+#include "bulkimporter.h"
+#include "cohortanalytics.h"
+#include "databasemanager.h"
+#include <QMenuBar>
+#include <QApplication>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QCheckBox>
+#include <QDateEdit>
+#include <QDateTimeEdit>
+#include <QDoubleSpinBox>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QInputDialog>
+#include <QLabel>
+#include <QLineEdit>
+#include <QLocale>
+#include <QFutureWatcher>
+#include <QProgressDialog>
+#include <QPushButton>
+#include <QSignalBlocker>
+#include <QSpinBox>
+#include <QTabWidget>
+#include <QtConcurrent>
+#include <QVBoxLayout>
+#include <QAtomicInteger>
+#include <QSqlError>
+
+// Milisegundos sin pulsaciones antes de lanzar la búsqueda
+static const int kSearchDebounceMs = 120;
+
+// Resultado de comprobar la instantánea de pacientes en segundo plano
+struct UserReconciliation {
+    qint64 changeCounter = -1;             // -1 si no se pudo leer
+    bool reloaded = false;                 // La instantánea estaba desactualizada: 'users' es la lista actual
+    QList<QSharedPointer<User>> users;
+};
+
+// Las conexiones de los hilos de trabajo necesitan nombres distintos
+static QAtomicInteger<quint64> workerConnectionCounter;
+
+// Llama a work(db) con una conexión propia, clon de la predeterminada, para leer desde un hilo de
+// trabajo (la conexión predeterminada solo se puede usar desde el hilo principal). Si la conexión
+// no se abre devuelve 'failed' sin llamar a 'work'.
+template <typename Result, typename Work>
+static Result withWorkerConnection(const QString& purpose, Work work, Result failed = Result())
+{
+    const QString connectionName = QString("%1_%2").arg(purpose).arg(workerConnectionCounter.fetchAndAddRelaxed(1));
+    Result result = failed;
+    {
+        QSqlDatabase db = QSqlDatabase::cloneDatabase(QString(QSqlDatabase::defaultConnection), connectionName);
+        if (db.open()) {
+            result = work(db);
+        } else {
+            qWarning() << "No se pudo abrir la conexión" << connectionName << ":" << db.lastError().text();
+        }
+        db.close();
+    }
+    // Fuera del bloque: no queda ninguna QSqlDatabase ni QSqlQuery que use la conexión
+    QSqlDatabase::removeDatabase(connectionName);
+    return result;
+}
 
 // Constructor de la ventana principal
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow) // Inicializa la interfaz de usuario
+    , m_userTableModel(nullptr)
+    , m_userColumnsSized(false)
+    , m_usersChangeCounter(-1)
 {
     ui->setupUi(this); // Configura todos los widgets definidos en mainwindow.ui
 
     // Inicializa nuestro gestor de usuarios.
     // 'this' es el padre, lo que asegura que userManager se destruya cuando MainWindow se destruya.
     userManager = new UserManager(this);
-    connect(ui->lineEdit_searchUser, &QLineEdit::textChanged,
-            this, &MainWindow::on_lineEdit_searchUser_textChanged);
+    // on_lineEdit_searchUser_textChanged ya se conecta automáticamente por nombre (setupUi),
+    // así que no se conecta de nuevo aquí.
+
+    // Búsqueda con retardo: cada pulsación reinicia el temporizador y cancela la búsqueda pendiente
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(kSearchDebounceMs);
+    connect(m_searchTimer, &QTimer::timeout, this, &MainWindow::applySearchFilter);
+
+    // Altas, cambios y bajas de usuarios actualizan la lista sin volver a consultar todo
+    connect(DataChangeHub::instance(), &DataChangeHub::userAdded, this, &MainWindow::onUserAdded);
+    connect(DataChangeHub::instance(), &DataChangeHub::userUpdated, this, &MainWindow::onUserUpdated);
+    connect(DataChangeHub::instance(), &DataChangeHub::userDeleted, this, &MainWindow::onUserDeleted);
+    // Las métricas cambian la franja de IMC del paciente en el índice de facetas
+    connect(DataChangeHub::instance(), &DataChangeHub::healthMetricAdded, this, &MainWindow::onHealthMetricChanged);
+    connect(DataChangeHub::instance(), &DataChangeHub::healthMetricUpdated, this, &MainWindow::onHealthMetricChanged);
+    connect(DataChangeHub::instance(), &DataChangeHub::bulkImportCompleted, this, &MainWindow::onBulkImportCompleted);
+    connect(DataChangeHub::instance(), &DataChangeHub::healthMetricDeleted, this, &MainWindow::onHealthMetricChanged);
     // Configura los datos de los ComboBox (Género, Nivel de Actividad, Objetivo)
     setupComboBoxes();
-
-    // Carga inicialmente todos los usuarios de la base de datos en la QTableWidget
-    loadUsersIntoTable("");
+    setupFacetFilters();
+    setupMenus();
 
     setupUsertable();
-    loadUsers();
+    // La carga de usuarios ya no se hace aquí: main.cpp pinta primero la instantánea
+    // y después llama a reconcileUsers() cuando la base de datos está abierta.
 }
 
 // Destructor de la ventana principal
@@ -59,55 +154,1760 @@ void MainWindow::setupComboBoxes() {
     ui->dateEdit_birthDate->setDate(QDate(2000, 1, 1));
 }
 
-void MainWindow::setupUsertable()
+// Menú de herramientas
+void MainWindow::setupMenus()
 {
-    ui->tableWidget_users->setColumnCount(4); // ID, Nombre, Apellido1, Apellido2 (o más, según lo que quieras mostrar)
-    ui->tableWidget_users->setHorizontalHeaderLabels({"ID", "Nombre", "Apellido 1", "Apellido 2"});
-    ui->tableWidget_users->horizontalHeader()->setStretchLastSection(true); // Estirar la última columna
-    ui->tableWidget_users->setEditTriggers(QAbstractItemView::NoEditTriggers); // No editable directamente
-    ui->tableWidget_users->setSelectionBehavior(QAbstractItemView::SelectRows); // Seleccionar filas completas
-    ui->tableWidget_users->setSelectionMode(QAbstractItemView::SingleSelection); // Solo una fila a la vez
+    QMenu *toolsMenu = ui->menubar->addMenu("Herramientas");
+    QAction *reviewAction = toolsMenu->addAction("Revisar mediciones...");
+    connect(reviewAction, &QAction::triggered, this, &MainWindow::reviewAllMetrics);
+    QAction *reviewQueueAction = toolsMenu->addAction("Cola de revisión de mediciones...");
+    connect(reviewQueueAction, &QAction::triggered, this, &MainWindow::showReviewQueue);
+    QAction *compareAction = toolsMenu->addAction("Comparar pacientes seleccionados...");
+    connect(compareAction, &QAction::triggered, this, &MainWindow::compareSelectedPatients);
+    QAction *cohortAction = toolsMenu->addAction("Análisis de cohortes...");
+    connect(cohortAction, &QAction::triggered, this, &MainWindow::showCohortAnalytics);
+    QAction *leanMassAction = toolsMenu->addAction("Bajadas de masa magra...");
+    connect(leanMassAction, &QAction::triggered, this, &MainWindow::showLeanMassDrops);
+    QAction *noteSearchAction = toolsMenu->addAction("Buscar en las notas...");
+    noteSearchAction->setShortcut(QKeySequence("Ctrl+Shift+F"));
+    connect(noteSearchAction, &QAction::triggered, this, &MainWindow::searchNotes);
+    QAction *agendaAction = toolsMenu->addAction("Agenda...");
+    agendaAction->setShortcut(QKeySequence("Ctrl+Shift+A"));
+    connect(agendaAction, &QAction::triggered, this, &MainWindow::showAgenda);
+    toolsMenu->addSeparator();
+    QAction *importCsvAction = toolsMenu->addAction("Importar tabla de alimentos (CSV)...");
+    connect(importCsvAction, &QAction::triggered, this, [this]() { importFoodCatalog(false); });
+    QAction *importUsdaAction = toolsMenu->addAction("Importar USDA FoodData Central...");
+    connect(importUsdaAction, &QAction::triggered, this, [this]() { importFoodCatalog(true); });
+    QAction *duplicatesAction = toolsMenu->addAction("Buscar pacientes duplicados...");
+    connect(duplicatesAction, &QAction::triggered, this, &MainWindow::findDuplicatePatients);
+    QAction *importPatientsAction = toolsMenu->addAction("Importar pacientes y mediciones (CSV)...");
+    connect(importPatientsAction, &QAction::triggered, this, &MainWindow::importPatients);
+    connect(BulkImporter::instance(), &BulkImporter::progress, this,
+            [this](BulkImporter::Kind kind, qint64 bytesDone, qint64 bytesTotal, qint64 imported, qint64 rejected) {
+                ui->statusbar->showMessage(QString("Importando %1: %2 % (%3 filas, %4 rechazadas)...")
+                                               .arg(kind == BulkImporter::Patients ? "pacientes" : "mediciones")
+                                               .arg(bytesTotal > 0 ? 100 * bytesDone / bytesTotal : 100)
+                                               .arg(imported)
+                                               .arg(rejected));
+            });
+    connect(BulkImporter::instance(), &BulkImporter::finished, this, [this](bool completed, qint64 elapsedMs) {
+        BulkImporter *importer = BulkImporter::instance();
+        QStringList lines;
+        for (const BulkImporter::FileResult& result : importer->results()) {
+            QString line = QString("%1: %2 importadas, %3 rechazadas")
+                               .arg(QFileInfo(result.filePath).fileName())
+                               .arg(result.imported)
+                               .arg(result.rejected);
+            if (result.alreadyImported) {
+                line += " (ya estaba importado)";
+            } else if (result.resumed) {
+                line += " (reanudado)";
+            }
+            if (result.rejected > 0) {
+                line += "\n    Rechazos: " + result.rejectsPath;
+            }
+            lines << line;
+        }
+        ui->statusbar->showMessage(QString("Importación %1 (%2 s).")
+                                       .arg(completed ? "terminada" : "interrumpida")
+                                       .arg(elapsedMs / 1000.0, 0, 'f', 1));
+        if (completed) {
+            QMessageBox::information(this, "Importar pacientes", lines.join("\n"));
+        } else {
+            QString message = importer->errorString().isEmpty() ? QString("Importación cancelada.") : importer->errorString();
+            message += "\n\n" + lines.join("\n")
+                       + "\n\nLo guardado se conserva; al importar de nuevo los mismos archivos se continúa donde se quedó.";
+            QMessageBox::warning(this, "Importar pacientes", message);
+        }
+    });
+    toolsMenu->addSeparator();
+    QAction *recipesAction = toolsMenu->addAction("Recetas y planes de dieta...");
+    connect(recipesAction, &QAction::triggered, this, &MainWindow::editRecipes);
+    QAction *mealPlansAction = toolsMenu->addAction("Generar planes de la semana próxima");
+    connect(mealPlansAction, &QAction::triggered, this, &MainWindow::generateMealPlans);
+    connect(MealPlanOptimizer::instance(), &MealPlanOptimizer::weekGenerated, this,
+            [this](const QDate& weekStart, int plans, int skipped, qint64 elapsedMs) {
+                ui->statusbar->showMessage(QString("Planes de la semana del %1: %2 pacientes, %3 sin plan (%4 s).")
+                                               .arg(weekStart.toString("dd/MM/yyyy"))
+                                               .arg(plans)
+                                               .arg(skipped)
+                                               .arg(elapsedMs / 1000.0, 0, 'f', 1));
+            });
+    toolsMenu->addSeparator();
+    QAction *exportAction = toolsMenu->addAction("Exportar datos (CSV, JSON Lines, Arrow)...");
+    connect(exportAction, &QAction::triggered, this, &MainWindow::exportData);
+    QAction *reportsAction = toolsMenu->addAction("Generar informes de progreso del mes...");
+    connect(reportsAction, &QAction::triggered, this, &MainWindow::generateProgressReports);
+    connect(ProgressReportEngine::instance(), &ProgressReportEngine::progress, this, [this](int done, int total) {
+        ui->statusbar->showMessage(QString("Generando informes de progreso: %1 de %2 pacientes...").arg(done).arg(total));
+    });
+    connect(ProgressReportEngine::instance(), &ProgressReportEngine::finished, this,
+            [this](int generated, int skipped, int failed, qint64 elapsedMs) {
+                ui->statusbar->showMessage(QString("Informes de progreso: %1 generados, %2 sin mediciones, %3 con error (%4 s).")
+                                               .arg(generated)
+                                               .arg(skipped)
+                                               .arg(failed)
+                                               .arg(elapsedMs / 1000.0, 0, 'f', 1));
+            });
+}
+
+// Los planes se generan en segundo plano; el resultado aparece en la barra de estado
+// Agenda de la consulta (AppointmentScheduler): vista de día, semana o mes por profesional,
+// reserva de citas para el paciente seleccionado y cambios de hora o de estado
+void MainWindow::showAgenda()
+{
+    AppointmentScheduler *scheduler = AppointmentScheduler::instance();
+    if (!scheduler->ensureLoaded()) {
+        QMessageBox::warning(this, "Agenda", "No se pudo cargar la agenda.");
+        return;
+    }
+    QHash<int, QString> names;
+    for (const UserSnapshot::Entry& entry : std::as_const(m_userEntries)) {
+        names.insert(entry.id, QString("%1 %2 %3").arg(entry.firstName, entry.lastName1, entry.lastName2).simplified());
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Agenda");
+    dialog.resize(1000, 600);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    QHBoxLayout *controls = new QHBoxLayout;
+    QComboBox *viewCombo = new QComboBox(&dialog);
+    viewCombo->addItem("Día", AppointmentScheduler::DayView);
+    viewCombo->addItem("Semana", AppointmentScheduler::WeekView);
+    viewCombo->addItem("Mes", AppointmentScheduler::MonthView);
+    viewCombo->setCurrentIndex(1);
+    QPushButton *previousButton = new QPushButton("<", &dialog);
+    QDateEdit *dateEdit = new QDateEdit(QDate::currentDate(), &dialog);
+    dateEdit->setCalendarPopup(true);
+    dateEdit->setDisplayFormat("dd/MM/yyyy");
+    QPushButton *nextButton = new QPushButton(">", &dialog);
+    QPushButton *todayButton = new QPushButton("Hoy", &dialog);
+    QComboBox *practitionerCombo = new QComboBox(&dialog);
+    controls->addWidget(viewCombo);
+    controls->addWidget(previousButton);
+    controls->addWidget(dateEdit);
+    controls->addWidget(nextButton);
+    controls->addWidget(todayButton);
+    controls->addStretch();
+    controls->addWidget(new QLabel("Profesional:", &dialog));
+    controls->addWidget(practitionerCombo);
+    layout->addLayout(controls);
+
+    QTableWidget *table = new QTableWidget(0, 7, &dialog);
+    table->setHorizontalHeaderLabels({ "Fecha", "Hora", "Paciente", "Profesional", "Sala", "Estado", "Notas" });
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setSelectionMode(QAbstractItemView::SingleSelection);
+    table->verticalHeader()->setVisible(false);
+    table->horizontalHeader()->setStretchLastSection(true);
+    layout->addWidget(table);
+
+    QHBoxLayout *actions = new QHBoxLayout;
+    QPushButton *bookButton = new QPushButton("Nueva cita...", &dialog);
+    QPushButton *editButton = new QPushButton("Cambiar...", &dialog);
+    QPushButton *completedButton = new QPushButton("Realizada", &dialog);
+    QPushButton *noShowButton = new QPushButton("No presentado", &dialog);
+    QPushButton *cancelButton = new QPushButton("Cancelar cita", &dialog);
+    actions->addWidget(bookButton);
+    actions->addWidget(editButton);
+    actions->addStretch();
+    actions->addWidget(completedButton);
+    actions->addWidget(noShowButton);
+    actions->addWidget(cancelButton);
+    layout->addLayout(actions);
+    QLabel *statusLabel = new QLabel(&dialog);
+    layout->addWidget(statusLabel);
+
+    auto fillPractitioners = [scheduler, practitionerCombo]() {
+        const QString current = practitionerCombo->currentData().toString();
+        const QSignalBlocker blocker(practitionerCombo);
+        practitionerCombo->clear();
+        practitionerCombo->addItem("Todos", QString());
+        for (const QString& practitioner : scheduler->practitioners()) {
+            practitionerCombo->addItem(practitioner, practitioner);
+        }
+        practitionerCombo->setCurrentIndex(qMax(0, practitionerCombo->findData(current)));
+    };
+    // Cita de la fila seleccionada (appointmentId -1 si no hay)
+    auto selectedAppointment = [scheduler, table]() {
+        const int row = table->currentRow();
+        return row >= 0 ? scheduler->appointment(table->item(row, 0)->data(Qt::UserRole).toInt())
+                        : AppointmentScheduler::Appointment();
+    };
+    auto refresh = [scheduler, viewCombo, dateEdit, practitionerCombo, table, statusLabel, names]() {
+        const auto view = AppointmentScheduler::View(viewCombo->currentData().toInt());
+        const QList<AppointmentScheduler::Appointment> appointments =
+            scheduler->view(view, dateEdit->date(), practitionerCombo->currentData().toString());
+        table->setRowCount(int(appointments.size()));
+        for (int row = 0; row < appointments.size(); ++row) {
+            const AppointmentScheduler::Appointment& appointment = appointments.at(row);
+            QTableWidgetItem *dateItem = new QTableWidgetItem(appointment.start.toString("ddd dd/MM/yyyy"));
+            dateItem->setData(Qt::UserRole, appointment.appointmentId);
+            table->setItem(row, 0, dateItem);
+            table->setItem(row, 1, new QTableWidgetItem(QString("%1 - %2").arg(appointment.start.toString("HH:mm"),
+                                                                               appointment.end.toString("HH:mm"))));
+            table->setItem(row, 2, new QTableWidgetItem(QString("%1 (ID %2)")
+                                                            .arg(names.value(appointment.userId))
+                                                            .arg(appointment.userId)));
+            table->setItem(row, 3, new QTableWidgetItem(appointment.practitioner));
+            table->setItem(row, 4, new QTableWidgetItem(appointment.room));
+            table->setItem(row, 5, new QTableWidgetItem(AppointmentScheduler::statusName(appointment.status)));
+            table->setItem(row, 6, new QTableWidgetItem(appointment.notes));
+        }
+        table->resizeColumnsToContents();
+        statusLabel->setText(appointments.isEmpty() ? QString("Sin citas en este periodo.")
+                                                    : QString("%1 citas.").arg(appointments.size()));
+    };
+    // Avanza o retrocede un periodo de la vista actual
+    auto step = [viewCombo, dateEdit](int direction) {
+        switch (AppointmentScheduler::View(viewCombo->currentData().toInt())) {
+        case AppointmentScheduler::DayView: dateEdit->setDate(dateEdit->date().addDays(direction)); break;
+        case AppointmentScheduler::WeekView: dateEdit->setDate(dateEdit->date().addDays(7 * direction)); break;
+        case AppointmentScheduler::MonthView: dateEdit->setDate(dateEdit->date().addMonths(direction)); break;
+        }
+    };
+
+    // Formulario de reserva o de cambio; guarda al aceptar y solo se cierra si se pudo guardar
+    auto editAppointment = [&dialog, scheduler, names](AppointmentScheduler::Appointment appointment) {
+        const bool existing = appointment.appointmentId > 0;
+        QDialog form(&dialog);
+        form.setWindowTitle(existing ? "Cambiar cita" : "Nueva cita");
+        QFormLayout *formLayout = new QFormLayout(&form);
+        formLayout->addRow("Paciente:", new QLabel(QString("%1 (ID %2)").arg(names.value(appointment.userId))
+                                                       .arg(appointment.userId), &form));
+        QComboBox *practitionerEdit = new QComboBox(&form);
+        practitionerEdit->setEditable(true);
+        practitionerEdit->addItems(scheduler->practitioners());
+        practitionerEdit->setCurrentText(appointment.practitioner);
+        formLayout->addRow("Profesional:", practitionerEdit);
+        QComboBox *roomEdit = new QComboBox(&form);
+        roomEdit->setEditable(true);
+        roomEdit->addItem(QString());
+        roomEdit->addItems(scheduler->rooms());
+        roomEdit->setCurrentText(appointment.room);
+        formLayout->addRow("Sala (opcional):", roomEdit);
+        QHBoxLayout *startLayout = new QHBoxLayout;
+        QDateTimeEdit *startEdit = new QDateTimeEdit(appointment.start, &form);
+        startEdit->setCalendarPopup(true);
+        startEdit->setDisplayFormat("dd/MM/yyyy HH:mm");
+        QPushButton *freeSlotButton = new QPushButton("Primer hueco libre", &form);
+        freeSlotButton->setToolTip("Busca desde la hora indicada, en los 30 días siguientes.");
+        startLayout->addWidget(startEdit, 1);
+        startLayout->addWidget(freeSlotButton);
+        formLayout->addRow("Inicio:", startLayout);
+        QSpinBox *minutesSpin = new QSpinBox(&form);
+        minutesSpin->setRange(5, 480);
+        minutesSpin->setSingleStep(5);
+        minutesSpin->setSuffix(" min");
+        minutesSpin->setValue(int(qMax<qint64>(5, appointment.start.secsTo(appointment.end) / 60)));
+        formLayout->addRow("Duración:", minutesSpin);
+        QLineEdit *notesEdit = new QLineEdit(appointment.notes, &form);
+        formLayout->addRow("Notas:", notesEdit);
+        QDialogButtonBox *formButtons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &form);
+        formLayout->addRow(formButtons);
+
+        connect(freeSlotButton, &QPushButton::clicked, &form, [&form, scheduler, practitionerEdit, roomEdit, startEdit, minutesSpin]() {
+            const QString practitioner = practitionerEdit->currentText().trimmed();
+            if (practitioner.isEmpty()) {
+                QMessageBox::information(&form, "Primer hueco libre", "Indique antes el profesional.");
+                return;
+            }
+            const QDateTime from = startEdit->dateTime();
+            const QDateTime slot = scheduler->nextFreeSlot(practitioner, roomEdit->currentText().trimmed(), from,
+                                                           from.addDays(30), minutesSpin->value());
+            if (!slot.isValid()) {
+                QMessageBox::information(&form, "Primer hueco libre", "No hay huecos libres en los próximos 30 días.");
+                return;
+            }
+            startEdit->setDateTime(slot);
+        });
+        connect(formButtons, &QDialogButtonBox::rejected, &form, &QDialog::reject);
+        connect(formButtons, &QDialogButtonBox::accepted, &form, [&form, &appointment, existing, scheduler, practitionerEdit,
+                                                                  roomEdit, startEdit, minutesSpin, notesEdit]() {
+            appointment.practitioner = practitionerEdit->currentText().trimmed();
+            appointment.room = roomEdit->currentText().trimmed();
+            appointment.start = startEdit->dateTime();
+            appointment.end = appointment.start.addSecs(qint64(minutesSpin->value()) * 60);
+            appointment.notes = notesEdit->text().trimmed();
+            QString error;
+            const bool saved = existing ? scheduler->reschedule(appointment, &error) : scheduler->book(appointment, &error) > 0;
+            if (!saved) {
+                QMessageBox::warning(&form, form.windowTitle(), error.isEmpty() ? QString("No se pudo guardar la cita.") : error);
+                return;
+            }
+            form.accept();
+        });
+        return form.exec() == QDialog::Accepted;
+    };
+
+    connect(viewCombo, &QComboBox::currentIndexChanged, &dialog, refresh);
+    connect(dateEdit, &QDateEdit::dateChanged, &dialog, refresh);
+    connect(practitionerCombo, &QComboBox::currentIndexChanged, &dialog, refresh);
+    connect(previousButton, &QPushButton::clicked, &dialog, [step]() { step(-1); });
+    connect(nextButton, &QPushButton::clicked, &dialog, [step]() { step(1); });
+    connect(todayButton, &QPushButton::clicked, &dialog, [dateEdit]() { dateEdit->setDate(QDate::currentDate()); });
+    connect(bookButton, &QPushButton::clicked, &dialog, [this, &dialog, dateEdit, practitionerCombo, editAppointment,
+                                                         fillPractitioners, refresh]() {
+        const QList<int> userIds = selectedUserIds();
+        if (userIds.size() != 1) {
+            QMessageBox::information(&dialog, "Nueva cita", "Seleccione un único paciente en la lista para darle cita.");
+            return;
+        }
+        AppointmentScheduler::Appointment appointment;
+        appointment.userId = userIds.first();
+        appointment.practitioner = practitionerCombo->currentData().toString();
+        // Primera hora en punto a partir de ahora, o las 9:00 del día mostrado si es otro
+        const QDateTime now = QDateTime::currentDateTime();
+        appointment.start = dateEdit->date() == now.date() ? QDateTime(now.date(), QTime(now.time().hour(), 0)).addSecs(3600)
+                                                           : QDateTime(dateEdit->date(), QTime(9, 0));
+        appointment.end = appointment.start.addSecs(30 * 60);
+        if (editAppointment(appointment)) {
+            fillPractitioners();
+            refresh();
+        }
+    });
+    auto editSelected = [&dialog, selectedAppointment, editAppointment, fillPractitioners, refresh]() {
+        const AppointmentScheduler::Appointment appointment = selectedAppointment();
+        if (appointment.appointmentId < 0) {
+            return;
+        }
+        if (appointment.status != AppointmentScheduler::Scheduled) {
+            QMessageBox::information(&dialog, "Cambiar cita", "Solo se pueden cambiar las citas programadas.");
+            return;
+        }
+        if (editAppointment(appointment)) {
+            fillPractitioners();
+            refresh();
+        }
+    };
+    connect(editButton, &QPushButton::clicked, &dialog, editSelected);
+    connect(table, &QTableWidget::cellDoubleClicked, &dialog, editSelected);
+    auto setSelectedStatus = [&dialog, scheduler, selectedAppointment, refresh](AppointmentScheduler::Status status) {
+        const AppointmentScheduler::Appointment appointment = selectedAppointment();
+        if (appointment.appointmentId < 0) {
+            return;
+        }
+        if (status == AppointmentScheduler::Cancelled
+            && QMessageBox::question(&dialog, "Cancelar cita", "¿Cancelar la cita? El hueco queda libre.") != QMessageBox::Yes) {
+            return;
+        }
+        if (!scheduler->setStatus(appointment.appointmentId, status)) {
+            QMessageBox::warning(&dialog, "Agenda", "No se pudo cambiar el estado de la cita.");
+            return;
+        }
+        refresh();
+    };
+    connect(completedButton, &QPushButton::clicked, &dialog, [setSelectedStatus]() { setSelectedStatus(AppointmentScheduler::Completed); });
+    connect(noShowButton, &QPushButton::clicked, &dialog, [setSelectedStatus]() { setSelectedStatus(AppointmentScheduler::NoShow); });
+    connect(cancelButton, &QPushButton::clicked, &dialog, [setSelectedStatus]() { setSelectedStatus(AppointmentScheduler::Cancelled); });
+
+    fillPractitioners();
+    refresh();
 
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addWidget(buttons);
+    dialog.exec();
 }
 
-void MainWindow::loadUsers()
+// Editor de recetas (alimentos del catálogo y otras recetas) y de los planes de dieta del paciente
+// seleccionado (RecipeGraph). Los totales por nutriente se recalculan al guardar.
+void MainWindow::editRecipes()
 {
-    // Limpia todas las filas existentes en la tabla antes de cargar nuevas.
-    ui->tableWidget_users->setRowCount(0);
+    RecipeGraph *graph = RecipeGraph::instance();
+    FoodCatalog *catalog = FoodCatalog::instance();
+    const QList<int> selected = selectedUserIds();
+    const int planUserId = selected.size() == 1 ? selected.first() : -1;
 
-    // Obtiene la lista completa de usuarios desde el UserManager.
-    QList<QSharedPointer<User>> users = m_userManager.getAllUsers();
+    QDialog dialog(this);
+    dialog.setWindowTitle("Recetas y planes de dieta");
+    dialog.resize(1000, 620);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    QTabWidget *tabs = new QTabWidget(&dialog);
+    layout->addWidget(tabs);
+
+    // Ingredientes: columna 0 con el nombre (Qt::UserRole = código del alimento, Qt::UserRole + 1 = id
+    // de la receta) y columna 1 con los gramos, la única editable
+    auto makeItemsTable = [](QWidget* parent, const QString& firstColumn) {
+        QTableWidget *table = new QTableWidget(0, 2, parent);
+        table->setHorizontalHeaderLabels({ firstColumn, "Gramos" });
+        table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        table->verticalHeader()->setVisible(false);
+        table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+        return table;
+    };
+    auto makeTotalsTable = [](QWidget* parent, const QStringList& headers) {
+        QTableWidget *table = new QTableWidget(0, int(headers.size()), parent);
+        table->setHorizontalHeaderLabels(headers);
+        table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        table->verticalHeader()->setVisible(false);
+        table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+        return table;
+    };
+    auto appendItem = [graph, catalog](QTableWidget* table, const RecipeGraph::Item& item) {
+        QString name;
+        if (item.recipeId > 0) {
+            name = "Receta: " + graph->recipeName(item.recipeId);
+        } else {
+            const int food = catalog->foodIndex(item.foodCode);
+            name = food >= 0 ? catalog->foodName(food) : item.foodCode + " (no está en el catálogo)";
+        }
+        const int row = table->rowCount();
+        table->insertRow(row);
+        QTableWidgetItem *nameItem = new QTableWidgetItem(name);
+        nameItem->setFlags(nameItem->flags() & ~Qt::ItemIsEditable);
+        nameItem->setData(Qt::UserRole, item.foodCode);
+        nameItem->setData(Qt::UserRole + 1, item.recipeId);
+        table->setItem(row, 0, nameItem);
+        table->setItem(row, 1, new QTableWidgetItem(QLocale().toString(item.grams, 'f', 1)));
+    };
+    auto fillItems = [appendItem](QTableWidget* table, const QVector<RecipeGraph::Item>& items) {
+        table->setRowCount(0);
+        for (const RecipeGraph::Item& item : items) {
+            appendItem(table, item);
+        }
+    };
+    auto readItems = [](QTableWidget* table, QVector<RecipeGraph::Item>& items, QString* error) {
+        items.clear();
+        for (int row = 0; row < table->rowCount(); ++row) {
+            bool ok = false;
+            const double grams = QLocale().toDouble(table->item(row, 1)->text().trimmed(), &ok);
+            if (!ok || grams <= 0.0) {
+                *error = QString("Cantidad no válida en \"%1\".").arg(table->item(row, 0)->text());
+                return false;
+            }
+            RecipeGraph::Item item;
+            item.foodCode = table->item(row, 0)->data(Qt::UserRole).toString();
+            item.recipeId = table->item(row, 0)->data(Qt::UserRole + 1).toInt();
+            item.grams = grams;
+            items.append(item);
+        }
+        return true;
+    };
+    // Una fila por nutriente del catálogo (mismo orden que los vectores de RecipeGraph)
+    auto fillTotals = [catalog](QTableWidget* table, const QVector<double>& totals, const QVector<double>& per100g) {
+        table->setRowCount(int(totals.size()));
+        for (int i = 0; i < totals.size(); ++i) {
+            const FoodCatalog::Nutrient nutrient = catalog->nutrient(i);
+            table->setItem(i, 0, new QTableWidgetItem(nutrient.unit.isEmpty()
+                                                          ? nutrient.name
+                                                          : QString("%1 (%2)").arg(nutrient.name, nutrient.unit)));
+            table->setItem(i, 1, new QTableWidgetItem(QLocale().toString(totals.at(i), 'f', 1)));
+            if (i < per100g.size()) {
+                table->setItem(i, 2, new QTableWidgetItem(QLocale().toString(per100g.at(i), 'f', 1)));
+            }
+        }
+    };
+    auto askGrams = [&dialog](double* grams) {
+        bool ok = false;
+        *grams = QInputDialog::getDouble(&dialog, "Cantidad", "Gramos:", 100.0, 0.1, 100000.0, 1, &ok);
+        return ok;
+    };
+    // Receta para añadir como ingrediente (sin 'exclude'); -1 si se cancela.
+    // El id va en el texto para distinguir recetas con el mismo nombre.
+    auto pickRecipe = [&dialog, graph](int exclude) {
+        QStringList names;
+        QList<int> ids;
+        for (int id : graph->recipeIds()) {
+            if (id != exclude) {
+                names << QString("%1 (%2)").arg(graph->recipeName(id)).arg(id);
+                ids << id;
+            }
+        }
+        if (ids.isEmpty()) {
+            QMessageBox::information(&dialog, "Añadir receta", "No hay otras recetas.");
+            return -1;
+        }
+        bool ok = false;
+        const QString choice = QInputDialog::getItem(&dialog, "Añadir receta", "Receta:", names, 0, false, &ok);
+        return ok ? ids.at(names.indexOf(choice)) : -1;
+    };
+    // Alimento del catálogo buscado por nombre; vacío si se cancela
+    auto pickFood = [&dialog, catalog]() {
+        if (catalog->foodCount() == 0) {
+            QMessageBox::information(&dialog, "Añadir alimento",
+                                     "El catálogo de alimentos está vacío: importe antes una tabla de composición.");
+            return QString();
+        }
+        bool ok = false;
+        const QString text = QInputDialog::getText(&dialog, "Añadir alimento", "Buscar en el catálogo:",
+                                                   QLineEdit::Normal, QString(), &ok).trimmed();
+        if (!ok || text.isEmpty()) {
+            return QString();
+        }
+        const QVector<FoodCatalog::Match> matches = catalog->search(text, 50);
+        if (matches.isEmpty()) {
+            QMessageBox::information(&dialog, "Añadir alimento", QString("Ningún alimento coincide con \"%1\".").arg(text));
+            return QString();
+        }
+        QStringList names;
+        for (const FoodCatalog::Match& match : matches) {
+            names << QString("%1 [%2]").arg(catalog->foodName(match.food), catalog->foodCode(match.food));
+        }
+        const QString choice = QInputDialog::getItem(&dialog, "Añadir alimento", "Alimento:", names, 0, false, &ok);
+        return ok ? catalog->foodCode(matches.at(names.indexOf(choice)).food) : QString();
+    };
 
-    // Establece el número de filas de la tabla igual a la cantidad de usuarios recuperados.
-    ui->tableWidget_users->setRowCount(users.count());
+    // --- Recetas ---
+    QWidget *recipeTab = new QWidget(tabs);
+    QHBoxLayout *recipeLayout = new QHBoxLayout(recipeTab);
+    QVBoxLayout *recipeListLayout = new QVBoxLayout;
+    QListWidget *recipeList = new QListWidget(recipeTab);
+    QPushButton *newRecipeButton = new QPushButton("Nueva...", recipeTab);
+    QPushButton *deleteRecipeButton = new QPushButton("Eliminar", recipeTab);
+    QHBoxLayout *recipeListButtons = new QHBoxLayout;
+    recipeListButtons->addWidget(newRecipeButton);
+    recipeListButtons->addWidget(deleteRecipeButton);
+    recipeListLayout->addWidget(recipeList);
+    recipeListLayout->addLayout(recipeListButtons);
+    recipeLayout->addLayout(recipeListLayout, 1);
 
-    // Itera sobre cada usuario en la lista.
-    for (int i = 0; i < users.count(); ++i) {
-        QSharedPointer<User> user = users.at(i);
-        if (user) { // Asegura que el puntero no sea nulo.
-            // Columna 0: ID del usuario
-            QTableWidgetItem *idItem = new QTableWidgetItem(QString::number(user->id()));
-            // Es CRÍTICO guardar el ID del usuario en los datos del ítem (Qt::UserRole).
-            // Esto permite recuperarlo fácilmente cuando se hace clic en la fila.
-            idItem->setData(Qt::UserRole, user->id());
-            ui->tableWidget_users->setItem(i, 0, idItem);
+    QWidget *recipeEditor = new QWidget(recipeTab);
+    QVBoxLayout *recipeEditorLayout = new QVBoxLayout(recipeEditor);
+    recipeEditorLayout->setContentsMargins(0, 0, 0, 0);
+    QFormLayout *recipeForm = new QFormLayout;
+    QDoubleSpinBox *yieldSpin = new QDoubleSpinBox(recipeEditor);
+    yieldSpin->setRange(0.0, 100000.0);
+    yieldSpin->setDecimals(0);
+    yieldSpin->setSuffix(" g");
+    yieldSpin->setSpecialValueText("Suma de los ingredientes");
+    recipeForm->addRow("Peso final tras cocinar:", yieldSpin);
+    recipeEditorLayout->addLayout(recipeForm);
+    QTableWidget *recipeItems = makeItemsTable(recipeEditor, "Ingrediente");
+    recipeEditorLayout->addWidget(recipeItems, 1);
+    QHBoxLayout *recipeItemButtons = new QHBoxLayout;
+    QPushButton *addFoodButton = new QPushButton("Añadir alimento...", recipeEditor);
+    QPushButton *addSubrecipeButton = new QPushButton("Añadir receta...", recipeEditor);
+    QPushButton *removeRecipeItemButton = new QPushButton("Quitar", recipeEditor);
+    QPushButton *saveRecipeButton = new QPushButton("Guardar receta", recipeEditor);
+    recipeItemButtons->addWidget(addFoodButton);
+    recipeItemButtons->addWidget(addSubrecipeButton);
+    recipeItemButtons->addWidget(removeRecipeItemButton);
+    recipeItemButtons->addStretch();
+    recipeItemButtons->addWidget(saveRecipeButton);
+    recipeEditorLayout->addLayout(recipeItemButtons);
+    QTableWidget *recipeTotals = makeTotalsTable(recipeEditor, { "Nutriente", "Receta completa", "Por 100 g" });
+    recipeEditorLayout->addWidget(recipeTotals, 1);
+    recipeLayout->addWidget(recipeEditor, 2);
+    tabs->addTab(recipeTab, "Recetas");
 
-            // Columna 1: Nombre del usuario
-            ui->tableWidget_users->setItem(i, 1, new QTableWidgetItem(user->firstName()));
+    auto currentRecipe = [recipeList]() {
+        return recipeList->currentItem() ? recipeList->currentItem()->data(Qt::UserRole).toInt() : -1;
+    };
+    auto loadRecipeList = [graph, recipeList](int selectId) {
+        recipeList->clear();
+        for (int id : graph->recipeIds()) {
+            QListWidgetItem *item = new QListWidgetItem(graph->recipeName(id), recipeList);
+            item->setData(Qt::UserRole, id);
+            if (id == selectId) {
+                recipeList->setCurrentItem(item);
+            }
+        }
+    };
+    auto showRecipe = [graph, currentRecipe, recipeEditor, deleteRecipeButton, yieldSpin, recipeItems, recipeTotals,
+                       fillItems, fillTotals]() {
+        const int recipeId = currentRecipe();
+        recipeEditor->setEnabled(recipeId > 0);
+        deleteRecipeButton->setEnabled(recipeId > 0);
+        yieldSpin->setValue(recipeId > 0 ? graph->recipeYield(recipeId) : 0.0);
+        fillItems(recipeItems, recipeId > 0 ? graph->recipeItems(recipeId) : QVector<RecipeGraph::Item>());
+        fillTotals(recipeTotals, recipeId > 0 ? graph->recipeTotals(recipeId) : QVector<double>(),
+                   recipeId > 0 ? graph->recipePer100g(recipeId) : QVector<double>());
+    };
+    connect(recipeList, &QListWidget::currentItemChanged, &dialog, showRecipe);
+    connect(newRecipeButton, &QPushButton::clicked, &dialog, [&dialog, graph, loadRecipeList]() {
+        bool ok = false;
+        const QString name = QInputDialog::getText(&dialog, "Nueva receta", "Nombre:", QLineEdit::Normal, QString(), &ok).trimmed();
+        if (!ok || name.isEmpty()) {
+            return;
+        }
+        const int recipeId = graph->createRecipe(name);
+        if (recipeId < 0) {
+            QMessageBox::warning(&dialog, "Nueva receta", "No se pudo crear la receta.");
+            return;
+        }
+        loadRecipeList(recipeId);
+    });
+    connect(deleteRecipeButton, &QPushButton::clicked, &dialog, [&dialog, graph, currentRecipe, loadRecipeList, showRecipe]() {
+        const int recipeId = currentRecipe();
+        if (recipeId < 0 || QMessageBox::question(&dialog, "Eliminar receta",
+                                                  QString("¿Eliminar la receta \"%1\"?").arg(graph->recipeName(recipeId)))
+                                 != QMessageBox::Yes) {
+            return;
+        }
+        QString error;
+        if (!graph->deleteRecipe(recipeId, &error)) {
+            QMessageBox::warning(&dialog, "Eliminar receta",
+                                 error.isEmpty() ? QString("No se pudo eliminar la receta.") : error);
+            return;
+        }
+        loadRecipeList(-1);
+        showRecipe();
+    });
+    connect(addFoodButton, &QPushButton::clicked, &dialog, [pickFood, askGrams, appendItem, recipeItems]() {
+        RecipeGraph::Item item;
+        item.foodCode = pickFood();
+        if (!item.foodCode.isEmpty() && askGrams(&item.grams)) {
+            appendItem(recipeItems, item);
+        }
+    });
+    connect(addSubrecipeButton, &QPushButton::clicked, &dialog, [pickRecipe, askGrams, appendItem, recipeItems, currentRecipe]() {
+        RecipeGraph::Item item;
+        item.recipeId = pickRecipe(currentRecipe());
+        if (item.recipeId > 0 && askGrams(&item.grams)) {
+            appendItem(recipeItems, item);
+        }
+    });
+    connect(removeRecipeItemButton, &QPushButton::clicked, &dialog, [recipeItems]() {
+        if (recipeItems->currentRow() >= 0) {
+            recipeItems->removeRow(recipeItems->currentRow());
+        }
+    });
+    connect(saveRecipeButton, &QPushButton::clicked, &dialog,
+            [this, &dialog, graph, currentRecipe, readItems, recipeItems, yieldSpin, showRecipe]() {
+                const int recipeId = currentRecipe();
+                if (recipeId < 0) {
+                    return;
+                }
+                QVector<RecipeGraph::Item> items;
+                QString error;
+                if (!readItems(recipeItems, items, &error) || !graph->setRecipeItems(recipeId, items, &error)) {
+                    QMessageBox::warning(&dialog, "Guardar receta", error);
+                    return;
+                }
+                if (yieldSpin->value() != graph->recipeYield(recipeId) && !graph->setRecipeYield(recipeId, yieldSpin->value())) {
+                    QMessageBox::warning(&dialog, "Guardar receta", "No se pudo guardar el peso final.");
+                    return;
+                }
+                showRecipe();
+                ui->statusbar->showMessage(QString("Receta \"%1\" guardada.").arg(graph->recipeName(recipeId)));
+            });
+    loadRecipeList(-1);
+    showRecipe();
 
-            // Columna 2: Primer apellido del usuario
-            ui->tableWidget_users->setItem(i, 2, new QTableWidgetItem(user->lastName1()));
+    // --- Planes de dieta del paciente seleccionado ---
+    QWidget *planTab = new QWidget(tabs);
+    QHBoxLayout *planLayout = new QHBoxLayout(planTab);
+    QVBoxLayout *planListLayout = new QVBoxLayout;
+    QListWidget *planList = new QListWidget(planTab);
+    QPushButton *newPlanButton = new QPushButton("Nuevo...", planTab);
+    QPushButton *deletePlanButton = new QPushButton("Eliminar", planTab);
+    QHBoxLayout *planListButtons = new QHBoxLayout;
+    planListButtons->addWidget(newPlanButton);
+    planListButtons->addWidget(deletePlanButton);
+    planListLayout->addWidget(planList);
+    planListLayout->addLayout(planListButtons);
+    planLayout->addLayout(planListLayout, 1);
 
-            // Columna 3: Segundo apellido del usuario
-            ui->tableWidget_users->setItem(i, 3, new QTableWidgetItem(user->lastName2()));
+    QWidget *planEditor = new QWidget(planTab);
+    QVBoxLayout *planEditorLayout = new QVBoxLayout(planEditor);
+    planEditorLayout->setContentsMargins(0, 0, 0, 0);
+    QTableWidget *planItems = makeItemsTable(planEditor, "Receta");
+    planEditorLayout->addWidget(planItems, 1);
+    QHBoxLayout *planItemButtons = new QHBoxLayout;
+    QPushButton *addPlanRecipeButton = new QPushButton("Añadir receta...", planEditor);
+    QPushButton *removePlanItemButton = new QPushButton("Quitar", planEditor);
+    QPushButton *savePlanButton = new QPushButton("Guardar plan", planEditor);
+    planItemButtons->addWidget(addPlanRecipeButton);
+    planItemButtons->addWidget(removePlanItemButton);
+    planItemButtons->addStretch();
+    planItemButtons->addWidget(savePlanButton);
+    planEditorLayout->addLayout(planItemButtons);
+    QTableWidget *planTotals = makeTotalsTable(planEditor, { "Nutriente", "Total del plan" });
+    planEditorLayout->addWidget(planTotals, 1);
+    planLayout->addWidget(planEditor, 2);
 
-            // Puedes añadir más columnas y datos aquí si deseas mostrar más información
-            // de forma resumida en la tabla principal de usuarios.
+    QString patientName;
+    for (const UserSnapshot::Entry& entry : std::as_const(m_userEntries)) {
+        if (entry.id == planUserId) {
+            patientName = QString("%1 %2 %3").arg(entry.firstName, entry.lastName1, entry.lastName2).simplified();
+            break;
         }
     }
-    // Ajusta automáticamente el ancho de las columnas para adaptarse al contenido.
-    ui->tableWidget_users->resizeColumnsToContents();
-    qDebug() << "Usuarios cargados en la tabla. Total:" << users.count();
+    const int planTabIndex = tabs->addTab(planTab, planUserId > 0 ? "Planes de " + patientName : QString("Planes de dieta"));
+    if (planUserId < 0) {
+        tabs->setTabEnabled(planTabIndex, false);
+        tabs->setTabToolTip(planTabIndex, "Seleccione un único paciente en la lista para editar sus planes de dieta.");
+    }
+
+    auto currentPlan = [planList]() {
+        return planList->currentItem() ? planList->currentItem()->data(Qt::UserRole).toInt() : -1;
+    };
+    auto loadPlanList = [graph, planList, planUserId](int selectId) {
+        planList->clear();
+        if (planUserId < 0) {
+            return;
+        }
+        for (int id : graph->dietPlansForUser(planUserId)) {
+            QListWidgetItem *item = new QListWidgetItem(graph->dietPlanName(id), planList);
+            item->setData(Qt::UserRole, id);
+            if (id == selectId) {
+                planList->setCurrentItem(item);
+            }
+        }
+    };
+    auto showPlan = [graph, currentPlan, planEditor, deletePlanButton, planItems, planTotals, fillItems, fillTotals]() {
+        const int planId = currentPlan();
+        planEditor->setEnabled(planId > 0);
+        deletePlanButton->setEnabled(planId > 0);
+        fillItems(planItems, planId > 0 ? graph->dietPlanItems(planId) : QVector<RecipeGraph::Item>());
+        fillTotals(planTotals, planId > 0 ? graph->dietPlanTotals(planId) : QVector<double>(), QVector<double>());
+    };
+    connect(planList, &QListWidget::currentItemChanged, &dialog, showPlan);
+    connect(newPlanButton, &QPushButton::clicked, &dialog, [&dialog, graph, planUserId, loadPlanList]() {
+        bool ok = false;
+        const QString name = QInputDialog::getText(&dialog, "Nuevo plan de dieta", "Nombre:", QLineEdit::Normal, QString(), &ok).trimmed();
+        if (!ok || name.isEmpty()) {
+            return;
+        }
+        const int planId = graph->createDietPlan(planUserId, name);
+        if (planId < 0) {
+            QMessageBox::warning(&dialog, "Nuevo plan de dieta", "No se pudo crear el plan.");
+            return;
+        }
+        loadPlanList(planId);
+    });
+    connect(deletePlanButton, &QPushButton::clicked, &dialog, [&dialog, graph, currentPlan, loadPlanList, showPlan]() {
+        const int planId = currentPlan();
+        if (planId < 0 || QMessageBox::question(&dialog, "Eliminar plan de dieta",
+                                                QString("¿Eliminar el plan \"%1\"?").arg(graph->dietPlanName(planId)))
+                               != QMessageBox::Yes) {
+            return;
+        }
+        if (!graph->deleteDietPlan(planId)) {
+            QMessageBox::warning(&dialog, "Eliminar plan de dieta", "No se pudo eliminar el plan.");
+            return;
+        }
+        loadPlanList(-1);
+        showPlan();
+    });
+    connect(addPlanRecipeButton, &QPushButton::clicked, &dialog, [pickRecipe, askGrams, appendItem, planItems]() {
+        RecipeGraph::Item item;
+        item.recipeId = pickRecipe(-1);
+        if (item.recipeId > 0 && askGrams(&item.grams)) {
+            appendItem(planItems, item);
+        }
+    });
+    connect(removePlanItemButton, &QPushButton::clicked, &dialog, [planItems]() {
+        if (planItems->currentRow() >= 0) {
+            planItems->removeRow(planItems->currentRow());
+        }
+    });
+    connect(savePlanButton, &QPushButton::clicked, &dialog,
+            [this, &dialog, graph, currentPlan, readItems, planItems, showPlan]() {
+                const int planId = currentPlan();
+                if (planId < 0) {
+                    return;
+                }
+                QVector<RecipeGraph::Item> items;
+                QString error;
+                if (!readItems(planItems, items, &error) || !graph->setDietPlanItems(planId, items, &error)) {
+                    QMessageBox::warning(&dialog, "Guardar plan de dieta", error);
+                    return;
+                }
+                showPlan();
+                ui->statusbar->showMessage(QString("Plan \"%1\" guardado.").arg(graph->dietPlanName(planId)));
+            });
+    loadPlanList(-1);
+    showPlan();
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addWidget(buttons);
+    dialog.exec();
+}
+
+void MainWindow::generateMealPlans()
+{
+    MealPlanOptimizer *optimizer = MealPlanOptimizer::instance();
+    if (optimizer->isRunning()) {
+        QMessageBox::information(this, "Planes semanales", "Ya se están generando planes.");
+        return;
+    }
+    const QDate today = QDate::currentDate();
+    const QDate nextMonday = today.addDays(8 - today.dayOfWeek());
+    if (!optimizer->generateWeek(nextMonday)) {
+        QMessageBox::warning(this, "Planes semanales",
+                             "No hay alimentos ni recetas con composición para generar planes. "
+                             "Importe una tabla de alimentos o cree recetas.");
+        return;
+    }
+    ui->statusbar->showMessage("Generando planes semanales...");
+}
+
+// Un PDF por paciente con mediciones en los últimos 12 meses; se generan en segundo plano
+void MainWindow::generateProgressReports()
+{
+    ProgressReportEngine *engine = ProgressReportEngine::instance();
+    if (engine->isRunning()) {
+        QMessageBox::information(this, "Informes de progreso", "Ya se están generando informes.");
+        return;
+    }
+    const QString outputDir = QFileDialog::getExistingDirectory(this, "Carpeta para los informes de progreso");
+    if (outputDir.isEmpty()) {
+        return;
+    }
+    ProgressReportEngine::Options options;
+    options.month = QDate::currentDate();
+    options.outputDir = outputDir;
+    if (!engine->start(options)) {
+        QMessageBox::warning(this, "Informes de progreso", "No se pudo escribir en la carpeta seleccionada.");
+        return;
+    }
+    ui->statusbar->showMessage("Generando informes de progreso...");
+}
+
+// Extracto de pacientes o mediciones para análisis externo (DataExporter)
+void MainWindow::exportData()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("Exportar datos");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QComboBox *datasetCombo = new QComboBox(&dialog);
+    datasetCombo->addItem("Mediciones", DataExporter::HealthMetrics);
+    datasetCombo->addItem("Pacientes", DataExporter::Patients);
+    form->addRow("Datos:", datasetCombo);
+
+    QComboBox *formatCombo = new QComboBox(&dialog);
+    formatCombo->addItem("CSV", DataExporter::Csv);
+    formatCombo->addItem("JSON Lines", DataExporter::JsonLines);
+    formatCombo->addItem("Arrow IPC (pandas, polars, R, DuckDB)", DataExporter::ArrowIpc);
+    form->addRow("Formato:", formatCombo);
+
+    QCheckBox *gzipCheck = new QCheckBox("Comprimir con gzip", &dialog);
+    form->addRow(QString(), gzipCheck);
+
+    // Mediciones: fecha de la medición; pacientes: fecha de alta
+    QCheckBox *dateCheck = new QCheckBox("Solo entre", &dialog);
+    QDateEdit *fromEdit = new QDateEdit(QDate::currentDate().addYears(-1), &dialog);
+    QDateEdit *toEdit = new QDateEdit(QDate::currentDate(), &dialog);
+    for (QDateEdit *edit : { fromEdit, toEdit }) {
+        edit->setCalendarPopup(true);
+        edit->setEnabled(false);
+        connect(dateCheck, &QCheckBox::toggled, edit, &QWidget::setEnabled);
+    }
+    QHBoxLayout *dateLayout = new QHBoxLayout;
+    dateLayout->addWidget(dateCheck);
+    dateLayout->addWidget(fromEdit);
+    dateLayout->addWidget(new QLabel("y", &dialog));
+    dateLayout->addWidget(toEdit);
+    form->addRow("Fechas:", dateLayout);
+
+    const QList<int> selected = selectedUserIds();
+    QCheckBox *selectedCheck = new QCheckBox(QString("Solo los pacientes seleccionados (%1)").arg(selected.size()), &dialog);
+    selectedCheck->setEnabled(!selected.isEmpty());
+    form->addRow(QString(), selectedCheck);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    const DataExporter::Dataset dataset = DataExporter::Dataset(datasetCombo->currentData().toInt());
+    const DataExporter::Format format = DataExporter::Format(formatCombo->currentData().toInt());
+    const ExportSink::Compression compression = gzipCheck->isChecked() ? ExportSink::GzipCompression
+                                                                       : ExportSink::NoCompression;
+    const QString suffix = DataExporter::fileSuffix(format, compression);
+    QString filePath = QFileDialog::getSaveFileName(this, "Exportar datos",
+                                                    (dataset == DataExporter::Patients ? "pacientes" : "mediciones") + suffix,
+                                                    QString("%1 (*%2)").arg(formatCombo->currentText(), suffix));
+    if (filePath.isEmpty()) {
+        return;
+    }
+    if (!filePath.endsWith(suffix)) {
+        filePath += suffix;
+    }
+
+    DataExporter::Filter filter;
+    if (dateCheck->isChecked()) {
+        filter.from = fromEdit->date();
+        filter.to = toEdit->date();
+    }
+    if (selectedCheck->isChecked()) {
+        filter.userIds = selected;
+    }
+
+    // En un hilo de trabajo con su propia conexión: la ventana sigue respondiendo y se puede cancelar
+    QProgressDialog *progressDialog = new QProgressDialog("Exportando datos...", "Cancelar", 0, 1000, this);
+    progressDialog->setWindowTitle("Exportar datos");
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+    progressDialog->setValue(0);
+
+    QSharedPointer<DataExporter::Result> result = QSharedPointer<DataExporter::Result>::create();
+    auto* watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::progressValueChanged, progressDialog, &QProgressDialog::setValue);
+    connect(progressDialog, &QProgressDialog::canceled, watcher, &QFutureWatcher<QString>::cancel);
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher, progressDialog, result]() {
+        const bool cancelled = watcher->isCanceled();
+        const QString error = (!cancelled && watcher->future().resultCount() > 0) ? watcher->result() : QString();
+        watcher->deleteLater();
+        progressDialog->deleteLater();
+        if (cancelled) {
+            ui->statusbar->showMessage("Exportación cancelada.");
+            return;
+        }
+        if (!error.isEmpty()) {
+            QMessageBox::critical(this, "Error", "No se pudo exportar:\n" + error);
+            return;
+        }
+        ui->statusbar->showMessage(QString("Exportadas %1 filas (%2) en %3 s.")
+                                       .arg(result->rows)
+                                       .arg(QLocale().formattedDataSize(result->bytes))
+                                       .arg(result->elapsedMs / 1000.0, 0, 'f', 1));
+    });
+    // Resultado: mensaje de error, vacío si se exportó
+    watcher->setFuture(QtConcurrent::run([filePath, dataset, format, compression, filter, result](QPromise<QString>& promise) {
+        promise.setProgressRange(0, 1000);
+        const DataExporter::Progress progress = [&promise](qint64 rows, qint64 total) {
+            promise.setProgressValue(total > 0 ? int(qMin<qint64>(999, rows * 1000 / total)) : 0);
+            return !promise.isCanceled();
+        };
+        QString error;
+        const bool exported = DataExporter::exportTo(filePath, dataset, format, compression, filter, result.data(),
+                                                     &error, progress);
+        promise.addResult(exported ? QString() : (error.isEmpty() ? QString("error desconocido") : error));
+    }));
+}
+
+// Archivos de pacientes y de mediciones de otra clínica; los dos son opcionales
+void MainWindow::importPatients()
+{
+    BulkImporter *importer = BulkImporter::instance();
+    if (importer->isRunning()) {
+        QMessageBox::information(this, "Importar pacientes", "Ya hay una importación en curso.");
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Importar pacientes y mediciones");
+    QFormLayout *form = new QFormLayout(&dialog);
+    QLineEdit *sourceEdit = new QLineEdit(&dialog);
+    sourceEdit->setPlaceholderText("Nombre o código de la clínica de origen");
+    form->addRow("Origen de los IDs:", sourceEdit);
+
+    auto addFileRow = [this, &dialog, form](const QString& label) {
+        QLineEdit *edit = new QLineEdit(&dialog);
+        QPushButton *browse = new QPushButton("Examinar...", &dialog);
+        connect(browse, &QPushButton::clicked, &dialog, [this, edit, label]() {
+            const QString path = QFileDialog::getOpenFileName(this, label, edit->text(),
+                                                              "Archivos CSV (*.csv *.txt);;Todos los archivos (*)");
+            if (!path.isEmpty()) {
+                edit->setText(path);
+            }
+        });
+        QHBoxLayout *layout = new QHBoxLayout;
+        layout->addWidget(edit);
+        layout->addWidget(browse);
+        form->addRow(label + ":", layout);
+        return edit;
+    };
+    QLineEdit *patientsEdit = addFileRow("Pacientes");
+    QLineEdit *metricsEdit = addFileRow("Mediciones");
+    form->addRow(new QLabel("Los pacientes se importan antes que las mediciones. Las filas no válidas se\n"
+                            "guardan en <archivo>.rechazos.csv y una importación interrumpida se reanuda\n"
+                            "al volver a importar el mismo archivo.", &dialog));
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    BulkImporter::Options options;
+    options.source = sourceEdit->text();
+    options.patientsFile = patientsEdit->text().trimmed();
+    options.metricsFile = metricsEdit->text().trimmed();
+    QString error;
+    if (!importer->start(options, &error)) {
+        QMessageBox::warning(this, "Importar pacientes", error);
+        return;
+    }
+    if (importer->isRunning()) {
+        ui->statusbar->showMessage("Importando pacientes y mediciones...");
+    }
+}
+
+void MainWindow::importFoodCatalog(bool usda)
+{
+    const QString source = usda
+        ? QFileDialog::getExistingDirectory(this, "Carpeta con food.csv, nutrient.csv y food_nutrient.csv")
+        : QFileDialog::getOpenFileName(this, "Tabla de composición de alimentos", QString(),
+                                       "Tablas CSV (*.csv *.txt);;Todos los archivos (*)");
+    if (source.isEmpty()) {
+        return;
+    }
+
+    QString catalogPath = FoodCatalog::instance()->filePath();
+    if (catalogPath.isEmpty()) {
+        catalogPath = DatabaseManager::foodCatalogPathFor(QCoreApplication::applicationDirPath() + "/nutricion.db");
+    }
+    // El catálogo nuevo se genera aparte en un hilo de trabajo; el actual sigue abierto y en uso
+    // hasta que termine, y solo entonces se sustituye
+    const QString newPath = catalogPath + ".new";
+
+    QProgressDialog *progressDialog = new QProgressDialog("Importando la tabla de alimentos...", "Cancelar", 0, 1000, this);
+    progressDialog->setWindowTitle("Tabla de alimentos");
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+    progressDialog->setValue(0);
+
+    auto* watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::progressValueChanged, progressDialog, &QProgressDialog::setValue);
+    connect(progressDialog, &QProgressDialog::canceled, watcher, &QFutureWatcher<QString>::cancel);
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher, progressDialog, catalogPath, newPath]() {
+        const bool cancelled = watcher->isCanceled();
+        const QString error = (!cancelled && watcher->future().resultCount() > 0) ? watcher->result() : QString();
+        watcher->deleteLater();
+        progressDialog->deleteLater();
+        if (cancelled || !error.isEmpty()) {
+            QFile::remove(newPath);
+            if (cancelled) {
+                ui->statusbar->showMessage("Importación de la tabla de alimentos cancelada.");
+            } else {
+                QMessageBox::critical(this, "Error", "No se pudo importar la tabla de alimentos:\n" + error);
+            }
+            return;
+        }
+
+        // El archivo mapeado no se puede reemplazar mientras está abierto (Windows)
+        FoodCatalog *catalog = FoodCatalog::instance();
+        catalog->close();
+        QFile::remove(catalogPath);
+        const bool replaced = QFile::rename(newPath, catalogPath);
+        catalog->open(catalogPath);
+        if (!replaced) {
+            QMessageBox::critical(this, "Error", "No se pudo sustituir el catálogo de alimentos por " + newPath);
+            return;
+        }
+        RecipeGraph::instance()->refreshFoods();
+        QMessageBox::information(this, "Tabla de alimentos",
+                                 QString("Catálogo actualizado: %1 alimentos y %2 nutrientes.")
+                                     .arg(catalog->foodCount())
+                                     .arg(catalog->nutrientCount()));
+    });
+    // Resultado: mensaje de error, vacío si el catálogo se generó
+    watcher->setFuture(QtConcurrent::run([source, newPath, usda](QPromise<QString>& promise) {
+        promise.setProgressRange(0, 1000);
+        const FoodCatalogImporter::Progress progress = [&promise](qint64 done, qint64 total) {
+            promise.setProgressValue(total > 0 ? int(qMin<qint64>(999, done * 1000 / total)) : 0);
+            return !promise.isCanceled();
+        };
+        QString error;
+        const bool imported = usda ? FoodCatalogImporter::importUsdaFdc(source, newPath, &error, progress)
+                                   : FoodCatalogImporter::importCsv(source, newPath, &error, progress);
+        promise.addResult(imported ? QString() : (error.isEmpty() ? QString("error desconocido") : error));
+    }));
+}
+
+// Una línea por candidato: "ID 12 María José García López (93 %)"; con 'pairs' se incluye el nuevo
+QString MainWindow::describeDuplicates(const QList<PatientDeduplicator::Candidate>& candidates, bool pairs)
+{
+    auto describe = [this](int userId) {
+        const QSharedPointer<User> user = userManager->getUserById(userId);
+        if (!user) {
+            return QString("ID %1").arg(userId);
+        }
+        return QString("ID %1 %2 %3 %4 (%5)")
+            .arg(userId)
+            .arg(user->firstName(), user->lastName1(), user->lastName2(), user->birthDate().toString("dd/MM/yyyy"))
+            .simplified();
+    };
+    QStringList lines;
+    for (const PatientDeduplicator::Candidate& candidate : candidates) {
+        const QString score = QString::number(qRound(candidate.score * 100)) + " %";
+        lines << (pairs ? QString("%1  <->  %2   [%3]").arg(describe(candidate.duplicateOf), describe(candidate.userId), score)
+                        : QString("%1   [%2]").arg(describe(candidate.duplicateOf), score));
+    }
+    return lines.join('\n');
+}
+
+// La búsqueda en todo el registro se hace en un hilo de trabajo con su propia conexión y su propio
+// índice (PatientDeduplicator::findAllIn); el resultado se muestra al terminar
+void MainWindow::findDuplicatePatients()
+{
+    QProgressDialog *progressDialog = new QProgressDialog("Buscando pacientes duplicados...", "Cancelar", 0, 0, this);
+    progressDialog->setWindowTitle("Pacientes duplicados");
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+    progressDialog->setValue(0);
+
+    auto *watcher = new QFutureWatcher<QList<PatientDeduplicator::Candidate>>(this);
+    connect(watcher, &QFutureWatcher<QList<PatientDeduplicator::Candidate>>::finished, this, [this, watcher, progressDialog]() {
+        const QList<PatientDeduplicator::Candidate> candidates = watcher->result();
+        const bool cancelled = progressDialog->wasCanceled();
+        watcher->deleteLater();
+        progressDialog->deleteLater();
+        if (cancelled) {
+            return; // La búsqueda no se puede interrumpir: solo se descarta el resultado
+        }
+        if (candidates.isEmpty()) {
+            QMessageBox::information(this, "Pacientes duplicados", "No se han encontrado posibles duplicados.");
+            return;
+        }
+        QMessageBox box(QMessageBox::Information, "Pacientes duplicados",
+                        QString("Se han encontrado %1 parejas de posibles duplicados (las más probables primero).")
+                            .arg(candidates.size()),
+                        QMessageBox::Ok, this);
+        box.setDetailedText(describeDuplicates(candidates, true));
+        box.exec();
+    });
+    watcher->setFuture(QtConcurrent::run([]() {
+        return withWorkerConnection<QList<PatientDeduplicator::Candidate>>("find_duplicates", [](const QSqlDatabase& db) {
+            return PatientDeduplicator::findAllIn(db, 0.88, 200);
+        });
+    }));
+}
+
+QList<int> MainWindow::selectedUserIds() const
+{
+    QList<int> userIds;
+    for (const QModelIndex& index : ui->tableView_users->selectionModel()->selectedRows(0)) {
+        userIds.append(m_userTableModel->userIdAt(index.row()));
+    }
+    return userIds;
+}
+
+void MainWindow::compareSelectedPatients()
+{
+    const QList<int> userIds = selectedUserIds();
+    if (userIds.size() < 2) {
+        QMessageBox::information(this, "Comparar pacientes",
+                                 "Seleccione al menos dos pacientes en la tabla (Ctrl o Mayús + clic).");
+        return;
+    }
+
+    PatientComparisonWindow *comparisonWindow = new PatientComparisonWindow(userIds, nullptr);
+    comparisonWindow->setAttribute(Qt::WA_DeleteOnClose);
+    comparisonWindow->show();
+}
+
+// La revisión lee toda la tabla de mediciones: se hace en un hilo de trabajo con su propia conexión,
+// con progreso y cancelación (si se cancela, la cola de revisión queda como estaba)
+void MainWindow::reviewAllMetrics()
+{
+    QProgressDialog *progressDialog = new QProgressDialog("Revisando mediciones...", "Cancelar", 0, 1000, this);
+    progressDialog->setWindowTitle("Revisión de mediciones");
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+    progressDialog->setValue(0);
+
+    auto* watcher = new QFutureWatcher<int>(this);
+    connect(watcher, &QFutureWatcher<int>::progressValueChanged, progressDialog, &QProgressDialog::setValue);
+    connect(progressDialog, &QProgressDialog::canceled, watcher, &QFutureWatcher<int>::cancel);
+    connect(watcher, &QFutureWatcher<int>::finished, this, [this, watcher, progressDialog]() {
+        const bool cancelled = watcher->isCanceled();
+        const int findings = (!cancelled && watcher->future().resultCount() > 0) ? watcher->result() : -1;
+        watcher->deleteLater();
+        progressDialog->deleteLater();
+        if (cancelled) {
+            ui->statusbar->showMessage("Revisión de mediciones cancelada.");
+            return;
+        }
+        if (findings < 0) {
+            QMessageBox::critical(this, "Error", "No se pudo completar la revisión de mediciones.");
+        } else if (findings == 0) {
+            QMessageBox::information(this, "Revisión de mediciones", "No se han encontrado mediciones sospechosas.");
+        } else if (QMessageBox::question(this, "Revisión de mediciones",
+                                         QString("Hay %1 avisos pendientes en la cola de revisión. ¿Desea revisarlos ahora?")
+                                             .arg(findings))
+                   == QMessageBox::Yes) {
+            showReviewQueue();
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([](QPromise<int>& promise) {
+        promise.setProgressRange(0, 1000);
+        const MetricAnomalyDetector::Progress progress = [&promise](qint64 done, qint64 total) {
+            promise.setProgressValue(total > 0 ? int(qMin<qint64>(999, done * 1000 / total)) : 0);
+            return !promise.isCanceled();
+        };
+        promise.addResult(withWorkerConnection<int>("review_metrics", [&progress](const QSqlDatabase& db) {
+            return MetricAnomalyDetector::sweepAll(db, progress);
+        }, -1));
+    }));
+}
+
+void MainWindow::showReviewQueue()
+{
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const QList<MetricAnomalyDetector::ReviewEntry> entries = MetricAnomalyDetector::pendingReviews();
+    QApplication::restoreOverrideCursor();
+    if (entries.isEmpty()) {
+        QMessageBox::information(this, "Cola de revisión",
+                                 "No hay avisos pendientes. Use Herramientas > Revisar mediciones para buscarlos.");
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(QString("Cola de revisión (%1 pendientes)").arg(entries.size()));
+    dialog.resize(900, 500);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    QTableWidget *table = new QTableWidget(int(entries.size()), 5, &dialog);
+    table->setHorizontalHeaderLabels({ "Fecha", "Paciente", "Campo", "Gravedad", "Aviso" });
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    table->verticalHeader()->setVisible(false);
+    table->horizontalHeader()->setStretchLastSection(true);
+    for (int row = 0; row < entries.size(); ++row) {
+        const MetricAnomalyDetector::ReviewEntry& entry = entries.at(row);
+        QTableWidgetItem *dateItem = new QTableWidgetItem(entry.date.toString("dd/MM/yyyy"));
+        dateItem->setData(Qt::UserRole, entry.reviewId);
+        table->setItem(row, 0, dateItem);
+        table->setItem(row, 1, new QTableWidgetItem(QString("%1 (ID %2)").arg(entry.patientName).arg(entry.userId)));
+        table->setItem(row, 2, new QTableWidgetItem(entry.finding.field));
+        table->setItem(row, 3, new QTableWidgetItem(entry.finding.severity == MetricAnomalyDetector::Critical
+                                                        ? "Crítico" : "Aviso"));
+        table->setItem(row, 4, new QTableWidgetItem(entry.finding.message));
+    }
+    table->resizeColumnsToContents();
+    layout->addWidget(table);
+    layout->addWidget(new QLabel("Corrija la medición desde la ficha del paciente o marque el aviso como revisado\n"
+                                 "si el valor es correcto; los avisos revisados no vuelven a aparecer.", &dialog));
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    QPushButton *resolveButton = buttons->addButton("Marcar seleccionados como revisados", QDialogButtonBox::ActionRole);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    connect(resolveButton, &QPushButton::clicked, &dialog, [this, table, &dialog]() {
+        const QModelIndexList selected = table->selectionModel()->selectedRows(0);
+        QList<int> reviewIds;
+        QList<int> rows;
+        for (const QModelIndex& index : selected) {
+            reviewIds.append(table->item(index.row(), 0)->data(Qt::UserRole).toInt());
+            rows.append(index.row());
+        }
+        if (reviewIds.isEmpty()) {
+            return;
+        }
+        if (!MetricAnomalyDetector::resolveReviews(reviewIds)) {
+            QMessageBox::critical(this, "Error", "No se pudieron marcar los avisos como revisados.");
+            return;
+        }
+        // De abajo arriba para no desplazar las filas pendientes de quitar
+        std::sort(rows.begin(), rows.end(), std::greater<int>());
+        for (int row : std::as_const(rows)) {
+            table->removeRow(row);
+        }
+        dialog.setWindowTitle(QString("Cola de revisión (%1 pendientes)").arg(table->rowCount()));
+    });
+    layout->addWidget(buttons);
+    dialog.exec();
+}
+
+// Agregados de la clínica en un hilo de trabajo con su propia conexión (lee toda la tabla de mediciones)
+static QFuture<QList<CohortGroupStats>> computeCohorts(CohortAnalytics::GroupBy groupBy)
+{
+    return QtConcurrent::run([groupBy]() {
+        return withWorkerConnection<QList<CohortGroupStats>>("cohort_analytics", [groupBy](const QSqlDatabase& db) {
+            return CohortAnalytics().compute(groupBy, QDate::currentDate(), db);
+        });
+    });
+}
+
+// El primer cálculo (por objetivo) se hace antes de abrir el diálogo, con una ventana de espera;
+// los cambios de agrupación se calculan en segundo plano con el diálogo abierto
+void MainWindow::showCohortAnalytics()
+{
+    QProgressDialog *progressDialog = new QProgressDialog("Calculando el análisis de cohortes...", "Cancelar", 0, 0, this);
+    progressDialog->setWindowTitle("Análisis de cohortes");
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+    progressDialog->setValue(0);
+
+    auto *watcher = new QFutureWatcher<QList<CohortGroupStats>>(this);
+    connect(watcher, &QFutureWatcher<QList<CohortGroupStats>>::finished, this, [this, watcher, progressDialog]() {
+        const QList<CohortGroupStats> groups = watcher->result();
+        const bool cancelled = progressDialog->wasCanceled();
+        watcher->deleteLater();
+        progressDialog->deleteLater();
+        if (!cancelled) {
+            showCohortDialog(groups); // La lectura no se puede interrumpir: al cancelar solo se descarta
+        }
+    });
+    watcher->setFuture(computeCohorts(CohortAnalytics::ByGoal));
+}
+
+void MainWindow::showCohortDialog(const QList<CohortGroupStats>& initialGroups)
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("Análisis de cohortes");
+    dialog.resize(1000, 400);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    QComboBox *groupCombo = new QComboBox(&dialog);
+    groupCombo->addItem("Por objetivo", CohortAnalytics::ByGoal);
+    groupCombo->addItem("Por nivel de actividad", CohortAnalytics::ByActivityLevel);
+    groupCombo->addItem("Por género", CohortAnalytics::ByGender);
+    layout->addWidget(groupCombo);
+
+    QTableWidget *table = new QTableWidget(0, 9, &dialog);
+    table->setHorizontalHeaderLabels({ "Grupo", "Pacientes", "Con historial", "Cambio de peso (kg)", "Tendencia (kg/sem)",
+                                       "IMC medio", "IMC P25 / mediana / P75", "Evaluados (90 días)", "Mejoran" });
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->verticalHeader()->setVisible(false);
+    table->horizontalHeader()->setStretchLastSection(true);
+    layout->addWidget(table);
+    QLabel *statusLabel = new QLabel(&dialog);
+    layout->addWidget(statusLabel);
+    const QString note = "El IMC solo cuenta a los pacientes con alguna medición con altura.";
+    statusLabel->setText(note);
+
+    auto fill = [table](const QList<CohortGroupStats>& groups) {
+        const QLocale locale;
+        table->setRowCount(int(groups.size()));
+        for (int row = 0; row < groups.size(); ++row) {
+            const CohortGroupStats& stats = groups.at(row);
+            const bool hasBmi = stats.patientsWithBmi > 0;
+            const QStringList cells = {
+                stats.group,
+                QString::number(stats.patients),
+                QString::number(stats.patientsWithHistory),
+                locale.toString(stats.meanWeightChange, 'f', 1),
+                locale.toString(stats.meanWeeklyTrend, 'f', 2),
+                hasBmi ? QString("%1 (%2 pac.)").arg(locale.toString(stats.meanLatestBmi, 'f', 1)).arg(stats.patientsWithBmi)
+                       : QString("-"),
+                hasBmi ? QString("%1 / %2 / %3").arg(locale.toString(stats.bmiP25, 'f', 1),
+                                                     locale.toString(stats.bmiMedian, 'f', 1),
+                                                     locale.toString(stats.bmiP75, 'f', 1))
+                       : QString("-"),
+                QString::number(stats.evaluatedLast90Days),
+                stats.evaluatedLast90Days > 0 ? QString("%1 %").arg(qRound(stats.improvingShare * 100)) : QString("-"),
+            };
+            for (int column = 0; column < cells.size(); ++column) {
+                table->setItem(row, column, new QTableWidgetItem(cells.at(column)));
+            }
+        }
+        table->resizeColumnsToContents();
+    };
+    fill(initialGroups);
+
+    // Si se cambia de agrupación antes de que termine el cálculo anterior, su resultado se descarta
+    QSharedPointer<int> generation = QSharedPointer<int>::create(0);
+    connect(groupCombo, &QComboBox::currentIndexChanged, &dialog,
+            [&dialog, groupCombo, statusLabel, note, fill, generation]() {
+                const int current = ++*generation;
+                statusLabel->setText("Calculando...");
+                auto *watcher = new QFutureWatcher<QList<CohortGroupStats>>(&dialog);
+                connect(watcher, &QFutureWatcher<QList<CohortGroupStats>>::finished, &dialog,
+                        [watcher, statusLabel, note, fill, generation, current]() {
+                            const QList<CohortGroupStats> groups = watcher->result();
+                            watcher->deleteLater();
+                            if (current == *generation) {
+                                fill(groups);
+                                statusLabel->setText(note);
+                            }
+                        });
+                watcher->setFuture(computeCohorts(CohortAnalytics::GroupBy(groupCombo->currentData().toInt())));
+            });
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addWidget(buttons);
+    dialog.exec();
+}
+
+// Pacientes cuya masa magra bajó entre dos mediciones seguidas del periodo (posible pérdida de
+// músculo en una dieta hipocalórica). La consulta se hace en segundo plano con su propia conexión.
+void MainWindow::showLeanMassDrops()
+{
+    QDialog optionsDialog(this);
+    optionsDialog.setWindowTitle("Bajadas de masa magra");
+    QFormLayout *form = new QFormLayout(&optionsDialog);
+    QDateEdit *sinceEdit = new QDateEdit(QDate::currentDate().addDays(-90), &optionsDialog);
+    sinceEdit->setCalendarPopup(true);
+    form->addRow("Mediciones desde:", sinceEdit);
+    QDoubleSpinBox *minDropSpin = new QDoubleSpinBox(&optionsDialog);
+    minDropSpin->setRange(0.1, 50.0);
+    minDropSpin->setDecimals(1);
+    minDropSpin->setSingleStep(0.5);
+    minDropSpin->setValue(1.0);
+    minDropSpin->setSuffix(" kg");
+    form->addRow("Bajada mínima:", minDropSpin);
+    form->addRow(new QLabel("Solo cuentan las mediciones con % de grasa.", &optionsDialog));
+    QDialogButtonBox *optionButtons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &optionsDialog);
+    connect(optionButtons, &QDialogButtonBox::accepted, &optionsDialog, &QDialog::accept);
+    connect(optionButtons, &QDialogButtonBox::rejected, &optionsDialog, &QDialog::reject);
+    form->addRow(optionButtons);
+    if (optionsDialog.exec() != QDialog::Accepted) {
+        return;
+    }
+    const QDate since = sinceEdit->date();
+    const double minDropKg = minDropSpin->value();
+
+    QProgressDialog *progressDialog = new QProgressDialog("Buscando bajadas de masa magra...", "Cancelar", 0, 0, this);
+    progressDialog->setWindowTitle("Bajadas de masa magra");
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+    progressDialog->setValue(0);
+
+    auto *watcher = new QFutureWatcher<QList<LeanMassDrop>>(this);
+    connect(watcher, &QFutureWatcher<QList<LeanMassDrop>>::finished, this, [this, watcher, progressDialog, since]() {
+        const QList<LeanMassDrop> drops = watcher->result();
+        const bool cancelled = progressDialog->wasCanceled();
+        watcher->deleteLater();
+        progressDialog->deleteLater();
+        if (cancelled) {
+            return; // La consulta no se puede interrumpir: solo se descarta el resultado
+        }
+        if (drops.isEmpty()) {
+            QMessageBox::information(this, "Bajadas de masa magra",
+                                     QString("No hay bajadas de masa magra desde el %1.").arg(since.toString("dd/MM/yyyy")));
+            return;
+        }
+
+        QHash<int, QString> names;
+        for (const UserSnapshot::Entry& entry : std::as_const(m_userEntries)) {
+            names.insert(entry.id, QString("%1 %2 %3").arg(entry.firstName, entry.lastName1, entry.lastName2).simplified());
+        }
+        QDialog dialog(this);
+        dialog.setWindowTitle(QString("Bajadas de masa magra desde el %1 (%2)").arg(since.toString("dd/MM/yyyy")).arg(drops.size()));
+        dialog.resize(800, 450);
+        QVBoxLayout *layout = new QVBoxLayout(&dialog);
+        QTableWidget *table = new QTableWidget(int(drops.size()), 5, &dialog);
+        table->setHorizontalHeaderLabels({ "Fecha", "Paciente", "Masa magra anterior (kg)", "Masa magra (kg)", "Bajada (kg)" });
+        table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        table->setSelectionMode(QAbstractItemView::SingleSelection);
+        table->verticalHeader()->setVisible(false);
+        table->horizontalHeader()->setStretchLastSection(true);
+        const QLocale locale;
+        for (int row = 0; row < drops.size(); ++row) {
+            const LeanMassDrop& drop = drops.at(row);
+            QTableWidgetItem *dateItem = new QTableWidgetItem(drop.date.toString("dd/MM/yyyy"));
+            dateItem->setData(Qt::UserRole, drop.userId);
+            table->setItem(row, 0, dateItem);
+            table->setItem(row, 1, new QTableWidgetItem(QString("%1 (ID %2)").arg(names.value(drop.userId)).arg(drop.userId)));
+            table->setItem(row, 2, new QTableWidgetItem(locale.toString(drop.previousLeanMassKg, 'f', 1)));
+            table->setItem(row, 3, new QTableWidgetItem(locale.toString(drop.leanMassKg, 'f', 1)));
+            table->setItem(row, 4, new QTableWidgetItem(locale.toString(drop.previousLeanMassKg - drop.leanMassKg, 'f', 1)));
+        }
+        table->resizeColumnsToContents();
+        connect(table, &QTableWidget::cellDoubleClicked, &dialog, [this, table](int row, int) {
+            openPatientDetails(table->item(row, 0)->data(Qt::UserRole).toInt());
+        });
+        layout->addWidget(table);
+        layout->addWidget(new QLabel("Doble clic para abrir la ficha del paciente.", &dialog));
+        QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+        connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+        layout->addWidget(buttons);
+        dialog.exec();
+    });
+    watcher->setFuture(QtConcurrent::run([minDropKg, since]() {
+        return withWorkerConnection<QList<LeanMassDrop>>("lean_mass_drops", [minDropKg, since](const QSqlDatabase& db) {
+            return HealthMetricManager().findLeanMassDrops(minDropKg, since, db);
+        });
+    }));
+}
+
+// Búsqueda en las notas de las mediciones de todos los pacientes (HealthMetricManager::searchNotes).
+// Cada búsqueda se lanza en segundo plano; si llega el resultado de una anterior a la última se descarta.
+void MainWindow::searchNotes()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("Buscar en las notas");
+    dialog.resize(900, 500);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    QHBoxLayout *searchLayout = new QHBoxLayout;
+    QLineEdit *searchEdit = new QLineEdit(&dialog);
+    searchEdit->setPlaceholderText("Palabras de la nota (sin distinguir tildes ni mayúsculas)");
+    searchEdit->setClearButtonEnabled(true);
+    QPushButton *searchButton = new QPushButton("Buscar", &dialog);
+    searchButton->setDefault(true);
+    searchLayout->addWidget(searchEdit);
+    searchLayout->addWidget(searchButton);
+    layout->addLayout(searchLayout);
+
+    QTableWidget *table = new QTableWidget(0, 3, &dialog);
+    table->setHorizontalHeaderLabels({ "Fecha", "Paciente", "Nota" });
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setSelectionMode(QAbstractItemView::SingleSelection);
+    table->verticalHeader()->setVisible(false);
+    table->horizontalHeader()->setStretchLastSection(true);
+    layout->addWidget(table);
+    QLabel *statusLabel = new QLabel("Doble clic en un resultado para abrir la ficha del paciente.", &dialog);
+    layout->addWidget(statusLabel);
+
+    QHash<int, QString> names;
+    for (const UserSnapshot::Entry& entry : std::as_const(m_userEntries)) {
+        names.insert(entry.id, QString("%1 %2 %3").arg(entry.firstName, entry.lastName1, entry.lastName2).simplified());
+    }
+
+    static const int kNoteSearchLimit = 200;
+    QSharedPointer<int> generation = QSharedPointer<int>::create(0);
+    auto search = [&dialog, searchEdit, table, statusLabel, names, generation]() {
+        const QString text = searchEdit->text().trimmed();
+        if (text.isEmpty()) {
+            return;
+        }
+        const int current = ++*generation;
+        statusLabel->setText("Buscando...");
+        // El observador cuelga del diálogo: si se cierra antes de terminar, el resultado se pierde
+        auto *watcher = new QFutureWatcher<QList<NoteSearchResult>>(&dialog);
+        connect(watcher, &QFutureWatcher<QList<NoteSearchResult>>::finished, &dialog,
+                [watcher, table, statusLabel, names, generation, current]() {
+                    const QList<NoteSearchResult> results = watcher->result();
+                    watcher->deleteLater();
+                    if (current != *generation) {
+                        return; // Hay una búsqueda más reciente en curso
+                    }
+                    table->setRowCount(int(results.size()));
+                    for (int row = 0; row < results.size(); ++row) {
+                        const NoteSearchResult& result = results.at(row);
+                        QTableWidgetItem *dateItem = new QTableWidgetItem(result.date.toString("dd/MM/yyyy"));
+                        dateItem->setData(Qt::UserRole, result.userId);
+                        table->setItem(row, 0, dateItem);
+                        table->setItem(row, 1, new QTableWidgetItem(QString("%1 (ID %2)")
+                                                                        .arg(names.value(result.userId))
+                                                                        .arg(result.userId)));
+                        table->setItem(row, 2, new QTableWidgetItem(result.snippet));
+                    }
+                    table->resizeColumnsToContents();
+                    statusLabel->setText(results.isEmpty()
+                                             ? QString("Sin resultados.")
+                                             : QString("%1 resultados%2. Doble clic para abrir la ficha del paciente.")
+                                                   .arg(results.size())
+                                                   .arg(results.size() >= kNoteSearchLimit ? " (los más relevantes)" : ""));
+                });
+        watcher->setFuture(QtConcurrent::run([text]() {
+            return withWorkerConnection<QList<NoteSearchResult>>("note_search", [&text](const QSqlDatabase& db) {
+                return HealthMetricManager().searchNotes(text, kNoteSearchLimit, db);
+            });
+        }));
+    };
+    // Intro en el campo de búsqueda pulsa el botón por defecto
+    connect(searchButton, &QPushButton::clicked, &dialog, search);
+    connect(table, &QTableWidget::cellDoubleClicked, &dialog, [this, table](int row, int) {
+        openPatientDetails(table->item(row, 0)->data(Qt::UserRole).toInt());
+    });
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addWidget(buttons);
+    dialog.exec();
+}
+
+// Configura los desplegables de filtrado por facetas.
+// Cada opción guarda en Qt::UserRole la lista de valores que selecciona (vacía = todos)
+// y en Qt::UserRole + 1 su etiqueta sin el recuento.
+void MainWindow::setupFacetFilters()
+{
+    auto addOption = [](QComboBox* combo, const QString& label, const QStringList& values) {
+        combo->addItem(label, values);
+        combo->setItemData(combo->count() - 1, label, Qt::UserRole + 1);
+    };
+    auto fillFromCombo = [&addOption](QComboBox* target, const QComboBox* source, const QString& allLabel) {
+        addOption(target, allLabel, QStringList());
+        for (int i = 0; i < source->count(); ++i) {
+            addOption(target, source->itemText(i), QStringList{ source->itemText(i) });
+        }
+    };
+
+    fillFromCombo(ui->comboBox_facetGender, ui->comboBox_gender, "Género: todos");
+    fillFromCombo(ui->comboBox_facetActivity, ui->comboBox_activityLevel, "Actividad: todas");
+    fillFromCombo(ui->comboBox_facetGoal, ui->comboBox_goal, "Objetivo: todos");
+
+    addOption(ui->comboBox_facetAge, "Edad: todas", QStringList());
+    for (const QString& band : PatientFacetIndex::ageBands()) {
+        addOption(ui->comboBox_facetAge, band + " años", QStringList{ band });
+    }
+
+    addOption(ui->comboBox_facetBmi, "IMC: todos", QStringList());
+    addOption(ui->comboBox_facetBmi, "IMC ≥ 30", QStringList{ "Obesidad I", "Obesidad II", "Obesidad III" });
+    for (const QString& band : PatientFacetIndex::bmiBands()) {
+        addOption(ui->comboBox_facetBmi, band, QStringList{ band });
+    }
+
+    for (int facet = 0; facet < PatientFacetIndex::FacetCount; ++facet) {
+        connect(facetCombo(PatientFacetIndex::Facet(facet)), &QComboBox::currentIndexChanged,
+                this, &MainWindow::onFacetFilterChanged);
+    }
+}
+
+QComboBox* MainWindow::facetCombo(PatientFacetIndex::Facet facet) const
+{
+    switch (facet) {
+    case PatientFacetIndex::Gender: return ui->comboBox_facetGender;
+    case PatientFacetIndex::ActivityLevel: return ui->comboBox_facetActivity;
+    case PatientFacetIndex::Goal: return ui->comboBox_facetGoal;
+    case PatientFacetIndex::AgeBand: return ui->comboBox_facetAge;
+    case PatientFacetIndex::BmiBand: return ui->comboBox_facetBmi;
+    default: return nullptr;
+    }
+}
+
+PatientFacetIndex::Selection MainWindow::currentFacetSelection() const
+{
+    PatientFacetIndex::Selection selection;
+    for (int facet = 0; facet < PatientFacetIndex::FacetCount; ++facet) {
+        const QStringList values = facetCombo(PatientFacetIndex::Facet(facet))->currentData().toStringList();
+        if (!values.isEmpty()) {
+            selection.insert(PatientFacetIndex::Facet(facet), values);
+        }
+    }
+    return selection;
+}
+
+// Construye el índice de facetas la primera vez que hace falta (necesita los datos completos
+// de los pacientes y su último IMC, que la lista principal no carga).
+void MainWindow::ensureFacetIndex()
+{
+    if (m_facetIndex.isLoaded()) {
+        m_facetIndex.refreshAgeBands(QDate::currentDate());
+        return;
+    }
+    m_facetIndex.rebuild(m_userManager.getAllUsers(), m_healthMetricManager.getLatestBmiForAllUsers());
+}
+
+// Actualiza el recuento que aparece junto a cada opción.
+// El recuento de una faceta se calcula con el resto de filtros aplicados (sin el suyo propio).
+void MainWindow::updateFacetCounts()
+{
+    if (!m_facetIndex.isLoaded()) {
+        return;
+    }
+    const PatientFacetIndex::Selection selection = currentFacetSelection();
+    for (int f = 0; f < PatientFacetIndex::FacetCount; ++f) {
+        const PatientFacetIndex::Facet facet = PatientFacetIndex::Facet(f);
+        PatientFacetIndex::Selection others = selection;
+        others.remove(facet);
+        const RoaringBitmap within = m_facetIndex.match(others);
+        const QMap<QString, quint64> counts = m_facetIndex.counts(facet, within);
+
+        QComboBox* combo = facetCombo(facet);
+        for (int i = 0; i < combo->count(); ++i) {
+            const QStringList values = combo->itemData(i).toStringList();
+            quint64 total = 0;
+            if (values.isEmpty()) {
+                total = within.cardinality();
+            } else {
+                for (const QString& value : values) {
+                    total += counts.value(value, 0);
+                }
+            }
+            combo->setItemText(i, QString("%1 (%2)").arg(combo->itemData(i, Qt::UserRole + 1).toString())
+                                      .arg(total));
+        }
+    }
+}
+
+void MainWindow::onFacetFilterChanged()
+{
+    ensureFacetIndex();
+    updateFacetCounts();
+    loadUsersIntoTable(ui->lineEdit_searchUser->text());
+}
+
+void MainWindow::setupUsertable()
+{
+    m_userTableModel = new UserTableModel(this); // Columnas: ID, Nombre, Apellido 1, Apellido 2
+    ui->tableView_users->setModel(m_userTableModel);
+    ui->tableView_users->verticalHeader()->setVisible(false);
+    ui->tableView_users->horizontalHeader()->setStretchLastSection(true); // Estirar la última columna
+    ui->tableView_users->setEditTriggers(QAbstractItemView::NoEditTriggers); // No editable directamente
+    ui->tableView_users->setSelectionBehavior(QAbstractItemView::SelectRows); // Seleccionar filas completas
+    ui->tableView_users->setSelectionMode(QAbstractItemView::ExtendedSelection); // Varias filas para comparar pacientes
+
+}
+
+void MainWindow::loadUsers()
+{
+    // Leemos el contador antes de la consulta: si alguien escribe entre medias,
+    // la instantánea quedará marcada como antigua y se recargará en el próximo arranque.
+    const qint64 changeCounter = m_userManager.usersChangeCounter();
+
+    // Obtiene la lista completa de usuarios desde el UserManager (una sola consulta).
+    applyUsers(m_userManager.getAllUsers(), changeCounter);
+}
+
+void MainWindow::applyUsers(const QList<QSharedPointer<User>>& users, qint64 changeCounter)
+{
+    m_usersChangeCounter = changeCounter;
+    m_userEntries.clear();
+    m_userEntries.reserve(users.count());
+    for (const QSharedPointer<User>& user : users) {
+        if (user) { // Asegura que el puntero no sea nulo.
+            m_userEntries.append(UserSnapshot::entryFromUser(*user));
+        }
+    }
+    m_searchIndex.rebuild(m_userEntries);
+    if (m_facetIndex.isLoaded()) {
+        m_facetIndex.rebuild(users, m_healthMetricManager.getLatestBmiForAllUsers());
+        updateFacetCounts();
+    }
+
+    // Repinta la tabla respetando el filtro que haya escrito el usuario
+    loadUsersIntoTable(ui->lineEdit_searchUser->text());
+    qDebug() << "Usuarios cargados desde la base de datos. Total:" << m_userEntries.count();
+}
+
+void MainWindow::showUserSnapshot(const UserSnapshot& snapshot)
+{
+    if (!snapshot.isValid()) {
+        return;
+    }
+    m_userEntries = snapshot.entries();
+    m_searchIndex.rebuild(m_userEntries);
+    loadUsersIntoTable("");
+    qDebug() << "Lista de pacientes pintada desde la instantánea. Total:" << m_userEntries.count();
+}
+
+// El contador y, si hace falta, la lista completa se leen en un hilo del pool con su propia conexión;
+// mientras tanto la ventana responde con la lista de la instantánea.
+void MainWindow::reconcileUsers(qint64 snapshotCounter)
+{
+    auto *watcher = new QFutureWatcher<UserReconciliation>(this);
+    connect(watcher, &QFutureWatcher<UserReconciliation>::finished, this, [this, watcher, snapshotCounter]() {
+        const UserReconciliation result = watcher->result();
+        watcher->deleteLater();
+        if (result.changeCounter < 0) {
+            return; // Ya se registró el error; la lista sigue siendo la de la instantánea
+        }
+        if (m_usersChangeCounter > result.changeCounter) {
+            // Hubo altas o cambios desde esta ventana mientras se leía: la lectura ya es antigua
+            reconcileUsers(-1);
+            return;
+        }
+        if (!result.reloaded) {
+            // La instantánea coincide con la base de datos: no hace falta volver a consultar
+            m_usersChangeCounter = result.changeCounter;
+            qInfo() << "Instantánea de pacientes vigente (contador" << result.changeCounter << "), no se recarga.";
+            return;
+        }
+        qInfo() << "Instantánea de pacientes desactualizada (" << snapshotCounter << "vs" << result.changeCounter
+                << "), recargada.";
+        applyUsers(result.users, result.changeCounter);
+    });
+    watcher->setFuture(QtConcurrent::run([snapshotCounter]() {
+        static QAtomicInteger<quint64> counter;
+        const QString connectionName = QString("reconcile_users_%1").arg(counter.fetchAndAddRelaxed(1));
+        UserReconciliation result;
+        {
+            QSqlDatabase db = QSqlDatabase::cloneDatabase(QString(QSqlDatabase::defaultConnection), connectionName);
+            if (db.open()) {
+                UserManager userManager;
+                result.changeCounter = userManager.usersChangeCounter(db);
+                if (result.changeCounter >= 0 && (snapshotCounter < 0 || result.changeCounter != snapshotCounter)) {
+                    // Contador antes que la lista: una escritura intermedia deja la instantánea como antigua
+                    result.users = userManager.getAllUsers(db);
+                    result.reloaded = true;
+                }
+            } else {
+                qWarning() << "No se pudo abrir la conexión" << connectionName << "para comprobar los pacientes:"
+                           << db.lastError().text();
+            }
+            db.close();
+        }
+        // Fuera del bloque: no queda ninguna QSqlDatabase ni QSqlQuery que use la conexión
+        QSqlDatabase::removeDatabase(connectionName);
+        return result;
+    }));
 }
 
 // Slot que se activa cuando se hace clic en el botón "Añadir Usuario"
@@ -133,13 +1933,8 @@ void MainWindow::on_pushButton_addUser_clicked()
     // Usamos el constructor para NUEVOS usuarios (sin ID, sin created_at, la DB los generará)
     User newUser(firstName, lastName1, lastName2, gender, birthDate, activityLevel, goal);
 
-    // 4. Intentar añadir el usuario a la base de datos usando UserManager
-    if (userManager->addUser(newUser)) {
-        // Éxito: el usuario fue añadido
-        QMessageBox::information(this, "Éxito",
-                                 "Usuario '" + newUser.firstName() + " " + newUser.lastName1() + "' añadido correctamente con ID: " + QString::number(newUser.id()));
-
-        // 5. Limpiar los campos del formulario para el siguiente registro
+    // Limpia los campos del formulario para el siguiente registro
+    auto clearForm = [this]() {
         ui->lineEdit_firstName->clear();
         ui->lineEdit_lastName1->clear();
         ui->lineEdit_lastName2->clear();
@@ -148,9 +1943,40 @@ void MainWindow::on_pushButton_addUser_clicked()
         ui->dateEdit_birthDate->setDate(QDate(2000, 1, 1));
         ui->comboBox_activityLevel->setCurrentIndex(0);
         ui->comboBox_goal->setCurrentIndex(0);
+    };
 
-        // 6. Actualizar la tabla de usuarios para mostrar el nuevo usuario
-        loadUsersIntoTable("");
+    // 4. Intentar añadir el usuario. Si se parece a un paciente ya registrado, UserManager no lo
+    //    guarda y devuelve los candidatos: se registra solo si el usuario lo confirma
+    QList<PatientDeduplicator::Candidate> duplicates;
+    bool added = userManager->addUser(newUser, &duplicates);
+    if (!added && !duplicates.isEmpty()) {
+        QMessageBox box(QMessageBox::Warning, "Posible duplicado",
+                        "Este paciente puede estar registrado ya como:\n" + describeDuplicates(duplicates, false)
+                            + "\n\n¿Desea registrarlo igualmente o abrir la ficha del paciente existente?",
+                        QMessageBox::Cancel, this);
+        QPushButton *addAnywayButton = box.addButton("Registrar igualmente", QMessageBox::AcceptRole);
+        QPushButton *openExistingButton = box.addButton("Abrir la ficha existente", QMessageBox::ActionRole);
+        box.setDefaultButton(openExistingButton);
+        box.exec();
+        if (box.clickedButton() == openExistingButton) {
+            // Se usa el paciente existente (el más parecido): el alta se descarta
+            openPatientDetails(duplicates.first().duplicateOf);
+            clearForm();
+            return;
+        }
+        if (box.clickedButton() != addAnywayButton) {
+            return; // Cancelado: el formulario se conserva para corregirlo
+        }
+        added = userManager->addUser(newUser);
+    }
+
+    if (added) {
+        // Éxito: el usuario fue añadido
+        QMessageBox::information(this, "Éxito", "Usuario '" + newUser.firstName() + " " + newUser.lastName1()
+                                                    + "' añadido correctamente con ID: " + QString::number(newUser.id()));
+        // 5. Limpiar los campos del formulario para el siguiente registro
+        clearForm();
+        // 6. La tabla ya se actualizó en onUserAdded (aviso de DataChangeHub)
     } else {
         // Error: no se pudo añadir el usuario
         QMessageBox::critical(this, "Error", "No se pudo añadir el usuario a la base de datos. Revise los logs.");
@@ -160,13 +1986,13 @@ void MainWindow::on_pushButton_addUser_clicked()
 // Slot que se activa cuando se hace clic en el botón "Actualizar Lista"
 void MainWindow::on_pushButton_refreshUsers_clicked()
 {
-    loadUsersIntoTable(""); // Simplemente vuelve a llamar a la función para recargar los datos
+    loadUsers(); // Vuelve a leer los usuarios de la base de datos
 }
 
 void MainWindow::on_pushButton_deleteUser_clicked()
 {
     // 1. Obtener la fila seleccionada en la tabla
-    int currentRow = ui->tableWidget_users->currentRow();
+    int currentRow = ui->tableView_users->currentIndex().row();
 
     // Verificar si hay una fila seleccionada
     if (currentRow < 0) {
@@ -176,7 +2002,7 @@ void MainWindow::on_pushButton_deleteUser_clicked()
 
     // 2. Obtener el ID del usuario de la fila seleccionada
     // Asumimos que la columna 0 de la tabla contiene el ID del usuario
-    int userIdToDelete = ui->tableWidget_users->item(currentRow, 0)->text().toInt();
+    int userIdToDelete = m_userTableModel->userIdAt(currentRow);
 
     // 3. Pedir confirmación al usuario (¡IMPORTANTE!)
     QMessageBox::StandardButton reply;
@@ -192,8 +2018,7 @@ void MainWindow::on_pushButton_deleteUser_clicked()
     // 4. Intentar eliminar el usuario usando UserManager
     if (userManager->deleteUser(userIdToDelete)) {
         QMessageBox::information(this, "Éxito", "Usuario con ID " + QString::number(userIdToDelete) + " eliminado correctamente.");
-        // 5. Actualizar la tabla después de la eliminación
-        loadUsersIntoTable("");
+        // 5. La tabla ya se actualizó en onUserDeleted (aviso de DataChangeHub)
     } else {
         QMessageBox::critical(this, "Error", "No se pudo eliminar el usuario. Revise los logs.");
     }
@@ -201,19 +2026,118 @@ void MainWindow::on_pushButton_deleteUser_clicked()
 
 void MainWindow::on_lineEdit_searchUser_textChanged(const QString &filter)
 {
-    loadUsersIntoTable(filter);
+    Q_UNUSED(filter);
+    m_searchTimer->start(); // Reinicia el retardo; la búsqueda anterior pendiente se descarta
 }
 
-void MainWindow::on_tableWidget_users_doubleClicked(const QModelIndex &index)
+void MainWindow::applySearchFilter()
+{
+    loadUsersIntoTable(ui->lineEdit_searchUser->text());
+}
+
+void MainWindow::onUserAdded(int userId)
+{
+    QSharedPointer<User> user = m_userManager.getUserById(userId);
+    if (!user) {
+        return;
+    }
+    UserSnapshot::Entry entry = UserSnapshot::entryFromUser(*user);
+    insertUserEntry(entry);
+    m_searchIndex.addUser(entry);
+    if (m_facetIndex.isLoaded()) {
+        m_facetIndex.setUser(*user);
+        updateFacetCounts();
+    }
+    m_usersChangeCounter = m_userManager.usersChangeCounter();
+    loadUsersIntoTable(ui->lineEdit_searchUser->text());
+}
+
+void MainWindow::onUserUpdated(int userId)
+{
+    QSharedPointer<User> user = m_userManager.getUserById(userId);
+    if (!user) {
+        return;
+    }
+    UserSnapshot::Entry entry = UserSnapshot::entryFromUser(*user);
+    removeUserEntry(userId); // Puede cambiar de posición si cambia el nombre
+    insertUserEntry(entry);
+    m_searchIndex.updateUser(entry);
+    if (m_facetIndex.isLoaded()) {
+        m_facetIndex.setUser(*user);
+        updateFacetCounts();
+    }
+    m_usersChangeCounter = m_userManager.usersChangeCounter();
+    loadUsersIntoTable(ui->lineEdit_searchUser->text());
+}
+
+void MainWindow::onUserDeleted(int userId)
+{
+    removeUserEntry(userId);
+    m_searchIndex.removeUser(userId);
+    if (m_facetIndex.isLoaded()) {
+        m_facetIndex.removeUser(userId);
+        updateFacetCounts();
+    }
+    m_usersChangeCounter = m_userManager.usersChangeCounter();
+    loadUsersIntoTable(ui->lineEdit_searchUser->text());
+}
+
+void MainWindow::onHealthMetricChanged(int userId, int metricId)
+{
+    Q_UNUSED(metricId);
+    if (!m_facetIndex.isLoaded() || userId <= 0) {
+        return;
+    }
+    // Solo importa la última medición del paciente
+    HealthMetric latest = m_healthMetricManager.getLatestHealthMetric(userId);
+    m_facetIndex.setLatestBmi(userId, latest.id() > 0 ? latest.bmi() : 0.0);
+    updateFacetCounts();
+    if (!currentFacetSelection().isEmpty()) {
+        loadUsersIntoTable(ui->lineEdit_searchUser->text());
+    }
+}
+
+// Miles de pacientes nuevos: una consulta completa (lista, búsqueda y facetas) en lugar de insertar uno a uno
+void MainWindow::onBulkImportCompleted(const QList<int>& userIds)
+{
+    Q_UNUSED(userIds);
+    loadUsers();
+}
+
+// Inserta la fila en su posición según la clave de ordenación (la lista ya está ordenada)
+void MainWindow::insertUserEntry(const UserSnapshot::Entry& entry)
+{
+    auto pos = std::lower_bound(m_userEntries.begin(), m_userEntries.end(), entry,
+                                [](const UserSnapshot::Entry& a, const UserSnapshot::Entry& b) {
+                                    if (a.sortKey != b.sortKey) {
+                                        return a.sortKey < b.sortKey;
+                                    }
+                                    return a.id < b.id;
+                                });
+    m_userEntries.insert(pos, entry);
+}
+
+void MainWindow::removeUserEntry(int userId)
+{
+    auto pos = std::find_if(m_userEntries.begin(), m_userEntries.end(),
+                            [userId](const UserSnapshot::Entry& e) { return e.id == userId; });
+    if (pos != m_userEntries.end()) {
+        m_userEntries.erase(pos);
+    }
+}
+
+void MainWindow::on_tableView_users_doubleClicked(const QModelIndex &index)
 {
     if (!index.isValid()) {
         return; // Índice no válido
     }
 
-    // Obtener el ID del usuario de la celda de la columna 0 (donde guardamos el ID)
-    // Usamos item->data(Qt::UserRole) porque lo guardamos allí.
-    int userId = ui->tableWidget_users->item(index.row(), 0)->data(Qt::UserRole).toInt();
+    // Obtener el ID del usuario de la fila (el modelo lo devuelve también con Qt::UserRole)
+    openPatientDetails(m_userTableModel->userIdAt(index.row()));
+}
 
+void MainWindow::openPatientDetails(int userId)
+{
     QSharedPointer<User> selectedUser = m_userManager.getUserById(userId);
 
     if (selectedUser) {
@@ -224,48 +2148,50 @@ void MainWindow::on_tableWidget_users_doubleClicked(const QModelIndex &index)
         qDebug() << "Abriendo ventana de detalles para el usuario ID:" << userId;
     } else {
         QMessageBox::warning(this, "Error", "No se pudo cargar la información completa del usuario seleccionado.");
-        qWarning() << "Error: No se pudo obtener el usuario con ID:" << userId << "para mostrar detalles en MainWindow::on_tableWidget_users_doubleClicked.";
+        qWarning() << "Error: No se pudo obtener el usuario con ID:" << userId << "para mostrar detalles en MainWindow::openPatientDetails.";
     }
 }
 
-// Función auxiliar para cargar usuarios desde la base de datos y mostrarlos en QTableWidget
+// Función auxiliar para mostrar en la tabla la lista de usuarios en memoria (filtrada si aplica)
 void MainWindow::loadUsersIntoTable( const QString &filter) {
-    ui->tableWidget_users->setRowCount(0);
-
-    QList<QSharedPointer<User>> users = m_userManager.getAllUsers();
-    QList<QSharedPointer<User>> filteredUsers; // Lista para usuarios filtrados
-
-    // Aplicar el filtro si no está vacío
-    if (!filter.isEmpty()) {
-        QString lowerFilter = filter.toLower(); // Para búsqueda sin distinción de mayúsculas/minúsculas
-        for (QSharedPointer<User> user : users) {
-            if (user->firstName().toLower().contains(lowerFilter) ||
-                user->lastName1().toLower().contains(lowerFilter) ||
-                user->lastName2().toLower().contains(lowerFilter) ||
-                QString::number(user->id()).contains(lowerFilter)) // También permite buscar por ID
-            {
+    QVector<UserSnapshot::Entry> filteredUsers; // Lista para usuarios filtrados
+
+    // Aplicar el filtro si no está vacío.
+    // El índice ignora acentos y mayúsculas y también permite buscar por ID.
+    if (!filter.trimmed().isEmpty()) {
+        const QSet<int> matches = m_searchIndex.search(filter);
+        filteredUsers.reserve(matches.count());
+        for (const UserSnapshot::Entry& user : std::as_const(m_userEntries)) {
+            if (matches.contains(user.id)) { // Conserva el orden de la lista
                 filteredUsers.append(user);
             }
         }
     } else {
-        filteredUsers = users; // Si no hay filtro, mostrar todos
+        filteredUsers = m_userEntries; // Si no hay filtro, mostrar todos
     }
 
+    // Filtros por facetas: intersección de bitmaps, se comprueba cada fila en O(1)
+    const PatientFacetIndex::Selection facetSelection = currentFacetSelection();
+    if (!facetSelection.isEmpty() && m_facetIndex.isLoaded()) {
+        const RoaringBitmap facetMatches = m_facetIndex.match(facetSelection);
+        QVector<UserSnapshot::Entry> facetFiltered;
+        facetFiltered.reserve(qsizetype(facetMatches.cardinality()));
+        for (const UserSnapshot::Entry& user : std::as_const(filteredUsers)) {
+            if (facetMatches.contains(quint32(user.id))) {
+                facetFiltered.append(user);
+            }
+        }
+        filteredUsers.swap(facetFiltered);
+    }
+    ui->label_facetCount->setText(QString("%1 pacientes").arg(filteredUsers.count()));
 
-    ui->tableWidget_users->setRowCount(filteredUsers.count());
-
-    for (int i = 0; i < filteredUsers.count(); ++i) {
-        QSharedPointer<User> user = filteredUsers.at(i);
-        if (user) {
-            QTableWidgetItem *idItem = new QTableWidgetItem(QString::number(user->id()));
-            idItem->setData(Qt::UserRole, user->id());
-            ui->tableWidget_users->setItem(i, 0, idItem);
 
-            ui->tableWidget_users->setItem(i, 1, new QTableWidgetItem(user->firstName()));
-            ui->tableWidget_users->setItem(i, 2, new QTableWidgetItem(user->lastName1()));
-            ui->tableWidget_users->setItem(i, 3, new QTableWidgetItem(user->lastName2()));
-        }
+    // La vista solo pide al modelo las filas visibles: no se crea nada por paciente
+    m_userTableModel->setEntries(filteredUsers);
+    if (!m_userColumnsSized && !filteredUsers.isEmpty()) {
+        // Una vez, con la lista completa: en cada búsqueda recorrería todas las filas
+        ui->tableView_users->resizeColumnsToContents();
+        m_userColumnsSized = true;
     }
-    ui->tableWidget_users->resizeColumnsToContents();
     qDebug() << "Usuarios cargados en la tabla (filtrados si aplica). Total:" << filteredUsers.count();
 }
@@ -7,9 +7,17 @@
 #include <QTableWidget>
 #include <QTableWidgetItem>
 #include <QModelIndex>
+#include <QTimer>
+#include <QComboBox>
 #include "usermanager.h" // Incluimos UserManager
 #include "user.h"        // Incluimos User
 #include "patientdetailswindow.h"
+#include "usersnapshot.h"
+#include "usertablemodel.h"
+#include "usersearchindex.h"
+#include "patientfacetindex.h"
+#include "healthmetricmanager.h"
+#include "cohortanalytics.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -23,6 +31,15 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    // Pinta la lista de pacientes desde la instantánea de arranque (sin tocar la base de datos)
+    void showUserSnapshot(const UserSnapshot& snapshot);
+    // Compara el contador de cambios de la DB con el de la instantánea y recarga solo si difieren.
+    // Asíncrono: la comprobación y la recarga se leen en segundo plano.
+    void reconcileUsers(qint64 snapshotCounter);
+    // Estado actual de la lista, usado para escribir la instantánea al salir
+    QVector<UserSnapshot::Entry> userEntries() const { return m_userEntries; }
+    qint64 usersChangeCounter() const { return m_usersChangeCounter; }
+
 private slots:
     // Slot que se conectará al clic del botón "Añadir Usuario"
     void on_pushButton_addUser_clicked();
@@ -33,7 +50,31 @@ private slots:
     void on_lineEdit_searchUser_textChanged(const QString &filter);
 
 
-    void on_tableWidget_users_doubleClicked(const QModelIndex &index);
+    void on_tableView_users_doubleClicked(const QModelIndex &index);
+
+    // Mantenimiento incremental de la lista y del índice de búsqueda (DataChangeHub)
+    void onUserAdded(int userId);
+    void onUserUpdated(int userId);
+    void onUserDeleted(int userId);
+    void onHealthMetricChanged(int userId, int metricId);
+    // Importación masiva terminada: la lista se recarga de una vez
+    void onBulkImportCompleted(const QList<int>& userIds);
+    // Cambio en alguno de los filtros por facetas (género, actividad, objetivo, edad, IMC)
+    void onFacetFilterChanged();
+    // Se ejecuta cuando el temporizador de búsqueda vence (búsqueda con retardo)
+    void applySearchFilter();
+    // Menú Herramientas > Revisar mediciones: busca valores improbables en todas las métricas
+    void reviewAllMetrics();
+    // Menú Herramientas > Cola de revisión: lista los avisos pendientes y permite marcarlos como revisados
+    void showReviewQueue();
+    // Menú Herramientas > Comparar pacientes: superpone las curvas de los pacientes seleccionados
+    void compareSelectedPatients();
+    // Menú Herramientas > Análisis de cohortes: evolución agregada por objetivo, actividad o género
+    void showCohortAnalytics();
+    // Menú Herramientas > Bajadas de masa magra: mediciones con pérdida de masa magra desde una fecha
+    void showLeanMassDrops();
+    // Menú Herramientas > Buscar en las notas: texto libre en las notas de las mediciones de todos los pacientes
+    void searchNotes();
 
 private:
     QScopedPointer<Ui::MainWindow> ui;
@@ -46,6 +87,54 @@ private:
     UserManager m_userManager;
     void setupUsertable();
     void loadUsers();
+    // Sustituye la lista de pacientes (índices de búsqueda y facetas incluidos) y repinta la tabla
+    void applyUsers(const QList<QSharedPointer<User>>& users, qint64 changeCounter);
+
+    // Lista de pacientes en memoria (ya ordenada); el filtro de búsqueda trabaja sobre ella
+    QVector<UserSnapshot::Entry> m_userEntries;
+    UserTableModel *m_userTableModel; // Filas visibles de la tabla (tras búsqueda y facetas)
+    bool m_userColumnsSized;          // Anchos ajustados una vez: recalcularlos recorre todas las filas
+    qint64 m_usersChangeCounter;
+
+    // Índice de búsqueda por nombre/apellidos/ID y temporizador para agrupar pulsaciones
+    UserSearchIndex m_searchIndex;
+    QTimer *m_searchTimer;
+    void insertUserEntry(const UserSnapshot::Entry& entry);
+    void removeUserEntry(int userId);
+
+    // Filtros por facetas. El índice se construye la primera vez que se usa un filtro.
+    PatientFacetIndex m_facetIndex;
+    HealthMetricManager m_healthMetricManager;
+    void setupFacetFilters();
+    void setupMenus();
+    // Importa una tabla de composición (CSV nacional o USDA) al catálogo de alimentos, en un hilo
+    // de trabajo con progreso y cancelación; el catálogo se sustituye al terminar
+    void importFoodCatalog(bool usda);
+    // Agenda de citas: vistas de día, semana y mes; reserva para el paciente seleccionado (AppointmentScheduler)
+    void showAgenda();
+    // Recetas y planes de dieta del paciente seleccionado, con sus totales por nutriente (RecipeGraph)
+    void editRecipes();
+    // Planes semanales de todos los pacientes para la semana siguiente (MealPlanOptimizer)
+    void generateMealPlans();
+    // Informes mensuales en PDF de todos los pacientes (ProgressReportEngine)
+    void generateProgressReports();
+    // Extractos de pacientes y mediciones en CSV, JSON Lines o Arrow (DataExporter)
+    void exportData();
+    // Alta masiva de pacientes y mediciones de otra clínica desde CSV (BulkImporter)
+    void importPatients();
+    // Diálogo del análisis de cohortes con el resultado del primer cálculo
+    void showCohortDialog(const QList<CohortGroupStats>& initialGroups);
+    // Abre la ficha del paciente (lista principal y listados de las herramientas)
+    void openPatientDetails(int userId);
+    // IDs de los pacientes seleccionados en la tabla
+    QList<int> selectedUserIds() const;
+    // Posibles duplicados de todo el registro (PatientDeduplicator)
+    void findDuplicatePatients();
+    QString describeDuplicates(const QList<PatientDeduplicator::Candidate>& candidates, bool pairs);
+    void ensureFacetIndex();
+    QComboBox* facetCombo(PatientFacetIndex::Facet facet) const;
+    PatientFacetIndex::Selection currentFacetSelection() const;
+    void updateFacetCounts();
 
 };
 
@@ -0,0 +1,778 @@
+#include "mealplanoptimizer.h"
+#include "datachangehub.h"
+#include "energycalculator.h"
+#include "foodcatalog.h"
+#include "healthmetricmanager.h"
+#include "lpsolver.h"
+#include "recipegraph.h"
+#include "textnormalizer.h"
+#include "usermanager.h"
+#include <QAtomicInteger>
+#include <QDateTime>
+#include <QDebug>
+#include <QHash>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QSharedPointer>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int kNightlyHour = 2;                  // Fuera del horario de consulta
+const int kNightlyRetryMs = 15 * 60 * 1000; // Si a esa hora ya hay una generación en curso
+const int kDaysPerWeek = 7;
+
+// Pesos del objetivo, sobre desviaciones relativas al objetivo (1.0 = 100 % de desviación)
+const double kEnergyWeight = 4.0;
+const double kMacroWeight = 1.0;
+const double kMicronutrientPenalty = 5.0; // Mínimos y máximos: casi restricciones duras
+const double kRepeatPenalty = 0.05;       // Por alimento ya usado otro día de la semana
+
+// Un alimento o una receta que puede entrar en los planes
+struct Candidate {
+    QString foodCode;
+    int recipeId = -1;
+    QString name;
+    QString haystack; // Nombre y nombres de ingredientes, normalizados para las exclusiones
+    double per100g[FoodDiary::NutrientCount] = {};
+    double pricePerKg = 0.0;
+};
+
+using CandidatePool = QSharedPointer<const QVector<Candidate>>;
+
+// Lo que necesita un hilo para resolver un día: todo por valor o compartido de solo lectura
+struct DayTask {
+    int userId = -1;
+    int dayIndex = 0;
+    QVector<int> candidates; // Índices en el conjunto
+    FoodDiary::Targets targets;
+};
+
+bool isTracked(FoodDiary::Nutrient nutrient)
+{
+    return nutrient == FoodDiary::EnergyKcal || nutrient == FoodDiary::ProteinG
+           || nutrient == FoodDiary::CarbohydrateG || nutrient == FoodDiary::FatG;
+}
+
+qint64 readMeta(const QString& name, qint64 fallback)
+{
+    QSqlQuery query;
+    query.prepare("SELECT value FROM app_meta WHERE name = :name");
+    query.bindValue(":name", name);
+    if (!query.exec() || !query.next()) {
+        return fallback;
+    }
+    return query.value(0).toLongLong();
+}
+
+bool writeMeta(const QString& name, qint64 value)
+{
+    QSqlQuery query;
+    query.prepare("REPLACE INTO app_meta (name, value) VALUES (:name, :value)");
+    query.bindValue(":name", name);
+    query.bindValue(":value", value);
+    if (!query.exec()) {
+        qCritical() << "Error al guardar" << name << "en app_meta:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+QString priceKey(const QString& foodCode, int recipeId)
+{
+    return recipeId >= 0 ? QString("r:%1").arg(recipeId) : "f:" + foodCode;
+}
+
+// Nombres de la receta y de todos sus ingredientes, bajando por las subrecetas
+void collectNames(int recipeId, QSet<int>& visited, QStringList& names)
+{
+    if (visited.contains(recipeId)) {
+        return;
+    }
+    visited.insert(recipeId);
+    RecipeGraph *graph = RecipeGraph::instance();
+    names << graph->recipeName(recipeId);
+    const FoodCatalog *catalog = FoodCatalog::instance();
+    for (const RecipeGraph::Item& item : graph->recipeItems(recipeId)) {
+        if (item.recipeId >= 0) {
+            collectNames(item.recipeId, visited, names);
+        } else {
+            const int food = catalog->foodIndex(item.foodCode);
+            if (food >= 0) {
+                names << catalog->foodName(food);
+            }
+        }
+    }
+}
+
+// Días de una generación, con el filtro de exclusiones ya aplicado
+struct PreparedDays {
+    QVector<DayTask> tasks;
+    QList<int> users; // Pacientes con días planteados
+    int skipped = 0;
+};
+
+QStringList loadMostLoggedFoods(const QSqlDatabase& db, int limit)
+{
+    QStringList foodCodes;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT food_code, COUNT(*) AS uses FROM food_diary WHERE food_code IS NOT NULL "
+                  "GROUP BY food_code ORDER BY uses DESC LIMIT :limit");
+    query.bindValue(":limit", limit);
+    if (!query.exec()) {
+        qWarning() << "No se pudieron leer los alimentos más registrados:" << query.lastError().text();
+        return foodCodes;
+    }
+    while (query.next()) {
+        foodCodes << query.value(0).toString();
+    }
+    return foodCodes;
+}
+
+QHash<QString, double> loadPrices(const QSqlDatabase& db)
+{
+    QHash<QString, double> prices;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT item_key, price_per_kg FROM food_prices")) {
+        qWarning() << "No se pudieron leer los precios de los planes:" << query.lastError().text();
+        return prices;
+    }
+    while (query.next()) {
+        prices.insert(query.value(0).toString(), query.value(1).toDouble());
+    }
+    return prices;
+}
+
+// Recetas y alimentos más registrados con su composición. Solo en el hilo principal: el catálogo
+// y el grafo de recetas son suyos (en memoria una vez cargado el grafo); las lecturas ya están hechas.
+QVector<Candidate> buildCandidates(QStringList foodCodes, const QHash<QString, double>& prices,
+                                   const MealPlanOptimizer::Options& options)
+{
+    QVector<Candidate> candidates;
+    const FoodCatalog *catalog = FoodCatalog::instance();
+
+    RecipeGraph *graph = RecipeGraph::instance();
+    for (int recipeId : graph->recipeIds()) {
+        Candidate candidate;
+        candidate.recipeId = recipeId;
+        candidate.name = graph->recipeName(recipeId);
+        QSet<int> visited;
+        QStringList names;
+        collectNames(recipeId, visited, names);
+        candidate.haystack = TextNormalizer::fold(names.join(' '));
+        candidates.append(candidate);
+    }
+
+    // Sin historial suficiente se completa con el principio del catálogo
+    for (int food = 0; food < catalog->foodCount() && foodCodes.size() < options.mostLoggedFoods; ++food) {
+        const QString code = catalog->foodCode(food);
+        if (!foodCodes.contains(code)) {
+            foodCodes << code;
+        }
+    }
+    for (const QString& code : std::as_const(foodCodes)) {
+        const int food = catalog->foodIndex(code);
+        if (food < 0) {
+            continue;
+        }
+        Candidate candidate;
+        candidate.foodCode = code;
+        candidate.name = catalog->foodName(food);
+        candidate.haystack = TextNormalizer::fold(candidate.name);
+        candidates.append(candidate);
+    }
+
+    QVector<QPair<QString, int>> items;
+    items.reserve(candidates.size());
+    for (const Candidate& candidate : std::as_const(candidates)) {
+        items.append(qMakePair(candidate.foodCode, candidate.recipeId));
+    }
+    const QVector<FoodDiary::Composition> compositions = FoodDiary::compositionPer100g(items);
+
+    // Sin composición o sin energía (agua, infusiones) no aportan nada al modelo
+    QVector<Candidate> usable;
+    usable.reserve(candidates.size());
+    for (qsizetype i = 0; i < candidates.size(); ++i) {
+        if (!compositions[i].valid || !(compositions[i].values[FoodDiary::EnergyKcal] > 0.0)) {
+            continue;
+        }
+        Candidate candidate = candidates[i];
+        std::copy(std::begin(compositions[i].values), std::end(compositions[i].values), candidate.per100g);
+        candidate.pricePerKg = prices.value(priceKey(candidate.foodCode, candidate.recipeId), 0.0);
+        usable.append(candidate);
+    }
+    return usable;
+}
+
+QHash<int, QStringList> loadExclusions(const QSqlDatabase& db)
+{
+    QHash<int, QStringList> exclusions;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT user_id, term FROM meal_plan_exclusions")) {
+        qWarning() << "No se pudieron leer las exclusiones de los planes:" << query.lastError().text();
+        return exclusions;
+    }
+    while (query.next()) {
+        exclusions[query.value(0).toInt()].append(TextNormalizer::fold(query.value(1).toString()));
+    }
+    return exclusions;
+}
+
+// Exclusiones y subconjuntos de candidatos de cada día. Solo cálculo: se ejecuta en un hilo del pool.
+PreparedDays planDays(const QVector<Candidate>& pool, const QHash<int, EnergyCalculator::Estimate>& estimates,
+                      const QHash<int, QStringList>& exclusions, QList<int> users, const QDate& weekStart,
+                      const MealPlanOptimizer::Options& options)
+{
+    PreparedDays prepared;
+    if (users.isEmpty()) {
+        users = estimates.keys();
+        std::sort(users.begin(), users.end());
+    }
+    for (int userId : std::as_const(users)) {
+        const auto estimate = estimates.constFind(userId);
+        if (estimate == estimates.cend() || !estimate->valid) {
+            ++prepared.skipped; // Sin peso, altura o fecha de nacimiento no hay objetivo
+            continue;
+        }
+        QVector<int> eligible;
+        const QStringList terms = exclusions.value(userId);
+        for (int c = 0; c < pool.size(); ++c) {
+            const QString& haystack = pool[c].haystack;
+            const bool excluded = std::any_of(terms.cbegin(), terms.cend(), [&haystack](const QString& term) {
+                return !term.isEmpty() && haystack.contains(term);
+            });
+            if (!excluded) {
+                eligible.append(c);
+            }
+        }
+        if (eligible.isEmpty()) {
+            ++prepared.skipped;
+            continue;
+        }
+
+        const FoodDiary::Targets targets = FoodDiary::targetsFor(estimate->targetKcal);
+        // Semilla fija por paciente y semana: repetir la generación da el mismo plan
+        QRandomGenerator random(quint32(userId) * 2654435761u ^ quint32(weekStart.toJulianDay()));
+        for (int day = 0; day < options.candidateDays; ++day) {
+            DayTask task;
+            task.userId = userId;
+            task.dayIndex = day;
+            task.targets = targets;
+            task.candidates = eligible;
+            // Fisher-Yates parcial: los primeros foodsPerDay quedan al azar
+            const int take = std::min(options.foodsPerDay, int(eligible.size()));
+            for (int i = 0; i < take; ++i) {
+                const int j = i + int(random.bounded(quint32(eligible.size() - i)));
+                std::swap(task.candidates[i], task.candidates[j]);
+            }
+            task.candidates.resize(take);
+            prepared.tasks.append(task);
+        }
+        prepared.users.append(userId);
+    }
+    return prepared;
+}
+
+// Programa entero de un día. Solo cálculo: se ejecuta en los hilos del pool.
+MealPlanOptimizer::DayPlan solveDay(const QVector<Candidate>& pool, const DayTask& task,
+                                    const MealPlanOptimizer::Options& options, bool* ok)
+{
+    LpSolver::Problem problem;
+    const double portionFactor = options.portionGrams / 100.0;
+    QVector<int> portions;
+    portions.reserve(task.candidates.size());
+    for (int c : task.candidates) {
+        const double cost = options.costWeight * pool[c].pricePerKg * options.portionGrams / 1000.0;
+        portions.append(problem.addVariable(cost, options.maxPortions, true));
+    }
+
+    for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+        const FoodDiary::Nutrient nutrient = FoodDiary::Nutrient(n);
+        const double target = task.targets.values[n];
+        if (!(target > 0.0)) {
+            continue;
+        }
+        QVector<QPair<int, double>> terms;
+        for (qsizetype i = 0; i < task.candidates.size(); ++i) {
+            const double amount = pool[task.candidates[i]].per100g[n] * portionFactor;
+            if (amount != 0.0) {
+                terms.append(qMakePair(portions[i], amount));
+            }
+        }
+        if (isTracked(nutrient)) {
+            const double weight = (nutrient == FoodDiary::EnergyKcal ? kEnergyWeight : kMacroWeight) / target;
+            terms.append(qMakePair(problem.addVariable(weight), -1.0)); // Exceso
+            terms.append(qMakePair(problem.addVariable(weight), 1.0));  // Defecto
+            problem.addRow(terms, LpSolver::Equal, target);
+        } else if (FoodDiary::isUpperLimit(nutrient)) {
+            terms.append(qMakePair(problem.addVariable(kMicronutrientPenalty / target), -1.0));
+            problem.addRow(terms, LpSolver::LessEqual, target);
+        } else {
+            terms.append(qMakePair(problem.addVariable(kMicronutrientPenalty / target), 1.0));
+            problem.addRow(terms, LpSolver::GreaterEqual, target);
+        }
+    }
+
+    MealPlanOptimizer::DayPlan plan;
+    const LpSolver::Result result = LpSolver::solve(problem, options.maxNodes);
+    *ok = result.status == LpSolver::Optimal || result.status == LpSolver::Feasible;
+    if (!*ok) {
+        return plan;
+    }
+    double costTerm = 0.0;
+    for (qsizetype i = 0; i < task.candidates.size(); ++i) {
+        const int count = int(std::lround(result.x[portions[i]]));
+        if (count <= 0) {
+            continue;
+        }
+        const Candidate& candidate = pool[task.candidates[i]];
+        MealPlanOptimizer::PlannedItem item;
+        item.foodCode = candidate.foodCode;
+        item.recipeId = candidate.recipeId;
+        item.name = candidate.name;
+        item.grams = count * options.portionGrams;
+        plan.items.append(item);
+        for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+            plan.values[n] += candidate.per100g[n] * item.grams / 100.0;
+        }
+        plan.cost += candidate.pricePerKg * item.grams / 1000.0;
+        costTerm += problem.cost[portions[i]] * count;
+    }
+    plan.deviation = std::max(0.0, result.objective - costTerm);
+    return plan;
+}
+
+// Elige los 7 días de la semana entre los candidatos: menor desviación, penalizando repetir alimentos
+QVector<MealPlanOptimizer::DayPlan> pickWeek(const QVector<MealPlanOptimizer::DayPlan>& days)
+{
+    QVector<MealPlanOptimizer::DayPlan> week;
+    if (days.isEmpty()) {
+        return week;
+    }
+    QHash<QString, int> uses;
+    for (int d = 0; d < kDaysPerWeek; ++d) {
+        int best = -1;
+        double bestScore = 0.0;
+        for (qsizetype i = 0; i < days.size(); ++i) {
+            // El coste ya pesó al resolver cada día
+            double score = days[i].deviation;
+            for (const MealPlanOptimizer::PlannedItem& item : days[i].items) {
+                score += kRepeatPenalty * uses.value(priceKey(item.foodCode, item.recipeId), 0);
+            }
+            if (best < 0 || score < bestScore) {
+                best = int(i);
+                bestScore = score;
+            }
+        }
+        week.append(days[best]);
+        for (const MealPlanOptimizer::PlannedItem& item : days[best].items) {
+            ++uses[priceKey(item.foodCode, item.recipeId)];
+        }
+    }
+    return week;
+}
+
+} // namespace
+
+struct MealPlanOptimizer::Inputs {
+    bool ok = false;
+    QStringList foodCodes; // Más registrados en el diario, de más a menos
+    QHash<QString, double> prices;
+    QHash<int, QStringList> exclusions;
+    QHash<int, EnergyCalculator::Estimate> estimates;
+};
+
+MealPlanOptimizer* MealPlanOptimizer::instance()
+{
+    static MealPlanOptimizer optimizer;
+    return &optimizer;
+}
+
+MealPlanOptimizer::MealPlanOptimizer(QObject *parent)
+    : QObject(parent)
+{
+    connect(&m_watcher, &QFutureWatcher<DayResult>::finished, this, &MealPlanOptimizer::onDaysSolved);
+    connect(DataChangeHub::instance(), &DataChangeHub::userDeleted, this, &MealPlanOptimizer::onUserDeleted);
+
+    m_nightlyTimer.setSingleShot(true);
+    m_nightlyTimer.setTimerType(Qt::VeryCoarseTimer); // Basta con precisión de segundos
+    connect(&m_nightlyTimer, &QTimer::timeout, this, &MealPlanOptimizer::onNightlyCheck);
+}
+
+bool MealPlanOptimizer::generateWeek(const QDate& weekStart, const QList<int>& userIds, const Options& options)
+{
+    if (m_running) {
+        qWarning() << "Ya hay una generación de planes en curso.";
+        return false;
+    }
+    // Comprobación en memoria; que los candidatos tengan composición se sabe al armarlos
+    if (RecipeGraph::instance()->recipeIds().isEmpty() && FoodCatalog::instance()->foodCount() == 0) {
+        qWarning() << "No hay alimentos ni recetas con composición para generar planes.";
+        return false;
+    }
+    m_running = true;
+    m_runTimer.start();
+
+    // 1. Lecturas de la base de datos en un hilo del pool, con su propia conexión
+    auto *watcher = new QFutureWatcher<Inputs>(this);
+    connect(watcher, &QFutureWatcher<Inputs>::finished, this, [this, watcher, weekStart, userIds, options]() {
+        const Inputs inputs = watcher->result();
+        watcher->deleteLater();
+        onInputsLoaded(weekStart, userIds, options, inputs);
+    });
+    watcher->setFuture(QtConcurrent::run(&MealPlanOptimizer::loadInputs, options));
+    return true;
+}
+
+MealPlanOptimizer::Inputs MealPlanOptimizer::loadInputs(const Options& options)
+{
+    static QAtomicInteger<quint64> counter;
+    const QString connectionName = QString("meal_plans_%1").arg(counter.fetchAndAddRelaxed(1));
+    Inputs inputs;
+    {
+        QSqlDatabase db = QSqlDatabase::cloneDatabase(QString(QSqlDatabase::defaultConnection), connectionName);
+        if (db.open()) {
+            inputs.foodCodes = loadMostLoggedFoods(db, options.mostLoggedFoods);
+            inputs.prices = loadPrices(db);
+            inputs.exclusions = loadExclusions(db);
+            UserManager userManager;
+            HealthMetricManager healthMetricManager;
+            inputs.estimates = EnergyCalculator::estimateAll(userManager.getAllUsers(db),
+                                                             healthMetricManager.getLatestHealthMetricForAllUsers(db));
+            inputs.ok = true;
+        } else {
+            qWarning() << "No se pudo abrir la conexión" << connectionName << "para generar planes:" << db.lastError().text();
+        }
+        db.close();
+    }
+    // Fuera del bloque: no queda ninguna QSqlDatabase ni QSqlQuery que use la conexión
+    QSqlDatabase::removeDatabase(connectionName);
+    return inputs;
+}
+
+void MealPlanOptimizer::onInputsLoaded(const QDate& weekStart, const QList<int>& userIds, const Options& options,
+                                       const Inputs& inputs)
+{
+    if (!inputs.ok) {
+        finishRun(weekStart, 0, 0, false);
+        return;
+    }
+    // 2. Candidatos en el hilo principal, solo desde memoria (catálogo mapeado y grafo de recetas)
+    const CandidatePool pool(new QVector<Candidate>(buildCandidates(inputs.foodCodes, inputs.prices, options)));
+    if (pool->isEmpty()) {
+        qWarning() << "No hay alimentos ni recetas con composición para generar planes.";
+        finishRun(weekStart, 0, int(userIds.isEmpty() ? inputs.estimates.size() : userIds.size()), false);
+        return;
+    }
+
+    // 3. Exclusiones y días candidatos en el pool
+    auto *watcher = new QFutureWatcher<PreparedDays>(this);
+    connect(watcher, &QFutureWatcher<PreparedDays>::finished, this, [this, watcher, weekStart, pool, options]() {
+        const PreparedDays prepared = watcher->result();
+        watcher->deleteLater();
+        m_runningWeek = weekStart;
+        m_runningUsers = prepared.users;
+        m_skippedUsers = prepared.skipped;
+        if (prepared.tasks.isEmpty()) {
+            finishRun(weekStart, 0, m_skippedUsers, true);
+            return;
+        }
+
+        // 4. Todos los días de todos los pacientes en el pool de hilos
+        qInfo() << "Generando planes de" << m_runningUsers.size() << "pacientes:" << prepared.tasks.size() << "días candidatos.";
+        m_watcher.setFuture(QtConcurrent::mapped(prepared.tasks, [pool, options](const DayTask& task) {
+            DayResult result;
+            result.userId = task.userId;
+            result.dayIndex = task.dayIndex;
+            result.plan = solveDay(*pool, task, options, &result.ok);
+            return result;
+        }));
+    });
+    watcher->setFuture(QtConcurrent::run([pool, inputs, userIds, weekStart, options]() {
+        return planDays(*pool, inputs.estimates, inputs.exclusions, userIds, weekStart, options);
+    }));
+}
+
+void MealPlanOptimizer::onDaysSolved()
+{
+    // 5. Selección de la semana y guardado, de nuevo en el hilo principal
+    QHash<int, QVector<DayPlan>> daysByUser;
+    const QList<DayResult> results = m_watcher.future().results();
+    for (const DayResult& result : results) {
+        if (result.ok && !result.plan.items.isEmpty()) {
+            daysByUser[result.userId].append(result.plan);
+        }
+    }
+
+    QList<WeekPlan> plans;
+    int skipped = m_skippedUsers;
+    for (int userId : std::as_const(m_runningUsers)) {
+        WeekPlan plan;
+        plan.userId = userId;
+        plan.weekStart = m_runningWeek;
+        plan.days = pickWeek(daysByUser.value(userId));
+        if (plan.days.isEmpty()) {
+            ++skipped;
+            continue;
+        }
+        for (const DayPlan& day : std::as_const(plan.days)) {
+            plan.deviation += day.deviation;
+            plan.cost += day.cost;
+        }
+        plans.append(plan);
+    }
+
+    const bool stored = storePlans(m_runningWeek, plans);
+    qInfo() << "Planes semanales generados:" << plans.size() << "pacientes," << skipped << "sin plan, en"
+            << m_runTimer.elapsed() << "ms.";
+    finishRun(m_runningWeek, stored ? int(plans.size()) : 0, skipped, stored);
+}
+
+void MealPlanOptimizer::finishRun(const QDate& weekStart, int plans, int skipped, bool stored)
+{
+    if (stored && m_nightlyRun) {
+        writeMeta("meal_plans_last_run", QDate::currentDate().toJulianDay());
+    }
+    m_nightlyRun = false;
+    m_running = false;
+    emit weekGenerated(weekStart, plans, skipped, m_runTimer.elapsed());
+}
+
+bool MealPlanOptimizer::storePlans(const QDate& weekStart, const QList<WeekPlan>& plans)
+{
+    if (plans.isEmpty()) {
+        return true;
+    }
+    const QString week = weekStart.toString(Qt::ISODate);
+    QVariantList deleteUsers, deleteWeeks;
+    QVariantList userIds, weeks, dayIndexes, positions, foodCodes, recipeIds, grams;
+    QVariantList runUsers, runWeeks, runDeviations, runCosts;
+    for (const WeekPlan& plan : plans) {
+        deleteUsers << plan.userId;
+        deleteWeeks << week;
+        runUsers << plan.userId;
+        runWeeks << week;
+        runDeviations << plan.deviation;
+        runCosts << plan.cost;
+        for (int day = 0; day < plan.days.size(); ++day) {
+            const QVector<PlannedItem>& items = plan.days[day].items;
+            for (int position = 0; position < items.size(); ++position) {
+                userIds << plan.userId;
+                weeks << week;
+                dayIndexes << day;
+                positions << position;
+                foodCodes << (items[position].recipeId >= 0 ? QVariant() : QVariant(items[position].foodCode));
+                recipeIds << (items[position].recipeId >= 0 ? QVariant(items[position].recipeId) : QVariant());
+                grams << items[position].grams;
+            }
+        }
+    }
+
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QSqlQuery query;
+    bool ok = true;
+    for (const QString& table : { QString("generated_meal_plans"), QString("meal_plan_runs") }) {
+        query.prepare(QString("DELETE FROM %1 WHERE user_id = ? AND week_start = ?").arg(table));
+        query.addBindValue(deleteUsers);
+        query.addBindValue(deleteWeeks);
+        ok = ok && query.execBatch();
+    }
+    if (ok) {
+        query.prepare("INSERT INTO generated_meal_plans (user_id, week_start, day_index, position, food_code, recipe_id, grams) "
+                      "VALUES (?, ?, ?, ?, ?, ?, ?)");
+        for (const QVariantList& column : { userIds, weeks, dayIndexes, positions, foodCodes, recipeIds, grams }) {
+            query.addBindValue(column);
+        }
+        ok = query.execBatch();
+    }
+    if (ok) {
+        query.prepare("INSERT INTO meal_plan_runs (user_id, week_start, deviation, cost) VALUES (?, ?, ?, ?)");
+        for (const QVariantList& column : { runUsers, runWeeks, runDeviations, runCosts }) {
+            query.addBindValue(column);
+        }
+        ok = query.execBatch();
+    }
+    if (!ok) {
+        qCritical() << "Error al guardar los planes semanales:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+MealPlanOptimizer::WeekPlan MealPlanOptimizer::plan(int userId, const QDate& weekStart)
+{
+    WeekPlan plan;
+    plan.userId = userId;
+    plan.weekStart = weekStart;
+    const QString week = weekStart.toString(Qt::ISODate);
+
+    QSqlQuery query;
+    query.prepare("SELECT deviation, cost FROM meal_plan_runs WHERE user_id = :user_id AND week_start = :week_start");
+    query.bindValue(":user_id", userId);
+    query.bindValue(":week_start", week);
+    if (!query.exec() || !query.next()) {
+        return plan;
+    }
+    plan.deviation = query.value(0).toDouble();
+    plan.cost = query.value(1).toDouble();
+
+    query.prepare("SELECT day_index, food_code, recipe_id, grams FROM generated_meal_plans "
+                  "WHERE user_id = :user_id AND week_start = :week_start ORDER BY day_index, position");
+    query.bindValue(":user_id", userId);
+    query.bindValue(":week_start", week);
+    if (!query.exec()) {
+        qCritical() << "Error al leer el plan semanal del usuario" << userId << ":" << query.lastError().text();
+        return plan;
+    }
+    plan.days.resize(kDaysPerWeek);
+    QVector<QPair<QString, int>> keys;
+    QVector<QPair<int, int>> slots; // (día, posición) de cada clave
+    while (query.next()) {
+        const int day = query.value(0).toInt();
+        if (day < 0 || day >= kDaysPerWeek) {
+            continue;
+        }
+        PlannedItem item;
+        item.recipeId = query.value(2).isNull() ? -1 : query.value(2).toInt();
+        item.foodCode = item.recipeId >= 0 ? QString() : query.value(1).toString();
+        item.grams = query.value(3).toDouble();
+        if (item.recipeId >= 0) {
+            item.name = RecipeGraph::instance()->recipeName(item.recipeId);
+        } else {
+            const int food = FoodCatalog::instance()->foodIndex(item.foodCode);
+            item.name = food >= 0 ? FoodCatalog::instance()->foodName(food) : item.foodCode;
+        }
+        keys.append(qMakePair(item.foodCode, item.recipeId));
+        slots.append(qMakePair(day, int(plan.days[day].items.size())));
+        plan.days[day].items.append(item);
+    }
+
+    // Valores con la composición actual
+    const QVector<FoodDiary::Composition> compositions = FoodDiary::compositionPer100g(keys);
+    for (qsizetype i = 0; i < keys.size(); ++i) {
+        DayPlan& day = plan.days[slots[i].first];
+        const double grams = day.items[slots[i].second].grams;
+        for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+            day.values[n] += compositions[i].values[n] * grams / 100.0;
+        }
+    }
+    return plan;
+}
+
+QStringList MealPlanOptimizer::exclusions(int userId)
+{
+    QStringList terms;
+    QSqlQuery query;
+    query.prepare("SELECT term FROM meal_plan_exclusions WHERE user_id = :user_id ORDER BY term");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al leer las exclusiones del usuario" << userId << ":" << query.lastError().text();
+        return terms;
+    }
+    while (query.next()) {
+        terms << query.value(0).toString();
+    }
+    return terms;
+}
+
+bool MealPlanOptimizer::setExclusions(int userId, const QStringList& terms)
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QSqlQuery query;
+    query.prepare("DELETE FROM meal_plan_exclusions WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    bool ok = query.exec();
+    QSet<QString> seen;
+    for (const QString& term : terms) {
+        const QString trimmed = term.trimmed();
+        if (!ok || trimmed.isEmpty() || seen.contains(TextNormalizer::fold(trimmed))) {
+            continue;
+        }
+        seen.insert(TextNormalizer::fold(trimmed));
+        query.prepare("INSERT INTO meal_plan_exclusions (user_id, term) VALUES (:user_id, :term)");
+        query.bindValue(":user_id", userId);
+        query.bindValue(":term", trimmed);
+        ok = query.exec();
+    }
+    if (!ok) {
+        qCritical() << "Error al guardar las exclusiones del usuario" << userId << ":" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+bool MealPlanOptimizer::setPrice(const QString& foodCode, int recipeId, double pricePerKg)
+{
+    QSqlQuery query;
+    if (pricePerKg <= 0.0) {
+        query.prepare("DELETE FROM food_prices WHERE item_key = :item_key");
+    } else {
+        query.prepare("REPLACE INTO food_prices (item_key, price_per_kg) VALUES (:item_key, :price_per_kg)");
+        query.bindValue(":price_per_kg", pricePerKg);
+    }
+    query.bindValue(":item_key", priceKey(foodCode, recipeId));
+    if (!query.exec()) {
+        qCritical() << "Error al guardar el precio de" << priceKey(foodCode, recipeId) << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void MealPlanOptimizer::startNightly()
+{
+    scheduleNightly();
+}
+
+void MealPlanOptimizer::scheduleNightly()
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    QDateTime next(now.date(), QTime(kNightlyHour, 0));
+    if (next <= now) {
+        next = next.addDays(1);
+    }
+    m_nightlyTimer.start(int(now.msecsTo(next)));
+    qInfo() << "Próxima generación nocturna de planes:" << next.toString(Qt::ISODate);
+}
+
+void MealPlanOptimizer::onNightlyCheck()
+{
+    if (m_running) {
+        m_nightlyTimer.start(kNightlyRetryMs);
+        return;
+    }
+    scheduleNightly();
+    const QDate today = QDate::currentDate();
+    if (readMeta("meal_plans_last_run", 0) == today.toJulianDay()) {
+        return;
+    }
+    // La semana siguiente (de lunes a domingo), con los datos del día
+    const QDate nextMonday = today.addDays(8 - today.dayOfWeek());
+    m_nightlyRun = true;
+    if (!generateWeek(nextMonday)) {
+        m_nightlyRun = false;
+    }
+}
+
+void MealPlanOptimizer::onUserDeleted(int userId)
+{
+    QSqlQuery query;
+    for (const QString& table : { QString("generated_meal_plans"), QString("meal_plan_runs"), QString("meal_plan_exclusions") }) {
+        query.prepare(QString("DELETE FROM %1 WHERE user_id = :user_id").arg(table));
+        query.bindValue(":user_id", userId);
+        if (!query.exec()) {
+            qCritical() << "Error al borrar" << table << "del usuario" << userId << ":" << query.lastError().text();
+        }
+    }
+}
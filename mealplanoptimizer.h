@@ -0,0 +1,128 @@
+#ifndef MEALPLANOPTIMIZER_H
+#define MEALPLANOPTIMIZER_H
+
+#include <QDate>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include "fooddiary.h"
+
+// Planes semanales generados para cada paciente a partir de su energía objetivo
+// (EnergyCalculator, que ya tiene en cuenta el 'goal') y de los objetivos de FoodDiary::targetsFor.
+//  - Candidatos: todas las recetas (RecipeGraph) y los alimentos más registrados en el diario,
+//    menos los que coinciden con las exclusiones del paciente (también por ingredientes de receta).
+//  - Cada día candidato es un programa entero pequeño que resuelve LpSolver: raciones enteras de
+//    portionGrams por alimento; energía y macronutrientes con variables de desviación; mínimos de
+//    micronutrientes y máximos (azúcares, grasa saturada, sodio) elásticos con penalización alta;
+//    y, opcionalmente, el coste (€/kg de 'food_prices').
+//  - Se plantean candidateDays días por paciente sobre subconjuntos aleatorios (con semilla fija)
+//    de los candidatos; todos los días de todos los pacientes se resuelven en paralelo
+//    (QtConcurrent) y de cada paciente se eligen 7 penalizando repetir alimentos.
+//  - Las lecturas (diario, precios, exclusiones, pacientes y mediciones) se hacen en un hilo con su
+//    propia conexión, y el filtro de exclusiones en el pool. El hilo principal solo arma los
+//    candidatos desde el catálogo y las recetas (en memoria) y guarda el resultado (una transacción).
+//
+// Tablas (migración v6): meal_plan_exclusions, food_prices, meal_plan_runs y generated_meal_plans.
+class MealPlanOptimizer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        int candidateDays = 14;    // Días planteados por paciente (se eligen 7)
+        int foodsPerDay = 30;      // Candidatos por día
+        int mostLoggedFoods = 300; // Alimentos del diario que entran en el conjunto de candidatos
+        double portionGrams = 50.0;
+        int maxPortions = 6;       // Por alimento y día
+        double costWeight = 0.0;   // 0: solo desviación; > 0: puntos de desviación por euro
+        int maxNodes = 300;        // Límite de ramificación por día
+    };
+
+    struct PlannedItem {
+        QString foodCode;
+        int recipeId = -1;
+        QString name;
+        double grams = 0.0;
+    };
+
+    struct DayPlan {
+        QVector<PlannedItem> items;
+        double values[FoodDiary::NutrientCount] = {};
+        double deviation = 0.0; // Desviación ponderada respecto a los objetivos (0 = exacta)
+        double cost = 0.0;      // € (0 si no hay precios)
+    };
+
+    struct WeekPlan {
+        int userId = -1;
+        QDate weekStart;
+        QVector<DayPlan> days; // Lunes a domingo; vacío si no hay plan
+        double deviation = 0.0;
+        double cost = 0.0;
+    };
+
+    static MealPlanOptimizer* instance();
+
+    // Genera en segundo plano los planes de la semana que empieza en weekStart (lunes) para los
+    // pacientes indicados (todos si la lista está vacía). Emite weekGenerated al terminar.
+    // false si ya hay una generación en curso o no hay ni recetas ni catálogo de alimentos.
+    bool generateWeek(const QDate& weekStart, const QList<int>& userIds = {}, const Options& options = Options());
+    bool isRunning() const { return m_running; }
+
+    WeekPlan plan(int userId, const QDate& weekStart);
+
+    // Términos excluidos del paciente (alergias, preferencias): se comparan sin tildes ni mayúsculas
+    // con el nombre del alimento o receta y con los de los ingredientes de la receta
+    QStringList exclusions(int userId);
+    bool setExclusions(int userId, const QStringList& terms);
+    // Precio por kg de un alimento o una receta (recipeId >= 0); <= 0 lo elimina
+    bool setPrice(const QString& foodCode, int recipeId, double pricePerKg);
+
+    // Generación nocturna: cada día a las 02:00 (fuera del horario de consulta), la semana siguiente
+    // para todos los pacientes. Si la aplicación no está abierta a esa hora se usa la opción del menú.
+    void startNightly();
+
+signals:
+    void weekGenerated(const QDate& weekStart, int plans, int skipped, qint64 elapsedMs);
+
+private slots:
+    void onDaysSolved();
+    void onNightlyCheck();
+    void onUserDeleted(int userId);
+
+private:
+    explicit MealPlanOptimizer(QObject *parent = nullptr);
+
+    // Lecturas de la base de datos para una generación (definido en mealplanoptimizer.cpp)
+    struct Inputs;
+
+    // Un día de un paciente, resuelto en un hilo del pool
+    struct DayResult {
+        int userId = -1;
+        int dayIndex = 0;
+        bool ok = false;
+        DayPlan plan;
+    };
+
+    // Se ejecuta en un hilo del pool con una conexión propia
+    static Inputs loadInputs(const Options& options);
+    void onInputsLoaded(const QDate& weekStart, const QList<int>& userIds, const Options& options, const Inputs& inputs);
+    bool storePlans(const QDate& weekStart, const QList<WeekPlan>& plans);
+    void finishRun(const QDate& weekStart, int plans, int skipped, bool stored);
+    void scheduleNightly();
+
+    QFutureWatcher<DayResult> m_watcher;
+    QDate m_runningWeek;
+    QList<int> m_runningUsers;
+    int m_skippedUsers = 0;
+    bool m_running = false; // Desde las lecturas hasta el guardado
+    bool m_nightlyRun = false;
+    QElapsedTimer m_runTimer;
+    QTimer m_nightlyTimer;
+};
+
+#endif // MEALPLANOPTIMIZER_H
@@ -0,0 +1,465 @@
+#include "metricanomalydetector.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QPair>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double kMadToSigma = 1.4826;       // MAD -> desviación típica para datos normales
+const double kMinWeightSigma = 1.5;      // kg; evita falsos avisos con historiales muy estables
+const double kRobustZWarning = 4.0;
+const double kRobustZCritical = 8.0;
+const double kMaxDailyWeightChange = 1.0;  // kg/día sostenido (más allá solo por líquidos)
+const double kWeightChangeAllowance = 3.0; // kg de oscilación admitida entre dos mediciones cualesquiera
+const double kAdultHeightTolerance = 3.0;  // cm
+const int kAdultAgeYears = 20;
+
+double median(QVector<double> values)
+{
+    if (values.isEmpty()) {
+        return 0.0;
+    }
+    const int middle = int(values.size() / 2);
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double result = values[middle];
+    if (values.size() % 2 == 0) {
+        result = (result + *std::max_element(values.begin(), values.begin() + middle)) / 2.0;
+    }
+    return result;
+}
+
+double medianAbsoluteDeviation(const QVector<double>& values, double center)
+{
+    QVector<double> deviations;
+    deviations.reserve(values.size());
+    for (double value : values) {
+        deviations.append(std::fabs(value - center));
+    }
+    return median(deviations);
+}
+
+bool closeTo(double value, double reference, double tolerance)
+{
+    return reference > 0 && std::fabs(value - reference) <= tolerance * reference;
+}
+
+QString formatKg(double value)
+{
+    return QString::number(value, 'f', 1) + " kg";
+}
+
+// Una fila de la revisión masiva
+struct ReviewRow {
+    int metricId;
+    int userId;
+    MetricAnomalyDetector::Finding finding;
+};
+
+// Un paciente con su historial ordenado por fecha
+struct PatientHistory {
+    int userId = -1;
+    QDate birthDate;
+    QVector<HealthMetric> metrics;
+};
+
+QVector<ReviewRow> reviewPatient(const PatientHistory& patient)
+{
+    QVector<ReviewRow> rows;
+    QVector<HealthMetric> window;
+    window.reserve(MetricAnomalyDetector::kWindow);
+    for (const HealthMetric& metric : patient.metrics) {
+        const QList<MetricAnomalyDetector::Finding> findings =
+            MetricAnomalyDetector::checkAgainstWindow(metric, window, patient.birthDate);
+        for (const MetricAnomalyDetector::Finding& finding : findings) {
+            rows.append({ metric.id(), patient.userId, finding });
+        }
+        // Las mediciones marcadas como críticas no entran en la referencia de las siguientes
+        const bool critical = std::any_of(findings.cbegin(), findings.cend(), [](const MetricAnomalyDetector::Finding& f) {
+            return f.severity == MetricAnomalyDetector::Critical;
+        });
+        if (!critical) {
+            if (window.size() == MetricAnomalyDetector::kWindow) {
+                window.removeFirst();
+            }
+            window.append(metric);
+        }
+    }
+    return rows;
+}
+
+} // namespace
+
+QList<MetricAnomalyDetector::Finding> MetricAnomalyDetector::check(const HealthMetric& candidate,
+                                                                   const QList<HealthMetric>& history,
+                                                                   const QDate& birthDate)
+{
+    // Mediciones anteriores o del mismo día (excluyendo la propia si se está editando), las más recientes
+    QVector<HealthMetric> previous;
+    for (const HealthMetric& metric : history) {
+        if (metric.id() == candidate.id() && candidate.id() > 0) {
+            continue;
+        }
+        if (metric.date() <= candidate.date()) {
+            previous.append(metric);
+        }
+    }
+    std::sort(previous.begin(), previous.end(), [](const HealthMetric& a, const HealthMetric& b) {
+        return a.date() < b.date();
+    });
+    if (previous.size() > kWindow) {
+        previous.erase(previous.begin(), previous.end() - kWindow);
+    }
+    return checkAgainstWindow(candidate, previous, birthDate);
+}
+
+QList<MetricAnomalyDetector::Finding> MetricAnomalyDetector::checkAgainstWindow(const HealthMetric& candidate,
+                                                                                const QVector<HealthMetric>& previous,
+                                                                                const QDate& birthDate)
+{
+    QList<Finding> findings;
+    const double weight = candidate.weight();
+    const double height = candidate.height();
+
+    // Comprobaciones absolutas (no necesitan historial)
+    if (height > 0 && height < 3.0) {
+        findings.append({ "height_units", "height", Critical,
+                          QString("La altura (%1) parece estar en metros; se esperan centímetros.").arg(height) });
+    }
+    if (weight > 0 && height >= 3.0) {
+        const double meters = height / 100.0;
+        const double bmi = weight / (meters * meters);
+        if (bmi < 10.0 || bmi > 80.0) {
+            findings.append({ "bmi_range", "bmi", Critical,
+                              QString("El IMC resultante (%1) no es fisiológicamente posible.").arg(bmi, 0, 'f', 1) });
+        }
+    }
+    if (candidate.bodyFatPercentage() > 0 && (candidate.bodyFatPercentage() < 2.0 || candidate.bodyFatPercentage() > 70.0)) {
+        findings.append({ "body_fat_range", "body_fat_percentage", Warning,
+                          QString("El % de grasa (%1) está fuera del rango habitual (2-70 %).")
+                              .arg(candidate.bodyFatPercentage()) });
+    }
+    if (candidate.bodyFatPercentage() + candidate.muscleMassPercentage() > 100.0) {
+        findings.append({ "composition_sum", "muscle_mass_percentage", Critical,
+                          "La suma de % de grasa y % de músculo supera el 100 %." });
+    }
+
+    if (previous.isEmpty()) {
+        return findings;
+    }
+
+    // Referencia robusta del historial reciente
+    QVector<double> weights;
+    QVector<double> heights;
+    for (const HealthMetric& metric : previous) {
+        if (metric.weight() > 0) {
+            weights.append(metric.weight());
+        }
+        if (metric.height() >= 3.0) {
+            heights.append(metric.height());
+        }
+    }
+
+    if (!weights.isEmpty() && weight > 0) {
+        const double medianWeight = median(weights);
+        const double sigma = qMax(kMadToSigma * medianAbsoluteDeviation(weights, medianWeight), kMinWeightSigma);
+        const double robustZ = std::fabs(weight - medianWeight) / sigma;
+
+        if (closeTo(weight * 10.0, medianWeight, 0.15) || closeTo(weight / 10.0, medianWeight, 0.15)) {
+            findings.append({ "weight_decimal", "weight", Critical,
+                              QString("El peso (%1) parece tener la coma desplazada; la mediana reciente es %2.")
+                                  .arg(formatKg(weight), formatKg(medianWeight)) });
+        } else if (robustZ > kRobustZWarning) {
+            findings.append({ "weight_outlier", "weight", robustZ > kRobustZCritical ? Critical : Warning,
+                              QString("El peso (%1) se aleja mucho de la mediana reciente (%2).")
+                                  .arg(formatKg(weight), formatKg(medianWeight)) });
+        }
+
+        // Ritmo de cambio respecto a la medición anterior más próxima
+        const HealthMetric& last = previous.last();
+        if (last.weight() > 0 && last.date().isValid() && candidate.date().isValid()) {
+            const qint64 days = qMax<qint64>(1, last.date().daysTo(candidate.date()));
+            const double change = weight - last.weight();
+            const double allowed = kWeightChangeAllowance + kMaxDailyWeightChange * days;
+            if (std::fabs(change) > allowed) {
+                findings.append({ "weight_rate", "weight", Warning,
+                                  QString("Cambio de peso de %1 en %2 días respecto a la medición anterior.")
+                                      .arg(formatKg(change)).arg(days) });
+            }
+        }
+    }
+
+    if (!heights.isEmpty() && height >= 3.0) {
+        const double medianHeight = median(heights);
+        const double ageYears = birthDate.isValid() && candidate.date().isValid()
+                                    ? birthDate.daysTo(candidate.date()) / 365.2425
+                                    : kAdultAgeYears;
+        if (ageYears >= kAdultAgeYears && std::fabs(height - medianHeight) > kAdultHeightTolerance) {
+            findings.append({ "adult_height_change", "height", Warning,
+                              QString("La altura (%1 cm) difiere de la habitual del paciente (%2 cm).")
+                                  .arg(height, 0, 'f', 1).arg(medianHeight, 0, 'f', 1) });
+        } else if (ageYears < kAdultAgeYears && height < medianHeight - 1.5) {
+            findings.append({ "height_decrease", "height", Warning,
+                              QString("La altura (%1 cm) es menor que en mediciones anteriores (%2 cm).")
+                                  .arg(height, 0, 'f', 1).arg(medianHeight, 0, 'f', 1) });
+        }
+    }
+
+    return findings;
+}
+
+QString MetricAnomalyDetector::describe(const QList<Finding>& findings)
+{
+    QStringList lines;
+    for (const Finding& finding : findings) {
+        lines << QString("%1 %2").arg(finding.severity == Critical ? "[!]" : "[?]", finding.message);
+    }
+    return lines.join('\n');
+}
+
+namespace {
+
+const int kMaxInlineUsers = 500;
+
+const int kProgressInterval = 4096; // Mediciones entre dos avisos de progreso
+
+// Revisión de los pacientes de 'users' (vacío = todos); ver sweepAll
+// 'db' por valor: transaction() y commit() no son const
+int sweep(const QSet<int>& users, QSqlDatabase db, const MetricAnomalyDetector::Progress& progress)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // 1. Lectura secuencial única, agrupada por paciente
+    QVector<PatientHistory> patients;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    // Con pocos pacientes el filtro va en la consulta (son enteros: se pueden escribir tal cual);
+    // con muchos se recorre la tabla y se descartan al leer
+    QString filter;
+    if (!users.isEmpty() && users.size() <= kMaxInlineUsers) {
+        QStringList ids;
+        for (int userId : users) {
+            ids << QString::number(userId);
+        }
+        filter = QString("WHERE m.user_id IN (%1) ").arg(ids.join(", "));
+    }
+    // Total para el progreso: el recuento sale del índice (user_id, date) sin leer las filas
+    qint64 total = 0;
+    if (progress) {
+        if (!query.exec("SELECT COUNT(*) FROM health_metrics m " + filter) || !query.next()) {
+            qCritical() << "Error al contar las métricas para la revisión:" << query.lastError().text();
+            return -1;
+        }
+        total = query.value(0).toLongLong();
+        query.finish();
+    }
+    if (!query.exec("SELECT m.metric_id, m.user_id, m.date, m.weight, m.height, m.body_fat_percentage, "
+                    "m.muscle_mass_percentage, u.birth_date "
+                    "FROM health_metrics m JOIN users u ON u.user_id = m.user_id " + filter +
+                    "ORDER BY m.user_id, m.date, m.created_at")) {
+        qCritical() << "Error al leer las métricas para la revisión:" << query.lastError().text();
+        return -1;
+    }
+    int rows = 0;
+    qint64 read = 0;
+    while (query.next()) {
+        if (progress && ++read % kProgressInterval == 0 && !progress(read, total)) {
+            qInfo() << "Revisión de mediciones cancelada tras" << read << "filas.";
+            return -1;
+        }
+        const int userId = query.value(1).toInt();
+        if (!users.isEmpty() && !users.contains(userId)) {
+            continue;
+        }
+        if (patients.isEmpty() || patients.last().userId != userId) {
+            PatientHistory patient;
+            patient.userId = userId;
+            patient.birthDate = QDate::fromString(query.value(7).toString(), Qt::ISODate);
+            patients.append(patient);
+        }
+        HealthMetric metric;
+        metric.setId(query.value(0).toInt());
+        metric.setUserId(userId);
+        metric.setDate(QDate::fromString(query.value(2).toString(), Qt::ISODate));
+        metric.setWeight(query.value(3).toDouble());
+        metric.setHeight(query.value(4).toDouble());
+        metric.setBodyFatPercentage(query.value(5).toDouble());
+        metric.setMuscleMassPercentage(query.value(6).toDouble());
+        patients.last().metrics.append(metric);
+        ++rows;
+    }
+    query.finish();
+    if (progress && !progress(total, total)) {
+        qInfo() << "Revisión de mediciones cancelada tras la lectura.";
+        return -1;
+    }
+
+    // 2. Revisión en paralelo: cada paciente es independiente
+    const QVector<ReviewRow> review = QtConcurrent::blockingMappedReduced<QVector<ReviewRow>>(
+        patients, reviewPatient,
+        [](QVector<ReviewRow>& total, const QVector<ReviewRow>& partial) { total += partial; },
+        QtConcurrent::UnorderedReduce);
+
+    // 3. Actualizar la cola en una transacción. La clave (metric_id, rule) es única: lo que ya está
+    //    en la cola, revisado o no, se conserva tal cual y solo entran los avisos nuevos.
+    QSet<QPair<int, QString>> detected;
+    for (const ReviewRow& row : review) {
+        detected.insert({ row.metricId, row.finding.rule });
+    }
+    if (!db.transaction()) {
+        qCritical() << "Error al iniciar la actualización de la cola de revisión:" << db.lastError().text();
+        return -1;
+    }
+    if (!query.exec("SELECT review_id, metric_id, rule, user_id FROM metric_review_queue WHERE resolved = 0")) {
+        qCritical() << "Error al leer la cola de revisión:" << query.lastError().text();
+        db.rollback();
+        return -1;
+    }
+    QVariantList staleIds;
+    while (query.next()) {
+        if ((users.isEmpty() || users.contains(query.value(3).toInt()))
+            && !detected.contains({ query.value(1).toInt(), query.value(2).toString() })) {
+            staleIds << query.value(0).toInt();
+        }
+    }
+    query.finish();
+    if (!staleIds.isEmpty()) {
+        QSqlQuery remove(db);
+        remove.prepare("DELETE FROM metric_review_queue WHERE review_id = ?");
+        remove.addBindValue(staleIds);
+        if (!remove.execBatch()) {
+            qCritical() << "Error al quitar avisos obsoletos de la cola de revisión:" << remove.lastError().text();
+            db.rollback();
+            return -1;
+        }
+    }
+    if (!review.isEmpty()) {
+        QVariantList metricIds;
+        QVariantList userIds;
+        QVariantList rules;
+        QVariantList fields;
+        QVariantList severities;
+        QVariantList messages;
+        for (const ReviewRow& row : review) {
+            metricIds << row.metricId;
+            userIds << row.userId;
+            rules << row.finding.rule;
+            fields << row.finding.field;
+            severities << int(row.finding.severity);
+            messages << row.finding.message;
+        }
+        const QString insertIgnore = db.driverName() == "QSQLITE" ? "INSERT OR IGNORE" : "INSERT IGNORE";
+        QSqlQuery insert(db);
+        insert.prepare(insertIgnore + " INTO metric_review_queue (metric_id, user_id, rule, field, severity, message) "
+                                      "VALUES (?, ?, ?, ?, ?, ?)");
+        insert.addBindValue(metricIds);
+        insert.addBindValue(userIds);
+        insert.addBindValue(rules);
+        insert.addBindValue(fields);
+        insert.addBindValue(severities);
+        insert.addBindValue(messages);
+        if (!insert.execBatch()) {
+            qCritical() << "Error al guardar en la cola de revisión:" << insert.lastError().text();
+            db.rollback();
+            return -1;
+        }
+    }
+    if (!query.exec("SELECT COUNT(*) FROM metric_review_queue WHERE resolved = 0") || !query.next()) {
+        qCritical() << "Error al contar la cola de revisión:" << query.lastError().text();
+        db.rollback();
+        return -1;
+    }
+    const int pending = query.value(0).toInt();
+    query.finish();
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar la cola de revisión:" << db.lastError().text();
+        return -1;
+    }
+
+    qInfo() << "Revisión de mediciones" << (users.isEmpty() ? "(toda la clínica):" : "(pacientes importados):") << rows << "filas de" << patients.size() << "pacientes," << review.size()
+            << "avisos," << staleIds.size() << "obsoletos," << pending << "pendientes en" << timer.elapsed() << "ms";
+    return pending;
+}
+
+} // namespace
+
+int MetricAnomalyDetector::sweepAll(const QSqlDatabase& db, const Progress& progress)
+{
+    return sweep(QSet<int>(), db, progress);
+}
+
+int MetricAnomalyDetector::sweepUsers(const QList<int>& userIds, const QSqlDatabase& db)
+{
+    if (userIds.isEmpty()) {
+        return 0;
+    }
+    return sweep(QSet<int>(userIds.cbegin(), userIds.cend()), db, MetricAnomalyDetector::Progress());
+}
+
+QList<MetricAnomalyDetector::ReviewEntry> MetricAnomalyDetector::pendingReviews()
+{
+    QList<ReviewEntry> entries;
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    // El JOIN deja fuera las entradas de mediciones o pacientes borrados (no hay claves foráneas activas)
+    if (!query.exec("SELECT q.review_id, q.metric_id, q.user_id, q.rule, q.field, q.severity, q.message, m.date, "
+                    "u.first_name, u.last_name1, u.last_name2 "
+                    "FROM metric_review_queue q "
+                    "JOIN health_metrics m ON m.metric_id = q.metric_id "
+                    "JOIN users u ON u.user_id = q.user_id "
+                    "WHERE q.resolved = 0 "
+                    "ORDER BY q.severity DESC, m.date DESC, q.review_id")) {
+        qCritical() << "Error al leer la cola de revisión:" << query.lastError().text();
+        return entries;
+    }
+    while (query.next()) {
+        ReviewEntry entry;
+        entry.reviewId = query.value(0).toInt();
+        entry.metricId = query.value(1).toInt();
+        entry.userId = query.value(2).toInt();
+        entry.finding.rule = query.value(3).toString();
+        entry.finding.field = query.value(4).toString();
+        entry.finding.severity = query.value(5).toInt() == Critical ? Critical : Warning;
+        entry.finding.message = query.value(6).toString();
+        entry.date = QDate::fromString(query.value(7).toString(), Qt::ISODate);
+        entry.patientName = QString("%1 %2 %3")
+                                .arg(query.value(8).toString(), query.value(9).toString(), query.value(10).toString())
+                                .simplified();
+        entries.append(entry);
+    }
+    return entries;
+}
+
+bool MetricAnomalyDetector::resolveReviews(const QList<int>& reviewIds)
+{
+    if (reviewIds.isEmpty()) {
+        return true;
+    }
+    QVariantList ids;
+    for (int reviewId : reviewIds) {
+        ids << reviewId;
+    }
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QSqlQuery query;
+    query.prepare("UPDATE metric_review_queue SET resolved = 1 WHERE review_id = ?");
+    query.addBindValue(ids);
+    if (!query.execBatch()) {
+        qCritical() << "Error al marcar la cola de revisión:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar la cola de revisión:" << db.lastError().text();
+        return false;
+    }
+    qInfo() << reviewIds.size() << "entradas de la cola de revisión marcadas como revisadas.";
+    return true;
+}
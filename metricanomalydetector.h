@@ -0,0 +1,77 @@
+#ifndef METRICANOMALYDETECTOR_H
+#define METRICANOMALYDETECTOR_H
+
+#include <QDate>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QSqlDatabase>
+#include <functional>
+#include "healtmetric.h"
+
+// Detección de mediciones improbables o con errores de tecleo (7,5 en lugar de 75, altura en metros...).
+// Cada medición se compara con las estadísticas robustas del historial reciente del paciente
+// (mediana y MAD de las últimas mediciones) y con ritmos de cambio fisiológicamente posibles.
+//  - check(): una medición nueva o editada, antes de guardarla (AddMetricDialog).
+//  - sweepAll(): revisa toda la tabla health_metrics en paralelo y rellena 'metric_review_queue'.
+//  - sweepUsers(): lo mismo para los pacientes de una importación masiva, que no pasa por check().
+//  - pendingReviews() / resolveReviews(): lista de la cola y marcado como revisadas (MainWindow).
+class MetricAnomalyDetector
+{
+public:
+    enum Severity {
+        Warning,  // Poco habitual; conviene revisarlo
+        Critical  // Casi seguro un error de introducción
+    };
+
+    struct Finding {
+        QString rule;    // Comprobación que lo detecta ("weight_decimal", "height_units"...); una por medición en la cola
+        QString field;   // "weight", "height", "bmi", "body_fat_percentage", "muscle_mass_percentage"
+        Severity severity = Warning;
+        QString message;
+    };
+
+    // Entrada pendiente de la cola de revisión
+    struct ReviewEntry {
+        int reviewId = -1;
+        int metricId = -1;
+        int userId = -1;
+        QString patientName;
+        QDate date;
+        Finding finding;
+    };
+
+    // Mediciones leídas y total durante la revisión; devuelve false para cancelarla (la cola no se toca)
+    using Progress = std::function<bool(qint64 done, qint64 total)>;
+
+    // Número de mediciones previas que forman la referencia robusta
+    static const int kWindow = 10;
+
+    // Comprueba 'candidate' contra 'history' (mediciones del mismo paciente en cualquier orden).
+    // Las mediciones con el mismo id que el candidato se ignoran (edición).
+    static QList<Finding> check(const HealthMetric& candidate, const QList<HealthMetric>& history,
+                                const QDate& birthDate);
+
+    // Revisión de toda la clínica. Solo se añaden a la cola los avisos nuevos (uno por medición y
+    // regla): los ya marcados como revisados no vuelven a aparecer, y los pendientes que ya no se
+    // detectan (medición corregida o borrada) se quitan. Retorna el número de entradas pendientes
+    // tras la revisión o -1 si hay un error o se cancela.
+    // 'db' permite revisar desde un hilo de trabajo con su propia conexión.
+    static int sweepAll(const QSqlDatabase& db = QSqlDatabase::database(), const Progress& progress = Progress());
+    // Lo mismo solo para unos pacientes (tras una importación masiva, ver main.cpp)
+    static int sweepUsers(const QList<int>& userIds, const QSqlDatabase& db = QSqlDatabase::database());
+
+    // Entradas sin revisar, las más graves y recientes primero
+    static QList<ReviewEntry> pendingReviews();
+    // Marca las entradas como revisadas; no se vuelven a mostrar aunque la medición siga igual
+    static bool resolveReviews(const QList<int>& reviewIds);
+
+    // Texto legible de la lista de avisos (para los mensajes al usuario)
+    static QString describe(const QList<Finding>& findings);
+
+    // Comprobación sobre la ventana previa ya ordenada por fecha (núcleo común de check y sweepAll)
+    static QList<Finding> checkAgainstWindow(const HealthMetric& candidate, const QVector<HealthMetric>& previous,
+                                             const QDate& birthDate);
+};
+
+#endif // METRICANOMALYDETECTOR_H
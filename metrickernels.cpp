@@ -0,0 +1,468 @@
+#include "metrickernels.h"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define METRICKERNELS_X86_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define METRICKERNELS_X86_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define METRICKERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Tabla de funciones de la implementación elegida
+struct KernelTable {
+    const char* name;
+    void (*bmi)(const double*, const double*, double*, std::size_t);
+    void (*minMax)(const double*, std::size_t, double&, double&); // n > 0
+    double (*sum)(const double*, std::size_t);
+    void (*crossDeviations)(const double*, const double*, std::size_t, double, double, double&, double&);
+    void (*addScaled)(double*, const double*, std::size_t, double);
+};
+
+// ---------------------------------------------------------------------------
+// Escalar (referencia y resto de los bucles vectoriales)
+// ---------------------------------------------------------------------------
+
+void bmiScalar(const double* w, const double* h, double* out, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        const double meters = h[i] * 0.01;
+        out[i] = (w[i] > 0.0 && h[i] > 0.0) ? w[i] / (meters * meters) : 0.0;
+    }
+}
+
+void minMaxScalar(const double* v, std::size_t n, double& minOut, double& maxOut)
+{
+    double lo = v[0];
+    double hi = v[0];
+    for (std::size_t i = 1; i < n; ++i) {
+        lo = std::min(lo, v[i]);
+        hi = std::max(hi, v[i]);
+    }
+    minOut = lo;
+    maxOut = hi;
+}
+
+double sumScalar(const double* v, std::size_t n)
+{
+    double total = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        total += v[i];
+    }
+    return total;
+}
+
+void crossDeviationsScalar(const double* x, const double* y, std::size_t n, double mx, double my,
+                           double& sxx, double& sxy)
+{
+    double xx = 0.0;
+    double xy = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const double dx = x[i] - mx;
+        xx += dx * dx;
+        xy += dx * (y[i] - my);
+    }
+    sxx = xx;
+    sxy = xy;
+}
+
+void addScaledScalar(double* acc, const double* v, std::size_t n, double k)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        acc[i] += v[i] * k;
+    }
+}
+
+const KernelTable kScalarTable = {
+    "scalar", bmiScalar, minMaxScalar, sumScalar, crossDeviationsScalar, addScaledScalar
+};
+
+// ---------------------------------------------------------------------------
+// SSE2 (2 doubles por registro)
+// ---------------------------------------------------------------------------
+#ifdef METRICKERNELS_X86_SSE2
+
+inline double horizontalSum(__m128d v)
+{
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+void bmiSse2(const double* w, const double* h, double* out, std::size_t n)
+{
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d toMeters = _mm_set1_pd(0.01);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const __m128d weight = _mm_loadu_pd(w + i);
+        const __m128d height = _mm_loadu_pd(h + i);
+        const __m128d meters = _mm_mul_pd(height, toMeters);
+        const __m128d bmi = _mm_div_pd(weight, _mm_mul_pd(meters, meters));
+        const __m128d valid = _mm_and_pd(_mm_cmpgt_pd(weight, zero), _mm_cmpgt_pd(height, zero));
+        _mm_storeu_pd(out + i, _mm_and_pd(valid, bmi));
+    }
+    bmiScalar(w + i, h + i, out + i, n - i);
+}
+
+void minMaxSse2(const double* v, std::size_t n, double& minOut, double& maxOut)
+{
+    if (n < 2) {
+        minMaxScalar(v, n, minOut, maxOut);
+        return;
+    }
+    __m128d lo = _mm_loadu_pd(v);
+    __m128d hi = lo;
+    std::size_t i = 2;
+    for (; i + 2 <= n; i += 2) {
+        const __m128d x = _mm_loadu_pd(v + i);
+        lo = _mm_min_pd(lo, x);
+        hi = _mm_max_pd(hi, x);
+    }
+    double los[2];
+    double his[2];
+    _mm_storeu_pd(los, lo);
+    _mm_storeu_pd(his, hi);
+    double l = std::min(los[0], los[1]);
+    double h = std::max(his[0], his[1]);
+    for (; i < n; ++i) {
+        l = std::min(l, v[i]);
+        h = std::max(h, v[i]);
+    }
+    minOut = l;
+    maxOut = h;
+}
+
+double sumSse2(const double* v, std::size_t n)
+{
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(v + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(v + i + 2));
+    }
+    return horizontalSum(_mm_add_pd(acc0, acc1)) + sumScalar(v + i, n - i);
+}
+
+void crossDeviationsSse2(const double* x, const double* y, std::size_t n, double mx, double my,
+                         double& sxx, double& sxy)
+{
+    const __m128d vmx = _mm_set1_pd(mx);
+    const __m128d vmy = _mm_set1_pd(my);
+    __m128d xx = _mm_setzero_pd();
+    __m128d xy = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), vmx);
+        const __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), vmy);
+        xx = _mm_add_pd(xx, _mm_mul_pd(dx, dx));
+        xy = _mm_add_pd(xy, _mm_mul_pd(dx, dy));
+    }
+    double tailXx = 0.0;
+    double tailXy = 0.0;
+    crossDeviationsScalar(x + i, y + i, n - i, mx, my, tailXx, tailXy);
+    sxx = horizontalSum(xx) + tailXx;
+    sxy = horizontalSum(xy) + tailXy;
+}
+
+void addScaledSse2(double* acc, const double* v, std::size_t n, double k)
+{
+    const __m128d scale = _mm_set1_pd(k);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(acc + i, _mm_add_pd(_mm_loadu_pd(acc + i), _mm_mul_pd(_mm_loadu_pd(v + i), scale)));
+    }
+    addScaledScalar(acc + i, v + i, n - i, k);
+}
+
+const KernelTable kSse2Table = {
+    "sse2", bmiSse2, minMaxSse2, sumSse2, crossDeviationsSse2, addScaledSse2
+};
+
+#endif // METRICKERNELS_X86_SSE2
+
+// ---------------------------------------------------------------------------
+// AVX2 (4 doubles por registro). Se compila con el atributo target para no exigir
+// -mavx2 en todo el proyecto; solo se usa si la CPU lo soporta.
+// ---------------------------------------------------------------------------
+#ifdef METRICKERNELS_X86_AVX2
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET inline double horizontalSum256(__m256d v)
+{
+    const __m128d low = _mm256_castpd256_pd128(v);
+    const __m128d high = _mm256_extractf128_pd(v, 1);
+    const __m128d pair = _mm_add_pd(low, high);
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+AVX2_TARGET void bmiAvx2(const double* w, const double* h, double* out, std::size_t n)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d toMeters = _mm256_set1_pd(0.01);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d weight = _mm256_loadu_pd(w + i);
+        const __m256d height = _mm256_loadu_pd(h + i);
+        const __m256d meters = _mm256_mul_pd(height, toMeters);
+        const __m256d bmi = _mm256_div_pd(weight, _mm256_mul_pd(meters, meters));
+        const __m256d valid = _mm256_and_pd(_mm256_cmp_pd(weight, zero, _CMP_GT_OQ),
+                                            _mm256_cmp_pd(height, zero, _CMP_GT_OQ));
+        _mm256_storeu_pd(out + i, _mm256_and_pd(valid, bmi));
+    }
+    bmiScalar(w + i, h + i, out + i, n - i);
+}
+
+AVX2_TARGET void minMaxAvx2(const double* v, std::size_t n, double& minOut, double& maxOut)
+{
+    if (n < 4) {
+        minMaxScalar(v, n, minOut, maxOut);
+        return;
+    }
+    __m256d lo = _mm256_loadu_pd(v);
+    __m256d hi = lo;
+    std::size_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d x = _mm256_loadu_pd(v + i);
+        lo = _mm256_min_pd(lo, x);
+        hi = _mm256_max_pd(hi, x);
+    }
+    double los[4];
+    double his[4];
+    _mm256_storeu_pd(los, lo);
+    _mm256_storeu_pd(his, hi);
+    double l = std::min(std::min(los[0], los[1]), std::min(los[2], los[3]));
+    double h = std::max(std::max(his[0], his[1]), std::max(his[2], his[3]));
+    for (; i < n; ++i) {
+        l = std::min(l, v[i]);
+        h = std::max(h, v[i]);
+    }
+    minOut = l;
+    maxOut = h;
+}
+
+AVX2_TARGET double sumAvx2(const double* v, std::size_t n)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(v + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(v + i + 4));
+    }
+    return horizontalSum256(_mm256_add_pd(acc0, acc1)) + sumScalar(v + i, n - i);
+}
+
+AVX2_TARGET void crossDeviationsAvx2(const double* x, const double* y, std::size_t n, double mx, double my,
+                                     double& sxx, double& sxy)
+{
+    const __m256d vmx = _mm256_set1_pd(mx);
+    const __m256d vmy = _mm256_set1_pd(my);
+    __m256d xx = _mm256_setzero_pd();
+    __m256d xy = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), vmx);
+        const __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), vmy);
+        xx = _mm256_add_pd(xx, _mm256_mul_pd(dx, dx));
+        xy = _mm256_add_pd(xy, _mm256_mul_pd(dx, dy));
+    }
+    double tailXx = 0.0;
+    double tailXy = 0.0;
+    crossDeviationsScalar(x + i, y + i, n - i, mx, my, tailXx, tailXy);
+    sxx = horizontalSum256(xx) + tailXx;
+    sxy = horizontalSum256(xy) + tailXy;
+}
+
+AVX2_TARGET void addScaledAvx2(double* acc, const double* v, std::size_t n, double k)
+{
+    const __m256d scale = _mm256_set1_pd(k);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(acc + i, _mm256_add_pd(_mm256_loadu_pd(acc + i), _mm256_mul_pd(_mm256_loadu_pd(v + i), scale)));
+    }
+    addScaledScalar(acc + i, v + i, n - i, k);
+}
+
+const KernelTable kAvx2Table = {
+    "avx2", bmiAvx2, minMaxAvx2, sumAvx2, crossDeviationsAvx2, addScaledAvx2
+};
+
+#endif // METRICKERNELS_X86_AVX2
+
+// ---------------------------------------------------------------------------
+// NEON (AArch64, 2 doubles por registro; siempre disponible en esa arquitectura)
+// ---------------------------------------------------------------------------
+#ifdef METRICKERNELS_NEON
+
+void bmiNeon(const double* w, const double* h, double* out, std::size_t n)
+{
+    const float64x2_t zero = vdupq_n_f64(0.0);
+    const float64x2_t toMeters = vdupq_n_f64(0.01);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const float64x2_t weight = vld1q_f64(w + i);
+        const float64x2_t height = vld1q_f64(h + i);
+        const float64x2_t meters = vmulq_f64(height, toMeters);
+        const float64x2_t bmi = vdivq_f64(weight, vmulq_f64(meters, meters));
+        const uint64x2_t valid = vandq_u64(vcgtq_f64(weight, zero), vcgtq_f64(height, zero));
+        vst1q_f64(out + i, vreinterpretq_f64_u64(vandq_u64(valid, vreinterpretq_u64_f64(bmi))));
+    }
+    bmiScalar(w + i, h + i, out + i, n - i);
+}
+
+void minMaxNeon(const double* v, std::size_t n, double& minOut, double& maxOut)
+{
+    if (n < 2) {
+        minMaxScalar(v, n, minOut, maxOut);
+        return;
+    }
+    float64x2_t lo = vld1q_f64(v);
+    float64x2_t hi = lo;
+    std::size_t i = 2;
+    for (; i + 2 <= n; i += 2) {
+        const float64x2_t x = vld1q_f64(v + i);
+        lo = vminq_f64(lo, x);
+        hi = vmaxq_f64(hi, x);
+    }
+    double l = vminvq_f64(lo);
+    double h = vmaxvq_f64(hi);
+    for (; i < n; ++i) {
+        l = std::min(l, v[i]);
+        h = std::max(h, v[i]);
+    }
+    minOut = l;
+    maxOut = h;
+}
+
+double sumNeon(const double* v, std::size_t n)
+{
+    float64x2_t acc0 = vdupq_n_f64(0.0);
+    float64x2_t acc1 = vdupq_n_f64(0.0);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = vaddq_f64(acc0, vld1q_f64(v + i));
+        acc1 = vaddq_f64(acc1, vld1q_f64(v + i + 2));
+    }
+    return vaddvq_f64(vaddq_f64(acc0, acc1)) + sumScalar(v + i, n - i);
+}
+
+void crossDeviationsNeon(const double* x, const double* y, std::size_t n, double mx, double my,
+                         double& sxx, double& sxy)
+{
+    const float64x2_t vmx = vdupq_n_f64(mx);
+    const float64x2_t vmy = vdupq_n_f64(my);
+    float64x2_t xx = vdupq_n_f64(0.0);
+    float64x2_t xy = vdupq_n_f64(0.0);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const float64x2_t dx = vsubq_f64(vld1q_f64(x + i), vmx);
+        const float64x2_t dy = vsubq_f64(vld1q_f64(y + i), vmy);
+        xx = vfmaq_f64(xx, dx, dx);
+        xy = vfmaq_f64(xy, dx, dy);
+    }
+    double tailXx = 0.0;
+    double tailXy = 0.0;
+    crossDeviationsScalar(x + i, y + i, n - i, mx, my, tailXx, tailXy);
+    sxx = vaddvq_f64(xx) + tailXx;
+    sxy = vaddvq_f64(xy) + tailXy;
+}
+
+void addScaledNeon(double* acc, const double* v, std::size_t n, double k)
+{
+    const float64x2_t scale = vdupq_n_f64(k);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        vst1q_f64(acc + i, vfmaq_f64(vld1q_f64(acc + i), vld1q_f64(v + i), scale));
+    }
+    addScaledScalar(acc + i, v + i, n - i, k);
+}
+
+const KernelTable kNeonTable = {
+    "neon", bmiNeon, minMaxNeon, sumNeon, crossDeviationsNeon, addScaledNeon
+};
+
+#endif // METRICKERNELS_NEON
+
+const KernelTable& selectTable()
+{
+#ifdef METRICKERNELS_X86_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return kAvx2Table;
+    }
+#endif
+#ifdef METRICKERNELS_X86_SSE2
+    return kSse2Table;
+#elif defined(METRICKERNELS_NEON)
+    return kNeonTable;
+#else
+    return kScalarTable;
+#endif
+}
+
+// Se resuelve una sola vez (inicialización de estáticos locales segura entre hilos)
+const KernelTable& table()
+{
+    static const KernelTable& selected = selectTable();
+    return selected;
+}
+
+} // namespace
+
+void MetricKernels::bmiBatch(const double* weightKg, const double* heightCm, double* bmiOut, std::size_t n)
+{
+    table().bmi(weightKg, heightCm, bmiOut, n);
+}
+
+bool MetricKernels::minMax(const double* values, std::size_t n, double& minOut, double& maxOut)
+{
+    if (n == 0) {
+        return false;
+    }
+    table().minMax(values, n, minOut, maxOut);
+    return true;
+}
+
+double MetricKernels::sum(const double* values, std::size_t n)
+{
+    return table().sum(values, n);
+}
+
+double MetricKernels::mean(const double* values, std::size_t n)
+{
+    return n > 0 ? table().sum(values, n) / double(n) : 0.0;
+}
+
+void MetricKernels::addScaled(double* accumulator, const double* values, std::size_t n, double factor)
+{
+    table().addScaled(accumulator, values, n, factor);
+}
+
+double MetricKernels::slope(const double* x, const double* y, std::size_t n)
+{
+    if (n < 2) {
+        return 0.0;
+    }
+    // Centrar en las medias evita la cancelación al usar días julianos (~2,46 millones)
+    const double mx = mean(x, n);
+    const double my = mean(y, n);
+    double sxx = 0.0;
+    double sxy = 0.0;
+    table().crossDeviations(x, y, n, mx, my, sxx, sxy);
+    return sxx > 0.0 ? sxy / sxx : 0.0;
+}
+
+const char* MetricKernels::activePath()
+{
+    return table().name;
+}
@@ -0,0 +1,35 @@
+#ifndef METRICKERNELS_H
+#define METRICKERNELS_H
+
+#include <cstddef>
+
+// Núcleos de cálculo vectorizados sobre arrays contiguos de double.
+// Al primer uso se elige la mejor implementación disponible en la CPU
+// (AVX2 o SSE2 en x86, NEON en ARM) y, si no hay ninguna, la escalar.
+// Todas las variantes dan el mismo resultado salvo redondeos del orden de la precisión de double.
+// No dependen de Qt para poder usarse desde hilos de cálculo sin restricciones.
+class MetricKernels
+{
+public:
+    // IMC = peso (kg) / (altura (m))^2 con la altura en cm; 0 si peso o altura no son positivos
+    // (mismo criterio que HealthMetric::calculateBmi)
+    static void bmiBatch(const double* weightKg, const double* heightCm, double* bmiOut, std::size_t n);
+
+    // Mínimo y máximo; con n == 0 no modifica las salidas y retorna false
+    static bool minMax(const double* values, std::size_t n, double& minOut, double& maxOut);
+
+    static double sum(const double* values, std::size_t n);
+    static double mean(const double* values, std::size_t n);
+
+    // Acumulación escalada: accumulator[i] += factor * values[i] (suma de vectores de nutrientes)
+    static void addScaled(double* accumulator, const double* values, std::size_t n, double factor);
+
+    // Pendiente de la recta de mínimos cuadrados y = a + b*x (x suele ser el día juliano).
+    // Retorna 0 si hay menos de dos puntos o todas las x son iguales.
+    static double slope(const double* x, const double* y, std::size_t n);
+
+    // Nombre de la implementación elegida ("avx2", "sse2", "neon" o "scalar")
+    static const char* activePath();
+};
+
+#endif // METRICKERNELS_H
@@ -0,0 +1,417 @@
+#include "metricrollups.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <tuple>
+
+namespace {
+
+const MetricRollups::Level kRollupLevels[] = { MetricRollups::Week, MetricRollups::Month, MetricRollups::Year };
+
+// Días aproximados de un periodo de cada nivel (para elegir el nivel)
+double periodDays(MetricRollups::Level level)
+{
+    switch (level) {
+    case MetricRollups::Raw: return 1.0;
+    case MetricRollups::Week: return 7.0;
+    case MetricRollups::Month: return 30.44;
+    case MetricRollups::Year: return 365.25;
+    }
+    return 1.0;
+}
+
+// Acumulador de un periodo (lo que se guarda en una fila de health_metric_rollups)
+struct Bucket {
+    int count = 0;
+    double weightMin = 0.0;
+    double weightMax = 0.0;
+    double weightSum = 0.0;
+    double weightLast = 0.0;
+    int bmiCount = 0;
+    double bmiMin = 0.0;
+    double bmiMax = 0.0;
+    double bmiSum = 0.0;
+    double bmiLast = 0.0;
+    QDate lastDate;
+
+    // Las mediciones llegan en orden de fecha salvo en las altas, donde 'last' solo avanza.
+    // Sin altura el IMC es 0: cuenta para el peso pero no para el mínimo ni la media del IMC.
+    void add(const QDate& date, double weight, double bmi)
+    {
+        const bool latest = !lastDate.isValid() || date >= lastDate;
+        if (count == 0) {
+            weightMin = weightMax = weight;
+        } else {
+            weightMin = qMin(weightMin, weight);
+            weightMax = qMax(weightMax, weight);
+        }
+        weightSum += weight;
+        ++count;
+        if (bmi > 0.0) {
+            if (bmiCount == 0) {
+                bmiMin = bmiMax = bmiLast = bmi;
+            } else {
+                bmiMin = qMin(bmiMin, bmi);
+                bmiMax = qMax(bmiMax, bmi);
+            }
+            bmiSum += bmi;
+            ++bmiCount;
+        }
+        if (latest) {
+            lastDate = date;
+            weightLast = weight;
+            if (bmi > 0.0) {
+                bmiLast = bmi;
+            }
+        }
+    }
+};
+
+bool saveBucket(int userId, MetricRollups::Level level, const QDate& start, const Bucket& bucket,
+                const QSqlDatabase& db = QSqlDatabase::database())
+{
+    QSqlQuery query(db);
+    if (bucket.count == 0) {
+        query.prepare("DELETE FROM health_metric_rollups WHERE user_id = :user_id AND level = :level AND bucket_start = :bucket_start");
+    } else {
+        // REPLACE INTO lo admiten tanto SQLite como MariaDB
+        query.prepare("REPLACE INTO health_metric_rollups "
+                      "(user_id, level, bucket_start, sample_count, weight_min, weight_max, weight_sum, weight_last, "
+                      "bmi_count, bmi_min, bmi_max, bmi_sum, bmi_last, last_date) "
+                      "VALUES (:user_id, :level, :bucket_start, :sample_count, :weight_min, :weight_max, :weight_sum, :weight_last, "
+                      ":bmi_count, :bmi_min, :bmi_max, :bmi_sum, :bmi_last, :last_date)");
+        query.bindValue(":sample_count", bucket.count);
+        query.bindValue(":weight_min", bucket.weightMin);
+        query.bindValue(":weight_max", bucket.weightMax);
+        query.bindValue(":weight_sum", bucket.weightSum);
+        query.bindValue(":weight_last", bucket.weightLast);
+        query.bindValue(":bmi_count", bucket.bmiCount);
+        query.bindValue(":bmi_min", bucket.bmiMin);
+        query.bindValue(":bmi_max", bucket.bmiMax);
+        query.bindValue(":bmi_sum", bucket.bmiSum);
+        query.bindValue(":bmi_last", bucket.bmiLast);
+        query.bindValue(":last_date", bucket.lastDate.toString(Qt::ISODate));
+    }
+    query.bindValue(":user_id", userId);
+    query.bindValue(":level", int(level));
+    query.bindValue(":bucket_start", start.toString(Qt::ISODate));
+    if (!query.exec()) {
+        qCritical() << "Error al guardar el resumen de métricas del usuario" << userId << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+QDate MetricRollups::periodStart(Level level, const QDate& date)
+{
+    switch (level) {
+    case Raw: return date;
+    case Week: return date.addDays(1 - date.dayOfWeek());
+    case Month: return QDate(date.year(), date.month(), 1);
+    case Year: return QDate(date.year(), 1, 1);
+    }
+    return date;
+}
+
+QDate MetricRollups::periodEnd(Level level, const QDate& date)
+{
+    const QDate start = periodStart(level, date);
+    switch (level) {
+    case Raw: return start.addDays(1);
+    case Week: return start.addDays(7);
+    case Month: return start.addMonths(1);
+    case Year: return start.addYears(1);
+    }
+    return start.addDays(1);
+}
+
+MetricRollups::Level MetricRollups::levelFor(const QDate& from, const QDate& to, int pixelWidth)
+{
+    if (!from.isValid() || !to.isValid() || pixelWidth <= 0) {
+        return Raw;
+    }
+    const double points = qMax(1.0, double(pixelWidth) / kPixelsPerPoint);
+    const double daysPerPoint = double(from.daysTo(to) + 1) / points;
+    Level level = Raw;
+    for (Level candidate : kRollupLevels) {
+        if (periodDays(candidate) <= daysPerPoint) {
+            level = candidate;
+        }
+    }
+    return level;
+}
+
+bool MetricRollups::dateRange(int userId, QDate& from, QDate& to)
+{
+    QSqlQuery query;
+    query.prepare("SELECT MIN(date), MAX(date) FROM health_metrics WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al leer el rango de fechas del usuario" << userId << ":" << query.lastError().text();
+        return false;
+    }
+    if (!query.next() || query.value(0).isNull()) {
+        return false;
+    }
+    from = QDate::fromString(query.value(0).toString(), Qt::ISODate);
+    to = QDate::fromString(query.value(1).toString(), Qt::ISODate);
+    return true;
+}
+
+QVector<MetricRollups::Point> MetricRollups::series(int userId, QDate from, QDate to, int pixelWidth, Level* usedLevel)
+{
+    QVector<Point> points;
+    QSqlQuery query;
+
+    if (!from.isValid() || !to.isValid()) {
+        // Historial completo: el rango sale del índice (user_id, date)
+        QDate first;
+        QDate last;
+        if (!dateRange(userId, first, last)) {
+            return points;
+        }
+        from = from.isValid() ? from : first;
+        to = to.isValid() ? to : last;
+    }
+
+    const Level level = levelFor(from, to, pixelWidth);
+    if (usedLevel) {
+        *usedLevel = level;
+    }
+
+    if (level == Raw) {
+        query.prepare("SELECT date, weight, bmi FROM health_metrics "
+                      "WHERE user_id = :user_id AND date >= :from AND date <= :to ORDER BY date, created_at");
+        query.bindValue(":user_id", userId);
+        query.bindValue(":from", from.toString(Qt::ISODate));
+        query.bindValue(":to", to.toString(Qt::ISODate));
+        if (!query.exec()) {
+            qCritical() << "Error al leer la serie del usuario" << userId << ":" << query.lastError().text();
+            return points;
+        }
+        while (query.next()) {
+            Point point;
+            point.start = point.lastDate = QDate::fromString(query.value(0).toString(), Qt::ISODate);
+            point.count = 1;
+            point.weightMin = point.weightMax = point.weightMean = point.weightLast = query.value(1).toDouble();
+            point.bmiMin = point.bmiMax = point.bmiMean = point.bmiLast = query.value(2).toDouble();
+            point.bmiCount = point.bmiMean > 0.0 ? 1 : 0;
+            points.append(point);
+        }
+        return points;
+    }
+
+    query.prepare("SELECT bucket_start, last_date, sample_count, weight_min, weight_max, weight_sum, weight_last, "
+                  "bmi_min, bmi_max, bmi_sum, bmi_last, bmi_count FROM health_metric_rollups "
+                  "WHERE user_id = :user_id AND level = :level AND bucket_start >= :from AND bucket_start <= :to "
+                  "ORDER BY bucket_start");
+    query.bindValue(":user_id", userId);
+    query.bindValue(":level", int(level));
+    query.bindValue(":from", periodStart(level, from).toString(Qt::ISODate));
+    query.bindValue(":to", to.toString(Qt::ISODate));
+    if (!query.exec()) {
+        qCritical() << "Error al leer los resúmenes del usuario" << userId << ":" << query.lastError().text();
+        return points;
+    }
+    while (query.next()) {
+        Point point;
+        point.start = QDate::fromString(query.value(0).toString(), Qt::ISODate);
+        point.lastDate = QDate::fromString(query.value(1).toString(), Qt::ISODate);
+        point.count = query.value(2).toInt();
+        point.weightMin = query.value(3).toDouble();
+        point.weightMax = query.value(4).toDouble();
+        point.weightMean = point.count > 0 ? query.value(5).toDouble() / point.count : 0.0;
+        point.weightLast = query.value(6).toDouble();
+        point.bmiMin = query.value(7).toDouble();
+        point.bmiMax = query.value(8).toDouble();
+        point.bmiCount = query.value(11).toInt();
+        point.bmiMean = point.bmiCount > 0 ? query.value(9).toDouble() / point.bmiCount : 0.0;
+        point.bmiLast = query.value(10).toDouble();
+        points.append(point);
+    }
+    return points;
+}
+
+bool MetricRollups::addMeasurement(int userId, const QDate& date, double weight, double bmi)
+{
+    if (!date.isValid()) {
+        return false;
+    }
+    QSqlQuery query;
+    for (Level level : kRollupLevels) {
+        const QDate start = periodStart(level, date);
+        query.prepare("SELECT sample_count, weight_min, weight_max, weight_sum, weight_last, "
+                      "bmi_min, bmi_max, bmi_sum, bmi_last, last_date, bmi_count FROM health_metric_rollups "
+                      "WHERE user_id = :user_id AND level = :level AND bucket_start = :bucket_start");
+        query.bindValue(":user_id", userId);
+        query.bindValue(":level", int(level));
+        query.bindValue(":bucket_start", start.toString(Qt::ISODate));
+        if (!query.exec()) {
+            qCritical() << "Error al leer el resumen de métricas del usuario" << userId << ":" << query.lastError().text();
+            return false;
+        }
+        Bucket bucket;
+        if (query.next()) {
+            bucket.count = query.value(0).toInt();
+            bucket.weightMin = query.value(1).toDouble();
+            bucket.weightMax = query.value(2).toDouble();
+            bucket.weightSum = query.value(3).toDouble();
+            bucket.weightLast = query.value(4).toDouble();
+            bucket.bmiMin = query.value(5).toDouble();
+            bucket.bmiMax = query.value(6).toDouble();
+            bucket.bmiSum = query.value(7).toDouble();
+            bucket.bmiLast = query.value(8).toDouble();
+            bucket.lastDate = QDate::fromString(query.value(9).toString(), Qt::ISODate);
+            bucket.bmiCount = query.value(10).toInt();
+        }
+        bucket.add(date, weight, bmi);
+        if (!saveBucket(userId, level, start, bucket)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MetricRollups::refreshPeriods(int userId, const QDate& date)
+{
+    if (!date.isValid()) {
+        return false;
+    }
+    QSqlQuery query;
+    for (Level level : kRollupLevels) {
+        const QDate start = periodStart(level, date);
+        query.prepare("SELECT date, weight, bmi FROM health_metrics "
+                      "WHERE user_id = :user_id AND date >= :from AND date < :to ORDER BY date, created_at");
+        query.bindValue(":user_id", userId);
+        query.bindValue(":from", start.toString(Qt::ISODate));
+        query.bindValue(":to", periodEnd(level, date).toString(Qt::ISODate));
+        if (!query.exec()) {
+            qCritical() << "Error al recalcular el resumen de métricas del usuario" << userId << ":" << query.lastError().text();
+            return false;
+        }
+        Bucket bucket;
+        while (query.next()) {
+            bucket.add(QDate::fromString(query.value(0).toString(), Qt::ISODate), query.value(1).toDouble(), query.value(2).toDouble());
+        }
+        if (!saveBucket(userId, level, start, bucket)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MetricRollups::refreshRange(int userId, const QDate& from, const QDate& to, const QSqlDatabase& db)
+{
+    if (!from.isValid() || !to.isValid() || to < from) {
+        return false;
+    }
+    // Una sola lectura que cubre enteros todos los periodos de cualquier nivel que tocan [from, to]:
+    // la semana de 'from' puede empezar el año anterior y la de 'to' acabar en el siguiente
+    const QDate readFrom = qMin(periodStart(Week, from), periodStart(Year, from));
+    const QDate readTo = qMax(periodEnd(Week, to), periodEnd(Year, to));
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT date, weight, bmi FROM health_metrics "
+                  "WHERE user_id = :user_id AND date >= :from AND date < :to ORDER BY date, created_at");
+    query.bindValue(":user_id", userId);
+    query.bindValue(":from", readFrom.toString(Qt::ISODate));
+    query.bindValue(":to", readTo.toString(Qt::ISODate));
+    if (!query.exec()) {
+        qCritical() << "Error al recalcular los resúmenes de métricas del usuario" << userId << ":" << query.lastError().text();
+        return false;
+    }
+    QMap<std::pair<int, QDate>, Bucket> buckets;
+    while (query.next()) {
+        const QDate date = QDate::fromString(query.value(0).toString(), Qt::ISODate);
+        if (!date.isValid()) {
+            continue;
+        }
+        for (Level level : kRollupLevels) {
+            buckets[std::make_pair(int(level), periodStart(level, date))]
+                .add(date, query.value(1).toDouble(), query.value(2).toDouble());
+        }
+    }
+    query.finish();
+
+    // Solo se guardan los periodos que contienen alguna fecha de [from, to]; los de los bordes
+    // de la lectura (parte del año anterior, por ejemplo) están incompletos y no han cambiado
+    for (auto it = buckets.cbegin(); it != buckets.cend(); ++it) {
+        const Level level = Level(it.key().first);
+        const QDate& start = it.key().second;
+        if (start < periodStart(level, from) || start > periodStart(level, to)) {
+            continue;
+        }
+        if (!saveBucket(userId, level, start, it.value(), db)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MetricRollups::removeUserData(int userId)
+{
+    QSqlQuery query;
+    query.prepare("DELETE FROM health_metric_rollups WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al borrar los resúmenes de métricas del usuario" << userId << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool MetricRollups::rebuildAll()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT user_id, date, weight, bmi FROM health_metrics ORDER BY user_id, date, created_at")) {
+        qCritical() << "Error al leer las métricas para los resúmenes:" << query.lastError().text();
+        return false;
+    }
+    // Clave: (usuario, nivel, inicio del periodo); QMap mantiene el orden al escribir
+    QMap<std::tuple<int, int, QDate>, Bucket> buckets;
+    int rows = 0;
+    while (query.next()) {
+        const int userId = query.value(0).toInt();
+        const QDate date = QDate::fromString(query.value(1).toString(), Qt::ISODate);
+        if (!date.isValid()) {
+            continue;
+        }
+        for (Level level : kRollupLevels) {
+            buckets[std::make_tuple(userId, int(level), periodStart(level, date))]
+                .add(date, query.value(2).toDouble(), query.value(3).toDouble());
+        }
+        ++rows;
+    }
+    query.finish();
+
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    if (!query.exec("DELETE FROM health_metric_rollups")) {
+        qCritical() << "Error al vaciar los resúmenes de métricas:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    for (auto it = buckets.cbegin(); it != buckets.cend(); ++it) {
+        if (!saveBucket(std::get<0>(it.key()), Level(std::get<1>(it.key())), std::get<2>(it.key()), it.value())) {
+            db.rollback();
+            return false;
+        }
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar los resúmenes de métricas:" << db.lastError().text();
+        return false;
+    }
+
+    qInfo() << "Resúmenes de métricas reconstruidos:" << rows << "mediciones," << buckets.size() << "periodos en"
+            << timer.elapsed() << "ms";
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef METRICROLLUPS_H
+#define METRICROLLUPS_H
+
+#include <QDate>
+#include <QSqlDatabase>
+#include <QVector>
+
+// Resúmenes por paciente de peso e IMC a resolución semanal, mensual y anual
+// (tabla 'health_metric_rollups': mínimo, máximo, suma, número de mediciones y último valor).
+// HealthMetricManager los mantiene en cada escritura:
+//  - alta: se fusiona la medición con los tres periodos que la contienen, sin releer nada más;
+//  - edición o borrado: se recalculan solo los periodos afectados (fecha antigua y nueva).
+// series() elige automáticamente el nivel más grueso que sigue llenando el ancho en píxeles
+// pedido, de modo que diez años en una gráfica leen unas decenas de filas en lugar de miles.
+class MetricRollups
+{
+public:
+    enum Level {
+        Raw = 0,   // Mediciones individuales (health_metrics)
+        Week = 1,  // Semanas de lunes a domingo
+        Month = 2,
+        Year = 3
+    };
+
+    struct Point {
+        QDate start;         // Inicio del periodo (o fecha de la medición en Raw)
+        QDate lastDate;      // Fecha de la última medición del periodo
+        int count = 0;
+        double weightMin = 0.0;
+        double weightMax = 0.0;
+        double weightMean = 0.0;
+        double weightLast = 0.0;
+        int bmiCount = 0;    // Mediciones con IMC (sin altura se guarda 0 y no cuenta)
+        double bmiMin = 0.0;
+        double bmiMax = 0.0;
+        double bmiMean = 0.0;
+        double bmiLast = 0.0;
+    };
+
+    // Píxeles mínimos por punto que se consideran legibles en una gráfica
+    static const int kPixelsPerPoint = 8;
+
+    // Nivel más grueso cuyos periodos no superan el tramo de días que representa un punto
+    static Level levelFor(const QDate& from, const QDate& to, int pixelWidth);
+
+    // Primera y última fecha con mediciones del paciente (índice (user_id, date)); false si no tiene
+    static bool dateRange(int userId, QDate& from, QDate& to);
+
+    // Serie del paciente entre from y to (ambos inválidos = todo su historial) para pixelWidth píxeles.
+    // usedLevel devuelve el nivel elegido.
+    static QVector<Point> series(int userId, QDate from, QDate to, int pixelWidth, Level* usedLevel = nullptr);
+
+    // Mantenimiento desde el camino de escritura de HealthMetricManager
+    static bool addMeasurement(int userId, const QDate& date, double weight, double bmi);
+    static bool refreshPeriods(int userId, const QDate& date);
+    // Recalcula todos los periodos (de cualquier nivel) que contienen alguna fecha de [from, to],
+    // con una sola lectura. No abre transacción: la importación masiva lo llama dentro de la de
+    // cada tanda, en la conexión de su hilo de escritura.
+    static bool refreshRange(int userId, const QDate& from, const QDate& to,
+                             const QSqlDatabase& db = QSqlDatabase::database());
+    // Baja de un paciente: sus resúmenes (no hay ON DELETE CASCADE efectivo en SQLite sin foreign_keys)
+    static bool removeUserData(int userId);
+
+    // Reconstrucción completa en una pasada (migración de bases de datos existentes)
+    static bool rebuildAll();
+
+    static QDate periodStart(Level level, const QDate& date);
+    static QDate periodEnd(Level level, const QDate& date); // Primer día del periodo siguiente
+};
+
+#endif // METRICROLLUPS_H
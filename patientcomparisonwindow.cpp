@@ -0,0 +1,226 @@
+#include "patientcomparisonwindow.h"
+#include "ui_patientcomparisonwindow.h"
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QAtomicInteger>
+#include <QtConcurrent>
+#include <QtCharts/QDateTimeAxis>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QValueAxis>
+#include <limits>
+
+namespace {
+
+// QSqlDatabase no se puede compartir entre hilos, así que cada tarea clona la conexión por defecto
+// con un nombre único y la elimina al terminar. El nombre no puede salir del ID del hilo: los hilos
+// del pool caducan, sus IDs se reutilizan y Qt devuelve inválida una conexión creada en otro hilo.
+QString nextConnectionName()
+{
+    static QAtomicInteger<quint64> counter;
+    return QString("comparison_%1").arg(counter.fetchAndAddRelaxed(1));
+}
+
+void readHistory(const QSqlDatabase& db, PatientComparisonWindow::History& history)
+{
+    const int userId = history.userId;
+    QSqlQuery query(db);
+    query.prepare("SELECT first_name, last_name1, last_name2 FROM users WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (query.exec() && query.next()) {
+        history.name = QString("%1 %2 %3").arg(query.value(0).toString(), query.value(1).toString(),
+                                               query.value(2).toString()).simplified();
+    }
+
+    query.setForwardOnly(true);
+    query.prepare("SELECT date, weight, bmi FROM health_metrics WHERE user_id = :user_id ORDER BY date, created_at");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al cargar el historial del usuario" << userId << ":" << query.lastError().text();
+        return;
+    }
+    while (query.next()) {
+        const QDate date = QDate::fromString(query.value(0).toString(), Qt::ISODate);
+        if (!date.isValid()) {
+            continue;
+        }
+        history.dates.append(date);
+        history.weights.append(query.value(1).toDouble());
+        history.bmis.append(query.value(2).toDouble());
+    }
+}
+
+} // namespace
+
+PatientComparisonWindow::PatientComparisonWindow(const QList<int>& userIds, QWidget *parent)
+    : QWidget(parent)
+    , ui(new Ui::PatientComparisonWindow)
+    , m_weightChart(new QChart())
+    , m_bmiChart(new QChart())
+{
+    ui->setupUi(this);
+
+    m_weightChart->setTitle("Evolución del peso (kg)");
+    m_bmiChart->setTitle("Evolución del IMC");
+    for (QChart *chart : { m_weightChart, m_bmiChart }) {
+        chart->legend()->setVisible(true);
+        chart->legend()->setAlignment(Qt::AlignRight);
+    }
+    ui->widgetWeight->setChart(m_weightChart);
+    ui->widgetWeight->setRenderHint(QPainter::Antialiasing);
+    ui->widgetBMI->setChart(m_bmiChart);
+    ui->widgetBMI->setRenderHint(QPainter::Antialiasing);
+
+    ui->alignmentComboBox->blockSignals(true);
+    ui->alignmentComboBox->addItem("Fecha", ByDate);
+    ui->alignmentComboBox->addItem("Días desde la primera visita", ByDaysSinceFirstVisit);
+    ui->alignmentComboBox->blockSignals(false);
+    ui->alignmentComboBox->setEnabled(false);
+
+    // Todos los historiales a la vez; la ventana se pinta cuando llega el último
+    ui->statusLabel->setText(QString("Cargando %1 pacientes...").arg(userIds.size()));
+    m_loadTimer.start();
+    connect(&m_watcher, &QFutureWatcher<History>::finished, this, &PatientComparisonWindow::onHistoriesLoaded);
+    m_watcher.setFuture(QtConcurrent::mapped(userIds, &PatientComparisonWindow::loadHistory));
+}
+
+PatientComparisonWindow::~PatientComparisonWindow()
+{
+    m_watcher.cancel();
+    m_watcher.waitForFinished();
+}
+
+PatientComparisonWindow::History PatientComparisonWindow::loadHistory(int userId)
+{
+    History history;
+    history.userId = userId;
+    history.name = QString("Paciente %1").arg(userId);
+
+    const QString connectionName = nextConnectionName();
+    {
+        QSqlDatabase db = QSqlDatabase::cloneDatabase(QString(QSqlDatabase::defaultConnection), connectionName);
+        if (db.open()) {
+            readHistory(db, history);
+        } else {
+            qCritical() << "Error al abrir la conexión" << connectionName << ":" << db.lastError().text();
+        }
+        db.close();
+    }
+    // Fuera del bloque: no queda ninguna QSqlDatabase ni QSqlQuery que use la conexión
+    QSqlDatabase::removeDatabase(connectionName);
+    return history;
+}
+
+void PatientComparisonWindow::onHistoriesLoaded()
+{
+    if (m_watcher.isCanceled()) {
+        return;
+    }
+    m_histories = m_watcher.future().results().toVector();
+    qInfo() << "Comparación:" << m_histories.size() << "historiales cargados en" << m_loadTimer.elapsed() << "ms";
+    int withData = 0;
+    for (const History& history : std::as_const(m_histories)) {
+        if (!history.dates.isEmpty()) {
+            ++withData;
+        }
+    }
+    ui->statusLabel->setText(QString("%1 pacientes, %2 con mediciones").arg(m_histories.size()).arg(withData));
+    ui->alignmentComboBox->setEnabled(true);
+    renderCharts(Alignment(ui->alignmentComboBox->currentData().toInt()));
+}
+
+void PatientComparisonWindow::on_alignmentComboBox_currentIndexChanged(int index)
+{
+    Q_UNUSED(index);
+    // Cambiar la alineación solo vuelve a pintar: los datos ya están en memoria
+    renderCharts(Alignment(ui->alignmentComboBox->currentData().toInt()));
+}
+
+void PatientComparisonWindow::renderCharts(Alignment alignment)
+{
+    renderChart(m_weightChart, alignment, false);
+    renderChart(m_bmiChart, alignment, true);
+}
+
+void PatientComparisonWindow::renderChart(QChart *chart, Alignment alignment, bool bmi)
+{
+    chart->removeAllSeries();
+    for (QAbstractAxis *axis : chart->axes()) {
+        chart->removeAxis(axis);
+        delete axis;
+    }
+
+    // Un único eje X para todos los pacientes: fecha en ms o días desde la primera visita
+    double minX = std::numeric_limits<double>::max();
+    double maxX = std::numeric_limits<double>::lowest();
+    double minY = std::numeric_limits<double>::max();
+    double maxY = std::numeric_limits<double>::lowest();
+    QList<QLineSeries*> seriesList;
+    const int count = int(m_histories.size());
+    for (int i = 0; i < count; ++i) {
+        const History& history = m_histories.at(i);
+        if (history.dates.isEmpty()) {
+            continue;
+        }
+        const QVector<double>& values = bmi ? history.bmis : history.weights;
+        QList<QPointF> points;
+        points.reserve(history.dates.size());
+        for (int k = 0; k < history.dates.size(); ++k) {
+            if (values.at(k) <= 0) {
+                continue;
+            }
+            const double x = (alignment == ByDate)
+                                 ? double(history.dates.at(k).startOfDay().toMSecsSinceEpoch())
+                                 : double(history.dates.first().daysTo(history.dates.at(k)));
+            points.append(QPointF(x, values.at(k)));
+            minX = qMin(minX, x);
+            maxX = qMax(maxX, x);
+            minY = qMin(minY, values.at(k));
+            maxY = qMax(maxY, values.at(k));
+        }
+        if (points.isEmpty()) {
+            continue;
+        }
+        QLineSeries *series = new QLineSeries(chart);
+        series->setName(history.name);
+        // El mismo color para el paciente en las dos gráficas
+        QPen pen(QColor::fromHsv((i * 360) / qMax(count, 1), 200, 200));
+        pen.setWidth(2);
+        series->setPen(pen);
+        series->replace(points);
+        chart->addSeries(series);
+        seriesList.append(series);
+    }
+
+    QAbstractAxis *axisX = nullptr;
+    if (alignment == ByDate) {
+        QDateTimeAxis *dateAxis = new QDateTimeAxis(chart);
+        dateAxis->setFormat("MMM yyyy");
+        dateAxis->setTitleText("Fecha");
+        if (!seriesList.isEmpty()) {
+            dateAxis->setRange(QDateTime::fromMSecsSinceEpoch(qint64(minX)),
+                               QDateTime::fromMSecsSinceEpoch(qint64(qMax(maxX, minX + 86400000.0))));
+        }
+        axisX = dateAxis;
+    } else {
+        QValueAxis *daysAxis = new QValueAxis(chart);
+        daysAxis->setLabelFormat("%d");
+        daysAxis->setTitleText("Días desde la primera visita");
+        if (!seriesList.isEmpty()) {
+            daysAxis->setRange(minX, qMax(maxX, minX + 1.0));
+        }
+        axisX = daysAxis;
+    }
+    QValueAxis *axisY = new QValueAxis(chart);
+    axisY->setTitleText(bmi ? "IMC" : "Peso (kg)");
+    if (!seriesList.isEmpty()) {
+        axisY->setRange(minY * 0.95, maxY * 1.05);
+    }
+    chart->addAxis(axisX, Qt::AlignBottom);
+    chart->addAxis(axisY, Qt::AlignLeft);
+    for (QLineSeries *series : std::as_const(seriesList)) {
+        series->attachAxis(axisX);
+        series->attachAxis(axisY);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef PATIENTCOMPARISONWINDOW_H
+#define PATIENTCOMPARISONWINDOW_H
+
+#include <QWidget>
+#include <QScopedPointer>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <QDate>
+#include <QVector>
+#include <QtCharts/QChart>
+#include <QtCharts/QChartView>
+
+QT_BEGIN_NAMESPACE
+namespace Ui { class PatientComparisonWindow; }
+QT_END_NAMESPACE
+
+// Superpone las curvas de peso e IMC de varios pacientes sobre un mismo eje de tiempo,
+// alineadas por fecha de calendario o por días desde la primera visita de cada uno.
+// Los historiales se cargan en paralelo (QtConcurrent), cada tarea con su propia conexión
+// a la base de datos, así que abrir 50 pacientes tarda más o menos lo mismo que abrir uno.
+class PatientComparisonWindow : public QWidget
+{
+    Q_OBJECT
+
+public:
+    // Historial de un paciente tal como se pinta
+    struct History {
+        int userId = -1;
+        QString name;
+        QVector<QDate> dates;
+        QVector<double> weights;
+        QVector<double> bmis;
+    };
+
+    enum Alignment {
+        ByDate,
+        ByDaysSinceFirstVisit
+    };
+
+    explicit PatientComparisonWindow(const QList<int>& userIds, QWidget *parent = nullptr);
+    ~PatientComparisonWindow();
+
+    // Lee el historial de un paciente con una conexión propia que se elimina al terminar
+    static History loadHistory(int userId);
+
+private slots:
+    void onHistoriesLoaded();
+    void on_alignmentComboBox_currentIndexChanged(int index);
+
+private:
+    QScopedPointer<Ui::PatientComparisonWindow> ui;
+    QFutureWatcher<History> m_watcher;
+    QVector<History> m_histories;
+    QElapsedTimer m_loadTimer;
+    QChart *m_weightChart;
+    QChart *m_bmiChart;
+
+    void renderCharts(Alignment alignment);
+    void renderChart(QChart *chart, Alignment alignment, bool bmi);
+};
+
+#endif // PATIENTCOMPARISONWINDOW_H
@@ -0,0 +1,496 @@
+#include "patientdeduplicator.h"
+#include "datachangehub.h"
+#include "textnormalizer.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QVarLengthArray>
+#include <QtConcurrent>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Bloques con más pacientes que esto se omiten en la pasada completa (y en un alta solo se miran
+// los más recientes): son nombres muy comunes sin fecha, que casi nunca son el mismo paciente
+const int kMaxBlockSize = 200;
+const quint64 kKeySeed = 0x9e3779b97f4a7c15ULL;
+
+// Partículas que no distinguen apellidos ("de la Fuente" = "Fuente")
+bool isParticle(const QString& word)
+{
+    static const QSet<QString> kParticles = { "de", "del", "la", "las", "los", "y", "i", "e", "da", "van", "von" };
+    return kParticles.contains(word);
+}
+
+bool isVowel(QChar ch)
+{
+    return ch == 'a' || ch == 'e' || ch == 'i' || ch == 'o' || ch == 'u';
+}
+
+// Segundo apellido: vacío en uno solo suele ser un registro incompleto, no otra persona
+double surnameSimilarity(const QString& a, const QString& b)
+{
+    if (a.isEmpty() && b.isEmpty()) {
+        return 1.0;
+    }
+    if (a.isEmpty() || b.isEmpty()) {
+        return 0.7;
+    }
+    return PatientDeduplicator::jaroWinkler(a, b);
+}
+
+// Fechas yyyyMMdd: iguales, día y mes intercambiados o una cifra distinta
+double birthSimilarity(const QString& a, const QString& b)
+{
+    if (a.isEmpty() || b.isEmpty()) {
+        return 0.5;
+    }
+    if (a == b) {
+        return 1.0;
+    }
+    if (a.left(4) == b.left(4) && a.mid(4, 2) == b.mid(6, 2) && a.mid(6, 2) == b.mid(4, 2)) {
+        return 0.8;
+    }
+    switch (PatientDeduplicator::levenshtein(a, b)) {
+    case 1: return 0.8;
+    case 2: return 0.4; // Dos cifras traspuestas
+    default: break;
+    }
+    return 0.0;
+}
+
+quint64 keyHash(const QString& key)
+{
+    return quint64(qHash(key, size_t(kKeySeed)));
+}
+
+} // namespace
+
+PatientDeduplicator* PatientDeduplicator::instance()
+{
+    static PatientDeduplicator deduplicator(true);
+    return &deduplicator;
+}
+
+PatientDeduplicator::PatientDeduplicator(bool followChanges, QObject *parent)
+    : QObject(parent)
+    , m_loaded(false)
+{
+    if (!followChanges) {
+        return;
+    }
+    connect(DataChangeHub::instance(), &DataChangeHub::userAdded, this, &PatientDeduplicator::onUserChanged);
+    connect(DataChangeHub::instance(), &DataChangeHub::userUpdated, this, &PatientDeduplicator::onUserChanged);
+    connect(DataChangeHub::instance(), &DataChangeHub::userDeleted, this, &PatientDeduplicator::onUserDeleted);
+    connect(DataChangeHub::instance(), &DataChangeHub::bulkImportCompleted, this, &PatientDeduplicator::onBulkImportCompleted);
+}
+
+QString PatientDeduplicator::phoneticKey(const QString& text)
+{
+    QString word;
+    for (const QString& part : TextNormalizer::words(TextNormalizer::fold(text))) {
+        if (!isParticle(part)) {
+            word += part;
+        }
+    }
+
+    QString key;
+    key.reserve(word.size());
+    auto push = [&key](QChar code) {
+        if (key.isEmpty() || key.back() != code) {
+            key.append(code);
+        }
+    };
+    const int length = int(word.size());
+    for (int i = 0; i < length; ++i) {
+        const QChar ch = word[i];
+        const QChar next = i + 1 < length ? word[i + 1] : QChar();
+        if (isVowel(ch) || (ch == 'y' && !isVowel(next))) {
+            if (key.isEmpty()) {
+                key.append('A'); // Solo cuenta que empieza por vocal
+            }
+            continue;
+        }
+        switch (ch.unicode()) {
+        case 'h':
+            break; // Muda
+        case 'b': case 'v': case 'w':
+            push('B');
+            break;
+        case 'c':
+            if (next == 'h') {
+                push('X');
+                ++i;
+            } else {
+                push(next == 'e' || next == 'i' ? 'S' : 'K');
+            }
+            break;
+        case 'q': case 'k':
+            push('K');
+            if (next == 'u') {
+                ++i;
+            }
+            break;
+        case 'z': case 's':
+            push('S');
+            break;
+        case 'g':
+            if (next == 'e' || next == 'i') {
+                push('J');
+            } else {
+                push('G');
+                if (next == 'u' && i + 2 < length && (word[i + 2] == 'e' || word[i + 2] == 'i')) {
+                    ++i; // "gue", "gui": la u no suena
+                }
+            }
+            break;
+        case 'l':
+            if (next == 'l') {
+                push('Y');
+                ++i;
+            } else {
+                push('L');
+            }
+            break;
+        case 'y':
+            push('Y');
+            break;
+        default:
+            if (ch.isLetter()) {
+                push(ch.toUpper());
+            }
+            break;
+        }
+    }
+    return key;
+}
+
+double PatientDeduplicator::jaroWinkler(const QString& a, const QString& b)
+{
+    if (a == b) {
+        return 1.0;
+    }
+    const int la = int(a.size());
+    const int lb = int(b.size());
+    if (la == 0 || lb == 0) {
+        return 0.0;
+    }
+    const int window = std::max(0, std::max(la, lb) / 2 - 1);
+    QVarLengthArray<bool, 64> matchedA(la);
+    QVarLengthArray<bool, 64> matchedB(lb);
+    std::fill(matchedA.begin(), matchedA.end(), false);
+    std::fill(matchedB.begin(), matchedB.end(), false);
+
+    int matches = 0;
+    for (int i = 0; i < la; ++i) {
+        const int from = std::max(0, i - window);
+        const int to = std::min(lb - 1, i + window);
+        for (int j = from; j <= to; ++j) {
+            if (!matchedB[j] && a[i] == b[j]) {
+                matchedA[i] = true;
+                matchedB[j] = true;
+                ++matches;
+                break;
+            }
+        }
+    }
+    if (matches == 0) {
+        return 0.0;
+    }
+    int transpositions = 0;
+    for (int i = 0, k = 0; i < la; ++i) {
+        if (!matchedA[i]) {
+            continue;
+        }
+        while (!matchedB[k]) {
+            ++k;
+        }
+        if (a[i] != b[k]) {
+            ++transpositions;
+        }
+        ++k;
+    }
+    const double m = matches;
+    const double jaro = (m / la + m / lb + (m - transpositions / 2.0) / m) / 3.0;
+
+    int prefix = 0;
+    while (prefix < 4 && prefix < la && prefix < lb && a[prefix] == b[prefix]) {
+        ++prefix;
+    }
+    return jaro + prefix * 0.1 * (1.0 - jaro);
+}
+
+int PatientDeduplicator::levenshtein(const QString& a, const QString& b)
+{
+    const int la = int(a.size());
+    const int lb = int(b.size());
+    QVarLengthArray<int, 32> previous(lb + 1);
+    QVarLengthArray<int, 32> current(lb + 1);
+    for (int j = 0; j <= lb; ++j) {
+        previous[j] = j;
+    }
+    for (int i = 1; i <= la; ++i) {
+        current[0] = i;
+        for (int j = 1; j <= lb; ++j) {
+            const int substitution = previous[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+            current[j] = std::min({ previous[j] + 1, current[j - 1] + 1, substitution });
+        }
+        std::swap(previous, current);
+    }
+    return previous[lb];
+}
+
+PatientDeduplicator::Record PatientDeduplicator::makeRecord(int userId, const QString& firstName, const QString& lastName1,
+                                                            const QString& lastName2, const QDate& birthDate)
+{
+    Record record;
+    record.userId = userId;
+    record.firstName = TextNormalizer::fold(firstName);
+    record.lastName1 = TextNormalizer::fold(lastName1);
+    record.lastName2 = TextNormalizer::fold(lastName2);
+    record.birth = birthDate.isValid() ? birthDate.toString("yyyyMMdd") : QString();
+    return record;
+}
+
+QVector<quint64> PatientDeduplicator::blockingKeys(const Record& record)
+{
+    const QStringList firstWords = TextNormalizer::words(record.firstName);
+    const QString first = firstWords.isEmpty() ? QString() : phoneticKey(firstWords.first());
+    const QString surname1 = phoneticKey(record.lastName1);
+    const QString surname2 = phoneticKey(record.lastName2);
+
+    QVector<quint64> keys;
+    if (!record.birth.isEmpty()) {
+        // Misma etiqueta para los dos apellidos: así coinciden aunque estén cruzados
+        if (!surname1.isEmpty()) {
+            keys.append(keyHash("s|" + record.birth + "|" + surname1));
+        }
+        if (!surname2.isEmpty()) {
+            keys.append(keyHash("s|" + record.birth + "|" + surname2));
+        }
+        if (!first.isEmpty()) {
+            keys.append(keyHash("n|" + record.birth + "|" + first));
+        }
+    }
+    // Sin fecha: para erratas en la fecha de nacimiento
+    if (!first.isEmpty() && !surname1.isEmpty()) {
+        keys.append(keyHash("f|" + first + "|" + std::min(surname1, surname2) + "|" + std::max(surname1, surname2)));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+double PatientDeduplicator::score(const Record& a, const Record& b)
+{
+    const double first = jaroWinkler(a.firstName, b.firstName);
+    const double straight = (jaroWinkler(a.lastName1, b.lastName1) + surnameSimilarity(a.lastName2, b.lastName2)) / 2.0;
+    const double crossed = (surnameSimilarity(a.lastName1, b.lastName2) + surnameSimilarity(a.lastName2, b.lastName1)) / 2.0;
+    const double name = 0.4 * first + 0.6 * std::max(straight, crossed);
+    return 0.7 * name + 0.3 * birthSimilarity(a.birth, b.birth);
+}
+
+void PatientDeduplicator::insertRecord(const Record& record)
+{
+    const int index = int(m_records.size());
+    m_records.append(record);
+    m_recordOfUser.insert(record.userId, index);
+    for (quint64 key : blockingKeys(record)) {
+        // Lista enlazada por clave, con el registro más reciente primero
+        m_links.append(Link{ index, m_blockHeads.value(key, -1) });
+        m_blockHeads.insert(key, int(m_links.size()) - 1);
+    }
+}
+
+void PatientDeduplicator::removeUser(int userId)
+{
+    // Los enlaces se quedan; el registro marcado se salta al recorrer los bloques
+    const auto it = m_recordOfUser.constFind(userId);
+    if (it != m_recordOfUser.cend()) {
+        m_records[it.value()].alive = false;
+        m_recordOfUser.erase(it);
+    }
+}
+
+bool PatientDeduplicator::ensureLoaded(const QSqlDatabase& db)
+{
+    if (m_loaded) {
+        return true;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT user_id, first_name, last_name1, last_name2, birth_date FROM users")) {
+        qCritical() << "Error al cargar los pacientes para detectar duplicados:" << query.lastError().text();
+        return false;
+    }
+    m_records.clear();
+    m_recordOfUser.clear();
+    m_blockHeads.clear();
+    m_links.clear();
+    while (query.next()) {
+        insertRecord(makeRecord(query.value(0).toInt(), query.value(1).toString(), query.value(2).toString(),
+                                query.value(3).toString(), QDate::fromString(query.value(4).toString(), Qt::ISODate)));
+    }
+    m_loaded = true;
+    qInfo() << "Índice de duplicados:" << m_records.size() << "pacientes," << m_blockHeads.size()
+            << "bloques en" << timer.elapsed() << "ms.";
+    return true;
+}
+
+QList<PatientDeduplicator::Candidate> PatientDeduplicator::candidatesFor(const User& user, double minScore, int limit)
+{
+    QList<Candidate> result;
+    if (!ensureLoaded()) {
+        return result;
+    }
+    const Record probe = makeRecord(user.id(), user.firstName(), user.lastName1(), user.lastName2(), user.birthDate());
+    QSet<int> seen;
+    for (quint64 key : blockingKeys(probe)) {
+        int visited = 0;
+        for (int link = m_blockHeads.value(key, -1); link >= 0 && visited < kMaxBlockSize; link = m_links[link].next) {
+            ++visited;
+            const int index = m_links[link].record;
+            const Record& record = m_records[index];
+            if (!record.alive || record.userId == probe.userId || seen.contains(index)) {
+                continue;
+            }
+            seen.insert(index);
+            const double s = score(probe, record);
+            if (s >= minScore) {
+                result.append(Candidate{ probe.userId, record.userId, s });
+            }
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const Candidate& a, const Candidate& b) { return a.score > b.score; });
+    if (result.size() > limit) {
+        result.resize(limit);
+    }
+    return result;
+}
+
+QList<PatientDeduplicator::Candidate> PatientDeduplicator::findAll(double minScore, int limit)
+{
+    QList<Candidate> result;
+    if (!ensureLoaded()) {
+        return result;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    // 1. Parejas que comparten bloque, sin repetir (índices de registro empaquetados en 64 bits)
+    std::vector<quint64> pairs;
+    QVarLengthArray<int, kMaxBlockSize> members;
+    int skippedBlocks = 0;
+    for (auto it = m_blockHeads.cbegin(); it != m_blockHeads.cend(); ++it) {
+        members.clear();
+        bool tooLarge = false;
+        for (int link = it.value(); link >= 0; link = m_links[link].next) {
+            const int index = m_links[link].record;
+            if (!m_records[index].alive) {
+                continue;
+            }
+            if (members.size() == kMaxBlockSize) {
+                tooLarge = true;
+                break;
+            }
+            members.append(index);
+        }
+        if (tooLarge) {
+            ++skippedBlocks;
+            continue;
+        }
+        for (qsizetype i = 0; i < members.size(); ++i) {
+            for (qsizetype j = i + 1; j < members.size(); ++j) {
+                const quint64 low = quint64(std::min(members[i], members[j]));
+                const quint64 high = quint64(std::max(members[i], members[j]));
+                pairs.push_back((low << 32) | high);
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    // 2. Puntuación en paralelo por tramos; los registros no cambian mientras tanto
+    //    (todo ocurre dentro de esta llamada, en el hilo dueño del índice)
+    const qsizetype total = qsizetype(pairs.size());
+    const qsizetype chunks = std::max<qsizetype>(1, std::min<qsizetype>(total / 1024 + 1, QThread::idealThreadCount() * 4));
+    QVector<QPair<qsizetype, qsizetype>> ranges;
+    for (qsizetype c = 0; c < chunks; ++c) {
+        ranges.append(qMakePair(total * c / chunks, total * (c + 1) / chunks));
+    }
+    const QVector<Record>& records = m_records;
+    const QList<QList<Candidate>> scored = QtConcurrent::blockingMapped<QList<QList<Candidate>>>(
+        ranges, [&records, &pairs, minScore](const QPair<qsizetype, qsizetype>& range) {
+            QList<Candidate> found;
+            for (qsizetype p = range.first; p < range.second; ++p) {
+                const Record& a = records[int(pairs[std::size_t(p)] >> 32)];
+                const Record& b = records[int(pairs[std::size_t(p)] & 0xffffffffu)];
+                const double s = score(a, b);
+                if (s >= minScore) {
+                    // El paciente más antiguo (id menor) es el que se conserva
+                    found.append(a.userId > b.userId ? Candidate{ a.userId, b.userId, s } : Candidate{ b.userId, a.userId, s });
+                }
+            }
+            return found;
+        });
+    for (const QList<Candidate>& part : scored) {
+        result += part;
+    }
+    std::sort(result.begin(), result.end(), [](const Candidate& a, const Candidate& b) { return a.score > b.score; });
+    if (result.size() > limit) {
+        result.resize(limit);
+    }
+    qInfo() << "Duplicados:" << pairs.size() << "parejas comparadas," << skippedBlocks << "bloques omitidos,"
+            << result.size() << "candidatos en" << timer.elapsed() << "ms.";
+    return result;
+}
+
+QList<PatientDeduplicator::Candidate> PatientDeduplicator::findAllIn(const QSqlDatabase& db, double minScore, int limit)
+{
+    PatientDeduplicator detached(false);
+    if (!detached.ensureLoaded(db)) {
+        return QList<Candidate>();
+    }
+    return detached.findAll(minScore, limit);
+}
+
+void PatientDeduplicator::onUserChanged(int userId)
+{
+    if (!m_loaded) {
+        return; // Se indexará al cargar
+    }
+    removeUser(userId);
+    QSqlQuery query;
+    query.prepare("SELECT first_name, last_name1, last_name2, birth_date FROM users WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec() || !query.next()) {
+        qWarning() << "No se pudo indexar el paciente" << userId << "para detectar duplicados:" << query.lastError().text();
+        return;
+    }
+    insertRecord(makeRecord(userId, query.value(0).toString(), query.value(1).toString(), query.value(2).toString(),
+                            QDate::fromString(query.value(3).toString(), Qt::ISODate)));
+}
+
+void PatientDeduplicator::onUserDeleted(int userId)
+{
+    if (m_loaded) {
+        removeUser(userId);
+    }
+}
+
+// Miles de altas de golpe: se recarga el índice en una consulta en lugar de indexarlas una a una
+void PatientDeduplicator::onBulkImportCompleted(const QList<int>& userIds)
+{
+    Q_UNUSED(userIds);
+    if (m_loaded) {
+        m_loaded = false;
+        ensureLoaded();
+    }
+}
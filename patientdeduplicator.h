@@ -0,0 +1,90 @@
+#ifndef PATIENTDEDUPLICATOR_H
+#define PATIENTDEDUPLICATOR_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+#include "user.h"
+
+// Detección de pacientes registrados dos veces ("María José" / "Maria Jose", apellidos cruzados,
+// una cifra mal en la fecha de nacimiento) sin comparar todos con todos:
+//  - Bloqueo: cada paciente se indexa por unas pocas claves (fecha de nacimiento + clave fonética
+//    de cada apellido o del nombre, y nombre + apellidos sin fecha). Solo se comparan los pacientes
+//    que comparten alguna clave; los bloques demasiado grandes (nombres muy comunes sin fecha) se omiten.
+//  - Puntuación: Jaro-Winkler sobre nombre y apellidos normalizados (probando también el orden
+//    cruzado de apellidos) y Levenshtein sobre la fecha para admitir erratas de una cifra.
+// El índice vive en memoria, se carga una vez y se mantiene con los avisos de DataChangeHub,
+// así que la comprobación de un alta solo recorre unos pocos bloques.
+class PatientDeduplicator : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Candidate {
+        int userId = -1;      // Paciente nuevo o comparado (-1 si aún no está guardado)
+        int duplicateOf = -1; // Paciente existente con el que coincide
+        double score = 0.0;   // 0..1
+    };
+
+    static PatientDeduplicator* instance();
+
+    // Carga el índice (una vez por sesión)
+    bool ensureLoaded(const QSqlDatabase& db = QSqlDatabase::database());
+
+    // Posibles duplicados de un paciente (nuevo o existente), de mayor a menor puntuación
+    QList<Candidate> candidatesFor(const User& user, double minScore = 0.88, int limit = 10);
+    // Parejas de posibles duplicados de todo el registro, de mayor a menor puntuación.
+    // La puntuación de las parejas se reparte entre los hilos del pool.
+    QList<Candidate> findAll(double minScore = 0.88, int limit = 1000);
+    // Lo mismo con un índice propio leído de 'db', para un hilo de trabajo: el índice compartido
+    // lo actualizan los avisos de DataChangeHub en el hilo principal y no se puede recorrer desde otro
+    static QList<Candidate> findAllIn(const QSqlDatabase& db, double minScore = 0.88, int limit = 1000);
+
+    // Clave fonética española: sin tildes ni partículas (de, la, del...), b/v, c/k/q, c/s/z, g/j,
+    // ll/y igualadas, h muda y solo consonantes tras la primera letra
+    static QString phoneticKey(const QString& text);
+    static double jaroWinkler(const QString& a, const QString& b);
+    static int levenshtein(const QString& a, const QString& b);
+
+private slots:
+    void onUserChanged(int userId);
+    void onUserDeleted(int userId);
+    void onBulkImportCompleted(const QList<int>& userIds);
+
+private:
+    // followChanges: el índice se mantiene con los avisos de DataChangeHub (solo el de instance())
+    explicit PatientDeduplicator(bool followChanges, QObject *parent = nullptr);
+
+    struct Record {
+        int userId = -1;
+        QString firstName; // Normalizados (TextNormalizer::fold)
+        QString lastName1;
+        QString lastName2;
+        QString birth;     // yyyyMMdd; vacío si no hay fecha
+        bool alive = true;
+    };
+
+    // Enlace de la lista de registros de una clave de bloqueo
+    struct Link {
+        int record;
+        int next;
+    };
+
+    static Record makeRecord(int userId, const QString& firstName, const QString& lastName1,
+                             const QString& lastName2, const QDate& birthDate);
+    static QVector<quint64> blockingKeys(const Record& record);
+    static double score(const Record& a, const Record& b);
+    void insertRecord(const Record& record);
+    void removeUser(int userId);
+
+    bool m_loaded;
+    QVector<Record> m_records;
+    QHash<int, int> m_recordOfUser;   // user_id -> registro vivo
+    QHash<quint64, int> m_blockHeads; // clave -> primer enlace
+    QVector<Link> m_links;
+};
+
+#endif // PATIENTDEDUPLICATOR_H
@@ -2,6 +2,13 @@
 #include "patientdetailswindow.h"
 #include "addmetricdialog.h"
 #include "healthmetricmanager.h"
+#include "metrickernels.h"
+#include "energycalculator.h"
+#include "growthreference.h"
+#include "weightforecaster.h"
+#include "clinicalalertengine.h"
+#include "metricrollups.h"
+#include "fooddiary.h"
 #include "ui_patientdetailswindow.h" // Incluye el archivo generado por Qt Designer
 #include <QDebug>
 #include <QMessageBox> // Para mostrar mensajes de error
@@ -12,6 +19,31 @@
 #include <QtCharts/QChart>
 #include <QDateTime>
 #include <QDateTimeAxis>
+#include <QAction>
+#include <QDesktopServices>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QEvent>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLocale>
+#include <QPushButton>
+#include <QScrollBar>
+#include <QUrl>
+#include <QVBoxLayout>
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+// Datos de cada elemento de la tira de fotos
+const int kPhotoIdRole = Qt::UserRole;
+const int kPhotoHashRole = Qt::UserRole + 1;
+const int kPhotoLoadedRole = Qt::UserRole + 2;
+
+} // namespace
 
 PatientDetailsWindow::PatientDetailsWindow(QSharedPointer<User> patient, QWidget *parent)
     : QWidget(parent),
@@ -21,10 +53,17 @@ PatientDetailsWindow::PatientDetailsWindow(QSharedPointer<User> patient, QWidget
     weightSeries(nullptr),
     weightAxisX(nullptr),
     weightAxisY(nullptr),
+    forecastSeries(nullptr),
+    forecastUpperSeries(nullptr),
+    forecastLowerSeries(nullptr),
+    forecastBandSeries(nullptr),
     bmiChart(nullptr),
     bmiSeries(nullptr),
     bmiAxisX(nullptr),
-    bmiAxisY(nullptr)
+    bmiAxisY(nullptr),
+    m_chartResizeTimer(nullptr),
+    m_chartsLoaded(false),
+    m_chartLevel(MetricRollups::Raw)
 // Almacena el paciente recibido
 {
     ui->setupUi(this); // Configura la interfaz de usuario desde el archivo .ui
@@ -41,8 +80,8 @@ PatientDetailsWindow::PatientDetailsWindow(QSharedPointer<User> patient, QWidget
     setupUi();          // Configuración inicial de la UI (columnas de tabla, etc.)
     loadPatientData();  // Carga los datos básicos del paciente
     loadHealthMetrics(); // Carga y muestra las métricas de salud
-    setupCharts();
-    updateCharts();
+    loadPhotos();
+    setupCharts(); // Las series se leen al distribuirse la ventana (onChartResized)
 }
 
 PatientDetailsWindow::~PatientDetailsWindow()
@@ -65,6 +104,47 @@ void PatientDetailsWindow::setupUi()
     // Seleccionar filas completas
     ui->healthMetricsTableWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
     ui->healthMetricsTableWidget->setSelectionMode(QAbstractItemView::SingleSelection);
+    ui->fullHistoryCheckBox->setToolTip(QString("Sin marcar, la tabla muestra las mediciones de los últimos %1 meses.")
+                                            .arg(kTableMonths));
+
+    // Cambios de tamaño de la gráfica agrupados: solo cuenta el ancho final
+    m_chartResizeTimer = new QTimer(this);
+    m_chartResizeTimer->setSingleShot(true);
+    m_chartResizeTimer->setInterval(150);
+    connect(m_chartResizeTimer, &QTimer::timeout, this, &PatientDetailsWindow::onChartResized);
+    ui->widgetWeight->installEventFilter(this);
+
+    // Tira horizontal de miniaturas de las fotos de progreso
+    QListWidget *strip = ui->photoStripListWidget;
+    const QSize iconSize(PhotoStore::SmallThumbnail, PhotoStore::SmallThumbnail);
+    strip->setViewMode(QListView::IconMode);
+    strip->setFlow(QListView::LeftToRight);
+    strip->setWrapping(false);
+    strip->setMovement(QListView::Static);
+    strip->setIconSize(iconSize);
+    strip->setUniformItemSizes(true);
+    strip->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+    strip->setSelectionMode(QAbstractItemView::SingleSelection);
+    strip->viewport()->installEventFilter(this);
+    connect(strip->horizontalScrollBar(), &QScrollBar::valueChanged, this, &PatientDetailsWindow::loadVisibleThumbnails);
+    connect(strip, &QListWidget::itemActivated, this, &PatientDetailsWindow::onPhotoActivated);
+
+    QAction *removePhotoAction = new QAction("Eliminar foto", strip);
+    connect(removePhotoAction, &QAction::triggered, this, &PatientDetailsWindow::removeSelectedPhoto);
+    strip->addAction(removePhotoAction);
+    strip->setContextMenuPolicy(Qt::ActionsContextMenu);
+
+    QPixmap placeholder(iconSize);
+    placeholder.fill(palette().color(QPalette::Mid));
+    m_photoPlaceholder = QIcon(placeholder);
+
+    // El recuento de alertas es un enlace que abre la lista para revisarlas
+    ui->alertsLabel->setTextFormat(Qt::RichText);
+    ui->alertsLabel->setTextInteractionFlags(Qt::LinksAccessibleByMouse);
+    connect(ui->alertsLabel, &QLabel::linkActivated, this, &PatientDetailsWindow::showAlerts);
+
+    connect(PhotoStore::instance(), &PhotoStore::thumbnailReady, this, &PatientDetailsWindow::onThumbnailReady);
+    connect(PhotoStore::instance(), &PhotoStore::photosChanged, this, &PatientDetailsWindow::onPhotosChanged);
 }
 
 // Carga los datos básicos del paciente en las etiquetas correspondientes
@@ -91,8 +171,14 @@ void PatientDetailsWindow::loadHealthMetrics()
         return;
     }
 
-    // Obtener las métricas del gestor de métricas
-    QList<QSharedPointer<HealthMetric>> metrics = m_healthMetricManager.getHealthMetricsByUserId(m_currentPatient->id());
+    // Obtener las métricas del gestor de métricas. Por defecto solo las recientes: la consulta
+    // recorre el tramo del índice (user_id, date) del periodo y no todo el historial
+    QList<QSharedPointer<HealthMetric>> metrics =
+        ui->fullHistoryCheckBox->isChecked()
+            ? m_healthMetricManager.getHealthMetricsByUserId(m_currentPatient->id())
+            : m_healthMetricManager.getHealthMetricsByUserId(m_currentPatient->id(),
+                                                             QDate::currentDate().addMonths(-kTableMonths),
+                                                             QDate(9999, 12, 31)); // Sin límite superior
 
     ui->healthMetricsTableWidget->setRowCount(metrics.count()); // Establecer el número de filas de la tabla
 
@@ -112,6 +198,188 @@ void PatientDetailsWindow::loadHealthMetrics()
     }
     ui->healthMetricsTableWidget->hideColumn(8);
     ui->healthMetricsTableWidget->resizeColumnsToContents(); // Ajustar el ancho de las columnas
+
+    updateEnergyEstimate(); // Se recalcula con cada alta, edición o borrado de medidas
+    updateGrowthAssessment();
+    updateAlerts();
+}
+
+QList<HealthMetric> PatientDetailsWindow::metricHistory()
+{
+    QList<HealthMetric> history;
+    for (const QSharedPointer<HealthMetric>& metric : m_healthMetricManager.getHealthMetricsByUserId(m_currentPatient->id())) {
+        if (metric) {
+            history.append(*metric);
+        }
+    }
+    return history;
+}
+
+void PatientDetailsWindow::updateGrowthAssessment()
+{
+    const HealthMetric latest = m_healthMetricManager.getLatestHealthMetric(m_currentPatient->id());
+    const GrowthReference::Assessment assessment = GrowthReference::assess(*m_currentPatient, latest);
+    ui->growthLabel->setVisible(assessment.valid);
+    if (!assessment.valid) {
+        return;
+    }
+    // Un indicador fuera de su tabla (peso/edad a partir de los 10 años) se muestra como "-"
+    auto percentile = [](bool valid, double value) {
+        return valid ? QString("P%1").arg(value, 0, 'f', 0) : QString("-");
+    };
+    auto zScore = [](bool valid, double value) {
+        return valid ? QString::number(value, 'f', 2) : QString("-");
+    };
+    ui->growthLabel->setText(QString("Percentiles OMS (%1 meses): peso %2 | longitud %3 | IMC %4")
+                                 .arg(assessment.ageMonths, 0, 'f', 1)
+                                 .arg(percentile(assessment.weightValid, assessment.weightPercentile),
+                                      percentile(assessment.heightValid, assessment.heightPercentile),
+                                      percentile(assessment.bmiValid, assessment.bmiPercentile)));
+    ui->growthLabel->setToolTip(QString("Puntuación z: peso %1 | longitud %2 | IMC %3")
+                                    .arg(zScore(assessment.weightValid, assessment.weightZ),
+                                         zScore(assessment.heightValid, assessment.heightZ),
+                                         zScore(assessment.bmiValid, assessment.bmiZ)));
+}
+
+void PatientDetailsWindow::updateAlerts()
+{
+    const QList<ClinicalAlertEngine::Alert> alerts = ClinicalAlertEngine::instance()->activeAlerts(m_currentPatient->id());
+    ui->alertsLabel->setVisible(!alerts.isEmpty());
+    if (alerts.isEmpty()) {
+        return;
+    }
+    QStringList messages;
+    for (const ClinicalAlertEngine::Alert& alert : alerts) {
+        messages << alert.message;
+    }
+    ui->alertsLabel->setText(QString("<a href=\"alerts\" style='color:#c0392b'><b>Alertas: %1</b></a>").arg(alerts.size()));
+    ui->alertsLabel->setToolTip(messages.join('\n') + "\n\nClic para revisarlas.");
+}
+
+// Lista de alertas activas del paciente; las seleccionadas se pueden marcar como revisadas
+void PatientDetailsWindow::showAlerts()
+{
+    ClinicalAlertEngine *engine = ClinicalAlertEngine::instance();
+    const QList<ClinicalAlertEngine::Alert> alerts = engine->activeAlerts(m_currentPatient->id());
+    if (alerts.isEmpty()) {
+        updateAlerts();
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(QString("Alertas clínicas (%1 activas)").arg(alerts.size()));
+    dialog.resize(700, 300);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    QTableWidget *table = new QTableWidget(int(alerts.size()), 3, &dialog);
+    table->setHorizontalHeaderLabels({ "Fecha", "Regla", "Alerta" });
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    table->verticalHeader()->setVisible(false);
+    table->horizontalHeader()->setStretchLastSection(true);
+    for (int row = 0; row < alerts.size(); ++row) {
+        const ClinicalAlertEngine::Alert& alert = alerts.at(row);
+        QTableWidgetItem *dateItem = new QTableWidgetItem(alert.firedAt.toString("dd/MM/yyyy HH:mm"));
+        dateItem->setData(Qt::UserRole, alert.alertId);
+        table->setItem(row, 0, dateItem);
+        table->setItem(row, 1, new QTableWidgetItem(alert.ruleId));
+        table->setItem(row, 2, new QTableWidgetItem(alert.message));
+    }
+    table->resizeColumnsToContents();
+    layout->addWidget(table);
+    layout->addWidget(new QLabel("Una alerta de estado revisada no vuelve a avisar mientras la condición se cumpla\n"
+                                 "(si deja de cumplirse y vuelve, se crea otra); las de cruce se cierran al revisarlas.", &dialog));
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    QPushButton *acknowledgeButton = buttons->addButton("Marcar seleccionadas como revisadas", QDialogButtonBox::ActionRole);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    connect(acknowledgeButton, &QPushButton::clicked, &dialog, [this, engine, table, &dialog]() {
+        QList<int> rows;
+        for (const QModelIndex& index : table->selectionModel()->selectedRows(0)) {
+            rows.append(index.row());
+        }
+        // De abajo arriba para no desplazar las filas pendientes de quitar
+        std::sort(rows.begin(), rows.end(), std::greater<int>());
+        for (int row : std::as_const(rows)) {
+            if (!engine->acknowledge(table->item(row, 0)->data(Qt::UserRole).toInt())) {
+                QMessageBox::critical(this, "Error", "No se pudo marcar la alerta como revisada.");
+                break;
+            }
+            table->removeRow(row);
+        }
+        dialog.setWindowTitle(QString("Alertas clínicas (%1 activas)").arg(table->rowCount()));
+    });
+    layout->addWidget(buttons);
+    dialog.exec();
+    updateAlerts();
+}
+
+void PatientDetailsWindow::updateEnergyEstimate()
+{
+    const HealthMetric latest = m_healthMetricManager.getLatestHealthMetric(m_currentPatient->id());
+    const EnergyCalculator::Estimate estimate = EnergyCalculator::estimate(*m_currentPatient, latest);
+    if (!estimate.valid) {
+        ui->energyLabel->setText("Energía: sin datos");
+        ui->energyLabel->setToolTip(QString());
+        updateIntake(0.0); // Sin objetivo: solo la ingesta
+        return;
+    }
+
+    ui->energyLabel->setText(QString("BMR: %1 kcal | TDEE: %2 kcal | Objetivo: %3 kcal")
+                                 .arg(qRound(estimate.bmr))
+                                 .arg(qRound(estimate.tdee))
+                                 .arg(qRound(estimate.targetKcal)));
+    QString details = QString("Mifflin-St Jeor: %1 kcal\nHarris-Benedict: %2 kcal")
+                          .arg(qRound(estimate.mifflinStJeor))
+                          .arg(qRound(estimate.harrisBenedict));
+    if (estimate.katchMcArdle > 0) {
+        details += QString("\nKatch-McArdle: %1 kcal (usada como BMR)").arg(qRound(estimate.katchMcArdle));
+    }
+    details += QString("\nFactor de actividad: %1 | Ajuste por objetivo: %2")
+                   .arg(estimate.activityFactor)
+                   .arg(estimate.goalFactor);
+    ui->energyLabel->setToolTip(details);
+    updateIntake(estimate.targetKcal);
+}
+
+void PatientDetailsWindow::updateIntake(double targetKcal)
+{
+    const QDate today = QDate::currentDate();
+    const FoodDiary::Targets targets = FoodDiary::targetsFor(targetKcal);
+    const FoodDiary::Adherence adherence = FoodDiary::adherence(m_currentPatient->id(), today.addDays(-6), today, targets);
+    ui->intakeLabel->setVisible(adherence.daysLogged > 0);
+    if (adherence.daysLogged == 0) {
+        return;
+    }
+
+    QString text = QString("Ingesta 7 días (%1 registrados): %2 kcal/día")
+                       .arg(adherence.daysLogged)
+                       .arg(qRound(adherence.average[FoodDiary::EnergyKcal]));
+    if (targets.values[FoodDiary::EnergyKcal] > 0) {
+        text += QString(" (%1 % del objetivo)").arg(qRound(adherence.ratio[FoodDiary::EnergyKcal] * 100));
+    }
+    text += QString(" | P %1 g | HC %2 g | G %3 g")
+                .arg(qRound(adherence.average[FoodDiary::ProteinG]))
+                .arg(qRound(adherence.average[FoodDiary::CarbohydrateG]))
+                .arg(qRound(adherence.average[FoodDiary::FatG]));
+    ui->intakeLabel->setText(text);
+
+    QStringList details;
+    for (int n = 0; n < FoodDiary::NutrientCount; ++n) {
+        const FoodDiary::Nutrient nutrient = FoodDiary::Nutrient(n);
+        QString line = QString("%1: %2 %3").arg(FoodDiary::label(nutrient))
+                           .arg(adherence.average[n], 0, 'f', 1)
+                           .arg(FoodDiary::unit(nutrient));
+        if (targets.values[n] > 0) {
+            line += QString(" / %1 %2 %3 (%4 %)")
+                        .arg(FoodDiary::isUpperLimit(nutrient) ? "máx." : "obj.")
+                        .arg(targets.values[n], 0, 'f', 0)
+                        .arg(FoodDiary::unit(nutrient))
+                        .arg(qRound(adherence.ratio[n] * 100));
+        }
+        details << line;
+    }
+    ui->intakeLabel->setToolTip(details.join('\n'));
 }
 
 
@@ -119,6 +387,7 @@ void PatientDetailsWindow::on_addMetricButton_clicked()
 {
     // 1. Crear una instancia del diálogo de entrada de métricas.
     AddMetricDialog dialog(this);
+    dialog.setAnomalyContext(metricHistory(), m_currentPatient->birthDate());
 
     // 2. Mostrar el diálogo y esperar a que el usuario interactúe.
     if (dialog.exec() == QDialog::Accepted) {
@@ -191,6 +460,7 @@ void PatientDetailsWindow::on_pushButtonEditar_clicked()
         originalMetric.notes(),
         this
         );
+    dialog.setAnomalyContext(metricHistory(), m_currentPatient->birthDate(), originalMetric.id());
 
     // 5. Mostrar el diálogo y esperar que el usuario lo acepte
     if (dialog.exec() == QDialog::Accepted) {
@@ -273,6 +543,27 @@ void PatientDetailsWindow::setupCharts()
     weightChart->addAxis(weightAxisY, Qt::AlignLeft);
     weightSeries->attachAxis(weightAxisY);
 
+    // Previsión: banda de confianza sombreada y línea discontinua a continuación de la serie real
+    forecastUpperSeries = new QLineSeries(weightChart);
+    forecastLowerSeries = new QLineSeries(weightChart);
+    forecastBandSeries = new QAreaSeries(forecastUpperSeries, forecastLowerSeries);
+    forecastBandSeries->setName("Intervalo 95 %");
+    forecastBandSeries->setColor(QColor(100, 149, 237, 60));
+    forecastBandSeries->setBorderColor(Qt::transparent);
+    weightChart->addSeries(forecastBandSeries);
+    forecastBandSeries->attachAxis(weightAxisX);
+    forecastBandSeries->attachAxis(weightAxisY);
+
+    forecastSeries = new QLineSeries(weightChart);
+    forecastSeries->setName("Previsión");
+    QPen forecastPen(QColor(100, 149, 237));
+    forecastPen.setStyle(Qt::DashLine);
+    forecastPen.setWidth(2);
+    forecastSeries->setPen(forecastPen);
+    weightChart->addSeries(forecastSeries);
+    forecastSeries->attachAxis(weightAxisX);
+    forecastSeries->attachAxis(weightAxisY);
+
     // --- Configuracion Grafica de IMC ---
     bmiChart = new QChart();
     bmiChart->setTitle("Evolucion del IMC");
@@ -313,70 +604,143 @@ void PatientDetailsWindow::updateCharts()
 
     QList<QPointF> weightDataPoints; // Para almacenar pares (fecha_milisegundos, peso)
     QList<QPointF> bmiDataPoints;    // Para almacenar pares (fecha_milisegundos, imc)
-    QDateTime minDate, maxDate;
-    qreal minWeight = std::numeric_limits<qreal>::max();
-    qreal maxWeight = std::numeric_limits<qreal>::min();
-    qreal minBmi = std::numeric_limits<qreal>::max();
-    qreal maxBmi = std::numeric_limits<qreal>::min();
-
-    // Columnas relevantes en healthMetricsTableWidget
-    const int DATE_COL = 0; // Columna 'Fecha'
-    const int WEIGHT_COL = 1; // Columna 'Peso (kg)'
-    const int BMI_COL = 3; // Columna 'IMC'
-
-    // Iterar sobre las filas del QTableWidget para recopilar datos
-    for (int i = 0; i < ui->healthMetricsTableWidget->rowCount(); ++i) {
-        QTableWidgetItem *dateItem = ui->healthMetricsTableWidget->item(i, DATE_COL);
-        QTableWidgetItem *weightItem = ui->healthMetricsTableWidget->item(i, WEIGHT_COL);
-        QTableWidgetItem *bmiItem = ui->healthMetricsTableWidget->item(i, BMI_COL);
-
-        if (dateItem && weightItem && bmiItem) {
-            // Intentar convertir la cadena de la fecha a QDateTime.
-            // Asegurarse de que el formato de fecha coincida con el que se guarda en la tabla.
-            QDateTime dateTime = QDateTime::fromString(dateItem->text(), Qt::ISODate);
-            double weight = weightItem->text().toDouble();
-            double imc = bmiItem->text().toDouble();
-
-            // Asegurarse de que la fecha sea valida y los valores sean sensatos para la grafica
-            if (dateTime.isValid() && weight > 0 && imc > 0) {
-                // Guardar los datos como QPointF (X=milisegundos desde epoch, Y=valor)
-                // QDateTimeAxis entiende los milisegundos desde epoch para su rango y etiquetas.
-                weightDataPoints.append(QPointF(dateTime.toMSecsSinceEpoch(), weight));
-                bmiDataPoints.append(QPointF(dateTime.toMSecsSinceEpoch(), imc));
-
-                // Actualizar rangos de los ejes para auto-escalado
-                if (minDate.isNull() || dateTime < minDate) minDate = dateTime;
-                if (maxDate.isNull() || dateTime > maxDate) maxDate = dateTime;
-                if (weight < minWeight) minWeight = weight;
-                if (weight > maxWeight) maxWeight = weight;
-                if (imc < minBmi) minBmi = imc;
-                if (imc > maxBmi) maxBmi = imc;
-            }
+
+    // La serie sale de los resúmenes: con historiales largos se lee una fila por semana, mes o año
+    // según el ancho de la gráfica, en vez de todas las mediciones
+    MetricRollups::Level level = MetricRollups::Raw;
+    QVector<MetricRollups::Point> points;
+    m_chartFrom = QDate();
+    m_chartTo = QDate();
+    if (MetricRollups::dateRange(m_currentPatient->id(), m_chartFrom, m_chartTo)) {
+        points = MetricRollups::series(m_currentPatient->id(), m_chartFrom, m_chartTo, chartPixelWidth(), &level);
+    }
+    m_chartLevel = level;
+    m_chartsLoaded = true;
+    // Los rangos de los ejes cubren los extremos de cada periodo, no solo su media
+    QVector<double> weights;
+    QVector<double> bmis;
+    weights.reserve(points.size() * 2);
+    bmis.reserve(points.size() * 2);
+    for (const MetricRollups::Point& point : points) {
+        // En los resúmenes el punto se sitúa en la mitad del tramo con mediciones del periodo
+        const QDate date = point.start.addDays(point.start.daysTo(point.lastDate) / 2);
+        const qreal x = date.startOfDay().toMSecsSinceEpoch();
+        if (point.weightMean > 0) {
+            weightDataPoints.append(QPointF(x, point.weightMean));
+            weights << point.weightMin << point.weightMax;
+        }
+        if (point.bmiMean > 0) {
+            bmiDataPoints.append(QPointF(x, point.bmiMean));
+            bmis << point.bmiMin << point.bmiMax;
+        }
+    }
+    static const char* const levelNames[] = { "", " (media semanal)", " (media mensual)", " (media anual)" };
+    weightSeries->setName(QString("Peso (kg)%1").arg(levelNames[level]));
+    bmiSeries->setName(QString("IMC%1").arg(levelNames[level]));
+
+    double minWeight = 0.0;
+    double maxWeight = 0.0;
+    double minBmi = 0.0;
+    double maxBmi = 0.0;
+    MetricKernels::minMax(weights.constData(), std::size_t(weights.size()), minWeight, maxWeight);
+    MetricKernels::minMax(bmis.constData(), std::size_t(bmis.size()), minBmi, maxBmi);
+
+    // Previsión de peso a 90 días desde el estado incremental del paciente
+    const WeightForecaster::State forecastState = WeightForecaster::instance()->state(m_currentPatient->id());
+    const QVector<WeightForecaster::Point> forecast = WeightForecaster::forecast(forecastState, kForecastHorizonDays);
+    QList<QPointF> forecastPoints;
+    QList<QPointF> upperPoints;
+    QList<QPointF> lowerPoints;
+    qint64 forecastEndMs = 0;
+    for (const WeightForecaster::Point& point : forecast) {
+        const qreal x = point.date.startOfDay().toMSecsSinceEpoch();
+        forecastPoints.append(QPointF(x, point.weight));
+        upperPoints.append(QPointF(x, point.upper));
+        lowerPoints.append(QPointF(x, point.lower));
+        minWeight = qMin(minWeight, point.lower);
+        maxWeight = qMax(maxWeight, point.upper);
+        forecastEndMs = qint64(x);
+    }
+    forecastSeries->replace(forecastPoints);
+    forecastUpperSeries->replace(upperPoints);
+    forecastLowerSeries->replace(lowerPoints);
+    forecastBandSeries->setVisible(!forecast.isEmpty());
+    forecastSeries->setVisible(!forecast.isEmpty());
+
+    // Para objetivos de pérdida de peso, fecha estimada en la que se alcanzaría un IMC de 25
+    QString weightTitle = "Evolución del peso";
+    const HealthMetric latestMetric = m_healthMetricManager.getLatestHealthMetric(m_currentPatient->id());
+    if (m_currentPatient->goal().startsWith("Perder", Qt::CaseInsensitive) && latestMetric.height() > 0) {
+        const double heightMeters = latestMetric.height() / 100.0;
+        const QDate reachDate = WeightForecaster::estimatedDateFor(forecastState, 25.0 * heightMeters * heightMeters);
+        if (reachDate.isValid()) {
+            weightTitle += QString(" (IMC 25 previsto el %1)").arg(reachDate.toString("dd/MM/yyyy"));
         }
     }
+    weightChart->setTitle(weightTitle);
 
-    // Ordenar los puntos por fecha (coordenada X) para asegurar que la linea sea continua y correcta
-    std::sort(weightDataPoints.begin(), weightDataPoints.end(), [](const QPointF& a, const QPointF& b){
-        return a.x() < b.x();
-    });
-    std::sort(bmiDataPoints.begin(), bmiDataPoints.end(), [](const QPointF& a, const QPointF& b){
-        return a.x() < b.x();
-    });
+    // Anadir los puntos ordenados a las series de las graficas (de una vez, sin repintar por punto)
+    weightSeries->replace(weightDataPoints);
+    bmiSeries->replace(bmiDataPoints);
 
-    // Anadir los puntos ordenados a las series de las graficas
-    for (const auto& point : weightDataPoints) {
-        weightSeries->append(point);
+    // Curvas de percentiles de IMC para pacientes dentro de la cobertura de las tablas de la OMS
+    for (QLineSeries* series : std::as_const(bmiPercentileSeries)) {
+        bmiChart->removeSeries(series);
+        delete series;
     }
-    for (const auto& point : bmiDataPoints) {
-        bmiSeries->append(point);
+    bmiPercentileSeries.clear();
+    GrowthReference::Sex sex;
+    if (!bmiDataPoints.isEmpty() && GrowthReference::sexFor(m_currentPatient->gender(), sex)) {
+        const QDate birthDate = m_currentPatient->birthDate();
+        const QDate firstDate = QDateTime::fromMSecsSinceEpoch(qint64(bmiDataPoints.first().x())).date();
+        const QDate lastDate = QDateTime::fromMSecsSinceEpoch(qint64(bmiDataPoints.last().x())).date();
+        // Una muestra por semana entre la primera y la última medición cubiertas
+        const double maxAge = GrowthReference::maxAgeMonths(GrowthReference::BmiForAge, sex);
+        QVector<double> ages;
+        QVector<qint64> times;
+        for (QDate date = firstDate; date <= lastDate; date = date.addDays(7)) {
+            const double age = GrowthReference::ageInMonths(birthDate, date);
+            if (age >= 0.0 && age <= maxAge) {
+                ages.append(age);
+                times.append(date.startOfDay().toMSecsSinceEpoch());
+            }
+        }
+        if (!ages.isEmpty()) {
+            const QVector<QVector<double>> curves = GrowthReference::bands(GrowthReference::BmiForAge, sex, ages,
+                                                                           GrowthReference::standardZLevels());
+            const QStringList names = GrowthReference::standardPercentileNames();
+            for (int k = 0; k < curves.size(); ++k) {
+                QList<QPointF> points;
+                points.reserve(ages.size());
+                for (int i = 0; i < ages.size(); ++i) {
+                    points.append(QPointF(times.at(i), curves.at(k).at(i)));
+                }
+                double curveMin = 0.0;
+                double curveMax = 0.0;
+                MetricKernels::minMax(curves.at(k).constData(), std::size_t(curves.at(k).size()), curveMin, curveMax);
+                minBmi = qMin(minBmi, curveMin);
+                maxBmi = qMax(maxBmi, curveMax);
+
+                QLineSeries* series = new QLineSeries(bmiChart);
+                series->setName(names.at(k));
+                QPen pen(k == curves.size() / 2 ? Qt::darkGray : Qt::lightGray);
+                pen.setStyle(Qt::DashLine);
+                series->setPen(pen);
+                series->replace(points);
+                bmiChart->addSeries(series);
+                series->attachAxis(bmiAxisX);
+                series->attachAxis(bmiAxisY);
+                bmiPercentileSeries.append(series);
+            }
+        }
     }
 
     // Ajustar los rangos de los ejes solo si hay datos para mostrar
     if (!weightDataPoints.isEmpty()) {
         // Rangos para el Eje X (Fechas)
         // Agrega un pequeno margen para que los puntos no esten en el borde
-        qint64 minMs = minDate.toMSecsSinceEpoch();
-        qint64 maxMs = maxDate.toMSecsSinceEpoch();
+        qint64 minMs = qint64(weightDataPoints.first().x());
+        qint64 maxMs = qint64(weightDataPoints.last().x());
         if (minMs == maxMs) { // Si solo hay un punto, extendemos el rango un dia a cada lado
             minMs -= 86400000; // 24 horas en milisegundos
             maxMs += 86400000;
@@ -387,8 +751,9 @@ void PatientDetailsWindow::updateCharts()
             maxMs += marginMs;
         }
 
-        // Establecer el rango de los ejes de fecha
-        weightAxisX->setRange(QDateTime::fromMSecsSinceEpoch(minMs), QDateTime::fromMSecsSinceEpoch(maxMs));
+        // Establecer el rango de los ejes de fecha (el de peso se alarga hasta el final de la previsión)
+        weightAxisX->setRange(QDateTime::fromMSecsSinceEpoch(minMs),
+                              QDateTime::fromMSecsSinceEpoch(qMax(maxMs, forecastEndMs)));
         bmiAxisX->setRange(QDateTime::fromMSecsSinceEpoch(minMs), QDateTime::fromMSecsSinceEpoch(maxMs));
 
         // Rangos para los Ejes Y (Valores)
@@ -405,3 +770,176 @@ void PatientDetailsWindow::updateCharts()
         bmiAxisY->setRange(0, 40);   // Ejemplo de rango para IMC (0-40)
     }
 }
+
+void PatientDetailsWindow::loadPhotos()
+{
+    QListWidget *strip = ui->photoStripListWidget;
+    strip->clear();
+    m_photoItems.clear();
+
+    const QList<PhotoStore::Photo> photos = PhotoStore::instance()->photosForUser(m_currentPatient->id());
+    strip->setVisible(!photos.isEmpty());
+    const QLocale locale;
+    for (const PhotoStore::Photo& photo : photos) {
+        // Todos los elementos empiezan con el marcador; nada se decodifica hasta que sea visible
+        QListWidgetItem *item = new QListWidgetItem(m_photoPlaceholder, photo.takenAt.date().toString(Qt::ISODate));
+        item->setData(kPhotoIdRole, photo.photoId);
+        item->setData(kPhotoHashRole, photo.sha256);
+        item->setData(kPhotoLoadedRole, false);
+        item->setToolTip(QString("%1\n%2 × %3 px, %4")
+                             .arg(photo.metricId > 0 ? QString("Medición del %1").arg(photo.takenAt.date().toString(Qt::ISODate))
+                                                     : QString("Sin medición asociada"))
+                             .arg(photo.width)
+                             .arg(photo.height)
+                             .arg(locale.formattedDataSize(photo.byteSize)));
+        strip->addItem(item);
+        m_photoItems.insert(photo.sha256, item);
+    }
+    loadVisibleThumbnails();
+}
+
+void PatientDetailsWindow::loadVisibleThumbnails()
+{
+    QListWidget *strip = ui->photoStripListWidget;
+    if (!strip->isVisible() || strip->count() == 0) {
+        return;
+    }
+    const QRect viewport = strip->viewport()->rect();
+    // Los elementos están en una sola fila ordenada: se empieza por el primero visible
+    // y se para en cuanto uno queda a la derecha de la zona visible
+    const QModelIndex first = strip->indexAt(QPoint(viewport.left() + 1, viewport.center().y()));
+    for (int row = first.isValid() ? first.row() : 0; row < strip->count(); ++row) {
+        QListWidgetItem *item = strip->item(row);
+        const QRect rect = strip->visualItemRect(item);
+        if (rect.left() > viewport.right()) {
+            break;
+        }
+        if (!rect.intersects(viewport) || item->data(kPhotoLoadedRole).toBool()) {
+            continue;
+        }
+        const QImage image = PhotoStore::instance()->thumbnail(item->data(kPhotoHashRole).toString(),
+                                                               PhotoStore::SmallThumbnail);
+        if (!image.isNull()) { // Si no estaba en caché llegará por onThumbnailReady
+            item->setIcon(QIcon(QPixmap::fromImage(image)));
+            item->setData(kPhotoLoadedRole, true);
+        }
+    }
+}
+
+bool PatientDetailsWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == ui->photoStripListWidget->viewport() && event->type() == QEvent::Resize) {
+        loadVisibleThumbnails();
+    } else if (watched == ui->widgetWeight && (event->type() == QEvent::Resize || event->type() == QEvent::Show)) {
+        m_chartResizeTimer->start();
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+int PatientDetailsWindow::chartPixelWidth() const
+{
+    if (!ui->widgetWeight->isVisible()) {
+        return 0;
+    }
+    // El área de trazado descuenta ejes y márgenes; antes de su primer pintado está vacía
+    const int plotWidth = weightChart ? int(weightChart->plotArea().width()) : 0;
+    return plotWidth > 0 ? plotWidth : ui->widgetWeight->width();
+}
+
+// Primera lectura de las gráficas con la ventana ya distribuida y, después, solo cuando el nuevo
+// ancho pide otro nivel de resumen
+void PatientDetailsWindow::onChartResized()
+{
+    const int width = chartPixelWidth();
+    if (width <= 0) {
+        return;
+    }
+    if (!m_chartsLoaded || MetricRollups::levelFor(m_chartFrom, m_chartTo, width) != m_chartLevel) {
+        updateCharts();
+    }
+}
+
+void PatientDetailsWindow::on_fullHistoryCheckBox_toggled(bool checked)
+{
+    Q_UNUSED(checked);
+    loadHealthMetrics();
+}
+
+void PatientDetailsWindow::onThumbnailReady(const QString& sha256, int size, const QImage& image)
+{
+    if (size != PhotoStore::SmallThumbnail) {
+        return;
+    }
+    const QList<QListWidgetItem*> items = m_photoItems.values(sha256);
+    if (items.isEmpty()) {
+        return;
+    }
+    const QIcon icon(QPixmap::fromImage(image));
+    for (QListWidgetItem *item : items) {
+        item->setIcon(icon);
+        item->setData(kPhotoLoadedRole, true);
+    }
+}
+
+void PatientDetailsWindow::onPhotosChanged(int userId)
+{
+    if (m_currentPatient && userId == m_currentPatient->id()) {
+        loadPhotos();
+    }
+}
+
+void PatientDetailsWindow::on_addPhotoButton_clicked()
+{
+    const QStringList files = QFileDialog::getOpenFileNames(this, "Añadir fotos de progreso", QString(),
+                                                            "Imágenes (*.jpg *.jpeg *.png *.webp *.bmp)");
+    if (files.isEmpty()) {
+        return;
+    }
+
+    // Con una medición seleccionada las fotos se enlazan con ella y toman su fecha
+    int metricId = -1;
+    QDate metricDate;
+    const int currentRow = ui->healthMetricsTableWidget->currentRow();
+    if (currentRow >= 0 && ui->healthMetricsTableWidget->item(currentRow, 8)) {
+        metricId = ui->healthMetricsTableWidget->item(currentRow, 8)->text().toInt();
+        metricDate = QDate::fromString(ui->healthMetricsTableWidget->item(currentRow, 0)->text(), Qt::ISODate);
+    }
+
+    QStringList errors;
+    for (const QString& file : files) {
+        const QDateTime takenAt = metricDate.isValid() ? metricDate.startOfDay() : QFileInfo(file).lastModified();
+        QString error;
+        if (PhotoStore::instance()->addPhoto(m_currentPatient->id(), metricId, file, takenAt, &error) < 0) {
+            errors << error;
+        }
+    }
+    if (!errors.isEmpty()) {
+        QMessageBox::warning(this, "Fotos de progreso", "No se pudieron añadir algunas fotos:\n" + errors.join('\n'));
+    }
+}
+
+void PatientDetailsWindow::onPhotoActivated(QListWidgetItem *item)
+{
+    if (!item) {
+        return;
+    }
+    const QString path = PhotoStore::instance()->originalPath(item->data(kPhotoHashRole).toString());
+    if (!QDesktopServices::openUrl(QUrl::fromLocalFile(path))) {
+        QMessageBox::warning(this, "Fotos de progreso", "No se pudo abrir la foto.");
+    }
+}
+
+void PatientDetailsWindow::removeSelectedPhoto()
+{
+    QListWidgetItem *item = ui->photoStripListWidget->currentItem();
+    if (!item) {
+        return;
+    }
+    if (QMessageBox::question(this, "Eliminar foto", "¿Eliminar esta foto de la ficha del paciente?")
+        != QMessageBox::Yes) {
+        return;
+    }
+    if (!PhotoStore::instance()->removePhoto(item->data(kPhotoIdRole).toInt())) {
+        QMessageBox::critical(this, "Error", "No se pudo eliminar la foto.");
+    }
+}
@@ -7,16 +7,22 @@
 
 #include <QSqlTableModel>
 #include <QDateTime>
+#include <QListWidget>
+#include <QMultiHash>
+#include <QTimer>
 
 // Incluimos las clases que vamos a necesitar
 #include "user.h" // Para recibir el objeto User
 #include "healthmetricmanager.h" // Para gestionar las métricas de salud
+#include "photostore.h" // Fotos de progreso del paciente
+#include "metricrollups.h" // Nivel de resumen de las gráficas
 
 #include <QtCharts/QtCharts>
 #include <QtCharts/QChartView>
 #include <QtCharts/QLineSeries>
 #include <QtCharts/QValueAxis>
 #include <QtCharts/QDateTimeAxis>
+#include <QtCharts/QAreaSeries>
 
 // Declaración forward para la interfaz de usuario generada por Qt Designer
 namespace Ui {
@@ -33,6 +39,11 @@ public:
     explicit PatientDetailsWindow(QSharedPointer<User> patient, QWidget *parent = nullptr);
     ~PatientDetailsWindow();
 
+protected:
+    // Al cambiar el tamaño de la tira de fotos se decodifican las que pasan a ser visibles;
+    // al cambiar el de la gráfica de peso se comprueba si conviene otro nivel de resumen
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private:
     // Puntero inteligente para la interfaz de usuario
     QScopedPointer<Ui::PatientDetailsWindow> ui;
@@ -49,26 +60,73 @@ private:
     QLineSeries *weightSeries;
     QDateTimeAxis *weightAxisX;
     QValueAxis *weightAxisY;
+    QLineSeries *forecastSeries;      // Previsión de peso (línea discontinua)
+    QLineSeries *forecastUpperSeries; // Límites de la banda de confianza
+    QLineSeries *forecastLowerSeries;
+    QAreaSeries *forecastBandSeries;
+    static const int kForecastHorizonDays = 90;
 
     QChart *bmiChart;          // Objeto grafico para el IMC
     QLineSeries *bmiSeries;    // Serie de datos para el IMC
     QDateTimeAxis *bmiAxisX;   // Eje X (fecha) para el IMC
     QValueAxis *bmiAxisY;      // Eje Y (valor) para el IMC
+    QList<QLineSeries*> bmiPercentileSeries; // Curvas de percentiles de IMC (solo pacientes pediátricos)
+
+    // Las gráficas se leen cuando ya tienen su ancho definitivo (no en el constructor): el nivel de
+    // resumen depende de los píxeles disponibles. Al redimensionar solo se vuelven a leer si cambia.
+    QTimer *m_chartResizeTimer;
+    bool m_chartsLoaded;
+    MetricRollups::Level m_chartLevel;
+    QDate m_chartFrom; // Rango de fechas del historial representado
+    QDate m_chartTo;
+
+    // La tabla muestra por defecto las mediciones de los últimos meses; el historial completo, a petición
+    static const int kTableMonths = 12;
+
+    // Tira de fotos de progreso: al abrir la ficha solo se leen los metadatos; cada miniatura se
+    // pide a PhotoStore cuando su elemento entra en la zona visible
+    QMultiHash<QString, QListWidgetItem*> m_photoItems; // sha256 -> elementos de la tira
+    QIcon m_photoPlaceholder;
 
 
     // Métodos privados para configurar la interfaz y cargar datos
     void setupUi();
     void loadPatientData();
     void loadHealthMetrics();
+    // Metabolismo basal, gasto total y objetivo calórico con la última medición
+    void updateEnergyEstimate();
+    // Percentiles pediátricos (OMS) de la última medición; se oculta si el paciente no está cubierto
+    void updateGrowthAssessment();
+    // Alertas clínicas activas del paciente (ClinicalAlertEngine)
+    void updateAlerts();
+    // Diálogo con las alertas activas para marcarlas como revisadas (clic en el recuento)
+    void showAlerts();
+    // Ingesta de los últimos 7 días frente a los objetivos (lee el resumen diario de FoodDiary)
+    void updateIntake(double targetKcal);
+    // Metadatos de las fotos del paciente (sin leer ninguna imagen)
+    void loadPhotos();
+    // Pide las miniaturas de los elementos visibles de la tira que aún no la tienen
+    void loadVisibleThumbnails();
+    // Mediciones del paciente como valores (referencia para el detector de anomalías)
+    QList<HealthMetric> metricHistory();
 
     void loadPatientMetrics();
     void setupCharts();
     void updateCharts();
+    // Ancho en píxeles del área de la gráfica de peso (0 si aún no se ha distribuido)
+    int chartPixelWidth() const;
+    void onChartResized();
 
 private slots:
         void on_addMetricButton_clicked(); // Nuevo slot para el botón
         void on_pushButtonEditar_clicked();
         void on_pushButtonBorrar_clicked();
+        void on_addPhotoButton_clicked();
+        void onThumbnailReady(const QString& sha256, int size, const QImage& image);
+        void onPhotosChanged(int userId);
+        void onPhotoActivated(QListWidgetItem *item);
+        void removeSelectedPhoto();
+        void on_fullHistoryCheckBox_toggled(bool checked);
 
 };
 
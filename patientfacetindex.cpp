@@ -0,0 +1,186 @@
+#include "patientfacetindex.h"
+#include <QDebug>
+#include <QElapsedTimer>
+
+namespace {
+
+// Etiqueta usada cuando el paciente no tiene ninguna medición
+const char* const kNoBmiData = "Sin datos";
+
+} // namespace
+
+PatientFacetIndex::PatientFacetIndex()
+    : m_loaded(false)
+{
+}
+
+QStringList PatientFacetIndex::ageBands()
+{
+    return { "0-17", "18-29", "30-44", "45-64", "65+" };
+}
+
+// Clasificación de la OMS para adultos
+QStringList PatientFacetIndex::bmiBands()
+{
+    return { "Bajo peso", "Normal", "Sobrepeso", "Obesidad I", "Obesidad II", "Obesidad III", kNoBmiData };
+}
+
+QString PatientFacetIndex::ageBand(const QDate& birthDate, const QDate& today)
+{
+    if (!birthDate.isValid()) {
+        return QString();
+    }
+    int age = today.year() - birthDate.year();
+    if (today.month() < birthDate.month()
+        || (today.month() == birthDate.month() && today.day() < birthDate.day())) {
+        --age; // Todavía no ha cumplido años este año
+    }
+    if (age < 18) return "0-17";
+    if (age < 30) return "18-29";
+    if (age < 45) return "30-44";
+    if (age < 65) return "45-64";
+    return "65+";
+}
+
+QString PatientFacetIndex::bmiBand(double bmi)
+{
+    if (bmi <= 0.0) return kNoBmiData;
+    if (bmi < 18.5) return "Bajo peso";
+    if (bmi < 25.0) return "Normal";
+    if (bmi < 30.0) return "Sobrepeso";
+    if (bmi < 35.0) return "Obesidad I";
+    if (bmi < 40.0) return "Obesidad II";
+    return "Obesidad III";
+}
+
+void PatientFacetIndex::rebuild(const QList<QSharedPointer<User>>& users, const QHash<int, double>& latestBmi,
+                                const QDate& today)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    for (auto& bitmaps : m_bitmaps) {
+        bitmaps.clear();
+    }
+    m_patients.clear();
+    m_all.clear();
+    m_today = today;
+
+    m_patients.reserve(users.count());
+    for (const QSharedPointer<User>& user : users) {
+        if (!user) {
+            continue;
+        }
+        setUser(*user);
+        setLatestBmi(user->id(), latestBmi.value(user->id(), 0.0));
+    }
+
+    m_loaded = true;
+    qInfo() << "Índice de facetas construido:" << m_patients.count() << "pacientes en" << timer.elapsed() << "ms";
+}
+
+void PatientFacetIndex::assign(int userId, PatientFacets& facets, Facet facet, const QString& value)
+{
+    QString& current = facets.values[facet];
+    if (current == value && m_bitmaps[facet].contains(value)) {
+        return;
+    }
+    if (!current.isNull()) {
+        auto it = m_bitmaps[facet].find(current);
+        if (it != m_bitmaps[facet].end()) {
+            it.value().remove(quint32(userId));
+            if (it.value().isEmpty()) {
+                m_bitmaps[facet].erase(it);
+            }
+        }
+    }
+    current = value;
+    if (!value.isNull()) {
+        m_bitmaps[facet][value].add(quint32(userId));
+    }
+}
+
+void PatientFacetIndex::setUser(const User& user)
+{
+    const int userId = user.id();
+    const bool isNew = !m_patients.contains(userId);
+    PatientFacets& facets = m_patients[userId];
+    facets.birthDate = user.birthDate();
+
+    assign(userId, facets, Gender, user.gender());
+    assign(userId, facets, ActivityLevel, user.activityLevel());
+    assign(userId, facets, Goal, user.goal());
+    assign(userId, facets, AgeBand, ageBand(user.birthDate(), m_today.isValid() ? m_today : QDate::currentDate()));
+    if (isNew) {
+        assign(userId, facets, BmiBand, kNoBmiData);
+    }
+    m_all.add(quint32(userId));
+}
+
+void PatientFacetIndex::removeUser(int userId)
+{
+    auto it = m_patients.find(userId);
+    if (it == m_patients.end()) {
+        return;
+    }
+    for (int facet = 0; facet < FacetCount; ++facet) {
+        assign(userId, it.value(), Facet(facet), QString());
+    }
+    m_patients.erase(it);
+    m_all.remove(quint32(userId));
+}
+
+void PatientFacetIndex::setLatestBmi(int userId, double bmi)
+{
+    auto it = m_patients.find(userId);
+    if (it == m_patients.end()) {
+        return;
+    }
+    assign(userId, it.value(), BmiBand, bmiBand(bmi));
+}
+
+void PatientFacetIndex::refreshAgeBands(const QDate& today)
+{
+    if (today == m_today) {
+        return;
+    }
+    m_today = today;
+    for (auto it = m_patients.begin(); it != m_patients.end(); ++it) {
+        assign(it.key(), it.value(), AgeBand, ageBand(it.value().birthDate, today));
+    }
+}
+
+RoaringBitmap PatientFacetIndex::match(const Selection& selection) const
+{
+    RoaringBitmap result = m_all;
+    for (auto it = selection.cbegin(); it != selection.cend(); ++it) {
+        if (it.value().isEmpty()) {
+            continue;
+        }
+        RoaringBitmap facetUnion;
+        for (const QString& value : it.value()) {
+            facetUnion |= m_bitmaps[it.key()].value(value);
+        }
+        result &= facetUnion;
+        if (result.isEmpty()) {
+            break;
+        }
+    }
+    return result;
+}
+
+QMap<QString, quint64> PatientFacetIndex::counts(Facet facet, const RoaringBitmap& within) const
+{
+    QMap<QString, quint64> result;
+    for (auto it = m_bitmaps[facet].cbegin(); it != m_bitmaps[facet].cend(); ++it) {
+        result.insert(it.key(), within.intersectionCardinality(it.value()));
+    }
+    return result;
+}
+
+QStringList PatientFacetIndex::values(Facet facet) const
+{
+    QStringList result = m_bitmaps[facet].keys();
+    result.sort();
+    return result;
+}
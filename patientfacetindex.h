@@ -0,0 +1,72 @@
+#ifndef PATIENTFACETINDEX_H
+#define PATIENTFACETINDEX_H
+
+#include <QDate>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QSharedPointer>
+#include <QStringList>
+#include "roaringbitmap.h"
+#include "user.h"
+
+// Motor de filtrado por facetas de la lista de pacientes.
+// Mantiene un bitmap comprimido de IDs de paciente por cada valor de género, nivel de actividad,
+// objetivo, franja de edad (derivada de la fecha de nacimiento) y franja de IMC (última medición).
+// Un filtro combinado es la intersección de bitmaps; los recuentos por valor no recorren pacientes.
+class PatientFacetIndex
+{
+public:
+    enum Facet {
+        Gender,
+        ActivityLevel,
+        Goal,
+        AgeBand,
+        BmiBand,
+        FacetCount
+    };
+
+    // Valores elegidos por faceta: dentro de una faceta se combinan con OR y entre facetas con AND.
+    // Una faceta ausente (o con lista vacía) no filtra.
+    using Selection = QMap<Facet, QStringList>;
+
+    PatientFacetIndex();
+
+    void rebuild(const QList<QSharedPointer<User>>& users, const QHash<int, double>& latestBmi,
+                 const QDate& today = QDate::currentDate());
+    bool isLoaded() const { return m_loaded; }
+
+    // Mantenimiento incremental
+    void setUser(const User& user);          // Alta o modificación
+    void removeUser(int userId);
+    void setLatestBmi(int userId, double bmi); // bmi <= 0 significa "sin mediciones"
+    // Las franjas de edad dependen del día actual; recalcula solo si ha cambiado la fecha
+    void refreshAgeBands(const QDate& today);
+
+    RoaringBitmap match(const Selection& selection) const;
+    // Número de pacientes de 'within' para cada valor de la faceta
+    QMap<QString, quint64> counts(Facet facet, const RoaringBitmap& within) const;
+    QStringList values(Facet facet) const;
+    const RoaringBitmap& allPatients() const { return m_all; }
+
+    static QString ageBand(const QDate& birthDate, const QDate& today);
+    static QString bmiBand(double bmi);
+    static QStringList ageBands();
+    static QStringList bmiBands();
+
+private:
+    struct PatientFacets {
+        QDate birthDate;
+        QString values[FacetCount];
+    };
+
+    QHash<QString, RoaringBitmap> m_bitmaps[FacetCount];
+    QHash<int, PatientFacets> m_patients;
+    RoaringBitmap m_all;
+    QDate m_today;
+    bool m_loaded;
+
+    void assign(int userId, PatientFacets& facets, Facet facet, const QString& value);
+};
+
+#endif // PATIENTFACETINDEX_H
@@ -0,0 +1,375 @@
+#include "photostore.h"
+#include "datachangehub.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QtConcurrent>
+
+namespace {
+
+const char* const kColumns = "photo_id, user_id, metric_id, sha256, format, width, height, byte_size, taken_at";
+const PhotoStore::ThumbnailSize kThumbnailSizes[] = {
+    PhotoStore::LargeThumbnail, PhotoStore::MediumThumbnail, PhotoStore::SmallThumbnail // De mayor a menor
+};
+const int kThumbnailCacheKb = 64 * 1024;
+const int kThumbnailQuality = 85;
+
+// Los archivos se reparten en subdirectorios por los dos primeros caracteres del hash
+// para no acumular miles de entradas en un solo directorio
+QString shardDir(const QString& root, const QString& sha256)
+{
+    return QDir(root).filePath(sha256.left(2));
+}
+
+QString originalFile(const QString& root, const QString& sha256)
+{
+    return QDir(shardDir(root, sha256)).filePath(sha256);
+}
+
+QString thumbnailFile(const QString& root, const QString& sha256, int size)
+{
+    return QDir(shardDir(root, sha256)).filePath(QString("%1_%2.jpg").arg(sha256).arg(size));
+}
+
+PhotoStore::Photo photoFromQuery(const QSqlQuery& query)
+{
+    PhotoStore::Photo photo;
+    photo.photoId = query.value(0).toInt();
+    photo.userId = query.value(1).toInt();
+    photo.metricId = query.value(2).isNull() ? -1 : query.value(2).toInt();
+    photo.sha256 = query.value(3).toString();
+    photo.format = query.value(4).toString();
+    photo.width = query.value(5).toInt();
+    photo.height = query.value(6).toInt();
+    photo.byteSize = query.value(7).toLongLong();
+    photo.takenAt = QDateTime::fromString(query.value(8).toString(), Qt::ISODate);
+    return photo;
+}
+
+// Se ejecuta en el pool: solo toca archivos e imágenes (QImage, nunca QPixmap).
+// Si la miniatura ya está en disco, se decodifica solo esa (unos pocos KB). Si no, se decodifica el
+// original una vez y se generan todas las resoluciones, cada una a partir de la anterior.
+QImage loadThumbnail(const QString& root, const QString& sha256, int size)
+{
+    const QString path = thumbnailFile(root, sha256, size);
+    if (QFileInfo::exists(path)) {
+        QImageReader reader(path);
+        const QImage image = reader.read();
+        if (!image.isNull()) {
+            return image;
+        }
+    }
+
+    QImageReader reader(originalFile(root, sha256));
+    reader.setAutoTransform(true); // Orientación EXIF de las fotos de móvil
+    // Con JPEG el decodificador escala durante la lectura: no hace falta la imagen completa en memoria
+    const QSize original = reader.size();
+    const int limit = 2 * PhotoStore::LargeThumbnail;
+    if (original.isValid() && (original.width() > limit || original.height() > limit)) {
+        reader.setScaledSize(original.scaled(limit, limit, Qt::KeepAspectRatio));
+    }
+    QImage current = reader.read();
+    if (current.isNull()) {
+        qWarning() << "No se pudo leer la foto" << sha256 << ":" << reader.errorString();
+        return QImage();
+    }
+
+    QImage requested;
+    for (PhotoStore::ThumbnailSize thumbnailSize : kThumbnailSizes) {
+        if (current.width() > thumbnailSize || current.height() > thumbnailSize) {
+            current = current.scaled(thumbnailSize, thumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+        QSaveFile file(thumbnailFile(root, sha256, thumbnailSize)); // Escritura atómica
+        if (!file.open(QIODevice::WriteOnly) || !current.save(&file, "JPG", kThumbnailQuality) || !file.commit()) {
+            qWarning() << "No se pudo guardar la miniatura" << file.fileName();
+        }
+        if (thumbnailSize == size) {
+            requested = current;
+        }
+    }
+    return requested;
+}
+
+} // namespace
+
+PhotoStore* PhotoStore::instance()
+{
+    static PhotoStore store;
+    return &store;
+}
+
+PhotoStore::PhotoStore(QObject *parent)
+    : QObject(parent)
+    , m_thumbnails(kThumbnailCacheKb)
+{
+    // Pool propio: generar miniaturas no debe quitar hilos a QtConcurrent en el resto de la aplicación
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+
+    connect(DataChangeHub::instance(), &DataChangeHub::healthMetricDeleted, this, &PhotoStore::onHealthMetricDeleted);
+    connect(DataChangeHub::instance(), &DataChangeHub::userDeleted, this, &PhotoStore::onUserDeleted);
+}
+
+bool PhotoStore::open(const QString& rootPath)
+{
+    if (!QDir().mkpath(rootPath)) {
+        qCritical() << "No se pudo crear el directorio de fotos" << rootPath;
+        return false;
+    }
+    m_rootPath = rootPath;
+    m_thumbnails.clear();
+    qInfo() << "Almacén de fotos en" << rootPath;
+    return true;
+}
+
+QString PhotoStore::originalPath(const QString& sha256) const
+{
+    return originalFile(m_rootPath, sha256);
+}
+
+QString PhotoStore::thumbnailPath(const QString& sha256, ThumbnailSize size) const
+{
+    return thumbnailFile(m_rootPath, sha256, size);
+}
+
+QString PhotoStore::cacheKey(const QString& sha256, ThumbnailSize size)
+{
+    return QString("%1_%2").arg(sha256).arg(int(size));
+}
+
+int PhotoStore::addPhoto(int userId, int metricId, const QString& sourceFile, const QDateTime& takenAt,
+                         QString* error)
+{
+    auto fail = [error](const QString& message) {
+        qWarning() << message;
+        if (error) {
+            *error = message;
+        }
+        return -1;
+    };
+    if (m_rootPath.isEmpty()) {
+        return fail("El almacén de fotos no está abierto.");
+    }
+
+    QImageReader reader(sourceFile);
+    reader.setAutoTransform(true);
+    if (!reader.canRead()) {
+        return fail(QString("%1 no es una imagen válida.").arg(QFileInfo(sourceFile).fileName()));
+    }
+    QSize size = reader.size(); // Solo la cabecera, sin decodificar
+    if (reader.transformation() & QImageIOHandler::TransformationRotate90) {
+        size.transpose();
+    }
+    const QString format = QString::fromLatin1(reader.format());
+
+    QFile source(sourceFile);
+    if (!source.open(QIODevice::ReadOnly)) {
+        return fail(QString("No se pudo abrir %1: %2").arg(sourceFile, source.errorString()));
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(&source);
+    const QString sha256 = QString::fromLatin1(hash.result().toHex());
+    const qint64 byteSize = source.size();
+    source.close();
+
+    // Mismo contenido, mismo archivo: solo se copia si el hash no está ya en el almacén
+    const QString target = originalPath(sha256);
+    if (!QFileInfo::exists(target)) {
+        const QString temporary = target + ".tmp";
+        QFile::remove(temporary);
+        if (!QDir().mkpath(shardDir(m_rootPath, sha256))
+            || !QFile::copy(sourceFile, temporary)
+            || !QFile::rename(temporary, target)) {
+            QFile::remove(temporary);
+            return fail(QString("No se pudo copiar %1 al almacén de fotos.").arg(sourceFile));
+        }
+    }
+
+    QSqlQuery query;
+    query.prepare("INSERT INTO progress_photos (user_id, metric_id, sha256, format, width, height, byte_size, taken_at) "
+                  "VALUES (:user_id, :metric_id, :sha256, :format, :width, :height, :byte_size, :taken_at)");
+    query.bindValue(":user_id", userId);
+    query.bindValue(":metric_id", metricId > 0 ? QVariant(metricId) : QVariant());
+    query.bindValue(":sha256", sha256);
+    query.bindValue(":format", format);
+    query.bindValue(":width", size.width());
+    query.bindValue(":height", size.height());
+    query.bindValue(":byte_size", byteSize);
+    query.bindValue(":taken_at", takenAt.toString(Qt::ISODate));
+    if (!query.exec()) {
+        removeUnreferencedFiles({sha256});
+        return fail("Error al guardar la foto: " + query.lastError().text());
+    }
+    const int photoId = query.lastInsertId().toInt();
+
+    queueThumbnail(sha256, SmallThumbnail); // Genera de paso todas las resoluciones
+    emit photosChanged(userId);
+    return photoId;
+}
+
+bool PhotoStore::removePhoto(int photoId)
+{
+    QSqlQuery query;
+    query.prepare("SELECT user_id, sha256 FROM progress_photos WHERE photo_id = :photo_id");
+    query.bindValue(":photo_id", photoId);
+    if (!query.exec() || !query.next()) {
+        qWarning() << "No se encontró la foto" << photoId << query.lastError().text();
+        return false;
+    }
+    const int userId = query.value(0).toInt();
+    const QString sha256 = query.value(1).toString();
+
+    query.prepare("DELETE FROM progress_photos WHERE photo_id = :photo_id");
+    query.bindValue(":photo_id", photoId);
+    if (!query.exec()) {
+        qCritical() << "Error al eliminar la foto" << photoId << ":" << query.lastError().text();
+        return false;
+    }
+    removeUnreferencedFiles({sha256});
+    emit photosChanged(userId);
+    return true;
+}
+
+bool PhotoStore::setMetric(int photoId, int metricId)
+{
+    QSqlQuery query;
+    query.prepare("UPDATE progress_photos SET metric_id = :metric_id WHERE photo_id = :photo_id");
+    query.bindValue(":metric_id", metricId > 0 ? QVariant(metricId) : QVariant());
+    query.bindValue(":photo_id", photoId);
+    if (!query.exec()) {
+        qCritical() << "Error al enlazar la foto" << photoId << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+QList<PhotoStore::Photo> PhotoStore::photosForUser(int userId)
+{
+    QList<Photo> photos;
+    QSqlQuery query;
+    query.prepare(QString("SELECT %1 FROM progress_photos WHERE user_id = :user_id "
+                          "ORDER BY taken_at, photo_id").arg(kColumns));
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al leer las fotos del paciente" << userId << ":" << query.lastError().text();
+        return photos;
+    }
+    while (query.next()) {
+        photos.append(photoFromQuery(query));
+    }
+    return photos;
+}
+
+QList<PhotoStore::Photo> PhotoStore::photosForMetric(int metricId)
+{
+    QList<Photo> photos;
+    QSqlQuery query;
+    query.prepare(QString("SELECT %1 FROM progress_photos WHERE metric_id = :metric_id "
+                          "ORDER BY taken_at, photo_id").arg(kColumns));
+    query.bindValue(":metric_id", metricId);
+    if (!query.exec()) {
+        qCritical() << "Error al leer las fotos de la medición" << metricId << ":" << query.lastError().text();
+        return photos;
+    }
+    while (query.next()) {
+        photos.append(photoFromQuery(query));
+    }
+    return photos;
+}
+
+QImage PhotoStore::thumbnail(const QString& sha256, ThumbnailSize size)
+{
+    if (const QImage* cached = m_thumbnails.object(cacheKey(sha256, size))) {
+        return *cached;
+    }
+    queueThumbnail(sha256, size);
+    return QImage();
+}
+
+void PhotoStore::queueThumbnail(const QString& sha256, ThumbnailSize size)
+{
+    const QString key = cacheKey(sha256, size);
+    if (m_rootPath.isEmpty() || m_pending.contains(key)) {
+        return;
+    }
+    m_pending.insert(key);
+
+    auto* watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher, sha256, size, key]() {
+        const QImage image = watcher->result();
+        watcher->deleteLater();
+        m_pending.remove(key);
+        if (image.isNull()) {
+            return;
+        }
+        m_thumbnails.insert(key, new QImage(image), qMax<qsizetype>(1, image.sizeInBytes() / 1024));
+        emit thumbnailReady(sha256, int(size), image);
+    });
+    watcher->setFuture(QtConcurrent::run(&m_pool, loadThumbnail, m_rootPath, sha256, int(size)));
+}
+
+void PhotoStore::removeUnreferencedFiles(const QSet<QString>& hashes)
+{
+    QSqlQuery query;
+    for (const QString& sha256 : hashes) {
+        query.prepare("SELECT COUNT(*) FROM progress_photos WHERE sha256 = :sha256");
+        query.bindValue(":sha256", sha256);
+        if (!query.exec() || !query.next() || query.value(0).toInt() > 0) {
+            continue; // Otra foto (de este u otro paciente) usa el mismo archivo
+        }
+        QFile::remove(originalPath(sha256));
+        for (ThumbnailSize size : kThumbnailSizes) {
+            QFile::remove(thumbnailPath(sha256, size));
+            m_thumbnails.remove(cacheKey(sha256, size));
+        }
+    }
+}
+
+void PhotoStore::onHealthMetricDeleted(int userId, int metricId)
+{
+    // La foto sigue en la ficha del paciente, solo pierde el enlace con la medición
+    QSqlQuery query;
+    query.prepare("UPDATE progress_photos SET metric_id = NULL WHERE metric_id = :metric_id");
+    query.bindValue(":metric_id", metricId);
+    if (!query.exec()) {
+        qWarning() << "Error al desenlazar las fotos de la medición" << metricId << ":" << query.lastError().text();
+        return;
+    }
+    if (query.numRowsAffected() > 0) {
+        emit photosChanged(userId);
+    }
+}
+
+void PhotoStore::onUserDeleted(int userId)
+{
+    QSqlQuery query;
+    query.prepare("SELECT DISTINCT sha256 FROM progress_photos WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qWarning() << "Error al leer las fotos del paciente eliminado" << userId << ":" << query.lastError().text();
+        return;
+    }
+    QSet<QString> hashes;
+    while (query.next()) {
+        hashes.insert(query.value(0).toString());
+    }
+    if (hashes.isEmpty()) {
+        return;
+    }
+
+    query.prepare("DELETE FROM progress_photos WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qWarning() << "Error al eliminar las fotos del paciente" << userId << ":" << query.lastError().text();
+        return;
+    }
+    removeUnreferencedFiles(hashes);
+    emit photosChanged(userId);
+}
@@ -0,0 +1,91 @@
+#ifndef PHOTOSTORE_H
+#define PHOTOSTORE_H
+
+#include <QCache>
+#include <QDateTime>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+
+// Fotos de progreso de los pacientes.
+// Las imágenes no van a la base de datos: se guardan en un almacén direccionado por contenido junto
+// a ella (nutricion.db -> nutricion.photos/), con el SHA-256 del archivo como nombre, así que la
+// misma foto importada dos veces ocupa disco una sola vez. La tabla 'progress_photos' (migración v8)
+// solo guarda los metadatos y el enlace con el paciente y la medición, y leer el historial de
+// mediciones no arrastra ningún BLOB.
+// Las miniaturas (varias resoluciones) se generan y se decodifican en un pool de hilos propio; las
+// ya decodificadas se guardan en una caché en memoria limitada.
+class PhotoStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Lado mayor de cada miniatura en píxeles
+    enum ThumbnailSize {
+        SmallThumbnail = 128,  // Tira de fotos de la ficha del paciente
+        MediumThumbnail = 320,
+        LargeThumbnail = 1024  // Vista previa
+    };
+
+    struct Photo {
+        int photoId = -1;
+        int userId = -1;
+        int metricId = -1; // -1 si no está enlazada a ninguna medición
+        QString sha256;
+        QString format;    // "jpeg", "png"... (QImageReader)
+        int width = 0;
+        int height = 0;
+        qint64 byteSize = 0;
+        QDateTime takenAt;
+    };
+
+    static PhotoStore* instance();
+    // Directorio raíz del almacén; lo abre DatabaseManager al inicializar la base de datos
+    bool open(const QString& rootPath);
+    QString rootPath() const { return m_rootPath; }
+
+    // Copia la imagen al almacén (si su contenido no estaba ya) y la enlaza con el paciente y,
+    // opcionalmente, con una medición. Encola la generación de miniaturas. Retorna el id o -1.
+    int addPhoto(int userId, int metricId, const QString& sourceFile, const QDateTime& takenAt,
+                 QString* error = nullptr);
+    // Borra el enlace; el archivo se elimina cuando ninguna otra foto lo usa
+    bool removePhoto(int photoId);
+    bool setMetric(int photoId, int metricId);
+
+    // Solo metadatos (una consulta por índice): no se lee ninguna imagen
+    QList<Photo> photosForUser(int userId);
+    QList<Photo> photosForMetric(int metricId);
+
+    QString originalPath(const QString& sha256) const;
+    QString thumbnailPath(const QString& sha256, ThumbnailSize size) const;
+
+    // Miniatura desde la caché. Si no está, retorna una imagen nula y la decodifica (o la genera)
+    // en segundo plano; al terminar se emite thumbnailReady.
+    QImage thumbnail(const QString& sha256, ThumbnailSize size);
+
+signals:
+    void thumbnailReady(const QString& sha256, int size, const QImage& image);
+    void photosChanged(int userId);
+
+private slots:
+    void onHealthMetricDeleted(int userId, int metricId);
+    void onUserDeleted(int userId);
+
+private:
+    explicit PhotoStore(QObject *parent = nullptr);
+
+    static QString cacheKey(const QString& sha256, ThumbnailSize size);
+    void queueThumbnail(const QString& sha256, ThumbnailSize size);
+    // Elimina original y miniaturas de los hashes que ya no tiene ninguna foto
+    void removeUnreferencedFiles(const QSet<QString>& hashes);
+
+    QString m_rootPath;
+    QThreadPool m_pool;
+    QCache<QString, QImage> m_thumbnails; // Coste en KB
+    QSet<QString> m_pending;              // Miniaturas en cola (cacheKey)
+};
+
+#endif // PHOTOSTORE_H
@@ -0,0 +1,450 @@
+#include "progressreportengine.h"
+#include "collationkey.h"
+#include "textnormalizer.h"
+#include <QDebug>
+#include <QDir>
+#include <QFontMetricsF>
+#include <QFutureWatcher>
+#include <QLocale>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QPolygonF>
+#include <QRegularExpression>
+#include <QSqlQuery>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int kUsersPerPage = 256; // Pacientes leídos de una vez del registro
+const int kResolutionDpi = 150;
+const double kMarginMm = 15.0;
+const double kChartHeightMm = 65.0;
+
+struct Axis {
+    double min;
+    double max;
+    double step;
+};
+
+// Eje con divisiones "redondas" (1, 2 o 5 por potencia de 10) que cubre [min, max] con margen
+Axis niceAxis(double min, double max, int ticks)
+{
+    if (max - min < 1e-9) {
+        min -= 1.0;
+        max += 1.0;
+    }
+    const double padding = (max - min) * 0.05;
+    min -= padding;
+    max += padding;
+    const double raw = (max - min) / ticks;
+    const double magnitude = std::pow(10.0, std::floor(std::log10(raw)));
+    const double residual = raw / magnitude;
+    const double step = magnitude * (residual > 5 ? 10 : residual > 2 ? 5 : residual > 1 ? 2 : 1);
+    return { std::floor(min / step) * step, std::ceil(max / step) * step, step };
+}
+
+QString optionalValue(double value)
+{
+    return value > 0.0 ? QString::number(value, 'f', 1) : QString("–");
+}
+
+int ageAt(const QDate& birthDate, const QDate& date)
+{
+    int age = date.year() - birthDate.year();
+    if (date.month() < birthDate.month() || (date.month() == birthDate.month() && date.day() < birthDate.day())) {
+        --age;
+    }
+    return age;
+}
+
+// Gráfica de línea con fechas en X (una marca por mes) y valores en Y
+void drawChart(QPainter& painter, const QRectF& rect, double mm, const QString& title, const QColor& color,
+               const QDate& from, const QDate& to, const QVector<QPointF>& points)
+{
+    painter.save();
+    const QFontMetricsF metrics(painter.font());
+    const double lineHeight = metrics.height();
+    painter.drawText(QRectF(rect.left(), rect.top(), rect.width(), lineHeight), Qt::AlignLeft | Qt::AlignVCenter, title);
+
+    const QRectF plot = rect.adjusted(metrics.horizontalAdvance("0000.0") + 2 * mm, lineHeight * 1.5,
+                                      -2 * mm, -lineHeight * 1.5);
+    painter.setPen(QPen(Qt::gray, 0.2 * mm));
+    painter.drawRect(plot);
+    if (points.isEmpty()) {
+        painter.drawText(plot, Qt::AlignCenter, "Sin datos en el periodo");
+        painter.restore();
+        return;
+    }
+
+    double minValue = points.first().y();
+    double maxValue = minValue;
+    for (const QPointF& point : points) {
+        minValue = std::min(minValue, point.y());
+        maxValue = std::max(maxValue, point.y());
+    }
+    const Axis axis = niceAxis(minValue, maxValue, 5);
+    const double days = std::max<qint64>(1, from.daysTo(to));
+    auto mapX = [&](double day) { return plot.left() + plot.width() * day / days; };
+    auto mapY = [&](double value) { return plot.bottom() - plot.height() * (value - axis.min) / (axis.max - axis.min); };
+
+    // Rejilla y etiquetas del eje Y
+    const int decimals = axis.step < 1.0 ? 1 : 0;
+    for (double value = axis.min; value <= axis.max + axis.step / 2; value += axis.step) {
+        const double y = mapY(value);
+        painter.setPen(QPen(QColor(220, 220, 220), 0.15 * mm));
+        painter.drawLine(QPointF(plot.left(), y), QPointF(plot.right(), y));
+        painter.setPen(Qt::black);
+        painter.drawText(QRectF(rect.left(), y - lineHeight / 2, plot.left() - rect.left() - mm, lineHeight),
+                         Qt::AlignRight | Qt::AlignVCenter, QString::number(value, 'f', decimals));
+    }
+    // Una marca al principio de cada mes
+    for (QDate month(from.year(), from.month(), 1); month <= to; month = month.addMonths(1)) {
+        if (month < from) {
+            continue;
+        }
+        const double x = mapX(from.daysTo(month));
+        painter.setPen(QPen(Qt::gray, 0.2 * mm));
+        painter.drawLine(QPointF(x, plot.bottom()), QPointF(x, plot.bottom() + mm));
+        painter.setPen(Qt::black);
+        painter.drawText(QRectF(x - 10 * mm, plot.bottom() + mm, 20 * mm, lineHeight),
+                         Qt::AlignHCenter | Qt::AlignTop, month.toString("MM/yy"));
+    }
+
+    QPolygonF line;
+    for (const QPointF& point : points) {
+        line << QPointF(mapX(point.x()), mapY(point.y()));
+    }
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(color, 0.5 * mm));
+    painter.drawPolyline(line);
+    painter.setBrush(color);
+    for (const QPointF& point : line) {
+        painter.drawEllipse(point, 0.7 * mm, 0.7 * mm);
+    }
+    painter.restore();
+}
+
+} // namespace
+
+ProgressReportEngine* ProgressReportEngine::instance()
+{
+    static ProgressReportEngine engine;
+    return &engine;
+}
+
+ProgressReportEngine::ProgressReportEngine(QObject *parent)
+    : QObject(parent)
+    , m_pageIndex(0)
+    , m_lastUserId(0)
+    , m_exhausted(true)
+    , m_running(false)
+    , m_cancelled(false)
+    , m_inFlight(0)
+    , m_total(0)
+    , m_generated(0)
+    , m_skipped(0)
+    , m_failed(0)
+{
+}
+
+bool ProgressReportEngine::start(const Options& options)
+{
+    if (m_running) {
+        qWarning() << "Ya hay una generación de informes en curso.";
+        return false;
+    }
+    if (!options.month.isValid() || options.historyMonths < 1 || !QDir().mkpath(options.outputDir)) {
+        qWarning() << "Opciones de informe no válidas; directorio:" << options.outputDir;
+        return false;
+    }
+    m_options = options;
+    m_to = QDate(options.month.year(), options.month.month(), 1).addMonths(1).addDays(-1);
+    m_from = QDate(m_to.year(), m_to.month(), 1).addMonths(-(options.historyMonths - 1));
+
+    m_page.clear();
+    m_pageIndex = 0;
+    m_lastSortKey.clear();
+    m_lastUserId = 0;
+    m_exhausted = false;
+    m_cancelled = false;
+    m_inFlight = 0;
+    m_generated = 0;
+    m_skipped = 0;
+    m_failed = 0;
+
+    QSqlQuery query;
+    m_total = query.exec("SELECT COUNT(*) FROM users") && query.next() ? query.value(0).toInt() : 0;
+
+    m_running = true;
+    m_timer.start();
+    qInfo() << "Generando informes de progreso de" << m_to.toString("MM/yyyy") << "en" << options.outputDir
+            << "con" << m_pool.maxThreadCount() << "hilos";
+    pump();
+    return true;
+}
+
+void ProgressReportEngine::cancel()
+{
+    m_cancelled = true;
+    if (m_running && m_inFlight == 0) {
+        finish();
+    }
+}
+
+void ProgressReportEngine::pump()
+{
+    // Como mucho un informe por hilo: la memoria no crece con el tamaño del registro
+    while (!m_cancelled && m_inFlight < m_pool.maxThreadCount()) {
+        ReportData data;
+        if (!nextReport(data)) {
+            break;
+        }
+        const QString path = QDir(m_options.outputDir).filePath(fileNameFor(data));
+        auto* watcher = new QFutureWatcher<QString>(this);
+        connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher]() {
+            const QString error = watcher->result();
+            watcher->deleteLater();
+            onReportRendered(error);
+        });
+        watcher->setFuture(QtConcurrent::run(&m_pool, [data, path]() {
+            QString error;
+            if (!renderReport(data, path, &error) && error.isEmpty()) {
+                error = path;
+            }
+            return error;
+        }));
+        ++m_inFlight;
+    }
+    if (m_inFlight == 0) {
+        finish();
+    }
+}
+
+bool ProgressReportEngine::nextReport(ReportData& data)
+{
+    while (true) {
+        if (m_pageIndex >= m_page.size()) {
+            if (m_exhausted) {
+                return false;
+            }
+            m_page = m_userManager.getUsersPage(m_lastSortKey, m_lastUserId, kUsersPerPage);
+            m_pageIndex = 0;
+            m_exhausted = m_page.size() < kUsersPerPage;
+            if (m_page.isEmpty()) {
+                return false;
+            }
+            const QSharedPointer<User>& last = m_page.last();
+            m_lastSortKey = CollationKey::forUserName(last->firstName(), last->lastName1(), last->lastName2());
+            m_lastUserId = last->id();
+        }
+
+        const QSharedPointer<User> user = m_page.at(m_pageIndex++);
+        QVector<HealthMetric> metrics;
+        for (const QSharedPointer<HealthMetric>& metric : m_healthMetricManager.getHealthMetricsByUserId(user->id(), m_from, m_to)) {
+            metrics.append(*metric);
+        }
+        if (metrics.isEmpty()) {
+            ++m_skipped; // Sin mediciones en el periodo no hay nada que informar
+            continue;
+        }
+
+        data.userId = user->id();
+        data.fullName = QString("%1 %2 %3").arg(user->firstName(), user->lastName1(), user->lastName2()).simplified();
+        data.gender = user->gender();
+        data.birthDate = user->birthDate();
+        data.activityLevel = user->activityLevel();
+        data.goal = user->goal();
+        data.from = m_from;
+        data.to = m_to;
+        data.metrics = metrics;
+        return true;
+    }
+}
+
+void ProgressReportEngine::onReportRendered(const QString& error)
+{
+    --m_inFlight;
+    if (error.isEmpty()) {
+        ++m_generated;
+    } else {
+        ++m_failed;
+        qWarning() << "No se pudo generar el informe:" << error;
+    }
+    emit progress(m_generated + m_skipped + m_failed, m_total);
+    pump();
+}
+
+void ProgressReportEngine::finish()
+{
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    m_page.clear();
+    qInfo() << "Informes de progreso:" << m_generated << "generados," << m_skipped << "sin mediciones,"
+            << m_failed << "con error en" << m_timer.elapsed() << "ms";
+    emit finished(m_generated, m_skipped, m_failed, m_timer.elapsed());
+}
+
+QString ProgressReportEngine::fileNameFor(const ReportData& data)
+{
+    static const QRegularExpression unsafe("[^a-z0-9]+");
+    const QString name = TextNormalizer::fold(data.fullName).replace(unsafe, "_");
+    return QString("%1_%2_%3.pdf").arg(data.to.toString("yyyy-MM")).arg(data.userId).arg(name);
+}
+
+bool ProgressReportEngine::renderReport(const ReportData& data, const QString& filePath, QString* error)
+{
+    QPdfWriter writer(filePath);
+    writer.setResolution(kResolutionDpi);
+    writer.setPageSize(QPageSize(QPageSize::A4));
+    writer.setPageMargins(QMarginsF(kMarginMm, kMarginMm, kMarginMm, kMarginMm), QPageLayout::Millimeter);
+    writer.setTitle(QString("Informe de progreso - %1").arg(data.fullName));
+
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        if (error) {
+            *error = QString("No se pudo crear %1").arg(filePath);
+        }
+        return false;
+    }
+
+    const double mm = writer.resolution() / 25.4; // Píxeles del dispositivo por milímetro
+    const double width = writer.width();
+    const double height = writer.height();
+    const QLocale locale(QLocale::Spanish);
+    QFont font("Helvetica", 9);
+    QFont bold = font;
+    bold.setBold(true);
+    QFont title = bold;
+    title.setPointSize(15);
+    QFont small = font;
+    small.setPointSize(7);
+
+    int pageNumber = 1;
+    auto drawFooter = [&]() {
+        painter.setFont(small);
+        painter.setPen(Qt::gray);
+        const double footerHeight = QFontMetricsF(small).height();
+        painter.drawText(QRectF(0, height - footerHeight, width, footerHeight), Qt::AlignRight | Qt::AlignVCenter,
+                         QString("%1 · Página %2").arg(data.fullName).arg(pageNumber));
+        painter.setPen(Qt::black);
+    };
+
+    // --- Cabecera ---
+    double y = 0;
+    painter.setFont(title);
+    double lineHeight = QFontMetricsF(title).height();
+    painter.drawText(QRectF(0, y, width, lineHeight), Qt::AlignLeft | Qt::AlignVCenter,
+                     QString("Informe de progreso · %1 %2").arg(locale.standaloneMonthName(data.to.month())).arg(data.to.year()));
+    y += lineHeight * 1.3;
+
+    painter.setFont(bold);
+    lineHeight = QFontMetricsF(bold).height();
+    painter.drawText(QRectF(0, y, width, lineHeight), Qt::AlignLeft | Qt::AlignVCenter, data.fullName);
+    y += lineHeight * 1.2;
+
+    const HealthMetric& first = data.metrics.first();
+    const HealthMetric& last = data.metrics.last();
+    QStringList header;
+    header << QString("Género: %1").arg(data.gender);
+    if (data.birthDate.isValid()) {
+        header << QString("Nacimiento: %1 (%2 años)").arg(data.birthDate.toString("dd/MM/yyyy")).arg(ageAt(data.birthDate, data.to));
+    }
+    header << QString("Nivel de actividad: %1").arg(data.activityLevel)
+           << QString("Objetivo: %1").arg(data.goal);
+    const QString summary = QString("Periodo: %1 - %2 · %3 mediciones · Peso: %4 → %5 kg (%6%7 kg) · IMC actual: %8")
+                                .arg(data.from.toString("dd/MM/yyyy"), data.to.toString("dd/MM/yyyy"))
+                                .arg(data.metrics.size())
+                                .arg(first.weight(), 0, 'f', 1)
+                                .arg(last.weight(), 0, 'f', 1)
+                                .arg(last.weight() >= first.weight() ? "+" : "")
+                                .arg(last.weight() - first.weight(), 0, 'f', 1)
+                                .arg(last.bmi(), 0, 'f', 1);
+    painter.setFont(font);
+    lineHeight = QFontMetricsF(font).height();
+    for (const QString& line : { header.join("   "), summary }) {
+        painter.drawText(QRectF(0, y, width, lineHeight), Qt::AlignLeft | Qt::AlignVCenter, line);
+        y += lineHeight * 1.2;
+    }
+    y += 3 * mm;
+
+    // --- Gráficas ---
+    QVector<QPointF> weightPoints;
+    QVector<QPointF> bmiPoints;
+    for (const HealthMetric& metric : data.metrics) {
+        const double day = data.from.daysTo(metric.date());
+        if (metric.weight() > 0.0) {
+            weightPoints << QPointF(day, metric.weight());
+        }
+        if (metric.bmi() > 0.0) {
+            bmiPoints << QPointF(day, metric.bmi());
+        }
+    }
+    const double chartHeight = kChartHeightMm * mm;
+    drawChart(painter, QRectF(0, y, width, chartHeight), mm, "Peso (kg)", QColor(33, 102, 172), data.from, data.to, weightPoints);
+    y += chartHeight + 4 * mm;
+    drawChart(painter, QRectF(0, y, width, chartHeight), mm, "IMC", QColor(26, 152, 80), data.from, data.to, bmiPoints);
+    y += chartHeight + 6 * mm;
+
+    // --- Tabla de mediciones (continúa en páginas nuevas con la cabecera repetida) ---
+    const QStringList columns = { "Fecha", "Peso (kg)", "Altura (cm)", "IMC", "Grasa (%)", "Músculo (%)", "Notas" };
+    const double fractions[] = { 0.13, 0.10, 0.11, 0.08, 0.10, 0.11, 0.37 };
+    QVector<double> columnX;
+    double x = 0;
+    for (double fraction : fractions) {
+        columnX << x;
+        x += fraction * width;
+    }
+    columnX << width;
+    const double rowHeight = lineHeight * 1.5;
+    const double bottom = height - QFontMetricsF(small).height() * 2;
+
+    auto drawRow = [&](const QStringList& cells, bool isHeader) {
+        painter.setFont(isHeader ? bold : font);
+        if (isHeader) {
+            painter.fillRect(QRectF(0, y, width, rowHeight), QColor(235, 235, 235));
+        }
+        const QFontMetricsF metrics(painter.font());
+        for (int c = 0; c < cells.size(); ++c) {
+            const QRectF cell(columnX[c] + mm, y, columnX[c + 1] - columnX[c] - 2 * mm, rowHeight);
+            const bool isText = c == 0 || c == cells.size() - 1;
+            painter.drawText(cell, (isText ? Qt::AlignLeft : Qt::AlignRight) | Qt::AlignVCenter,
+                             metrics.elidedText(cells[c], Qt::ElideRight, cell.width()));
+        }
+        painter.setPen(QPen(QColor(210, 210, 210), 0.15 * mm));
+        painter.drawLine(QPointF(0, y + rowHeight), QPointF(width, y + rowHeight));
+        painter.setPen(Qt::black);
+        y += rowHeight;
+    };
+
+    drawRow(columns, true);
+    for (const HealthMetric& metric : data.metrics) {
+        if (y + rowHeight > bottom) {
+            drawFooter();
+            writer.newPage();
+            ++pageNumber;
+            y = 0;
+            drawRow(columns, true);
+        }
+        drawRow({ metric.date().toString("dd/MM/yyyy"),
+                  QString::number(metric.weight(), 'f', 1),
+                  QString::number(metric.height(), 'f', 1),
+                  QString::number(metric.bmi(), 'f', 1),
+                  optionalValue(metric.bodyFatPercentage()),
+                  optionalValue(metric.muscleMassPercentage()),
+                  metric.notes().simplified() },
+                false);
+    }
+    drawFooter();
+
+    if (!painter.end()) {
+        if (error) {
+            *error = QString("Error al escribir %1").arg(filePath);
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,95 @@
+#ifndef PROGRESSREPORTENGINE_H
+#define PROGRESSREPORTENGINE_H
+
+#include <QByteArray>
+#include <QDate>
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include "healthmetricmanager.h"
+#include "usermanager.h"
+
+// Informes mensuales de progreso en PDF, uno por paciente: datos de cabecera, gráficas de peso e
+// IMC y tabla de mediciones (el mismo contenido que PatientDetailsWindow).
+// Se dibujan con QPainter sobre un QPdfWriter, sin widgets, así que cada informe se genera en un
+// hilo del pool. El hilo principal lee los pacientes por páginas (UserManager::getUsersPage) y
+// solo carga las mediciones del siguiente cuando queda un hilo libre: en memoria nunca hay más
+// datos que los de los informes en curso, uno por hilo.
+class ProgressReportEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        QDate month;            // Cualquier día del mes del informe
+        int historyMonths = 12; // Meses que cubren las gráficas y la tabla (incluido el del informe)
+        QString outputDir;
+    };
+
+    // Todo lo que necesita un informe; se copia al hilo de trabajo
+    struct ReportData {
+        int userId = -1;
+        QString fullName;
+        QString gender;
+        QDate birthDate;
+        QString activityLevel;
+        QString goal;
+        QDate from;
+        QDate to;
+        QVector<HealthMetric> metrics; // En [from, to], por fecha
+    };
+
+    static ProgressReportEngine* instance();
+
+    bool start(const Options& options);
+    bool isRunning() const { return m_running; }
+    // Los informes en curso terminan; no se empieza ninguno más
+    void cancel();
+
+    // Dibuja el informe en 'filePath'. No toca la base de datos ni widgets: apta para cualquier hilo.
+    static bool renderReport(const ReportData& data, const QString& filePath, QString* error = nullptr);
+    static QString fileNameFor(const ReportData& data);
+
+signals:
+    void progress(int done, int total);
+    void finished(int generated, int skipped, int failed, qint64 elapsedMs);
+
+private:
+    explicit ProgressReportEngine(QObject *parent = nullptr);
+
+    // Lanza informes mientras haya hilos libres y pacientes por leer
+    void pump();
+    // Siguiente paciente con mediciones en el periodo; false al agotar el registro
+    bool nextReport(ReportData& data);
+    void onReportRendered(const QString& error); // Error vacío: informe generado
+    void finish();
+
+    UserManager m_userManager;
+    HealthMetricManager m_healthMetricManager;
+    QThreadPool m_pool;
+    QElapsedTimer m_timer;
+    Options m_options;
+    QDate m_from;
+    QDate m_to;
+
+    // Cursor sobre el registro de pacientes (paginación por clave de ordenación)
+    QList<QSharedPointer<User>> m_page;
+    int m_pageIndex;
+    QByteArray m_lastSortKey;
+    int m_lastUserId;
+    bool m_exhausted;
+
+    bool m_running;
+    bool m_cancelled;
+    int m_inFlight;
+    int m_total;
+    int m_generated;
+    int m_skipped;
+    int m_failed;
+};
+
+#endif // PROGRESSREPORTENGINE_H
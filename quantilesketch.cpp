@@ -0,0 +1,63 @@
+#include "quantilesketch.h"
+#include <cmath>
+#include <limits>
+
+QuantileSketch::QuantileSketch(double relativeAccuracy)
+    : m_gamma((1.0 + relativeAccuracy) / (1.0 - relativeAccuracy)),
+    m_logGamma(std::log(m_gamma)),
+    m_zeroCount(0),
+    m_count(0),
+    m_min(std::numeric_limits<double>::max()),
+    m_max(std::numeric_limits<double>::lowest())
+{
+}
+
+void QuantileSketch::add(double value)
+{
+    if (std::isnan(value)) {
+        return;
+    }
+    if (value <= 0.0) {
+        ++m_zeroCount;
+    } else {
+        const int index = int(std::ceil(std::log(value) / m_logGamma));
+        ++m_bins[index];
+    }
+    ++m_count;
+    m_min = qMin(m_min, value);
+    m_max = qMax(m_max, value);
+}
+
+void QuantileSketch::merge(const QuantileSketch& other)
+{
+    for (auto it = other.m_bins.cbegin(); it != other.m_bins.cend(); ++it) {
+        m_bins[it.key()] += it.value();
+    }
+    m_zeroCount += other.m_zeroCount;
+    m_count += other.m_count;
+    m_min = qMin(m_min, other.m_min);
+    m_max = qMax(m_max, other.m_max);
+}
+
+double QuantileSketch::quantile(double q) const
+{
+    if (m_count == 0) {
+        return 0.0;
+    }
+    q = qBound(0.0, q, 1.0);
+    const double rank = q * double(m_count - 1);
+
+    quint64 seen = m_zeroCount;
+    if (rank < double(seen)) {
+        return 0.0;
+    }
+    for (auto it = m_bins.cbegin(); it != m_bins.cend(); ++it) {
+        seen += it.value();
+        if (rank < double(seen)) {
+            // Punto medio (en escala relativa) del cubo, acotado por los extremos observados
+            const double value = 2.0 * std::pow(m_gamma, it.key()) / (m_gamma + 1.0);
+            return qBound(m_min, value, m_max);
+        }
+    }
+    return m_max;
+}
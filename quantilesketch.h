@@ -0,0 +1,35 @@
+#ifndef QUANTILESKETCH_H
+#define QUANTILESKETCH_H
+
+#include <QMap>
+#include <QtGlobal>
+
+// Resumen de cuantiles con error relativo acotado (estilo DDSketch).
+// Cada valor positivo cae en un cubo logarítmico; dos resúmenes se combinan sumando
+// los contadores de sus cubos, así que cada hilo puede construir el suyo y fusionarlos al final.
+class QuantileSketch
+{
+public:
+    // relativeAccuracy = 0.01 -> el cuantil devuelto está a menos del 1% del valor real
+    explicit QuantileSketch(double relativeAccuracy = 0.01);
+
+    void add(double value);
+    void merge(const QuantileSketch& other);
+
+    quint64 count() const { return m_count; }
+    double min() const { return m_min; }
+    double max() const { return m_max; }
+    // q en [0, 1]; devuelve 0 si el resumen está vacío
+    double quantile(double q) const;
+
+private:
+    double m_gamma;
+    double m_logGamma;
+    QMap<int, quint64> m_bins; // índice de cubo -> número de valores
+    quint64 m_zeroCount;       // valores <= 0 (no tienen cubo logarítmico)
+    quint64 m_count;
+    double m_min;
+    double m_max;
+};
+
+#endif // QUANTILESKETCH_H
@@ -0,0 +1,705 @@
+#include "recipegraph.h"
+#include "datachangehub.h"
+#include "foodcatalog.h"
+#include "metrickernels.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+RecipeGraph* RecipeGraph::instance()
+{
+    static RecipeGraph graph;
+    return &graph;
+}
+
+RecipeGraph::RecipeGraph(QObject *parent)
+    : QObject(parent)
+    , m_loaded(false)
+{
+    connect(DataChangeHub::instance(), &DataChangeHub::userDeleted, this, &RecipeGraph::onUserDeleted);
+}
+
+// Carga todas las recetas y planes y calcula sus totales (una vez por sesión)
+bool RecipeGraph::ensureLoaded()
+{
+    if (m_loaded) {
+        return true;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    FoodCatalog *catalog = FoodCatalog::instance();
+    m_nutrientCodes.clear();
+    for (int i = 0; i < catalog->nutrientCount(); ++i) {
+        m_nutrientCodes.append(catalog->nutrient(i).code);
+    }
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT recipe_id, name, yield_grams FROM recipes")) {
+        qCritical() << "Error al cargar las recetas:" << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        addNode(RecipeNode, query.value(0).toInt(), -1, query.value(1).toString(), query.value(2).toDouble());
+    }
+    if (!query.exec("SELECT plan_id, user_id, name FROM diet_plans")) {
+        qCritical() << "Error al cargar los planes de dieta:" << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        addNode(DietPlanNode, query.value(0).toInt(), query.value(1).toInt(), query.value(2).toString(), 0.0);
+    }
+
+    // Aristas (en el orden guardado)
+    QHash<int, QVector<Edge>> edges;
+    if (!query.exec("SELECT recipe_id, food_code, sub_recipe_id, grams FROM recipe_items ORDER BY recipe_id, position")) {
+        qCritical() << "Error al cargar los ingredientes de las recetas:" << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        const int node = m_recipeNodes.value(query.value(0).toInt(), -1);
+        Edge edge;
+        edge.grams = query.value(3).toDouble();
+        if (!query.value(1).isNull()) {
+            edge.food = foodSlot(query.value(1).toString());
+        } else {
+            edge.child = m_recipeNodes.value(query.value(2).toInt(), -1);
+        }
+        if (node >= 0 && (edge.food >= 0 || edge.child >= 0)) {
+            edges[node].append(edge);
+        }
+    }
+    if (!query.exec("SELECT plan_id, recipe_id, grams FROM diet_plan_items ORDER BY plan_id, position")) {
+        qCritical() << "Error al cargar las recetas de los planes:" << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        const int node = m_planNodes.value(query.value(0).toInt(), -1);
+        Edge edge;
+        edge.child = m_recipeNodes.value(query.value(1).toInt(), -1);
+        edge.grams = query.value(2).toDouble();
+        if (node >= 0 && edge.child >= 0) {
+            edges[node].append(edge);
+        }
+    }
+    for (auto it = edges.cbegin(); it != edges.cend(); ++it) {
+        replaceEdges(it.key(), it.value());
+    }
+
+    m_loaded = true;
+    QVector<int> all(m_nodes.size());
+    std::iota(all.begin(), all.end(), 0);
+    propagate(all);
+
+    qInfo() << "Recetas cargadas:" << m_recipeNodes.size() << "recetas," << m_planNodes.size() << "planes,"
+            << m_foodCodes.size() << "alimentos distintos en" << timer.elapsed() << "ms";
+    return true;
+}
+
+int RecipeGraph::addNode(NodeKind kind, int id, int userId, const QString& name, double yieldGrams)
+{
+    Node node;
+    node.kind = kind;
+    node.id = id;
+    node.userId = userId;
+    node.name = name;
+    node.yieldGrams = yieldGrams;
+    node.totals = QVector<double>(m_nutrientCodes.size(), 0.0);
+    m_nodes.append(node);
+    const int index = int(m_nodes.size()) - 1;
+    (kind == RecipeNode ? m_recipeNodes : m_planNodes).insert(id, index);
+    return index;
+}
+
+// Valores por 100 g de un alimento, copiados del catálogo (NaN = 0: sin dato no suma)
+QVector<double> RecipeGraph::foodRow(const QString& code) const
+{
+    FoodCatalog *catalog = FoodCatalog::instance();
+    QVector<double> row(m_nutrientCodes.size(), 0.0);
+    const int food = catalog->foodIndex(code);
+    if (food < 0) {
+        return row;
+    }
+    for (int n = 0; n < row.size() && n < catalog->nutrientCount(); ++n) {
+        const float value = catalog->value(food, n);
+        row[n] = std::isnan(value) ? 0.0 : double(value);
+    }
+    return row;
+}
+
+int RecipeGraph::foodSlot(const QString& code)
+{
+    const auto it = m_foodSlots.constFind(code);
+    if (it != m_foodSlots.cend()) {
+        return it.value();
+    }
+    const QVector<double> row = foodRow(code);
+    if (FoodCatalog::instance()->isOpen() && FoodCatalog::instance()->foodIndex(code) < 0) {
+        qWarning() << "Alimento" << code << "no encontrado en el catálogo; cuenta como 0 en las recetas.";
+    }
+    m_foodCodes.append(code);
+    m_foodRows.append(row);
+    m_foodUsers.append(QVector<int>());
+    const int slot = int(m_foodCodes.size()) - 1;
+    m_foodSlots.insert(code, slot);
+    return slot;
+}
+
+bool RecipeGraph::toEdges(const QVector<Item>& items, bool allowFoods, QVector<Edge>& edges, QString* error)
+{
+    edges.clear();
+    for (const Item& item : items) {
+        if (!(item.grams > 0.0)) {
+            if (error) {
+                *error = "Las cantidades deben ser mayores que 0 g.";
+            }
+            return false;
+        }
+        Edge edge;
+        edge.grams = item.grams;
+        if (item.recipeId >= 0) {
+            edge.child = m_recipeNodes.value(item.recipeId, -1);
+            if (edge.child < 0) {
+                if (error) {
+                    *error = QString("La receta %1 no existe.").arg(item.recipeId);
+                }
+                return false;
+            }
+        } else if (allowFoods && !item.foodCode.isEmpty()) {
+            edge.food = foodSlot(item.foodCode);
+        } else {
+            if (error) {
+                *error = allowFoods ? "Ingrediente sin alimento ni receta." : "Un plan de dieta solo puede contener recetas.";
+            }
+            return false;
+        }
+        edges.append(edge);
+    }
+    return true;
+}
+
+// Sustituye las aristas de un nodo manteniendo las listas inversas (parents / m_foodUsers)
+void RecipeGraph::replaceEdges(int node, const QVector<Edge>& edges)
+{
+    for (const Edge& edge : std::as_const(m_nodes[node].edges)) {
+        if (edge.child >= 0) {
+            m_nodes[edge.child].parents.removeAll(node);
+        } else {
+            m_foodUsers[edge.food].removeAll(node);
+        }
+    }
+    m_nodes[node].edges = edges;
+    for (const Edge& edge : edges) {
+        QVector<int>& users = edge.child >= 0 ? m_nodes[edge.child].parents : m_foodUsers[edge.food];
+        if (!users.contains(node)) {
+            users.append(node);
+        }
+    }
+}
+
+// ¿Se llega a 'target' bajando desde 'from'?
+bool RecipeGraph::reaches(int from, int target) const
+{
+    QVector<int> stack = { from };
+    QVector<bool> seen(m_nodes.size(), false);
+    while (!stack.isEmpty()) {
+        const int node = stack.takeLast();
+        if (node == target) {
+            return true;
+        }
+        if (seen[node]) {
+            continue;
+        }
+        seen[node] = true;
+        for (const Edge& edge : m_nodes[node].edges) {
+            if (edge.child >= 0) {
+                stack.append(edge.child);
+            }
+        }
+    }
+    return false;
+}
+
+void RecipeGraph::recompute(int index)
+{
+    Node& node = m_nodes[index];
+    const std::size_t n = std::size_t(m_nutrientCodes.size());
+    node.totals.fill(0.0, int(n));
+    node.totalGrams = 0.0;
+    for (const Edge& edge : std::as_const(node.edges)) {
+        node.totalGrams += edge.grams;
+        if (edge.food >= 0) {
+            MetricKernels::addScaled(node.totals.data(), m_foodRows[edge.food].constData(), n, edge.grams / 100.0);
+        } else {
+            // Una porción de la receta hija: su total escalado por gramos usados / peso final
+            const Node& child = m_nodes[edge.child];
+            const double weight = child.weight();
+            if (weight > 0.0) {
+                MetricKernels::addScaled(node.totals.data(), child.totals.constData(), n, edge.grams / weight);
+            }
+        }
+    }
+}
+
+void RecipeGraph::propagate(const QVector<int>& changed)
+{
+    // Recorrido en postorden por los padres: cada nodo queda detrás de todos sus ascendientes,
+    // así que al invertir la lista los hijos se recalculan antes que quien los usa.
+    QVector<int> order;
+    QVector<bool> visited(m_nodes.size(), false);
+    QVector<QPair<int, int>> stack; // (nodo, siguiente padre a visitar)
+    for (int start : changed) {
+        if (visited[start] || !m_nodes[start].alive) {
+            continue;
+        }
+        visited[start] = true;
+        stack.append(qMakePair(start, 0));
+        while (!stack.isEmpty()) {
+            QPair<int, int>& top = stack.last();
+            const QVector<int>& parents = m_nodes[top.first].parents;
+            if (top.second < parents.size()) {
+                const int parent = parents[top.second++];
+                if (!visited[parent]) {
+                    visited[parent] = true;
+                    stack.append(qMakePair(parent, 0));
+                }
+            } else {
+                order.append(top.first);
+                stack.removeLast();
+            }
+        }
+    }
+
+    QList<int> recipes;
+    QList<int> plans;
+    for (int i = int(order.size()) - 1; i >= 0; --i) {
+        recompute(order[i]);
+        const Node& node = m_nodes[order[i]];
+        (node.kind == RecipeNode ? recipes : plans).append(node.id);
+    }
+    if (!order.isEmpty()) {
+        emit totalsChanged(recipes, plans);
+    }
+}
+
+QVector<RecipeGraph::Item> RecipeGraph::itemsOf(const Node& node) const
+{
+    QVector<Item> items;
+    for (const Edge& edge : node.edges) {
+        Item item;
+        item.grams = edge.grams;
+        if (edge.food >= 0) {
+            item.foodCode = m_foodCodes[edge.food];
+        } else {
+            item.recipeId = m_nodes[edge.child].id;
+        }
+        items.append(item);
+    }
+    return items;
+}
+
+bool RecipeGraph::saveItems(const Node& node)
+{
+    const bool recipe = node.kind == RecipeNode;
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QSqlQuery query;
+    query.prepare(recipe ? "DELETE FROM recipe_items WHERE recipe_id = :id"
+                         : "DELETE FROM diet_plan_items WHERE plan_id = :id");
+    query.bindValue(":id", node.id);
+    if (!query.exec()) {
+        qCritical() << "Error al borrar los ingredientes de" << node.name << ":" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    query.prepare(recipe ? "INSERT INTO recipe_items (recipe_id, position, food_code, sub_recipe_id, grams) "
+                           "VALUES (:id, :position, :food_code, :sub_recipe_id, :grams)"
+                         : "INSERT INTO diet_plan_items (plan_id, position, recipe_id, grams) "
+                           "VALUES (:id, :position, :sub_recipe_id, :grams)");
+    for (int i = 0; i < node.edges.size(); ++i) {
+        const Edge& edge = node.edges[i];
+        query.bindValue(":id", node.id);
+        query.bindValue(":position", i);
+        if (recipe) {
+            query.bindValue(":food_code", edge.food >= 0 ? QVariant(m_foodCodes[edge.food]) : QVariant());
+        }
+        query.bindValue(":sub_recipe_id", edge.child >= 0 ? QVariant(m_nodes[edge.child].id) : QVariant());
+        query.bindValue(":grams", edge.grams);
+        if (!query.exec()) {
+            qCritical() << "Error al guardar los ingredientes de" << node.name << ":" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    query.prepare(recipe ? "UPDATE recipes SET updated_at = CURRENT_TIMESTAMP WHERE recipe_id = :id"
+                         : "UPDATE diet_plans SET updated_at = CURRENT_TIMESTAMP WHERE plan_id = :id");
+    query.bindValue(":id", node.id);
+    if (!query.exec()) {
+        qCritical() << "Error al actualizar" << node.name << ":" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar los ingredientes de" << node.name << ":" << db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void RecipeGraph::removeNode(int index)
+{
+    replaceEdges(index, QVector<Edge>());
+    Node& node = m_nodes[index];
+    (node.kind == RecipeNode ? m_recipeNodes : m_planNodes).remove(node.id);
+    node.alive = false;
+    node.totals.clear();
+    node.parents.clear();
+}
+
+// ---------------------------------------------------------------------------------------------
+// Recetas
+
+int RecipeGraph::createRecipe(const QString& name, double yieldGrams)
+{
+    if (!ensureLoaded()) {
+        return -1;
+    }
+    QSqlQuery query;
+    query.prepare("INSERT INTO recipes (name, yield_grams) VALUES (:name, :yield_grams)");
+    query.bindValue(":name", name.trimmed());
+    query.bindValue(":yield_grams", yieldGrams > 0.0 ? QVariant(yieldGrams) : QVariant());
+    if (!query.exec()) {
+        qCritical() << "Error al crear la receta" << name << ":" << query.lastError().text();
+        return -1;
+    }
+    const int recipeId = query.lastInsertId().toInt();
+    addNode(RecipeNode, recipeId, -1, name.trimmed(), yieldGrams);
+    return recipeId;
+}
+
+bool RecipeGraph::setRecipeItems(int recipeId, const QVector<Item>& items, QString* error)
+{
+    if (!ensureLoaded()) {
+        return false;
+    }
+    const int node = m_recipeNodes.value(recipeId, -1);
+    if (node < 0) {
+        if (error) {
+            *error = QString("La receta %1 no existe.").arg(recipeId);
+        }
+        return false;
+    }
+    QVector<Edge> edges;
+    if (!toEdges(items, true, edges, error)) {
+        return false;
+    }
+    for (const Edge& edge : std::as_const(edges)) {
+        if (edge.child >= 0 && reaches(edge.child, node)) {
+            if (error) {
+                *error = QString("\"%1\" ya contiene \"%2\": no puede ser ingrediente suyo.")
+                             .arg(m_nodes[edge.child].name, m_nodes[node].name);
+            }
+            return false;
+        }
+    }
+
+    const QVector<Edge> previous = m_nodes[node].edges;
+    replaceEdges(node, edges);
+    if (!saveItems(m_nodes[node])) {
+        replaceEdges(node, previous);
+        if (error) {
+            *error = "No se pudieron guardar los ingredientes.";
+        }
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    propagate({ node });
+    qInfo() << "Receta" << recipeId << "actualizada; totales recalculados en" << timer.elapsed() << "ms";
+    return true;
+}
+
+bool RecipeGraph::setRecipeYield(int recipeId, double yieldGrams)
+{
+    if (!ensureLoaded()) {
+        return false;
+    }
+    const int node = m_recipeNodes.value(recipeId, -1);
+    if (node < 0) {
+        return false;
+    }
+    QSqlQuery query;
+    query.prepare("UPDATE recipes SET yield_grams = :yield_grams, updated_at = CURRENT_TIMESTAMP WHERE recipe_id = :id");
+    query.bindValue(":yield_grams", yieldGrams > 0.0 ? QVariant(yieldGrams) : QVariant());
+    query.bindValue(":id", recipeId);
+    if (!query.exec()) {
+        qCritical() << "Error al guardar el peso final de la receta" << recipeId << ":" << query.lastError().text();
+        return false;
+    }
+    m_nodes[node].yieldGrams = yieldGrams;
+    // Los totales de la receta no cambian, pero sí la porción que aporta a quien la usa
+    propagate(m_nodes[node].parents);
+    return true;
+}
+
+bool RecipeGraph::deleteRecipe(int recipeId, QString* error)
+{
+    if (!ensureLoaded()) {
+        return false;
+    }
+    const int node = m_recipeNodes.value(recipeId, -1);
+    if (node < 0) {
+        return false;
+    }
+    if (!m_nodes[node].parents.isEmpty()) {
+        if (error) {
+            *error = QString("\"%1\" se usa en %2 recetas o planes.").arg(m_nodes[node].name).arg(m_nodes[node].parents.size());
+        }
+        return false;
+    }
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QSqlQuery query;
+    query.prepare("DELETE FROM recipe_items WHERE recipe_id = :id");
+    query.bindValue(":id", recipeId);
+    bool ok = query.exec();
+    query.prepare("DELETE FROM recipes WHERE recipe_id = :id");
+    query.bindValue(":id", recipeId);
+    ok = ok && query.exec();
+    if (!ok || !db.commit()) {
+        qCritical() << "Error al borrar la receta" << recipeId << ":" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    removeNode(node);
+    return true;
+}
+
+QList<int> RecipeGraph::recipeIds()
+{
+    ensureLoaded();
+    QList<int> ids = m_recipeNodes.keys();
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+QString RecipeGraph::recipeName(int recipeId)
+{
+    ensureLoaded();
+    const int node = m_recipeNodes.value(recipeId, -1);
+    return node >= 0 ? m_nodes[node].name : QString();
+}
+
+double RecipeGraph::recipeYield(int recipeId)
+{
+    ensureLoaded();
+    const int node = m_recipeNodes.value(recipeId, -1);
+    return node >= 0 ? m_nodes[node].yieldGrams : 0.0;
+}
+
+QVector<RecipeGraph::Item> RecipeGraph::recipeItems(int recipeId)
+{
+    ensureLoaded();
+    const int node = m_recipeNodes.value(recipeId, -1);
+    return node >= 0 ? itemsOf(m_nodes[node]) : QVector<Item>();
+}
+
+// ---------------------------------------------------------------------------------------------
+// Planes de dieta
+
+int RecipeGraph::createDietPlan(int userId, const QString& name)
+{
+    if (!ensureLoaded()) {
+        return -1;
+    }
+    QSqlQuery query;
+    query.prepare("INSERT INTO diet_plans (user_id, name) VALUES (:user_id, :name)");
+    query.bindValue(":user_id", userId);
+    query.bindValue(":name", name.trimmed());
+    if (!query.exec()) {
+        qCritical() << "Error al crear el plan de dieta" << name << ":" << query.lastError().text();
+        return -1;
+    }
+    const int planId = query.lastInsertId().toInt();
+    addNode(DietPlanNode, planId, userId, name.trimmed(), 0.0);
+    return planId;
+}
+
+bool RecipeGraph::setDietPlanItems(int planId, const QVector<Item>& items, QString* error)
+{
+    if (!ensureLoaded()) {
+        return false;
+    }
+    const int node = m_planNodes.value(planId, -1);
+    if (node < 0) {
+        if (error) {
+            *error = QString("El plan %1 no existe.").arg(planId);
+        }
+        return false;
+    }
+    QVector<Edge> edges;
+    if (!toEdges(items, false, edges, error)) {
+        return false;
+    }
+    const QVector<Edge> previous = m_nodes[node].edges;
+    replaceEdges(node, edges);
+    if (!saveItems(m_nodes[node])) {
+        replaceEdges(node, previous);
+        if (error) {
+            *error = "No se pudieron guardar las recetas del plan.";
+        }
+        return false;
+    }
+    propagate({ node });
+    return true;
+}
+
+bool RecipeGraph::deleteDietPlan(int planId)
+{
+    if (!ensureLoaded()) {
+        return false;
+    }
+    const int node = m_planNodes.value(planId, -1);
+    if (node < 0) {
+        return false;
+    }
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    QSqlQuery query;
+    query.prepare("DELETE FROM diet_plan_items WHERE plan_id = :id");
+    query.bindValue(":id", planId);
+    bool ok = query.exec();
+    query.prepare("DELETE FROM diet_plans WHERE plan_id = :id");
+    query.bindValue(":id", planId);
+    ok = ok && query.exec();
+    if (!ok || !db.commit()) {
+        qCritical() << "Error al borrar el plan de dieta" << planId << ":" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    removeNode(node);
+    return true;
+}
+
+QList<int> RecipeGraph::dietPlansForUser(int userId)
+{
+    ensureLoaded();
+    QList<int> ids;
+    for (auto it = m_planNodes.cbegin(); it != m_planNodes.cend(); ++it) {
+        if (m_nodes[it.value()].userId == userId) {
+            ids.append(it.key());
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+QString RecipeGraph::dietPlanName(int planId)
+{
+    ensureLoaded();
+    const int node = m_planNodes.value(planId, -1);
+    return node >= 0 ? m_nodes[node].name : QString();
+}
+
+QVector<RecipeGraph::Item> RecipeGraph::dietPlanItems(int planId)
+{
+    ensureLoaded();
+    const int node = m_planNodes.value(planId, -1);
+    return node >= 0 ? itemsOf(m_nodes[node]) : QVector<Item>();
+}
+
+void RecipeGraph::onUserDeleted(int userId)
+{
+    // Los planes se borran aunque el grafo no esté cargado todavía
+    QSqlQuery query;
+    query.prepare("DELETE FROM diet_plan_items WHERE plan_id IN (SELECT plan_id FROM diet_plans WHERE user_id = :user_id)");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al borrar los planes del usuario" << userId << ":" << query.lastError().text();
+    }
+    query.prepare("DELETE FROM diet_plans WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al borrar los planes del usuario" << userId << ":" << query.lastError().text();
+    }
+    if (!m_loaded) {
+        return;
+    }
+    const QList<int> plans = dietPlansForUser(userId);
+    for (int planId : plans) {
+        removeNode(m_planNodes.value(planId));
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Totales
+
+QVector<double> RecipeGraph::recipeTotals(int recipeId)
+{
+    ensureLoaded();
+    const int node = m_recipeNodes.value(recipeId, -1);
+    return node >= 0 ? m_nodes[node].totals : QVector<double>();
+}
+
+QVector<double> RecipeGraph::recipePer100g(int recipeId)
+{
+    ensureLoaded();
+    const int node = m_recipeNodes.value(recipeId, -1);
+    if (node < 0) {
+        return QVector<double>();
+    }
+    QVector<double> per100g(m_nutrientCodes.size(), 0.0);
+    const double weight = m_nodes[node].weight();
+    if (weight > 0.0) {
+        MetricKernels::addScaled(per100g.data(), m_nodes[node].totals.constData(), std::size_t(per100g.size()), 100.0 / weight);
+    }
+    return per100g;
+}
+
+QVector<double> RecipeGraph::dietPlanTotals(int planId)
+{
+    ensureLoaded();
+    const int node = m_planNodes.value(planId, -1);
+    return node >= 0 ? m_nodes[node].totals : QVector<double>();
+}
+
+void RecipeGraph::refreshFoods()
+{
+    if (!m_loaded) {
+        return; // Se leerá el catálogo nuevo al cargar
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    FoodCatalog *catalog = FoodCatalog::instance();
+    QStringList nutrientCodes;
+    for (int i = 0; i < catalog->nutrientCount(); ++i) {
+        nutrientCodes.append(catalog->nutrient(i).code);
+    }
+    const bool layoutChanged = nutrientCodes != m_nutrientCodes;
+    m_nutrientCodes = nutrientCodes;
+
+    QVector<int> changed;
+    for (int slot = 0; slot < m_foodCodes.size(); ++slot) {
+        QVector<double> row = foodRow(m_foodCodes[slot]);
+        if (layoutChanged || row != m_foodRows[slot]) {
+            m_foodRows[slot] = row;
+            changed += m_foodUsers[slot];
+        }
+    }
+    if (layoutChanged) {
+        changed.clear();
+        for (int node = 0; node < m_nodes.size(); ++node) {
+            changed.append(node);
+        }
+    }
+    propagate(changed);
+    qInfo() << "Recetas actualizadas tras cambiar el catálogo en" << timer.elapsed() << "ms";
+}
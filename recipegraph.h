@@ -0,0 +1,126 @@
+#ifndef RECIPEGRAPH_H
+#define RECIPEGRAPH_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Recetas y planes de dieta como grafo acíclico: una receta se compone de alimentos del catálogo
+// (FoodCatalog) y de otras recetas (salsas, bases); un plan de dieta, de recetas.
+// Cada nodo guarda en memoria su vector de nutrientes total (mismo orden que FoodCatalog::nutrient),
+// calculado una vez al cargar. Al cambiar los ingredientes de un nodo se recalculan solo ese nodo y
+// sus ascendientes, en orden topológico, sumando los vectores de los hijos con MetricKernels::addScaled.
+//
+// Tablas (migración v4): recipes, recipe_items, diet_plans y diet_plan_items.
+class RecipeGraph : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Un ingrediente: o un alimento del catálogo (foodCode) o una receta (recipeId), en gramos
+    struct Item {
+        QString foodCode;
+        int recipeId = -1;
+        double grams = 0.0;
+    };
+
+    static RecipeGraph* instance();
+
+    // --- Recetas ---
+    // yieldGrams = peso final tras cocinar; 0 = suma de los ingredientes. Retorna el id o -1.
+    int createRecipe(const QString& name, double yieldGrams = 0.0);
+    // Sustituye los ingredientes. Falla si la receta acabaría conteniéndose a sí misma.
+    bool setRecipeItems(int recipeId, const QVector<Item>& items, QString* error = nullptr);
+    bool setRecipeYield(int recipeId, double yieldGrams);
+    // Falla si la receta se usa en otra receta o en un plan
+    bool deleteRecipe(int recipeId, QString* error = nullptr);
+    QList<int> recipeIds();
+    QString recipeName(int recipeId);
+    double recipeYield(int recipeId); // 0 = suma de los ingredientes
+    QVector<Item> recipeItems(int recipeId);
+
+    // --- Planes de dieta ---
+    int createDietPlan(int userId, const QString& name);
+    // Solo admite recetas (Item::recipeId)
+    bool setDietPlanItems(int planId, const QVector<Item>& items, QString* error = nullptr);
+    bool deleteDietPlan(int planId);
+    QList<int> dietPlansForUser(int userId);
+    QString dietPlanName(int planId);
+    QVector<Item> dietPlanItems(int planId);
+
+    // --- Totales memoizados (vacíos si el id no existe) ---
+    QVector<double> recipeTotals(int recipeId);      // Receta completa
+    QVector<double> recipePer100g(int recipeId);     // Por 100 g de receta terminada
+    QVector<double> dietPlanTotals(int planId);
+
+    // Tras reimportar el catálogo: recalcula solo lo que depende de alimentos cuyos valores cambiaron
+    // (todo si cambió la lista de nutrientes)
+    void refreshFoods();
+
+signals:
+    // Nodos cuyos totales han cambiado
+    void totalsChanged(const QList<int>& recipeIds, const QList<int>& planIds);
+
+private slots:
+    void onUserDeleted(int userId);
+
+private:
+    explicit RecipeGraph(QObject *parent = nullptr);
+
+    enum NodeKind {
+        RecipeNode,
+        DietPlanNode
+    };
+
+    // Arista hacia un alimento (índice en m_foodRows) o hacia otro nodo
+    struct Edge {
+        int food = -1;
+        int child = -1;
+        double grams = 0.0;
+    };
+
+    struct Node {
+        NodeKind kind = RecipeNode;
+        int id = -1;
+        int userId = -1; // Solo planes
+        QString name;
+        double yieldGrams = 0.0;
+        QVector<Edge> edges;
+        QVector<int> parents;   // Nodos que usan este (sin repetidos)
+        QVector<double> totals; // Memoizado
+        double totalGrams = 0.0;
+        bool alive = true;
+
+        double weight() const { return yieldGrams > 0.0 ? yieldGrams : totalGrams; }
+    };
+
+    bool ensureLoaded();
+    int addNode(NodeKind kind, int id, int userId, const QString& name, double yieldGrams);
+    int foodSlot(const QString& code);
+    QVector<double> foodRow(const QString& code) const;
+    bool toEdges(const QVector<Item>& items, bool allowFoods, QVector<Edge>& edges, QString* error);
+    void replaceEdges(int node, const QVector<Edge>& edges);
+    bool reaches(int from, int target) const;
+    void recompute(int node);
+    // Recalcula los nodos indicados y todos sus ascendientes, cada uno una sola vez
+    void propagate(const QVector<int>& changed);
+    void removeNode(int node);
+    bool saveItems(const Node& node);
+    QVector<Item> itemsOf(const Node& node) const;
+
+    bool m_loaded;
+    QVector<Node> m_nodes;
+    QHash<int, int> m_recipeNodes; // recipe_id -> nodo
+    QHash<int, int> m_planNodes;   // plan_id -> nodo
+    // Alimentos usados en alguna receta: código, valores por 100 g y recetas que los usan
+    QStringList m_foodCodes;
+    QHash<QString, int> m_foodSlots;
+    QVector<QVector<double>> m_foodRows;
+    QVector<QVector<int>> m_foodUsers;
+    QStringList m_nutrientCodes;
+};
+
+#endif // RECIPEGRAPH_H
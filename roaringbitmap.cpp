@@ -0,0 +1,344 @@
+#include "roaringbitmap.h"
+#include <QtAlgorithms>
+#include <algorithm>
+#include <iterator>
+
+bool RoaringBitmap::Container::contains(quint16 low) const
+{
+    if (isBitset()) {
+        return (bitset[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+void RoaringBitmap::Container::toBitset()
+{
+    bitset.resize(kBitsetWords);
+    std::fill(bitset.begin(), bitset.end(), 0);
+    for (quint16 low : array) {
+        bitset[low >> 6] |= quint64(1) << (low & 63);
+    }
+    array.clear();
+    array.squeeze();
+}
+
+void RoaringBitmap::Container::toArray()
+{
+    QVector<quint16> values;
+    values.reserve(cardinality);
+    for (int word = 0; word < kBitsetWords; ++word) {
+        quint64 bits = bitset[word];
+        while (bits) {
+            const int bit = qCountTrailingZeroBits(bits);
+            values.push_back(quint16(word * 64 + bit));
+            bits &= bits - 1;
+        }
+    }
+    array = values;
+    bitset.clear();
+    bitset.squeeze();
+}
+
+int RoaringBitmap::findContainer(quint16 key) const
+{
+    int low = 0;
+    int high = int(m_containers.size()) - 1;
+    while (low <= high) {
+        const int middle = (low + high) / 2;
+        const quint16 middleKey = m_containers[middle].key;
+        if (middleKey == key) {
+            return middle;
+        }
+        if (middleKey < key) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return -(low + 1);
+}
+
+void RoaringBitmap::add(quint32 value)
+{
+    const quint16 key = quint16(value >> 16);
+    const quint16 low = quint16(value & 0xFFFF);
+
+    int index = findContainer(key);
+    if (index < 0) {
+        index = -index - 1;
+        Container container;
+        container.key = key;
+        m_containers.insert(m_containers.begin() + index, container);
+    }
+
+    Container& container = m_containers[index];
+    if (container.isBitset()) {
+        quint64& word = container.bitset[low >> 6];
+        const quint64 mask = quint64(1) << (low & 63);
+        if (!(word & mask)) {
+            word |= mask;
+            ++container.cardinality;
+        }
+        return;
+    }
+
+    auto pos = std::lower_bound(container.array.begin(), container.array.end(), low);
+    if (pos != container.array.end() && *pos == low) {
+        return;
+    }
+    container.array.insert(pos, low);
+    ++container.cardinality;
+    if (container.cardinality > kArrayLimit) {
+        container.toBitset();
+    }
+}
+
+void RoaringBitmap::remove(quint32 value)
+{
+    const int index = findContainer(quint16(value >> 16));
+    if (index < 0) {
+        return;
+    }
+
+    Container& container = m_containers[index];
+    const quint16 low = quint16(value & 0xFFFF);
+    if (container.isBitset()) {
+        quint64& word = container.bitset[low >> 6];
+        const quint64 mask = quint64(1) << (low & 63);
+        if (!(word & mask)) {
+            return;
+        }
+        word &= ~mask;
+        --container.cardinality;
+        if (container.cardinality <= kArrayLimit) {
+            container.toArray();
+        }
+    } else {
+        auto pos = std::lower_bound(container.array.begin(), container.array.end(), low);
+        if (pos == container.array.end() || *pos != low) {
+            return;
+        }
+        container.array.erase(pos);
+        --container.cardinality;
+    }
+
+    if (container.cardinality == 0) {
+        m_containers.erase(m_containers.begin() + index);
+    }
+}
+
+bool RoaringBitmap::contains(quint32 value) const
+{
+    const int index = findContainer(quint16(value >> 16));
+    return index >= 0 && m_containers[index].contains(quint16(value & 0xFFFF));
+}
+
+quint64 RoaringBitmap::cardinality() const
+{
+    quint64 total = 0;
+    for (const Container& container : m_containers) {
+        total += quint64(container.cardinality);
+    }
+    return total;
+}
+
+QVector<quint32> RoaringBitmap::toVector() const
+{
+    QVector<quint32> values;
+    values.reserve(qsizetype(cardinality()));
+    for (const Container& container : m_containers) {
+        const quint32 high = quint32(container.key) << 16;
+        if (container.isBitset()) {
+            for (int word = 0; word < kBitsetWords; ++word) {
+                quint64 bits = container.bitset[word];
+                while (bits) {
+                    values.push_back(high | quint32(word * 64 + qCountTrailingZeroBits(bits)));
+                    bits &= bits - 1;
+                }
+            }
+        } else {
+            for (quint16 low : container.array) {
+                values.push_back(high | low);
+            }
+        }
+    }
+    return values;
+}
+
+RoaringBitmap::Container RoaringBitmap::intersect(const Container& a, const Container& b)
+{
+    Container result;
+    result.key = a.key;
+
+    if (a.isBitset() && b.isBitset()) {
+        result.bitset.resize(kBitsetWords);
+        int count = 0;
+        for (int word = 0; word < kBitsetWords; ++word) {
+            result.bitset[word] = a.bitset[word] & b.bitset[word];
+            count += qPopulationCount(result.bitset[word]);
+        }
+        result.cardinality = count;
+        if (count <= kArrayLimit) {
+            result.toArray();
+        }
+        return result;
+    }
+
+    if (a.isBitset() || b.isBitset()) {
+        const Container& sparse = a.isBitset() ? b : a;
+        const Container& dense = a.isBitset() ? a : b;
+        result.array.reserve(sparse.array.size());
+        for (quint16 low : sparse.array) {
+            if (dense.contains(low)) {
+                result.array.push_back(low);
+            }
+        }
+        result.cardinality = int(result.array.size());
+        return result;
+    }
+
+    result.array.reserve(qMin(a.array.size(), b.array.size()));
+    std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                          std::back_inserter(result.array));
+    result.cardinality = int(result.array.size());
+    return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::unite(const Container& a, const Container& b)
+{
+    Container result;
+    result.key = a.key;
+
+    if (!a.isBitset() && !b.isBitset()) {
+        result.array.reserve(a.array.size() + b.array.size());
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                       std::back_inserter(result.array));
+        result.cardinality = int(result.array.size());
+        if (result.cardinality > kArrayLimit) {
+            result.toBitset();
+        }
+        return result;
+    }
+
+    // Al menos uno es denso: el resultado también lo es
+    result.bitset.resize(kBitsetWords);
+    std::fill(result.bitset.begin(), result.bitset.end(), 0);
+    for (const Container* part : { &a, &b }) {
+        if (part->isBitset()) {
+            for (int word = 0; word < kBitsetWords; ++word) {
+                result.bitset[word] |= part->bitset[word];
+            }
+        } else {
+            for (quint16 low : part->array) {
+                result.bitset[low >> 6] |= quint64(1) << (low & 63);
+            }
+        }
+    }
+    int count = 0;
+    for (int word = 0; word < kBitsetWords; ++word) {
+        count += qPopulationCount(result.bitset[word]);
+    }
+    result.cardinality = count;
+    return result;
+}
+
+quint64 RoaringBitmap::intersectCount(const Container& a, const Container& b)
+{
+    if (a.isBitset() && b.isBitset()) {
+        quint64 count = 0;
+        for (int word = 0; word < kBitsetWords; ++word) {
+            count += qPopulationCount(a.bitset[word] & b.bitset[word]);
+        }
+        return count;
+    }
+    if (a.isBitset() || b.isBitset()) {
+        const Container& sparse = a.isBitset() ? b : a;
+        const Container& dense = a.isBitset() ? a : b;
+        quint64 count = 0;
+        for (quint16 low : sparse.array) {
+            count += dense.contains(low) ? 1 : 0;
+        }
+        return count;
+    }
+    quint64 count = 0;
+    auto i = a.array.begin();
+    auto j = b.array.begin();
+    while (i != a.array.end() && j != b.array.end()) {
+        if (*i < *j) {
+            ++i;
+        } else if (*j < *i) {
+            ++j;
+        } else {
+            ++count;
+            ++i;
+            ++j;
+        }
+    }
+    return count;
+}
+
+RoaringBitmap RoaringBitmap::operator&(const RoaringBitmap& other) const
+{
+    RoaringBitmap result;
+    int i = 0;
+    int j = 0;
+    while (i < int(m_containers.size()) && j < int(other.m_containers.size())) {
+        const Container& a = m_containers[i];
+        const Container& b = other.m_containers[j];
+        if (a.key < b.key) {
+            ++i;
+        } else if (b.key < a.key) {
+            ++j;
+        } else {
+            Container merged = intersect(a, b);
+            if (merged.cardinality > 0) {
+                result.m_containers.push_back(merged);
+            }
+            ++i;
+            ++j;
+        }
+    }
+    return result;
+}
+
+RoaringBitmap RoaringBitmap::operator|(const RoaringBitmap& other) const
+{
+    RoaringBitmap result;
+    result.m_containers.reserve(m_containers.size() + other.m_containers.size());
+    int i = 0;
+    int j = 0;
+    while (i < int(m_containers.size()) || j < int(other.m_containers.size())) {
+        if (j >= int(other.m_containers.size())
+            || (i < int(m_containers.size()) && m_containers[i].key < other.m_containers[j].key)) {
+            result.m_containers.push_back(m_containers[i++]);
+        } else if (i >= int(m_containers.size()) || other.m_containers[j].key < m_containers[i].key) {
+            result.m_containers.push_back(other.m_containers[j++]);
+        } else {
+            result.m_containers.push_back(unite(m_containers[i], other.m_containers[j]));
+            ++i;
+            ++j;
+        }
+    }
+    return result;
+}
+
+quint64 RoaringBitmap::intersectionCardinality(const RoaringBitmap& other) const
+{
+    quint64 total = 0;
+    int i = 0;
+    int j = 0;
+    while (i < int(m_containers.size()) && j < int(other.m_containers.size())) {
+        const Container& a = m_containers[i];
+        const Container& b = other.m_containers[j];
+        if (a.key < b.key) {
+            ++i;
+        } else if (b.key < a.key) {
+            ++j;
+        } else {
+            total += intersectCount(a, b);
+            ++i;
+            ++j;
+        }
+    }
+    return total;
+}
@@ -0,0 +1,59 @@
+#ifndef ROARINGBITMAP_H
+#define ROARINGBITMAP_H
+
+#include <QVector>
+#include <QtGlobal>
+
+// Conjunto comprimido de enteros de 32 bits al estilo "roaring bitmap".
+// Los valores se agrupan por sus 16 bits altos; cada grupo (contenedor) guarda los 16 bits bajos
+// como lista ordenada si tiene pocos elementos, o como mapa de 65536 bits si está denso.
+// Las intersecciones y uniones se hacen contenedor a contenedor, sin expandir el conjunto.
+class RoaringBitmap
+{
+public:
+    void add(quint32 value);
+    void remove(quint32 value);
+    bool contains(quint32 value) const;
+    void clear() { m_containers.clear(); }
+
+    quint64 cardinality() const;
+    bool isEmpty() const { return m_containers.empty(); }
+
+    RoaringBitmap operator&(const RoaringBitmap& other) const;
+    RoaringBitmap operator|(const RoaringBitmap& other) const;
+    RoaringBitmap& operator&=(const RoaringBitmap& other) { *this = *this & other; return *this; }
+    RoaringBitmap& operator|=(const RoaringBitmap& other) { *this = *this | other; return *this; }
+
+    // Cardinal de la intersección sin construirla (para los recuentos de facetas)
+    quint64 intersectionCardinality(const RoaringBitmap& other) const;
+
+    // Valores en orden ascendente
+    QVector<quint32> toVector() const;
+
+private:
+    // Por encima de este número de elementos un contenedor pasa a mapa de bits (8 KB)
+    static const int kArrayLimit = 4096;
+    static const int kBitsetWords = 65536 / 64;
+
+    struct Container {
+        quint16 key = 0;
+        int cardinality = 0;
+        QVector<quint16> array;  // Ordenado; se usa si el mapa de bits está vacío
+        QVector<quint64> bitset; // kBitsetWords palabras cuando el contenedor es denso
+
+        bool isBitset() const { return !bitset.empty(); }
+        bool contains(quint16 low) const;
+        void toBitset();
+        void toArray();
+    };
+
+    QVector<Container> m_containers; // Ordenados por clave
+
+    int findContainer(quint16 key) const; // Índice o -(posición de inserción) - 1
+
+    static Container intersect(const Container& a, const Container& b);
+    static Container unite(const Container& a, const Container& b);
+    static quint64 intersectCount(const Container& a, const Container& b);
+};
+
+#endif // ROARINGBITMAP_H
@@ -0,0 +1,36 @@
+#include "textnormalizer.h"
+#include <QRegularExpression>
+
+QString TextNormalizer::fold(const QString& text)
+{
+    // NFD separa cada letra de sus marcas diacríticas; después descartamos las marcas
+    const QString decomposed = text.normalized(QString::NormalizationForm_D);
+
+    QString result;
+    result.reserve(decomposed.size());
+    bool lastWasSpace = true; // Evita espacios al principio
+    for (const QChar ch : decomposed) {
+        if (ch.category() == QChar::Mark_NonSpacing) {
+            continue;
+        }
+        if (ch.isSpace()) {
+            if (!lastWasSpace) {
+                result.append(QLatin1Char(' '));
+            }
+            lastWasSpace = true;
+            continue;
+        }
+        result.append(ch.toCaseFolded());
+        lastWasSpace = false;
+    }
+    if (result.endsWith(QLatin1Char(' '))) {
+        result.chop(1);
+    }
+    return result;
+}
+
+QStringList TextNormalizer::words(const QString& foldedText)
+{
+    static const QRegularExpression separators("[^\\w]+", QRegularExpression::UseUnicodePropertiesOption);
+    return foldedText.split(separators, Qt::SkipEmptyParts);
+}
@@ -0,0 +1,20 @@
+#ifndef TEXTNORMALIZER_H
+#define TEXTNORMALIZER_H
+
+#include <QString>
+#include <QStringList>
+
+// Utilidades para comparar textos en español sin tener en cuenta acentos ni mayúsculas.
+// "María José" y "maria jose" producen la misma forma normalizada.
+class TextNormalizer
+{
+public:
+    // Quita diacríticos (á -> a, ñ -> n, ü -> u), pasa a minúsculas (case folding)
+    // y colapsa los espacios repetidos.
+    static QString fold(const QString& text);
+
+    // Divide un texto ya normalizado en palabras (separadas por espacios o signos)
+    static QStringList words(const QString& foldedText);
+};
+
+#endif // TEXTNORMALIZER_H
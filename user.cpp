@@ -1,6 +1,22 @@
 #include "user.h"
+#include "textnormalizer.h"
 
 User::User(QObject *parent)
 {
 
 }
+
+QString User::normalizeGender(const QString& value)
+{
+    const QString folded = TextNormalizer::fold(value.trimmed());
+    if (folded.startsWith("muj") || folded.startsWith('f')) { // Mujer / Femenino / F
+        return "Femenino";
+    }
+    if (folded.startsWith('m') || folded.startsWith('h') || folded.startsWith('v')) { // Masculino / Hombre / Varón
+        return "Masculino";
+    }
+    if (folded.startsWith('o') || folded == "x") {
+        return "Otro";
+    }
+    return QString();
+}
@@ -47,6 +47,11 @@ public:
     void setGoal(const QString& goal) { m_goal = goal; }
     void setCreatedAt(const QDateTime& createdAt) { m_createdAt = createdAt; }
 
+    // Género a uno de los valores de los desplegables de alta ("Masculino", "Femenino", "Otro"), o vacío
+    // si no se reconoce. Admite Mujer/Hombre/Varón, abreviaturas y acentos. "Mujer" empieza por 'm':
+    // se comprueba antes que Masculino.
+    static QString normalizeGender(const QString& value);
+
 private:
     int m_id;
     QString m_firstName;
@@ -1,4 +1,6 @@
 #include "usermanager.h"
+#include "datachangehub.h"
+#include "collationkey.h"
 #include <QDebug>
 #include <QSqlQuery>
 #include <QSqlError>
@@ -11,11 +13,28 @@ UserManager::UserManager(QObject *parent) : QObject(parent)
 
 // Añade un nuevo usuario a la base de datos.
 // El ID del objeto 'user' se actualizará si la inserción es exitosa.
-bool UserManager::addUser(User& user)
+bool UserManager::addUser(User& user, QList<PatientDeduplicator::Candidate>* duplicates)
 {
+    if (duplicates) {
+        // Comprobación incremental: solo los bloques del índice en memoria que comparte el paciente
+        *duplicates = PatientDeduplicator::instance()->candidatesFor(user);
+        if (!duplicates->isEmpty()) {
+            qInfo() << "Alta pendiente de confirmar: posible duplicado del usuario" << duplicates->first().duplicateOf
+                    << "(puntuación" << duplicates->first().score << ")";
+            return false;
+        }
+    }
+
+    // El alta y el contador de cambios van en la misma transacción: una instantánea nunca
+    // puede parecer vigente con un paciente que no contiene
+    QSqlDatabase db = QSqlDatabase::database();
+    if (!db.transaction()) {
+        qCritical() << "Error al iniciar la transacción del alta de usuario:" << db.lastError().text();
+        return false;
+    }
     QSqlQuery query;
-    query.prepare("INSERT INTO users (first_name, last_name1, last_name2, gender, birth_date, activity_level, goal) "
-                  "VALUES (:first_name, :last_name1, :last_name2, :gender, :birth_date, :activity_level, :goal)");
+    query.prepare("INSERT INTO users (first_name, last_name1, last_name2, gender, birth_date, activity_level, goal, sort_key) "
+                  "VALUES (:first_name, :last_name1, :last_name2, :gender, :birth_date, :activity_level, :goal, :sort_key)");
 
     query.bindValue(":first_name", user.firstName());
     query.bindValue(":last_name1", user.lastName1());
@@ -24,28 +43,44 @@ bool UserManager::addUser(User& user)
     query.bindValue(":birth_date", user.birthDate().toString(Qt::ISODate)); // Almacena la fecha en formato ISO
     query.bindValue(":activity_level", user.activityLevel());
     query.bindValue(":goal", user.goal());
+    query.bindValue(":sort_key", CollationKey::forUserName(user.firstName(), user.lastName1(), user.lastName2()));
 
     if (!query.exec()) {
         qCritical() << "Error al añadir usuario:" << query.lastError().text();
+        db.rollback();
         return false;
     }
 
     // Si la inserción fue exitosa, recupera el ID autogenerado
-    if (query.lastInsertId().isValid()) {
-        user.setId(query.lastInsertId().toInt()); // Asigna el ID de vuelta al objeto User
-        qInfo() << "Usuario añadido correctamente con ID:" << user.id();
-        return true;
+    if (!query.lastInsertId().isValid()) {
+        qCritical() << "Error: Usuario añadido, pero no se pudo recuperar el ID generado.";
+        db.rollback();
+        return false;
+    }
+    if (!bumpUsersChangeCounter(db)) {
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar el alta del usuario:" << db.lastError().text();
+        return false;
     }
 
-    qCritical() << "Error: Usuario añadido, pero no se pudo recuperar el ID generado.";
-    return false;
+    user.setId(query.lastInsertId().toInt()); // Asigna el ID de vuelta al objeto User
+    qInfo() << "Usuario añadido correctamente con ID:" << user.id();
+    emit DataChangeHub::instance()->userAdded(user.id());
+    return true;
 }
 
 // Recupera todos los usuarios de la base de datos.
-QList<QSharedPointer<User>> UserManager::getAllUsers()
+QList<QSharedPointer<User>> UserManager::getAllUsers(const QSqlDatabase& db)
 {
     QList<QSharedPointer<User>> users;
-    QSqlQuery query("SELECT user_id, first_name, last_name1, last_name2, gender, birth_date, activity_level, goal, created_at FROM users ORDER BY first_name ASC");
+    // El orden lo da la clave de colación indexada (sin comparaciones de idioma en tiempo de ejecución)
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT user_id, first_name, last_name1, last_name2, gender, birth_date, activity_level, goal, created_at "
+                  "FROM users ORDER BY sort_key ASC, user_id ASC");
 
     if (!query.exec()) {
         qCritical() << "Error getting all users:" << query.lastError().text();
@@ -69,6 +104,48 @@ QList<QSharedPointer<User>> UserManager::getAllUsers()
     return users;
 }
 
+// Recupera una página de usuarios en orden alfabético a partir de la última fila de la página anterior.
+// La condición por clave usa el índice (sort_key, user_id), así que el coste no depende del número de página.
+QList<QSharedPointer<User>> UserManager::getUsersPage(const QByteArray& afterSortKey, int afterUserId, int limit)
+{
+    QList<QSharedPointer<User>> users;
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    // Primera página sin condición: una clave vacía podría enlazarse como NULL y no devolver nada
+    const bool firstPage = afterSortKey.isEmpty() && afterUserId <= 0;
+    query.prepare(QString("SELECT user_id, first_name, last_name1, last_name2, gender, birth_date, activity_level, goal, created_at "
+                          "FROM users %1"
+                          "ORDER BY sort_key ASC, user_id ASC LIMIT :limit")
+                      .arg(firstPage ? QString()
+                                     : QString("WHERE sort_key > :sort_key OR (sort_key = :sort_key2 AND user_id > :user_id) ")));
+    if (!firstPage) {
+        query.bindValue(":sort_key", afterSortKey);
+        query.bindValue(":sort_key2", afterSortKey);
+        query.bindValue(":user_id", afterUserId);
+    }
+    query.bindValue(":limit", limit);
+
+    if (!query.exec()) {
+        qCritical() << "Error al obtener la página de usuarios:" << query.lastError().text();
+        return users;
+    }
+
+    while (query.next()) {
+        users.append(QSharedPointer<User>::create(
+            query.value("user_id").toInt(),
+            query.value("first_name").toString(),
+            query.value("last_name1").toString(),
+            query.value("last_name2").toString(),
+            query.value("gender").toString(),
+            QDate::fromString(query.value("birth_date").toString(), Qt::ISODate),
+            query.value("activity_level").toString(),
+            query.value("goal").toString(),
+            query.value("created_at").toDateTime()
+            ));
+    }
+    return users;
+}
+
 // Actualiza un usuario existente en la base de datos.
 bool UserManager::updateUser(const User& user)
 {
@@ -77,10 +154,16 @@ bool UserManager::updateUser(const User& user)
         return false;
     }
 
+    QSqlDatabase db = QSqlDatabase::database();
+    if (!db.transaction()) {
+        qCritical() << "Error al iniciar la transacción de actualización del usuario con ID" << user.id() << ":" << db.lastError().text();
+        return false;
+    }
     QSqlQuery query;
     query.prepare("UPDATE users SET "
                   "first_name = :first_name, last_name1 = :last_name1, last_name2 = :last_name2, "
-                  "gender = :gender, birth_date = :birth_date, activity_level = :activity_level, goal = :goal "
+                  "gender = :gender, birth_date = :birth_date, activity_level = :activity_level, goal = :goal, "
+                  "sort_key = :sort_key "
                   "WHERE user_id = :user_id");
 
     query.bindValue(":first_name", user.firstName());
@@ -90,19 +173,31 @@ bool UserManager::updateUser(const User& user)
     query.bindValue(":birth_date", user.birthDate().toString(Qt::ISODate));
     query.bindValue(":activity_level", user.activityLevel());
     query.bindValue(":goal", user.goal());
+    query.bindValue(":sort_key", CollationKey::forUserName(user.firstName(), user.lastName1(), user.lastName2()));
     query.bindValue(":user_id", user.id());
 
     if (!query.exec()) {
         qCritical() << "Error al actualizar usuario con ID" << user.id() << ":" << query.lastError().text();
+        db.rollback();
         return false;
     }
 
     if (query.numRowsAffected() == 0) {
         qWarning() << "Usuario con ID" << user.id() << "no encontrado para actualizar.";
+        db.rollback();
         return false;
     }
 
+    if (!bumpUsersChangeCounter(db)) {
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar la actualización del usuario con ID" << user.id() << ":" << db.lastError().text();
+        return false;
+    }
     qInfo() << "Usuario con ID" << user.id() << "actualizado correctamente.";
+    emit DataChangeHub::instance()->userUpdated(user.id());
     return true;
 }
 
@@ -114,21 +209,37 @@ bool UserManager::deleteUser(int id)
         return false;
     }
 
+    QSqlDatabase db = QSqlDatabase::database();
+    if (!db.transaction()) {
+        qCritical() << "Error al iniciar la transacción de baja del usuario con ID" << id << ":" << db.lastError().text();
+        return false;
+    }
     QSqlQuery query;
     query.prepare("DELETE FROM users WHERE user_id = :id");
     query.bindValue(":id", id);
 
     if (!query.exec()) {
         qCritical() << "Error al eliminar usuario con ID" << id << ":" << query.lastError().text();
+        db.rollback();
         return false;
     }
 
     if (query.numRowsAffected() == 0) {
         qWarning() << "Usuario con ID" << id << "no encontrado para eliminar.";
+        db.rollback();
         return false;
     }
 
+    if (!bumpUsersChangeCounter(db)) {
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar la baja del usuario con ID" << id << ":" << db.lastError().text();
+        return false;
+    }
     qInfo() << "Usuario con ID" << id << "eliminado correctamente.";
+    emit DataChangeHub::instance()->userDeleted(id);
     return true;
 }
 
@@ -166,3 +277,43 @@ QSharedPointer<User> UserManager::getUserById(int id)
         return QSharedPointer<User>(); // Devuelve un puntero nulo si el usuario no se encuentra
     }
 }
+
+// Lee el contador de cambios de la tabla 'users' guardado en 'app_meta'.
+// Devuelve 0 si todavía no se ha registrado ningún cambio y -1 si hay un error.
+qint64 UserManager::usersChangeCounter(const QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT value FROM app_meta WHERE name = :name");
+    query.bindValue(":name", "users_version");
+
+    if (!query.exec()) {
+        qCritical() << "Error al leer el contador de cambios de usuarios:" << query.lastError().text();
+        return -1;
+    }
+    return query.next() ? query.value(0).toLongLong() : 0;
+}
+
+// Incrementa el contador de cambios de 'users'. Se llama dentro de la transacción de cada escritura,
+// que se deshace si el contador no se puede actualizar.
+bool UserManager::bumpUsersChangeCounter(const QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+    query.prepare("UPDATE app_meta SET value = value + 1 WHERE name = :name");
+    query.bindValue(":name", "users_version");
+
+    if (!query.exec()) {
+        qWarning() << "No se pudo actualizar el contador de cambios de usuarios:" << query.lastError().text();
+        return false;
+    }
+
+    if (query.numRowsAffected() == 0) {
+        // Primera escritura: la fila todavía no existe
+        query.prepare("INSERT INTO app_meta (name, value) VALUES (:name, 1)");
+        query.bindValue(":name", "users_version");
+        if (!query.exec()) {
+            qWarning() << "No se pudo crear el contador de cambios de usuarios:" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
@@ -4,7 +4,9 @@
 #include <QObject>
 #include <QVector>
 #include <QSharedPointer>
+#include <QSqlDatabase>
 #include "user.h" // Incluimos nuestra clase User
+#include "patientdeduplicator.h"
 
 class UserManager : public QObject {
     Q_OBJECT
@@ -12,12 +14,27 @@ public:
     explicit UserManager(QObject *parent = nullptr);
 
     // Operaciones CRUD
-    bool addUser(User& user); // Añade un nuevo usuario, el ID se actualizará en el objeto 'user'
-    QList<QSharedPointer<User>> getAllUsers(); // Obtiene todos los usuarios
+    // Añade un nuevo usuario, el ID se actualizará en el objeto 'user'.
+    // Con 'duplicates', antes comprueba si ya hay un paciente parecido (PatientDeduplicator): si lo hay
+    // no guarda nada, devuelve los candidatos en 'duplicates' y retorna false para que el usuario
+    // confirme el alta o use la ficha existente. El alta confirmada se repite sin 'duplicates'.
+    bool addUser(User& user, QList<PatientDeduplicator::Candidate>* duplicates = nullptr);
+    // Obtiene todos los usuarios (orden alfabético español); 'db' para leer desde otro hilo con su conexión
+    QList<QSharedPointer<User>> getAllUsers(const QSqlDatabase& db = QSqlDatabase::database());
+    // Paginación por clave: hasta 'limit' usuarios posteriores a (afterSortKey, afterUserId).
+    // Para la primera página se pasa una clave vacía y afterUserId = 0.
+    QList<QSharedPointer<User>> getUsersPage(const QByteArray& afterSortKey, int afterUserId, int limit);
     QSharedPointer<User> getUserById(int userId); // Obtiene un usuario por su ID
     bool updateUser(const User& user); // Actualiza los datos de un usuario existente
     bool deleteUser(int userId); // Elimina un usuario por su ID
 
+    // Contador que se incrementa con cada alta, modificación o baja de usuarios.
+    // Permite saber si una copia en caché (p. ej. la instantánea de arranque) sigue vigente.
+    qint64 usersChangeCounter(const QSqlDatabase& db = QSqlDatabase::database());
+    // Lo llaman las escrituras de este gestor y las que insertan pacientes directamente (BulkImporter,
+    // con la conexión de su hilo de escritura)
+    bool bumpUsersChangeCounter(const QSqlDatabase& db = QSqlDatabase::database());
+
 private:
          // No necesitamos una QSqlDatabase miembro aquí, usaremos la conexión por defecto.
 };
@@ -0,0 +1,275 @@
+#include "usersearchindex.h"
+#include "textnormalizer.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <climits>
+#include <iterator>
+
+UserSearchIndex::UserSearchIndex()
+    : m_hasLastResult(false)
+{
+}
+
+void UserSearchIndex::clear()
+{
+    m_documents.clear();
+    m_trigrams.clear();
+    m_words.clear();
+    m_lastTerms.clear();
+    m_lastResult.clear();
+    m_hasLastResult = false;
+}
+
+void UserSearchIndex::rebuild(const QVector<UserSnapshot::Entry>& entries)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    clear();
+    m_documents.reserve(entries.count());
+    m_words.reserve(entries.count() * 4);
+
+    // Insertamos sin mantener el orden y ordenamos una sola vez al final
+    for (const UserSnapshot::Entry& entry : entries) {
+        indexDocument(entry.id, documentFor(entry), false);
+    }
+    for (auto it = m_trigrams.begin(); it != m_trigrams.end(); ++it) {
+        QVector<int>& posting = it.value();
+        std::sort(posting.begin(), posting.end());
+        posting.erase(std::unique(posting.begin(), posting.end()), posting.end());
+    }
+    std::sort(m_words.begin(), m_words.end());
+    m_words.erase(std::unique(m_words.begin(), m_words.end()), m_words.end());
+
+    qInfo() << "Índice de búsqueda de pacientes construido:" << m_documents.count()
+            << "pacientes," << m_trigrams.count() << "trigramas en" << timer.elapsed() << "ms";
+}
+
+void UserSearchIndex::addUser(const UserSnapshot::Entry& entry)
+{
+    if (m_documents.contains(entry.id)) {
+        removeUser(entry.id);
+    }
+    indexDocument(entry.id, documentFor(entry), true);
+    m_hasLastResult = false; // El nuevo paciente podría entrar en la búsqueda anterior
+}
+
+void UserSearchIndex::updateUser(const UserSnapshot::Entry& entry)
+{
+    removeUser(entry.id);
+    indexDocument(entry.id, documentFor(entry), true);
+    m_hasLastResult = false;
+}
+
+void UserSearchIndex::removeUser(int userId)
+{
+    const QString document = m_documents.take(userId);
+    if (document.isEmpty()) {
+        return;
+    }
+
+    for (quint64 trigram : trigramsOf(document)) {
+        auto it = m_trigrams.find(trigram);
+        if (it == m_trigrams.end()) {
+            continue;
+        }
+        QVector<int>& posting = it.value();
+        auto pos = std::lower_bound(posting.begin(), posting.end(), userId);
+        if (pos != posting.end() && *pos == userId) {
+            posting.erase(pos);
+        }
+        if (posting.isEmpty()) {
+            m_trigrams.erase(it);
+        }
+    }
+
+    for (const QString& word : TextNormalizer::words(document)) {
+        const QPair<QString, int> key(word, userId);
+        auto pos = std::lower_bound(m_words.begin(), m_words.end(), key);
+        if (pos != m_words.end() && *pos == key) {
+            m_words.erase(pos);
+        }
+    }
+
+    m_lastResult.remove(userId);
+}
+
+QSet<int> UserSearchIndex::search(const QString& query)
+{
+    const QStringList terms = TextNormalizer::words(TextNormalizer::fold(query));
+
+    QSet<int> result;
+    if (terms.isEmpty()) {
+        for (auto it = m_documents.cbegin(); it != m_documents.cend(); ++it) {
+            result.insert(it.key());
+        }
+        m_hasLastResult = false;
+        return result;
+    }
+
+    auto matchesAll = [&terms](const QString& document) {
+        for (const QString& term : terms) {
+            if (!termMatches(document, term)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (m_hasLastResult && canRefine(m_lastTerms, terms)) {
+        // La consulta amplía la anterior: basta con filtrar los candidatos previos
+        for (int userId : std::as_const(m_lastResult)) {
+            if (matchesAll(m_documents.value(userId))) {
+                result.insert(userId);
+            }
+        }
+    } else {
+        // El término más largo suele ser el más selectivo
+        QString seedTerm = terms.first();
+        for (const QString& term : terms) {
+            if (term.size() > seedTerm.size()) {
+                seedTerm = term;
+            }
+        }
+        const QVector<int> candidates = candidatesForTerm(seedTerm);
+        result.reserve(candidates.size());
+        for (int userId : candidates) {
+            if (matchesAll(m_documents.value(userId))) {
+                result.insert(userId);
+            }
+        }
+    }
+
+    m_lastTerms = terms;
+    m_lastResult = result;
+    m_hasLastResult = true;
+    return result;
+}
+
+QString UserSearchIndex::documentFor(const UserSnapshot::Entry& entry)
+{
+    return TextNormalizer::fold(QString("%1 %2 %3 %4").arg(entry.firstName, entry.lastName1, entry.lastName2,
+                                                          QString::number(entry.id)));
+}
+
+QVector<quint64> UserSearchIndex::trigramsOf(const QString& text)
+{
+    QVector<quint64> trigrams;
+    if (text.size() < 3) {
+        return trigrams;
+    }
+    trigrams.reserve(text.size() - 2);
+    for (int i = 0; i + 2 < text.size(); ++i) {
+        const quint64 key = (quint64(text.at(i).unicode()) << 32)
+                            | (quint64(text.at(i + 1).unicode()) << 16)
+                            | quint64(text.at(i + 2).unicode());
+        trigrams.append(key);
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+// Los términos largos se buscan como subcadena; los cortos, como inicio de palabra
+bool UserSearchIndex::termMatches(const QString& document, const QString& term)
+{
+    if (term.size() >= 3) {
+        return document.contains(term);
+    }
+    qsizetype from = 0;
+    while ((from = document.indexOf(term, from)) >= 0) {
+        if (from == 0 || !document.at(from - 1).isLetterOrNumber()) {
+            return true;
+        }
+        ++from;
+    }
+    return false;
+}
+
+// Se puede refinar si cada término anterior es prefijo del nuevo y no cambia
+// el modo de búsqueda (prefijo de palabra <-> subcadena) de ninguno de ellos
+bool UserSearchIndex::canRefine(const QStringList& previous, const QStringList& current)
+{
+    if (previous.isEmpty() || current.size() < previous.size()) {
+        return false;
+    }
+    for (int i = 0; i < previous.size(); ++i) {
+        if (!current.at(i).startsWith(previous.at(i))) {
+            return false;
+        }
+        if ((previous.at(i).size() >= 3) != (current.at(i).size() >= 3)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QVector<int> UserSearchIndex::candidatesForTerm(const QString& term) const
+{
+    QVector<int> candidates;
+
+    if (term.size() < 3) {
+        // Rango de palabras que empiezan por el término
+        auto it = std::lower_bound(m_words.cbegin(), m_words.cend(), qMakePair(term, INT_MIN));
+        for (; it != m_words.cend() && it->first.startsWith(term); ++it) {
+            candidates.append(it->second);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        return candidates;
+    }
+
+    // Intersección de las listas de trigramas, empezando por la más corta
+    QVector<const QVector<int>*> postings;
+    for (quint64 trigram : trigramsOf(term)) {
+        auto it = m_trigrams.constFind(trigram);
+        if (it == m_trigrams.cend()) {
+            return candidates; // Un trigrama sin pacientes: no hay coincidencias
+        }
+        postings.append(&it.value());
+    }
+    std::sort(postings.begin(), postings.end(), [](const QVector<int>* a, const QVector<int>* b) {
+        return a->size() < b->size();
+    });
+
+    candidates = *postings.first();
+    for (int i = 1; i < postings.size() && !candidates.isEmpty(); ++i) {
+        QVector<int> intersection;
+        intersection.reserve(candidates.size());
+        std::set_intersection(candidates.cbegin(), candidates.cend(),
+                              postings.at(i)->cbegin(), postings.at(i)->cend(),
+                              std::back_inserter(intersection));
+        candidates.swap(intersection);
+    }
+    return candidates;
+}
+
+void UserSearchIndex::indexDocument(int userId, const QString& document, bool keepSorted)
+{
+    m_documents.insert(userId, document);
+
+    for (quint64 trigram : trigramsOf(document)) {
+        QVector<int>& posting = m_trigrams[trigram];
+        if (keepSorted) {
+            auto pos = std::lower_bound(posting.begin(), posting.end(), userId);
+            if (pos == posting.end() || *pos != userId) {
+                posting.insert(pos, userId);
+            }
+        } else {
+            posting.append(userId);
+        }
+    }
+
+    for (const QString& word : TextNormalizer::words(document)) {
+        const QPair<QString, int> key(word, userId);
+        if (keepSorted) {
+            auto pos = std::lower_bound(m_words.begin(), m_words.end(), key);
+            if (pos == m_words.end() || *pos != key) {
+                m_words.insert(pos, key);
+            }
+        } else {
+            m_words.append(key);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef USERSEARCHINDEX_H
+#define USERSEARCHINDEX_H
+
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "usersnapshot.h"
+
+// Índice en memoria para la búsqueda de pacientes mientras se escribe.
+// Indexa nombre, apellidos e ID normalizados (sin acentos ni mayúsculas):
+//  - términos de 3 o más caracteres: se buscan como subcadena mediante trigramas;
+//  - términos de 1 o 2 caracteres: se buscan como prefijo de palabra en una lista ordenada.
+// Si la consulta nueva amplía la anterior, se refina el conjunto de candidatos previo
+// en lugar de volver a consultar los índices.
+class UserSearchIndex
+{
+public:
+    UserSearchIndex();
+
+    // Reconstruye el índice completo a partir de la lista de pacientes
+    void rebuild(const QVector<UserSnapshot::Entry>& entries);
+    void clear();
+
+    // Mantenimiento incremental (altas, modificaciones y bajas)
+    void addUser(const UserSnapshot::Entry& entry);
+    void updateUser(const UserSnapshot::Entry& entry);
+    void removeUser(int userId);
+
+    // Devuelve los IDs de los pacientes que cumplen todos los términos de la consulta
+    QSet<int> search(const QString& query);
+
+    int count() const { return m_documents.count(); }
+
+private:
+    // Texto normalizado por paciente: "nombre apellido1 apellido2 id"
+    QHash<int, QString> m_documents;
+    // Trigrama -> IDs ordenados de forma ascendente
+    QHash<quint64, QVector<int>> m_trigrams;
+    // (palabra, ID) ordenado por palabra, para búsquedas por prefijo
+    QVector<QPair<QString, int>> m_words;
+
+    // Estado de la última búsqueda, usado para refinar la siguiente
+    QStringList m_lastTerms;
+    QSet<int> m_lastResult;
+    bool m_hasLastResult;
+
+    static QString documentFor(const UserSnapshot::Entry& entry);
+    static QVector<quint64> trigramsOf(const QString& text);
+    static bool termMatches(const QString& document, const QString& term);
+    static bool canRefine(const QStringList& previous, const QStringList& current);
+
+    QVector<int> candidatesForTerm(const QString& term) const;
+    void indexDocument(int userId, const QString& document, bool keepSorted);
+};
+
+#endif // USERSEARCHINDEX_H
@@ -0,0 +1,199 @@
+#include "usersnapshot.h"
+#include "collationkey.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+// Formato del archivo (little-endian):
+//   cabecera: "NUSN" | quint32 versión | qint64 contador de cambios | quint32 número de filas | quint32 reservado
+//   cada fila: qint32 user_id | 4 campos (nombre, apellido1, apellido2, clave de orden) como quint16 longitud + bytes UTF-8
+const char kMagic[4] = { 'N', 'U', 'S', 'N' };
+const quint32 kFormatVersion = 2; // v2: clave de colación española (CollationKey)
+const int kHeaderSize = 4 + 4 + 8 + 4 + 4;
+
+// Lector acotado sobre la zona mapeada; cualquier lectura fuera de rango invalida el resultado
+class Reader {
+public:
+    Reader(const uchar* data, qint64 size) : m_data(data), m_size(size), m_pos(0), m_ok(true) {}
+
+    template <typename T>
+    T read() {
+        if (!m_ok || m_pos + qint64(sizeof(T)) > m_size) {
+            m_ok = false;
+            return T();
+        }
+        T value = qFromLittleEndian<T>(m_data + m_pos);
+        m_pos += sizeof(T);
+        return value;
+    }
+
+    QByteArray readBytes() {
+        quint16 length = read<quint16>();
+        if (!m_ok || m_pos + length > m_size) {
+            m_ok = false;
+            return QByteArray();
+        }
+        QByteArray bytes(reinterpret_cast<const char*>(m_data + m_pos), length);
+        m_pos += length;
+        return bytes;
+    }
+
+    bool ok() const { return m_ok; }
+
+private:
+    const uchar* m_data;
+    qint64 m_size;
+    qint64 m_pos;
+    bool m_ok;
+};
+
+template <typename T>
+void appendValue(QByteArray& out, T value)
+{
+    char buffer[sizeof(T)];
+    qToLittleEndian<T>(value, buffer);
+    out.append(buffer, sizeof(T));
+}
+
+void appendBytes(QByteArray& out, const QByteArray& bytes)
+{
+    // Los nombres nunca se acercan al límite, pero truncamos por seguridad
+    const QByteArray clipped = bytes.left(0xFFFF);
+    appendValue<quint16>(out, quint16(clipped.size()));
+    out.append(clipped);
+}
+
+} // namespace
+
+UserSnapshot::UserSnapshot()
+    : m_changeCounter(-1),
+    m_valid(false)
+{
+}
+
+UserSnapshot::Entry UserSnapshot::entryFromUser(const User& user)
+{
+    Entry entry;
+    entry.id = user.id();
+    entry.firstName = user.firstName();
+    entry.lastName1 = user.lastName1();
+    entry.lastName2 = user.lastName2();
+    entry.sortKey = CollationKey::forUserName(user.firstName(), user.lastName1(), user.lastName2());
+    return entry;
+}
+
+QString UserSnapshot::pathForDatabase(const QString& dbFilePath)
+{
+    QFileInfo fi(dbFilePath);
+    return fi.absoluteDir().filePath(fi.completeBaseName() + ".users.snap");
+}
+
+bool UserSnapshot::load(const QString& filePath)
+{
+    m_entries.clear();
+    m_changeCounter = -1;
+    m_valid = false;
+
+    QFile file(filePath);
+    if (!file.exists()) {
+        qInfo() << "No hay instantánea de pacientes en" << filePath;
+        return false;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "No se pudo abrir la instantánea de pacientes:" << file.errorString();
+        return false;
+    }
+    if (file.size() < kHeaderSize) {
+        qWarning() << "Instantánea de pacientes truncada:" << filePath;
+        return false;
+    }
+
+    // Mapeamos el archivo: evita copiarlo entero en un buffer intermedio
+    uchar* data = file.map(0, file.size());
+    if (!data) {
+        qWarning() << "No se pudo mapear la instantánea de pacientes:" << file.errorString();
+        return false;
+    }
+
+    if (std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+        qWarning() << "Instantánea de pacientes con formato desconocido:" << filePath;
+        file.unmap(data);
+        return false;
+    }
+
+    Reader reader(data + sizeof(kMagic), file.size() - qint64(sizeof(kMagic)));
+    const quint32 version = reader.read<quint32>();
+    const qint64 changeCounter = reader.read<qint64>();
+    const quint32 count = reader.read<quint32>();
+    reader.read<quint32>(); // reservado
+
+    if (version != kFormatVersion) {
+        qInfo() << "Versión de instantánea" << version << "ignorada (se esperaba" << kFormatVersion << ").";
+        file.unmap(data);
+        return false;
+    }
+
+    QVector<Entry> entries;
+    entries.reserve(int(count));
+    for (quint32 i = 0; i < count && reader.ok(); ++i) {
+        Entry entry;
+        entry.id = reader.read<qint32>();
+        entry.firstName = QString::fromUtf8(reader.readBytes());
+        entry.lastName1 = QString::fromUtf8(reader.readBytes());
+        entry.lastName2 = QString::fromUtf8(reader.readBytes());
+        entry.sortKey = reader.readBytes();
+        entries.append(entry);
+    }
+    file.unmap(data);
+
+    if (!reader.ok()) {
+        qWarning() << "Instantánea de pacientes corrupta, se ignorará:" << filePath;
+        return false;
+    }
+
+    m_entries = entries;
+    m_changeCounter = changeCounter;
+    m_valid = true;
+    qInfo() << "Instantánea de pacientes cargada:" << m_entries.count() << "filas, contador" << m_changeCounter;
+    return true;
+}
+
+bool UserSnapshot::save(const QString& filePath, const QVector<Entry>& entries, qint64 changeCounter)
+{
+    QByteArray out;
+    out.reserve(kHeaderSize + entries.count() * 48);
+    out.append(kMagic, sizeof(kMagic));
+    appendValue<quint32>(out, kFormatVersion);
+    appendValue<qint64>(out, changeCounter);
+    appendValue<quint32>(out, quint32(entries.count()));
+    appendValue<quint32>(out, 0); // reservado
+
+    for (const Entry& entry : entries) {
+        appendValue<qint32>(out, entry.id);
+        appendBytes(out, entry.firstName.toUtf8());
+        appendBytes(out, entry.lastName1.toUtf8());
+        appendBytes(out, entry.lastName2.toUtf8());
+        appendBytes(out, entry.sortKey);
+    }
+
+    // QSaveFile escribe en un temporal y renombra: nunca dejamos una instantánea a medias
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "No se pudo escribir la instantánea de pacientes:" << file.errorString();
+        return false;
+    }
+    file.write(out);
+    if (!file.commit()) {
+        qWarning() << "Error al guardar la instantánea de pacientes:" << file.errorString();
+        return false;
+    }
+
+    qInfo() << "Instantánea de pacientes guardada:" << entries.count() << "filas en" << filePath;
+    return true;
+}
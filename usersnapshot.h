@@ -0,0 +1,50 @@
+#ifndef USERSNAPSHOT_H
+#define USERSNAPSHOT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include "user.h"
+
+// Instantánea binaria compacta de la lista de pacientes.
+// Se escribe al cerrar la aplicación y se mapea en memoria al arrancar,
+// de forma que la tabla principal se pinta antes de abrir la base de datos.
+// El contador de cambios permite decidir después si hay que recargar desde la DB.
+class UserSnapshot
+{
+public:
+    // Una fila de la lista principal (solo lo que se muestra y el orden)
+    struct Entry {
+        int id = -1;
+        QString firstName;
+        QString lastName1;
+        QString lastName2;
+        QByteArray sortKey; // Clave de ordenación usada al generar la lista
+    };
+
+    UserSnapshot();
+
+    // Construye la fila a partir de un usuario completo
+    static Entry entryFromUser(const User& user);
+
+    // Ruta de la instantánea asociada a un archivo de base de datos (junto a nutricion.db)
+    static QString pathForDatabase(const QString& dbFilePath);
+
+    // Mapea el archivo en memoria y decodifica las entradas.
+    // Retorna false si no existe, está truncado o tiene otra versión de formato.
+    bool load(const QString& filePath);
+
+    // Escribe la instantánea de forma atómica (QSaveFile).
+    static bool save(const QString& filePath, const QVector<Entry>& entries, qint64 changeCounter);
+
+    bool isValid() const { return m_valid; }
+    qint64 changeCounter() const { return m_changeCounter; }
+    const QVector<Entry>& entries() const { return m_entries; }
+
+private:
+    QVector<Entry> m_entries;
+    qint64 m_changeCounter;
+    bool m_valid;
+};
+
+#endif // USERSNAPSHOT_H
@@ -0,0 +1,62 @@
+#include "usertablemodel.h"
+
+UserTableModel::UserTableModel(QObject *parent) : QAbstractTableModel(parent)
+{
+}
+
+void UserTableModel::setEntries(const QVector<UserSnapshot::Entry>& entries)
+{
+    beginResetModel();
+    m_entries = entries;
+    endResetModel();
+}
+
+int UserTableModel::userIdAt(int row) const
+{
+    return row >= 0 && row < m_entries.size() ? m_entries.at(row).id : -1;
+}
+
+int UserTableModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : int(m_entries.size());
+}
+
+int UserTableModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant UserTableModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_entries.size()) {
+        return QVariant();
+    }
+    const UserSnapshot::Entry& entry = m_entries.at(index.row());
+    if (role == Qt::UserRole) {
+        return entry.id;
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    switch (index.column()) {
+    case IdColumn: return entry.id;
+    case FirstNameColumn: return entry.firstName;
+    case LastName1Column: return entry.lastName1;
+    case LastName2Column: return entry.lastName2;
+    }
+    return QVariant();
+}
+
+QVariant UserTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case IdColumn: return QString("ID");
+    case FirstNameColumn: return QString("Nombre");
+    case LastName1Column: return QString("Apellido 1");
+    case LastName2Column: return QString("Apellido 2");
+    }
+    return QVariant();
+}
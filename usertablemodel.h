@@ -0,0 +1,39 @@
+#ifndef USERTABLEMODEL_H
+#define USERTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include "usersnapshot.h"
+
+// Modelo de la lista principal de pacientes (ID, nombre y apellidos) sobre las filas ya filtradas.
+// Cada búsqueda sustituye el vector de filas y reinicia el modelo: la vista solo pide las celdas
+// visibles, en lugar de crear cuatro QTableWidgetItem por paciente en cada pulsación.
+class UserTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        IdColumn,
+        FirstNameColumn,
+        LastName1Column,
+        LastName2Column,
+        ColumnCount
+    };
+
+    explicit UserTableModel(QObject *parent = nullptr);
+
+    void setEntries(const QVector<UserSnapshot::Entry>& entries);
+    // ID del paciente de una fila; -1 si la fila no existe
+    int userIdAt(int row) const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    QVector<UserSnapshot::Entry> m_entries;
+};
+
+#endif // USERTABLEMODEL_H
@@ -0,0 +1,306 @@
+#include "weightforecaster.h"
+#include "datachangehub.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <cmath>
+
+namespace {
+
+const double kAlpha = 0.5;      // Peso de la observación frente a la predicción en el nivel
+const double kBeta = 0.2;       // Peso de la pendiente observada en la tendencia
+const double kErrorWeight = 0.2; // Suavizado de la varianza del error y de la separación media
+const double kZ95 = 1.96;
+
+WeightForecaster::State stateFromQuery(const QSqlQuery& query)
+{
+    WeightForecaster::State state;
+    state.userId = query.value("user_id").toInt();
+    state.level = query.value("level").toDouble();
+    state.trend = query.value("trend").toDouble();
+    state.lastDate = QDate::fromString(query.value("last_date").toString(), Qt::ISODate);
+    state.observations = query.value("observations").toInt();
+    state.errorVariance = query.value("error_variance").toDouble();
+    state.meanGapDays = query.value("mean_gap_days").toDouble();
+    return state;
+}
+
+} // namespace
+
+WeightForecaster* WeightForecaster::instance()
+{
+    static WeightForecaster forecaster;
+    return &forecaster;
+}
+
+WeightForecaster::WeightForecaster(QObject *parent)
+    : QObject(parent)
+{
+    connect(DataChangeHub::instance(), &DataChangeHub::healthMetricAdded, this, &WeightForecaster::onHealthMetricAdded);
+    connect(DataChangeHub::instance(), &DataChangeHub::healthMetricUpdated, this, &WeightForecaster::onHealthMetricChanged);
+    connect(DataChangeHub::instance(), &DataChangeHub::healthMetricDeleted, this, &WeightForecaster::onHealthMetricChanged);
+    connect(DataChangeHub::instance(), &DataChangeHub::userDeleted, this, &WeightForecaster::onUserDeleted);
+    connect(DataChangeHub::instance(), &DataChangeHub::bulkImportCompleted, this, &WeightForecaster::onBulkImportCompleted);
+}
+
+void WeightForecaster::observe(State& state, const QDate& date, double weight)
+{
+    if (weight <= 0 || !date.isValid()) {
+        return;
+    }
+    if (state.observations == 0) {
+        state.level = weight;
+        state.trend = 0.0;
+        state.lastDate = date;
+        state.observations = 1;
+        return;
+    }
+
+    const double gap = state.lastDate.daysTo(date);
+    if (gap <= 0) {
+        // Misma fecha (o anterior, si se llama mal): se promedia en el nivel sin tocar la tendencia
+        state.level = kAlpha * weight + (1.0 - kAlpha) * state.level;
+        ++state.observations;
+        return;
+    }
+
+    const double predicted = state.level + state.trend * gap;
+    const double error = weight - predicted;
+    const double previousLevel = state.level;
+
+    if (state.observations == 1) {
+        // Con dos puntos la tendencia es la pendiente entre ellos
+        state.trend = (weight - previousLevel) / gap;
+        state.level = weight;
+        state.meanGapDays = gap;
+    } else {
+        state.level = kAlpha * weight + (1.0 - kAlpha) * predicted;
+        state.trend = kBeta * (state.level - previousLevel) / gap + (1.0 - kBeta) * state.trend;
+        state.errorVariance = (state.observations == 2)
+                                  ? error * error
+                                  : kErrorWeight * error * error + (1.0 - kErrorWeight) * state.errorVariance;
+        state.meanGapDays = kErrorWeight * gap + (1.0 - kErrorWeight) * state.meanGapDays;
+    }
+    state.lastDate = date;
+    ++state.observations;
+}
+
+QVector<WeightForecaster::Point> WeightForecaster::forecast(const State& state, int horizonDays, int stepDays)
+{
+    QVector<Point> points;
+    if (!state.isValid() || horizonDays <= 0 || stepDays <= 0) {
+        return points;
+    }
+    // Sin historial suficiente no hay tendencia fiable: solo se proyecta con 3 o más mediciones
+    if (state.observations < 3) {
+        return points;
+    }
+
+    const double sigma = std::sqrt(qMax(state.errorVariance, 0.0));
+    const double gap = qMax(state.meanGapDays, 1.0);
+    points.reserve(horizonDays / stepDays + 2);
+    for (int day = 0; day <= horizonDays; day += stepDays) {
+        Point point;
+        point.date = state.lastDate.addDays(day);
+        point.weight = state.level + state.trend * day;
+        // La incertidumbre crece con el número de pasos de predicción (aproximación de Holt)
+        const double spread = kZ95 * sigma * std::sqrt(1.0 + day / gap);
+        point.lower = point.weight - spread;
+        point.upper = point.weight + spread;
+        points.append(point);
+    }
+    return points;
+}
+
+QVector<WeightForecaster::Point> WeightForecaster::forecast(int userId, int horizonDays, int stepDays)
+{
+    return forecast(state(userId), horizonDays, stepDays);
+}
+
+QDate WeightForecaster::estimatedDateFor(const State& state, double targetWeight)
+{
+    if (state.observations < 3 || std::fabs(state.trend) < 1e-6 || targetWeight <= 0) {
+        return QDate();
+    }
+    const double days = (targetWeight - state.level) / state.trend;
+    if (days < 0 || days > 3650) { // Tendencia contraria o más de 10 años: no es una estimación útil
+        return QDate();
+    }
+    return state.lastDate.addDays(qint64(std::ceil(days)));
+}
+
+WeightForecaster::State WeightForecaster::state(int userId)
+{
+    QSqlQuery query;
+    query.prepare("SELECT user_id, level, trend, last_date, observations, error_variance, mean_gap_days "
+                  "FROM weight_forecast_state WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al leer el estado de previsión del usuario" << userId << ":" << query.lastError().text();
+        return State();
+    }
+    if (!query.next()) {
+        return State();
+    }
+    return stateFromQuery(query);
+}
+
+bool WeightForecaster::saveState(const State& state)
+{
+    QSqlQuery query;
+    // REPLACE INTO lo admiten tanto SQLite como MariaDB
+    query.prepare("REPLACE INTO weight_forecast_state "
+                  "(user_id, level, trend, last_date, observations, error_variance, mean_gap_days) "
+                  "VALUES (:user_id, :level, :trend, :last_date, :observations, :error_variance, :mean_gap_days)");
+    query.bindValue(":user_id", state.userId);
+    query.bindValue(":level", state.level);
+    query.bindValue(":trend", state.trend);
+    query.bindValue(":last_date", state.lastDate.toString(Qt::ISODate));
+    query.bindValue(":observations", state.observations);
+    query.bindValue(":error_variance", state.errorVariance);
+    query.bindValue(":mean_gap_days", state.meanGapDays);
+    if (!query.exec()) {
+        qCritical() << "Error al guardar el estado de previsión del usuario" << state.userId << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool WeightForecaster::deleteState(int userId)
+{
+    QSqlQuery query;
+    query.prepare("DELETE FROM weight_forecast_state WHERE user_id = :user_id");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al borrar el estado de previsión del usuario" << userId << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool WeightForecaster::rebuildPatient(int userId)
+{
+    QSqlQuery query;
+    query.prepare("SELECT date, weight FROM health_metrics WHERE user_id = :user_id ORDER BY date, created_at");
+    query.bindValue(":user_id", userId);
+    if (!query.exec()) {
+        qCritical() << "Error al recalcular la previsión del usuario" << userId << ":" << query.lastError().text();
+        return false;
+    }
+
+    State rebuilt;
+    rebuilt.userId = userId;
+    while (query.next()) {
+        observe(rebuilt, QDate::fromString(query.value(0).toString(), Qt::ISODate), query.value(1).toDouble());
+    }
+    return rebuilt.isValid() ? saveState(rebuilt) : deleteState(userId);
+}
+
+bool WeightForecaster::refreshAll()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QHash<int, State> states;
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT user_id, level, trend, last_date, observations, error_variance, mean_gap_days "
+                    "FROM weight_forecast_state")) {
+        qCritical() << "Error al leer los estados de previsión:" << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        const State loaded = stateFromQuery(query);
+        states.insert(loaded.userId, loaded);
+    }
+
+    // Solo las filas que el estado aún no ha visto: pacientes sin estado o mediciones posteriores
+    if (!query.exec("SELECT m.user_id, m.date, m.weight FROM health_metrics m "
+                    "LEFT JOIN weight_forecast_state s ON s.user_id = m.user_id "
+                    "WHERE s.user_id IS NULL OR m.date > s.last_date "
+                    "ORDER BY m.user_id, m.date, m.created_at")) {
+        qCritical() << "Error al leer las mediciones pendientes de previsión:" << query.lastError().text();
+        return false;
+    }
+    QHash<int, State> changed;
+    int rows = 0;
+    while (query.next()) {
+        const int userId = query.value(0).toInt();
+        auto it = changed.find(userId);
+        if (it == changed.end()) {
+            State initial = states.value(userId);
+            initial.userId = userId;
+            it = changed.insert(userId, initial);
+        }
+        observe(it.value(), QDate::fromString(query.value(1).toString(), Qt::ISODate), query.value(2).toDouble());
+        ++rows;
+    }
+    query.finish();
+
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+    for (const State& updated : std::as_const(changed)) {
+        if (!saveState(updated)) {
+            db.rollback();
+            return false;
+        }
+    }
+    if (!db.commit()) {
+        qCritical() << "Error al confirmar los estados de previsión:" << db.lastError().text();
+        return false;
+    }
+
+    qInfo() << "Previsiones de peso actualizadas:" << changed.size() << "pacientes," << rows
+            << "mediciones nuevas en" << timer.elapsed() << "ms";
+    return true;
+}
+
+void WeightForecaster::onHealthMetricAdded(int userId, int metricId)
+{
+    QSqlQuery query;
+    query.prepare("SELECT date, weight FROM health_metrics WHERE metric_id = :metric_id");
+    query.bindValue(":metric_id", metricId);
+    if (!query.exec() || !query.next()) {
+        rebuildPatient(userId);
+        return;
+    }
+    const QDate date = QDate::fromString(query.value(0).toString(), Qt::ISODate);
+    const double weight = query.value(1).toDouble();
+
+    State current = state(userId);
+    if (current.isValid() && date <= current.lastDate) {
+        // Medición intercalada en el historial: el estado incremental ya no vale
+        rebuildPatient(userId);
+        return;
+    }
+    current.userId = userId;
+    observe(current, date, weight);
+    saveState(current);
+}
+
+void WeightForecaster::onHealthMetricChanged(int userId, int metricId)
+{
+    Q_UNUSED(metricId);
+    if (userId > 0) {
+        rebuildPatient(userId);
+    }
+}
+
+void WeightForecaster::onUserDeleted(int userId)
+{
+    deleteState(userId);
+}
+
+// Las mediciones importadas pueden ser anteriores a lo ya procesado: los pacientes con estado se
+// recalculan y refreshAll incorpora de una pasada a los que no tenían ninguno
+void WeightForecaster::onBulkImportCompleted(const QList<int>& userIds)
+{
+    for (int userId : userIds) {
+        if (state(userId).isValid()) {
+            rebuildPatient(userId);
+        }
+    }
+    refreshAll();
+}
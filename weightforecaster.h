@@ -0,0 +1,74 @@
+#ifndef WEIGHTFORECASTER_H
+#define WEIGHTFORECASTER_H
+
+#include <QDate>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QVector>
+
+// Previsión de la evolución del peso por paciente con suavizado exponencial de Holt (nivel + tendencia)
+// adaptado a mediciones con separación irregular (la tendencia se expresa en kg/día).
+// El estado de cada paciente se guarda en la tabla 'weight_forecast_state':
+//  - una medición nueva posterior a la última procesada actualiza el estado en O(1);
+//  - una medición intercalada, editada o borrada obliga a recalcular solo ese paciente;
+//  - refreshAll() procesa únicamente las filas posteriores al estado guardado de cada paciente.
+// Escucha a DataChangeHub, así que el estado se mantiene al día sin que nadie lo llame.
+class WeightForecaster : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct State {
+        int userId = -1;
+        double level = 0.0;         // Peso suavizado en lastDate (kg)
+        double trend = 0.0;         // kg/día
+        QDate lastDate;
+        int observations = 0;
+        double errorVariance = 0.0; // Varianza (suavizada) del error de predicción a un paso
+        double meanGapDays = 7.0;   // Separación media entre mediciones
+
+        bool isValid() const { return observations > 0; }
+    };
+
+    struct Point {
+        QDate date;
+        double weight = 0.0;
+        double lower = 0.0; // Banda de confianza aproximada del 95 %
+        double upper = 0.0;
+    };
+
+    static WeightForecaster* instance();
+
+    // Estado guardado del paciente (isValid() == false si no tiene mediciones)
+    State state(int userId);
+
+    // Proyección desde la última medición, un punto cada stepDays hasta horizonDays
+    QVector<Point> forecast(int userId, int horizonDays, int stepDays = 7);
+    static QVector<Point> forecast(const State& state, int horizonDays, int stepDays = 7);
+
+    // Fecha estimada en la que la tendencia alcanza targetWeight; inválida si la tendencia no va hacia él
+    static QDate estimatedDateFor(const State& state, double targetWeight);
+
+    // Añade al estado las mediciones posteriores a lo ya procesado (o todo, para pacientes nuevos)
+    bool refreshAll();
+    // Recalcula un paciente desde su historial completo
+    bool rebuildPatient(int userId);
+
+    // Incorpora una observación al estado (Holt con separación irregular)
+    static void observe(State& state, const QDate& date, double weight);
+
+private slots:
+    void onHealthMetricAdded(int userId, int metricId);
+    void onHealthMetricChanged(int userId, int metricId);
+    void onUserDeleted(int userId);
+    void onBulkImportCompleted(const QList<int>& userIds);
+
+private:
+    explicit WeightForecaster(QObject *parent = nullptr);
+
+    bool saveState(const State& state);
+    bool deleteState(int userId);
+};
+
+#endif // WEIGHTFORECASTER_H
@@ -0,0 +1,207 @@
+# Convierte las tablas LMS de la OMS (archivos .txt tal como se publican) en arrays constexpr
+# para GrowthReference. Se ejecuta al configurar: el programa no lee ningún archivo al arrancar.
+#
+#   generate_who_tables(<salida.h> <archivo.txt>...)
+#
+# El indicador y el sexo salen del nombre ("wfa", "lhfa"/"hfa", "bmi" y "boys"/"girls"), y de cada
+# archivo se leen las columnas Month, L, M y S. Un indicador puede venir en varios archivos
+# (0-2 y 2-5 años de los patrones de 2006, 5-19 años de la referencia de 2007): se combinan por
+# mes y, si dos dan el mismo mes (24: longitud tumbado y talla de pie), prevalece el que empieza
+# más tarde. Cada tabla se usa desde el mes 0 hasta el primer hueco; una tabla sin filas deja
+# en su lugar la incorporada en growthreference.cpp.
+
+function(generate_who_tables output)
+    set(indicators wfa hfa bmi)
+    set(sexes boys girls)
+    set(array_wfa Weight)
+    set(array_hfa Height)
+    set(array_bmi Bmi)
+    set(array_boys Boys)
+    set(array_girls Girls)
+    set(number_regex "^-?[0-9]+(\\.[0-9]+)?([eE][-+]?[0-9]+)?$")
+
+    # 1. Cada archivo es una parte: <indicador>_<sexo> con su primer mes y sus filas
+    set(part_count 0)
+    foreach(path IN LISTS ARGN)
+        get_filename_component(name "${path}" NAME)
+        string(TOLOWER "${name}" name)
+        if(name MATCHES "girls")
+            set(sex girls)
+        elseif(name MATCHES "boys")
+            set(sex boys)
+        else()
+            continue()
+        endif()
+        if(name MATCHES "wfa")
+            set(indicator wfa)
+        elseif(name MATCHES "hfa")
+            set(indicator hfa) # También "lhfa"
+        elseif(name MATCHES "bmi|bfa")
+            set(indicator bmi)
+        else()
+            continue() # Peso/longitud y demás indicadores que no dependen de la edad
+        endif()
+
+        file(STRINGS "${path}" lines)
+        list(LENGTH lines line_count)
+        if(line_count LESS 2)
+            message(WARNING "Tablas de la OMS: ${name} no tiene filas; se ignora")
+            continue()
+        endif()
+        list(POP_FRONT lines header)
+        string(STRIP "${header}" header)
+        string(REGEX REPLACE "[ \t]+" ";" header "${header}")
+        set(month_column -1)
+        set(l_column -1)
+        set(m_column -1)
+        set(s_column -1)
+        set(column 0)
+        foreach(field IN LISTS header)
+            string(TOLOWER "${field}" field)
+            if(field STREQUAL "month")
+                set(month_column ${column})
+            elseif(field STREQUAL "l")
+                set(l_column ${column})
+            elseif(field STREQUAL "m")
+                set(m_column ${column})
+            elseif(field STREQUAL "s")
+                set(s_column ${column})
+            endif()
+            math(EXPR column "${column} + 1")
+        endforeach()
+        if(month_column LESS 0 OR l_column LESS 0 OR m_column LESS 0 OR s_column LESS 0)
+            # Las tablas ampliadas por días (columna "Day") no se usan: basta con una fila por mes
+            message(WARNING "Tablas de la OMS: ${name} no tiene las columnas Month, L, M y S; se ignora")
+            continue()
+        endif()
+
+        set(part "part${part_count}")
+        set(first_month -1)
+        set(valid TRUE)
+        set(months "")
+        foreach(line IN LISTS lines)
+            string(STRIP "${line}" line)
+            if(line STREQUAL "")
+                continue()
+            endif()
+            string(REGEX REPLACE "[ \t]+" ";" fields "${line}")
+            list(LENGTH fields field_count)
+            if(field_count LESS_EQUAL month_column OR field_count LESS_EQUAL l_column
+               OR field_count LESS_EQUAL m_column OR field_count LESS_EQUAL s_column)
+                set(valid FALSE)
+                break()
+            endif()
+            list(GET fields ${month_column} month)
+            list(GET fields ${l_column} value_l)
+            list(GET fields ${m_column} value_m)
+            list(GET fields ${s_column} value_s)
+            if(NOT month MATCHES "^[0-9]+$" OR NOT value_l MATCHES "${number_regex}"
+               OR NOT value_m MATCHES "${number_regex}" OR NOT value_s MATCHES "${number_regex}"
+               OR value_m MATCHES "^-" OR value_s MATCHES "^-")
+                set(valid FALSE)
+                break()
+            endif()
+            math(EXPR month "${month}") # Sin ceros a la izquierda
+            if(first_month LESS 0 OR month LESS first_month)
+                set(first_month ${month})
+            endif()
+            set(${part}_${month} "{ ${value_l}, ${value_m}, ${value_s} }")
+            list(APPEND months ${month})
+        endforeach()
+        if(NOT valid OR first_month LESS 0)
+            message(WARNING "Tablas de la OMS: ${name} tiene filas no válidas; se ignora")
+            continue()
+        endif()
+
+        # Orden por primer mes con relleno fijo: list(SORT) compara texto
+        string(LENGTH "${first_month}" digits)
+        set(padded "${first_month}")
+        while(digits LESS 4)
+            string(PREPEND padded "0")
+            math(EXPR digits "${digits} + 1")
+        endwhile()
+        list(APPEND parts_${indicator}_${sex} "${padded}:${part}")
+        set(${part}_months "${months}")
+        math(EXPR part_count "${part_count} + 1")
+    endforeach()
+
+    # 2. Una tabla por indicador y sexo, contigua desde el mes 0
+    set(arrays "")
+    set(row_counts "")
+    set(tables "")
+    set(loaded 0)
+    foreach(indicator IN LISTS indicators)
+        set(counts "")
+        set(names "")
+        foreach(sex IN LISTS sexes)
+            if(DEFINED parts_${indicator}_${sex})
+                set(sorted "${parts_${indicator}_${sex}}")
+                list(SORT sorted)
+                foreach(entry IN LISTS sorted)
+                    string(REGEX REPLACE "^[0-9]+:" "" part "${entry}")
+                    foreach(month IN LISTS ${part}_months)
+                        set(merged_${month} "${${part}_${month}}")
+                    endforeach()
+                endforeach()
+            endif()
+            set(rows "")
+            set(month 0)
+            while(DEFINED merged_${month})
+                string(APPEND rows "    ${merged_${month}},\n")
+                unset(merged_${month})
+                math(EXPR month "${month} + 1")
+            endwhile()
+            # Lo que quede tras un hueco no se usa: la interpolación accede por índice
+            foreach(leftover RANGE 0 240)
+                unset(merged_${leftover})
+            endforeach()
+            if(month EQUAL 1)
+                set(month 0) # Una sola fila no permite interpolar
+            endif()
+            if(month EQUAL 0)
+                set(rows "    { 0.0, 0.0, 0.0 },\n") # Sin datos: no se usa (kRows = 0)
+            else()
+                math(EXPR loaded "${loaded} + 1")
+            endif()
+            set(array "k${array_${indicator}}${array_${sex}}")
+            string(APPEND arrays "constexpr Row ${array}[] = {\n${rows}};\n\n")
+            list(APPEND counts ${month})
+            list(APPEND names ${array})
+        endforeach()
+        list(JOIN counts ", " counts)
+        list(JOIN names ", " names)
+        list(APPEND row_counts "{ ${counts} }")
+        list(APPEND tables "{ ${names} }")
+    endforeach()
+    list(JOIN row_counts ", " row_counts)
+    list(JOIN tables ", " tables)
+
+    if(loaded EQUAL 0)
+        message(STATUS "Tablas de la OMS: no hay archivos en who/; solo se incluyen las del primer año")
+    else()
+        message(STATUS "Tablas de la OMS: ${loaded} tablas LMS compiladas desde who/")
+    endif()
+
+    # Solo se reescribe si cambia, para no recompilar en cada configuración
+    file(CONFIGURE OUTPUT "${output}" @ONLY CONTENT
+"// Generado por whotables.cmake a partir de who/*.txt (tablas LMS de la OMS). No editar.
+#ifndef WHOTABLES_H
+#define WHOTABLES_H
+
+namespace WhoTables {
+
+struct Row {
+    double l;
+    double m;
+    double s;
+};
+
+${arrays}// [indicador][sexo]: WeightForAge, HeightForAge, BmiForAge x Male, Female. 0 = sin tabla.
+constexpr int kRows[3][2] = { ${row_counts} };
+constexpr const Row* kTables[3][2] = { ${tables} };
+
+} // namespace WhoTables
+
+#endif // WHOTABLES_H
+")
+endfunction()